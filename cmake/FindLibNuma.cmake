@@ -0,0 +1,27 @@
+#
+# - Find libnuma
+#
+# LIBNUMA_INCLUDE_DIR - Path to numa.h
+# LIBNUMA_LIBRARY     - List of libraries for using libnuma
+# LIBNUMA_FOUND       - True if libnuma was found
+
+set(LIBNUMA_INSTALL "" CACHE PATH "libnuma install directory")
+
+if(LIBNUMA_INSTALL)
+    # install dir specified, only search them
+    find_path(LIBNUMA_INCLUDE_DIR numa.h
+            PATHS ${LIBNUMA_INSTALL} ${LIBNUMA_INSTALL}/include
+            NO_DEFAULT_PATH)
+
+    find_library(LIBNUMA_LIBRARY numa
+            PATHS ${LIBNUMA_INSTALL} ${LIBNUMA_INSTALL}/lib
+            NO_DEFAULT_PATH)
+else()
+    find_path(LIBNUMA_INCLUDE_DIR numa.h)
+    find_library(LIBNUMA_LIBRARY numa)
+endif()
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LibNuma DEFAULT_MSG LIBNUMA_LIBRARY LIBNUMA_INCLUDE_DIR)
+
+mark_as_advanced(LIBNUMA_LIBRARY LIBNUMA_INCLUDE_DIR)
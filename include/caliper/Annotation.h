@@ -42,14 +42,95 @@
 
 #include "common/cali_types.h"
 
+#ifdef CALI_DISABLE
+
+//
+// Compile-time kill switch: with CALI_DISABLE defined, all annotation
+// classes are empty inline definitions that compile to nothing and
+// reference no %Caliper runtime symbols.
+//
+
 namespace cali
 {
-    
+
+class Variant;
+
+class Function
+{
+    Function(const Function&);
+    Function& operator = (const Function&);
+
+public:
+
+    inline Function(const char*) { }
+    inline ~Function()           { }
+};
+
+class Loop
+{
+public:
+
+    class Iteration {
+    public:
+
+        inline Iteration()  { }
+        inline ~Iteration() { }
+    };
+
+    inline Loop(const char*) { }
+    inline ~Loop()           { }
+
+    inline Iteration iteration(int) { return Iteration(); }
+
+    inline void end() { }
+};
+
+class Annotation
+{
+public:
+
+    inline Annotation(const char*, int = 0) { }
+
+    class Guard {
+        Guard(const Guard&);
+        Guard& operator = (const Guard&);
+
+    public:
+
+        inline Guard(Annotation&) { }
+        inline ~Guard()           { }
+    };
+
+    typedef Guard AutoScope;
+
+    inline Annotation& begin()                                  { return *this; }
+    inline Annotation& begin(int)                               { return *this; }
+    inline Annotation& begin(double)                            { return *this; }
+    inline Annotation& begin(const char*)                       { return *this; }
+    inline Annotation& begin(cali_attr_type, void*, uint64_t)   { return *this; }
+    inline Annotation& begin(const Variant&)                    { return *this; }
+
+    inline Annotation& set(int)                                 { return *this; }
+    inline Annotation& set(double)                              { return *this; }
+    inline Annotation& set(const char*)                         { return *this; }
+    inline Annotation& set(cali_attr_type, void*, uint64_t)     { return *this; }
+    inline Annotation& set(const Variant&)                      { return *this; }
+
+    inline void end() { }
+};
+
+} // namespace cali
+
+#else // CALI_DISABLE
+
+namespace cali
+{
+
 class Variant;
 
 /// \addtogroup AnnotationAPI
 /// \{
-    
+
 /// \brief Pre-defined function annotation class
     
 class Function
@@ -218,7 +299,9 @@ public:
 };
 
 /// \} // AnnotationAPI group
-    
+
 } // namespace cali
 
+#endif // CALI_DISABLE
+
 #endif
@@ -0,0 +1,136 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file AttributeHandle.h
+/// \brief Compile-time attribute handles for low-overhead annotations
+///
+/// Requires C++11. Unlike cali::Annotation, which resolves its
+/// attribute by name at runtime on first use per object, an attribute
+/// handle binds the attribute to a static instance selected by the
+/// compile-time hash of its name: steady-state begin/set/end is a
+/// handle load and a blackboard update, and never touches the name
+/// string or the global attribute map.
+
+#pragma once
+
+#include "Caliper.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace cali
+{
+
+/// \addtogroup AnnotationAPI
+/// \{
+
+/// \brief Compile-time FNV-1a hash of the attribute name \a str
+constexpr uint64_t
+attribute_name_hash(const char* str, uint64_t hash = 14695981039346656037ull)
+{
+    return *str ? attribute_name_hash(str+1, (hash ^ static_cast<unsigned char>(*str)) * 1099511628211ull) : hash;
+}
+
+/// \brief Static per-name attribute handle
+///
+/// Binds the attribute named \a name to the template instance selected
+/// by \c attribute_name_hash(name). The attribute is created (or looked
+/// up) once, on first access; all subsequent accesses only load the
+/// cached Attribute object. Example:
+///
+/// \code
+///   for (int i = 0; i < ITER; ++i) {
+///     CALI_CXX_MARK_BEGIN("kernel");
+///     // ...
+///     CALI_CXX_MARK_END("kernel");
+///   }
+/// \endcode
+///
+/// or, accessing the attribute object directly:
+///
+/// \code
+///   const cali::Attribute& attr =
+///     cali::AttributeHandle<cali::attribute_name_hash("myattr")>::attribute("myattr");
+/// \endcode
+
+template <uint64_t NameHash>
+class AttributeHandle
+{
+    Attribute m_attr;
+
+    AttributeHandle(const char* name, cali_attr_type type, int prop) {
+        Caliper c;
+        m_attr = c.create_attribute(name, type, prop);
+    }
+
+public:
+
+    /// \brief Return the attribute for \a name, creating it on first use
+    static const Attribute& attribute(const char*    name,
+                                      cali_attr_type type = CALI_TYPE_STRING,
+                                      int            prop = CALI_ATTR_DEFAULT) {
+        static AttributeHandle<NameHash> handle(name, type, prop);
+        return handle.m_attr;
+    }
+
+    static void begin(const char* name, const char* value) {
+        Caliper c;
+        c.begin(attribute(name), Variant(CALI_TYPE_STRING, value, strlen(value)));
+    }
+
+    static void set(const char* name, const char* value) {
+        Caliper c;
+        c.set(attribute(name), Variant(CALI_TYPE_STRING, value, strlen(value)));
+    }
+
+    static void end(const char* name) {
+        Caliper c;
+        c.end(attribute(name));
+    }
+};
+
+/// \}
+
+} // namespace cali
+
+/// \brief Return the cali::Attribute for \a name through a compile-time handle
+#define CALI_CXX_ATTRIBUTE(name) \
+    (cali::AttributeHandle<cali::attribute_name_hash(name)>::attribute(name))
+
+/// \brief Begin region \a name, binding the attribute through a
+///   compile-time handle. \a name must be a string literal.
+#define CALI_CXX_MARK_BEGIN(name) \
+    cali::AttributeHandle<cali::attribute_name_hash("annotation")>::begin("annotation", (name))
+
+/// \brief End region \a name begun with \ref CALI_CXX_MARK_BEGIN
+#define CALI_CXX_MARK_END(name) \
+    cali::AttributeHandle<cali::attribute_name_hash("annotation")>::end("annotation")
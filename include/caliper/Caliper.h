@@ -83,7 +83,9 @@ private:
         { }
 
     Scope* scope(cali_context_scope_t scope);
-    
+
+    cali_err update_batch(size_t n, const Attribute attr[], const Variant data[], bool is_begin);
+
 
 public:
     
@@ -127,6 +129,8 @@ public:
             flush_cbvec;
         typedef util::callback<void(Caliper*,const SnapshotRecord*)>
             write_cbvec;
+        typedef util::callback<void(Caliper*,int,size_t,const unsigned char*,size_t)>
+            write_blob_cbvec;
                                     
         pre_create_attr_cbvec  pre_create_attr_evt;
         create_attr_cbvec      create_attr_evt;
@@ -144,8 +148,13 @@ public:
         caliper_cbvec          post_init_evt;
         caliper_cbvec          finish_evt;
 
+        snapshot_cbvec         pre_snapshot_evt;
         snapshot_cbvec         snapshot;
+        snapshot_cbvec         post_snapshot_evt;
+
+        process_snapshot_cbvec pre_process_snapshot_evt;
         process_snapshot_cbvec process_snapshot;
+        process_snapshot_cbvec post_process_snapshot_evt;
 
         write_cbvec            pre_flush_evt;
         flush_cbvec            flush_evt;
@@ -154,11 +163,44 @@ public:
 
         write_cbvec            pre_write_evt;
         process_snapshot_cbvec write_snapshot;
+
+        // Zero-copy flush path: sources hand pre-encoded record blocks
+        // (binary .cali block type, record count, payload) directly to
+        // sinks that can write them verbatim. Only engaged when a sink
+        // has subscribed; the regular write_snapshot path is used
+        // otherwise.
+        write_blob_cbvec       write_blob_evt;
+
         write_cbvec            post_write_evt;
     };
 
     Events&   events();
 
+    // --- Snapshot channels
+
+    /// \brief A named snapshot subscriber list with its own trigger filter.
+    ///
+    /// Channels allow multiple measurement configurations to share a single
+    /// snapshot source: each snapshot is captured once, and then fanned out
+    /// to all channels whose trigger filter accepts it. Services subscribe
+    /// to a channel's process_snapshot callback instead of the global one.
+    ///
+    /// The trigger filter is a list of attribute names set with
+    /// CALI_CHANNEL_<NAME>_TRIGGER. A channel with a filter receives only
+    /// snapshots triggered by one of the listed attributes; a channel
+    /// without a filter receives all snapshots.
+    struct SnapshotChannel {
+        std::string                    name;
+        std::vector<std::string>       triggers; ///< empty: accept all snapshots
+        Events::process_snapshot_cbvec process_snapshot;
+    };
+
+    /// \brief Return the snapshot channel \a name, creating it on first use.
+    ///
+    /// Channels must be created during service registration, before
+    /// snapshots are being taken.
+    SnapshotChannel* channel(const char* name);
+
     // --- Context environment API
 
     Scope*    create_scope(cali_context_scope_t context);
@@ -168,6 +210,16 @@ public:
 
     void      set_scope_callback(cali_context_scope_t context, ScopeCallbackFn cb);
 
+    /// \brief Get the calling thread's stack bounds.
+    ///
+    /// The bounds are captured once from the pthread attributes when
+    /// the thread's Caliper scope is created and cached per thread,
+    /// so this is a pair of plain thread-local loads with no syscall
+    /// and is safe in signal context. Unwinders use the bounds to
+    /// validate frame pointers with two compares. Returns false if no
+    /// bounds have been captured on this thread.
+    static bool thread_stack_bounds(void** lo, void** hi);
+
     // --- Snapshot API
 
     /// \name Snapshot API
@@ -176,6 +228,18 @@ public:
     void      push_snapshot(int scopes, const SnapshotRecord* trigger_info);
     void      pull_snapshot(int scopes, const SnapshotRecord* trigger_info, SnapshotRecord* snapshot);
 
+    /// \brief Compute a snapshot interest mask for the given attribute ids.
+    ///
+    /// Returns a Bloom-style bitmask (one bit per attribute id) for
+    /// use with the snapshot callback's interest filter: connect the
+    /// callback with this mask (or update it later with
+    /// set_interest()) and pull_snapshot() skips invoking it when the
+    /// trigger info does not contain any of the given attributes.
+    /// Matching is conservative: unrelated attributes may alias onto
+    /// the same bit and cause a spurious invocation, but a registered
+    /// attribute never fails to match.
+    static uint64_t make_attribute_mask(size_t n, const cali_id_t attr_ids[]);
+
     // --- Flush and I/O API
 
     /// \}
@@ -196,6 +260,24 @@ public:
     cali_err  set(const Attribute& attr, const Variant& data);
     cali_err  set_path(const Attribute& attr, size_t n, const Variant data[]);
 
+    // batched updates: apply n attribute/value pairs in one
+    // blackboard transaction per scope
+
+    cali_err  begin(size_t n, const Attribute attr[], const Variant data[]);
+    cali_err  set(size_t n, const Attribute attr[], const Variant data[]);
+
+    // push a pre-constructed tree entry: no value conversion or
+    // node data allocation on this path
+
+    cali_err  begin(const Attribute& attr, Node* node);
+
+    // task context save/restore: capture the thread blackboard's
+    // reference entries in an immutable handle, and re-install them
+    // on another thread at a task switch
+
+    Node*     save_context();
+    cali_err  restore_context(Node* context);
+
     /// \}
     /// \name Blackboard access
     /// \{
@@ -204,6 +286,12 @@ public:
 
     Entry     get(const Attribute& attr);
 
+    /// \brief Get the innermost blackboard entry for \a attr from the
+    ///   given scope, e.g. another thread's scope obtained with
+    ///   default_scope(). Safe against concurrent updates by the
+    ///   owning thread.
+    Entry     get(const Attribute& attr, Scope* scope);
+
     // --- Direct metadata / data access API
 
     /// \}
@@ -104,7 +104,15 @@ public:
           m_data_array { data },
           m_sizes    { 0, n },
           m_capacity { 0, n }
-        { } 
+        { }
+
+    SnapshotRecord(size_t n_nodes, cali::Node** nodes, size_t n_imm, cali_id_t* attr, Variant* data)
+        : m_node_array { nodes },
+          m_attr_array { attr },
+          m_data_array { data },
+          m_sizes    { 0, 0 },
+          m_capacity { n_nodes, n_imm }
+        { }
 
     void append(const SnapshotRecord& list);
     void append(cali::Node*);
@@ -145,10 +153,72 @@ private:
     cali::Node**   m_node_array;
     cali_id_t*     m_attr_array;
     cali::Variant* m_data_array;
-    
+
     Sizes          m_sizes;
     Sizes          m_capacity;
 
 };
 
+/// \brief Compile-time capacity staging buffer for snapshot entries.
+///
+/// Services that contribute multiple entries to a snapshot can stage
+/// them in a SnapshotBuilder and copy them into the target record with
+/// a single bulk flush() instead of issuing one bounds-checked append
+/// per entry. The capacities are template arguments, so appends compile
+/// down to stores at fixed offsets in a stack-allocated buffer: like
+/// FixedSnapshotRecord, a SnapshotBuilder performs no allocations and
+/// can be used in a signal handler. Entries appended beyond the
+/// capacity are dropped and counted in num_skipped().
+
+template<std::size_t NodeCap, std::size_t ImmCap>
+class SnapshotBuilder
+{
+public:
+
+    SnapshotBuilder()
+        : m_n_nodes(0), m_n_immediate(0), m_skipped(0)
+        { }
+
+    void append(cali::Node* node) {
+        if (m_n_nodes < NodeCap)
+            m_nodes[m_n_nodes++] = node;
+        else
+            ++m_skipped;
+    }
+
+    void append(cali_id_t attr, const cali::Variant& data) {
+        if (m_n_immediate < ImmCap) {
+            m_attr[m_n_immediate] = attr;
+            m_data[m_n_immediate] = data;
+            ++m_n_immediate;
+        } else
+            ++m_skipped;
+    }
+
+    std::size_t num_nodes() const     { return m_n_nodes;     }
+    std::size_t num_immediate() const { return m_n_immediate; }
+
+    /// \brief Number of entries dropped because a capacity was exceeded
+    std::size_t num_skipped() const   { return m_skipped;     }
+
+    /// \brief Copy the staged entries into \a rec and reset the builder
+    void flush(SnapshotRecord* rec) {
+        if (rec)
+            rec->append(m_n_nodes, m_nodes, m_n_immediate, m_attr, m_data);
+
+        m_n_nodes = m_n_immediate = 0;
+    }
+
+private:
+
+    cali::Node*   m_nodes[NodeCap > 0 ? NodeCap : 1];
+    cali_id_t     m_attr [ImmCap  > 0 ? ImmCap  : 1];
+    cali::Variant m_data [ImmCap  > 0 ? ImmCap  : 1];
+
+    std::size_t   m_n_nodes;
+    std::size_t   m_n_immediate;
+    std::size_t   m_skipped;
+
+};
+
 }
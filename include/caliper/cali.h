@@ -365,13 +365,35 @@ cali_set  (cali_id_t   attr,
            const void* value,
            size_t      size);
 
-cali_err  
+cali_err
 cali_set_double(cali_id_t attr, double val);
-cali_err  
+cali_err
 cali_set_int(cali_id_t attr, int val);
-cali_err  
+cali_err
 cali_set_string(cali_id_t attr, const char* val);
 
+/**
+ * \brief Begin \a n attribute/value pairs in a single blackboard
+ * transaction per scope.
+ *
+ * Cheaper than \a n individual cali_begin calls when several
+ * attributes change together, e.g. at a task switch.
+ */
+
+cali_err
+cali_begin_list(size_t n, const cali_id_t attr[], const cali_variant_t value[]);
+
+/**
+ * \brief Set \a n attribute/value pairs in a single blackboard
+ * transaction per scope.
+ *
+ * Cheaper than \a n individual cali_set calls when several
+ * attributes change together, e.g. at a task switch.
+ */
+
+cali_err
+cali_set_list(size_t n, const cali_id_t attr[], const cali_variant_t value[]);
+
 /**
  * Put attribute with name \a attr_name on the blackboard.
  */
@@ -410,9 +432,59 @@ cali_set_string_byname(const char* attr_name, const char* val);
 cali_err
 cali_end_byname(const char* attr_name);
 
+/**
+ * \brief Pre-resolved attribute/value pair for the handle-based
+ * annotation API.
+ */
+
+typedef struct _cali_context_handle* cali_context_handle_t;
+
+/**
+ * \brief Pre-resolve attribute \a attr and the value taken from
+ * \a value with size \a size into a context handle.
+ *
+ * The attribute/value pair is resolved into an interned context tree
+ * entry once; pushing the handle with cali_begin_handle() then
+ * requires no string handling, value conversion, or allocation.
+ * Handles remain valid for the lifetime of the Caliper runtime and
+ * can be shared between threads. Calling this function again with the
+ * same pair returns the same handle.
+ *
+ * \note This function is not async-signal safe.
+ *
+ * \param attr  Attribute ID. Cannot have the AS_VALUE property.
+ * \param value Pointer to the value
+ * \param size  Size of the value in bytes
+ * \return The context handle, or NULL if the pair could not be resolved
+ */
+
+cali_context_handle_t
+cali_make_context_handle(cali_id_t attr, const void* value, size_t size);
+
+/**
+ * \brief Add the pre-resolved attribute/value pair in \a handle to
+ * the blackboard.
+ *
+ * The new value is nested under the current value of the handle's
+ * attribute. Equivalent to cali_begin_*() for the pair given to
+ * cali_make_context_handle(), but without per-call string handling,
+ * value conversion, or allocation.
+ */
+
+cali_err
+cali_begin_handle(cali_context_handle_t handle);
+
+/**
+ * \brief Remove innermost value for the handle's attribute from the
+ * blackboard.
+ */
+
+cali_err
+cali_end_handle(cali_context_handle_t handle);
+
 /**
  * \} // name
- * \} // addtogroup 
+ * \} // addtogroup
  */
 
 /*
@@ -453,10 +525,69 @@ cali_init();
 
 int
 cali_is_initialized();
-    
+
+/**
+ * \brief Return the number of bytes currently reserved by the given
+ *   Caliper memory component, or by all tracked components for
+ *   CALI_MEMORY_TOTAL.
+ *
+ * Caliper tracks the memory reserved by its large in-process
+ * consumers (metadata pool, trace buffers, aggregation databases)
+ * and degrades gracefully when usage approaches the total budget
+ * configured with CALI_MEMBUDGET_TOTAL.
+ */
+
+size_t
+cali_memory_usage(cali_memory_component_t component);
+
+/**
+ * \brief Return the configured total memory budget in bytes
+ *   (CALI_MEMBUDGET_TOTAL, given in MiB).
+ * \return The budget in bytes, or 0 if no budget is set.
+ */
+
+size_t
+cali_memory_budget();
+
+/**
+ * \brief Check if the memory budget is exhausted.
+ * \return A non-zero value if a budget is set and total usage
+ *   exceeds it, 0 otherwise.
+ */
+
+int
+cali_memory_budget_exceeded();
+
+/**
+ * \brief Runtime data-loss counters. See cali_get_health().
+ */
+typedef struct {
+  uint64_t dropped_snapshots; /**< Snapshots discarded (full buffers, tables, or queues) */
+  uint64_t dropped_bytes;     /**< Encoded record bytes discarded                        */
+  uint64_t failed_nodes;      /**< Metadata node or node data allocation failures        */
+} cali_health_t;
+
+/**
+ * \brief Fill \a health with Caliper's current data-loss counters.
+ *
+ * Caliper counts the records it loses at runtime: snapshots dropped
+ * by full trace buffers, full aggregation tables, or full send
+ * queues; record bytes discarded; and metadata node allocation
+ * failures. All counters zero means the recorded data is complete.
+ * The counters are always maintained and this call is cheap, so
+ * applications can poll it to detect silent data loss while the job
+ * runs. The counters are also appended to the output metadata at
+ * flush (cali.health.*).
+ *
+ * \note This function is async-signal safe.
+ */
+
+void
+cali_get_health(cali_health_t* health);
+
 /*
  * --- Macro annotation helper functions
- */  
+ */
 
 /**
  * \brief Create a loop iteration attribute for CALI_MARK_LOOP_BEGIN.
@@ -50,9 +50,20 @@ extern "C" {
 typedef enum {
   CALI_SCOPE_PROCESS = 1,
   CALI_SCOPE_THREAD  = 2,
-  CALI_SCOPE_TASK    = 4 
+  CALI_SCOPE_TASK    = 4
 } cali_context_scope_t;
 
+/* Memory components tracked by the memory budget subsystem.
+ * See cali_memory_usage().
+ */
+typedef enum {
+  CALI_MEMORY_METADATA  = 0, /* metadata pool chunks              */
+  CALI_MEMORY_TRACE     = 1, /* trace buffer chunks               */
+  CALI_MEMORY_AGGREGATE = 2, /* aggregation database blocks       */
+
+  CALI_MEMORY_TOTAL     = 3  /* sum over all tracked components   */
+} cali_memory_component_t;
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
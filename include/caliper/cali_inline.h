@@ -0,0 +1,211 @@
+/* *********************************************************************************************
+ * Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ *
+ * This file is part of Caliper.
+ * Written by David Boehme, boehme3@llnl.gov.
+ * LLNL-CODE-678900
+ * All rights reserved.
+ *
+ * For details, see https://github.com/scalability-llnl/Caliper.
+ * Please also see the LICENSE file for our additional BSD notice.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this list of
+ *    conditions and the disclaimer below.
+ *  * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+ *    provided with the distribution.
+ *  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * *********************************************************************************************/
+
+/**
+ * \file cali_inline.h
+ * \brief Opt-in inline fast path for the hottest Caliper C calls.
+ *
+ * This header is not included by cali.h. Including it provides
+ * `static inline` variants of the hot annotation calls that the
+ * compiler can inline into application code, avoiding the shared
+ * library PLT call and instance resolution on the fast path:
+ *
+ *  - The `_fast` call variants inline the runtime's disabled check.
+ *    A disabled run costs a single predictable branch per call site;
+ *    enabled calls fall back into the library.
+ *
+ *  - Value slots turn the hottest set-type updates (e.g. an iteration
+ *    counter) into a single inlined store to an exported per-thread
+ *    state struct. A slot is bound once to an attribute with
+ *    cali_inline_slot_bind(); snapshots then pick the current slot
+ *    values up from the thread state, so the per-update cost is the
+ *    disabled check and the slot store, with no library call at all.
+ *
+ * Slot attributes are created with CALI_ATTR_ASVALUE and
+ * CALI_ATTR_SKIP_EVENTS: slot updates do not trigger events and are
+ * visible in snapshots only. Use the regular API for evented
+ * begin/end region annotations.
+ *
+ * The thread state is exported with the initial-exec TLS model, so
+ * libcaliper must be linked at program start (not dlopen'ed) when this
+ * header is used.
+ */
+
+#ifndef CALI_CALI_INLINE_H
+#define CALI_CALI_INLINE_H
+
+#include "cali.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Number of available inline value slots per process */
+#define CALI_INLINE_MAX_SLOTS 16
+
+/**
+ * \brief Exported per-thread state for the inline fast path.
+ *
+ * Written by the inline slot stores and read by the runtime when it
+ * assembles a snapshot on this thread. The attribute binding of each
+ * slot is process-global (see cali_inline_slot_bind()); only the
+ * values are per-thread.
+ */
+typedef struct {
+    /** bitmask of slots that have been written on this thread */
+    unsigned active;
+
+    /** slot values; the value type is fixed when the slot is bound */
+    union {
+        int      v_int;
+        uint64_t v_uint;
+        double   v_double;
+    } value[CALI_INLINE_MAX_SLOTS];
+} cali_thread_state_t;
+
+#if defined(__GNUC__)
+extern __thread cali_thread_state_t cali_thread_state __attribute__((tls_model("initial-exec")));
+#else
+extern __thread cali_thread_state_t cali_thread_state;
+#endif
+
+/* The runtime fast-disable flag cali_enabled is declared in
+ * cali_macros.h, included via cali.h. */
+
+/**
+ * \brief Bind a value slot to an attribute.
+ *
+ * Creates an attribute with the given \a name and \a type
+ * (CALI_TYPE_INT, CALI_TYPE_UINT, or CALI_TYPE_DOUBLE) and the
+ * CALI_ATTR_ASVALUE, CALI_ATTR_SKIP_EVENTS, and CALI_ATTR_SCOPE_THREAD
+ * properties, and assigns it one of the process-global value slots.
+ * Binding the same name again returns the existing slot.
+ *
+ * \return The slot index to pass to the inline slot stores, or -1 if
+ *   no slot is available or the type is not supported.
+ */
+int
+cali_inline_slot_bind(const char* name, cali_attr_type type);
+
+/**
+ * \brief Set an integer value slot. Inlines into a check and a store.
+ * \param slot Slot index obtained from cali_inline_slot_bind()
+ */
+static inline void
+cali_set_int_slot(int slot, int val)
+{
+    if (cali_enabled) {
+        cali_thread_state.value[slot].v_int = val;
+        cali_thread_state.active |= 1u << slot;
+    }
+}
+
+/** \copydoc cali_set_int_slot */
+static inline void
+cali_set_uint_slot(int slot, uint64_t val)
+{
+    if (cali_enabled) {
+        cali_thread_state.value[slot].v_uint = val;
+        cali_thread_state.active |= 1u << slot;
+    }
+}
+
+/** \copydoc cali_set_int_slot */
+static inline void
+cali_set_double_slot(int slot, double val)
+{
+    if (cali_enabled) {
+        cali_thread_state.value[slot].v_double = val;
+        cali_thread_state.active |= 1u << slot;
+    }
+}
+
+/**
+ * \brief Clear a value slot on this thread. Subsequent snapshots no
+ *   longer contain the slot's attribute.
+ */
+static inline void
+cali_unset_slot(int slot)
+{
+    cali_thread_state.active &= ~(1u << slot);
+}
+
+/*
+ * --- Inline disabled-check variants of the hot annotation calls.
+ *     When the runtime is disabled these compile to a single branch;
+ *     otherwise they fall back into the library.
+ */
+
+/** \brief Inline fast-path variant of cali_begin() */
+static inline cali_err
+cali_begin_fast(cali_id_t attr_id)
+{
+    return cali_enabled ? cali_begin(attr_id) : CALI_SUCCESS;
+}
+
+/** \brief Inline fast-path variant of cali_begin_int() */
+static inline cali_err
+cali_begin_int_fast(cali_id_t attr_id, int val)
+{
+    return cali_enabled ? cali_begin_int(attr_id, val) : CALI_SUCCESS;
+}
+
+/** \brief Inline fast-path variant of cali_begin_string() */
+static inline cali_err
+cali_begin_string_fast(cali_id_t attr_id, const char* val)
+{
+    return cali_enabled ? cali_begin_string(attr_id, val) : CALI_SUCCESS;
+}
+
+/** \brief Inline fast-path variant of cali_set_int() */
+static inline cali_err
+cali_set_int_fast(cali_id_t attr_id, int val)
+{
+    return cali_enabled ? cali_set_int(attr_id, val) : CALI_SUCCESS;
+}
+
+/** \brief Inline fast-path variant of cali_end() */
+static inline cali_err
+cali_end_fast(cali_id_t attr_id)
+{
+    return cali_enabled ? cali_end(attr_id) : CALI_SUCCESS;
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* CALI_CALI_INLINE_H */
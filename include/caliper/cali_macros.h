@@ -42,6 +42,36 @@
  * \{
  */
 
+#ifdef CALI_DISABLE
+
+/* Compile-time kill switch: with CALI_DISABLE defined, all annotation
+ * macros expand to nothing, leaving no residual code or symbol
+ * references at the annotation sites.
+ */
+
+#ifdef __cplusplus
+
+#include "Annotation.h"
+
+#define CALI_CXX_MARK_FUNCTION
+#define CALI_CXX_MARK_LOOP_BEGIN(loop_id, name)
+#define CALI_CXX_MARK_LOOP_END(loop_id)
+#define CALI_CXX_MARK_LOOP_ITERATION(loop_id, iter)
+
+#endif /* __cplusplus */
+
+#define CALI_MARK_FUNCTION_BEGIN
+#define CALI_MARK_FUNCTION_END
+#define CALI_MARK_LOOP_BEGIN(loop_id, name)
+#define CALI_MARK_LOOP_END(loop_id)
+#define CALI_MARK_ITERATION_BEGIN(loop_id, iter)
+#define CALI_MARK_ITERATION_END(loop_id)
+#define CALI_WRAP_STATEMENT(name, statement) statement
+#define CALI_MARK_BEGIN(name)
+#define CALI_MARK_END(name)
+
+#else /* CALI_DISABLE */
+
 #ifdef __cplusplus
 
 #include "Annotation.h"
@@ -98,6 +128,13 @@ extern cali_id_t cali_loop_attr_id;
 extern cali_id_t cali_statement_attr_id;
 extern cali_id_t cali_annotation_attr_id;
 
+/* Runtime fast-disable flag. Set to zero by the runtime when no
+ * services are enabled: the annotation macros then skip the call into
+ * the runtime entirely, so a disabled run costs a single predictable
+ * branch per annotation site.
+ */
+extern int cali_enabled;
+
 /// \brief Mark begin of a function. 
 /// 
 /// Exports the annotated function's name in the pre=defined 
@@ -106,9 +143,11 @@ extern cali_id_t cali_annotation_attr_id;
 /// \ref CALI_CXX_MARK_FUNCTION instead.
 /// \sa CALI_MARK_FUNCTION_END, CALI_CXX_MARK_FUNCTION
 #define CALI_MARK_FUNCTION_BEGIN \
-    if (cali_function_attr_id == CALI_INV_ID) \
-        cali_init(); \
-    cali_begin_string(cali_function_attr_id, __func__)
+    if (cali_enabled) { \
+        if (cali_function_attr_id == CALI_INV_ID) \
+            cali_init(); \
+        cali_begin_string(cali_function_attr_id, __func__); \
+    }
 
 /// \brief Mark end of a function.
 ///
@@ -116,7 +155,8 @@ extern cali_id_t cali_annotation_attr_id;
 /// \ref CALI_MARK_FUNCTION_BEGIN.
 /// \sa CALI_MARK_FUNCTION_BEGIN
 #define CALI_MARK_FUNCTION_END \
-    cali_safe_end_string(cali_function_attr_id, __func__)
+    if (cali_enabled) \
+        cali_safe_end_string(cali_function_attr_id, __func__)
 
 /// \brief Mark a loop
 /// 
@@ -129,11 +169,13 @@ extern cali_id_t cali_annotation_attr_id;
 ///   from the \a iteration and \a end annotations.
 /// \param name    Name of the loop.
 #define CALI_MARK_LOOP_BEGIN(loop_id, name) \
-    if (cali_loop_attr_id == CALI_INV_ID) \
-        cali_init(); \
-    cali_begin_string(cali_loop_attr_id, (name));       \
+    if (cali_enabled) { \
+        if (cali_loop_attr_id == CALI_INV_ID) \
+            cali_init(); \
+        cali_begin_string(cali_loop_attr_id, (name)); \
+    } \
     cali_id_t __cali_iter_##loop_id = \
-        cali_make_loop_iteration_attribute(name);
+        cali_enabled ? cali_make_loop_iteration_attribute(name) : CALI_INV_ID;
 
 /// \brief Mark a loop
 /// 
@@ -148,7 +190,8 @@ extern cali_id_t cali_annotation_attr_id;
 ///
 /// \param loop_id The loop identifier given to \ref CALI_MARK_LOOP_BEGIN.
 #define CALI_MARK_LOOP_END(loop_id) \
-    cali_end(cali_loop_attr_id)
+    if (cali_enabled) \
+        cali_end(cali_loop_attr_id)
 
 /// \brief Mark begin of a loop iteration. 
 ///
@@ -165,7 +208,8 @@ extern cali_id_t cali_annotation_attr_id;
 /// \sa CALI_MARK_ITERATION_END, CALI_MARK_LOOP_BEGIN,
 ///    CALI_CXX_MARK_LOOP_ITERATION
 #define CALI_MARK_ITERATION_BEGIN(loop_id, iter) \
-    cali_begin_int( __cali_iter_##loop_id, ((int) (iter)))
+    if (cali_enabled) \
+        cali_begin_int( __cali_iter_##loop_id, ((int) (iter)))
 
 /// \brief Mark end of a loop iteration.
 ///
@@ -177,7 +221,8 @@ extern cali_id_t cali_annotation_attr_id;
 /// \param loop_id Loop identifier given in \ref CALI_MARK_LOOP_BEGIN.
 /// \sa CALI_MARK_ITERATION_BEGIN
 #define CALI_MARK_ITERATION_END(loop_id) \
-    cali_end( __cali_iter_##loop_id )
+    if (cali_enabled) \
+        cali_end( __cali_iter_##loop_id )
 
 /// \brief Wrap Caliper annotations around a C/C++ statement.
 ///
@@ -198,11 +243,14 @@ extern cali_id_t cali_annotation_attr_id;
 ///   \c break, or \c return).
 ///
 #define CALI_WRAP_STATEMENT(name, statement)     \
-    if (cali_statement_attr_id == CALI_INV_ID) \
-        cali_init(); \
-    cali_begin_string(cali_statement_attr_id, (name));  \
+    if (cali_enabled) { \
+        if (cali_statement_attr_id == CALI_INV_ID) \
+            cali_init(); \
+        cali_begin_string(cali_statement_attr_id, (name)); \
+    } \
     statement; \
-    cali_end(cali_statement_attr_id);
+    if (cali_enabled) \
+        cali_end(cali_statement_attr_id);
 
 /// \brief Mark begin of a user-defined code region.
 ///
@@ -218,9 +266,11 @@ extern cali_id_t cali_annotation_attr_id;
 /// \param name The region name. Must be convertible to `const char*`.
 /// \sa CALI_MARK_END
 #define CALI_MARK_BEGIN(name) \
-    if (cali_annotation_attr_id == CALI_INV_ID) \
-        cali_init(); \
-    cali_begin_string(cali_annotation_attr_id, (name))
+    if (cali_enabled) { \
+        if (cali_annotation_attr_id == CALI_INV_ID) \
+            cali_init(); \
+        cali_begin_string(cali_annotation_attr_id, (name)); \
+    }
 
 /// \brief Mark end of a user-defined code region.
 /// 
@@ -232,8 +282,11 @@ extern cali_id_t cali_annotation_attr_id;
 ///   if it doesn't.
 /// \sa CALI_MARK_BEGIN
 #define CALI_MARK_END(name) \
-    cali_safe_end_string(cali_annotation_attr_id, (name))
+    if (cali_enabled) \
+        cali_safe_end_string(cali_annotation_attr_id, (name))
+
+#endif /* CALI_DISABLE */
 
 /**
- * \} (group) 
+ * \} (group)
  */
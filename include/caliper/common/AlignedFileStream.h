@@ -0,0 +1,94 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file AlignedFileStream.h
+/// \brief AlignedFileStream declaration
+
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace cali
+{
+
+/// \brief Page-cache friendly output file stream.
+///
+/// File output stream for large writes (e.g. trace flushes) that
+/// should not displace the application's working set from the OS
+/// page cache. Data written to stream() is staged in an aligned
+/// buffer and written out in alignment-sized chunks. With the
+/// DirectIO flag the file is opened with O_DIRECT, bypassing the
+/// page cache entirely; with DropCache, written ranges are evicted
+/// from the page cache (posix_fadvise DONTNEED) as writeback
+/// completes. If the file system does not support O_DIRECT, the
+/// stream falls back to buffered writes.
+class AlignedFileStream
+{
+    struct AlignedFileStreamImpl;
+    std::shared_ptr<AlignedFileStreamImpl> mP;
+
+public:
+
+    /// I/O block alignment (bytes) of the staging buffer and of
+    /// direct-I/O writes
+    static const std::size_t alignment;
+
+    enum Flags {
+        DirectIO  = 1, ///< Open the file with O_DIRECT
+        DropCache = 2  ///< Evict written ranges from the page cache
+    };
+
+    AlignedFileStream()
+    { }
+
+    AlignedFileStream(const std::string& filename, int flags);
+
+    ~AlignedFileStream();
+
+    std::ostream& stream();
+
+    bool is_open() const;
+
+    /// \brief Write out staged data up to the last alignment boundary.
+    void flush();
+
+    /// \brief Write out all staged data and close the file.
+    ///
+    /// In direct-I/O mode, the final partial chunk is written
+    /// zero-padded and the file is truncated to its logical length.
+    void close();
+};
+
+} // namespace cali
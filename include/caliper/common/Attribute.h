@@ -105,11 +105,21 @@ public:
     bool is_nested() const {
         return properties() & CALI_ATTR_NESTED;
     }
+    bool is_monotonic() const {
+        return properties() & CALI_ATTR_MONOTONIC;
+    }
 
     Variant        get(const Attribute& attr) const;
     
     static Attribute make_attribute(const Node* node);
 
+    /// Wrap a node that has already been validated as an attribute node
+    /// (i.e., accepted by make_attribute() at registration time).
+    /// Skips the parent-chain check; for use by attribute lookup tables.
+    static Attribute make_attribute_unchecked(const Node* node) {
+        return Attribute(node);
+    }
+
     static MetaAttributeIDs meta_attribute_keys() {
         return s_keys;
     }
@@ -141,7 +141,27 @@ public:
     /// \brief Append node entries
     size_t
     append(size_t n, const Node* const node_vec[]);
-    
+
+    /// \brief Append node entries merged into a single path entry
+    ///
+    /// Flattens the given entries' parent chains and interns their
+    /// concatenation as one path in \a db. Because the metadata tree
+    /// uniquifies paths, snapshots with the same reference context
+    /// collapse onto the same leaf node, and the record stores a single
+    /// node id for the complete chain. Decoders reconstruct the
+    /// individual entries by walking the node's parents.
+    ///
+    /// May create new metadata nodes in \a db, and is therefore not
+    /// async-signal safe. Falls back to appending the entries
+    /// individually if the merged chain cannot be built.
+    size_t
+    append_path(CaliperMetadataAccessInterface& db, size_t n, const Node* const node_vec[]);
+
+    /// \brief Append snapshot record, merging its node entries into a
+    ///   single path entry
+    size_t
+    append_path(CaliperMetadataAccessInterface& db, const SnapshotRecord* rec);
+
     /// \brief Append immediate entries
     size_t
     append(size_t n, const cali_id_t attr_vec[], const Variant data_vec[]);
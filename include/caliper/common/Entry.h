@@ -2,6 +2,7 @@
 #define CALI_ENTRY_H
 
 #include "Attribute.h"
+#include "Node.h"
 #include "Variant.h"
 
 namespace cali
@@ -52,21 +53,51 @@ public:
     /// \brief Return top-level attribute ID of this entry
     ///
     /// For immediate entries, returns the stored attribute id.
-    /// For reference entries, returns the referenced node's 
+    /// For reference entries, returns the referenced node's
     /// attribute id.
-    cali_id_t attribute() const;
+    ///
+    /// The accessors are defined inline: reader-side per-record loops
+    /// touch them for every entry, and an out-of-line call per touch
+    /// dominates the loop cost.
+    cali_id_t attribute() const {
+        return m_node ? m_node->attribute() : m_attr_id;
+    }
 
     /// \brief Count instances of attribute \a attr_id in this entry
-    int       count(cali_id_t attr_id = CALI_INV_ID) const;
+    int       count(cali_id_t attr_id = CALI_INV_ID) const {
+        int res = 0;
+
+        if (m_node) {
+            for (const Node* node = m_node; node; node = node->parent())
+                if (node->attribute() == attr_id)
+                    ++res;
+        } else {
+            if (m_attr_id != CALI_INV_ID && m_attr_id == attr_id)
+                ++res;
+        }
+
+        return res;
+    }
     int       count(const Attribute& attr) const {
         return count(attr.id());
     }
 
     /// \brief Return top-level data value of this entry
-    Variant   value() const;
+    Variant   value() const {
+        return m_node ? m_node->data() : m_value;
+    }
 
     /// \brief Extract data value for attribute \a attr_id from this entry
-    Variant   value(cali_id_t attr_id) const;
+    Variant   value(cali_id_t attr_id) const {
+        if (!m_node && attr_id == m_attr_id)
+            return m_value;
+
+        for (const Node* node = m_node; node; node = node->parent())
+            if (node->attribute() == attr_id)
+                return node->data();
+
+        return Variant();
+    }
     Variant   value(const Attribute& attr) const {
         return value(attr.id());
     }
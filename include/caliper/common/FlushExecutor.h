@@ -0,0 +1,75 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/// @file FlushExecutor.h
+/// FlushExecutor class declaration
+
+#ifndef CALI_FLUSHEXECUTOR_H
+#define CALI_FLUSHEXECUTOR_H
+
+#include <functional>
+#include <vector>
+
+namespace cali
+{
+
+/// \brief Shared worker pool for flush tasks.
+///
+/// Services submit batches of independent flush tasks (per-thread
+/// trace buffer drains, aggregation merge partitions) to a shared,
+/// lazily started worker pool instead of spawning their own threads
+/// or draining everything on the flushing thread. run() blocks until
+/// the batch completes, so ordering between services is preserved by
+/// the sequential flush callback chain: a service's tasks finish
+/// before the next service's flush callback runs.
+///
+/// The pool size is configured with CALI_FLUSH_THREADS. With one
+/// thread (or a single task), tasks run inline on the calling thread.
+/// Tasks must not submit batches themselves.
+
+class FlushExecutor
+{
+public:
+
+    typedef std::function<void()> Task;
+
+    /// \brief Run \a tasks on the pool and wait for completion.
+    static void run(const std::vector<Task>& tasks);
+
+    /// \brief Return the configured number of worker threads.
+    static unsigned num_threads();
+};
+
+} // namespace cali
+
+#endif // CALI_FLUSHEXECUTOR_H
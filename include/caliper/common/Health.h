@@ -0,0 +1,86 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @file Health.h
+/// Health class declaration
+
+#ifndef CALI_HEALTH_H
+#define CALI_HEALTH_H
+
+#include <cstddef>
+#include <iostream>
+
+namespace cali
+{
+
+/// \brief Global drop and failure accounting.
+///
+/// Counts the records Caliper loses at runtime: snapshots dropped by
+/// full trace buffers, full aggregation tables, or full send queues;
+/// record bytes discarded; and metadata node allocation failures.
+/// Components report losses with inc() at their drop sites. The
+/// counters are plain relaxed atomics -- wait-free, signal safe, and
+/// cheap enough to always run. They are queryable through the
+/// cali_get_health() C API and appended to the output metadata at
+/// flush, so incomplete profiles are detectable from the data itself
+/// instead of being discovered days later.
+
+class Health
+{
+public:
+
+    enum Counter {
+        DroppedSnapshots = 0, ///< Snapshots discarded (full buffers, tables, or queues)
+        DroppedBytes     = 1, ///< Encoded record bytes discarded
+        FailedNodeAllocs = 2, ///< Metadata node or node data allocation failures
+
+        NumCounters      = 3
+    };
+
+    /// \brief Add \a n to counter \a c. Wait-free and signal safe.
+    static void inc(Counter c, std::size_t n = 1);
+
+    /// \brief Return the current value of counter \a c
+    static std::size_t count(Counter c);
+
+    /// \brief Return the name of counter \a c (e.g. "dropped.snapshots")
+    static const char* counter_name(Counter c);
+
+    /// \brief Is any counter nonzero?
+    static bool any();
+
+    static std::ostream& print_statistics(std::ostream& os);
+};
+
+} // namespace cali
+
+#endif // CALI_HEALTH_H
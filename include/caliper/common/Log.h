@@ -38,17 +38,25 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 namespace cali
 {
 
 class Log
 {
-    std::ofstream m_nullstream;
+    std::ofstream      m_nullstream;
+    std::ostringstream m_sstream;
+
     unsigned      m_level;
+    bool          m_enqueue { false };
 
     std::ostream& get_stream();
 
+    // async mode: staged into a queue drained by the logger thread
+    static bool   is_async();
+    void          push_record();
+
 public:
 
     static unsigned verbosity();
@@ -59,12 +67,22 @@ public:
         if (verbosity() < m_level)
             return m_nullstream;
 
+        if (is_async()) {
+            m_enqueue = true;
+            return m_sstream;
+        }
+
         return get_stream();
     }
 
     Log(unsigned level = 1)
         : m_level { level }
         { }
+
+    inline ~Log() {
+        if (m_enqueue)
+            push_record();
+    }
 };
 
 } // namespace cali
@@ -0,0 +1,94 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @file MemoryBudget.h
+/// MemoryBudget class declaration
+
+#ifndef CALI_MEMORYBUDGET_H
+#define CALI_MEMORYBUDGET_H
+
+#include <cstddef>
+#include <iostream>
+
+namespace cali
+{
+
+/// \brief Global memory accounting and budget.
+///
+/// Tracks the memory reserved by Caliper's large in-process consumers
+/// (the metadata pool, trace buffers, and aggregation databases) and
+/// compares the total against a configurable budget
+/// (CALI_MEMBUDGET_TOTAL). Components register their reservations
+/// with add()/sub(), and check over_watermark()/exceeded() at their
+/// growth points to degrade gracefully (flush early, stop recording,
+/// stop adding aggregation keys) rather than growing until the job is
+/// OOM-killed. With no budget set, only the accounting is active.
+
+class MemoryBudget
+{
+public:
+
+    enum Component {
+        Metadata  = 0, ///< Metadata pool chunks (MemoryPool)
+        Trace     = 1, ///< Trace buffer chunks (trace service)
+        Aggregate = 2, ///< Aggregation database blocks (aggregate service)
+
+        NumComponents = 3
+    };
+
+    /// \brief Register \a bytes reserved by component \a c
+    static void add(Component c, std::size_t bytes);
+
+    /// \brief Register \a bytes released by component \a c
+    static void sub(Component c, std::size_t bytes);
+
+    /// \brief Return the bytes currently registered for component \a c
+    static std::size_t usage(Component c);
+
+    /// \brief Return the bytes currently registered across all components
+    static std::size_t total_usage();
+
+    /// \brief Return the configured total budget in bytes. 0: no budget set.
+    static std::size_t budget();
+
+    /// \brief Is a budget set and total usage over the soft watermark?
+    static bool over_watermark();
+
+    /// \brief Is a budget set and total usage over the budget?
+    static bool exceeded();
+
+    static std::ostream& print_statistics(std::ostream& os);
+};
+
+} // namespace cali
+
+#endif // CALI_MEMORYBUDGET_H
@@ -45,20 +45,33 @@
 #include "RecordMap.h"
 #include "Variant.h"
 
-#include "util/lockfree-tree.hpp"
-
 #include <atomic>
 
-namespace cali 
+namespace cali
 {
 
 /// \brief A context tree node.
 ///
 /// Represents a context tree node and its (attribute key, value) pair.
-
-class Node : public IdType, public util::LockfreeIntrusiveTree<Node> 
+///
+/// The tree links are intrinsic members rather than a generic
+/// intrusive-tree handle: the metadata tree is the largest resident
+/// structure after trace buffers, and the slimmer layout fits a node
+/// in a single cacheline.
+///
+/// Concurrency notes: the tree is append-only; nodes are never moved
+/// or removed, so a node pointer, once observed, stays valid for the
+/// lifetime of the tree and readers need no hazard pointers or epoch
+/// reclamation. The release CAS in append() paired with the acquire
+/// load in first_child() publishes a node's data members along with
+/// the list link, so readers never observe a partially constructed
+/// node.
+
+class Node : public IdType
 {
-    util::LockfreeIntrusiveTree<Node>::Node m_treenode;
+    Node*              m_parent;
+    Node*              m_next;
+    std::atomic<Node*> m_head;
 
     cali_id_t m_attribute;
     Variant   m_data;
@@ -69,7 +82,9 @@ public:
 
     Node(cali_id_t id, cali_id_t attr, const Variant& data)
         : IdType(id),
-          util::LockfreeIntrusiveTree<Node>(this, &Node::m_treenode), 
+        m_parent    { nullptr },
+        m_next      { nullptr },
+        m_head      { nullptr },
         m_attribute { attr },
         m_data      { data }
         { }
@@ -80,6 +95,31 @@ public:
 
     ~Node();
 
+    Node* parent()       const { return m_parent; }
+
+    // acquire load: pairs with the release CAS in append() to publish
+    // the node's data members along with the list link
+    Node* first_child()  const { return m_head.load(std::memory_order_acquire); }
+
+    Node* next_sibling() const { return m_next;   }
+
+    /// \brief Append \a sub to this node's child list.
+    ///
+    /// Lock-free: CAS-appends to the head of the child list, so
+    /// concurrent insertions under the same or different parents
+    /// proceed without serialization.
+    void append(Node* sub) {
+        sub->m_parent = this;
+
+        Node* old_head = m_head.load(std::memory_order_relaxed);
+
+        do {
+            sub->m_next = old_head;
+        } while (!m_head.compare_exchange_weak(old_head, sub,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed));
+    }
+
     bool equals(cali_id_t attr, const Variant& v) const {
         return m_attribute == attr ? m_data == v : false;
     }
@@ -87,7 +127,9 @@ public:
     bool equals(cali_id_t attr, const void* data, size_t size) const;
 
     cali_id_t attribute() const { return m_attribute; }
-    Variant   data() const      { return m_data;      }    
+    // return by reference: for inline string values, data().data()
+    // must point into the node's stored variant, not a temporary
+    const Variant& data() const { return m_data;      }
     
     static const RecordDescriptor& record_descriptor() { return s_record; }
 
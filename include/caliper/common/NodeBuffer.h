@@ -44,6 +44,16 @@ public:
     void append(const NodeInfo& info);
     void append(const Node* node);
 
+    /// \brief Append \a n nodes as a bulk-encoded batch.
+    ///
+    /// Batches store nodes sorted by id with delta-encoded ids and
+    /// parent references and a shared attribute-id dictionary, which
+    /// is considerably more compact than per-node records when many
+    /// nodes are written at once (metadata exchange, recorder init).
+    /// for_each() decodes batch and per-node records transparently.
+    void append_batch(size_t n, const NodeInfo* info);
+    void append_batch(size_t n, const Node* const* nodes);
+
     size_t count() const { return m_count; }
     size_t size() const  { return m_pos;   }
     
@@ -81,6 +81,11 @@ public:
 
     static StringConverter get(const char* set, const char* key);
     static void        preset(const char* key, const std::string& value);
+
+    /// \brief Initialize a config set.
+    ///
+    /// Entries are evaluated lazily on first access; \a set must
+    /// therefore point to a list with static lifetime.
     static ConfigSet   init(const char* name, const ConfigSet::Entry* set);
 
     static void print(std::ostream& os);
@@ -1,8 +1,9 @@
 /// \file  SnapshotBuffer.h
-/// \brief SnapshotBuffer class 
+/// \brief SnapshotBuffer class
 
 #pragma once
 
+#include <cstddef>
 #include <functional>
 
 namespace cali
@@ -10,26 +11,34 @@ namespace cali
 
 class CompressedSnapshotRecord;
 class CompressedSnapshotRecordView;
-    
+
 /// \brief Serialize/deserialize a set of nodes
+///
+/// Contents are kept in a single anonymous memory mapping that is
+/// grown with mremap(): growth remaps pages instead of copying
+/// records, and the unused tail of the reservation is never touched,
+/// so it consumes no physical memory. data() is therefore always
+/// O(1). Use release() to return the buffer's pages to the OS after
+/// a flush while keeping the reservation for reuse.
 class SnapshotBuffer
 {
     size_t         m_count;
-    
     size_t         m_pos;
-    size_t         m_reserved_len;
-    
-    unsigned char* m_buffer;
 
-    unsigned char* reserve(size_t min);
-    
+    size_t         m_initial;  ///< initial reservation size
+    size_t         m_reserved; ///< current reservation size
+
+    unsigned char* m_data;
+
+    void grow(size_t need);
+
 public:
 
     SnapshotBuffer();
     SnapshotBuffer(size_t size);
-    
+
     ~SnapshotBuffer();
-    
+
     SnapshotBuffer(const SnapshotBuffer&) = delete;
     SnapshotBuffer& operator = (const SnapshotBuffer&) = delete;
 
@@ -37,14 +46,21 @@ public:
 
     size_t count() const { return m_count; }
     size_t size() const  { return m_pos;   }
-    
-    const unsigned char* data() const { return m_buffer; }
+
+    const unsigned char* data() const { return m_data; }
 
     /// \brief Expose buffer for read from external source (e.g., MPI),
     /// and set count and size.
     unsigned char* import(size_t size, size_t count);
 
-    /// \brief Run function \a fn on each snapshot  
+    /// \brief Drop the contents and return the buffer's pages to the
+    /// OS (madvise MADV_DONTNEED).
+    ///
+    /// The reservation stays in place, so subsequent appends reuse the
+    /// mapping. Call after flushing run-sized staging buffers.
+    void release();
+
+    /// \brief Run function \a fn on each snapshot
     void for_each(std::function<void(const CompressedSnapshotRecordView&)> fn) const;
 };
 
@@ -50,8 +50,9 @@ namespace cali
     /// most of the data type-specific functionality. It is a thin wrapper
     /// around the `cali_variant_t` C data type.
     ///
-    /// NOTE: This class does *not* do any sort of memory management:
-    /// strings and "blobs" are stored as unmanaged pointers. Users need
+    /// NOTE: Strings and "blobs" of up to CALI_VARIANT_INLINE_MAX bytes
+    /// are copied into the variant's inline storage; the variant owns the
+    /// copy. Larger values are stored as unmanaged pointers: users need
     /// to make sure these pointers are valid while any variant
     /// encapsulating them is being used.
     
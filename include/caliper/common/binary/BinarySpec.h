@@ -0,0 +1,99 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file BinarySpec.h
+/// \brief Constants of the binary .cali file format
+
+#pragma once
+
+#include <cstddef>
+
+namespace cali
+{
+
+namespace binary
+{
+
+// The binary .cali format is an 8-byte magic header followed by a
+// sequence of blocks. Each block is
+//
+//   [ 1 byte block type | varint payload length | varint record count | payload ]
+//
+// Node block payload holds NodeBuffer-encoded node records.
+// Snapshot block payload holds snapshot records of the form
+//
+//   varint num_nodes, num_nodes * varint node id,
+//   varint num_imm,   num_imm * (varint attr id, varint type, varint size, data)
+//
+// Dictionary snapshot block payload starts with a table mapping the
+// block's dense local node ids to global node ids,
+//
+//   varint dict size, dict size * varint global node id
+//
+// followed by snapshot records as above, except that node references
+// are local ids (indices into the table). Since a block rarely
+// touches more than a few dozen distinct nodes, local references are
+// one-byte varints regardless of the global id range. The record
+// count does not include the table.
+//
+// Trace block payload holds a trace buffer chunk verbatim (the
+// zero-copy flush path): a sequence of shape-dictionary records,
+// where a record starting with varint tag 0 defines a snapshot shape
+//
+//   varint num_nodes, varint num_imm,
+//   num_nodes * varint node id, num_imm * varint (2*attr id + d)
+//
+// where d is 1 if the entry's values are delta-encoded (monotonic
+// uint attributes) and 0 otherwise. A record starting with varint
+// tag t > 0 is a snapshot with the shape of the t-th preceding shape
+// definition, followed by num_imm immediate values: a varint delta
+// to the attribute's previous value in the block for delta-encoded
+// entries, a packed Variant otherwise. The record count covers both
+// shape definitions and snapshots.
+//
+// Pad block payload is undefined and skipped by readers. Writers in
+// direct-I/O mode insert pad blocks so that the following block
+// starts on an I/O block boundary.
+
+const char          spec_magic[8]       = { 'c', 'a', 'l', 'i', 'b', 'i', 'n', '\1' };
+
+const unsigned char spec_node_block      = 0x01;
+const unsigned char spec_snapshot_block  = 0x02;
+const unsigned char spec_trace_block     = 0x03;
+const unsigned char spec_pad_block       = 0x04;
+const unsigned char spec_snapshotd_block = 0x05;
+
+const std::size_t   spec_blocksize      = 64 * 1024;
+
+} // namespace binary
+
+} // namespace cali
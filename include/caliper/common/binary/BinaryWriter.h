@@ -0,0 +1,94 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file BinaryWriter.h
+/// \brief BinaryWriter declaration
+
+#pragma once
+
+#include "../Entry.h"
+
+#include <iostream>
+#include <memory>
+
+namespace cali
+{
+
+class CaliperMetadataAccessInterface;
+
+/// \brief Write metadata nodes and snapshot records in the binary
+///   .cali representation.
+///
+/// The binary format consists of an 8-byte magic header followed by
+/// length-prefixed blocks of varint-packed node and snapshot records.
+/// Records are buffered and written out block-wise; call flush() to
+/// write out incomplete blocks.
+class BinaryWriter
+{
+    struct BinaryWriterImpl;
+    std::shared_ptr<BinaryWriterImpl> mP;
+
+public:
+
+    BinaryWriter()
+    { }
+
+    BinaryWriter(std::ostream& os);
+
+    ~BinaryWriter();
+
+    size_t num_written() const;
+
+    /// \brief Align the start of each record block to \a align bytes.
+    ///
+    /// Inserts pad blocks so that block writes fall on I/O block
+    /// boundaries; used with direct-I/O output streams. Set before
+    /// writing any records. 0 (the default) disables alignment.
+    void set_block_alignment(size_t align);
+
+    void write_snapshot(const CaliperMetadataAccessInterface& db,
+                        size_t n_nodes, const cali_id_t nodes[],
+                        size_t n_imm,   const cali_id_t attr[], const Variant vals[]);
+
+    /// \brief Write a pre-encoded record block of the given type verbatim.
+    ///
+    /// The payload is written unmodified (zero-copy flush path); only
+    /// the shape definition records are scanned for referenced node
+    /// ids so the metadata they need precedes the block.
+    void write_trace_block(const CaliperMetadataAccessInterface& db,
+                           size_t n_rec, const unsigned char* data, size_t len);
+
+    /// \brief Write out any buffered blocks
+    void flush();
+};
+
+} // namespace cali
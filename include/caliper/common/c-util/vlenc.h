@@ -67,6 +67,12 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define VLENC_HAVE_SSE2
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -122,6 +128,183 @@ vldec_u64(const unsigned char* buf, size_t* inc)
     return val;
 }
 
+/*! \brief Branchless variant of vlenc_u64() for slack-checked buffers.
+ *
+ * Writes the encoded value with a fixed-count store loop instead of a
+ * branch per byte: 10 bytes are always stored, and the encoded length
+ * is determined up front from the value's bit width. The encoding is
+ * byte-identical to vlenc_u64().
+ *
+ * \param  val  64-bit unsigned integer value to be written.
+ * \param  buf  Character buffer. Must have 10 bytes of slack: all 10
+ *              bytes are written regardless of the encoded length.
+ * \return      Number of bytes used by the encoded value.
+ */
+inline size_t
+vlenc_u64_fast(uint64_t val, unsigned char* buf)
+{
+#if defined(__GNUC__)
+    size_t bits   = 64 - (size_t) __builtin_clzll(val | 1);
+    size_t nbytes = (bits + 6) / 7;
+    size_t k;
+
+    for (k = 0; k < 10; ++k)
+        buf[k] = (unsigned char) ((val >> (7*k)) | 0x80);
+
+    buf[nbytes-1] &= 0x7F;
+
+    return nbytes;
+#else
+    return vlenc_u64(val, buf);
+#endif
+}
+
+/*! \brief Branchless variant of vldec_u64() for slack-checked buffers.
+ *
+ * Loads eight bytes at once and finds the encoded length from the
+ * position of the first cleared continuation bit (count-trailing-zeros)
+ * instead of testing a branch per byte. Values longer than eight bytes
+ * fall back to the scalar decoder.
+ *
+ * \param  buf  Buffer to read from. Must have at least 10 readable bytes.
+ * \param  inc  The function increments this value by the number of bytes read.
+ * \return      The decoded value.
+ */
+inline uint64_t
+vldec_u64_fast(const unsigned char* buf, size_t* inc)
+{
+#if defined(__GNUC__)
+    uint64_t x;
+    uint64_t stops;
+    uint64_t lowbit;
+
+    memcpy(&x, buf, 8);
+
+    /* bit set at each byte with a cleared continuation bit */
+    stops = ~x & UINT64_C(0x8080808080808080);
+
+    if (stops == 0) /* value longer than 8 bytes: rare, take the byte loop */
+        return vldec_u64(buf, inc);
+
+    /* keep the stop byte and everything below it */
+    lowbit = stops & (~stops + 1);
+    x     &= (lowbit << 1) - 1;
+
+    /* compact the 7-bit groups */
+    x &= UINT64_C(0x7F7F7F7F7F7F7F7F);
+    x  = (x & UINT64_C(0x007F007F007F007F)) | ((x & UINT64_C(0x7F007F007F007F00)) >> 1);
+    x  = (x & UINT64_C(0x00003FFF00003FFF)) | ((x & UINT64_C(0x3FFF00003FFF0000)) >> 2);
+    x  = (x & UINT64_C(0x000000000FFFFFFF)) | ((x & UINT64_C(0x0FFFFFFF00000000)) >> 4);
+
+    if (inc)
+        *inc += ((size_t) __builtin_ctzll(stops) >> 3) + 1;
+
+    return x;
+#else
+    return vldec_u64(buf, inc);
+#endif
+}
+
+/*! \brief Encode an array of 64-bit values into \a buf.
+ *
+ * Bulk version of vlenc_u64() with a group fast path: runs of eight
+ * values below 128 are stored as eight plain bytes without the
+ * per-value encoding loop. The output is byte-identical to encoding
+ * each value individually with vlenc_u64().
+ *
+ * \param  vals Values to be written.
+ * \param  n    Number of values.
+ * \param  buf  Character buffer. Must hold 10*n bytes in the worst case.
+ * \return      Number of bytes written.
+ */
+inline size_t
+vlenc_u64_arr(const uint64_t* vals, size_t n, unsigned char* buf)
+{
+    size_t pos = 0;
+    size_t i   = 0;
+
+    while (i < n) {
+        if (i + 8 <= n) {
+            uint64_t m = vals[i]   | vals[i+1] | vals[i+2] | vals[i+3]
+                       | vals[i+4] | vals[i+5] | vals[i+6] | vals[i+7];
+
+            if (m <= 0x7F) {
+                size_t j;
+
+                for (j = 0; j < 8; ++j)
+                    buf[pos+j] = (unsigned char) vals[i+j];
+
+                pos += 8;
+                i   += 8;
+
+                continue;
+            }
+        }
+
+        /* the 10*n buffer requirement guarantees the slack for the
+           unconditional 10-byte store */
+        pos += vlenc_u64_fast(vals[i++], buf+pos);
+    }
+
+    return pos;
+}
+
+/*! \brief Decode an array of 64-bit values from \a buf.
+ *
+ * Bulk version of vldec_u64(). Where SSE2 is available, 16-byte blocks
+ * are scanned at once for varint continuation bits so that runs of
+ * single-byte values decode without the per-byte loop. Vector loads
+ * never read past \a avail bytes; the remainder falls back to the
+ * scalar decoder.
+ *
+ * \param  vals  Decoded values are written here.
+ * \param  buf   Buffer to read from.
+ * \param  avail Number of valid bytes in \a buf.
+ * \param  n     Number of values to read.
+ * \return       Number of bytes read.
+ */
+inline size_t
+vldec_u64_arr(const unsigned char* buf, size_t avail, size_t n, uint64_t* vals)
+{
+    size_t pos = 0;
+    size_t i   = 0;
+
+#ifdef VLENC_HAVE_SSE2
+    while (i < n && pos + 16 <= avail) {
+        __m128i  v    = _mm_loadu_si128((const __m128i*) (buf+pos));
+        unsigned mask = (unsigned) _mm_movemask_epi8(v);
+
+        /* bit k set in mask <=> byte k is a continuation byte:
+           the number of trailing zeros is the length of the run of
+           single-byte values at the front of the block */
+
+        size_t   run  = (mask == 0 ? 16 : (size_t) __builtin_ctz(mask));
+        size_t   blk  = (n - i) < run ? (n - i) : run;
+        size_t   j;
+
+        for (j = 0; j < blk; ++j)
+            vals[i+j] = buf[pos+j];
+
+        pos += blk;
+        i   += blk;
+
+        if (mask != 0 && i < n && blk == run)
+            vals[i++] = vldec_u64(buf+pos, &pos);
+    }
+#endif
+
+    /* branchless decode while enough readable bytes remain, byte loop
+       for the buffer tail */
+
+    for ( ; i < n && pos + 10 <= avail; ++i)
+        vals[i] = vldec_u64_fast(buf+pos, &pos);
+
+    for ( ; i < n; ++i)
+        vals[i] = vldec_u64(buf+pos, &pos);
+
+    return pos;
+}
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
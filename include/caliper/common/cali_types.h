@@ -120,7 +120,16 @@ typedef enum {
    * partially overlap function calls or other NESTED attribute
    * regions.
    */
-  CALI_ATTR_NESTED        = 256
+  CALI_ATTR_NESTED        = 256,
+
+  /** \brief Values for this attribute are monotonically increasing.
+   *
+   * Indicates that successive values set for this attribute on a
+   * thread never decrease (e.g., timestamps or event counters).
+   * Allows services to delta-encode the values. Only applicable to
+   * unsigned integer attributes.
+   */
+  CALI_ATTR_MONOTONIC     = 512
 } cali_attr_properties;
 
 #define CALI_ATTR_SCOPE_MASK 60
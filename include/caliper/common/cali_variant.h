@@ -47,16 +47,23 @@ extern "C" {
 #include <stdbool.h>
 #include <stddef.h>
 
-/** The variant struct manages values of different types in Caliper.    
+/** Maximum size of variable-length values (strings and blobs) that are
+ *  stored inside the variant itself.
+ */
+#define CALI_VARIANT_INLINE_MAX 15
+
+/** The variant struct manages values of different types in Caliper.
  *  Types with fixed size (i.e., numeric types) are stored in the variant directly.
- *  Variable-length types (strings and blobs) are stored as unmanaged pointers. 
- */    
+ *  Variable-length types (strings and blobs) of up to CALI_VARIANT_INLINE_MAX
+ *  bytes are copied into the variant's inline storage; larger values are
+ *  stored as unmanaged pointers.
+ */
 typedef struct {
     /** Least significant bytes encode the type.
      *  Remaining bytes encode the size of variable-length types (strings and blobs (usr)).
      */
     uint64_t type_and_size;
-    
+
     /** Value in various type representations
      */
     union {
@@ -66,6 +73,7 @@ typedef struct {
         uint64_t       v_uint;
         cali_attr_type v_type;
         const void*    unmanaged_ptr;
+        char           v_inline[CALI_VARIANT_INLINE_MAX+1];
     }        value;
 } cali_variant_t;
 
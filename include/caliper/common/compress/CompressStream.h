@@ -0,0 +1,99 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file CompressStream.h
+/// \brief CompressStream and DecompressStream declarations
+
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace cali
+{
+
+/// \brief Block-compressing output stream wrapper.
+///
+/// Wraps an underlying output stream in a block-based deflate
+/// compression stage. Data written to stream() is buffered and
+/// compressed one block at a time; see CompressSpec.h for the
+/// container layout.
+class CompressStream
+{
+    struct CompressStreamImpl;
+    std::shared_ptr<CompressStreamImpl> mP;
+
+public:
+
+    CompressStream()
+    { }
+
+    CompressStream(std::ostream& os, int level);
+
+    ~CompressStream();
+
+    std::ostream& stream();
+
+    /// \brief Compress and write out any buffered data.
+    void flush();
+};
+
+/// \brief Decompressing input stream wrapper for compressed .cali files.
+///
+/// Blocks in the container are compressed independently and are
+/// decompressed on a pool of worker threads, pipelined with the
+/// consumer through a bounded queue, so decompression overlaps with
+/// parsing and aggregation and scales with cores.
+class DecompressStream
+{
+    struct DecompressStreamImpl;
+    std::shared_ptr<DecompressStreamImpl> mP;
+
+public:
+
+    /// \brief Open \a filename for decompression.
+    ///
+    /// \param n_threads Number of decompression threads. 0 (default)
+    ///    selects a thread count based on the available cores; 1
+    ///    decompresses inline in the consuming thread.
+    DecompressStream(const std::string& filename, unsigned n_threads = 0);
+
+    ~DecompressStream();
+
+    std::istream& stream();
+
+    /// \brief Check whether \a filename starts with the compressed stream magic
+    static bool is_compressed_file(const std::string& filename);
+};
+
+} // namespace cali
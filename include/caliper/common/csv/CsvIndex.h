@@ -0,0 +1,138 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @file CsvIndex.h
+/// Footer index definitions for csv-format .cali files
+///
+/// An indexed .cali file appends an optional footer after the record
+/// stream:
+///
+///     __rec=idx,offset=...,len=...,nrec=...,bloom=<hex>[,tmin=...,tmax=...]
+///     ...
+///     __rec=ftr,idx=<offset of first idx record>,nblocks=...
+///
+/// Each idx record describes a block: a contiguous run of snapshot
+/// (ctx) records, given as byte offset and length. Blocks never
+/// contain node records, so a reader may skip a block wholesale
+/// without losing metadata. The bloom field is a bloom filter over
+/// the names of all attributes occurring in the block (including
+/// attributes of node entry ancestors); tmin/tmax give the block's
+/// time.offset range when present. The ftr record is the last line
+/// of the file and points to the index section.
+///
+/// Readers that do not know the footer see ordinary records with
+/// unknown __rec types and ignore them, so indexed files remain
+/// readable by older tools.
+
+#ifndef CALI_CSVINDEX_H
+#define CALI_CSVINDEX_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace cali
+{
+
+namespace csvindex
+{
+
+/// Number of snapshot records per index block
+const std::size_t block_size  = 1024;
+
+/// Size of the per-block attribute bloom filter (256 bits)
+const std::size_t bloom_words = 4;
+
+inline uint64_t bloom_hash(const char* str, std::size_t len) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+
+    for (std::size_t i = 0; i < len; ++i) {
+        h ^= static_cast<unsigned char>(str[i]);
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+inline void bloom_add(uint64_t bloom[bloom_words], const char* str, std::size_t len) {
+    uint64_t h  = bloom_hash(str, len);
+
+    unsigned b1 = static_cast<unsigned>(h       & 255);
+    unsigned b2 = static_cast<unsigned>((h>>32) & 255);
+
+    bloom[b1 / 64] |= (1ULL << (b1 % 64));
+    bloom[b2 / 64] |= (1ULL << (b2 % 64));
+}
+
+inline bool bloom_test(const uint64_t bloom[bloom_words], const char* str, std::size_t len) {
+    uint64_t h  = bloom_hash(str, len);
+
+    unsigned b1 = static_cast<unsigned>(h       & 255);
+    unsigned b2 = static_cast<unsigned>((h>>32) & 255);
+
+    return (bloom[b1 / 64] & (1ULL << (b1 % 64)))
+        && (bloom[b2 / 64] & (1ULL << (b2 % 64)));
+}
+
+inline std::string bloom_to_hex(const uint64_t bloom[bloom_words]) {
+    char buf[bloom_words * 16 + 1];
+
+    for (std::size_t i = 0; i < bloom_words; ++i)
+        snprintf(buf + 16*i, 17, "%016llx", static_cast<unsigned long long>(bloom[i]));
+
+    return std::string(buf, bloom_words * 16);
+}
+
+inline bool bloom_from_hex(const std::string& str, uint64_t bloom[bloom_words]) {
+    if (str.size() != bloom_words * 16)
+        return false;
+
+    for (std::size_t i = 0; i < bloom_words; ++i) {
+        char buf[17];
+
+        memcpy(buf, str.data() + 16*i, 16);
+        buf[16] = '\0';
+
+        bloom[i] = strtoull(buf, nullptr, 16);
+    }
+
+    return true;
+}
+
+} // namespace csvindex
+
+} // namespace cali
+
+#endif // CALI_CSVINDEX_H
@@ -58,7 +58,16 @@ public:
 
     ~CsvReader();
 
-    bool read(std::function<void(const RecordMap&)>);
+    bool read(std::function<void(const RecordMap&)> rec_handler);
+
+    /// \brief Read records, skipping index blocks rejected by \a block_filter.
+    ///
+    /// If the file carries a footer index (see CsvIndex.h), \a block_filter
+    /// is invoked with each block's idx record; blocks for which it returns
+    /// false are skipped. Unindexed, compressed, and non-seekable inputs
+    /// are read in full.
+    bool read(std::function<void(const RecordMap&)> rec_handler,
+              std::function<bool(const RecordMap&)> block_filter);
 };
 
 } // namespace cali
@@ -56,6 +56,14 @@ public:
     static void      write_record(std::ostream& os, const RecordDescriptor& record, const int* data_count, const Variant** data);
     static void      write_record(std::ostream& os, const RecordMap& record);
     static RecordMap read_record(const std::string& line);
+    static RecordMap read_record(const char* begin, const char* end);
+
+    /// \brief Streamable FNV-1a checksum over \a len bytes.
+    ///
+    /// Used for the block checksums in __rec=sync marker records;
+    /// pass a previous result as \a seed to checksum incrementally.
+    static uint64_t  checksum(const char* data, std::size_t len,
+                              uint64_t seed = 14695981039346656037ull);
 };
 
 } // namespace cali
@@ -56,19 +56,39 @@ public:
 
     CsvWriter()
     { }
-    
-    CsvWriter(std::ostream& os);
+
+    CsvWriter(std::ostream& os, bool write_index = false);
 
     ~CsvWriter();
 
     size_t num_written() const;
-    
+
+    /// \brief Append periodic __rec=sync marker records with block
+    ///   checksums and flush the stream at each marker.
+    ///
+    /// Markers let readers verify block integrity and recover the
+    /// complete blocks of a file truncated by a crashed job. Set
+    /// before writing any records.
+    void set_sync_markers(bool enable);
+
+    /// \brief Append the footer index (see CsvIndex.h) to the stream.
+    ///
+    /// No-op unless index writing was enabled in the constructor.
+    /// Must be called after the last record has been written.
+    void write_index();
+
     void write_snapshot(const CaliperMetadataAccessInterface& db,
                         size_t n_nodes, const cali_id_t nodes[],
                         size_t n_imm,   const cali_id_t attr[], const Variant vals[]);
 
     void operator()(const CaliperMetadataAccessInterface&, const Node*);
     void operator()(const CaliperMetadataAccessInterface&, const std::vector<Entry>&);
+
+    /// \brief Write out any buffered records.
+    ///
+    /// Records accumulate in node and snapshot buffers and are written
+    /// out chunk-wise; the destructor flushes remaining buffers.
+    void flush();
 };
 
 }
@@ -4,39 +4,136 @@
 #ifndef UTIL_CALLBACK_HPP
 #define UTIL_CALLBACK_HPP
 
-#include <functional>
-#include <vector>
+#include "../Log.h"
+
+#include <cstdint>
 
 namespace util
 {
 
+/// \brief Flat-array callback dispatch table.
+///
+/// Connected callbacks are raw function pointers in a flat array, so
+/// dispatching an event is one direct indirect call per connected
+/// service, with no type-erasure or heap indirection on the hot
+/// path. Capture-less lambdas convert to function pointers and can
+/// be connected as well.
+///
+/// The table starts with a fixed inline block that covers typical
+/// service configurations and grows on demand, so a connect() never
+/// drops a subscriber. Growth only ever happens at connect time
+/// (service registration), never on the dispatch path.
+///
+/// Each slot carries a 64-bit interest mask (all-ones by default).
+/// invoke_matching() dispatches an event along with an update mask,
+/// and skips slots whose interest mask does not intersect it. This
+/// lets subscribers opt out of events they would ignore (e.g.,
+/// snapshot callbacks that only act on specific trigger attributes)
+/// without a per-invocation check in the callback itself.
 template<class F>
 class callback
 {
-    std::vector< std::function<F> > mCb;
+    static const int INLINE_SLOTS = 32;
+
+    F*        mInlineCb[INLINE_SLOTS];
+    uint64_t  mInlineInterest[INLINE_SLOTS];
+
+    F**       mCb;
+    uint64_t* mInterest;
+
+    int       mCount;
+    int       mCapacity;
+
+    void grow() {
+        int       capacity = 2 * mCapacity;
+        F**       cb       = new F*[capacity];
+        uint64_t* interest = new uint64_t[capacity];
+
+        for (int i = 0; i < mCount; ++i) {
+            cb[i]       = mCb[i];
+            interest[i] = mInterest[i];
+        }
+
+        if (mCb != mInlineCb) {
+            delete[] mCb;
+            delete[] mInterest;
+        }
+
+        mCb       = cb;
+        mInterest = interest;
+        mCapacity = capacity;
+
+        cali::Log(2).stream() << "callback: growing dispatch table to "
+                              << capacity << " slots" << std::endl;
+    }
 
 public:
 
-    void connect(std::function<F> f) {
-        mCb.push_back(f);
-    } 
+    callback()
+        : mCb(mInlineCb),
+          mInterest(mInlineInterest),
+          mCount(0),
+          mCapacity(INLINE_SLOTS)
+        {
+            for (int i = 0; i < INLINE_SLOTS; ++i) {
+                mInlineCb[i]       = nullptr;
+                mInlineInterest[i] = ~static_cast<uint64_t>(0);
+            }
+        }
+
+    ~callback() {
+        if (mCb != mInlineCb) {
+            delete[] mCb;
+            delete[] mInterest;
+        }
+    }
+
+    callback(const callback&) = delete;
+    callback& operator=(const callback&) = delete;
+
+    void connect(F* fn) {
+        connect(fn, ~static_cast<uint64_t>(0));
+    }
+
+    void connect(F* fn, uint64_t interest) {
+        if (!fn)
+            return;
+
+        if (mCount >= mCapacity)
+            grow();
+
+        mCb[mCount]       = fn;
+        mInterest[mCount] = interest;
+
+        ++mCount;
+    }
+
+    /// \brief Update the interest mask of the already-connected
+    /// callback \a fn, e.g. once the attribute ids it cares about
+    /// are known.
+    void set_interest(F* fn, uint64_t interest) {
+        for (int i = 0; i < mCount; ++i)
+            if (mCb[i] == fn)
+                mInterest[i] = interest;
+    }
 
     bool empty() const {
-        return mCb.empty();
+        return mCount == 0;
     }
 
     template<class... Args>
     void operator()(Args... a) {
-        for ( auto& f : mCb )
-            f(a...);
+        for (int i = 0; i < mCount; ++i)
+            mCb[i](a...);
     }
 
-    template<class Op, class R, class... Args>
-    R accumulate(Op op, R init, Args... a) {
-        for ( auto& f : mCb )
-            init = Op(init, f(a...));
-
-        return init;
+    /// \brief Invoke only the callbacks whose interest mask
+    /// intersects \a update.
+    template<class... Args>
+    void invoke_matching(uint64_t update, Args... a) {
+        for (int i = 0; i < mCount; ++i)
+            if (mInterest[i] & update)
+                mCb[i](a...);
     }
 };
 
@@ -0,0 +1,81 @@
+/// \file  hugealloc.hpp
+/// \brief Page-granular region allocation with optional hugepage backing
+
+#ifndef UTIL_HUGEALLOC_HPP
+#define UTIL_HUGEALLOC_HPP
+
+#include <cstddef>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace util
+{
+
+const std::size_t hugepage_bytes = 2 * 1024 * 1024;
+
+/// \brief Round \a bytes up to the region granularity.
+///
+/// With \a hugepages, regions are allocated in 2MB hugepage multiples.
+inline std::size_t region_size(std::size_t bytes, bool hugepages)
+{
+    if (hugepages)
+        bytes = (bytes + hugepage_bytes - 1) & ~(hugepage_bytes - 1);
+
+    return bytes;
+}
+
+/// \brief Allocate a zero-initialized, lazily mapped memory region.
+///
+/// \a bytes must be a region_size() result. Pages are not touched, so
+/// first-touch NUMA placement applies. With \a hugepages, the region
+/// is 2MB-aligned and marked for transparent hugepage backing.
+inline void* alloc_region(std::size_t bytes, bool hugepages)
+{
+#ifdef __linux__
+    std::size_t len = bytes + (hugepages ? hugepage_bytes : 0);
+
+    char* p = static_cast<char*>(
+        mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+
+    if (p == MAP_FAILED)
+        throw std::bad_alloc();
+
+    if (hugepages) {
+        // trim the overmap to a 2MB-aligned region
+        std::size_t head =
+            (hugepage_bytes - reinterpret_cast<std::size_t>(p) % hugepage_bytes) % hugepage_bytes;
+
+        if (head > 0)
+            munmap(p, head);
+        if (head < hugepage_bytes)
+            munmap(p + head + bytes, hugepage_bytes - head);
+
+        p += head;
+
+#ifdef MADV_HUGEPAGE
+        madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    }
+
+    return p;
+#else
+    return ::operator new(bytes);
+#endif
+}
+
+/// \brief Release a region obtained from alloc_region().
+inline void free_region(void* ptr, std::size_t bytes)
+{
+#ifdef __linux__
+    munmap(ptr, bytes);
+#else
+    ::operator delete(ptr);
+#endif
+}
+
+} // namespace util
+
+#endif
@@ -40,6 +40,16 @@ namespace util
 /// restrictions on the operations that can be
 /// performed. Specifically, tree nodes can only be added, but not
 /// moved or removed.
+///
+/// Concurrency notes: insertion CAS-appends to the head of the
+/// parent's child list, so concurrent insertions under the same or
+/// different parents proceed without serialization. Because nodes are
+/// never moved or removed, readers traversing the child list need no
+/// hazard pointers or epoch reclamation: a node pointer, once
+/// observed, stays valid for the lifetime of the tree. The release
+/// CAS in append() paired with the acquire load in first_child()
+/// publishes the host structure's data members along with the link,
+/// so readers never observe a partially constructed host.
    
 template<typename T> 
 class LockfreeIntrusiveTree {
@@ -76,7 +86,11 @@ public:
     { }
 
     T* parent()       const { return node(m_me).parent;     }
-    T* first_child()  const { return node(m_me).head.load(std::memory_order_relaxed); }
+
+    // acquire load: pairs with the release CAS in append() to publish
+    // the host object's data members along with the list link
+    T* first_child()  const { return node(m_me).head.load(std::memory_order_acquire); }
+
     T* next_sibling() const { return node(m_me).next;       }
 
     void append(T* sub) {
@@ -0,0 +1,28 @@
+/// @file prefetch.hpp
+/// @brief Software prefetch hint
+
+#ifndef UTIL_PREFETCH_HPP
+#define UTIL_PREFETCH_HPP
+
+namespace util
+{
+
+/// \brief Prefetch the cache line at \a p for reading.
+///
+/// Use in pointer-chasing loops (sibling scans, parent-chain walks)
+/// to fetch the next node while the current one is processed: the
+/// link pointer lives in the current node's cache line, so issuing
+/// the prefetch hides the dependent-load miss on the next node.
+/// A null pointer is allowed and ignored by the hardware.
+inline void prefetch(const void* p)
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(p, 0);
+#else
+    (void) p;
+#endif
+}
+
+}
+
+#endif
@@ -5,27 +5,64 @@
 #define UTIL_SPINLOCK_HPP
 
 #include <atomic>
+#include <thread>
 
 namespace util
 {
-    
+
+/// \brief Test-and-test-and-set spinlock with exponential backoff.
+///
+/// Waiters spin read-only on their cached copy of the lock word and
+/// back off exponentially between acquisition attempts, so contended
+/// locks do not ping-pong the lock cacheline between all waiters.
+/// Long waits yield the processor.
 class spinlock {
-    std::atomic_flag m_lock;
+    std::atomic<int> m_lock;
+
+    static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield" ::: "memory");
+#else
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+    }
 
 public:
 
     spinlock()
-        {
-            m_lock.clear();
-        }
+        : m_lock(0)
+        { }
 
     void lock() {
-        while (m_lock.test_and_set(std::memory_order_acquire))
-            ;
+        // uncontended fast path
+
+        if (!m_lock.exchange(1, std::memory_order_acquire))
+            return;
+
+        int spins = 1;
+
+        for (;;) {
+            // wait read-only until the lock looks free
+
+            while (m_lock.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < spins; ++i)
+                    cpu_relax();
+
+                if (spins < 1024)
+                    spins *= 2;
+                else
+                    std::this_thread::yield();
+            }
+
+            if (!m_lock.exchange(1, std::memory_order_acquire))
+                return;
+        }
     }
 
     void unlock() {
-        m_lock.clear(std::memory_order_release);
+        m_lock.store(0, std::memory_order_release);
     }
 };
 
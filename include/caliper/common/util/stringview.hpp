@@ -0,0 +1,86 @@
+/// @file  stringview.hpp
+/// @brief Non-owning string reference and non-allocating split
+
+#ifndef UTIL_STRINGVIEW_HPP
+#define UTIL_STRINGVIEW_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace util
+{
+
+/// \brief A non-owning reference to a character range.
+///
+/// Minimal stand-in for C++17 std::string_view: allows splitting and
+/// comparing pieces of configuration or spec strings without copying
+/// each piece into a std::string. The referenced characters must
+/// outlive the view.
+class stringview
+{
+    const char* m_ptr;
+    std::size_t m_size;
+
+public:
+
+    stringview()
+        : m_ptr(nullptr), m_size(0)
+    { }
+
+    stringview(const char* ptr, std::size_t size)
+        : m_ptr(ptr), m_size(size)
+    { }
+
+    stringview(const char* str)
+        : m_ptr(str), m_size(str ? strlen(str) : 0)
+    { }
+
+    stringview(const std::string& str)
+        : m_ptr(str.data()), m_size(str.size())
+    { }
+
+    const char* data()  const { return m_ptr;  }
+    std::size_t size()  const { return m_size; }
+    bool        empty() const { return m_size == 0; }
+
+    const char* begin() const { return m_ptr;          }
+    const char* end()   const { return m_ptr + m_size; }
+
+    char operator[](std::size_t i) const { return m_ptr[i]; }
+
+    std::string to_string() const { return std::string(m_ptr, m_size); }
+};
+
+inline bool operator==(stringview lhs, stringview rhs)
+{
+    return lhs.size() == rhs.size()
+        && (lhs.size() == 0 || 0 == memcmp(lhs.data(), rhs.data(), lhs.size()));
+}
+
+inline bool operator!=(stringview lhs, stringview rhs)
+{
+    return !(lhs == rhs);
+}
+
+/// Split \a input at \a sep and write the pieces to \a out as
+/// stringviews into \a input. Same piece semantics as util::split,
+/// but without copying characters.
+template<typename OutputIterator>
+void split(stringview input, char sep, OutputIterator out)
+{
+    std::size_t begin = 0;
+
+    for (std::size_t i = 0; i < input.size(); ++i)
+        if (input[i] == sep) {
+            *out++ = stringview(input.data() + begin, i - begin);
+            begin  = i + 1;
+        }
+
+    if (begin < input.size())
+        *out++ = stringview(input.data() + begin, input.size() - begin);
+}
+
+} // namespace util
+
+#endif
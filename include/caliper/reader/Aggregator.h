@@ -46,6 +46,8 @@ namespace cali
 {
 
 class CaliperMetadataAccessInterface;
+class Node;
+class Variant;
 
 /// \brief Post-processing aggregator
 /// \ingroup ReaderAPI
@@ -65,12 +67,39 @@ public:
 
     void add(CaliperMetadataAccessInterface&, const EntryList&);
 
+    /// \brief Fused single-pass aggregation: consume a snapshot
+    ///   record's raw fields directly.
+    ///
+    /// Extracts the key and aggregation attributes from the given
+    /// node references and immediate entries without materializing
+    /// the record as an EntryList first. Equivalent to add() for a
+    /// record holding the same entries. Used by
+    /// CaliperMetadataDB::read_aggregate().
+    void add(CaliperMetadataAccessInterface& db,
+             std::size_t n_nodes, const Node* const nodes[],
+             std::size_t n_imm,   const cali_id_t attr_ids[], const Variant values[]);
+
     void operator()(CaliperMetadataAccessInterface& db, const EntryList& list) {
         add(db, list);
     }
 
     void flush(CaliperMetadataAccessInterface&, SnapshotProcessFn push);
 
+    /// \brief Pre-size the aggregation table for \a n expected groups.
+    ///
+    /// Optional cardinality hint that avoids rehashing while the
+    /// aggregation table grows. Must be called before adding records.
+    void reserve(std::size_t n);
+
+    /// \brief Merge aggregation results of \a from into this aggregator.
+    ///
+    /// Combines results from multiple aggregator instances, e.g. from
+    /// per-thread aggregation. Both aggregators must use the same
+    /// aggregation spec and metadata database. Merges with disjoint
+    /// targets may run concurrently, but no instance may be the target
+    /// of two merges at the same time.
+    void merge(Aggregator& from);
+
     static const QuerySpec::FunctionSignature* aggregation_defs();
 };
 
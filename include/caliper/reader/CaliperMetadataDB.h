@@ -49,9 +49,10 @@
 namespace cali
 {
 
+class Aggregator;
 class Node;
 class Variant;
-    
+
 typedef std::map<cali_id_t, cali_id_t> IdMap;
 
 /// \brief Maintains a context tree and provides metadata information.
@@ -75,6 +76,33 @@ public:
     RecordMap   merge(const RecordMap& rec, IdMap& map);
     void        merge(const RecordMap& rec, IdMap& map, NodeProcessFn node_fn, SnapshotProcessFn snap_fn);
 
+    /// \brief Read and merge the record stream in \a filename.
+    ///
+    /// Processes the stream in bounded memory: only node metadata is
+    /// interned in the database, snapshot records are passed on to
+    /// \a snap_fn without being retained, and the per-file node id
+    /// map is discarded when the file is done. Memory use is thus
+    /// independent of the number of snapshot records and files read.
+    ///
+    /// The optional \a block_filter is passed to CsvReader to skip
+    /// index blocks in indexed files (see CsvIndex.h).
+    ///
+    /// \return false if the file could not be read
+    bool        read(const std::string& filename, NodeProcessFn node_fn, SnapshotProcessFn snap_fn);
+    bool        read(const std::string& filename, NodeProcessFn node_fn, SnapshotProcessFn snap_fn,
+                     std::function<bool(const RecordMap&)> block_filter);
+
+    /// \brief Read the record stream in \a filename and aggregate
+    ///   snapshot records directly into \a aggregator.
+    ///
+    /// Fused variant of read() for aggregation queries: snapshot
+    /// records are handed to the aggregator's direct interface,
+    /// which extracts the key and aggregation attributes without
+    /// the records being materialized as EntryList records first.
+    ///
+    /// \return false if the file could not be read
+    bool        read_aggregate(const std::string& filename, NodeProcessFn node_fn, Aggregator& aggregator);
+
     // Merge node and snapshots. Note: this interface may change.
     const Node* merge_node    (cali_id_t       node_id, 
                                cali_id_t       attr_id, 
@@ -30,39 +30,48 @@
 // WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
 // ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+
 /// \file QueryProcessor.h
 /// QueryProcessor class
 
 #pragma once
 
 #include "QuerySpec.h"
+#include "RecordProcessor.h"
 
 #include <iostream>
+#include <memory>
 
 namespace cali
 {
 
 class CaliperMetadataAccessInterface;
 
+/// \brief Execute a complete query spec (filter, aggregation, and
+///   formatting) on a snapshot record stream.
+///
+/// Multiple QueryProcessor instances can consume the same record
+/// stream, which lets several queries run in a single pass over the
+/// input.
 
 class QueryProcessor
 {
     struct QueryProcessorImpl;
     std::shared_ptr<QueryProcessorImpl> mP;
-    
+
 public:
 
     QueryProcessor(const QuerySpec&, std::ostream& os);
 
-    void process(CaliperMetadataAccessInterface&, const EntryList&);
+    ~QueryProcessor();
 
-    void flush();
+    void process_record(CaliperMetadataAccessInterface&, const EntryList&);
+
+    void flush(CaliperMetadataAccessInterface&);
 
     void operator()(CaliperMetadataAccessInterface& db, const EntryList& rec) {
-        process(db, rec);
+        process_record(db, rec);
     }
-
-    static const QuerySpec::FunctionSignature* formatter_defs() const;
 };
 
 }
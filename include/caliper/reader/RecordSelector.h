@@ -63,6 +63,14 @@ public:
 
     bool pass(const CaliperMetadataAccessInterface&, const EntryList&);
 
+    /// \brief Check if a file index block may contain matching records.
+    ///
+    /// Evaluates the filter conditions against the attribute bloom
+    /// filter in the given idx record (see CsvIndex.h). Returns false
+    /// only if no record in the block can pass the filter, so the
+    /// block can be skipped wholesale.
+    bool pass_block(const RecordMap& idx_rec) const;
+
     void operator()(CaliperMetadataAccessInterface&, const EntryList&, SnapshotProcessFn) const;
 
     static std::vector<QuerySpec::Condition> parse(const std::string&);
@@ -42,9 +42,11 @@
 
 #include "caliper/common/util/lockfree-tree.hpp"
 
+#include <algorithm>
 #include <functional>
-#include <map>
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace cali
 {
@@ -94,10 +96,12 @@ class SnapshotTreeNode : public util::LockfreeIntrusiveTree<SnapshotTreeNode>
 
     bool      m_empty;
 
-    std::map<cali::Attribute, cali::Variant> m_attributes;
+    // Sorted by attribute. A flat vector is more compact and faster to
+    // build than a map for the few entries a snapshot record carries.
+    std::vector< std::pair<cali::Attribute, cali::Variant> > m_attributes;
 
-    void assign_attributes(std::map<cali::Attribute, cali::Variant>&& a) {
-        m_attributes = a;
+    void assign_attributes(std::vector< std::pair<cali::Attribute, cali::Variant> >&& a) {
+        m_attributes = std::move(a);
         m_empty = false;
     }
 
@@ -125,11 +129,22 @@ public:
     }
 
     /// \brief Access the non-path attributes of the snapshot associated
-    ///   with this node.
-    const std::map<cali::Attribute, cali::Variant>& attributes() const {
+    ///   with this node, sorted by attribute.
+    const std::vector< std::pair<cali::Attribute, cali::Variant> >& attributes() const {
         return m_attributes;
     }
 
+    /// \brief Return the value for attribute \a key, or an empty
+    ///   Variant if the node has no entry for \a key.
+    Variant attribute(const Attribute& key) const {
+        auto it = std::lower_bound(m_attributes.begin(), m_attributes.end(), key,
+                                   [](const std::pair<cali::Attribute, cali::Variant>& p, const Attribute& a) {
+                                       return p.first < a;
+                                   });
+
+        return (it != m_attributes.end() && it->first == key) ? it->second : Variant();
+    }
+
     friend class SnapshotTree;
 }; // SnapshotTreeNode
 
@@ -63,6 +63,14 @@ public:
     TableFormatter(const std::string& fields, const std::string& sort_fields);
     TableFormatter(const QuerySpec& spec);
 
+    /// \brief Create table formatter with streaming support.
+    ///
+    /// With the \a stream format argument set to \e N, the formatter
+    /// samples column widths from the first \e N records, then writes
+    /// records to \a os as they arrive instead of buffering the entire
+    /// result set. Streaming is disabled when sorting is requested.
+    TableFormatter(std::ostream& os, const QuerySpec& spec);
+
     ~TableFormatter();
 
     void process_record(CaliperMetadataAccessInterface&, const EntryList&);
@@ -32,6 +32,8 @@
 
 #include "caliper/cali-mpi.h"
 
+#include "aggregate_buffers.h"
+
 #include "caliper/reader/Aggregator.h"
 #include "caliper/reader/CaliperMetadataDB.h"
 
@@ -41,6 +43,7 @@
 #include "caliper/common/SnapshotBuffer.h"
 
 #include <set>
+#include <vector>
 
 using namespace cali;
 
@@ -50,7 +53,7 @@ namespace
 
 void recursive_append_path(const CaliperMetadataAccessInterface& db,
                            const Node* node,
-                           NodeBuffer& buf,
+                           std::vector<const Node*>& nodes,
                            std::set<cali_id_t>& written_nodes)
 {
     if (!node || node->id() == CALI_INV_ID)
@@ -59,75 +62,62 @@ void recursive_append_path(const CaliperMetadataAccessInterface& db,
         return;
 
     if (node->attribute() < node->id())
-        recursive_append_path(db, db.node(node->attribute()), buf, written_nodes);
+        recursive_append_path(db, db.node(node->attribute()), nodes, written_nodes);
 
-    recursive_append_path(db, node->parent(), buf, written_nodes);
+    recursive_append_path(db, node->parent(), nodes, written_nodes);
 
     if (written_nodes.count(node->id()) > 0)
         return;
 
     written_nodes.insert(node->id());
-    buf.append(node);
-}    
+    nodes.push_back(node);
+}
 
-void pack_and_send(int dest, CaliperMetadataAccessInterface& db, Aggregator& aggregator)
+void pack_and_send(int dest, CaliperMetadataAccessInterface& db, Aggregator& aggregator, MPI_Comm comm)
 {
     NodeBuffer     nodebuf;
     SnapshotBuffer snapbuf;
 
-    std::set<cali_id_t> written_nodes;
-
-    aggregator.flush(db,
-                     [&nodebuf,&snapbuf,&written_nodes](CaliperMetadataAccessInterface& db,
-                                                        const EntryList& list)
-                     {
-                         for (const Entry& e : list)
-                             if (e.node())
-                                 recursive_append_path(db, e.node(), nodebuf, written_nodes);
-                             else if (e.is_immediate())
-                                 recursive_append_path(db, db.node(e.attribute()), nodebuf, written_nodes);
-
-                         snapbuf.append(CompressedSnapshotRecord(list.size(), list.data()));
-                     });
+    pack_aggregation_buffers(db, aggregator, nodebuf, snapbuf);
 
     {
         unsigned nodecount = nodebuf.count();
 
         MPI_Send(&nodecount,     1,              MPI_UNSIGNED,
-                 dest, 1, MPI_COMM_WORLD);
+                 dest, 1, comm);
         // Work with pre-3.0 MPIs that take non-const void* :-/
         MPI_Send(const_cast<unsigned char*>(nodebuf.data()), nodebuf.size(), MPI_BYTE,
-                 dest, 2, MPI_COMM_WORLD);
+                 dest, 2, comm);
     }
 
     {
         unsigned snapcount = snapbuf.count();
 
         MPI_Send(&snapcount,     1,              MPI_UNSIGNED,
-                 dest, 3, MPI_COMM_WORLD);
+                 dest, 3, comm);
         MPI_Send(const_cast<unsigned char*>(snapbuf.data()), snapbuf.size(), MPI_BYTE,
-                 dest, 4, MPI_COMM_WORLD);
-    }        
+                 dest, 4, comm);
+    }
 }
 
 
-size_t receive_and_merge_nodes(int source, CaliperMetadataDB& db, IdMap& idmap)
+size_t receive_and_merge_nodes(int source, CaliperMetadataDB& db, IdMap& idmap, MPI_Comm comm)
 {
     unsigned count;
 
     MPI_Recv(&count, 1, MPI_UNSIGNED,
-             source, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+             source, 1, comm, MPI_STATUS_IGNORE);
 
     MPI_Status status;
     int size;
 
-    MPI_Probe(source, 2, MPI_COMM_WORLD, &status);
+    MPI_Probe(source, 2, comm, &status);
     MPI_Get_count(&status, MPI_BYTE, &size);
 
     NodeBuffer nodebuf;
 
     MPI_Recv(nodebuf.import(size, count), size, MPI_BYTE,
-             source, 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+             source, 2, comm, MPI_STATUS_IGNORE);
 
     nodebuf.for_each([&db,&idmap](const NodeBuffer::NodeInfo& info)
                      {
@@ -137,25 +127,25 @@ size_t receive_and_merge_nodes(int source, CaliperMetadataDB& db, IdMap& idmap)
     return nodebuf.size();
 }
 
-size_t receive_and_merge_snapshots(int source, 
-                                   CaliperMetadataDB& db, const IdMap& idmap, 
-                                   SnapshotProcessFn snap_fn)
+size_t receive_and_merge_snapshots(int source,
+                                   CaliperMetadataDB& db, const IdMap& idmap,
+                                   SnapshotProcessFn snap_fn, MPI_Comm comm)
 {
     unsigned count;
 
-    MPI_Recv(&count, 3, MPI_UNSIGNED,
-             source, 3, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Recv(&count, 1, MPI_UNSIGNED,
+             source, 3, comm, MPI_STATUS_IGNORE);
 
     MPI_Status status;
     int size;
 
-    MPI_Probe(source, 4, MPI_COMM_WORLD, &status);
+    MPI_Probe(source, 4, comm, &status);
     MPI_Get_count(&status, MPI_BYTE, &size);
 
     SnapshotBuffer snapbuf;
 
     MPI_Recv(snapbuf.import(size, count), size, MPI_BYTE,
-             source, 4, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+             source, 4, comm, MPI_STATUS_IGNORE);
 
     size_t pos = 0;
 
@@ -178,13 +168,13 @@ size_t receive_and_merge_snapshots(int source,
     return snapbuf.size();
 }
 
-size_t receive_and_merge(int source, CaliperMetadataDB& db, SnapshotProcessFn snap_fn)
+size_t receive_and_merge(int source, CaliperMetadataDB& db, SnapshotProcessFn snap_fn, MPI_Comm comm)
 {
     IdMap  idmap;
     size_t bytes = 0;
 
-    bytes += receive_and_merge_nodes(source, db, idmap);
-    bytes += receive_and_merge_snapshots(source, db, idmap, snap_fn);
+    bytes += receive_and_merge_nodes(source, db, idmap, comm);
+    bytes += receive_and_merge_snapshots(source, db, idmap, snap_fn, comm);
 
     return bytes;
 }
@@ -195,6 +185,34 @@ size_t receive_and_merge(int source, CaliperMetadataDB& db, SnapshotProcessFn sn
 namespace cali
 {
 
+void
+pack_aggregation_buffers(CaliperMetadataAccessInterface& db,
+                         Aggregator&     aggregator,
+                         NodeBuffer&     nodebuf,
+                         SnapshotBuffer& snapbuf)
+{
+    std::set<cali_id_t>      written_nodes;
+    std::vector<const Node*> nodes;
+
+    aggregator.flush(db,
+                     [&nodes,&snapbuf,&written_nodes](CaliperMetadataAccessInterface& db,
+                                                      const EntryList& list)
+                     {
+                         for (const Entry& e : list)
+                             if (e.node())
+                                 recursive_append_path(db, e.node(), nodes, written_nodes);
+                             else if (e.is_immediate())
+                                 recursive_append_path(db, db.node(e.attribute()), nodes, written_nodes);
+
+                         snapbuf.append(CompressedSnapshotRecord(list.size(), list.data()));
+                     });
+
+    // Write the referenced context tree as one bulk-encoded batch
+    // instead of a stream of per-node records
+
+    nodebuf.append_batch(nodes.size(), nodes.data());
+}
+
 void
 aggregate_over_mpi(CaliperMetadataDB& metadb, Aggregator& aggr, MPI_Comm comm)
 {
@@ -209,11 +227,11 @@ aggregate_over_mpi(CaliperMetadataDB& metadb, Aggregator& aggr, MPI_Comm comm)
         
         // receive and merge
         if (rank % (2*steppow2) == 0 && rank + steppow2 < commsize)
-            bytes = ::receive_and_merge(rank + steppow2, metadb, aggr);
+            bytes = ::receive_and_merge(rank + steppow2, metadb, aggr, comm);
 
         // send up the tree (happens only in one step for each rank, and never for rank 0)
         if (rank % steppow2 == 0 && rank % (2*steppow2) != 0)
-            ::pack_and_send(rank - steppow2, metadb, aggr);
+            ::pack_and_send(rank - steppow2, metadb, aggr, comm);
     }
 }
 
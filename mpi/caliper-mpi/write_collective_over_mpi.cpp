@@ -0,0 +1,146 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file write_collective_over_mpi.cpp
+/// \brief Collective MPI-IO output of per-rank aggregation buffers
+///
+/// Writes the serialized node and snapshot buffers of all ranks into
+/// a single shared file, so large runs create one file instead of one
+/// file per process. File layout (all integers native-endian uint64):
+///
+///     bytes 0..7:   magic "CALIMPIO"
+///     bytes 8..15:  number of ranks N
+///     bytes 16..:   N table entries of 5 uint64 each:
+///                   file offset, node buffer size and count,
+///                   snapshot buffer size and count
+///     payload:      per-rank node buffer followed by snapshot buffer,
+///                   in rank order at the offsets given in the table
+///
+/// The payload is written with MPI_File_write_at_all: MPI-IO's
+/// two-phase collective buffering funnels the data through its I/O
+/// aggregator ranks, so the file system sees few large writes instead
+/// of many small ones.
+
+#include "caliper/cali-mpi.h"
+
+#include "aggregate_buffers.h"
+
+#include "caliper/reader/Aggregator.h"
+#include "caliper/reader/CaliperMetadataDB.h"
+
+#include "caliper/common/Log.h"
+#include "caliper/common/NodeBuffer.h"
+#include "caliper/common/SnapshotBuffer.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace cali;
+
+namespace cali
+{
+
+bool
+write_collective_over_mpi(const std::string& filename, CaliperMetadataDB& metadb, Aggregator& aggr, MPI_Comm comm)
+{
+    int commsize;
+    int rank;
+
+    MPI_Comm_size(comm, &commsize);
+    MPI_Comm_rank(comm, &rank);
+
+    NodeBuffer     nodebuf;
+    SnapshotBuffer snapbuf;
+
+    pack_aggregation_buffers(metadb, aggr, nodebuf, snapbuf);
+
+    // table entry: offset, node size, node count, snapshot size, snapshot count
+    uint64_t entry[5] = {
+        0,
+        nodebuf.size(), nodebuf.count(),
+        snapbuf.size(), snapbuf.count()
+    };
+
+    uint64_t header_size = 16 + 40 * static_cast<uint64_t>(commsize);
+    uint64_t local_size  = entry[1] + entry[3];
+    uint64_t offset      = 0;
+
+    MPI_Exscan(&local_size, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+
+    if (rank == 0) // MPI_Exscan leaves the recv buffer undefined on rank 0
+        offset = 0;
+
+    entry[0] = header_size + offset;
+
+    std::vector<uint64_t> table;
+
+    if (rank == 0)
+        table.resize(5 * commsize);
+
+    MPI_Gather(entry, 5, MPI_UNSIGNED_LONG_LONG,
+               table.data(), 5, MPI_UNSIGNED_LONG_LONG, 0, comm);
+
+    MPI_File file;
+
+    if (MPI_File_open(comm, const_cast<char*>(filename.c_str()),
+                      MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        Log(0).stream() << "write_collective_over_mpi: cannot open " << filename << std::endl;
+        return false;
+    }
+
+    if (rank == 0) {
+        unsigned char header[16];
+        uint64_t      nranks = commsize;
+
+        memcpy(header,   "CALIMPIO", 8);
+        memcpy(header+8, &nranks,    8);
+
+        MPI_File_write_at(file, 0, header, 16, MPI_BYTE, MPI_STATUS_IGNORE);
+        MPI_File_write_at(file, 16, table.data(), 40 * commsize, MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+
+    // Collective payload writes at the per-rank offsets
+
+    MPI_File_write_at_all(file, entry[0],
+                          const_cast<unsigned char*>(nodebuf.data()),
+                          nodebuf.size(), MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_write_at_all(file, entry[0] + entry[1],
+                          const_cast<unsigned char*>(snapbuf.data()),
+                          snapbuf.size(), MPI_BYTE, MPI_STATUS_IGNORE);
+
+    MPI_File_close(&file);
+
+    return true;
+}
+
+} // namespace cali
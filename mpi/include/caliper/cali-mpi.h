@@ -43,6 +43,8 @@
 
 #ifdef __cplusplus
 
+#include <string>
+
 namespace cali
 {
 
@@ -72,9 +74,33 @@ class CaliperMetadataDB;
  * \ingroup ReaderAPI
  */
     
-void 
+void
 aggregate_over_mpi(CaliperMetadataDB& db, Aggregator& a, MPI_Comm comm);
 
+/**
+ * \brief Write per-rank aggregation results into a single shared file
+ *
+ * Serializes the local aggregation results in \a a on each rank and
+ * writes them into \a filename with collective MPI-IO, so the run
+ * creates one shared output file instead of one file per process.
+ * A header records each rank's file offset and buffer sizes.
+ *
+ * This function is a blocking collective operation over \a comm.
+ *
+ * \param filename Name of the shared output file.
+ * \param db   Metadata information for \a a.
+ * \param a    Provides the aggregation configuration and local input
+ *    records. The aggregator contents are not modified.
+ * \param comm MPI communicator.
+ *
+ * \return false on any rank that could not open the file.
+ *
+ * \ingroup ReaderAPI
+ */
+
+bool
+write_collective_over_mpi(const std::string& filename, CaliperMetadataDB& db, Aggregator& a, MPI_Comm comm);
+
 } /* namespace cali */
 
 extern "C" {
@@ -41,20 +41,26 @@
 
 #include "ContextBuffer.h"
 #include "MetadataTree.h"
+#include "SnapshotQueue.h"
 
 #include "caliper/common/ContextRecord.h"
+#include "caliper/common/Health.h"
 #include "caliper/common/Node.h"
 #include "caliper/common/Log.h"
+#include "caliper/common/MemoryBudget.h"
 #include "caliper/common/RuntimeConfig.h"
 
 #include "caliper/common/util/split.hpp"
 
 #include "../services/Services.h"
 
+#include <pthread.h>
 #include <signal.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #include <cstdlib>
 #include <functional>
@@ -63,6 +69,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <vector>
 #include <utility>
 
@@ -73,15 +80,16 @@ namespace cali
 {
     extern void init_attribute_classes(Caliper* c);
     extern void init_api_attributes(Caliper* c);
+    extern void append_inline_slots(SnapshotRecord* sbuf);
 }
 
 namespace
 {
     // --- helpers
 
-    inline cali_context_scope_t 
-    attr2caliscope(const Attribute& attr) {
-        switch (attr.properties() & CALI_ATTR_SCOPE_MASK) {
+    inline cali_context_scope_t
+    attr2caliscope(int prop) {
+        switch (prop & CALI_ATTR_SCOPE_MASK) {
         case CALI_ATTR_SCOPE_THREAD:
             return CALI_SCOPE_THREAD;
         case CALI_ATTR_SCOPE_PROCESS:
@@ -105,6 +113,11 @@ namespace
             c.flush_and_write(nullptr);
             c.events().finish_evt(&c);
 
+            if (Log::verbosity() >= 2)
+                MemoryBudget::print_statistics( Log(2).stream() ) << std::endl;
+            if (Health::any())
+                Health::print_statistics( Log(1).stream() ) << std::endl;
+
             c.release_scope(c.default_scope(CALI_SCOPE_PROCESS));
             // Somehow default thread scope is not released by pthread_key_create destructor
             c.release_scope(c.default_scope(CALI_SCOPE_THREAD));
@@ -114,6 +127,66 @@ namespace
         // Caliper::release();
     }
 
+    // --- Snapshot trigger classification
+
+    // Compute the attribute bitmask of a snapshot trigger for the
+    // snapshot callback's interest filter (see
+    // Caliper::make_attribute_mask). Covers the trigger's immediate
+    // entries and full node chains; an absent or empty trigger
+    // matches every subscriber, since it cannot be classified.
+
+    uint64_t trigger_update_mask(const SnapshotRecord* trigger_info) {
+        if (!trigger_info)
+            return ~static_cast<uint64_t>(0);
+
+        SnapshotRecord::Data  data(trigger_info->data());
+        SnapshotRecord::Sizes size(trigger_info->size());
+
+        if (size.n_nodes + size.n_immediate == 0)
+            return ~static_cast<uint64_t>(0);
+
+        uint64_t mask = 0;
+
+        for (size_t e = 0; e < size.n_immediate; ++e)
+            mask |= 1ull << (data.immediate_attr[e] & 63);
+
+        for (size_t e = 0; e < size.n_nodes; ++e)
+            for (const cali::Node* node = data.node_entries[e]; node; node = node->parent())
+                if (node->attribute() != CALI_INV_ID)
+                    mask |= 1ull << (node->attribute() & 63);
+
+        return mask;
+    }
+
+    // --- Per-thread stack bounds
+    //
+    // Captured once from the pthread attributes when a thread's
+    // Caliper scope is created. Caliper::thread_stack_bounds() then
+    // is a pair of plain thread-local loads with no syscall, so
+    // unwinders can validate frame pointers with two compares, also
+    // in signal context.
+
+    thread_local void* t_stack_lo = nullptr;
+    thread_local void* t_stack_hi = nullptr;
+
+    void capture_stack_bounds() {
+#ifdef __linux__
+        pthread_attr_t attr;
+
+        if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+            void*  addr = nullptr;
+            size_t size = 0;
+
+            if (pthread_attr_getstack(&attr, &addr, &size) == 0 && size > 0) {
+                t_stack_lo = addr;
+                t_stack_hi = static_cast<char*>(addr) + size;
+            }
+
+            pthread_attr_destroy(&attr);
+        }
+#endif
+    }
+
     // --- Siglock
 
     class siglock {
@@ -144,11 +217,105 @@ struct Caliper::Scope
 {
     MetadataTree         tree;
     ContextBuffer        blackboard;
-    
+
     cali_context_scope_t scope;
 
     ::siglock            lock;
 
+    // Memoized blackboard serialization for pull_snapshot(). Caches the
+    // last serialized node entries of a source blackboard, keyed by its
+    // node generation counter, so the reference portion of an unchanged
+    // context isn't re-serialized on every snapshot trigger; only the
+    // (few) immediate entries are copied per pull. Accessed only by the
+    // owning thread.
+
+    struct BlackboardSnapshot {
+        const ContextBuffer*  source     { nullptr };
+        unsigned              generation { 0 };
+
+        SnapshotRecord::Sizes sizes      { 0, 0 };
+
+        SnapshotRecord::FixedSnapshotRecord<128> data;
+    };
+
+    BlackboardSnapshot   snapshot_cache[3]; // process/thread/task
+
+    // Pool of reusable snapshot record buffers for push_snapshot() and
+    // the flush paths, replacing fixed-size stack staging. Buffers grow
+    // to the target capacity when they are acquired outside signal
+    // context; a record that ran full doubles the target for subsequent
+    // snapshots, so sustained truncation cannot go unnoticed forever.
+    // Accessed only by the owning thread.
+
+    class SnapshotBufferPool {
+        static const size_t NUM_BUFFERS = 4;
+
+    public:
+
+        static const size_t INITIAL_CAPACITY = 128;
+
+        struct Buffer {
+            std::vector<cali::Node*>   nodes;
+            std::vector<cali_id_t>     attr;
+            std::vector<cali::Variant> data;
+
+            bool in_use = false;
+
+            SnapshotRecord record() {
+                return SnapshotRecord(nodes.size(), nodes.data(),
+                                      attr.size(),  attr.data(), data.data());
+            }
+        };
+
+    private:
+
+        Buffer m_buffers[NUM_BUFFERS];
+        size_t m_capacity; // target per-buffer capacity
+
+        static void resize(Buffer& b, size_t capacity) {
+            b.nodes.resize(capacity);
+            b.attr.resize(capacity);
+            b.data.resize(capacity);
+        }
+
+    public:
+
+        SnapshotBufferPool()
+            : m_capacity(INITIAL_CAPACITY)
+            {
+                for (Buffer& b : m_buffers)
+                    resize(b, m_capacity);
+            }
+
+        // Get a free buffer, or null if all are taken. Deferred growth
+        // happens here: in signal context no allocation takes place.
+        Buffer* acquire(bool is_signal) {
+            for (Buffer& b : m_buffers)
+                if (!b.in_use) {
+                    if (!is_signal && b.nodes.size() < m_capacity)
+                        resize(b, m_capacity);
+
+                    b.in_use = true;
+                    return &b;
+                }
+
+            return nullptr;
+        }
+
+        void release(Buffer* b, const SnapshotRecord& rec) {
+            // a record that ran full was likely truncated: double the
+            // target capacity for subsequent snapshots
+            SnapshotRecord::Sizes free = rec.capacity();
+
+            if (free.n_nodes == 0 || free.n_immediate == 0)
+                m_capacity = std::max<size_t>(2 * b->nodes.size(), m_capacity);
+
+            b->in_use = false;
+        }
+    };
+
+    SnapshotBufferPool   snapshot_pool;
+
     Scope(cali_context_scope_t s)
         : scope(s) { }
 };
@@ -188,6 +355,113 @@ struct Caliper::GlobalData
     map<string, Node*>     attribute_nodes;
     map<string, int>       attribute_prop_presets;
 
+    //
+    // Lock-free attribute lookup table. Fixed-size open-addressing hash
+    // keyed by the attribute name's hash. The mutex-protected
+    // attribute_nodes map remains the authoritative store; entries here
+    // are only added (under attribute_lock) and published with a
+    // release store, so the read hit path takes no lock at all.
+    //
+
+    static const size_t    ATTRIBUTE_TABLE_SIZE = 1024;
+
+    struct AttributeTableEntry {
+        std::atomic<Node*> node  { nullptr };
+        uint64_t           hash  { 0 };
+        std::string        name;
+    };
+
+    AttributeTableEntry    attribute_table[ATTRIBUTE_TABLE_SIZE];
+    size_t                 attribute_table_count = 0; // guarded by attribute_lock
+
+    //
+    // Lock-free attribute-by-id table. Attribute ids are small and
+    // dense, so a flat array indexed by id serves get_attribute(id) --
+    // called per entry in unpack and formatting paths -- with a single
+    // load. Slots are published with a release store at registration;
+    // ids beyond the table fall back to the validated tree lookup.
+    //
+
+    static const size_t    ATTRIBUTE_ID_TABLE_SIZE = 4096;
+
+    std::atomic<Node*>     attribute_id_table[ATTRIBUTE_ID_TABLE_SIZE];
+
+    // Property bits per attribute id. Attribute::properties() chases
+    // the attribute node's metadata chain; the snapshot path tests
+    // properties per entry per event, so serve them from a packed
+    // array filled at registration instead.
+
+    std::atomic<int>       attribute_prop_table[ATTRIBUTE_ID_TABLE_SIZE];
+
+    void insert_attribute_id_table(Node* node) {
+        if (node && node->id() < ATTRIBUTE_ID_TABLE_SIZE) {
+            attribute_prop_table[node->id()].store(
+                Attribute::make_attribute_unchecked(node).properties(), std::memory_order_relaxed);
+            attribute_id_table[node->id()].store(node, std::memory_order_release);
+        }
+    }
+
+    // Branch-light property test for the snapshot path: a load and
+    // mask for table-resident ids.
+    int attribute_properties(const Attribute& attr) const {
+        cali_id_t id = attr.id();
+
+        if (id < ATTRIBUTE_ID_TABLE_SIZE && attribute_id_table[id].load(std::memory_order_acquire))
+            return attribute_prop_table[id].load(std::memory_order_relaxed);
+
+        return attr.properties();
+    }
+
+    static uint64_t hash_attribute_name(const std::string& name) {
+        uint64_t hash = 14695981039346656037ull;
+
+        for (char c : name)
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+
+        return hash;
+    }
+
+    Node* lookup_attribute_table(const std::string& name) const {
+        uint64_t hash = hash_attribute_name(name);
+
+        for (size_t i = 0; i < ATTRIBUTE_TABLE_SIZE; ++i) {
+            const AttributeTableEntry& e = attribute_table[(hash+i) % ATTRIBUTE_TABLE_SIZE];
+
+            Node* node = e.node.load(std::memory_order_acquire);
+
+            if (!node) // never-used slot: name is not in the table
+                return nullptr;
+            if (e.hash == hash && e.name == name)
+                return node;
+        }
+
+        return nullptr;
+    }
+
+    void insert_attribute_table(const std::string& name, Node* node) {
+        // NOTE: attribute_lock must be held!
+
+        // Leave some headroom: a nearly-full table degrades probes, and
+        // lookups can always fall back to the map
+        if (4 * (attribute_table_count+1) >= 3 * ATTRIBUTE_TABLE_SIZE)
+            return;
+
+        uint64_t hash = hash_attribute_name(name);
+
+        for (size_t i = 0; i < ATTRIBUTE_TABLE_SIZE; ++i) {
+            AttributeTableEntry& e = attribute_table[(hash+i) % ATTRIBUTE_TABLE_SIZE];
+
+            if (!e.node.load(std::memory_order_relaxed)) {
+                e.hash = hash;
+                e.name = name;
+                e.node.store(node, std::memory_order_release);
+
+                ++attribute_table_count;
+                return;
+            }
+        }
+    }
+
     // are there new attributes since last snapshot recording? - temporary, will go away
     std::atomic<bool>      new_attributes;
     std::atomic<bool>      bootstrap_nodes_written;
@@ -202,10 +476,111 @@ struct Caliper::GlobalData
     
     Events                 events;
 
+    // --- asynchronous snapshot processing
+    //
+    // With async_snapshot_processing, push_snapshot enqueues assembled
+    // records into a lock-free ring and helper threads run the
+    // process_snapshot callback chain off the application's critical
+    // path. async_active gates producers; it is cleared (and helpers
+    // are joined) before the first flush so no records are in flight
+    // when the flush callbacks run.
+
+    std::unique_ptr<SnapshotQueue> snapshot_queue;
+    std::vector<std::thread>       helper_threads;
+    std::atomic<bool>              async_active { false };
+    std::atomic<bool>              async_stop   { false };
+
+    // --- snapshot channels
+    //
+    // Named process_snapshot subscriber lists with their own trigger
+    // filters; the single captured record is fanned out to all
+    // channels whose filter accepts it. The list is append-only and
+    // only modified during service registration, before snapshots
+    // are being taken.
+
+    static const ConfigSet::Entry  s_channel_configdata[];
+
+    std::vector<SnapshotChannel*>  channels;
+    std::mutex                     channel_lock;
+
+    // lazily resolved "cali.event" attribute ids for the trigger filter
+    std::atomic<cali_id_t>         evt_trigger_attr_ids[3];
+
+    // Find the id of the attribute that triggered this snapshot from
+    // the event service's trigger entries, or CALI_INV_ID if there is
+    // no trigger entry (e.g., sampler snapshots).
+    cali_id_t find_snapshot_trigger_id(Caliper* c, const SnapshotRecord* snapshot) {
+        static const char* evt_attr_names[3] = {
+            "cali.event.begin", "cali.event.set", "cali.event.end"
+        };
+
+        SnapshotRecord::Sizes size = snapshot->size();
+        SnapshotRecord::Data  data = snapshot->data();
+
+        for (int i = 0; i < 3; ++i) {
+            cali_id_t evt_id = evt_trigger_attr_ids[i].load(std::memory_order_relaxed);
+
+            if (evt_id == CALI_INV_ID) {
+                // attribute name lookup takes a lock: skip in signal context
+                if (c->is_signal())
+                    continue;
+
+                Attribute attr = c->get_attribute(evt_attr_names[i]);
+
+                if (attr == Attribute::invalid)
+                    continue;
+
+                evt_id = attr.id();
+                evt_trigger_attr_ids[i].store(evt_id, std::memory_order_relaxed);
+            }
+
+            for (size_t e = 0; e < size.n_immediate; ++e)
+                if (data.immediate_attr[e] == evt_id)
+                    return data.immediate_data[e].to_uint();
+
+            // the trigger entries are reference entries unless the event
+            // attributes are set to store-as-value: walk the node chains
+
+            for (size_t e = 0; e < size.n_nodes; ++e)
+                for (const Node* node = data.node_entries[e]; node; node = node->parent())
+                    if (node->attribute() == evt_id)
+                        return node->data().to_uint();
+        }
+
+        return CALI_INV_ID;
+    }
+
+    void fanout_channels(Caliper* c, const SnapshotRecord* trigger_info, const SnapshotRecord* snapshot) {
+        cali_id_t   trigger_id = find_snapshot_trigger_id(c, snapshot);
+        std::string trigger_name;
+
+        if (trigger_id != CALI_INV_ID)
+            trigger_name = c->get_attribute(trigger_id).name();
+
+        for (SnapshotChannel* chn : channels) {
+            if (!chn->triggers.empty()) {
+                if (trigger_name.empty())
+                    continue;
+                if (std::find(chn->triggers.begin(), chn->triggers.end(), trigger_name) == chn->triggers.end())
+                    continue;
+            }
+
+            chn->process_snapshot(c, trigger_info, snapshot);
+        }
+    }
+
     Scope*                 process_scope;
     Scope*                 default_thread_scope;
     Scope*                 default_task_scope;
 
+    // Retired thread scopes, kept for reuse. release_scope() cannot
+    // free a scope because its memory pool may still hold context tree
+    // nodes; recycling retired scopes for new threads preserves their
+    // blackboard and tree pool allocations across thread churn (e.g.
+    // thread pools re-creating workers between phases).
+    std::vector<Scope*>    retired_thread_scopes;
+    std::mutex             retired_scopes_lock;
+
     pthread_key_t          thread_scope_key;
 
     // --- constructor
@@ -226,7 +601,17 @@ struct Caliper::GlobalData
           default_task_scope   { new Scope(CALI_SCOPE_TASK)    }
     {
         automerge = config.get("automerge").to_bool();
-        
+
+        // avoid reallocation under concurrent channel fan-out
+        channels.reserve(16);
+
+        for (std::atomic<cali_id_t>& id : evt_trigger_attr_ids)
+            id.store(CALI_INV_ID, std::memory_order_relaxed);
+        for (std::atomic<Node*>& node : attribute_id_table)
+            node.store(nullptr, std::memory_order_relaxed);
+        for (std::atomic<int>& prop : attribute_prop_table)
+            prop.store(CALI_ATTR_DEFAULT, std::memory_order_relaxed);
+
         name_attr = Attribute::make_attribute(default_thread_scope->tree.node( 8));
         type_attr = Attribute::make_attribute(default_thread_scope->tree.node( 9));
         prop_attr = Attribute::make_attribute(default_thread_scope->tree.node(10));
@@ -234,6 +619,14 @@ struct Caliper::GlobalData
         attribute_nodes.insert(make_pair(name_attr.name(), default_thread_scope->tree.node(name_attr.id())));
         attribute_nodes.insert(make_pair(type_attr.name(), default_thread_scope->tree.node(type_attr.id())));
         attribute_nodes.insert(make_pair(prop_attr.name(), default_thread_scope->tree.node(prop_attr.id())));
+
+        insert_attribute_table(name_attr.name(), default_thread_scope->tree.node(name_attr.id()));
+        insert_attribute_table(type_attr.name(), default_thread_scope->tree.node(type_attr.id()));
+        insert_attribute_table(prop_attr.name(), default_thread_scope->tree.node(prop_attr.id()));
+
+        insert_attribute_id_table(default_thread_scope->tree.node(name_attr.id()));
+        insert_attribute_id_table(default_thread_scope->tree.node(type_attr.id()));
+        insert_attribute_id_table(default_thread_scope->tree.node(prop_attr.id()));
         
         assert(name_attr != Attribute::invalid);
         assert(type_attr != Attribute::invalid);
@@ -242,6 +635,10 @@ struct Caliper::GlobalData
         pthread_key_create(&thread_scope_key, release_thread);
         pthread_setspecific(thread_scope_key, default_thread_scope);
 
+        // the main thread's scope is created directly above, so
+        // capture its stack bounds here
+        capture_stack_bounds();
+
         parse_attribute_property_presets();
         
         // now it is safe to use the Caliper interface
@@ -257,8 +654,14 @@ struct Caliper::GlobalData
 
 	//freeing up context buffers
         delete process_scope;
-        delete default_thread_scope; 
+        delete default_thread_scope;
         delete default_task_scope;
+
+        for (Scope* s : retired_thread_scopes)
+            delete s;
+
+        for (SnapshotChannel* chn : channels)
+            delete chn;
     }
     
     Scope* acquire_thread_scope(bool create = true) {
@@ -292,13 +695,19 @@ struct Caliper::GlobalData
     void init() {
         Caliper c(this, default_thread_scope, default_task_scope);
         
-        // Create and set key & version attributes
+        // Create and set key & version attributes.
+        // The key attribute itself must not carry the HIDDEN property:
+        // it is the blackboard key for the merged context chains, and
+        // the blackboard keeps entries under hidden keys off the
+        // snapshot path.
 
         key_attr =
-            c.create_attribute("cali.key.attribute", CALI_TYPE_USR, CALI_ATTR_HIDDEN);
+            c.create_attribute("cali.key.attribute", CALI_TYPE_USR, CALI_ATTR_DEFAULT);
             
+        // string length without the terminating null, like all other
+        // string tree data, so re-created nodes compare equal
         c.set(c.create_attribute("cali.caliper.version", CALI_TYPE_STRING, CALI_ATTR_SCOPE_PROCESS),
-              Variant(CALI_TYPE_STRING, CALIPER_VERSION, sizeof(CALIPER_VERSION)));
+              Variant(CALI_TYPE_STRING, CALIPER_VERSION, strlen(CALIPER_VERSION)));
 
         init_attribute_classes(&c);
 
@@ -311,12 +720,80 @@ struct Caliper::GlobalData
         if (Log::verbosity() >= 3)
             RuntimeConfig::print( Log(3).stream() << "Configuration:\n" );
 
-        c.events().post_init_evt(&c);        
+        c.events().post_init_evt(&c);
+
+        if (config.get("async_snapshot_processing").to_bool())
+            start_async_processing();
+    }
+
+    void start_async_processing() {
+        snapshot_queue.reset(new SnapshotQueue(config.get("async_queue_size").to_uint()));
+
+        int nthreads = std::max<int>(config.get("async_helper_threads").to_int(), 1);
+
+        async_active.store(true);
+
+        for (int i = 0; i < nthreads; ++i)
+            helper_threads.emplace_back([this](){
+                    Caliper c = Caliper::instance();
+
+                    SnapshotRecord::Sizes sizes = { 0, 0 };
+
+                    SnapshotRecord::FixedSnapshotRecord<SnapshotQueue::MAX_ENTRIES> qdata;
+                    SnapshotRecord::FixedSnapshotRecord<SnapshotQueue::MAX_ENTRIES> pdata;
+
+                    while (true) {
+                        if (snapshot_queue->dequeue(qdata, sizes)) {
+                            SnapshotRecord rec(pdata);
+
+                            rec.append(sizes.n_nodes,     qdata.node_array,
+                                       sizes.n_immediate, qdata.attr_array, qdata.data_array);
+
+                            events.pre_process_snapshot_evt(&c, nullptr, &rec);
+                            events.process_snapshot(&c, nullptr, &rec);
+
+                            if (!channels.empty())
+                                fanout_channels(&c, nullptr, &rec);
+
+                            events.post_process_snapshot_evt(&c, nullptr, &rec);
+                        } else if (async_stop.load()) {
+                            break;
+                        } else {
+                            std::this_thread::sleep_for(std::chrono::microseconds(50));
+                        }
+                    }
+                });
+
+        Log(1).stream() << "Asynchronous snapshot processing enabled ("
+                        << nthreads << " helper threads)" << endl;
+    }
+
+    // Stop producers and join the helper threads. Helpers drain the
+    // queue before exiting; any stragglers are drained by the caller.
+    void stop_async_processing() {
+        if (!async_active.exchange(false))
+            return;
+
+        async_stop.store(true);
+
+        for (std::thread& t : helper_threads)
+            t.join();
+
+        helper_threads.clear();
     }
     
     const Attribute&
     get_key(const Attribute& attr) const {
-        if (!automerge || attr.store_as_value() || !attr.is_autocombineable())
+        return get_key(attr, attribute_properties(attr));
+    }
+
+    const Attribute&
+    get_key(const Attribute& attr, int prop) const {
+        // Hidden attributes keep their own chain: the blackboard
+        // stores entries under hidden keys on a separate segment that
+        // the snapshot functions never visit, which wouldn't work if
+        // they were merged into the common context chain.
+        if (!automerge || (prop & (CALI_ATTR_ASVALUE | CALI_ATTR_NOMERGE | CALI_ATTR_HIDDEN)))
             return attr;
 
         return key_attr;
@@ -338,6 +815,23 @@ const ConfigSet::Entry Caliper::GlobalData::s_configdata[] = {
       "Decreases the size of context records, but may increase\n"
       "the amount of metadata and reduce performance." 
     },
+    { "async_snapshot_processing", CALI_TYPE_BOOL, "false",
+      "Process snapshots asynchronously on helper threads",
+      "Process snapshots asynchronously on helper threads.\n"
+      "Snapshot triggers only capture the snapshot contents into a\n"
+      "lock-free queue; the snapshot processing services run off the\n"
+      "critical path. Asynchronous processing ends at the first flush."
+    },
+    { "async_helper_threads", CALI_TYPE_UINT, "1",
+      "Number of helper threads for asynchronous snapshot processing",
+      "Number of helper threads for asynchronous snapshot processing"
+    },
+    { "async_queue_size", CALI_TYPE_UINT, "1024",
+      "Capacity of the asynchronous snapshot queue",
+      "Capacity of the asynchronous snapshot queue (rounded up to a\n"
+      "power of two). Snapshots taken while the queue is full are\n"
+      "processed inline."
+    },
     { "attribute_properties", CALI_TYPE_STRING, "",
       "List of attribute property presets",
       "List of attribute property presets, in the form\n"
@@ -351,7 +845,17 @@ const ConfigSet::Entry Caliper::GlobalData::s_configdata[] = {
       "  skip_events:   Do not invoke callback functions for updates\n"
       "  hidden:        Do not include this attribute in snapshots\n" 
     },
-    ConfigSet::Terminator 
+    ConfigSet::Terminator
+};
+
+const ConfigSet::Entry Caliper::GlobalData::s_channel_configdata[] = {
+    // key, type, value, short description, long description
+    { "trigger", CALI_TYPE_STRING, "",
+      "List of attributes that trigger snapshots on this channel",
+      "Colon-separated list of attributes that trigger snapshots on\n"
+      "this channel. If empty, the channel receives all snapshots."
+    },
+    ConfigSet::Terminator
 };
 
 
@@ -435,11 +939,39 @@ Caliper::create_scope(cali_context_scope_t st)
 {
     assert(mG != 0);
 
-    Scope* s = new Scope(st);
-    
+    Scope* s = nullptr;
+
+    if (st == CALI_SCOPE_THREAD) {
+        std::lock_guard<std::mutex>
+            g(mG->retired_scopes_lock);
+
+        if (!mG->retired_thread_scopes.empty()) {
+            s = mG->retired_thread_scopes.back();
+            mG->retired_thread_scopes.pop_back();
+        }
+    }
+
+    if (s) {
+        // Recycle a retired scope: drop leftover blackboard contents
+        // and memoized snapshots, keep the allocations
+
+        s->blackboard.clear();
+
+        for (Scope::BlackboardSnapshot& bs : s->snapshot_cache) {
+            bs.source     = nullptr;
+            bs.generation = 0;
+        }
+
+        Log(2).stream() << "Recycling retired thread scope" << endl;
+    } else
+        s = new Scope(st);
+
     switch (st) {
     case CALI_SCOPE_THREAD:
         m_thread_scope = s;
+        // scope setup runs on the owning thread: capture its stack
+        // bounds for thread_stack_bounds()
+        capture_stack_bounds();
         break;
     case CALI_SCOPE_TASK:
         m_task_scope   = s;
@@ -458,6 +990,18 @@ Caliper::create_scope(cali_context_scope_t st)
     return s;
 }
 
+bool
+Caliper::thread_stack_bounds(void** lo, void** hi)
+{
+    if (!::t_stack_lo)
+        return false;
+
+    *lo = ::t_stack_lo;
+    *hi = ::t_stack_hi;
+
+    return true;
+}
+
 void
 Caliper::release_scope(Caliper::Scope* s)
 {
@@ -491,10 +1035,19 @@ Caliper::release_scope(Caliper::Scope* s)
     
     std::lock_guard<::siglock>
         g(m_thread_scope->lock);
-    
+
     mG->events.release_scope_evt(this, s->scope);
-    // do NOT delete this because we may still need the node data in the scope's memory pool
-    // delete ctx;
+
+    // We cannot delete the scope because we may still need the node
+    // data in its memory pool, but retired thread scopes can be
+    // recycled for new threads in create_scope().
+
+    if (s->scope == CALI_SCOPE_THREAD && s != mG->default_thread_scope) {
+        std::lock_guard<std::mutex>
+            g(mG->retired_scopes_lock);
+
+        mG->retired_thread_scopes.push_back(s);
+    }
 }
 
 
@@ -537,15 +1090,21 @@ Caliper::create_attribute(const std::string& name, cali_attr_type type, int prop
     Node* node        = nullptr;
     bool  created_now = false;
 
-    // Check if an attribute with this name already exists
+    // Check if an attribute with this name already exists.
+    // Try the lock-free lookup table first; it can miss when full,
+    // so check the authoritative map before creating the attribute.
 
-    mG->attribute_lock.lock();
+    node = mG->lookup_attribute_table(name);
 
-    auto it = mG->attribute_nodes.find(name);
-    if (it != mG->attribute_nodes.end())
-        node = it->second;
+    if (!node) {
+        mG->attribute_lock.lock();
+
+        auto it = mG->attribute_nodes.find(name);
+        if (it != mG->attribute_nodes.end())
+            node = it->second;
 
-    mG->attribute_lock.unlock();
+        mG->attribute_lock.unlock();
+    }
 
     // Create attribute nodes
 
@@ -590,6 +1149,8 @@ Caliper::create_attribute(const std::string& name, cali_attr_type type, int prop
 
             if (it == mG->attribute_nodes.end() || it->first != name) {
                 mG->attribute_nodes.emplace_hint(it, name, node);
+                mG->insert_attribute_table(name, node);
+                mG->insert_attribute_id_table(node);
                 mG->new_attributes.store(true);
                 created_now = true;
             } else
@@ -623,17 +1184,21 @@ Caliper::get_attribute(const std::string& name) const
 
     std::lock_guard<::siglock>
         g(m_thread_scope->lock);
-    
-    Node* node = nullptr;
 
-    mG->attribute_lock.lock();
+    Node* node = mG->lookup_attribute_table(name);
+
+    if (!node) {
+        // the lookup table may miss when full: check the map
 
-    auto it = mG->attribute_nodes.find(name);
+        mG->attribute_lock.lock();
 
-    if (it != mG->attribute_nodes.end())
-        node = it->second;
+        auto it = mG->attribute_nodes.find(name);
 
-    mG->attribute_lock.unlock();
+        if (it != mG->attribute_nodes.end())
+            node = it->second;
+
+        mG->attribute_lock.unlock();
+    }
 
     return Attribute::make_attribute(node);
 }
@@ -647,7 +1212,14 @@ Attribute
 Caliper::get_attribute(cali_id_t id) const
 {
     // no signal lock necessary
-    
+
+    if (id < GlobalData::ATTRIBUTE_ID_TABLE_SIZE) {
+        Node* node = mG->attribute_id_table[id].load(std::memory_order_acquire);
+
+        if (node)
+            return Attribute::make_attribute_unchecked(node);
+    }
+
     return Attribute::make_attribute(m_thread_scope->tree.node(id));
 }
 
@@ -697,6 +1269,18 @@ Caliper::get_attributes() const
 ///                     callback, and added to the returned snapshot record.
 /// \param sbuf         Caller-provided snapshot record buffer in which the snapshot record is
 ///                     returned. Must have sufficient space for the snapshot contents.
+uint64_t
+Caliper::make_attribute_mask(size_t n, const cali_id_t attr_ids[])
+{
+    uint64_t mask = 0;
+
+    for (size_t i = 0; i < n; ++i)
+        if (attr_ids[i] != CALI_INV_ID)
+            mask |= 1ull << (attr_ids[i] & 63);
+
+    return mask;
+}
+
 void
 Caliper::pull_snapshot(int scopes, const SnapshotRecord* trigger_info, SnapshotRecord* sbuf)
 {
@@ -710,13 +1294,47 @@ Caliper::pull_snapshot(int scopes, const SnapshotRecord* trigger_info, SnapshotR
     if (trigger_info)
         sbuf->append(*trigger_info);
 
-    // Invoke callbacks and get contextbuffer data
+    // Invoke callbacks and get contextbuffer data. The snapshot
+    // callback is dispatched with the triggering update's attribute
+    // mask so subscribers that registered interest in specific
+    // attributes are skipped when the trigger doesn't contain them.
 
-    mG->events.snapshot(this, scopes, trigger_info, sbuf);
+    mG->events.pre_snapshot_evt(this, scopes, trigger_info, sbuf);
+    mG->events.snapshot.invoke_matching(::trigger_update_mask(trigger_info),
+                                        this, scopes, trigger_info, sbuf);
+    mG->events.post_snapshot_evt(this, scopes, trigger_info, sbuf);
 
     for (cali_context_scope_t s : { CALI_SCOPE_TASK, CALI_SCOPE_THREAD, CALI_SCOPE_PROCESS })
-        if (scopes & s)
-            scope(s)->blackboard.snapshot(sbuf);
+        if (scopes & s) {
+            ContextBuffer* bb = &scope(s)->blackboard;
+
+            // Re-serialize the blackboard's node entries only if they
+            // changed since the last pull; otherwise append the
+            // memoized node list. Immediate entries (timestamps,
+            // counters) are copied fresh on every pull.
+
+            int i = (s == CALI_SCOPE_PROCESS ? 0 : (s == CALI_SCOPE_THREAD ? 1 : 2));
+
+            Scope::BlackboardSnapshot& cache = m_thread_scope->snapshot_cache[i];
+
+            if (cache.source != bb || bb->node_generation() != cache.generation) {
+                SnapshotRecord rec(cache.data);
+
+                cache.generation = bb->snapshot_nodes(&rec);
+                cache.sizes      = rec.size();
+                cache.source     = bb;
+            }
+
+            sbuf->append(cache.sizes.n_nodes, cache.data.node_array,
+                         0, nullptr, nullptr);
+
+            bb->snapshot_immediates(sbuf);
+        }
+
+    // Pick up this thread's inline fast-path value slots (cali_inline.h)
+
+    if (scopes & CALI_SCOPE_THREAD)
+        append_inline_slots(sbuf);
 }
 
 /// \brief Trigger and process a snapshot. 
@@ -749,12 +1367,35 @@ Caliper::push_snapshot(int scopes, const SnapshotRecord* trigger_info)
     std::lock_guard<::siglock>
         g(m_thread_scope->lock);
 
-    SnapshotRecord::FixedSnapshotRecord<80> snapshot_data;
-    SnapshotRecord sbuf(snapshot_data);
+    // Stage the record in a pooled per-thread buffer; fall back to
+    // stack staging if the pool is exhausted
+
+    Scope::SnapshotBufferPool::Buffer* buf = m_thread_scope->snapshot_pool.acquire(is_signal());
+
+    SnapshotRecord::FixedSnapshotRecord<80> stack_data;
+    SnapshotRecord sbuf = buf ? buf->record() : SnapshotRecord(stack_data);
 
     pull_snapshot(scopes, trigger_info, &sbuf);
 
-    mG->events.process_snapshot(this, trigger_info, &sbuf);
+    // In asynchronous mode, hand the record off to the helper threads.
+    // The trigger info contents are already part of the record.
+    bool enqueued = false;
+
+    if (mG->async_active.load(std::memory_order_relaxed))
+        enqueued = mG->snapshot_queue->enqueue(&sbuf);
+
+    if (!enqueued) {
+        mG->events.pre_process_snapshot_evt(this, trigger_info, &sbuf);
+        mG->events.process_snapshot(this, trigger_info, &sbuf);
+
+        if (!mG->channels.empty())
+            mG->fanout_channels(this, trigger_info, &sbuf);
+
+        mG->events.post_process_snapshot_evt(this, trigger_info, &sbuf);
+    }
+
+    if (buf)
+        m_thread_scope->snapshot_pool.release(buf, sbuf);
 }
 
 
@@ -762,6 +1403,34 @@ Caliper::push_snapshot(int scopes, const SnapshotRecord* trigger_info)
 void
 Caliper::flush(const SnapshotRecord* flush_info, SnapshotFlushFn proc_fn)
 {
+    // End asynchronous processing and drain in-flight records so the
+    // flush sees all snapshots. Helpers drain the queue before
+    // exiting; process any stragglers here.
+
+    if (mG->snapshot_queue) {
+        mG->stop_async_processing();
+
+        SnapshotRecord::Sizes sizes = { 0, 0 };
+
+        SnapshotRecord::FixedSnapshotRecord<SnapshotQueue::MAX_ENTRIES> qdata;
+        SnapshotRecord::FixedSnapshotRecord<SnapshotQueue::MAX_ENTRIES> pdata;
+
+        while (mG->snapshot_queue->dequeue(qdata, sizes)) {
+            SnapshotRecord rec(pdata);
+
+            rec.append(sizes.n_nodes,     qdata.node_array,
+                       sizes.n_immediate, qdata.attr_array, qdata.data_array);
+
+            mG->events.pre_process_snapshot_evt(this, nullptr, &rec);
+            mG->events.process_snapshot(this, nullptr, &rec);
+
+            if (!mG->channels.empty())
+                mG->fanout_channels(this, nullptr, &rec);
+
+            mG->events.post_process_snapshot_evt(this, nullptr, &rec);
+        }
+    }
+
     std::lock_guard<::siglock>
         g(m_thread_scope->lock);
 
@@ -770,15 +1439,24 @@ Caliper::flush(const SnapshotRecord* flush_info, SnapshotFlushFn proc_fn)
     if (mG->events.postprocess_snapshot.empty()) { 
         mG->events.flush_evt(this, flush_info, proc_fn);
     } else {
-        mG->events.flush_evt(this, flush_info, 
+        mG->events.flush_evt(this, flush_info,
                              [this,flush_info,proc_fn](const SnapshotRecord* input_snapshot) {
+                                 Scope::SnapshotBufferPool::Buffer* buf =
+                                     m_thread_scope->snapshot_pool.acquire(false);
+
                                  SnapshotRecord::FixedSnapshotRecord<80> data;
-                                 SnapshotRecord snapshot(data);
+                                 SnapshotRecord snapshot = buf ? buf->record() : SnapshotRecord(data);
 
                                  snapshot.append(*input_snapshot);
 
                                  mG->events.postprocess_snapshot(this, &snapshot);
-                                 return proc_fn(&snapshot);
+
+                                 bool ret = proc_fn(&snapshot);
+
+                                 if (buf)
+                                     m_thread_scope->snapshot_pool.release(buf, snapshot);
+
+                                 return ret;
                              });
     }
 }
@@ -801,8 +1479,10 @@ Caliper::flush_and_write(const SnapshotRecord* input_flush_info)
     std::lock_guard<::siglock>
         g(m_thread_scope->lock);
 
+    Scope::SnapshotBufferPool::Buffer* buf = m_thread_scope->snapshot_pool.acquire(false);
+
     SnapshotRecord::FixedSnapshotRecord<80> snapshot_data;
-    SnapshotRecord flush_info(snapshot_data);
+    SnapshotRecord flush_info = buf ? buf->record() : SnapshotRecord(snapshot_data);
 
     if (input_flush_info)
         flush_info.append(*input_flush_info);
@@ -812,13 +1492,49 @@ Caliper::flush_and_write(const SnapshotRecord* input_flush_info)
 
     mG->events.pre_write_evt(this, &flush_info);
 
-    flush(&flush_info, 
+    flush(&flush_info,
           [this,&flush_info](const SnapshotRecord* snapshot){
               mG->events.write_snapshot(this, &flush_info, snapshot);
               return true;
           });
 
+    if (Health::any()) {
+        // Append the drop accounting to the output, so incomplete
+        // profiles are detectable from the data itself
+
+        Attribute attr[Health::NumCounters];
+        Variant   data[Health::NumCounters];
+        size_t    n = 0;
+
+        for (int i = 0; i < Health::NumCounters; ++i) {
+            Health::Counter hc    = static_cast<Health::Counter>(i);
+            uint64_t        count = Health::count(hc);
+
+            if (count == 0)
+                continue;
+
+            attr[n] = create_attribute(std::string("cali.health.") + Health::counter_name(hc),
+                                       CALI_TYPE_UINT,
+                                       CALI_ATTR_ASVALUE     |
+                                       CALI_ATTR_SKIP_EVENTS |
+                                       CALI_ATTR_SCOPE_PROCESS);
+            data[n] = Variant(count);
+
+            ++n;
+        }
+
+        SnapshotRecord::FixedSnapshotRecord<Health::NumCounters> health_data;
+        SnapshotRecord health_rec(health_data);
+
+        make_entrylist(n, attr, data, health_rec);
+
+        mG->events.write_snapshot(this, &flush_info, &health_rec);
+    }
+
     mG->events.post_write_evt(this, &flush_info);
+
+    if (buf)
+        m_thread_scope->snapshot_pool.release(buf, flush_info);
 }
 
 
@@ -849,27 +1565,249 @@ Caliper::begin(const Attribute& attr, const Variant& data)
     std::lock_guard<::siglock>
         g(m_thread_scope->lock);
 
+    int prop = mG->attribute_properties(attr);
+
     // invoke callbacks
-    if (!attr.skip_events())
+    if (!(prop & CALI_ATTR_SKIP_EVENTS))
         mG->events.pre_begin_evt(this, attr, data);
 
-    Scope* s = scope(attr2caliscope(attr));
+    Scope* s = scope(attr2caliscope(prop));
     ContextBuffer* sb = &s->blackboard;
-    
-    if (attr.store_as_value())
+
+    if (prop & CALI_ATTR_ASVALUE)
         ret = sb->set(attr, data);
-    else
-        ret = sb->set_node(mG->get_key(attr),
+    else {
+        const Attribute& key = mG->get_key(attr, prop);
+
+        ret = sb->set_node(key,
                            m_thread_scope->tree.get_path(1, &attr, &data,
-                                                         sb->get_node(mG->get_key(attr))));
+                                                         sb->get_node(key)));
+    }
 
     // invoke callbacks
-    if (!attr.skip_events())
+    if (!(prop & CALI_ATTR_SKIP_EVENTS))
         mG->events.post_begin_evt(this, attr, data);
 
     return ret;
 }
 
+/// \brief Push a batch of attribute:value pairs on the blackboard.
+///
+/// Like begin(), but applies all updates for each blackboard in a
+/// single transaction, so setting several attributes (e.g. at a task
+/// switch) costs one synchronization per blackboard instead of one per
+/// attribute.
+///
+/// This function is signal safe.
+///
+/// \param n    Number of attribute/value pairs
+/// \param attr Attribute keys
+/// \param data Values to set
+
+cali_err
+Caliper::begin(size_t n, const Attribute attr[], const Variant data[])
+{
+    return update_batch(n, attr, data, true);
+}
+
+/// \brief Push a pre-constructed context tree entry on the blackboard.
+///
+/// Like begin(), but takes the attribute:value pair from a tree entry
+/// that was created beforehand (e.g. with make_tree_entry()), so no
+/// value conversion or node data allocation happens on this path.
+///
+/// This function invokes pre_begin/post_begin callbacks, unless the
+/// CALI_ATTR_SKIP_EVENTS attribute property is set in `attr`.
+///
+/// This function is signal safe.
+///
+/// \param attr Attribute key. Cannot have the AS_VALUE property, and
+///    must match the entry's attribute.
+/// \param node Tree entry to push
+
+cali_err
+Caliper::begin(const Attribute& attr, Node* node)
+{
+    cali_err ret = CALI_EINV;
+
+    if (!mG || !node || attr == Attribute::invalid)
+        return CALI_EINV;
+
+    int prop = mG->attribute_properties(attr);
+
+    if (prop & CALI_ATTR_ASVALUE)
+        return CALI_EINV;
+
+    std::lock_guard<::siglock>
+        g(m_thread_scope->lock);
+
+    // invoke callbacks
+    if (!(prop & CALI_ATTR_SKIP_EVENTS))
+        mG->events.pre_begin_evt(this, attr, node->data());
+
+    Scope* s = scope(attr2caliscope(prop));
+    ContextBuffer* sb = &s->blackboard;
+
+    const Node* nodelist[1] = { node };
+    const Attribute& key = mG->get_key(attr, prop);
+
+    ret = sb->set_node(key,
+                       m_thread_scope->tree.get_path(1, nodelist,
+                                                     sb->get_node(key)));
+
+    // invoke callbacks
+    if (!(prop & CALI_ATTR_SKIP_EVENTS))
+        mG->events.post_begin_evt(this, attr, node->data());
+
+    return ret;
+}
+
+/// \brief Capture the reference (node) entries of this thread's
+/// blackboard in an immutable context handle.
+///
+/// The returned handle is a context tree node chain. It is unaffected
+/// by subsequent blackboard updates, remains valid for the lifetime of
+/// the Caliper runtime, and can be passed to another thread, where
+/// restore_context() re-installs the captured contents (e.g. at a
+/// task switch in a task-based runtime).
+///
+/// Immediate (AS_VALUE) entries are not captured.
+///
+/// This function is signal safe. If all captured entries live under a
+/// single blackboard key (the default with attribute auto-merging),
+/// the capture is O(1) and does not modify the context tree.
+///
+/// \return The context handle. Null if the blackboard holds no
+///    reference entries.
+
+Node*
+Caliper::save_context()
+{
+    if (!mG)
+        return nullptr;
+
+    std::lock_guard<::siglock>
+        g(m_thread_scope->lock);
+
+    SnapshotRecord::FixedSnapshotRecord<32> snapshot_data;
+    SnapshotRecord rec(snapshot_data);
+
+    m_thread_scope->blackboard.snapshot_nodes(&rec);
+
+    size_t n = rec.num_nodes();
+
+    if (n == 0)
+        return nullptr;
+    if (n == 1)
+        return const_cast<Node*>(rec.data().node_entries[0]);
+
+    // Entries under multiple blackboard keys: flatten the chains into
+    // a single path, chain by chain in root-to-leaf order.
+
+    const size_t max_chain = 120;
+
+    Node* path = nullptr;
+
+    for (size_t i = 0; i < n; ++i) {
+        const Node* chain[max_chain];
+        size_t      len = 0;
+
+        for (const Node* node = rec.data().node_entries[i]; node && node->attribute() != CALI_INV_ID; node = node->parent())
+            if (len < max_chain)
+                chain[len++] = node;
+            else
+                Log(1).stream() << "save_context(): context chain too long, dropping entries" << endl;
+
+        std::reverse(chain, chain+len);
+
+        path = m_thread_scope->tree.get_path(len, chain, path);
+    }
+
+    return path;
+}
+
+/// \brief Install the contents of a context handle obtained from
+/// save_context() on this thread's blackboard.
+///
+/// Reference entries for the blackboard keys present in the handle are
+/// replaced; other blackboard contents are left in place. The handle
+/// is not consumed: it remains valid and can be installed again.
+///
+/// No begin/end callbacks are invoked: like a direct blackboard
+/// update, only the snapshot contents change.
+///
+/// This function is signal safe. If all entries in the handle live
+/// under a single blackboard key (the default with attribute
+/// auto-merging), the restore is a single O(1) blackboard update and
+/// does not modify the context tree.
+///
+/// \param context Context handle obtained from save_context()
+
+cali_err
+Caliper::restore_context(Node* context)
+{
+    if (!mG || !context || context->attribute() == CALI_INV_ID)
+        return CALI_EINV;
+
+    std::lock_guard<::siglock>
+        g(m_thread_scope->lock);
+
+    // common case: all entries share one blackboard key, so the chain
+    // can be installed as-is
+
+    Attribute key = mG->get_key(get_attribute(context->attribute()));
+    bool single_key = true;
+
+    for (Node* node = context->parent(); single_key && node && node->attribute() != CALI_INV_ID; node = node->parent())
+        if (!(mG->get_key(get_attribute(node->attribute())) == key))
+            single_key = false;
+
+    if (single_key)
+        return m_thread_scope->blackboard.set_node(key, context);
+
+    // entries under multiple blackboard keys: split the chain into one
+    // path per key and install them in a single transaction
+
+    const size_t max_keys  = 16;
+    const size_t max_chain = 120;
+
+    Attribute keys[max_keys];
+    Node*     heads[max_keys];
+    size_t    n_keys = 0;
+
+    for (Node* node = context; node && node->attribute() != CALI_INV_ID; node = node->parent()) {
+        Attribute k = mG->get_key(get_attribute(node->attribute()));
+        size_t    i = 0;
+
+        while (i < n_keys && !(keys[i] == k))
+            ++i;
+
+        if (i == n_keys) {
+            if (n_keys == max_keys) {
+                Log(0).stream() << "restore_context(): too many blackboard keys in context" << endl;
+                return CALI_EINV;
+            }
+
+            keys[n_keys++] = k;
+        }
+    }
+
+    for (size_t i = 0; i < n_keys; ++i) {
+        const Node* chain[max_chain];
+        size_t      len = 0;
+
+        for (Node* node = context; node && node->attribute() != CALI_INV_ID; node = node->parent())
+            if (mG->get_key(get_attribute(node->attribute())) == keys[i] && len < max_chain)
+                chain[len++] = node;
+
+        std::reverse(chain, chain+len);
+
+        heads[i] = m_thread_scope->tree.get_path(len, chain, nullptr);
+    }
+
+    return m_thread_scope->blackboard.update(n_keys, keys, heads, 0, nullptr, nullptr);
+}
+
 /// \brief Pop/remove top-most entry with given attribute from blackboard.
 ///
 /// This function invokes the pre_end/post_end callbacks, unless the
@@ -887,7 +1825,9 @@ Caliper::end(const Attribute& attr)
 
     cali_err ret = CALI_EINV;
 
-    Scope* s = scope(attr2caliscope(attr));
+    int prop = mG->attribute_properties(attr);
+
+    Scope* s = scope(attr2caliscope(prop));
     ContextBuffer* sb = &s->blackboard;
 
     Entry  e = get(attr);
@@ -899,22 +1839,24 @@ Caliper::end(const Attribute& attr)
         g(m_thread_scope->lock);
 
     // invoke callbacks
-    if (!attr.skip_events())
-        if (!e.is_empty()) // prevent executing events for 
+    if (!(prop & CALI_ATTR_SKIP_EVENTS))
+        if (!e.is_empty()) // prevent executing events for
             mG->events.pre_end_evt(this, attr, e.value());
 
-    if (attr.store_as_value())
+    if (prop & CALI_ATTR_ASVALUE)
         ret = sb->unset(attr);
     else {
-        Node* node = sb->get_node(mG->get_key(attr));
+        const Attribute& key = mG->get_key(attr, prop);
+
+        Node* node = sb->get_node(key);
 
         if (node) {
             node = m_thread_scope->tree.remove_first_in_path(node, attr);
-                
+
             if (node == m_thread_scope->tree.root())
-                ret = sb->unset(mG->get_key(attr));
+                ret = sb->unset(key);
             else if (node)
-                ret = sb->set_node(mG->get_key(attr), node);
+                ret = sb->set_node(key, node);
         }
 
         if (!node)
@@ -922,7 +1864,7 @@ Caliper::end(const Attribute& attr)
     }
 
     // invoke callbacks
-    if (!attr.skip_events())
+    if (!(prop & CALI_ATTR_SKIP_EVENTS))
         mG->events.post_end_evt(this, attr, e.value());
 
     return ret;
@@ -952,28 +1894,172 @@ Caliper::set(const Attribute& attr, const Variant& data)
     std::lock_guard<::siglock>
         g(m_thread_scope->lock);
 
-    Scope* s = scope(attr2caliscope(attr));
+    int prop = mG->attribute_properties(attr);
+
+    Scope* s = scope(attr2caliscope(prop));
     ContextBuffer* sb = &s->blackboard;
 
     // invoke callbacks
-    if (!attr.skip_events())
+    if (!(prop & CALI_ATTR_SKIP_EVENTS))
         mG->events.pre_set_evt(this, attr, data);
 
-    if (attr.store_as_value())
+    if (prop & CALI_ATTR_ASVALUE)
         ret = sb->set(attr, data);
     else {
-        Attribute key = mG->get_key(attr);
-        
+        const Attribute& key = mG->get_key(attr, prop);
+
         ret = sb->set_node(key, m_thread_scope->tree.replace_first_in_path(sb->get_node(key), attr, data));
     }
-    
+
     // invoke callbacks
-    if (!attr.skip_events())
+    if (!(prop & CALI_ATTR_SKIP_EVENTS))
         mG->events.post_set_evt(this, attr, data);
 
     return ret;
 }
 
+/// \brief Set a batch of attribute:value pairs on the blackboard.
+///
+/// Like set(), but applies all updates for each blackboard in a
+/// single transaction, so setting several attributes (e.g. at a task
+/// switch) costs one synchronization per blackboard instead of one per
+/// attribute.
+///
+/// This function is signal safe.
+///
+/// \param n    Number of attribute/value pairs
+/// \param attr Attribute keys
+/// \param data Values to set
+
+cali_err
+Caliper::set(size_t n, const Attribute attr[], const Variant data[])
+{
+    return update_batch(n, attr, data, false);
+}
+
+/// \brief Apply a batch of begin or set updates, grouped by blackboard.
+
+cali_err
+Caliper::update_batch(size_t n, const Attribute attr[], const Variant data[], bool is_begin)
+{
+    static const size_t MAX_BATCH = 16;
+
+    if (n < 1)
+        return CALI_SUCCESS;
+    if (!mG)
+        return CALI_EINV;
+
+    cali_err ret = CALI_SUCCESS;
+
+    // split up large batches
+
+    if (n > MAX_BATCH) {
+        for (size_t i = 0; i < n && ret == CALI_SUCCESS; i += MAX_BATCH)
+            ret = update_batch(std::min<size_t>(MAX_BATCH, n-i), attr+i, data+i, is_begin);
+
+        return ret;
+    }
+
+    std::lock_guard<::siglock>
+        g(m_thread_scope->lock);
+
+    int props[MAX_BATCH];
+
+    for (size_t i = 0; i < n; ++i)
+        props[i] = mG->attribute_properties(attr[i]);
+
+    // invoke callbacks
+
+    for (size_t i = 0; i < n; ++i)
+        if (attr[i] != Attribute::invalid && !(props[i] & CALI_ATTR_SKIP_EVENTS)) {
+            if (is_begin)
+                mG->events.pre_begin_evt(this, attr[i], data[i]);
+            else
+                mG->events.pre_set_evt(this, attr[i], data[i]);
+        }
+
+    // Group the updates by blackboard, build the tree paths, and apply
+    // each blackboard's updates in a single write transaction. Tree
+    // updates for entries sharing a key (e.g. auto-merged attributes)
+    // are chained through the pending node for that key.
+
+    struct BlackboardUpdates {
+        ContextBuffer* sb           { nullptr };
+
+        size_t         n_nodes     { 0 };
+        size_t         n_imm       { 0 };
+
+        Attribute      node_attr[MAX_BATCH];
+        Node*          nodes[MAX_BATCH];
+        Attribute      imm_attr[MAX_BATCH];
+        Variant        values[MAX_BATCH];
+    } updates[3]; // at most one per process/thread/task scope
+
+    size_t n_blackboards = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        if (attr[i] == Attribute::invalid) {
+            ret = CALI_EINV;
+            continue;
+        }
+
+        ContextBuffer* sb = &scope(attr2caliscope(props[i]))->blackboard;
+
+        size_t b = 0;
+        for ( ; b < n_blackboards && updates[b].sb != sb; ++b)
+            ;
+        if (b == n_blackboards)
+            updates[n_blackboards++].sb = sb;
+
+        BlackboardUpdates& u = updates[b];
+
+        if (props[i] & CALI_ATTR_ASVALUE) {
+            u.imm_attr[u.n_imm] = attr[i];
+            u.values[u.n_imm++] = data[i];
+        } else {
+            Attribute key = mG->get_key(attr[i], props[i]);
+
+            size_t k = 0;
+            for ( ; k < u.n_nodes && u.node_attr[k].id() != key.id(); ++k)
+                ;
+
+            Node* node = (k < u.n_nodes) ? u.nodes[k] : sb->get_node(key);
+
+            if (is_begin)
+                node = m_thread_scope->tree.get_path(1, &attr[i], &data[i], node);
+            else
+                node = m_thread_scope->tree.replace_first_in_path(node, attr[i], data[i]);
+
+            if (k < u.n_nodes)
+                u.nodes[k] = node;
+            else {
+                u.node_attr[u.n_nodes] = key;
+                u.nodes[u.n_nodes++]   = node;
+            }
+        }
+    }
+
+    for (size_t b = 0; b < n_blackboards; ++b) {
+        cali_err err = updates[b].sb->update(updates[b].n_nodes, updates[b].node_attr, updates[b].nodes,
+                                             updates[b].n_imm,   updates[b].imm_attr,  updates[b].values);
+
+        if (err != CALI_SUCCESS)
+            ret = err;
+    }
+
+    // invoke callbacks
+
+    for (size_t i = 0; i < n; ++i)
+        if (attr[i] != Attribute::invalid && !(props[i] & CALI_ATTR_SKIP_EVENTS)) {
+            if (is_begin)
+                mG->events.post_begin_evt(this, attr[i], data[i]);
+            else
+                mG->events.post_set_evt(this, attr[i], data[i]);
+        }
+
+    return ret;
+}
+
 /// \brief Set a list of values for attribute \a attr blackboard.
 ///
 /// Sets the given values on the blackboard. Overwrites
@@ -1000,25 +2086,27 @@ Caliper::set_path(const Attribute& attr, size_t n, const Variant* data) {
     std::lock_guard<::siglock>
         g(m_thread_scope->lock);
 
-    Scope* s = scope(attr2caliscope(attr));
+    int prop = mG->attribute_properties(attr);
+
+    Scope* s = scope(attr2caliscope(prop));
     ContextBuffer* sb = &s->blackboard;
 
     // invoke callbacks
-    if (!attr.skip_events())
+    if (!(prop & CALI_ATTR_SKIP_EVENTS))
         mG->events.pre_set_evt(this, attr, data[n-1]);
 
-    if (attr.store_as_value()) {
+    if (prop & CALI_ATTR_ASVALUE) {
         Log(0).stream() << "error: set_path() invoked with immediate-value attribute " << attr.name() << endl;
         ret = CALI_EINV;
     } else {
-        Attribute key = mG->get_key(attr);
-        
+        const Attribute& key = mG->get_key(attr, prop);
+
         ret = sb->set_node(key,
                            m_thread_scope->tree.replace_all_in_path(sb->get_node(key), attr, n, data));
     }
-    
+
     // invoke callbacks
-    if (!attr.skip_events())
+    if (!(prop & CALI_ATTR_SKIP_EVENTS))
         mG->events.post_set_evt(this, attr, data[n-1]);
 
     return ret;
@@ -1046,16 +2134,55 @@ Caliper::get(const Attribute& attr)
     std::lock_guard<::siglock>
         g(m_thread_scope->lock);
 
-    ContextBuffer* sb = &(scope(attr2caliscope(attr))->blackboard);
+    int prop = mG->attribute_properties(attr);
+
+    ContextBuffer* sb = &(scope(attr2caliscope(prop))->blackboard);
 
-    if (attr.store_as_value())
+    if (prop & CALI_ATTR_ASVALUE)
         return Entry(attr, sb->get(attr));
     else
-        return Entry(m_thread_scope->tree.find_node_with_attribute(attr, sb->get_node(mG->get_key(attr))));
+        return Entry(m_thread_scope->tree.find_node_with_attribute(attr, sb->get_node(mG->get_key(attr, prop))));
 
     return e;
 }
 
+/// \brief Retrieve top-most entry for the given attribute key from
+///   the given scope's blackboard.
+///
+/// Like get(), but reads thread- and task-scope attributes from the
+/// blackboard of \a s instead of the calling thread's, e.g. another
+/// thread's scope obtained with default_scope(). The blackboard read
+/// is seqlock-protected and safe against concurrent updates by the
+/// owning thread. Process-scope attributes read the process
+/// blackboard as usual.
+///
+/// \param attr Attribute key.
+/// \param s    Scope whose blackboard to read.
+///
+/// \return The top-most entry on the scope's blackboard for the given
+///         attribute key. An empty Entry object if this attribute is
+///         not set.
+
+Entry
+Caliper::get(const Attribute& attr, Scope* s)
+{
+    if (!mG || attr == Attribute::invalid || !s)
+        return Entry::empty;
+
+    std::lock_guard<::siglock>
+        g(m_thread_scope->lock);
+
+    int prop = mG->attribute_properties(attr);
+
+    ContextBuffer* sb =
+        attr2caliscope(prop) == CALI_SCOPE_PROCESS ? &mG->process_scope->blackboard : &s->blackboard;
+
+    if (prop & CALI_ATTR_ASVALUE)
+        return Entry(attr, sb->get(attr));
+    else
+        return Entry(m_thread_scope->tree.find_node_with_attribute(attr, sb->get_node(mG->get_key(attr, prop))));
+}
+
 // --- Generic entry API
 
 /// \brief Create a snapshot record (entry list) from the given attribute:value pairs
@@ -1076,7 +2203,7 @@ Caliper::make_entrylist(size_t n, const Attribute* attr, const Variant* value, S
     Node* node = 0;
 
     for (size_t i = 0; i < n; ++i)
-        if (attr[i].store_as_value())
+        if (mG->attribute_properties(attr[i]) & CALI_ATTR_ASVALUE)
             list.append(attr[i].id(), value[i]);
         else
             node = m_thread_scope->tree.get_path(1, &attr[i], &value[i], node);
@@ -1109,7 +2236,7 @@ Caliper::make_entry(const Attribute& attr, const Variant& value)
 
     Entry entry { Entry::empty };
 
-    if (attr.store_as_value())
+    if (mG->attribute_properties(attr) & CALI_ATTR_ASVALUE)
         return Entry(attr, value);
     else
         return Entry(m_thread_scope->tree.get_path(1, &attr, &value, nullptr));
@@ -1150,7 +2277,7 @@ Caliper::make_tree_entry(size_t n, const Node* nodelist[], Node* parent)
 Node*
 Caliper::make_tree_entry(const Attribute& attr, const Variant& data, Node*  parent)
 {
-    if (attr.store_as_value())
+    if (mG->attribute_properties(attr) & CALI_ATTR_ASVALUE)
         return nullptr;
 
     std::lock_guard<::siglock>
@@ -1180,6 +2307,40 @@ Caliper::events()
     return mG->events;
 }
 
+/// \brief Return the snapshot channel \a name, creating it on first use.
+///
+/// The channel's trigger filter is read from the channel_<name> config
+/// set at creation. Channels must be created during service
+/// registration, before snapshots are being taken.
+///
+/// \note This function is _not_ signal safe.
+
+Caliper::SnapshotChannel*
+Caliper::channel(const char* name)
+{
+    std::lock_guard<std::mutex>
+        g(mG->channel_lock);
+
+    for (SnapshotChannel* chn : mG->channels)
+        if (chn->name == name)
+            return chn;
+
+    SnapshotChannel* chn = new SnapshotChannel;
+
+    chn->name = name;
+
+    ConfigSet config =
+        RuntimeConfig::init((std::string("channel_") + name).c_str(), GlobalData::s_channel_configdata);
+
+    util::split(config.get("trigger").to_string(), ':', std::back_inserter(chn->triggers));
+
+    mG->channels.push_back(chn);
+
+    Log(2).stream() << "Created snapshot channel \"" << name << "\"" << endl;
+
+    return chn;
+}
+
 /// Exchange value on the blackboard. Atomically updates value for given
 /// attribute key and returns the previous value.
 ///
@@ -1196,7 +2357,7 @@ Caliper::exchange(const Attribute& attr, const Variant& data)
     std::lock_guard<::siglock>
         g(m_thread_scope->lock);
 
-    return scope(attr2caliscope(attr))->blackboard.exchange(attr, data);
+    return scope(attr2caliscope(mG->attribute_properties(attr)))->blackboard.exchange(attr, data);
 }
 
 
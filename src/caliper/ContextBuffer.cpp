@@ -40,86 +40,387 @@
 #include "caliper/common/Attribute.h"
 #include "caliper/common/Node.h"
 
+#include "caliper/common/Log.h"
+#include "caliper/common/RuntimeConfig.h"
+
 #include "caliper/common/util/spinlock.hpp"
 
+#include <unistd.h>
+
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdio>
 #include <mutex>
-#include <vector>
+#include <string>
 
+#include <fstream>
 #include <iostream>
 
 using namespace cali;
 using namespace std;
 
+namespace
+{
+
+const ConfigSet::Entry s_configdata[] = {
+    { "reserved_entries", CALI_TYPE_UINT, "0",
+      "Number of blackboard entries to preallocate per buffer",
+      "Number of blackboard entries to preallocate per buffer.\n"
+      "0 uses the persisted entry high-water mark of previous runs,\n"
+      "if available, and a single slab otherwise."
+    },
+    { "cache_highwater", CALI_TYPE_BOOL, "false",
+      "Persist the blackboard entry high-water mark across runs",
+      "Persist the blackboard entry high-water mark across runs.\n"
+      "Subsequent runs preallocate their blackboard storage from it,\n"
+      "so no growth events occur once the working set is reached."
+    },
+    { "cachefile", CALI_TYPE_STRING, "caliper.blackboard.cache",
+      "Blackboard high-water cache file",
+      "Blackboard high-water cache file"
+    },
+    ConfigSet::Terminator
+};
+
+// process-wide entry high-water over all blackboards, persisted at exit
+std::atomic<unsigned> proc_max_entries { 0 };
+
+void update_proc_max(size_t n) {
+    unsigned v = static_cast<unsigned>(n);
+    unsigned p = proc_max_entries.load(std::memory_order_relaxed);
+
+    while (p < v && !proc_max_entries.compare_exchange_weak(p, v))
+        ;
+}
+
+// Reads the persisted high-water hint at startup and writes the
+// observed high-water back at process exit, using the same temp
+// file + rename publication as the config cache.
+
+struct HighwaterCache {
+    bool        enabled { false };
+    unsigned    stored  { 0 };
+    size_t      reserve { 0 };
+    std::string filename;
+
+    HighwaterCache() {
+        ConfigSet config = RuntimeConfig::init("blackboard", s_configdata);
+
+        enabled  = config.get("cache_highwater").to_bool();
+        filename = config.get("cachefile").to_string();
+        reserve  = config.get("reserved_entries").to_uint();
+
+        if (enabled) {
+            std::ifstream is(filename.c_str());
+            unsigned      hw = 0;
+
+            if (is >> hw) {
+                stored = hw;
+
+                if (reserve == 0)
+                    reserve = hw;
+            }
+        }
+    }
+
+    ~HighwaterCache() {
+        unsigned hw = ::proc_max_entries.load();
+
+        if (!enabled || hw <= stored)
+            return;
+
+        std::string   tmp = filename + ".tmp." + std::to_string(getpid());
+        std::ofstream os(tmp.c_str());
+
+        if (os << hw << std::endl)
+            rename(tmp.c_str(), filename.c_str());
+        else
+            unlink(tmp.c_str());
+    }
+};
+
+HighwaterCache& highwater_cache() {
+    static HighwaterCache cache;
+    return cache;
+}
+
+} // namespace
+
 
 struct ContextBuffer::ContextBufferImpl
 {
-    // --- data
+    // --- constants
+
+    // Storage grows by chaining fixed-size slabs. A slab never moves
+    // once allocated, so lock-free readers never chase reallocated
+    // buffers and growth never copies entries; the fixed slab table
+    // bounds total capacity. Initial slabs are preallocated from the
+    // persisted high-water hint so that steady-state runs see no
+    // growth events at all.
+
+    static constexpr size_t SLAB_SHIFT   = 6;
+    static constexpr size_t SLAB_ENTRIES = 1 << SLAB_SHIFT;
+    static constexpr size_t MAX_SLABS    = 32;
+    static constexpr size_t MAX_KEYS     = MAX_SLABS * SLAB_ENTRIES;
 
-    mutable util::spinlock m_lock;
+    // Snapshot staging capacity. The snapshot machinery caps records
+    // at 80 entries, so larger blackboards cannot fit in a record anyway.
+    static constexpr size_t SNAP_MAX     = 128;
 
-    // m_attr array stores attribute ids for context nodes, hidden entries, and immediate entries
-    // m_data array stores context node ids, hidden values, and immediate data
+    // --- data
+
+    // Reader/writer synchronization uses a seqlock: writers bump m_seq to an
+    // odd value before and an even value after an update, readers retry while
+    // they observe an odd or changing sequence count. Thus, updates (which
+    // run on the blackboard's owner thread in the common case) never wait for
+    // concurrent snapshot() or get() readers. m_wlock serializes writers on
+    // shared (process-scope) buffers only.
+
+    mutable std::atomic<unsigned> m_seq;
+    util::spinlock                m_wlock;
+
+    // Counts updates to the reference (node) portion of the buffer
+    // only. Immediate-value updates (timestamps, counters) leave it
+    // unchanged, so snapshot consumers can keep the serialized node
+    // list memoized and re-read just the immediates. Reads are
+    // made consistent by the m_seq retry loop.
+    std::atomic<unsigned>         m_node_seq;
+
+    // The keys arrays store attribute ids for context nodes, hidden entries, and immediate entries
+    // The data arrays store context node ids, hidden values, and immediate data
     // boundaries within the arrays are defined by m_num_nodes and m_num_hidden
     // attr/data array layout: [ <node attr/ids> ... <hidden attr/values> ... <data attr/values> ]
-    // m_nodes array stores pointers of context nodes
+    // The nodes arrays store pointers of context nodes, kept parallel to
+    //   the other arrays (null for non-node entries): hidden entries can
+    //   be node chains, too
+    // The hidden middle segment holds both value and node entries of
+    // CALI_ATTR_HIDDEN attributes; the snapshot functions copy only the
+    // node and immediate segments, so hidden bookkeeping entries cost
+    // nothing on the snapshot path.
+    // Entry position i lives in slab i / SLAB_ENTRIES at offset
+    // i % SLAB_ENTRIES; the accessor functions below hide the split.
+
+    struct Slab {
+        cali_id_t keys [SLAB_ENTRIES];
+        Variant   attr [SLAB_ENTRIES];
+        Variant   data [SLAB_ENTRIES];
+        Node*     nodes[SLAB_ENTRIES];
+    };
 
-    vector<cali_id_t> m_keys;
+    std::atomic<Slab*> m_slabs[MAX_SLABS];
 
-    vector<Variant>   m_attr;
-    vector<Variant>   m_data;
+    size_t    m_capacity;
 
-    vector<Node*>     m_nodes;
+    // Open-addressing index mapping attribute ids to entry positions,
+    // so begin/end/set find an attribute's entry in O(1) instead of
+    // scanning the key array. Sized at 4x MAX_KEYS to keep probe
+    // sequences short; rebuilt on unset, which shifts positions.
 
-    vector<Variant>::size_type m_num_nodes;
-    vector<Variant>::size_type m_num_hidden;
+    static constexpr size_t INDEX_SIZE = 4 * MAX_KEYS;
+
+    cali_id_t m_idx_key[INDEX_SIZE];
+    uint16_t  m_idx_pos[INDEX_SIZE];
+
+    size_t    m_size;
+
+    size_t    m_num_nodes;
+    size_t    m_num_hidden;
+
+    size_t    m_max_entries;
+
+    bool      m_overflow;
 
-    vector<Variant>::size_type m_max_entries;
-    
     // --- constructor
 
-    ContextBufferImpl() 
-        : m_num_nodes   { 0 },
+    ContextBufferImpl()
+        : m_seq         { 0 },
+          m_node_seq    { 0 },
+          m_capacity    { 0 },
+          m_size        { 0 },
+          m_num_nodes   { 0 },
           m_num_hidden  { 0 },
-          m_max_entries { 0 }
+          m_max_entries { 0 },
+          m_overflow    { false }
+        {
+            for (size_t s = 0; s < MAX_SLABS; ++s)
+                m_slabs[s].store(nullptr, std::memory_order_relaxed);
+
+            std::fill_n(m_idx_key, INDEX_SIZE, CALI_INV_ID);
+
+            // make sure the readers' fallback slab is initialized here,
+            // not on the (potentially signal-context) read path
+            empty_slab();
+
+            size_t reserve = std::min(::highwater_cache().reserve, MAX_KEYS + 0);
+
+            do {
+                grow();
+            } while (m_capacity < reserve);
+        }
+
+    ~ContextBufferImpl()
         {
-            m_keys.reserve(64);
-            m_attr.reserve(64);
-            m_data.reserve(64);
+            ::update_proc_max(m_max_entries);
 
-            m_nodes.reserve(32);
+            for (size_t s = 0; s < MAX_SLABS; ++s)
+                delete m_slabs[s].load(std::memory_order_relaxed);
         }
 
+    // --- slab storage accessors
+
+    static const Slab& empty_slab() {
+        static const Slab empty {};
+        return empty;
+    }
+
+    /// Chain another slab. Returns false when the slab table is full.
+    bool grow() {
+        size_t s = m_capacity >> SLAB_SHIFT;
+
+        if (s >= MAX_SLABS)
+            return false;
+
+        Slab* slab = new Slab;
+
+        std::fill_n(slab->keys,  SLAB_ENTRIES, CALI_INV_ID);
+        std::fill_n(slab->nodes, SLAB_ENTRIES, nullptr);
+
+        m_slabs[s].store(slab, std::memory_order_release);
+
+        m_capacity += SLAB_ENTRIES;
+
+        return true;
+    }
+
+    // Readers can race with grow() and observe entry positions beyond
+    // the slabs they see published; they fall back to the empty slab
+    // then. The values read are discarded by the seqlock retry, the
+    // fallback only keeps the access fault-free.
+
+    const Slab* reader_slab(size_t i) const {
+        const Slab* s = m_slabs[i >> SLAB_SHIFT].load(std::memory_order_acquire);
+        return s ? s : &empty_slab();
+    }
+
+    Slab* writer_slab(size_t i) {
+        return m_slabs[i >> SLAB_SHIFT].load(std::memory_order_relaxed);
+    }
+
+    cali_id_t& key_entry (size_t i)       { return writer_slab(i)->keys [i & (SLAB_ENTRIES-1)]; }
+    Variant&   attr_entry(size_t i)       { return writer_slab(i)->attr [i & (SLAB_ENTRIES-1)]; }
+    Variant&   data_entry(size_t i)       { return writer_slab(i)->data [i & (SLAB_ENTRIES-1)]; }
+    Node*&     node_entry(size_t i)       { return writer_slab(i)->nodes[i & (SLAB_ENTRIES-1)]; }
+
+    cali_id_t  key_entry (size_t i) const { return reader_slab(i)->keys [i & (SLAB_ENTRIES-1)]; }
+    Variant    data_entry(size_t i) const { return reader_slab(i)->data [i & (SLAB_ENTRIES-1)]; }
+    Node*      node_entry(size_t i) const { return reader_slab(i)->nodes[i & (SLAB_ENTRIES-1)]; }
+
+    // --- attribute index helpers
+
+    /// Return the entry position for \a id, or MAX_KEYS if not present
+    size_t index_find(cali_id_t id) const {
+        size_t h = id & (INDEX_SIZE-1);
+
+        for (size_t p = 0; p < INDEX_SIZE; ++p, h = (h+1) & (INDEX_SIZE-1)) {
+            if (m_idx_key[h] == id)
+                return m_idx_pos[h];
+            if (m_idx_key[h] == CALI_INV_ID)
+                break;
+        }
+
+        return MAX_KEYS;
+    }
+
+    /// Insert or update the index entry for \a id
+    void index_set(cali_id_t id, size_t pos) {
+        size_t h = id & (INDEX_SIZE-1);
+
+        while (m_idx_key[h] != id && m_idx_key[h] != CALI_INV_ID)
+            h = (h+1) & (INDEX_SIZE-1);
+
+        m_idx_key[h] = id;
+        m_idx_pos[h] = static_cast<uint16_t>(pos);
+    }
+
+    void index_rebuild() {
+        std::fill_n(m_idx_key, INDEX_SIZE, CALI_INV_ID);
+
+        for (size_t i = 0; i < m_size; ++i)
+            index_set(key_entry(i), i);
+    }
+
+    /// Swap the entries at positions \a a and \a b in all entry arrays
+    void swap_entries(size_t a, size_t b) {
+        std::swap(key_entry(a),  key_entry(b));
+        std::swap(attr_entry(a), attr_entry(b));
+        std::swap(data_entry(a), data_entry(b));
+        std::swap(node_entry(a), node_entry(b));
+    }
+
+    // --- seqlock helpers
+
+    unsigned read_begin() const {
+        unsigned s;
+
+        while ((s = m_seq.load(std::memory_order_acquire)) & 1)
+            ;
+
+        return s;
+    }
+
+    bool read_retry(unsigned s) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return m_seq.load(std::memory_order_relaxed) != s;
+    }
+
+    void write_begin() {
+        m_wlock.lock();
+        m_seq.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void write_end() {
+        m_seq.fetch_add(1, std::memory_order_release);
+        m_wlock.unlock();
+    }
+
     // --- interface
 
     Variant get(const Attribute& attr) const {
         Variant ret;
 
-        std::lock_guard<util::spinlock> lock(m_lock);
+        unsigned s;
 
-        auto it = std::find(m_keys.begin(), m_keys.end(), attr.id());
+        do {
+            s = read_begin();
 
-        if (it != m_keys.end())
-            ret = m_data[it-m_keys.begin()];
+            ret = Variant();
+
+            size_t n = index_find(attr.id());
+
+            if (n < m_size)
+                ret = data_entry(n);
+        } while (read_retry(s));
 
         return ret;
     }
 
     Node* get_node(const Attribute& attr) const {
-        Node* ret = nullptr;
+        Node* ret;
 
-        std::lock_guard<util::spinlock> lock(m_lock);
+        unsigned s;
 
-        auto end = m_keys.begin() + m_num_nodes;
-        auto it  = std::find(m_keys.begin(), end, attr.id());
+        do {
+            s = read_begin();
 
-        if (it != end) {
-            vector<Variant>::size_type n = it - m_keys.begin();
+            ret = nullptr;
 
-            assert(n < m_nodes.size());
-            ret = m_nodes[n];
-        }
+            size_t n = index_find(attr.id());
+
+            if (n < m_size)
+                ret = node_entry(n);
+        } while (read_retry(s));
 
         return ret;
     }
@@ -128,17 +429,19 @@ struct ContextBuffer::ContextBufferImpl
         Variant ret;
 
         {
-            std::lock_guard<util::spinlock> lock(m_lock);
+            write_begin();
 
             // Only handle immediate or hidden entries for now
-            auto it = std::find(m_keys.begin() + m_num_nodes, m_keys.end(), attr.id());
+            size_t n = index_find(attr.id());
 
-            if (it != m_keys.end()) {
-                ret = m_data[it-m_keys.begin()];
-                m_data[it-m_keys.begin()] = value;
+            if (n >= m_num_nodes && n < m_size) {
+                ret = data_entry(n);
+                data_entry(n) = value;
             }
+
+            write_end();
         }
-        
+
         if (ret.empty())
             set(attr, value);
 
@@ -146,144 +449,361 @@ struct ContextBuffer::ContextBufferImpl
     }
 
     cali_err set(const Attribute& attr, const Variant& value) {
-        std::lock_guard<util::spinlock> lock(m_lock);
+        write_begin();
+
+        cali_err ret = set_unlocked(attr, value);
 
-        auto it = std::find(m_keys.begin(), m_keys.end(), attr.id());
+        write_end();
 
-        if (it != m_keys.end()) {
+        return ret;
+    }
+
+    cali_err set_unlocked(const Attribute& attr, const Variant& value) {
+        cali_err ret = CALI_SUCCESS;
+
+        size_t pos = index_find(attr.id());
+
+        if (pos < m_size) {
             // Update entry
 
-            m_data[it - m_keys.begin()] = value;
+            if (pos < m_num_nodes)
+                m_node_seq.fetch_add(1, std::memory_order_relaxed);
+
+            data_entry(pos) = value;
+        } else if (m_size >= m_capacity && !grow()) {
+            ret = overflow();
         } else {
             // Add new entry
 
-            m_keys.push_back(attr.id());
-            m_attr.push_back(Variant(attr.id()));
-            m_data.push_back(value);
+            size_t n = m_size++;
 
-            if (!attr.store_as_value()) {
-                // this is a node, move it up front
+            key_entry(n)  = attr.id();
+            attr_entry(n) = Variant(attr.id());
+            data_entry(n) = value;
+            node_entry(n) = nullptr;
+
+            if (attr.is_hidden()) {
+                // move "hidden" entry to the middle
 
-                m_nodes.push_back(nullptr);
+                auto h = m_num_nodes + m_num_hidden;
 
-                if (m_num_nodes < m_keys.size()-1) {
-                    std::swap(m_keys.back(), m_keys[m_num_nodes]);
-                    std::swap(m_attr.back(), m_attr[m_num_nodes]);
-                    std::swap(m_data.back(), m_data[m_num_nodes]);
+                if (h < n) {
+                    swap_entries(n, h);
+                    index_set(key_entry(n), n);
                 }
 
-                ++m_num_nodes;
-            } else if (attr.is_hidden()) {
-                // move "hidden" entry to the middle
-                
-                auto n = m_num_nodes + m_num_hidden;
+                index_set(attr.id(), h);
+
+                ++m_num_hidden;
+            } else if (!attr.store_as_value()) {
+                // this is a node, move it up front
+
+                m_node_seq.fetch_add(1, std::memory_order_relaxed);
+
+                if (m_num_nodes < n)
+                    swap_entries(n, m_num_nodes);
+                if (m_num_hidden > 0) {
+                    auto h = m_num_nodes + m_num_hidden;
 
-                if (n < m_keys.size()-1) {
-                    std::swap(m_keys.back(), m_keys[n]);
-                    std::swap(m_attr.back(), m_attr[n]);
-                    std::swap(m_data.back(), m_data[n]);
+                    swap_entries(n, h);
+                    index_set(key_entry(h), h);
                 }
 
-                ++m_num_hidden;
+                index_set(attr.id(), m_num_nodes);
+
+                if (key_entry(n) != attr.id())
+                    index_set(key_entry(n), n);
+
+                ++m_num_nodes;
+            } else {
+                index_set(attr.id(), n);
             }
         }
 
-        m_max_entries = std::max(m_max_entries, m_attr.size());
-        
-        return CALI_SUCCESS;
+        if (m_size > m_max_entries) {
+            m_max_entries = m_size;
+            // feed the process-wide high-water eagerly: exit-time
+            // destructor ordering is not reliable enough to collect it
+            ::update_proc_max(m_size);
+        }
+
+        return ret;
     }
 
     cali_err set_node(const Attribute& attr, Node* node) {
         if (!node || attr.store_as_value())
             return CALI_EINV;
 
-        std::lock_guard<util::spinlock> lock(m_lock);
+        write_begin();
 
-        auto end = m_keys.begin() + m_num_nodes;
-        auto it  = std::find(m_keys.begin(), end, attr.id());
+        cali_err ret = set_node_unlocked(attr, node);
 
-        if (it != end) {
-            // Update entry
+        write_end();
+
+        return ret;
+    }
+
+    cali_err set_node_unlocked(const Attribute& attr, Node* node) {
+        if (!node || attr.store_as_value())
+            return CALI_EINV;
+
+        cali_err ret = CALI_SUCCESS;
+
+        size_t pos = index_find(attr.id());
 
-            vector<Variant>::size_type n = it - m_keys.begin();
+        if (pos < m_size) {
+            // Update entry
 
-            assert(n < m_nodes.size());
+            if (pos < m_num_nodes)
+                m_node_seq.fetch_add(1, std::memory_order_relaxed);
 
-            m_data[n]  = Variant(node->id());
-            m_nodes[n] = node;
+            data_entry(pos)  = Variant(node->id());
+            node_entry(pos)  = node;
+        } else if (m_size >= m_capacity && !grow()) {
+            ret = overflow();
         } else {
             // Add new entry
 
-            m_keys.emplace_back(attr.id());
-            m_attr.emplace_back(Variant(attr.id()));
-            m_data.emplace_back(node->id());
+            size_t n = m_size++;
 
-            m_nodes.push_back(node);
+            key_entry(n)  = attr.id();
+            attr_entry(n) = Variant(attr.id());
+            data_entry(n) = Variant(node->id());
+            node_entry(n) = node;
 
-            // this is a node, move entry in attr/data array up front
+            if (attr.is_hidden()) {
+                // hidden node chain: keep it in the middle segment
+                // that the snapshot functions skip
 
-            if (m_num_nodes < m_keys.size()-1) {
-                std::swap(m_keys.back(), m_keys[m_num_nodes]);
-                std::swap(m_attr.back(), m_attr[m_num_nodes]);
-                std::swap(m_data.back(), m_data[m_num_nodes]);
-            }
-            if (m_num_hidden > 0) {
-                std::swap(m_keys.back(), m_keys[m_num_nodes+m_num_hidden]);
-                std::swap(m_attr.back(), m_attr[m_num_nodes+m_num_hidden]);
-                std::swap(m_data.back(), m_data[m_num_nodes+m_num_hidden]);
+                auto h = m_num_nodes + m_num_hidden;
+
+                if (h < n) {
+                    swap_entries(n, h);
+                    index_set(key_entry(n), n);
+                }
+
+                index_set(attr.id(), h);
+
+                ++m_num_hidden;
+            } else {
+                // this is a node, move entry in attr/data array up front
+
+                m_node_seq.fetch_add(1, std::memory_order_relaxed);
+
+                if (m_num_nodes < n)
+                    swap_entries(n, m_num_nodes);
+                if (m_num_hidden > 0) {
+                    auto h = m_num_nodes + m_num_hidden;
+
+                    swap_entries(n, h);
+                    index_set(key_entry(h), h);
+                }
+
+                index_set(attr.id(), m_num_nodes);
+
+                if (key_entry(n) != attr.id())
+                    index_set(key_entry(n), n);
+
+                ++m_num_nodes;
             }
+        }
 
-            ++m_num_nodes;
+        if (m_size > m_max_entries) {
+            m_max_entries = m_size;
+            ::update_proc_max(m_size);
         }
 
-        m_max_entries = std::max(m_max_entries, m_attr.size());
+        return ret;
+    }
+
+    cali_err update(size_t n_nodes, const Attribute node_attr[], Node* const nodes[],
+                    size_t n_imm,   const Attribute imm_attr[],  const Variant values[]) {
+        cali_err ret = CALI_SUCCESS;
+
+        write_begin();
 
-        return CALI_SUCCESS;
+        for (size_t i = 0; i < n_nodes && ret == CALI_SUCCESS; ++i)
+            ret = set_node_unlocked(node_attr[i], nodes[i]);
+        for (size_t i = 0; i < n_imm   && ret == CALI_SUCCESS; ++i)
+            ret = set_unlocked(imm_attr[i], values[i]);
+
+        write_end();
+
+        return ret;
     }
 
     cali_err unset(const Attribute& attr) {
         cali_err ret = CALI_SUCCESS;
 
-        std::lock_guard<util::spinlock> lock(m_lock);
-
-        auto it = std::find(m_keys.begin(), m_keys.end(), attr.id());
+        write_begin();
 
-        if (it != m_keys.end()) {
-            vector<Variant>::size_type n = it - m_keys.begin();
+        size_t n = index_find(attr.id());
 
-            m_keys.erase(it);
-            m_attr.erase(m_attr.begin() + n);
-            m_data.erase(m_data.begin() + n);
+        if (n < m_size) {
+            if (n < m_num_nodes)
+                m_node_seq.fetch_add(1, std::memory_order_relaxed);
 
-            if (n < m_nodes.size())
-                m_nodes.erase(m_nodes.begin() + n);
+            for (size_t i = n; i + 1 < m_size; ++i) {
+                key_entry(i)  = key_entry(i+1);
+                attr_entry(i) = attr_entry(i+1);
+                data_entry(i) = data_entry(i+1);
+                node_entry(i) = node_entry(i+1);
+            }
 
             if (n < m_num_nodes)
                 --m_num_nodes;
             else if (n < m_num_nodes + m_num_hidden)
                 --m_num_hidden;
+
+            --m_size;
+            node_entry(m_size) = nullptr;
+
+            // removal shifts the entries behind n
+            index_rebuild();
         }
 
+        write_end();
+
         return ret;
     }
 
-    void snapshot(SnapshotRecord* sbuf) const {
-        std::lock_guard<util::spinlock> lock(m_lock);
+    void clear() {
+        write_begin();
 
-        cali::Node* const*   nodeptr = m_num_nodes > 0 ? m_nodes.data() : nullptr;
+        m_node_seq.fetch_add(1, std::memory_order_relaxed);
 
-        size_t p = m_num_nodes + m_num_hidden;
-        size_t n = m_data.size() - p;
+        m_size       = 0;
+        m_num_nodes  = 0;
+        m_num_hidden = 0;
+        m_overflow   = false;
 
-        const cali_id_t*     attrptr = n > 0 ? m_keys.data() + p : nullptr;
-        const cali::Variant* dataptr = n > 0 ? m_data.data() + p : nullptr;
+        for (size_t s = 0; s < MAX_SLABS; ++s) {
+            Slab* slab = m_slabs[s].load(std::memory_order_relaxed);
 
-        if (m_num_nodes + n > 0)
-            sbuf->append(m_num_nodes, nodeptr, n, attrptr, dataptr);
+            if (!slab)
+                break;
+
+            std::fill_n(slab->keys,  SLAB_ENTRIES, CALI_INV_ID);
+            std::fill_n(slab->nodes, SLAB_ENTRIES, nullptr);
+        }
+
+        std::fill_n(m_idx_key, INDEX_SIZE, CALI_INV_ID);
+
+        write_end();
+    }
+
+    unsigned snapshot(SnapshotRecord* sbuf) const {
+        // Stage a consistent copy of the buffer contents locally, then
+        // append to the snapshot record outside the retry loop. The
+        // size clamps keep all accesses in bounds even when a
+        // concurrent update is observed mid-write; inconsistent
+        // contents are discarded by the retry.
+
+        Node*     nodes[SNAP_MAX];
+        cali_id_t attr[SNAP_MAX];
+        Variant   data[SNAP_MAX];
+
+        size_t num_nodes, n;
+
+        unsigned s;
+
+        do {
+            s = read_begin();
+
+            size_t size = std::min(m_size, MAX_KEYS + 0);
+            size_t nn   = std::min(m_num_nodes, size);
+            size_t p    = std::min(nn + m_num_hidden, size);
+
+            num_nodes = std::min(nn, SNAP_MAX + 0);
+            n         = std::min(size - p, SNAP_MAX + 0);
+
+            for (size_t i = 0; i < num_nodes; ++i)
+                nodes[i] = node_entry(i);
+            for (size_t i = 0; i < n; ++i) {
+                attr[i] = key_entry(p+i);
+                data[i] = data_entry(p+i);
+            }
+        } while (read_retry(s));
+
+        if (num_nodes + n > 0)
+            sbuf->append(num_nodes, nodes, n, attr, data);
+
+        // the observed sequence number identifies the serialized contents
+        return s;
+    }
+
+    unsigned snapshot_nodes(SnapshotRecord* sbuf) const {
+        Node*    nodes[SNAP_MAX];
+
+        size_t   num_nodes;
+        unsigned s, node_s;
+
+        do {
+            s      = read_begin();
+            node_s = m_node_seq.load(std::memory_order_relaxed);
+
+            num_nodes = std::min(std::min(m_num_nodes, MAX_KEYS + 0), SNAP_MAX + 0);
+
+            for (size_t i = 0; i < num_nodes; ++i)
+                nodes[i] = node_entry(i);
+        } while (read_retry(s));
+
+        if (num_nodes > 0)
+            sbuf->append(num_nodes, nodes, 0, nullptr, nullptr);
+
+        return node_s;
+    }
+
+    void snapshot_immediates(SnapshotRecord* sbuf) const {
+        cali_id_t attr[SNAP_MAX];
+        Variant   data[SNAP_MAX];
+
+        size_t   n;
+        unsigned s;
+
+        do {
+            s = read_begin();
+
+            size_t size = std::min(m_size, MAX_KEYS + 0);
+            size_t p    = std::min(m_num_nodes + m_num_hidden, size);
+
+            n = std::min(size - p, SNAP_MAX + 0);
+
+            for (size_t i = 0; i < n; ++i) {
+                attr[i] = key_entry(p+i);
+                data[i] = data_entry(p+i);
+            }
+        } while (read_retry(s));
+
+        if (n > 0)
+            sbuf->append(n, attr, data);
+    }
+
+    unsigned generation() const {
+        return m_seq.load(std::memory_order_acquire);
+    }
+
+    unsigned node_generation() const {
+        return m_node_seq.load(std::memory_order_acquire);
+    }
+
+    cali_err overflow() {
+        if (!m_overflow) {
+            m_overflow = true;
+            Log(0).stream() << "Blackboard buffer overflow: dropping update. "
+                            << "Consider reducing the number of distinct attributes." << std::endl;
+        }
+
+        return CALI_ESTACK;
     }
 
     std::ostream& print_statistics(std::ostream& os) const {
-        os << "Blackboard buffer: max " << m_max_entries << " entries";
+        // feed the high-water persistence here as well: long-lived
+        // buffers may never run their destructor before process exit
+        ::update_proc_max(m_max_entries);
+
+        os << "Blackboard buffer: max " << m_max_entries << " entries ("
+           << m_capacity << " allocated)";
 
         return os;
     }
@@ -328,14 +848,45 @@ cali_err ContextBuffer::set(const Attribute& attr, const Variant& data)
     return mP->set(attr, data);
 }
 
+cali_err ContextBuffer::update(size_t n_nodes, const Attribute node_attr[], Node* const nodes[],
+                               size_t n_imm,   const Attribute imm_attr[],  const Variant values[])
+{
+    return mP->update(n_nodes, node_attr, nodes, n_imm, imm_attr, values);
+}
+
 cali_err ContextBuffer::unset(const Attribute& attr)
 {
     return mP->unset(attr);
 }
 
-void ContextBuffer::snapshot(SnapshotRecord* sbuf) const
+void ContextBuffer::clear()
+{
+    mP->clear();
+}
+
+unsigned ContextBuffer::snapshot(SnapshotRecord* sbuf) const
+{
+    return mP->snapshot(sbuf);
+}
+
+unsigned ContextBuffer::snapshot_nodes(SnapshotRecord* sbuf) const
+{
+    return mP->snapshot_nodes(sbuf);
+}
+
+void ContextBuffer::snapshot_immediates(SnapshotRecord* sbuf) const
+{
+    mP->snapshot_immediates(sbuf);
+}
+
+unsigned ContextBuffer::generation() const
+{
+    return mP->generation();
+}
+
+unsigned ContextBuffer::node_generation() const
 {
-    mP->snapshot(sbuf);
+    return mP->node_generation();
 }
 
 std::ostream& ContextBuffer::print_statistics(std::ostream& os) const
@@ -72,11 +72,46 @@ public:
     cali_err set(const Attribute&, const Variant&);
     cali_err unset(const Attribute&);
 
+    /// \brief Remove all entries.
+    void     clear();
+
+    /// \brief Apply a batch of node and immediate updates in a single
+    ///   write transaction.
+    cali_err update(size_t n_nodes, const Attribute node_attr[], Node* const nodes[],
+                    size_t n_imm,   const Attribute imm_attr[],  const Variant values[]);
+
     /// @}
     /// @name get context
     /// @{
 
-    void     snapshot(SnapshotRecord* sbuf) const;
+    /// \brief Append the blackboard contents to \a sbuf.
+    /// \return The blackboard generation of the serialized contents;
+    ///   see generation().
+    unsigned snapshot(SnapshotRecord* sbuf) const;
+
+    /// \brief Append only the reference (node) entries to \a sbuf.
+    /// \return The node generation of the serialized contents;
+    ///   see node_generation().
+    unsigned snapshot_nodes(SnapshotRecord* sbuf) const;
+
+    /// \brief Append only the immediate-value entries to \a sbuf.
+    void     snapshot_immediates(SnapshotRecord* sbuf) const;
+
+    /// \brief Return the blackboard's generation counter.
+    ///
+    /// The generation changes with every blackboard update; equal
+    /// generations identify unchanged contents. Snapshot consumers can
+    /// use this to skip re-serializing an unchanged blackboard.
+    unsigned generation() const;
+
+    /// \brief Return the generation counter of the reference (node)
+    ///   entries.
+    ///
+    /// Unlike generation(), this counter is unaffected by
+    /// immediate-value updates: equal node generations identify an
+    /// unchanged node list, even while timestamps or counters on the
+    /// blackboard keep changing.
+    unsigned node_generation() const;
 
     /// @}
     /// @name Statistics
@@ -32,15 +32,39 @@
 
 #include "MemoryPool.h"
 
+#include "caliper/caliper-config.h"
+
+#include "caliper/common/Log.h"
+#include "caliper/common/MemoryBudget.h"
 #include "caliper/common/RuntimeConfig.h"
 
+#include "caliper/common/util/hugealloc.hpp"
 #include "caliper/common/util/spinlock.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <cstring>
 #include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef CALIPER_HAVE_LIBNUMA
+#include <numaif.h>
+
+#include <map>
+#include <unistd.h>
+#endif
+
 
 using namespace cali;
 using namespace std;
@@ -52,45 +76,271 @@ struct MemoryPool::MemoryPoolImpl
 
     const size_t chunksize = 64 * 1024;
 
+    // Size of the per-thread arenas carved off the global pool. The
+    // common-case allocate() is a lock-free pointer bump within the
+    // calling thread's arena; only arena refills take the pool lock.
+    static const size_t arenasize = 8 * 1024;
+
+    struct Arena {
+        MemoryPoolImpl* owner;
+        uint64_t        gen;
+
+        uint64_t*       ptr;
+        size_t          wmark;
+        size_t          size;
+    };
+
+    static thread_local Arena   s_arena;
+    static std::atomic<uint64_t> s_pool_gen;
+
     static const ConfigSet::Entry s_configdata[];
 
-    template<typename T> 
+    template<typename T>
     struct Chunk {
         T*     ptr;
         size_t wmark;
         size_t size;
+        bool   shm;
+    };
+
+    // --- Shared-memory segment (memory.shm)
+    //
+    // With memory.shm, the first Caliper process on a node creates a
+    // POSIX shared-memory segment and carves its pool chunks from it.
+    // Later local processes attach the segment read-only at the
+    // creator's base address, so pointers into the shared pool resolve
+    // in every attached process; their own pools fall back to regular
+    // private chunks automatically.
+
+    struct ShmSegmentHeader {
+        std::atomic<uint64_t> magic; // written last by the creator
+        std::atomic<uint64_t> wmark; // offset of the first free byte
+        uint64_t              size;  // total segment size in bytes
+        uint64_t              base;  // the creator's mapping address
+    };
+
+    struct ShmSegment {
+        ShmSegmentHeader* header  = nullptr;
+        size_t            size    = 0;
+        bool              creator = false;
+        std::string       name;
+
+        ~ShmSegment();
     };
 
+    static const uint64_t s_shm_magic = 0x43414c49504f4f4cull; // "CALIPOOL"
+
+    static std::mutex     s_shm_mutex;
+    static ShmSegment     s_shm;
+    static bool           s_shm_init;
+
     ConfigSet                 m_config;
 
     util::spinlock            m_lock;
-        
+
     vector< Chunk<uint64_t> > m_chunks;
     size_t                    m_index;
     bool                      m_can_expand;
+    bool                      m_use_hugepages;
+
+    uint64_t                  m_gen;
 
     size_t                    m_total_reserved;
     size_t                    m_total_used;
-    
-    // --- interface 
+
+    // --- interface
+
+#ifdef __linux__
+    static bool shm_create(const std::string& name, size_t size) {
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+
+        if (fd < 0)
+            return false; // segment exists already: attach instead
+
+        if (ftruncate(fd, size) < 0) {
+            Log(0).stream() << "Cannot size shared-memory segment " << name
+                            << ": " << strerror(errno) << std::endl;
+            close(fd);
+            shm_unlink(name.c_str());
+            return true;
+        }
+
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        close(fd);
+
+        if (p == MAP_FAILED) {
+            Log(0).stream() << "Cannot map shared-memory segment " << name
+                            << ": " << strerror(errno) << std::endl;
+            shm_unlink(name.c_str());
+            return true;
+        }
+
+        ShmSegmentHeader* h = static_cast<ShmSegmentHeader*>(p);
+
+        h->size  = size;
+        h->base  = reinterpret_cast<uint64_t>(p);
+        h->wmark.store((sizeof(ShmSegmentHeader) + 63) & ~static_cast<size_t>(63),
+                       std::memory_order_relaxed);
+
+        // the magic is written last: attaching processes wait for it
+        h->magic.store(s_shm_magic, std::memory_order_release);
+
+        s_shm.header  = h;
+        s_shm.size    = size;
+        s_shm.creator = true;
+        s_shm.name    = name;
+
+        Log(1).stream() << "Created shared-memory metadata segment " << name
+                        << " (" << size << " bytes)" << std::endl;
+
+        return true;
+    }
+
+    static void shm_attach(const std::string& name) {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+
+        if (fd < 0) {
+            Log(0).stream() << "Cannot open shared-memory segment " << name
+                            << ": " << strerror(errno) << std::endl;
+            return;
+        }
+
+        // map the header first to learn the segment size and the
+        // creator's base address
+
+        size_t pagesize = sysconf(_SC_PAGESIZE);
+
+        void* hp = mmap(nullptr, pagesize, PROT_READ, MAP_SHARED, fd, 0);
+
+        if (hp == MAP_FAILED) {
+            Log(0).stream() << "Cannot map shared-memory segment " << name
+                            << ": " << strerror(errno) << std::endl;
+            close(fd);
+            return;
+        }
+
+        ShmSegmentHeader* h = static_cast<ShmSegmentHeader*>(hp);
+
+        // wait for the creator to finish segment setup
+        for (int retry = 0; h->magic.load(std::memory_order_acquire) != s_shm_magic && retry < 500; ++retry)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        if (h->magic.load(std::memory_order_acquire) != s_shm_magic) {
+            Log(0).stream() << "Shared-memory segment " << name
+                            << " was not initialized" << std::endl;
+            munmap(hp, pagesize);
+            close(fd);
+            return;
+        }
+
+        size_t size = h->size;
+        void*  base = reinterpret_cast<void*>(h->base);
+
+        munmap(hp, pagesize);
+
+        // map the full segment at the creator's address so that
+        // pointers into the shared pool resolve here, too
+
+        void* p = mmap(base, size, PROT_READ, MAP_SHARED, fd, 0);
+
+        close(fd);
+
+        if (p == MAP_FAILED || p != base) {
+            Log(0).stream() << "Cannot map shared-memory segment " << name
+                            << " at the creator's address" << std::endl;
+            if (p != MAP_FAILED)
+                munmap(p, size);
+            return;
+        }
+
+        s_shm.header  = static_cast<ShmSegmentHeader*>(p);
+        s_shm.size    = size;
+        s_shm.creator = false;
+        s_shm.name    = name;
+
+        Log(1).stream() << "Attached shared-memory metadata segment " << name
+                        << " (" << size << " bytes, read-only)" << std::endl;
+    }
+#endif
+
+    static void shm_init(const ConfigSet& config) {
+        std::lock_guard<std::mutex> lock(s_shm_mutex);
+
+        if (s_shm_init)
+            return;
+
+        s_shm_init = true;
+
+        if (!config.get("shm").to_bool())
+            return;
+
+#ifdef __linux__
+        std::string name = config.get("shm_segment").to_string();
+        size_t      size = config.get("shm_size").to_uint();
+
+        if (!shm_create(name, size))
+            shm_attach(name);
+#else
+        Log(1).stream() << "memory.shm is not supported on this platform" << std::endl;
+#endif
+    }
+
+    // Carve a pool chunk out of the shared segment. Returns nullptr
+    // when there is no segment, the segment is full, or this process
+    // attached it read-only.
+    static void* shm_allocate_chunk(size_t rsz) {
+        if (!s_shm.header || !s_shm.creator)
+            return nullptr;
+
+        std::lock_guard<std::mutex> lock(s_shm_mutex);
+
+        ShmSegmentHeader* h = s_shm.header;
+        uint64_t          w = h->wmark.load(std::memory_order_relaxed);
+
+        if (w + rsz > h->size)
+            return nullptr;
+
+        h->wmark.store(w + rsz, std::memory_order_relaxed);
+
+        return reinterpret_cast<char*>(h) + w;
+    }
+
+    // Chunk memory is mapped untouched, so each page is physically
+    // placed on the NUMA node of the thread that first writes to it -
+    // i.e., the owner of the arena carved out of it - rather than the
+    // node of the thread that happened to grow the pool.
+    // With memory.hugepages, chunks are rounded up to hugepage
+    // multiples and marked for transparent hugepage backing.
 
     void expand(size_t bytes) {
         size_t len = max((bytes+sizeof(uint64_t)-1)/sizeof(uint64_t), chunksize);
+        size_t rsz = util::region_size(len * sizeof(uint64_t), m_use_hugepages);
+
+        len = rsz / sizeof(uint64_t);
+
+        // Carve the chunk out of the shared segment if we created one;
+        // else (also when the segment is full) use a private region
+        void* p   = shm_allocate_chunk(rsz);
+        bool  shm = (p != nullptr);
 
-        m_chunks.push_back( { new uint64_t[len], 0, len } );
+        if (!p)
+            p = util::alloc_region(rsz, m_use_hugepages);
+
+        m_chunks.push_back( { static_cast<uint64_t*>(p), 0, len, shm } );
 
         m_index = m_chunks.size() - 1;
         m_total_reserved += len;
-    }
 
-    void* allocate(size_t bytes, bool can_expand) {
-        size_t n = (bytes+sizeof(uint64_t)-1)/sizeof(uint64_t);
+        MemoryBudget::add(MemoryBudget::Metadata, rsz);
+    }
 
+    void* allocate_global(size_t n, bool can_expand) {
         std::lock_guard<util::spinlock> lock(m_lock);
-        
+
         if (m_index == m_chunks.size() || m_chunks[m_index].wmark + n > m_chunks[m_index].size) {
             if (can_expand)
-                expand(bytes);
+                expand(n * sizeof(uint64_t));
             else
                 return nullptr;
         }
@@ -102,27 +352,102 @@ struct MemoryPool::MemoryPoolImpl
         return ptr;
     }
 
+    void* allocate(size_t bytes, bool can_expand) {
+        size_t n = (bytes+sizeof(uint64_t)-1)/sizeof(uint64_t);
+
+        // Large requests bypass the arena and go to the global pool directly
+        if (n > arenasize / 2)
+            return allocate_global(n, can_expand);
+
+        Arena* a = &s_arena;
+
+        if (a->owner != this || a->gen != m_gen || a->wmark + n > a->size) {
+            // Refill this thread's arena with a bulk carve-out from the global pool
+            uint64_t* p = static_cast<uint64_t*>(allocate_global(arenasize, can_expand));
+
+            if (!p)
+                return nullptr;
+
+            a->owner = this;
+            a->gen   = m_gen;
+            a->ptr   = p;
+            a->wmark = 0;
+            a->size  = arenasize;
+        }
+
+        void* ptr = static_cast<void*>(a->ptr + a->wmark);
+        a->wmark += n;
+
+        return ptr;
+    }
+
     std::ostream& print_statistics(std::ostream& os) const {
         os << "Metadata memory pool: "
            << m_total_reserved << " bytes reserved, "
            << m_total_used << " bytes used";
 
+        if (s_shm.header)
+            os << "\n      shared segment " << s_shm.name
+               << (s_shm.creator ? " (creator): " : " (attached): ")
+               << s_shm.header->wmark.load(std::memory_order_relaxed)
+               << " of " << s_shm.size << " bytes used";
+
+#ifdef CALIPER_HAVE_LIBNUMA
+        // Report per-NUMA-node placement of the pool's touched pages
+
+        long pagesize = sysconf(_SC_PAGESIZE);
+
+        std::vector<void*> pages;
+
+        for (const Chunk<uint64_t>& c : m_chunks)
+            for (char* p = reinterpret_cast<char*>(c.ptr); p < reinterpret_cast<char*>(c.ptr + c.size); p += pagesize)
+                pages.push_back(p);
+
+        std::vector<int> status(pages.size(), -1);
+
+        if (move_pages(0, pages.size(), pages.data(), nullptr, status.data(), 0) == 0) {
+            std::map<int, size_t> node_pages;
+            size_t untouched = 0;
+
+            for (int s : status)
+                if (s >= 0)
+                    ++node_pages[s];
+                else
+                    ++untouched;
+
+            for (const auto& p : node_pages)
+                os << "\n      NUMA node " << p.first << ": "
+                   << p.second * pagesize << " bytes";
+
+            if (untouched > 0)
+                os << "\n      untouched: " << untouched * pagesize << " bytes";
+        }
+#endif
+
         return os;
     }
     
-    MemoryPoolImpl() 
+    MemoryPoolImpl()
         : m_config { RuntimeConfig::init("memory", s_configdata) }, m_index { 0 },
+          m_gen { s_pool_gen.fetch_add(1) + 1 },
           m_total_reserved { 0 }, m_total_used { 0 }
     {
-        m_can_expand = m_config.get("can_expand").to_bool();
-        size_t s     = m_config.get("pool_size").to_uint();
+        m_can_expand    = m_config.get("can_expand").to_bool();
+        m_use_hugepages = m_config.get("hugepages").to_bool();
+        size_t s        = m_config.get("pool_size").to_uint();
+
+        shm_init(m_config);
 
         expand(s);
     }
-    
-    ~MemoryPoolImpl() {            
-        for ( auto &c : m_chunks )
-            delete[] c.ptr;
+
+    ~MemoryPoolImpl() {
+        for ( auto &c : m_chunks ) {
+            if (!c.shm)
+                util::free_region(c.ptr, c.size * sizeof(uint64_t));
+
+            MemoryBudget::sub(MemoryBudget::Metadata, c.size * sizeof(uint64_t));
+        }
 
         m_chunks.clear();
     }
@@ -130,7 +455,30 @@ struct MemoryPool::MemoryPoolImpl
 
 // --- Static data initialization
 
-const ConfigSet::Entry MemoryPool::MemoryPoolImpl::s_configdata[] = { 
+thread_local MemoryPool::MemoryPoolImpl::Arena
+    MemoryPool::MemoryPoolImpl::s_arena { nullptr, 0, nullptr, 0, 0 };
+
+std::atomic<uint64_t> MemoryPool::MemoryPoolImpl::s_pool_gen { 0 };
+
+const uint64_t MemoryPool::MemoryPoolImpl::s_shm_magic;
+
+std::mutex MemoryPool::MemoryPoolImpl::s_shm_mutex;
+MemoryPool::MemoryPoolImpl::ShmSegment MemoryPool::MemoryPoolImpl::s_shm;
+bool       MemoryPool::MemoryPoolImpl::s_shm_init { false };
+
+MemoryPool::MemoryPoolImpl::ShmSegment::~ShmSegment()
+{
+#ifdef __linux__
+    if (header) {
+        munmap(header, size);
+
+        if (creator)
+            shm_unlink(name.c_str());
+    }
+#endif
+}
+
+const ConfigSet::Entry MemoryPool::MemoryPoolImpl::s_configdata[] = {
     // key, type, value, short description, long description
     { "pool_size", CALI_TYPE_UINT, "2097152",
       "Initial size of the Caliper memory pool (in bytes)",
@@ -140,6 +488,32 @@ const ConfigSet::Entry MemoryPool::MemoryPoolImpl::s_configdata[] = {
       "Allow memory pool to expand at runtime",
       "Allow memory pool to expand at runtime"
     },
+    { "hugepages", CALI_TYPE_BOOL, "false",
+      "Back pool and aggregation memory with transparent hugepages",
+      "Back pool and aggregation memory with transparent hugepages "
+      "(2MB pages) to reduce TLB pressure. Linux only."
+    },
+    { "shm", CALI_TYPE_BOOL, "false",
+      "Back the metadata pool with a node-wide shared-memory segment",
+      "Back the metadata pool with a node-wide POSIX shared-memory "
+      "segment. The first local process creates the segment and carves "
+      "its metadata pool from it; later local processes attach it "
+      "read-only at the creator's address, so node pointers into the "
+      "shared pool resolve in every local process. Attached processes "
+      "keep their own (private) metadata pools. Linux only."
+    },
+    { "shm_segment", CALI_TYPE_STRING, "/caliper-metadata",
+      "Name of the shared-memory metadata pool segment",
+      "Name of the shared-memory metadata pool segment. Must start "
+      "with '/'. Use a per-job name (e.g., including the job id) when "
+      "multiple jobs can share a node."
+    },
+    { "shm_size", CALI_TYPE_UINT, "67108864",
+      "Size of the shared-memory metadata pool segment (in bytes)",
+      "Size of the shared-memory metadata pool segment (in bytes). "
+      "The segment does not expand; the creator's pool falls back to "
+      "private memory when it fills up."
+    },
     ConfigSet::Terminator
 };
 
@@ -40,12 +40,16 @@
 #include "MemoryPool.h"
 
 #include "caliper/common/Attribute.h"
+#include "caliper/common/Health.h"
 #include "caliper/common/Node.h"
 #include "caliper/common/RuntimeConfig.h"
 #include "caliper/common/Variant.h"
 
+#include "caliper/common/util/prefetch.hpp"
+
 #include <atomic>
 #include <cstring>
+#include <unordered_map>
 
 // #define METADATATREE_BENCHMARK
 
@@ -129,9 +133,39 @@ struct MetadataTree::MetadataTreeImpl
 
     static std::atomic<GlobalData*> mG;
 
-    MemoryPool  m_mempool;    
+    // Fanout above which we build a hash index over a parent's children.
+    // High-fanout nodes (e.g., function names from symbol lookup) otherwise
+    // make path construction O(children) per lookup.
+    static const unsigned s_index_fanout = 64;
+
+    MemoryPool  m_mempool;
     NodeBlock*  m_nodeblock;
 
+    // Per-thread child hash index for high-fanout parents:
+    // (attribute, value) hash -> child node. The sibling list remains
+    // authoritative; the index is a cache and may lag behind appends
+    // from other threads.
+    std::unordered_map< const Node*, std::unordered_multimap<uint64_t, Node*> >
+                m_child_index;
+
+    // Direct-mapped (parent, attribute, value) -> child memo, consulted
+    // before any tree descent. Annotation sequences are highly
+    // repetitive (the same region names in the same order each
+    // iteration), so steady-state get_path() lookups resolve here
+    // without touching the sibling list or the child index. The tree is
+    // append-only, so entries never go stale.
+
+    static const size_t s_path_memo_size = 512; // must be a power of two
+
+    struct PathMemoEntry {
+        const Node* parent  { nullptr };
+        cali_id_t   attr_id { CALI_INV_ID };
+        uint64_t    hash    { 0 };
+        Node*       child   { nullptr };
+    };
+
+    PathMemoEntry m_path_memo[s_path_memo_size];
+
     unsigned    m_num_nodes;
     unsigned    m_num_blocks;
 
@@ -185,20 +219,26 @@ struct MetadataTree::MetadataTreeImpl
         GlobalData* g = mG.load();
 
         if (!m_nodeblock || m_nodeblock->index + n >= g->nodes_per_block) {
-            if (g->next_block.load() >= g->num_blocks)
+            if (g->next_block.load() >= g->num_blocks) {
+                Health::inc(Health::FailedNodeAllocs, n);
                 return false;
+            }
 
             // allocate new node block
 
             Node* chunk = static_cast<Node*>(m_mempool.allocate(g->nodes_per_block * sizeof(Node)));
 
-            if (!chunk)
+            if (!chunk) {
+                Health::inc(Health::FailedNodeAllocs, n);
                 return false;
+            }
 
             size_t block_index = g->next_block++;
 
-            if (block_index >= g->num_blocks)
+            if (block_index >= g->num_blocks) {
+                Health::inc(Health::FailedNodeAllocs, n);
                 return false;
+            }
 
             m_nodeblock = g->node_blocks + block_index;
 
@@ -211,11 +251,137 @@ struct MetadataTree::MetadataTreeImpl
         return true;
     }
 
+    //
+    // --- Child lookup
+    //
+
+    static uint64_t
+    hash_entry(cali_id_t attr_id, const Variant& data) {
+        // FNV-1a over the attribute id and value bytes
+        uint64_t h = 14695981039346656037ull;
+
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(&attr_id);
+
+        for (size_t i = 0; i < sizeof(attr_id); ++i)
+            h = (h ^ p[i]) * 1099511628211ull;
+
+        p = static_cast<const unsigned char*>(data.data());
+
+        for (size_t i = 0; i < data.size(); ++i)
+            h = (h ^ p[i]) * 1099511628211ull;
+
+        return h;
+    }
+
+    static size_t
+    path_memo_slot(const Node* parent, uint64_t hash) {
+        uint64_t h = hash ^ (reinterpret_cast<uintptr_t>(parent) >> 4);
+
+        h *= UINT64_C(0xff51afd7ed558ccd);
+
+        return (h >> 32) & (s_path_memo_size - 1);
+    }
+
+    /// \brief Build the child hash index for \param parent
+
+    void
+    build_child_index(const Node* parent) {
+        auto& index = m_child_index[parent];
+
+        for (Node* node = parent->first_child(); node; node = node->next_sibling()) {
+            util::prefetch(node->next_sibling());
+            index.insert(std::make_pair(hash_entry(node->attribute(), node->data()), node));
+        }
+    }
+
+    /// \brief Add \param node to \param parent's child index, if one exists
+
+    void
+    index_child(const Node* parent, Node* node) {
+        auto it = m_child_index.find(parent);
+
+        if (it != m_child_index.end())
+            it->second.insert(std::make_pair(hash_entry(node->attribute(), node->data()), node));
+    }
+
+    /// \brief Find the child of \param parent matching (\param attr_id, \param data).
+    /// Checks the path memo first; falls back to the hash index for
+    /// high-fanout parents (built lazily) or the sibling list.
+
+    Node*
+    find_child(const Node* parent, cali_id_t attr_id, const Variant& data) {
+        uint64_t h = hash_entry(attr_id, data);
+
+        PathMemoEntry& memo = m_path_memo[path_memo_slot(parent, h)];
+
+        if (memo.parent == parent && memo.attr_id == attr_id && memo.hash == h
+            && memo.child->equals(attr_id, data))
+            return memo.child;
+
+        Node* result = lookup_child(parent, attr_id, data, h);
+
+        if (result) {
+            memo.parent  = parent;
+            memo.attr_id = attr_id;
+            memo.hash    = h;
+            memo.child   = result;
+        }
+
+        return result;
+    }
+
+    Node*
+    lookup_child(const Node* parent, cali_id_t attr_id, const Variant& data, uint64_t h) {
+        auto it = m_child_index.find(parent);
+
+        if (it != m_child_index.end()) {
+            auto range = it->second.equal_range(h);
+
+            for (auto c = range.first; c != range.second; ++c)
+                if (c->second->equals(attr_id, data))
+                    return c->second;
+
+            // The index may miss children appended by other threads:
+            // fall back to the authoritative sibling list and cache the result
+            for (Node* node = parent->first_child(); node; node = node->next_sibling()) {
+                util::prefetch(node->next_sibling());
+                if (node->equals(attr_id, data)) {
+                    it->second.insert(std::make_pair(h, node));
+                    return node;
+                }
+            }
+
+            return nullptr;
+        }
+
+        unsigned num_ops = 1;
+        Node*    result  = nullptr;
+
+        for (Node* node = parent->first_child(); node; node = node->next_sibling(), ++num_ops) {
+            util::prefetch(node->next_sibling());
+            if (node->equals(attr_id, data)) {
+                result = node;
+                break;
+            }
+        }
+
+#ifdef METADATATREE_BENCHMARK
+        ++m_num_lookups;
+        m_tot_lookup_ops += num_ops;
+        m_max_lookup_ops  = std::max(m_max_lookup_ops, num_ops);
+#endif
+
+        if (num_ops > s_index_fanout)
+            build_child_index(parent);
+
+        return result;
+    }
+
     //
     // --- Modifying tree operations
     //
 
-    /// \brief Creates \param n new nodes hierarchically under \param parent 
+    /// \brief Creates \param n new nodes hierarchically under \param parent
 
     Node*
     create_path(const Attribute& attr, size_t n, const Variant* data, Node* parent = nullptr) {
@@ -229,17 +395,25 @@ struct MetadataTree::MetadataTreeImpl
         const size_t align = 8;
         size_t data_size   = 0;
 
+        // variable-size values beyond the variant's inline capacity are
+        // copied into the pool; smaller ones are stored in the variant itself
+
         bool   copy        = (attr.type() == CALI_TYPE_USR || attr.type() == CALI_TYPE_STRING);
         char*  ptr         = nullptr;
 
         if (copy) {
             for (size_t i = 0; i < n; ++i)
-                data_size += data[i].size() + (align - data[i].size()%align);
+                if (data[i].size() > CALI_VARIANT_INLINE_MAX)
+                    data_size += data[i].size() + (align - data[i].size()%align);
 
-            ptr = static_cast<char*>(m_mempool.allocate(data_size));
+            if (data_size > 0) {
+                ptr = static_cast<char*>(m_mempool.allocate(data_size));
 
-            if (!ptr)
-                return nullptr;
+                if (!ptr) {
+                    Health::inc(Health::FailedNodeAllocs, n);
+                    return nullptr;
+                }
+            }
         }
 
         Node* node = nullptr;
@@ -250,9 +424,9 @@ struct MetadataTree::MetadataTreeImpl
 
         for (size_t i = 0; i < n; ++i) {
             const void* dptr { data[i].data() };
-            size_t size      { data[i].size() }; 
+            size_t size      { data[i].size() };
 
-            if (copy) {
+            if (copy && size > CALI_VARIANT_INLINE_MAX) {
                 dptr = memcpy(ptr, dptr, size);
                 ptr += size+(align-size%align);
             }
@@ -262,8 +436,10 @@ struct MetadataTree::MetadataTreeImpl
             node = new(m_nodeblock->chunk + index)
                 Node((m_nodeblock - g->node_blocks) * g->nodes_per_block + index, attr.id(), Variant(attr.type(), dptr, size));
 
-            if (parent)
+            if (parent) {
                 parent->append(node);
+                index_child(parent, node);
+            }
 
             parent = node;
         }
@@ -288,7 +464,8 @@ struct MetadataTree::MetadataTreeImpl
         size_t data_size   = 0;
 
         for (size_t i = 0; i < n; ++i)
-            if (attr[i].type() == CALI_TYPE_USR || attr[i].type() == CALI_TYPE_STRING)
+            if ((attr[i].type() == CALI_TYPE_USR || attr[i].type() == CALI_TYPE_STRING)
+                && data[i].size() > CALI_VARIANT_INLINE_MAX)
                 data_size += data[i].size() + (align - data[i].size()%align);
 
         char* ptr  = nullptr;
@@ -296,8 +473,10 @@ struct MetadataTree::MetadataTreeImpl
         if (data_size > 0) {
             ptr = static_cast<char*>(m_mempool.allocate(data_size));
 
-            if (!ptr)
+            if (!ptr) {
+                Health::inc(Health::FailedNodeAllocs, n);
                 return nullptr;
+            }
         }
 
         Node* node = nullptr;
@@ -309,20 +488,22 @@ struct MetadataTree::MetadataTreeImpl
             bool   copy { attr[i].type() == CALI_TYPE_USR || attr[i].type() == CALI_TYPE_STRING };
 
             const void* dptr { data[i].data() };
-            size_t size      { data[i].size() }; 
+            size_t size      { data[i].size() };
 
-            if (copy) {
+            if (copy && size > CALI_VARIANT_INLINE_MAX) {
                 dptr = memcpy(ptr, dptr, size);
                 ptr += size+(align-size%align);
             }
 
             size_t index = m_nodeblock->index++;
 
-            node = new(m_nodeblock->chunk + index) 
+            node = new(m_nodeblock->chunk + index)
                 Node((m_nodeblock - g->node_blocks) * g->nodes_per_block + index, attr[i].id(), Variant(attr[i].type(), dptr, size));
 
-            if (parent)
+            if (parent) {
                 parent->append(node);
+                index_child(parent, node);
+            }
 
             parent = node;
         }
@@ -342,23 +523,8 @@ struct MetadataTree::MetadataTreeImpl
 
         for (size_t i = 0; i < n; ++i) {
             parent = node;
+            node   = find_child(parent, attr.id(), data[i]);
 
-#ifdef METADATATREE_BENCHMARK
-            unsigned num_ops = 1;
-#endif
-            
-            for (node = parent->first_child(); node && !node->equals(attr.id(), data[i]); node = node->next_sibling())
-#ifdef METADATATREE_BENCHMARK
-                ++num_ops
-#endif
-                ;
-
-#ifdef METADATATREE_BENCHMARK
-            ++m_num_lookups;
-            m_tot_lookup_ops += num_ops;
-            m_max_lookup_ops  = std::max(m_max_lookup_ops, num_ops);
-#endif
-            
             if (!node)
                 break;
 
@@ -381,22 +547,7 @@ struct MetadataTree::MetadataTreeImpl
 
         for (size_t i = 0; i < n; ++i) {
             parent = node;
-
-#ifdef METADATATREE_BENCHMARK
-            unsigned num_ops = 1;
-#endif
-
-            for (node = parent->first_child(); node && !node->equals(attr[i].id(), data[i]); node = node->next_sibling())
-#ifdef METADATATREE_BENCHMARK
-                ++num_ops
-#endif
-                ;
-
-#ifdef METADATATREE_BENCHMARK
-            ++m_num_lookups;
-            m_tot_lookup_ops += num_ops;
-            m_max_lookup_ops  = std::max(m_max_lookup_ops, num_ops);
-#endif
+            node   = find_child(parent, attr[i].id(), data[i]);
 
             if (!node)
                 break;
@@ -431,23 +582,7 @@ struct MetadataTree::MetadataTreeImpl
         if (!parent)
             parent = &(g->root);
         
-        Node* node = nullptr;
-
-#ifdef METADATATREE_BENCHMARK
-            unsigned num_ops = 1;
-#endif
-
-        for ( node = parent->first_child(); node && !node->equals(from->attribute(), from->data()); node = node->next_sibling())
-#ifdef METADATATREE_BENCHMARK
-                ++num_ops
-#endif
-            ;
-
-#ifdef METADATATREE_BENCHMARK
-            ++m_num_lookups;
-            m_tot_lookup_ops += num_ops;
-            m_max_lookup_ops  = std::max(m_max_lookup_ops, num_ops);
-#endif
+        Node* node = find_child(parent, from->attribute(), from->data());
 
         if (!node) {
             if (!have_free_nodeblock(1))
@@ -457,8 +592,9 @@ struct MetadataTree::MetadataTreeImpl
 
             node = new(m_nodeblock->chunk + index) 
                 Node((m_nodeblock - g->node_blocks) * g->nodes_per_block + index, from->attribute(), from->data());
-            
+
             parent->append(node);
+            index_child(parent, node);
 
             ++m_num_nodes;
         }
@@ -471,17 +607,21 @@ struct MetadataTree::MetadataTreeImpl
         GlobalData* g = mG.load();
 
         // parent info is fixed, no need to lock
-        for (Node* tmp = node ; tmp && tmp != &(g->root); tmp = tmp->parent())
+        for (Node* tmp = node ; tmp && tmp != &(g->root); tmp = tmp->parent()) {
+            util::prefetch(tmp->parent());
             if (tmp->attribute() == attr.id())
                 node = tmp;
+        }
 
         return node ? node->parent() : &(g->root);
     }
 
     Node*
     find_node_with_attribute(const Attribute& attr, Node* node) const {
-        while (node && node->attribute() != attr.id())
+        while (node && node->attribute() != attr.id()) {
+            util::prefetch(node->parent());
             node = node->parent();
+        }
 
         return node;
     }
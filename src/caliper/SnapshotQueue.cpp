@@ -0,0 +1,143 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "SnapshotQueue.h"
+
+#include <algorithm>
+
+using namespace cali;
+
+const std::size_t SnapshotQueue::MAX_ENTRIES;
+
+namespace
+{
+
+// Bounded MPMC ring with per-slot sequence numbers: a slot's sequence
+// equals its position when free, position+1 when filled. Producers and
+// consumers claim positions with a CAS and publish slot contents with
+// a release store on the sequence.
+
+std::size_t next_power_of_two(std::size_t n)
+{
+    std::size_t p = 1;
+
+    while (p < n)
+        p *= 2;
+
+    return p;
+}
+
+} // namespace [anonymous]
+
+
+SnapshotQueue::SnapshotQueue(std::size_t capacity)
+    : m_slots(::next_power_of_two(std::max<std::size_t>(capacity, 2))),
+      m_mask(m_slots.size() - 1),
+      m_enqueue_pos(0),
+      m_dequeue_pos(0)
+{
+    for (std::size_t i = 0; i < m_slots.size(); ++i)
+        m_slots[i].seq.store(i, std::memory_order_relaxed);
+}
+
+bool
+SnapshotQueue::enqueue(const SnapshotRecord* rec)
+{
+    std::size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+
+    Slot* slot;
+
+    for (;;) {
+        slot = &m_slots[pos & m_mask];
+
+        std::size_t seq = slot->seq.load(std::memory_order_acquire);
+
+        if (seq == pos) {
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+                break;
+        } else if (seq < pos)
+            return false; // queue is full
+        else
+            pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    }
+
+    SnapshotRecord::Sizes sizes = rec->size();
+    SnapshotRecord::Data  addr  = rec->data();
+
+    sizes.n_nodes     = std::min(sizes.n_nodes,     MAX_ENTRIES);
+    sizes.n_immediate = std::min(sizes.n_immediate, MAX_ENTRIES);
+
+    std::copy_n(const_cast<Node* const*>(addr.node_entries), sizes.n_nodes,
+                slot->data.node_array);
+    std::copy_n(addr.immediate_attr, sizes.n_immediate, slot->data.attr_array);
+    std::copy_n(addr.immediate_data, sizes.n_immediate, slot->data.data_array);
+
+    slot->sizes = sizes;
+
+    slot->seq.store(pos + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool
+SnapshotQueue::dequeue(SnapshotRecord::FixedSnapshotRecord<MAX_ENTRIES>& data,
+                       SnapshotRecord::Sizes&                            sizes)
+{
+    std::size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+
+    Slot* slot;
+
+    for (;;) {
+        slot = &m_slots[pos & m_mask];
+
+        std::size_t seq = slot->seq.load(std::memory_order_acquire);
+
+        if (seq == pos + 1) {
+            if (m_dequeue_pos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+                break;
+        } else if (seq < pos + 1)
+            return false; // queue is empty
+        else
+            pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    }
+
+    sizes = slot->sizes;
+
+    std::copy_n(slot->data.node_array, sizes.n_nodes,     data.node_array);
+    std::copy_n(slot->data.attr_array, sizes.n_immediate, data.attr_array);
+    std::copy_n(slot->data.data_array, sizes.n_immediate, data.data_array);
+
+    // mark the slot free for the next lap
+    slot->seq.store(pos + m_mask + 1, std::memory_order_release);
+
+    return true;
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// @file SnapshotQueue.h
+/// @brief Lock-free queue decoupling snapshot triggers from processing
+///
+
+#ifndef CALI_SNAPSHOTQUEUE_H
+#define CALI_SNAPSHOTQUEUE_H
+
+#include "caliper/SnapshotRecord.h"
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace cali
+{
+
+///
+/// \brief Bounded lock-free multi-producer/multi-consumer snapshot queue.
+///
+/// Producers (snapshot triggers) copy assembled snapshot records into a
+/// fixed-size ring; consumers (helper threads) take them out for
+/// processing off the application's critical path. Enqueue is wait-free
+/// except for a single CAS and is signal safe. When the queue is full,
+/// enqueue fails and the caller processes the snapshot inline.
+///
+
+class SnapshotQueue
+{
+public:
+
+    // Queue slots store snapshot contents inline; capacity matches
+    // push_snapshot's fixed snapshot buffer.
+    static const std::size_t MAX_ENTRIES = 80;
+
+private:
+
+    struct Slot {
+        std::atomic<std::size_t> seq;
+
+        SnapshotRecord::FixedSnapshotRecord<MAX_ENTRIES> data;
+        SnapshotRecord::Sizes                            sizes;
+
+        Slot() : seq(0), sizes { 0, 0 } { }
+    };
+
+    std::vector<Slot>        m_slots;
+    std::size_t              m_mask;
+
+    std::atomic<std::size_t> m_enqueue_pos;
+    std::atomic<std::size_t> m_dequeue_pos;
+
+public:
+
+    /// \brief Create a queue with \a capacity slots (rounded up to a power of two).
+    explicit SnapshotQueue(std::size_t capacity);
+
+    /// \brief Copy \a rec into the queue.
+    /// \return false if the queue is full; the caller should then process inline.
+    bool enqueue(const SnapshotRecord* rec);
+
+    /// \brief Take one record out of the queue.
+    ///
+    /// Copies the record contents into \a data and \a sizes.
+    /// \return false if the queue is empty.
+    bool dequeue(SnapshotRecord::FixedSnapshotRecord<MAX_ENTRIES>& data,
+                 SnapshotRecord::Sizes&                            sizes);
+};
+
+} // namespace cali
+
+#endif // CALI_SNAPSHOTQUEUE_H
@@ -33,12 +33,18 @@
 /// \file api.cpp
 /// Initialization of API attributes and static variables
 
+#include "caliper/cali_inline.h"
+
 #include "caliper/Caliper.h"
+#include "caliper/SnapshotRecord.h"
 
 #include "caliper/common/Attribute.h"
+#include "caliper/common/Variant.h"
 
 #include "caliper/common/cali_types.h"
 
+#include <mutex>
+
 cali_id_t cali_class_aggregatable_attr_id  = CALI_INV_ID;
 cali_id_t cali_class_symboladdress_attr_id = CALI_INV_ID;
 cali_id_t cali_function_attr_id     = CALI_INV_ID;
@@ -46,6 +52,55 @@ cali_id_t cali_loop_attr_id         = CALI_INV_ID;
 cali_id_t cali_statement_attr_id    = CALI_INV_ID;
 cali_id_t cali_annotation_attr_id   = CALI_INV_ID;
 
+// starts out enabled so the first annotation macro triggers initialization;
+// cleared by service registration when no services are enabled
+int       cali_enabled              = 1;
+
+// per-thread value slot state for the inline fast path (cali_inline.h)
+__thread cali_thread_state_t cali_thread_state;
+
+//
+// --- Inline fast-path value slots
+//
+
+// The slot-to-attribute binding is process-global: all threads share
+// the binding, only the values in cali_thread_state are per-thread.
+
+namespace
+{
+    cali::Attribute slot_attrs[CALI_INLINE_MAX_SLOTS];
+    int             num_slots = 0;
+    std::mutex      slot_lock;
+}
+
+int
+cali_inline_slot_bind(const char* name, cali_attr_type type)
+{
+    if (!(type == CALI_TYPE_INT || type == CALI_TYPE_UINT || type == CALI_TYPE_DOUBLE))
+        return -1;
+
+    std::lock_guard<std::mutex>
+        g(slot_lock);
+
+    for (int i = 0; i < num_slots; ++i)
+        if (slot_attrs[i].name() == name)
+            return slot_attrs[i].type() == type ? i : -1;
+
+    if (num_slots >= CALI_INLINE_MAX_SLOTS)
+        return -1;
+
+    cali::Attribute attr =
+        cali::Caliper::instance().create_attribute(name, type,
+            CALI_ATTR_ASVALUE | CALI_ATTR_SKIP_EVENTS | CALI_ATTR_SCOPE_THREAD);
+
+    if (attr == cali::Attribute::invalid)
+        return -1;
+
+    slot_attrs[num_slots] = attr;
+
+    return num_slots++;
+}
+
 namespace cali
 {
     Attribute class_aggregatable_attr;
@@ -112,4 +167,18 @@ namespace cali
             *(p->attr_id) = (p->attr)->id();
         }
     }
+
+    // Append the calling thread's active inline value slots to a
+    // snapshot record. Called from Caliper::pull_snapshot(); reads
+    // only plain thread-local data, so it is signal safe.
+    void append_inline_slots(SnapshotRecord* sbuf) {
+        unsigned active = cali_thread_state.active;
+
+        for (int i = 0; active; ++i, active >>= 1)
+            if (active & 1)
+                sbuf->append(slot_attrs[i].id(),
+                             Variant(slot_attrs[i].type(),
+                                     &cali_thread_state.value[i],
+                                     sizeof(cali_thread_state.value[i])));
+    }
 }
@@ -39,7 +39,9 @@
 #include "caliper/SnapshotRecord.h"
 
 #include "caliper/common/CompressedSnapshotRecord.h"
+#include "caliper/common/Health.h"
 #include "caliper/common/Log.h"
+#include "caliper/common/MemoryBudget.h"
 #include "caliper/common/Node.h"
 #include "caliper/common/RuntimeConfig.h"
 #include "caliper/common/Variant.h"
@@ -319,6 +321,9 @@ cali_get(cali_id_t attr_id)
 cali_err
 cali_begin(cali_id_t attr_id)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr = c.get_attribute(attr_id);
     
@@ -331,24 +336,85 @@ cali_begin(cali_id_t attr_id)
 cali_err
 cali_end(cali_id_t attr_id)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr = c.get_attribute(attr_id);
 
     return c.end(attr);
 }
 
-cali_err  
+cali_err
 cali_set(cali_id_t attr_id, const void* value, size_t size)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr = c.get_attribute(attr_id);
 
     return c.set(attr, Variant(attr.type(), value, size));
 }
 
+cali_err
+cali_begin_list(size_t n, const cali_id_t attr_id[], const cali_variant_t value[])
+{
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
+    Caliper   c;
+    cali_err  ret = CALI_SUCCESS;
+
+    Attribute attr[16];
+    Variant   data[16];
+
+    for (size_t i = 0; i < n && ret == CALI_SUCCESS; i += 16) {
+        size_t nn = (n-i < 16 ? n-i : 16);
+
+        for (size_t j = 0; j < nn; ++j) {
+            attr[j] = c.get_attribute(attr_id[i+j]);
+            data[j] = Variant(value[i+j]);
+        }
+
+        ret = c.begin(nn, attr, data);
+    }
+
+    return ret;
+}
+
+cali_err
+cali_set_list(size_t n, const cali_id_t attr_id[], const cali_variant_t value[])
+{
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
+    Caliper   c;
+    cali_err  ret = CALI_SUCCESS;
+
+    Attribute attr[16];
+    Variant   data[16];
+
+    for (size_t i = 0; i < n && ret == CALI_SUCCESS; i += 16) {
+        size_t nn = (n-i < 16 ? n-i : 16);
+
+        for (size_t j = 0; j < nn; ++j) {
+            attr[j] = c.get_attribute(attr_id[i+j]);
+            data[j] = Variant(value[i+j]);
+        }
+
+        ret = c.set(nn, attr, data);
+    }
+
+    return ret;
+}
+
 cali_err
 cali_begin_double(cali_id_t attr_id, double val)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr = c.get_attribute(attr_id);
 
@@ -361,6 +427,9 @@ cali_begin_double(cali_id_t attr_id, double val)
 cali_err
 cali_begin_int(cali_id_t attr_id, int val)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr = c.get_attribute(attr_id);
 
@@ -373,6 +442,9 @@ cali_begin_int(cali_id_t attr_id, int val)
 cali_err
 cali_begin_string(cali_id_t attr_id, const char* val)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr = c.get_attribute(attr_id);
 
@@ -385,6 +457,9 @@ cali_begin_string(cali_id_t attr_id, const char* val)
 cali_err
 cali_set_double(cali_id_t attr_id, double val)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr = c.get_attribute(attr_id);
 
@@ -397,6 +472,9 @@ cali_set_double(cali_id_t attr_id, double val)
 cali_err
 cali_set_int(cali_id_t attr_id, int val)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr = c.get_attribute(attr_id);
 
@@ -409,6 +487,9 @@ cali_set_int(cali_id_t attr_id, int val)
 cali_err
 cali_set_string(cali_id_t attr_id, const char* val)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr = c.get_attribute(attr_id);
 
@@ -421,6 +502,9 @@ cali_set_string(cali_id_t attr_id, const char* val)
 cali_err
 cali_safe_end_string(cali_id_t attr_id, const char* val)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     cali_err  ret  = CALI_SUCCESS;
 
     Caliper   c;
@@ -446,12 +530,89 @@ cali_safe_end_string(cali_id_t attr_id, const char* val)
 }
 
 //
-// --- By-name annotation interface 
+// --- Handle-based annotation interface
+//
+
+struct _cali_context_handle {
+    Attribute attr;
+    Node*     node;
+};
+
+namespace
+{
+
+std::mutex handle_lock;
+std::unordered_map<cali::Node*, cali_context_handle_t> handle_map;
+
+}
+
+cali_context_handle_t
+cali_make_context_handle(cali_id_t attr_id, const void* value, size_t size)
+{
+    Caliper   c;
+    Attribute attr = c.get_attribute(attr_id);
+
+    if (attr == Attribute::invalid || attr.store_as_value())
+        return nullptr;
+
+    // Intern the attribute/value pair as a top-level tree entry.
+    // begin() merges it under the current blackboard entry later.
+
+    Node* node = c.make_tree_entry(attr, Variant(attr.type(), value, size));
+
+    if (!node)
+        return nullptr;
+
+    std::lock_guard<std::mutex>
+        g(::handle_lock);
+
+    auto it = ::handle_map.find(node);
+
+    if (it == ::handle_map.end())
+        it = ::handle_map.insert(std::make_pair(node,
+                 new _cali_context_handle { attr, node })).first;
+
+    return it->second;
+}
+
+cali_err
+cali_begin_handle(cali_context_handle_t handle)
+{
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
+    if (!handle)
+        return CALI_EINV;
+
+    Caliper c;
+
+    return c.begin(handle->attr, handle->node);
+}
+
+cali_err
+cali_end_handle(cali_context_handle_t handle)
+{
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
+    if (!handle)
+        return CALI_EINV;
+
+    Caliper c;
+
+    return c.end(handle->attr);
+}
+
+//
+// --- By-name annotation interface
 //
 
 cali_err
 cali_begin_byname(const char* attr_name)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr =
         c.create_attribute(attr_name, CALI_TYPE_BOOL, CALI_ATTR_DEFAULT);
@@ -467,6 +628,9 @@ cali_begin_byname(const char* attr_name)
 cali_err
 cali_begin_double_byname(const char* attr_name, double val)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr =
         c.create_attribute(attr_name, CALI_TYPE_DOUBLE, CALI_ATTR_DEFAULT);
@@ -480,6 +644,9 @@ cali_begin_double_byname(const char* attr_name, double val)
 cali_err
 cali_begin_int_byname(const char* attr_name, int val)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr =
         c.create_attribute(attr_name, CALI_TYPE_INT, CALI_ATTR_DEFAULT);
@@ -493,6 +660,9 @@ cali_begin_int_byname(const char* attr_name, int val)
 cali_err
 cali_begin_string_byname(const char* attr_name, const char* val)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr =
         c.create_attribute(attr_name, CALI_TYPE_STRING, CALI_ATTR_DEFAULT);
@@ -506,6 +676,9 @@ cali_begin_string_byname(const char* attr_name, const char* val)
 cali_err
 cali_set_double_byname(const char* attr_name, double val)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr =
         c.create_attribute(attr_name, CALI_TYPE_DOUBLE, CALI_ATTR_DEFAULT);
@@ -519,6 +692,9 @@ cali_set_double_byname(const char* attr_name, double val)
 cali_err
 cali_set_int_byname(const char* attr_name, int val)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr =
         c.create_attribute(attr_name, CALI_TYPE_INT, CALI_ATTR_DEFAULT);
@@ -532,6 +708,9 @@ cali_set_int_byname(const char* attr_name, int val)
 cali_err
 cali_set_string_byname(const char* attr_name, const char* val)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr =
         c.create_attribute(attr_name, CALI_TYPE_STRING, CALI_ATTR_DEFAULT);
@@ -545,6 +724,9 @@ cali_set_string_byname(const char* attr_name, const char* val)
 cali_err
 cali_end_byname(const char* attr_name)
 {
+    if (!cali_enabled)
+        return CALI_SUCCESS;
+
     Caliper   c;
     Attribute attr = c.get_attribute(attr_name);
 
@@ -569,6 +751,43 @@ cali_is_initialized()
     return Caliper::is_initialized() ? 1 : 0;
 }
 
+size_t
+cali_memory_usage(cali_memory_component_t component)
+{
+    switch (component) {
+    case CALI_MEMORY_METADATA:
+        return MemoryBudget::usage(MemoryBudget::Metadata);
+    case CALI_MEMORY_TRACE:
+        return MemoryBudget::usage(MemoryBudget::Trace);
+    case CALI_MEMORY_AGGREGATE:
+        return MemoryBudget::usage(MemoryBudget::Aggregate);
+    case CALI_MEMORY_TOTAL:
+        return MemoryBudget::total_usage();
+    }
+
+    return 0;
+}
+
+size_t
+cali_memory_budget()
+{
+    return MemoryBudget::budget();
+}
+
+int
+cali_memory_budget_exceeded()
+{
+    return MemoryBudget::exceeded() ? 1 : 0;
+}
+
+void
+cali_get_health(cali_health_t* health)
+{
+    health->dropped_snapshots = Health::count(Health::DroppedSnapshots);
+    health->dropped_bytes     = Health::count(Health::DroppedBytes);
+    health->failed_nodes      = Health::count(Health::FailedNodeAllocs);
+}
+
 //
 // --- Helper functions for high-level macro interface
 // 
@@ -0,0 +1,184 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//
+// Multi-threaded scaling stress benchmark.
+//
+// Runs begin/end/snapshot loops on an increasing number of concurrent
+// threads against one Caliper instance and reports throughput versus
+// thread count as CSV, so changes to the shared runtime structures
+// (MetadataTree, MemoryPool, ContextBuffer) can be evaluated under
+// contention.
+//
+
+#include "caliper/tools-util/Args.h"
+
+#include <caliper/Caliper.h>
+
+#include <caliper/common/Variant.h>
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct StressConfig {
+    int iterations;
+    int snapshot_interval;
+
+    cali::Attribute tree_attr;
+    cali::Attribute value_attr;
+
+    std::vector<std::string> values;
+};
+
+//
+// Per-thread stress loop: nested begin/end with rotating values
+// creates and looks up tree nodes through the shared MetadataTree and
+// MemoryPool, by-value set updates the thread's ContextBuffer, and
+// periodic snapshots run the full snapshot path.
+//
+
+void stress_thread(int id, const StressConfig& cfg)
+{
+    cali::Caliper c;
+
+    for (int i = 0; i < cfg.iterations; ++i) {
+        const std::string& sval = cfg.values[(id+i) % cfg.values.size()];
+        int64_t ival = i;
+
+        c.begin(cfg.tree_attr, cali::Variant(CALI_TYPE_STRING, sval.c_str(), sval.length()));
+        c.set(cfg.value_attr, cali::Variant(CALI_TYPE_INT, &ival, sizeof(ival)));
+
+        if (cfg.snapshot_interval && i % cfg.snapshot_interval == 0)
+            c.push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, nullptr);
+
+        c.end(cfg.tree_attr);
+    }
+}
+
+double run_with_threads(int num_threads, const StressConfig& cfg)
+{
+    std::vector<std::thread> threads;
+
+    auto stime = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < num_threads; ++i)
+        threads.push_back(std::thread(&stress_thread, i, std::cref(cfg)));
+
+    for (auto& t : threads)
+        t.join();
+
+    auto etime = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double>(etime-stime).count();
+}
+
+} // namespace [anonymous]
+
+
+int main(int argc, const char* argv[])
+{
+    // parse command line arguments
+
+    const util::Args::Table option_table[] = {
+        { "max-threads",       "max-threads",       't', true,
+          "Largest thread count to run (counts double from 1)",
+          "16" },
+        { "iterations",        "iterations",        'i', true,
+          "Number of iterations per thread",
+          "20000" },
+        { "snapshot-interval", "snapshot-interval", 's', true,
+          "Take a snapshot every N iterations (0 disables snapshots)",
+          "10" },
+        { "fanout",            "fanout",            'f', true,
+          "Number of distinct values for the tree attribute",
+          "16" },
+
+        util::Args::Table::Terminator
+    };
+
+    util::Args args(option_table);
+
+    int lastarg = args.parse(argc, argv);
+
+    if (lastarg < argc) {
+        std::cerr << "cali-scale-stress: unknown option: " << argv[lastarg] << '\n'
+                  << "  Available options: ";
+
+        args.print_available_options(std::cerr);
+
+        return -1;
+    }
+
+    int max_threads = std::stoi(args.get("max-threads",       "16"));
+    int fanout      = std::stoi(args.get("fanout",            "16"));
+
+    StressConfig cfg;
+
+    cfg.iterations        = std::stoi(args.get("iterations",        "20000"));
+    cfg.snapshot_interval = std::stoi(args.get("snapshot-interval", "10"));
+
+    for (int i = 0; i < fanout; ++i) {
+        std::stringstream s;
+        s << "stress.value." << i;
+        cfg.values.push_back(s.str());
+    }
+
+    {
+        cali::Caliper c;
+
+        cfg.tree_attr  =
+            c.create_attribute("stress.region",    CALI_TYPE_STRING, CALI_ATTR_SCOPE_THREAD);
+        cfg.value_attr =
+            c.create_attribute("stress.iteration", CALI_TYPE_INT,    CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD);
+    }
+
+    std::cout << "threads,iterations,snapshot_interval,time_sec,ops_per_sec" << std::endl;
+
+    for (int t = 1; t <= max_threads; t *= 2) {
+        double sec = ::run_with_threads(t, cfg);
+        double ops = static_cast<double>(t) * cfg.iterations;
+
+        std::cout << t
+                  << ',' << cfg.iterations
+                  << ',' << cfg.snapshot_interval
+                  << ',' << sec
+                  << ',' << static_cast<long long>(ops / sec)
+                  << std::endl;
+    }
+}
@@ -0,0 +1,68 @@
+// Tests for the CALI_DISABLE compile-time kill switch:
+// annotation macros and classes must compile to nothing in this
+// translation unit and never initialize the Caliper runtime.
+
+#define CALI_DISABLE
+#include "caliper/cali_macros.h"
+
+#include "caliper/Caliper.h"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    int annotated_function(int i) {
+        CALI_CXX_MARK_FUNCTION;
+
+        CALI_MARK_BEGIN("disabled.region");
+        CALI_MARK_END("disabled.region");
+
+        return i;
+    }
+}
+
+TEST(DisabledAnnotationTest, MacrosCompileToNothing) {
+    CALI_MARK_FUNCTION_BEGIN;
+
+    CALI_CXX_MARK_LOOP_BEGIN(testloop, "disabled.loop");
+
+    for (int i = 0; i < 4; ++i) {
+        CALI_CXX_MARK_LOOP_ITERATION(testloop, i);
+    }
+
+    CALI_CXX_MARK_LOOP_END(testloop);
+
+    int res = 0;
+
+    CALI_WRAP_STATEMENT("disabled.wrap", res = annotated_function(42));
+
+    EXPECT_EQ(res, 42);
+
+    CALI_MARK_FUNCTION_END;
+
+    // none of the above may have initialized the runtime
+    EXPECT_FALSE(cali::Caliper::is_initialized());
+}
+
+TEST(DisabledAnnotationTest, ClassesAreEmpty) {
+    cali::Annotation ann("test.disabled.annotation");
+
+    cali::Annotation::Guard g(ann.begin(7));
+
+    ann.set(1.0).set("string").end();
+
+    {
+        cali::Function    f("test.disabled.function");
+        cali::Loop        l("test.disabled.loop");
+        cali::Loop::Iteration it(l.iteration(0));
+
+        l.end();
+    }
+
+    // the disabled constructs are stateless empty classes
+    EXPECT_EQ(sizeof(cali::Function),   static_cast<size_t>(1));
+    EXPECT_EQ(sizeof(cali::Loop),       static_cast<size_t>(1));
+    EXPECT_EQ(sizeof(cali::Annotation), static_cast<size_t>(1));
+
+    EXPECT_FALSE(cali::Caliper::is_initialized());
+}
@@ -0,0 +1,328 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file AlignedFileStream.cpp
+/// AlignedFileStream implementation
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "caliper/common/AlignedFileStream.h"
+
+#include "caliper/common/Log.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <streambuf>
+
+using namespace cali;
+using namespace std;
+
+namespace
+{
+
+const size_t s_align   = 4096;           // I/O block size for O_DIRECT
+const size_t s_bufsize = 4 * 1024*1024;  // staging buffer size
+
+// Write len bytes, retrying on short writes and EINTR.
+bool write_all(int fd, const char* data, size_t len)
+{
+    while (len > 0) {
+        ssize_t w = ::write(fd, data, len);
+
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
+
+        data += w;
+        len  -= w;
+    }
+
+    return true;
+}
+
+class AlignedFileBuf : public std::streambuf
+{
+    int    m_fd;
+    bool   m_direct;
+    bool   m_dropcache;
+
+    char*  m_buf;
+
+    off_t  m_offset;   // file offset of the staging buffer's first byte
+    off_t  m_dropped;  // dropcache: file range [0, m_dropped) has been evicted
+
+    // Request writeback for the just-written range and evict all
+    // ranges written before it: their writeback was requested on the
+    // previous call and has had time to complete, so DONTNEED
+    // actually drops the pages instead of skipping them as dirty.
+    void drop_written_range(off_t pos, size_t len) {
+#ifdef SYNC_FILE_RANGE_WRITE
+        sync_file_range(m_fd, pos, len, SYNC_FILE_RANGE_WRITE);
+#endif
+        if (pos > m_dropped) {
+            posix_fadvise(m_fd, m_dropped, pos - m_dropped, POSIX_FADV_DONTNEED);
+            m_dropped = pos;
+        }
+    }
+
+    // Write out staged data. Outside of close(), direct-I/O mode only
+    // writes whole I/O blocks and keeps the partial tail staged, so
+    // the file offset stays aligned.
+    bool flush_buffer(bool final) {
+        size_t used = pptr() - pbase();
+        size_t len  = used;
+
+        if (m_direct && !final)
+            len -= len % s_align;
+
+        if (len == 0)
+            return true;
+
+        size_t wlen = len;
+
+        if (m_direct && final && (wlen % s_align) != 0) {
+            // pad the final chunk to the I/O block size; close()
+            // truncates the file back to its logical length
+            size_t plen = s_align - wlen % s_align;
+
+            memset(pbase() + wlen, 0, plen);
+            wlen += plen;
+        }
+
+        if (!write_all(m_fd, pbase(), wlen)) {
+            Log(0).stream() << "AlignedFileStream: error: write failed: "
+                            << strerror(errno) << endl;
+            return false;
+        }
+
+        if (m_dropcache)
+            drop_written_range(m_offset, len);
+
+        m_offset += len;
+
+        setp(m_buf, m_buf + s_bufsize);
+
+        if (len < used) {
+            memmove(m_buf, m_buf + len, used - len);
+            pbump(used - len);
+        }
+
+        return true;
+    }
+
+public:
+
+    AlignedFileBuf(const std::string& filename, bool direct, bool dropcache)
+        : m_fd(-1),
+          m_direct(direct),
+          m_dropcache(dropcache),
+          m_buf(nullptr),
+          m_offset(0),
+          m_dropped(0)
+        {
+            int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+#ifdef O_DIRECT
+            if (m_direct)
+                flags |= O_DIRECT;
+#else
+            if (m_direct) {
+                Log(1).stream() << "AlignedFileStream: O_DIRECT is not available "
+                                << "on this platform, using buffered writes" << endl;
+                m_direct = false;
+            }
+#endif
+
+            m_fd = ::open(filename.c_str(), flags, 0644);
+
+#ifdef O_DIRECT
+            if (m_fd < 0 && m_direct) {
+                Log(1).stream() << "AlignedFileStream: cannot open " << filename
+                                << " with O_DIRECT (" << strerror(errno)
+                                << "), falling back to buffered writes" << endl;
+
+                m_direct = false;
+                m_fd     = ::open(filename.c_str(), flags & ~O_DIRECT, 0644);
+            }
+#endif
+
+            if (m_fd < 0)
+                return;
+
+            void* buf = nullptr;
+
+            if (posix_memalign(&buf, s_align, s_bufsize) != 0) {
+                ::close(m_fd);
+                m_fd = -1;
+                return;
+            }
+
+            m_buf = static_cast<char*>(buf);
+
+            setp(m_buf, m_buf + s_bufsize);
+        }
+
+    ~AlignedFileBuf() {
+        close();
+    }
+
+    bool is_open() const {
+        return m_fd >= 0;
+    }
+
+    void close() {
+        if (m_fd < 0)
+            return;
+
+        off_t logical_size = m_offset + (pptr() - pbase());
+
+        flush_buffer(true);
+
+        // the final chunk was written zero-padded: truncate the file
+        // back to its logical length
+        if (m_direct && (logical_size % s_align) != 0)
+            ftruncate(m_fd, logical_size);
+
+        if (m_dropcache) {
+            fdatasync(m_fd);
+            posix_fadvise(m_fd, 0, 0, POSIX_FADV_DONTNEED);
+        }
+
+        ::close(m_fd);
+        m_fd = -1;
+
+        free(m_buf);
+        m_buf = nullptr;
+    }
+
+protected:
+
+    virtual int_type overflow(int_type ch) {
+        if (!flush_buffer(false))
+            return traits_type::eof();
+
+        if (ch != traits_type::eof()) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+
+        return traits_type::not_eof(ch);
+    }
+
+    virtual std::streamsize xsputn(const char* data, std::streamsize count) {
+        std::streamsize written = 0;
+
+        while (written < count) {
+            std::streamsize avail = epptr() - pptr();
+
+            if (avail == 0) {
+                if (!flush_buffer(false))
+                    return written;
+
+                avail = epptr() - pptr();
+            }
+
+            std::streamsize n = std::min(avail, count - written);
+
+            memcpy(pptr(), data + written, n);
+            pbump(n);
+
+            written += n;
+        }
+
+        return written;
+    }
+
+    virtual int sync() {
+        return flush_buffer(false) ? 0 : -1;
+    }
+};
+
+} // namespace
+
+
+struct AlignedFileStream::AlignedFileStreamImpl
+{
+    AlignedFileBuf m_buf;
+    std::ostream   m_os;
+
+    AlignedFileStreamImpl(const std::string& filename, int flags)
+        : m_buf(filename, (flags & DirectIO) != 0, (flags & DropCache) != 0),
+          m_os(&m_buf)
+    { }
+};
+
+
+const size_t AlignedFileStream::alignment { ::s_align };
+
+AlignedFileStream::AlignedFileStream(const std::string& filename, int flags)
+    : mP(new AlignedFileStreamImpl(filename, flags))
+{ }
+
+AlignedFileStream::~AlignedFileStream()
+{
+    mP.reset();
+}
+
+std::ostream& AlignedFileStream::stream()
+{
+    return mP->m_os;
+}
+
+bool AlignedFileStream::is_open() const
+{
+    return mP && mP->m_buf.is_open();
+}
+
+void AlignedFileStream::flush()
+{
+    if (mP)
+        mP->m_os.flush();
+}
+
+void AlignedFileStream::close()
+{
+    if (mP) {
+        mP->m_os.flush();
+        mP->m_buf.close();
+    }
+}
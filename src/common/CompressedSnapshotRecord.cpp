@@ -98,10 +98,8 @@ void
 CompressedSnapshotRecordView::unpack_nodes(size_t n, cali_id_t node_vec[]) const
 {
     size_t max = std::min(n, m_num_nodes);
-    size_t pos = 1;
 
-    for (size_t i = 0; i < max; ++i)
-        node_vec[i] = vldec_u64(m_buffer+pos, &pos);
+    vldec_u64_arr(m_buffer+1, m_imm_pos-1, max, node_vec);
 }
 
 /// \brief Unpack immediate entries
@@ -125,10 +123,12 @@ CompressedSnapshotRecordView::to_entrylist(const CaliperMetadataAccessInterface*
     list.reserve(m_num_nodes + m_num_imm);
 
     {
-        size_t pos = 1;
+        cali_id_t node_vec[128];
+
+        vldec_u64_arr(m_buffer+1, m_imm_pos-1, m_num_nodes, node_vec);
 
         for (size_t i = 0; i < m_num_nodes; ++i)
-            list.push_back(Entry(c->node(vldec_u64(m_buffer+pos, &pos))));
+            list.push_back(Entry(c->node(node_vec[i])));
     }
 
     {
@@ -185,12 +185,14 @@ CompressedSnapshotRecord::append(size_t n, const Node* const node_vec[])
     // blockwise encode, size check, and copy
     while (n > 0) {
         unsigned char tmp[m_blocksize*10];
+        uint64_t      ids[m_blocksize];
         size_t blk = std::min(n, m_blocksize);
-        size_t len = 0;
 
         // encode to temp buffer
         for (size_t i = 0; i < blk; ++i)
-            len += vlenc_u64(node_vec[i]->id(), tmp+len);
+            ids[i] = node_vec[i]->id();
+
+        size_t len = vlenc_u64_arr(ids, blk, tmp);
 
         // size check, copy to actual buffer
         if (m_num_nodes+blk < 128 && m_imm_pos+m_imm_len+len <= m_buffer_len) {
@@ -216,6 +218,46 @@ CompressedSnapshotRecord::append(size_t n, const Node* const node_vec[])
     return skipped;
 }
 
+/// \brief Append node entries merged into a single path entry
+size_t
+CompressedSnapshotRecord::append_path(CaliperMetadataAccessInterface& db, size_t n, const Node* const node_vec[])
+{
+    // with one entry the record already stores a single path id
+    if (n < 2)
+        return append(n, node_vec);
+
+    // Flatten each entry's parent chain root-to-leaf and intern the
+    // concatenation as one path. The tree uniquifies paths, so repeated
+    // reference contexts collapse onto the same leaf node.
+
+    constexpr size_t max_path = 128;
+
+    const Node* chain[max_path];
+    size_t      len = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        size_t head = len;
+
+        for (const Node* node = node_vec[i]; node && node->attribute() != CALI_INV_ID; node = node->parent()) {
+            if (len >= max_path) // path too long: store entries individually
+                return append(n, node_vec);
+
+            chain[len++] = node;
+        }
+
+        std::reverse(chain+head, chain+len);
+    }
+
+    Node* path = db.make_tree_entry(len, chain);
+
+    if (!path)
+        return append(n, node_vec);
+
+    const Node* nodelist[1] = { path };
+
+    return append(1, nodelist);
+}
+
 /// \brief Append immediate entries
 size_t
 CompressedSnapshotRecord::append(size_t n, const cali_id_t attr_vec[], const Variant data_vec[])
@@ -224,7 +266,7 @@ CompressedSnapshotRecord::append(size_t n, const cali_id_t attr_vec[], const Var
 
     // blockwise encode, size check, and copy
     while (n > 0) {
-        unsigned char tmp[m_blocksize*30]; // holds immediate entries (10 bytes per id + 20 bytes per variant)
+        unsigned char tmp[m_blocksize*40]; // holds immediate entries (10 bytes per id + up to 25 bytes per variant incl. inline string data)
         size_t blk = std::min(n, m_blocksize);
         size_t len = 0;
 
@@ -313,4 +355,19 @@ CompressedSnapshotRecord::append(const SnapshotRecord* rec)
     return skipped;
 }
 
+/// \brief Append snapshot record with merged node entries
+size_t
+CompressedSnapshotRecord::append_path(CaliperMetadataAccessInterface& db, const SnapshotRecord* rec)
+{
+    size_t skipped = 0;
+
+    SnapshotRecord::Sizes size = rec->size();
+    SnapshotRecord::Data  data = rec->data();
+
+    skipped += append_path(db, size.n_nodes, data.node_entries);
+    skipped += append(size.n_immediate, data.immediate_attr, data.immediate_data);
+
+    return skipped;
+}
+
 constexpr size_t CompressedSnapshotRecord::m_blocksize;
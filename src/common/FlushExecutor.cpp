@@ -0,0 +1,195 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/// @file FlushExecutor.cpp
+/// FlushExecutor class implementation
+
+#include "caliper/common/FlushExecutor.h"
+
+#include "caliper/common/RuntimeConfig.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace cali;
+using namespace std;
+
+struct ExecutorImpl
+{
+    // --- data
+
+    static unique_ptr<ExecutorImpl> s_instance;
+
+    static const ConfigSet::Entry   s_configdata[];
+
+    unsigned                 m_num_threads;
+
+    std::vector<std::thread> m_workers;
+
+    std::mutex               m_run_lock;  // serializes batches
+
+    std::mutex               m_lock;
+    std::condition_variable  m_work_cv;
+    std::condition_variable  m_done_cv;
+
+    // current batch: workers claim task indices from m_next
+    const std::vector<FlushExecutor::Task>* m_tasks = nullptr;
+
+    std::atomic<size_t>      m_next      { 0 };
+    size_t                   m_num_tasks = 0;
+    size_t                   m_completed = 0;
+    unsigned                 m_batch     = 0;
+    bool                     m_stop      = false;
+
+    // --- interface
+
+    void worker_fn() {
+        unsigned last_batch = 0;
+
+        std::unique_lock<std::mutex> ul(m_lock);
+
+        while (true) {
+            m_work_cv.wait(ul, [this,&last_batch]{
+                    return m_stop || m_batch != last_batch;
+                });
+
+            if (m_stop)
+                return;
+
+            last_batch = m_batch;
+
+            ul.unlock();
+
+            // claim tasks from the shared counter: workers that finish
+            // early pick up the remaining ones
+
+            size_t done = 0;
+
+            for (size_t i = m_next++; i < m_num_tasks; i = m_next++) {
+                (*m_tasks)[i]();
+                ++done;
+            }
+
+            ul.lock();
+
+            m_completed += done;
+
+            if (m_completed == m_num_tasks)
+                m_done_cv.notify_all();
+        }
+    }
+
+    void run(const std::vector<FlushExecutor::Task>& tasks) {
+        if (m_num_threads <= 1 || tasks.size() <= 1) {
+            for (const FlushExecutor::Task& t : tasks)
+                t();
+
+            return;
+        }
+
+        std::lock_guard<std::mutex>
+            gr(m_run_lock);
+
+        if (m_workers.empty())
+            for (unsigned t = 0; t < m_num_threads; ++t)
+                m_workers.emplace_back(&ExecutorImpl::worker_fn, this);
+
+        std::unique_lock<std::mutex> ul(m_lock);
+
+        m_tasks     = &tasks;
+        m_num_tasks = tasks.size();
+        m_completed = 0;
+
+        m_next.store(0);
+
+        ++m_batch;
+
+        m_work_cv.notify_all();
+        m_done_cv.wait(ul, [this]{ return m_completed == m_num_tasks; });
+
+        m_tasks = nullptr;
+    }
+
+    ExecutorImpl() {
+        ConfigSet config = RuntimeConfig::init("flush", s_configdata);
+
+        m_num_threads = config.get("threads").to_uint();
+    }
+
+    ~ExecutorImpl() {
+        {
+            std::lock_guard<std::mutex> g(m_lock);
+            m_stop = true;
+        }
+
+        m_work_cv.notify_all();
+
+        for (std::thread& w : m_workers)
+            w.join();
+    }
+
+    static ExecutorImpl* instance() {
+        if (!s_instance)
+            s_instance.reset(new ExecutorImpl);
+
+        return s_instance.get();
+    }
+};
+
+unique_ptr<ExecutorImpl> ExecutorImpl::s_instance { nullptr };
+
+const ConfigSet::Entry ExecutorImpl::s_configdata[] = {
+    // key, type, value, short description, long description
+    { "threads", CALI_TYPE_UINT, "4",
+      "Number of worker threads for flush tasks",
+      "Number of worker threads in the shared flush pool. Services"
+      "submit independent flush tasks (per-thread trace buffer drains,"
+      "aggregation merge partitions) to the pool instead of running"
+      "them sequentially on the flushing thread.\n"
+      "0 or 1: tasks run on the flushing thread." },
+
+    ConfigSet::Terminator
+};
+
+void FlushExecutor::run(const std::vector<Task>& tasks)
+{
+    ExecutorImpl::instance()->run(tasks);
+}
+
+unsigned FlushExecutor::num_threads()
+{
+    return ExecutorImpl::instance()->m_num_threads;
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @file Health.cpp
+/// Health class implementation
+
+#include "caliper/common/Health.h"
+
+#include <atomic>
+
+using namespace cali;
+
+namespace
+{
+
+const char* s_counter_names[Health::NumCounters] = {
+    "dropped.snapshots", "dropped.bytes", "failed.nodes"
+};
+
+// zero-initialized statics: no init-order dependency, drop sites can
+// report before any Caliper subsystem is up
+std::atomic<std::size_t> s_counters[Health::NumCounters];
+
+} // namespace
+
+void Health::inc(Counter c, std::size_t n)
+{
+    s_counters[c].fetch_add(n, std::memory_order_relaxed);
+}
+
+std::size_t Health::count(Counter c)
+{
+    return s_counters[c].load(std::memory_order_relaxed);
+}
+
+const char* Health::counter_name(Counter c)
+{
+    return s_counter_names[c];
+}
+
+bool Health::any()
+{
+    for (int c = 0; c < NumCounters; ++c)
+        if (s_counters[c].load(std::memory_order_relaxed) > 0)
+            return true;
+
+    return false;
+}
+
+std::ostream& Health::print_statistics(std::ostream& os)
+{
+    os << "Data loss:";
+
+    for (int c = 0; c < NumCounters; ++c)
+        os << "\n      " << s_counter_names[c] << ": "
+           << s_counters[c].load(std::memory_order_relaxed);
+
+    return os;
+}
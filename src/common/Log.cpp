@@ -36,8 +36,12 @@
 #include "caliper/common/Log.h"
 #include "caliper/common/RuntimeConfig.h"
 
+#include <atomic>
+#include <chrono>
+#include <iomanip>
 #include <memory>
 #include <map>
+#include <thread>
 
 using namespace cali;
 using namespace std;
@@ -54,6 +58,14 @@ struct LogImpl
 
     enum class Stream { StdOut, StdErr, None, File };
 
+    // async mode log record: formatted message with the timestamp
+    // captured at enqueue
+    struct LogRecord {
+        std::string msg;
+        double      timestamp;
+        LogRecord*  next;
+    };
+
     ConfigSet     m_config;
 
     Stream        m_stream;
@@ -62,6 +74,15 @@ struct LogImpl
 
     std::string   m_prefix;
 
+    bool          m_async    { false };
+
+    std::atomic<LogRecord*> m_queue { nullptr };
+    std::atomic<bool>       m_done  { false };
+
+    std::thread   m_logger_thread;
+
+    std::chrono::steady_clock::time_point m_start_time;
+
     // --- helpers
 
     void init_stream() {
@@ -85,14 +106,84 @@ struct LogImpl
             m_stream = it->second;
     }
 
+    // --- async mode
+
+    void enqueue(std::string&& msg) {
+        double timestamp =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start_time).count();
+
+        LogRecord* rec = new LogRecord { std::move(msg), timestamp, nullptr };
+
+        rec->next = m_queue.load(std::memory_order_relaxed);
+
+        while (!m_queue.compare_exchange_weak(rec->next, rec,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed))
+            ;
+    }
+
+    void write_records() {
+        LogRecord* rec = m_queue.exchange(nullptr, std::memory_order_acquire);
+
+        // the queue is a lifo list: reverse it to restore enqueue order
+
+        LogRecord* head = nullptr;
+
+        while (rec) {
+            LogRecord* next = rec->next;
+
+            rec->next = head;
+            head      = rec;
+            rec       = next;
+        }
+
+        ostream& os = get_stream();
+
+        while (head) {
+            LogRecord* next = head->next;
+
+            os << m_prefix
+               << '[' << fixed << setprecision(6) << head->timestamp << "] "
+               << head->msg;
+
+            delete head;
+            head = next;
+        }
+
+        os << flush;
+    }
+
+    void logger_loop() {
+        while (!m_done.load(std::memory_order_acquire)) {
+            write_records();
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+
+        // final drain
+        write_records();
+    }
+
     // --- interface
 
-    LogImpl() 
+    LogImpl()
         : m_config { RuntimeConfig::init("log", s_configdata) },
           m_prefix { s_prefix }
     {
-        m_verbosity = m_config.get("verbosity").to_uint();
+        m_verbosity  = m_config.get("verbosity").to_uint();
+        m_async      = m_config.get("async").to_bool();
+        m_start_time = std::chrono::steady_clock::now();
+
         init_stream();
+
+        if (m_async)
+            m_logger_thread = std::thread(&LogImpl::logger_loop, this);
+    }
+
+    ~LogImpl() {
+        if (m_logger_thread.joinable()) {
+            m_done.store(true, std::memory_order_release);
+            m_logger_thread.join();
+        }
     }
 
     ostream& get_stream() {
@@ -134,7 +225,14 @@ const ConfigSet::Entry LogImpl::s_configdata[] = {
       "   none:   No output,\n"
       " or a log file name."
     },
-    ConfigSet::Terminator 
+    { "async",     CALI_TYPE_BOOL,   "false",
+      "Write log messages asynchronously",
+      "Write log messages asynchronously. Formatted messages are staged\n"
+      "in a lock-free queue and written by a background logger thread,\n"
+      "with timestamps captured at enqueue. Keeps log I/O off the\n"
+      "calling thread's critical path."
+    },
+    ConfigSet::Terminator
 };
 
 
@@ -142,12 +240,24 @@ const ConfigSet::Entry LogImpl::s_configdata[] = {
 // --- Log public interface
 //
 
-ostream& 
+ostream&
 Log::get_stream()
 {
     return (LogImpl::instance()->get_stream() << LogImpl::instance()->m_prefix);
 }
 
+bool
+Log::is_async()
+{
+    return LogImpl::instance()->m_async;
+}
+
+void
+Log::push_record()
+{
+    LogImpl::instance()->enqueue(m_sstream.str());
+}
+
 unsigned 
 Log::verbosity()
 {
@@ -0,0 +1,178 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @file MemoryBudget.cpp
+/// MemoryBudget class implementation
+
+#include "caliper/common/MemoryBudget.h"
+
+#include "caliper/common/RuntimeConfig.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+using namespace cali;
+using namespace std;
+
+namespace
+{
+
+const char* s_component_names[MemoryBudget::NumComponents] = {
+    "metadata", "trace", "aggregate"
+};
+
+} // namespace
+
+struct BudgetImpl
+{
+    // --- data
+
+    static unique_ptr<BudgetImpl>  s_instance;
+
+    static const ConfigSet::Entry  s_configdata[];
+
+    std::atomic<size_t> m_usage[MemoryBudget::NumComponents];
+
+    size_t              m_budget;    // total budget in bytes, 0: unlimited
+    size_t              m_watermark; // soft watermark in bytes
+
+    // --- interface
+
+    size_t total_usage() const {
+        size_t total = 0;
+
+        for (int c = 0; c < MemoryBudget::NumComponents; ++c)
+            total += m_usage[c].load(std::memory_order_relaxed);
+
+        return total;
+    }
+
+    std::ostream& print_statistics(std::ostream& os) const {
+        os << "Memory usage: " << total_usage() << " bytes";
+
+        if (m_budget > 0)
+            os << " of " << m_budget << " bytes budget";
+
+        for (int c = 0; c < MemoryBudget::NumComponents; ++c) {
+            size_t bytes = m_usage[c].load(std::memory_order_relaxed);
+
+            if (bytes > 0)
+                os << "\n      " << s_component_names[c] << ": " << bytes << " bytes";
+        }
+
+        return os;
+    }
+
+    BudgetImpl() {
+        ConfigSet config = RuntimeConfig::init("membudget", s_configdata);
+
+        m_budget    = config.get("total").to_uint() * 1024 * 1024;
+        m_watermark =
+            (m_budget / 100) * std::min<uint64_t>(config.get("watermark").to_uint(), 100);
+
+        for (int c = 0; c < MemoryBudget::NumComponents; ++c)
+            m_usage[c].store(0, std::memory_order_relaxed);
+    }
+
+    static BudgetImpl* instance() {
+        if (!s_instance)
+            s_instance.reset(new BudgetImpl);
+
+        return s_instance.get();
+    }
+};
+
+unique_ptr<BudgetImpl> BudgetImpl::s_instance { nullptr };
+
+const ConfigSet::Entry BudgetImpl::s_configdata[] = {
+    // key, type, value, short description, long description
+    { "total", CALI_TYPE_UINT, "0",
+      "Total memory budget in MiB",
+      "Total budget for Caliper's in-process memory (metadata pool,"
+      "trace buffers, aggregation databases) in MiB. Components"
+      "degrade gracefully (flush early, stop recording, stop adding"
+      "aggregation keys) as usage approaches the budget.\n"
+      "0: no budget." },
+    { "watermark", CALI_TYPE_UINT, "80",
+      "Soft watermark in percent of the total budget",
+      "Soft watermark in percent of the total budget. Components"
+      "start degrading when total usage crosses the watermark,"
+      "e.g. the trace service flushes its buffers instead of"
+      "growing them." },
+
+    ConfigSet::Terminator
+};
+
+void MemoryBudget::add(Component c, size_t bytes)
+{
+    BudgetImpl::instance()->m_usage[c].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void MemoryBudget::sub(Component c, size_t bytes)
+{
+    BudgetImpl::instance()->m_usage[c].fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+size_t MemoryBudget::usage(Component c)
+{
+    return BudgetImpl::instance()->m_usage[c].load(std::memory_order_relaxed);
+}
+
+size_t MemoryBudget::total_usage()
+{
+    return BudgetImpl::instance()->total_usage();
+}
+
+size_t MemoryBudget::budget()
+{
+    return BudgetImpl::instance()->m_budget;
+}
+
+bool MemoryBudget::over_watermark()
+{
+    BudgetImpl* b = BudgetImpl::instance();
+
+    return b->m_budget > 0 && b->total_usage() > b->m_watermark;
+}
+
+bool MemoryBudget::exceeded()
+{
+    BudgetImpl* b = BudgetImpl::instance();
+
+    return b->m_budget > 0 && b->total_usage() > b->m_budget;
+}
+
+std::ostream& MemoryBudget::print_statistics(std::ostream& os)
+{
+    return BudgetImpl::instance()->print_statistics(os);
+}
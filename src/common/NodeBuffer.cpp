@@ -7,7 +7,9 @@
 
 #include <caliper/common/c-util/vlenc.h>
 
+#include <algorithm>
 #include <cstring>
+#include <vector>
 
 using namespace cali;
 
@@ -77,6 +79,119 @@ namespace
 
         return ret;
     }
+
+    //
+    // --- Bulk batch encoding
+    //
+    // A batch stores many nodes in one record, sorted by node id:
+    //
+    //   varint batch marker (2 * CALI_INV_ID; no valid node record
+    //     starts with an invalid node id, so the decoder can tell
+    //     batches and per-node records apart)
+    //   varint number of nodes
+    //   varint dictionary size, then the distinct attribute ids of the
+    //     batch in ascending order, delta-encoded
+    //   per node: varint id delta to the previous node, varint index
+    //     into the attribute dictionary, varint parent reference
+    //     (0 = no parent, else distance below the node's own id),
+    //     varint type, varint size, value bytes
+    //
+    // Delta-encoded ids and parent references and the shared
+    // dictionary keep the headers to a byte or two per node, where the
+    // per-node encoding repeats full ids for every record.
+    //
+
+    const uint64_t batch_marker = 2 * CALI_INV_ID;
+
+    size_t pack_batch(unsigned char* buf,
+                      const std::vector<const NodeBuffer::NodeInfo*>& nodes,
+                      const std::vector<cali_id_t>& dict)
+    {
+        size_t pos = 0;
+
+        pos += vlenc_u64(batch_marker, buf+pos);
+        pos += vlenc_u64(nodes.size(), buf+pos);
+        pos += vlenc_u64(dict.size(),  buf+pos);
+
+        cali_id_t prev = 0;
+
+        for (cali_id_t attr_id : dict) {
+            pos += vlenc_u64(attr_id - prev, buf+pos);
+            prev = attr_id;
+        }
+
+        prev = 0;
+
+        for (const NodeBuffer::NodeInfo* info : nodes) {
+            size_t index =
+                std::lower_bound(dict.begin(), dict.end(), info->attr_id) - dict.begin();
+
+            pos += vlenc_u64(info->node_id - prev, buf+pos);
+            prev = info->node_id;
+
+            pos += vlenc_u64(index, buf+pos);
+            pos += vlenc_u64(info->parent_id == CALI_INV_ID ?
+                             0 : info->node_id - info->parent_id, buf+pos);
+
+            pos += vlenc_u64(static_cast<uint64_t>(info->value.type()), buf+pos);
+            pos += vlenc_u64(info->value.size(), buf+pos);
+            memcpy(buf+pos, info->value.data(), info->value.size());
+
+            pos += info->value.size();
+        }
+
+        return pos;
+    }
+
+    // Decode a batch record. \a buf points past the batch marker;
+    // returns the number of nodes decoded.
+    size_t unpack_batch(const unsigned char* buf, size_t* inc,
+                        const std::function<void(const NodeBuffer::NodeInfo&)>& fn)
+    {
+        size_t pos = 0;
+
+        uint64_t n_nodes = vldec_u64(buf+pos, &pos);
+        uint64_t n_dict  = vldec_u64(buf+pos, &pos);
+
+        std::vector<cali_id_t> dict(n_dict, CALI_INV_ID);
+
+        cali_id_t prev = 0;
+
+        for (uint64_t d = 0; d < n_dict; ++d) {
+            prev   += vldec_u64(buf+pos, &pos);
+            dict[d] = prev;
+        }
+
+        prev = 0;
+
+        for (uint64_t n = 0; n < n_nodes; ++n) {
+            NodeBuffer::NodeInfo info = { CALI_INV_ID, CALI_INV_ID, CALI_INV_ID, Variant() };
+
+            prev += vldec_u64(buf+pos, &pos);
+            info.node_id = prev;
+
+            uint64_t index   = vldec_u64(buf+pos, &pos);
+            uint64_t par_ref = vldec_u64(buf+pos, &pos);
+
+            info.attr_id   = index < n_dict ? dict[index] : CALI_INV_ID;
+            info.parent_id = par_ref > 0 ? info.node_id - par_ref : CALI_INV_ID;
+
+            uint64_t u    = vldec_u64(buf+pos, &pos);
+            size_t   size = vldec_u64(buf+pos, &pos);
+
+            cali_attr_type type = (u <= CALI_MAXTYPE ? static_cast<cali_attr_type>(u) : CALI_TYPE_INV);
+
+            info.value = Variant(type, buf+pos, size);
+
+            pos += size;
+
+            fn(info);
+        }
+
+        *inc += pos;
+
+        return n_nodes;
+    }
 }
 
 unsigned char*
@@ -126,7 +241,75 @@ NodeBuffer::append(const Node* node)
 {
     append(::make_nodeinfo(node));
 }
-    
+
+void
+NodeBuffer::append_batch(size_t n, const NodeInfo* info)
+{
+    if (n < 1)
+        return;
+
+    // Sort by node id for delta encoding. Parents precede their
+    // children in Caliper's append-only node ids; a node that breaks
+    // that assumption can't use the relative parent reference and
+    // takes the per-node encoding instead.
+
+    std::vector<const NodeInfo*> nodes;
+    std::vector<const NodeInfo*> scalar;
+
+    nodes.reserve(n);
+
+    for (size_t i = 0; i < n; ++i)
+        if (info[i].parent_id != CALI_INV_ID && info[i].parent_id >= info[i].node_id)
+            scalar.push_back(info + i);
+        else
+            nodes.push_back(info + i);
+
+    if (!nodes.empty()) {
+        std::sort(nodes.begin(), nodes.end(),
+                  [](const NodeInfo* a, const NodeInfo* b){
+                      return a->node_id < b->node_id;
+                  });
+
+        // attribute-id dictionary shared across the batch
+
+        std::vector<cali_id_t> dict;
+
+        dict.reserve(16);
+
+        for (const NodeInfo* p : nodes)
+            dict.push_back(p->attr_id);
+
+        std::sort(dict.begin(), dict.end());
+        dict.erase(std::unique(dict.begin(), dict.end()), dict.end());
+
+        size_t max_size = 50 + 10 * dict.size();
+
+        for (const NodeInfo* p : nodes)
+            max_size += ::max_packed_size(*p);
+
+        reserve(m_pos + max_size);
+
+        m_pos   += ::pack_batch(m_buffer + m_pos, nodes, dict);
+        m_count += nodes.size();
+    }
+
+    for (const NodeInfo* p : scalar)
+        append(*p);
+}
+
+void
+NodeBuffer::append_batch(size_t n, const Node* const* nodes)
+{
+    std::vector<NodeInfo> info;
+
+    info.reserve(n);
+
+    for (size_t i = 0; i < n; ++i)
+        info.push_back(::make_nodeinfo(nodes[i]));
+
+    append_batch(info.size(), info.data());
+}
+
 
 /// \brief Expose buffer for read from external source (e.g., MPI),
 /// and set count and size.
@@ -145,7 +328,19 @@ void
 NodeBuffer::for_each(const std::function<void(const NodeInfo&)> fn) const
 {
     size_t pos = 0;
-    
-    for (size_t i = 0; i < m_count && pos < m_pos; ++i)
-        fn(::unpack_node(m_buffer + pos, &pos));
+
+    for (size_t i = 0; i < m_count && pos < m_pos; ) {
+        // peek at the record header: batch or per-node record?
+
+        size_t   p = pos;
+        uint64_t u = vldec_u64(m_buffer + p, &p);
+
+        if (u == ::batch_marker) {
+            i  += ::unpack_batch(m_buffer + p, &p, fn);
+            pos = p;
+        } else {
+            fn(::unpack_node(m_buffer + pos, &pos));
+            ++i;
+        }
+    }
 }
@@ -36,10 +36,16 @@
 #include "caliper/common/RuntimeConfig.h"
 
 #include "caliper/common/util/split.hpp"
+#include "caliper/common/util/stringview.hpp"
+
+#include "caliper/common/c-util/vlenc.h"
 
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <iterator>
@@ -48,6 +54,11 @@
 #include <unordered_map>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace cali;
 using namespace std;
 
@@ -69,6 +80,79 @@ namespace
         "CALI_SERVICES_ENABLE=event:recorder:timestamp:libpfm\n"
         "CALI_LOG_VERBOSITY=2\n";
 
+    //
+    // --- config cache helpers
+    //
+
+    // Preparsed config cache file layout: magic word, cache key
+    // (hash over config file names, mtimes and sizes, the relevant
+    // environment variables, and the builtin profiles), then the
+    // parsed profile database as varint-length-prefixed strings.
+
+    const uint64_t cache_magic   = UINT64_C(0x43616c69436e6667); /* "CaliCnfg" */
+
+    const char*    cache_env[]   = { "CALI_CONFIG_FILE", "CALI_CONFIG_PROFILE", nullptr };
+
+    uint64_t hash_data(uint64_t h, const void* data, size_t len) {
+        // FNV-1a
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+
+        for (size_t i = 0; i < len; ++i) {
+            h ^= p[i];
+            h *= UINT64_C(0x100000001b3);
+        }
+
+        return h;
+    }
+
+    uint64_t hash_string(uint64_t h, const string& str) {
+        return hash_data(h, str.data(), str.size());
+    }
+
+    void append_u64(vector<unsigned char>& buf, uint64_t val) {
+        unsigned char tmp[10];
+        size_t        len = vlenc_u64(val, tmp);
+
+        buf.insert(buf.end(), tmp, tmp+len);
+    }
+
+    void append_string(vector<unsigned char>& buf, const string& str) {
+        append_u64(buf, str.size());
+        buf.insert(buf.end(), str.begin(), str.end());
+    }
+
+    // bounds-checked varint decoder for the mmap'd cache blob
+    bool cache_dec_u64(const unsigned char* buf, size_t size, size_t* pos, uint64_t* val) {
+        uint64_t v = 0;
+        size_t   p = *pos;
+
+        for (unsigned shift = 0; p < size && shift < 64; shift += 7) {
+            unsigned char c = buf[p++];
+
+            v |= static_cast<uint64_t>(c & 0x7F) << shift;
+
+            if (!(c & 0x80)) {
+                *pos = p;
+                *val = v;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool cache_dec_string(const unsigned char* buf, size_t size, size_t* pos, string& str) {
+        uint64_t len;
+
+        if (!cache_dec_u64(buf, size, pos, &len) || *pos + len > size)
+            return false;
+
+        str.assign(reinterpret_cast<const char*>(buf) + *pos, len);
+        *pos += len;
+
+        return true;
+    }
+
     string config_var_name(const string& name, const string& key) {
         // make uppercase PREFIX_NAMESPACE_KEY string
 
@@ -96,13 +180,38 @@ struct ConfigSetImpl
 
     unordered_map<string, ConfigSet::Entry> m_dict;
 
+    // deferred initialization: entry list and profile to read from,
+    // evaluated on first access
+    string                     m_name;
+    const ConfigSet::Entry*    m_list    { nullptr };
+    const map<string, string>* m_profile { nullptr };
+
+    bool                       m_materialized { true };
+
     // --- interface
 
-    StringConverter get(const char* key) const {
+    StringConverter get(const char* key) {
+        materialize();
+
         auto it = m_dict.find(key);
         return (it == m_dict.end() ? StringConverter() : StringConverter(it->second.value));
     }
 
+    void init_deferred(const char* name, const ConfigSet::Entry* list, const map<string, string>* profile) {
+        m_name         = name;
+        m_list         = list;
+        m_profile      = profile;
+        m_materialized = false;
+    }
+
+    void materialize() {
+        if (m_materialized)
+            return;
+
+        m_materialized = true;
+        init(m_name.c_str(), m_list, *m_profile);
+    }
+
     void init(const char* name, const ConfigSet::Entry* list, const map<string, string>& profile) {
         for (const ConfigSet::Entry* e = list; e && e->key; ++e) {
             ConfigSet::Entry newent = *e;
@@ -193,20 +302,160 @@ struct RuntimeConfigImpl
 
         istringstream is(::builtin_profiles);
         read_config_profiles(is);
-        
+
         // read config files
-        vector<string> files;
+        vector<util::stringview> files;
 
-        util::split(filenames, ':', back_inserter(files));
+        util::split(util::stringview(filenames), ':', back_inserter(files));
 
-        for (const auto &s : files) {
-            ifstream fs(s.c_str());
+        for (util::stringview s : files) {
+            ifstream fs(s.to_string().c_str());
 
             if (fs)
                 read_config_profiles(fs);
         }
     }
 
+    // --- preparsed config cache
+
+    uint64_t compute_cache_key(const std::string& filenames) const {
+        uint64_t h = UINT64_C(0xcbf29ce484222325);
+
+        // builtin profiles change across versions
+        h = ::hash_data(h, ::builtin_profiles, strlen(::builtin_profiles));
+        h = ::hash_string(h, filenames);
+
+        // config file mtimes and sizes
+        vector<util::stringview> files;
+
+        util::split(util::stringview(filenames), ':', back_inserter(files));
+
+        for (util::stringview s : files) {
+            struct stat st;
+
+            if (stat(s.to_string().c_str(), &st) == 0) {
+                h = ::hash_data(h, &st.st_mtime, sizeof(st.st_mtime));
+                h = ::hash_data(h, &st.st_size,  sizeof(st.st_size));
+            } else {
+                h = ::hash_string(h, "<none>");
+            }
+        }
+
+        // environment variables that select config files and profile
+
+        for (const char** e = ::cache_env; *e; ++e) {
+            const char* val = getenv(*e);
+
+            h = ::hash_string(h, *e);
+            h = ::hash_string(h, val ? val : "<unset>");
+        }
+
+        return h;
+    }
+
+    bool read_config_cache(const char* path, uint64_t key) {
+        int fd = open(path, O_RDONLY);
+
+        if (fd == -1)
+            return false;
+
+        struct stat st;
+
+        if (fstat(fd, &st) == -1 || st.st_size < 16) {
+            close(fd);
+            return false;
+        }
+
+        size_t size = static_cast<size_t>(st.st_size);
+        void*  ptr  = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        close(fd);
+
+        if (ptr == MAP_FAILED)
+            return false;
+
+        const unsigned char* buf = static_cast<const unsigned char*>(ptr);
+
+        uint64_t magic, blob_key;
+
+        memcpy(&magic,    buf,   8);
+        memcpy(&blob_key, buf+8, 8);
+
+        bool ok = (magic == ::cache_magic && blob_key == key);
+
+        if (ok) {
+            size_t   pos = 16;
+            uint64_t n_profiles;
+
+            ok = ::cache_dec_u64(buf, size, &pos, &n_profiles);
+
+            for (uint64_t p = 0; ok && p < n_profiles; ++p) {
+                string   profile_name;
+                uint64_t n_entries;
+
+                ok = ::cache_dec_string(buf, size, &pos, profile_name)
+                    && ::cache_dec_u64(buf, size, &pos, &n_entries);
+
+                for (uint64_t i = 0; ok && i < n_entries; ++i) {
+                    string entry_key, entry_val;
+
+                    ok = ::cache_dec_string(buf, size, &pos, entry_key)
+                        && ::cache_dec_string(buf, size, &pos, entry_val);
+
+                    if (ok)
+                        m_config_profiles[profile_name][entry_key] = entry_val;
+                }
+            }
+
+            if (!ok) // partial or damaged blob: discard and re-parse
+                m_config_profiles.clear();
+        }
+
+        munmap(ptr, size);
+
+        return ok;
+    }
+
+    void write_config_cache(const char* path, uint64_t key) const {
+        vector<unsigned char> buf;
+
+        buf.resize(16);
+
+        memcpy(buf.data(),   &::cache_magic, 8);
+        memcpy(buf.data()+8, &key,           8);
+
+        ::append_u64(buf, m_config_profiles.size());
+
+        for (const auto& p : m_config_profiles) {
+            ::append_string(buf, p.first);
+            ::append_u64(buf, p.second.size());
+
+            for (const auto& e : p.second) {
+                ::append_string(buf, e.first);
+                ::append_string(buf, e.second);
+            }
+        }
+
+        // write to a temp file and rename so concurrently starting
+        // processes never see a partial blob
+
+        string tmp_path = string(path) + ".tmp." + std::to_string(getpid());
+
+        int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+        if (fd == -1)
+            return;
+
+        ssize_t ret = write(fd, buf.data(), buf.size());
+
+        close(fd);
+
+        if (ret == static_cast<ssize_t>(buf.size()))
+            rename(tmp_path.c_str(), path);
+        else
+            unlink(tmp_path.c_str());
+    }
+
 
     // --- interface
 
@@ -227,13 +476,18 @@ struct RuntimeConfigImpl
 
         shared_ptr<ConfigSetImpl> ret { new ConfigSetImpl };
 
-        ret->init(name, list, m_config_profiles[m_profile_name]);
+        // defer entry evaluation to the first access so config sets of
+        // services that never start are not materialized at all
+        ret->init_deferred(name, list, &m_config_profiles[m_profile_name]);
         m_database.insert(it, make_pair(string(name), ret));
 
         return ret;
     }
 
     void print(ostream& os) const {
+        for ( auto set : m_database )
+            set.second->materialize();
+
         for ( auto set : m_database )
             for ( auto entry : set.second->m_dict )
                 os << "# " << entry.second.descr << " (" << cali_type2string(entry.second.type) << ")\n" 
@@ -247,8 +501,21 @@ struct RuntimeConfigImpl
 
         pre_init_config.init("config", s_configdata, map<string, string>());
 
-        // read config files
-        read_config_files(pre_init_config.get("file").to_string());
+        string filenames = pre_init_config.get("file").to_string();
+
+        // read config files, through the preparsed cache if enabled
+
+        if (pre_init_config.get("cache").to_bool()) {
+            string   cachefile = pre_init_config.get("cachefile").to_string();
+            uint64_t key       = compute_cache_key(filenames);
+
+            if (!read_config_cache(cachefile.c_str(), key)) {
+                read_config_files(filenames);
+                write_config_cache(cachefile.c_str(), key);
+            }
+        } else {
+            read_config_files(filenames);
+        }
     }
 
     static RuntimeConfigImpl* instance() {
@@ -273,7 +540,18 @@ const ConfigSet::Entry RuntimeConfigImpl::s_configdata[] = {
     },
     { "file", CALI_TYPE_STRING, "caliper.config",
       "List of configuration files",
-      "Colon-serparated list of configuration files" 
+      "Colon-serparated list of configuration files"
+    },
+    { "cache", CALI_TYPE_BOOL, "false",
+      "Use the preparsed configuration cache",
+      "Use the preparsed configuration cache. The first process parses the\n"
+      "configuration files and writes a binary blob that subsequent processes\n"
+      "map instead of re-parsing. The cache is invalidated when the files,\n"
+      "their modification times, or the config environment variables change."
+    },
+    { "cachefile", CALI_TYPE_STRING, "caliper.config.cache",
+      "Preparsed configuration cache file",
+      "Preparsed configuration cache file"
     },
     ConfigSet::Terminator
 };
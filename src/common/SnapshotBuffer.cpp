@@ -5,71 +5,122 @@
 
 #include "caliper/common/CompressedSnapshotRecord.h"
 
+#include <algorithm>
 #include <cstring>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 
 using namespace cali;
 
-unsigned char*
-SnapshotBuffer::reserve(size_t min) {
-    if (min <= m_reserved_len)
-        return m_buffer;
+namespace
+{
+    const size_t default_reserve = 64 * 1024;
+}
+
+// Ensure capacity for \a need bytes. On Linux, the buffer is an
+// anonymous mapping grown with mremap(): the kernel remaps pages, so
+// existing contents are never copied, and pages beyond the append
+// cursor stay untouched (no physical memory). Doubling the
+// reservation thus only consumes address space.
+void
+SnapshotBuffer::grow(size_t need)
+{
+    size_t reserve = std::max(std::max(2 * m_reserved, m_initial), need);
+
+#ifdef __linux__
+    void* p = m_data ?
+        mremap(m_data, m_reserved, reserve, MREMAP_MAYMOVE) :
+        mmap(nullptr, reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 
-    m_reserved_len = 4096 + min * 2;
+    if (p == MAP_FAILED)
+        throw std::bad_alloc();
+#else
+    void* p = ::operator new(reserve);
 
-    unsigned char* tmp = new unsigned char[m_reserved_len];
-    memcpy(tmp, m_buffer, m_pos);
-    delete[] m_buffer;
-    m_buffer = tmp;
+    if (m_data) {
+        memcpy(p, m_data, m_pos);
+        ::operator delete(m_data);
+    }
+#endif
 
-    return m_buffer;
+    m_data     = static_cast<unsigned char*>(p);
+    m_reserved = reserve;
 }
 
 SnapshotBuffer::SnapshotBuffer()
     : m_count(0),
       m_pos(0),
-      m_reserved_len(0),
-      m_buffer(0)
+      m_initial(::default_reserve),
+      m_reserved(0),
+      m_data(nullptr)
 { }
 
 SnapshotBuffer::SnapshotBuffer(size_t size)
     : m_count(0),
       m_pos(0),
-      m_reserved_len(size),
-      m_buffer(new unsigned char[size])
+      m_initial(size > 0 ? size : ::default_reserve),
+      m_reserved(0),
+      m_data(nullptr)
 { }
 
 SnapshotBuffer::~SnapshotBuffer() {
-    delete[] m_buffer;
+    if (m_data) {
+#ifdef __linux__
+        munmap(m_data, m_reserved);
+#else
+        ::operator delete(m_data);
+#endif
+    }
 }
 
 void
 SnapshotBuffer::append(const CompressedSnapshotRecord& rec)
 {
-    memcpy(reserve(m_pos + rec.size()) + m_pos, rec.data(), rec.size());
-    
-    m_pos += rec.size();
-    ++m_count;    
+    size_t len = rec.size();
+
+    if (m_pos + len > m_reserved)
+        grow(m_pos + len);
+
+    memcpy(m_data + m_pos, rec.data(), len);
+
+    m_pos += len;
+    ++m_count;
 }
-    
 
 /// \brief Expose buffer for read from external source (e.g., MPI),
 /// and set count and size.
 unsigned char*
 SnapshotBuffer::import(size_t size, size_t count)
 {
-    reserve(size);
-        
+    if (size > m_reserved)
+        grow(size);
+
     m_pos   = size;
     m_count = count;
-        
-    return m_buffer;
+
+    return m_data;
+}
+
+void
+SnapshotBuffer::release()
+{
+    m_pos   = 0;
+    m_count = 0;
+
+#ifdef __linux__
+    if (m_data)
+        madvise(m_data, m_reserved, MADV_DONTNEED);
+#endif
 }
 
 void
 SnapshotBuffer::for_each(const std::function<void(const CompressedSnapshotRecordView&)> fn) const
 {
     size_t pos = 0;
-    
+
     for (size_t i = 0; i < m_count && pos < m_pos; ++i)
-        fn(CompressedSnapshotRecordView(m_buffer + pos, &pos));
+        fn(CompressedSnapshotRecordView(m_data + pos, &pos));
 }
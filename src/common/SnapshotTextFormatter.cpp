@@ -9,12 +9,135 @@
 #include "caliper/common/util/split.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
 #include <iterator>
 #include <mutex>
 #include <vector>
 
 using namespace cali;
 
+namespace
+{
+
+// Locale-free value-to-string routines. Values are appended to a
+// record buffer which is written out in a single call, bypassing the
+// ostream formatting machinery on the hot path. The output matches
+// Variant::to_string().
+
+void append_uint(std::string& buf, uint64_t val)
+{
+    char  tmp[24];
+    char* p = tmp + sizeof(tmp);
+
+    do {
+        *--p = '0' + static_cast<char>(val % 10);
+        val /= 10;
+    } while (val > 0);
+
+    buf.append(p, tmp + sizeof(tmp) - p);
+}
+
+void append_hex(std::string& buf, uint64_t val)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    char  tmp[16];
+    char* p = tmp + sizeof(tmp);
+
+    do {
+        *--p = digits[val % 16];
+        val /= 16;
+    } while (val > 0);
+
+    buf.append(p, tmp + sizeof(tmp) - p);
+}
+
+// Fixed-point with six decimal places, like std::to_string(double).
+// Values whose integer part doesn't fit uint64_t go through snprintf.
+void append_double(std::string& buf, double val)
+{
+    if (!std::isfinite(val) || std::fabs(val) >= 9.2e18) {
+        char tmp[344];
+        int  n = snprintf(tmp, sizeof(tmp), "%f", val);
+
+        if (n > 0)
+            buf.append(tmp, std::min<size_t>(n, sizeof(tmp)-1));
+
+        return;
+    }
+
+    if (std::signbit(val)) {
+        buf.push_back('-');
+        val = -val;
+    }
+
+    uint64_t ip = static_cast<uint64_t>(val);
+    uint64_t fp = static_cast<uint64_t>((val - ip) * 1e6 + 0.5);
+
+    if (fp >= 1000000) {
+        ++ip;
+        fp = 0;
+    }
+
+    append_uint(buf, ip);
+    buf.push_back('.');
+
+    char tmp[6];
+
+    for (int i = 5; i >= 0; --i) {
+        tmp[i] = '0' + static_cast<char>(fp % 10);
+        fp /= 10;
+    }
+
+    buf.append(tmp, 6);
+}
+
+void append_value(std::string& buf, const cali::Variant& v)
+{
+    switch (v.type()) {
+    case CALI_TYPE_INT:
+        {
+            int64_t i = v.to_int();
+
+            if (i < 0) {
+                buf.push_back('-');
+                append_uint(buf, static_cast<uint64_t>(-(i+1)) + 1);
+            } else
+                append_uint(buf, static_cast<uint64_t>(i));
+        }
+        break;
+    case CALI_TYPE_UINT:
+        append_uint(buf, v.to_uint());
+        break;
+    case CALI_TYPE_DOUBLE:
+        append_double(buf, v.to_double());
+        break;
+    case CALI_TYPE_ADDR:
+        append_hex(buf, v.to_uint());
+        break;
+    case CALI_TYPE_BOOL:
+        buf.append(v.to_bool() ? "true" : "false");
+        break;
+    case CALI_TYPE_STRING:
+        {
+            const char* str = static_cast<const char*>(v.data());
+            std::size_t len = v.size();
+
+            if (len && str[len-1] == 0)
+                --len;
+
+            buf.append(str, len);
+        }
+        break;
+    default:
+        buf.append(v.to_string());
+    }
+}
+
+} // namespace [anonymous]
+
 
 struct cali::SnapshotTextFormatter::SnapshotTextFormatterImpl
 {
@@ -28,11 +151,20 @@ struct cali::SnapshotTextFormatter::SnapshotTextFormatterImpl
         char        align; // 'l', 'r', 'c' 
     };
 
-    std::vector<Field> m_fields;    
+    std::vector<Field> m_fields;
     std::mutex         m_field_mutex;
 
-    void 
+    // Set once all attribute names are resolved: m_fields is read-only
+    // from then on and printing skips the lock and field list copy.
+    std::atomic<bool>  m_compiled { false };
+
+    void
     parse(const std::string& formatstring) {
+        std::lock_guard<std::mutex>
+            g(m_field_mutex);
+
+        m_compiled.store(false, std::memory_order_relaxed);
+
         m_fields.clear();
 
         // parse format: "(prefix string) %[<width+alignment(l|r|c)>]attr_name% ... "
@@ -90,8 +222,77 @@ struct cali::SnapshotTextFormatter::SnapshotTextFormatterImpl
         }
     }
 
-    std::ostream& 
+    static void
+    format_field(std::string& buf, const Field& f, const std::vector<Entry>& list) {
+        buf.append(f.prefix);
+
+        std::size_t vpos = buf.size();
+
+        if (f.attr != Attribute::invalid) {
+            Entry e;
+
+            for (auto it = list.begin(); it != list.end(); ++it)
+                if ((*it).count(f.attr)) {
+                    e = *it;
+                    break;
+                }
+
+            if (e.node()) {
+                // gather matching nodes, then append root-to-leaf
+
+                const int   MAX_PATH = 128;
+                const Node* path[MAX_PATH];
+                int         n = 0;
+
+                for (const Node* node = e.node(); node && n < MAX_PATH; node = node->parent())
+                    if (node->attribute() == f.attr.id())
+                        path[n++] = node;
+
+                while (n-- > 0) {
+                    append_value(buf, path[n]->data());
+
+                    if (n > 0)
+                        buf.push_back('/');
+                }
+            } else if (e.is_immediate()) {
+                append_value(buf, e.value());
+            }
+        }
+
+        int len = static_cast<int>(buf.size() - vpos);
+        int w   = len < f.width ? std::min<int>(f.width - len, 80) : 0;
+
+        if (w > 0)
+            buf.append(w, ' ');
+    }
+
+    static std::ostream&
+    print_field(std::ostream& os, const Field& f, const std::vector<Entry>& list) {
+        std::string buf;
+        format_field(buf, f, list);
+
+        os.write(buf.data(), buf.size());
+
+        return os;
+    }
+
+    std::ostream&
     print(std::ostream& os, const CaliperMetadataAccessInterface* db, const std::vector<Entry>& list) {
+        // fast path: all attributes resolved, field list is read-only.
+        // The record is assembled in a buffer and written in one call.
+
+        if (m_compiled.load(std::memory_order_acquire)) {
+            std::string buf;
+            buf.reserve(128);
+
+            for (const Field& f : m_fields)
+                format_field(buf, f, list);
+
+            os.write(buf.data(), buf.size());
+
+            return os;
+        }
+
         std::vector<Field> fields;
 
         {
@@ -110,34 +311,7 @@ struct cali::SnapshotTextFormatter::SnapshotTextFormatterImpl
                 update = true;
             }
 
-            std::string str;
-
-            if (f.attr != Attribute::invalid) {
-                Entry e;
-
-                for (auto it = list.begin(); it != list.end(); ++it)
-                    if ((*it).count(f.attr)) {
-                        e = *it;
-                        break;
-                    }
-
-                if (e.node()) {
-                    for (const Node* node = e.node(); node; node = node->parent())
-                        if (node->attribute() == f.attr.id())
-                            str = node->data().to_string().append(str.size() ? "/" : "").append(str);
-                } else if (e.is_immediate()) {
-                    str.append(e.value().to_string());
-                }
-            }
-
-            static const char whitespace[80+1] = 
-                "                                        "
-                "                                        ";
-
-            int len = str.size();
-            int w   = len < f.width ? std::min<int>(f.width - len, 80) : 0;
-
-            os << f.prefix << str << (w > 0 ? whitespace+(80-w) : "");
+            print_field(os, f, list);
         }
 
         if (update) {
@@ -145,6 +319,10 @@ struct cali::SnapshotTextFormatter::SnapshotTextFormatterImpl
                 g(m_field_mutex);
 
             m_fields.swap(fields);
+
+            if (std::none_of(m_fields.begin(), m_fields.end(),
+                             [](const Field& f){ return !f.attr_name.empty(); }))
+                m_compiled.store(true, std::memory_order_release);
         }
 
         return os;
@@ -35,8 +35,164 @@
 
 #include "caliper/common/StringConverter.h"
 
-#include <algorithm>
 #include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+
+// from_chars-style numeric parsers: single pass over the character
+// range, no exceptions, no locale machinery. Like the strtoX family,
+// they skip leading whitespace and ignore trailing characters;
+// a conversion succeeds if at least one digit was consumed.
+
+inline const char* skip_ws(const char* p, const char* end)
+{
+    while (p != end && (*p == ' ' || *p == '\t' || *p == '\n'))
+        ++p;
+
+    return p;
+}
+
+inline int digit_value(char c, int base)
+{
+    int v = -1;
+
+    if (c >= '0' && c <= '9')
+        v = c - '0';
+    else if (c >= 'a' && c <= 'z')
+        v = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'Z')
+        v = c - 'A' + 10;
+
+    return v < base ? v : -1;
+}
+
+const char* parse_uint(const char* p, const char* end, int base, uint64_t* res, bool* okptr)
+{
+    p = skip_ws(p, end);
+
+    if (p != end && *p == '+')
+        ++p;
+
+    if (base == 16 && end - p > 1 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+        p += 2;
+
+    uint64_t val = 0;
+    bool     ok  = false;
+
+    for (int d; p != end && (d = digit_value(*p, base)) >= 0; ++p) {
+        val = val * base + d;
+        ok  = true;
+    }
+
+    *res   = val;
+    *okptr = ok;
+
+    return p;
+}
+
+const char* parse_int(const char* p, const char* end, int64_t* res, bool* okptr)
+{
+    p = skip_ws(p, end);
+
+    bool negative = (p != end && *p == '-');
+
+    if (negative)
+        ++p;
+
+    uint64_t uval = 0;
+
+    p = parse_uint(p, end, 10, &uval, okptr);
+
+    *res = negative ? -static_cast<int64_t>(uval) : static_cast<int64_t>(uval);
+
+    return p;
+}
+
+void parse_double(const char* p, const char* end, double* res, bool* okptr)
+{
+    const char* begin = p;
+
+    p = skip_ws(p, end);
+
+    bool negative = (p != end && (*p == '-' || *p == '+') && *p++ == '-');
+
+    // mantissa digits, tracking the decimal point
+
+    uint64_t mant     = 0;
+    int      exponent = 0;
+    int      digits   = 0;
+    bool     ok       = false;
+
+    for ( ; p != end && *p >= '0' && *p <= '9'; ++p) {
+        if (digits < 19) {
+            mant = mant * 10 + (*p - '0');
+            ++digits;
+        } else
+            ++exponent;
+
+        ok = true;
+    }
+
+    if (p != end && *p == '.')
+        for (++p; p != end && *p >= '0' && *p <= '9'; ++p) {
+            if (digits < 19) {
+                mant = mant * 10 + (*p - '0');
+                ++digits;
+                --exponent;
+            }
+
+            ok = true;
+        }
+
+    if (!ok) {
+        *res   = 0.0;
+        *okptr = false;
+        return;
+    }
+
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        int64_t e    = 0;
+        bool    e_ok = false;
+
+        parse_int(p+1, end, &e, &e_ok);
+
+        if (!e_ok) {
+            *res   = 0.0;
+            *okptr = false;
+            return;
+        }
+
+        exponent += static_cast<int>(e);
+    }
+
+    double val;
+
+    if (exponent >= -22 && exponent <= 22 && digits <= 15) {
+        // value is exactly representable as mantissa and power of ten
+        static const double pow10[23] = {
+            1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+            1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+            1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        val = static_cast<double>(mant);
+        val = exponent < 0 ? val / pow10[-exponent] : val * pow10[exponent];
+
+        if (negative)
+            val = -val;
+    } else {
+        // fall back to strtod for values needing full precision handling
+        val = strtod(std::string(begin, end - begin).c_str(), nullptr);
+    }
+
+    *res   = val;
+    *okptr = true;
+}
+
+} // namespace [anonymous]
 
 cali_id_t
 cali::StringConverter::to_id() const
@@ -52,35 +208,37 @@ cali::StringConverter::to_bool(bool* okptr) const
 {
     bool ok  = false;
     bool res = false;
-    
+
     // try string
-    
-    {
-        std::string lower;
-
-        std::transform(m_str.begin(), m_str.end(), std::back_inserter(lower),
-                       ::tolower);
-
-        if (lower == "true" || lower == "t") {
-            ok  = true;
-            res = true;
-        } else if (lower == "false" || lower == "f") {
-            ok  = true;
-            res = false;
-        }
+
+    const char* p   = m_str.data();
+    const char* end = p + m_str.size();
+
+    size_t len = m_str.size();
+
+    if ((len == 1 && ::tolower(m_str[0]) == 't') ||
+        (len == 4 &&
+         ::tolower(m_str[0]) == 't' && ::tolower(m_str[1]) == 'r' &&
+         ::tolower(m_str[2]) == 'u' && ::tolower(m_str[3]) == 'e')) {
+        ok  = true;
+        res = true;
+    } else if ((len == 1 && ::tolower(m_str[0]) == 'f') ||
+               (len == 5 &&
+                ::tolower(m_str[0]) == 'f' && ::tolower(m_str[1]) == 'a' &&
+                ::tolower(m_str[2]) == 'l' && ::tolower(m_str[3]) == 's' &&
+                ::tolower(m_str[4]) == 'e')) {
+        ok  = true;
+        res = false;
     }
 
     // try numeral
-    
+
     if (!ok) {
-        try {
-            unsigned long i = std::stoul(m_str);
-            
-            res = (i != 0);
-            ok  = true;
-        } catch (...) {
-            ok  = false;
-        }
+        uint64_t val = 0;
+
+        parse_uint(p, end, 10, &val, &ok);
+
+        res = (val != 0);
     }
 
     if (okptr)
@@ -92,39 +250,29 @@ cali::StringConverter::to_bool(bool* okptr) const
 int
 cali::StringConverter::to_int(bool* okptr) const
 {
-    bool ok  = false;
-    int  res = 0;
+    bool    ok  = false;
+    int64_t res = 0;
 
-    try {
-        res = std::stoi(m_str);
-        ok  = true;
-    } catch (...) {
-        ok  = false;
-    }
+    parse_int(m_str.data(), m_str.data() + m_str.size(), &res, &ok);
 
     if (okptr)
         *okptr = ok;
 
-    return res;
+    return static_cast<int>(res);
 }
 
 uint64_t
 cali::StringConverter::to_uint(bool* okptr, int base) const
 {
-    bool ok = false;
+    bool     ok  = false;
     uint64_t res = 0;
 
-    try {
-        res = std::stoull(m_str, nullptr, base);
-        ok  = true;
-    } catch (...) {
-        ok  = false;
-    }
+    parse_uint(m_str.data(), m_str.data() + m_str.size(), base, &res, &ok);
 
     if (okptr)
         *okptr = ok;
 
-    return res;    
+    return res;
 }
 
 double
@@ -133,12 +281,7 @@ cali::StringConverter::to_double(bool* okptr) const
     bool   ok  = false;
     double res = 0;
 
-    try {
-        res = std::stod(m_str);
-        ok  = true;
-    } catch (...) {
-        ok  = false;
-    }
+    parse_double(m_str.data(), m_str.data() + m_str.size(), &res, &ok);
 
     if (okptr)
         *okptr = ok;
@@ -0,0 +1,417 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file BinaryReader.cpp
+/// BinaryReader implementation
+
+#include "caliper/common/binary/BinaryReader.h"
+
+#include "caliper/common/binary/BinarySpec.h"
+
+#include "caliper/common/Variant.h"
+
+#include "caliper/common/c-util/vlenc.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <vector>
+
+using namespace cali;
+using namespace std;
+
+namespace
+{
+
+// Decode an immediate value at an arbitrary offset in a packed block.
+// Values are packed back-to-back without padding, so buf does not
+// necessarily satisfy the value type's alignment: copy scalars into a
+// properly typed local instead of handing the raw block pointer to the
+// variant constructor, which dereferences it as the value type.
+Variant unpack_value(uint64_t type, const unsigned char* buf, size_t size)
+{
+    if (type > CALI_MAXTYPE)
+        return Variant(CALI_TYPE_INV, buf, size);
+
+    cali_attr_type t = static_cast<cali_attr_type>(type);
+
+    switch (t) {
+    case CALI_TYPE_INT:
+        {
+            int val = 0;
+            memcpy(&val, buf, std::min(size, sizeof(val)));
+            return Variant(t, &val, sizeof(val));
+        }
+    case CALI_TYPE_UINT:
+    case CALI_TYPE_ADDR:
+        {
+            uint64_t val = 0;
+            memcpy(&val, buf, std::min(size, sizeof(val)));
+            return Variant(t, &val, sizeof(val));
+        }
+    case CALI_TYPE_DOUBLE:
+        {
+            double val = 0.0;
+            memcpy(&val, buf, std::min(size, sizeof(val)));
+            return Variant(t, &val, sizeof(val));
+        }
+    case CALI_TYPE_BOOL:
+        {
+            bool val = false;
+            memcpy(&val, buf, std::min(size, sizeof(val)));
+            return Variant(t, &val, sizeof(val));
+        }
+    case CALI_TYPE_TYPE:
+        {
+            cali_attr_type val = CALI_TYPE_INV;
+            memcpy(&val, buf, std::min(size, sizeof(val)));
+            return Variant(t, &val, sizeof(val));
+        }
+    default:
+        // strings and USR data are copied or referenced byte-wise
+        return Variant(t, buf, size);
+    }
+}
+
+} // namespace
+
+
+struct BinaryReader::BinaryReaderImpl
+{
+    string   m_filename;
+    istream* m_stream;
+
+    BinaryReaderImpl(const string& filename)
+        : m_filename { filename }, m_stream { nullptr }
+        { }
+
+    BinaryReaderImpl(istream& is)
+        : m_stream { &is }
+        { }
+
+    void unpack_node_block(const unsigned char* buf, size_t len, size_t count,
+                           function<void(const RecordMap&)> rec_handler) {
+        size_t pos = 0;
+
+        for (size_t r = 0; r < count && pos < len; ++r) {
+            // see NodeBuffer: first entry is 2*id + (1 if parent id follows)
+            uint64_t  u           = vldec_u64(buf+pos, &pos);
+            bool      have_parent = ((u % 2) == 1);
+
+            cali_id_t node_id     = u / 2;
+            cali_id_t attr_id     = vldec_u64(buf+pos, &pos);
+            cali_id_t parent_id   = have_parent ? vldec_u64(buf+pos, &pos) : CALI_INV_ID;
+
+            uint64_t  type        = vldec_u64(buf+pos, &pos);
+            size_t    size        = vldec_u64(buf+pos, &pos);
+
+            Variant   data = unpack_value(type, buf+pos, size);
+
+            pos += size;
+
+            RecordMap rec;
+
+            rec["__rec"].push_back("node");
+            rec["id"   ].push_back(std::to_string(node_id));
+            rec["attr" ].push_back(std::to_string(attr_id));
+            rec["data" ].push_back(data.to_string());
+
+            if (have_parent)
+                rec["parent"].push_back(std::to_string(parent_id));
+
+            rec_handler(rec);
+        }
+    }
+
+    // Unpack snapshot records starting at *posp. If dict is given,
+    // node references are local ids resolved through it (dictionary
+    // snapshot blocks); otherwise they are global node ids.
+    void unpack_snapshot_records(const unsigned char* buf, size_t len, size_t count,
+                                 size_t* posp, const vector<cali_id_t>* dict,
+                                 function<void(const RecordMap&)> rec_handler) {
+        size_t pos = *posp;
+
+        for (size_t r = 0; r < count && pos < len; ++r) {
+            RecordMap rec;
+
+            rec["__rec"].push_back("ctx");
+
+            uint64_t n_nodes = vldec_u64(buf+pos, &pos);
+
+            for (uint64_t i = 0; i < n_nodes; ++i) {
+                uint64_t id = vldec_u64(buf+pos, &pos);
+
+                if (dict) {
+                    if (id >= dict->size())
+                        return; // invalid dictionary reference
+
+                    id = (*dict)[id];
+                }
+
+                rec["ref"].push_back(std::to_string(id));
+            }
+
+            uint64_t n_imm   = vldec_u64(buf+pos, &pos);
+
+            for (uint64_t i = 0; i < n_imm; ++i) {
+                cali_id_t attr_id = vldec_u64(buf+pos, &pos);
+                uint64_t  type    = vldec_u64(buf+pos, &pos);
+                size_t    size    = vldec_u64(buf+pos, &pos);
+
+                Variant   data = unpack_value(type, buf+pos, size);
+
+                pos += size;
+
+                rec["attr"].push_back(std::to_string(attr_id));
+                rec["data"].push_back(data.to_string());
+            }
+
+            rec_handler(rec);
+        }
+
+        *posp = pos;
+    }
+
+    void unpack_snapshot_block(const unsigned char* buf, size_t len, size_t count,
+                               function<void(const RecordMap&)> rec_handler) {
+        size_t pos = 0;
+
+        unpack_snapshot_records(buf, len, count, &pos, nullptr, rec_handler);
+    }
+
+    // Decode a dictionary snapshot block: the payload starts with a
+    // table mapping the records' dense local node ids to global ids
+    void unpack_snapshotd_block(const unsigned char* buf, size_t len, size_t count,
+                                function<void(const RecordMap&)> rec_handler) {
+        size_t pos = 0;
+
+        uint64_t dict_size = vldec_u64(buf+pos, &pos);
+
+        vector<cali_id_t> dict;
+        dict.reserve(dict_size);
+
+        for (uint64_t i = 0; i < dict_size && pos < len; ++i)
+            dict.push_back(vldec_u64(buf+pos, &pos));
+
+        unpack_snapshot_records(buf, len, count, &pos, &dict, rec_handler);
+    }
+
+    // Decode a zero-copy trace block: shape definition records (tag 0)
+    // followed by snapshot records referencing them; see BinarySpec.h
+    void unpack_trace_block(const unsigned char* buf, size_t len, size_t count,
+                            function<void(const RecordMap&)> rec_handler) {
+        struct Shape {
+            vector<cali_id_t> nodes;
+            vector<cali_id_t> attrs;
+            vector<char>      delta;
+        };
+
+        vector<Shape> shapes;
+
+        // previous value per delta-encoded attribute in this block
+        map<cali_id_t, uint64_t> prev_val;
+
+        size_t pos = 0;
+
+        for (size_t r = 0; r < count && pos < len; ++r) {
+            uint64_t tag = vldec_u64(buf+pos, &pos);
+
+            if (tag == 0) {
+                Shape sh;
+
+                uint64_t n_nodes = vldec_u64(buf+pos, &pos);
+                uint64_t n_imm   = vldec_u64(buf+pos, &pos);
+
+                for (uint64_t i = 0; i < n_nodes; ++i)
+                    sh.nodes.push_back(vldec_u64(buf+pos, &pos));
+                for (uint64_t i = 0; i < n_imm;  ++i) {
+                    // attribute id entry is 2*id + (1 if delta-encoded)
+                    uint64_t u = vldec_u64(buf+pos, &pos);
+
+                    sh.attrs.push_back(u / 2);
+                    sh.delta.push_back(static_cast<char>(u % 2));
+                }
+
+                shapes.push_back(std::move(sh));
+
+                continue;
+            }
+
+            if (tag > shapes.size())
+                return; // invalid shape reference
+
+            const Shape& sh = shapes[tag-1];
+
+            RecordMap rec;
+
+            rec["__rec"].push_back("ctx");
+
+            for (cali_id_t id : sh.nodes)
+                rec["ref"].push_back(std::to_string(id));
+
+            for (size_t i = 0; i < sh.attrs.size(); ++i) {
+                Variant data;
+
+                if (sh.delta[i]) {
+                    uint64_t val = prev_val[sh.attrs[i]] + vldec_u64(buf+pos, &pos);
+
+                    prev_val[sh.attrs[i]] = val;
+                    data = Variant(val);
+                } else
+                    data = Variant::unpack(buf+pos, &pos, nullptr);
+
+                rec["attr"].push_back(std::to_string(sh.attrs[i]));
+                rec["data"].push_back(data.to_string());
+            }
+
+            rec_handler(rec);
+        }
+    }
+
+    bool read(function<void(const RecordMap&)> rec_handler) {
+        ifstream file;
+
+        if (!m_stream) {
+            file.open(m_filename.c_str(), ios::binary);
+
+            if (!file)
+                return false;
+        }
+
+        istream& is = m_stream ? *m_stream : file;
+
+        char magic[sizeof(binary::spec_magic)];
+
+        if (!is.read(magic, sizeof(magic))
+            || 0 != memcmp(magic, binary::spec_magic, sizeof(magic)))
+            return false;
+
+        vector<unsigned char> payload;
+
+        while (is) {
+            int type = is.get();
+
+            if (type == ifstream::traits_type::eof())
+                break;
+
+            // read the varint payload length and record count byte-wise
+
+            unsigned char hdr[20];
+            size_t        hpos = 0;
+
+            for (int f = 0; f < 2; ++f)
+                do {
+                    int c = is.get();
+
+                    if (c == ifstream::traits_type::eof())
+                        return false;
+
+                    hdr[hpos] = static_cast<unsigned char>(c);
+                } while (hdr[hpos++] & 0x80);
+
+            size_t   pos   = 0;
+            uint64_t len   = vldec_u64(hdr, &pos);
+            uint64_t count = vldec_u64(hdr+pos, &pos);
+
+            payload.resize(len);
+
+            if (!is.read(reinterpret_cast<char*>(payload.data()), len))
+                return false;
+
+            if (type == binary::spec_node_block)
+                unpack_node_block(payload.data(), len, count, rec_handler);
+            else if (type == binary::spec_snapshot_block)
+                unpack_snapshot_block(payload.data(), len, count, rec_handler);
+            else if (type == binary::spec_snapshotd_block)
+                unpack_snapshotd_block(payload.data(), len, count, rec_handler);
+            else if (type == binary::spec_trace_block)
+                unpack_trace_block(payload.data(), len, count, rec_handler);
+
+            // skip unknown block types
+        }
+
+        return true;
+    }
+};
+
+
+BinaryReader::BinaryReader(const std::string& filename)
+    : mP(new BinaryReaderImpl(filename))
+{ }
+
+BinaryReader::BinaryReader(std::istream& is)
+    : mP(new BinaryReaderImpl(is))
+{ }
+
+BinaryReader::~BinaryReader()
+{
+    mP.reset();
+}
+
+bool BinaryReader::is_binary_file(const std::string& filename)
+{
+    ifstream is(filename.c_str(), ios::binary);
+
+    char magic[sizeof(binary::spec_magic)];
+
+    return is.read(magic, sizeof(magic))
+        && 0 == memcmp(magic, binary::spec_magic, sizeof(magic));
+}
+
+bool BinaryReader::is_binary_stream(std::istream& is)
+{
+    char   magic[sizeof(binary::spec_magic)];
+    size_t read = 0;
+
+    while (read < sizeof(magic)) {
+        int c = is.get();
+
+        if (c == istream::traits_type::eof())
+            break;
+
+        magic[read++] = static_cast<char>(c);
+    }
+
+    for (size_t i = read; i > 0; --i)
+        is.putback(magic[i-1]);
+
+    is.clear();
+
+    return read == sizeof(magic)
+        && 0 == memcmp(magic, binary::spec_magic, sizeof(magic));
+}
+
+bool BinaryReader::read(std::function<void(const RecordMap&)> rec_handler)
+{
+    return mP->read(rec_handler);
+}
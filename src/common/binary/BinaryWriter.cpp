@@ -0,0 +1,372 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file BinaryWriter.cpp
+/// BinaryWriter implementation
+
+#include "caliper/common/binary/BinaryWriter.h"
+
+#include "caliper/common/binary/BinarySpec.h"
+
+#include "caliper/common/CaliperMetadataAccessInterface.h"
+#include "caliper/common/Node.h"
+#include "caliper/common/NodeBuffer.h"
+
+#include "caliper/common/c-util/vlenc.h"
+
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+using namespace cali;
+
+
+struct BinaryWriter::BinaryWriterImpl
+{
+    std::ostream& m_os;
+    std::mutex    m_os_lock;
+
+    std::set<cali_id_t> m_written_nodes;
+    std::mutex    m_written_nodes_lock;
+
+    // --- block buffers
+
+    NodeBuffer    m_nodebuf;
+
+    std::vector<unsigned char> m_snapbuf;
+    size_t        m_snapbuf_count;
+
+    // The current snapshot block's node id dictionary: snapshot
+    // records reference nodes by dense local ids, which are indices
+    // into m_dict_ids. The table is written at the head of the block
+    // and reset for the next one.
+    std::unordered_map<cali_id_t, uint64_t> m_dict;
+    std::vector<cali_id_t>     m_dict_ids;
+
+    std::size_t   m_num_written;
+
+    // block alignment for direct I/O (0: off)
+    std::size_t   m_align;
+    std::size_t   m_pos;
+
+    BinaryWriterImpl(std::ostream& os)
+        : m_os(os),
+          m_snapbuf_count(0),
+          m_num_written(0),
+          m_align(0),
+          m_pos(sizeof(binary::spec_magic))
+    {
+        m_os.write(binary::spec_magic, sizeof(binary::spec_magic));
+    }
+
+    // Write a pad block filling the gap bytes up to the next
+    // alignment boundary
+    void write_pad_block(size_t gap) {
+        if (gap == 0)
+            return;
+
+        // the minimum pad block is three bytes, and a 131-byte gap
+        // falls between the one- and two-byte varint payload length
+        // encodings: grow these to the next boundary
+        if (gap < 3 || gap == 131)
+            gap += m_align;
+
+        // header is [type][payload len][count 0]: subtract one byte
+        // more when the payload length needs a two-byte varint
+        size_t len = gap - (gap - 3 < 128 ? 3 : 4);
+
+        unsigned char hdr[21];
+        size_t        pos = 0;
+
+        hdr[pos++] = binary::spec_pad_block;
+        pos += vlenc_u64(len, hdr+pos);
+        pos += vlenc_u64(0,   hdr+pos);
+
+        std::vector<char> zeros(len, 0);
+
+        m_os.write(reinterpret_cast<const char*>(hdr), pos);
+        m_os.write(zeros.data(), len);
+
+        m_pos += gap;
+    }
+
+    // Write a [type][payload len][count][payload] block with the
+    // payload given in two parts (e.g. dictionary table + records)
+    void write_block(unsigned char type, size_t count,
+                     const unsigned char* head, size_t headlen,
+                     const unsigned char* data, size_t len) {
+        if (m_align)
+            write_pad_block((m_align - m_pos % m_align) % m_align);
+
+        unsigned char hdr[21];
+        size_t        pos = 0;
+
+        hdr[pos++] = type;
+        pos += vlenc_u64(headlen+len, hdr+pos);
+        pos += vlenc_u64(count, hdr+pos);
+
+        m_os.write(reinterpret_cast<const char*>(hdr),  pos);
+
+        if (headlen > 0)
+            m_os.write(reinterpret_cast<const char*>(head), headlen);
+
+        m_os.write(reinterpret_cast<const char*>(data), len);
+
+        m_pos += pos + headlen + len;
+    }
+
+    void write_block(unsigned char type, size_t count, const unsigned char* data, size_t len) {
+        write_block(type, count, nullptr, 0, data, len);
+    }
+
+    void flush_blocks() {
+        std::lock_guard<std::mutex>
+            g(m_os_lock);
+
+        flush_blocks_unlocked();
+    }
+
+    void flush_blocks_unlocked() {
+        if (m_nodebuf.count() > 0) {
+            write_block(binary::spec_node_block, m_nodebuf.count(),
+                        m_nodebuf.data(), m_nodebuf.size());
+
+            m_num_written += m_nodebuf.count();
+            m_nodebuf.import(0, 0);
+        }
+
+        if (m_snapbuf_count > 0) {
+            unsigned char tmp[10];
+            std::vector<unsigned char> dictbuf;
+
+            dictbuf.insert(dictbuf.end(), tmp, tmp + vlenc_u64(m_dict_ids.size(), tmp));
+
+            for (cali_id_t id : m_dict_ids)
+                dictbuf.insert(dictbuf.end(), tmp, tmp + vlenc_u64(id, tmp));
+
+            write_block(binary::spec_snapshotd_block, m_snapbuf_count,
+                        dictbuf.data(), dictbuf.size(),
+                        m_snapbuf.data(), m_snapbuf.size());
+
+            m_num_written  += m_snapbuf_count;
+            m_snapbuf_count = 0;
+            m_snapbuf.clear();
+
+            m_dict.clear();
+            m_dict_ids.clear();
+        }
+    }
+
+    // Return (and assign, if needed) the node's local id in the
+    // current snapshot block's dictionary
+    uint64_t local_id(cali_id_t node_id) {
+        auto it = m_dict.find(node_id);
+
+        if (it != m_dict.end())
+            return it->second;
+
+        uint64_t id = m_dict_ids.size();
+
+        m_dict.emplace(node_id, id);
+        m_dict_ids.push_back(node_id);
+
+        return id;
+    }
+
+    void recursive_save_node(const CaliperMetadataAccessInterface& db, cali_id_t id)
+    {
+        if (id < 11) // don't write the hard-coded metadata nodes
+            return;
+
+        {
+            std::lock_guard<std::mutex>
+                g(m_written_nodes_lock);
+
+            if (m_written_nodes.count(id) > 0)
+                return;
+
+            m_written_nodes.insert(id);
+        }
+
+        Node* node = db.node(id);
+
+        if (!node)
+            return;
+
+        recursive_save_node(db, node->attribute());
+
+        Node* parent = node->parent();
+
+        if (parent && parent->id() != CALI_INV_ID)
+            recursive_save_node(db, parent->id());
+
+        m_nodebuf.append(node);
+    }
+
+    void save_snapshot(const CaliperMetadataAccessInterface& db,
+                       size_t n_nodes, const cali_id_t nodes[],
+                       size_t n_imm,   const cali_id_t attr[], const Variant vals[])
+    {
+        std::lock_guard<std::mutex>
+            g(m_os_lock);
+
+        for (size_t i = 0; i < n_nodes; ++i)
+            recursive_save_node(db, nodes[i]);
+        for (size_t i = 0; i < n_imm;   ++i)
+            recursive_save_node(db, attr[i]);
+
+        unsigned char tmp[10];
+
+        m_snapbuf.insert(m_snapbuf.end(), tmp, tmp + vlenc_u64(n_nodes, tmp));
+
+        for (size_t i = 0; i < n_nodes; ++i)
+            m_snapbuf.insert(m_snapbuf.end(), tmp, tmp + vlenc_u64(local_id(nodes[i]), tmp));
+
+        m_snapbuf.insert(m_snapbuf.end(), tmp, tmp + vlenc_u64(n_imm, tmp));
+
+        for (size_t i = 0; i < n_imm; ++i) {
+            m_snapbuf.insert(m_snapbuf.end(), tmp, tmp + vlenc_u64(attr[i], tmp));
+            m_snapbuf.insert(m_snapbuf.end(), tmp,
+                             tmp + vlenc_u64(static_cast<uint64_t>(vals[i].type()), tmp));
+            m_snapbuf.insert(m_snapbuf.end(), tmp, tmp + vlenc_u64(vals[i].size(), tmp));
+
+            const unsigned char* p = static_cast<const unsigned char*>(vals[i].data());
+
+            m_snapbuf.insert(m_snapbuf.end(), p, p + vals[i].size());
+        }
+
+        ++m_snapbuf_count;
+
+        if (m_nodebuf.size() + m_snapbuf.size() >= binary::spec_blocksize)
+            flush_blocks_unlocked();
+    }
+
+    void write_trace_block(const CaliperMetadataAccessInterface& db,
+                           size_t n_rec, const unsigned char* data, size_t len)
+    {
+        std::lock_guard<std::mutex>
+            g(m_os_lock);
+
+        // Scan the shape definition records for referenced node and
+        // attribute ids: the metadata they need must precede the
+        // block. Snapshot records are skipped using their shape's
+        // immediate entry layout; the payload itself is not decoded.
+
+        std::vector< std::vector<char> > shape_delta;
+
+        size_t pos = 0;
+
+        for (size_t r = 0; r < n_rec && pos < len; ++r) {
+            uint64_t tag = vldec_u64(data+pos, &pos);
+
+            if (tag == 0) {
+                uint64_t n_nodes = vldec_u64(data+pos, &pos);
+                uint64_t n_imm   = vldec_u64(data+pos, &pos);
+
+                std::vector<char> delta(n_imm, 0);
+
+                for (uint64_t i = 0; i < n_nodes; ++i)
+                    recursive_save_node(db, vldec_u64(data+pos, &pos));
+                for (uint64_t i = 0; i < n_imm;  ++i) {
+                    // attribute id entry is 2*id + (1 if delta-encoded)
+                    uint64_t u = vldec_u64(data+pos, &pos);
+
+                    recursive_save_node(db, u / 2);
+                    delta[i] = static_cast<char>(u % 2);
+                }
+
+                shape_delta.push_back(std::move(delta));
+            } else if (tag <= shape_delta.size()) {
+                const std::vector<char>& delta = shape_delta[tag-1];
+
+                for (size_t i = 0; i < delta.size(); ++i)
+                    if (delta[i])
+                        vldec_u64(data+pos, &pos);
+                    else
+                        Variant::unpack(data+pos, &pos, nullptr);
+            } else
+                break; // invalid shape reference: write the block as-is
+        }
+
+        // write pending node metadata ahead of the trace block
+
+        flush_blocks_unlocked();
+
+        write_block(binary::spec_trace_block, n_rec, data, len);
+
+        m_num_written += n_rec;
+    }
+};
+
+
+BinaryWriter::BinaryWriter(std::ostream& os)
+    : mP(new BinaryWriterImpl(os))
+{ }
+
+BinaryWriter::~BinaryWriter()
+{
+    if (mP) {
+        mP->flush_blocks();
+        mP.reset();
+    }
+}
+
+size_t BinaryWriter::num_written() const
+{
+    return mP ? mP->m_num_written : 0;
+}
+
+void BinaryWriter::set_block_alignment(size_t align)
+{
+    if (mP)
+        mP->m_align = align;
+}
+
+void BinaryWriter::write_snapshot(const CaliperMetadataAccessInterface& db,
+                                  size_t n_nodes, const cali_id_t nodes[],
+                                  size_t n_imm,   const cali_id_t attr[], const Variant vals[])
+{
+    mP->save_snapshot(db, n_nodes, nodes, n_imm, attr, vals);
+}
+
+void BinaryWriter::write_trace_block(const CaliperMetadataAccessInterface& db,
+                                     size_t n_rec, const unsigned char* data, size_t len)
+{
+    mP->write_trace_block(db, n_rec, data, len);
+}
+
+void BinaryWriter::flush()
+{
+    if (mP)
+        mP->flush_blocks();
+}
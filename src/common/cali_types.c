@@ -51,6 +51,7 @@ static const struct propmap_t {
   { "skip_events",   CALI_ATTR_SKIP_EVENTS,   CALI_ATTR_SKIP_EVENTS },
   { "hidden",        CALI_ATTR_HIDDEN,        CALI_ATTR_HIDDEN      },
   { "nested",        CALI_ATTR_NESTED,        CALI_ATTR_NESTED      },
+  { "monotonic",     CALI_ATTR_MONOTONIC,     CALI_ATTR_MONOTONIC   },
   { 0, CALI_ATTR_DEFAULT, CALI_ATTR_DEFAULT }
 };
 
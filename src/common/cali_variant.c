@@ -45,6 +45,13 @@
 #define _EXTRACT_TYPE(type_and_size) ((type_and_size) & CALI_VARIANT_TYPE_MASK)
 #define _EXTRACT_SIZE(type_and_size) ((type_and_size) >> 8)
 
+/* Variable-length values up to CALI_VARIANT_INLINE_MAX bytes are stored
+ * in the variant's inline buffer: the representation is self-describing,
+ * a string or blob is inline iff its size fits.
+ */
+#define _IS_INLINE(type, size) \
+    (((type) == CALI_TYPE_USR || (type) == CALI_TYPE_STRING) && (size) <= CALI_VARIANT_INLINE_MAX)
+
 extern inline bool
 cali_variant_is_empty(cali_variant_t v);
 
@@ -97,7 +104,8 @@ cali_variant_get_data(const cali_variant_t* v)
         return 0;
     case CALI_TYPE_USR:
     case CALI_TYPE_STRING:
-        return v->value.unmanaged_ptr;
+        return _EXTRACT_SIZE(v->type_and_size) <= CALI_VARIANT_INLINE_MAX ?
+            (const void*) v->value.v_inline : v->value.unmanaged_ptr;
     case CALI_TYPE_INT:
         return &v->value.v_int;
     case CALI_TYPE_ADDR:
@@ -128,7 +136,12 @@ cali_make_variant(cali_attr_type type, const void* ptr, size_t size)
     case CALI_TYPE_USR:
     case CALI_TYPE_STRING:
         v.type_and_size  = (size << 8) | (type & CALI_VARIANT_TYPE_MASK);
-        v.value.unmanaged_ptr = ptr;
+
+        if (size <= CALI_VARIANT_INLINE_MAX) {
+            if (size > 0)
+                memcpy(v.value.v_inline, ptr, size);
+        } else
+            v.value.unmanaged_ptr = ptr;
         break;
     case CALI_TYPE_INT:
         v.value.v_int    = *((const int*) ptr);
@@ -418,7 +431,7 @@ cali_variant_compare(cali_variant_t lhs, cali_variant_t rhs)
             {
                 int lhssize = (int) _EXTRACT_SIZE(lhs.type_and_size);
                 int rhssize = (int) _EXTRACT_SIZE(rhs.type_and_size);
-                int cmp     = memcmp(lhs.value.unmanaged_ptr, rhs.value.unmanaged_ptr,
+                int cmp     = memcmp(cali_variant_get_data(&lhs), cali_variant_get_data(&rhs),
                                      imin(lhssize, rhssize));
 
                 return (cmp ? cmp : (lhssize - rhssize));
@@ -426,8 +439,8 @@ cali_variant_compare(cali_variant_t lhs, cali_variant_t rhs)
         case CALI_TYPE_STRING:
             {
                 int lhssize = (int) _EXTRACT_SIZE(lhs.type_and_size);
-                int rhssize = (int) _EXTRACT_SIZE(rhs.type_and_size);                
-                int cmp     = strncmp(lhs.value.unmanaged_ptr, rhs.value.unmanaged_ptr,
+                int rhssize = (int) _EXTRACT_SIZE(rhs.type_and_size);
+                int cmp     = strncmp(cali_variant_get_data(&lhs), cali_variant_get_data(&rhs),
                                       imin(lhssize, rhssize));
 
                 return (cmp ? cmp : (lhssize - rhssize));
@@ -467,10 +480,13 @@ cali_variant_eq(cali_variant_t lhs, cali_variant_t rhs)
     case CALI_TYPE_USR:
     case CALI_TYPE_STRING:
         {
-            if (lhs.value.unmanaged_ptr == rhs.value.unmanaged_ptr)
+            const void* lhsptr = cali_variant_get_data(&lhs);
+            const void* rhsptr = cali_variant_get_data(&rhs);
+
+            if (lhsptr == rhsptr)
                 return true;
             else
-                return 0 == memcmp(lhs.value.unmanaged_ptr, rhs.value.unmanaged_ptr, 
+                return 0 == memcmp(lhsptr, rhsptr,
                                    _EXTRACT_SIZE(lhs.type_and_size));
         }
         break;
@@ -487,7 +503,18 @@ cali_variant_pack(cali_variant_t v, unsigned char* buf)
     size_t pos = 0;
 
     pos += vlenc_u64(v.type_and_size, buf);
-    pos += vlenc_u64(v.value.v_uint,  buf+pos);
+
+    /* inline strings and blobs pack their contents, everything else
+     * packs the value word */
+
+    uint64_t type = _EXTRACT_TYPE(v.type_and_size);
+    uint64_t size = _EXTRACT_SIZE(v.type_and_size);
+
+    if (_IS_INLINE(type, size)) {
+        memcpy(buf+pos, v.value.v_inline, size);
+        pos += size;
+    } else
+        pos += vlenc_u64(v.value.v_uint, buf+pos);
 
     return pos;
 }
@@ -508,8 +535,16 @@ cali_variant_unpack(const unsigned char* buf, size_t* inc, bool *okptr)
     }
 
     v.type_and_size = ts;
-    v.value.v_uint  = vldec_u64(buf+p, &p);
-    
+
+    uint64_t type = _EXTRACT_TYPE(ts);
+    uint64_t size = _EXTRACT_SIZE(ts);
+
+    if (_IS_INLINE(type, size)) {
+        memcpy(v.value.v_inline, buf+p, size);
+        p += size;
+    } else
+        v.value.v_uint = vldec_u64(buf+p, &p);
+
     if (inc)
         *inc  += p;
     if (okptr)
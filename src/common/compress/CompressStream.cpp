@@ -0,0 +1,471 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file CompressStream.cpp
+/// CompressStream and DecompressStream implementation
+
+#include "caliper/common/compress/CompressStream.h"
+
+#include "caliper/common/compress/CompressSpec.h"
+
+#include "caliper/common/Log.h"
+
+#include "caliper/common/c-util/vlenc.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+using namespace cali;
+using namespace std;
+
+namespace
+{
+
+class CompressBuf : public std::streambuf
+{
+    std::ostream& m_os;
+    int           m_level;
+
+    std::vector<char>          m_block;
+    std::vector<unsigned char> m_cbuf;
+
+public:
+
+    CompressBuf(std::ostream& os, int level)
+        : m_os(os), m_level(level), m_block(compress::spec_blocksize)
+        {
+            setp(m_block.data(), m_block.data() + m_block.size());
+
+            m_os.write(compress::spec_magic, sizeof(compress::spec_magic));
+            m_os.put(static_cast<char>(compress::spec_codec_deflate));
+        }
+
+    void flush_block() {
+        size_t len = pptr() - pbase();
+
+        if (len == 0)
+            return;
+
+        uLongf clen = compressBound(len);
+        m_cbuf.resize(clen);
+
+        if (compress2(m_cbuf.data(), &clen,
+                      reinterpret_cast<const Bytef*>(pbase()), len, m_level) != Z_OK) {
+            Log(0).stream() << "CompressStream: error: block compression failed" << endl;
+            setp(m_block.data(), m_block.data() + m_block.size());
+            return;
+        }
+
+        unsigned char hdr[20];
+        size_t        pos = 0;
+
+        pos += vlenc_u64(len,  hdr);
+        pos += vlenc_u64(clen, hdr + pos);
+
+        m_os.write(reinterpret_cast<char*>(hdr), pos);
+        m_os.write(reinterpret_cast<char*>(m_cbuf.data()), clen);
+
+        setp(m_block.data(), m_block.data() + m_block.size());
+    }
+
+protected:
+
+    virtual int_type overflow(int_type ch) {
+        flush_block();
+
+        if (ch != traits_type::eof()) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+
+        return traits_type::not_eof(ch);
+    }
+
+    // Note: sync() does not cut a compression block: frequent writer
+    // flushes (e.g., one per record) would produce tiny blocks with
+    // poor compression ratios. Blocks are cut when the block buffer is
+    // full and on CompressStream::flush().
+    virtual int sync() {
+        m_os.flush();
+
+        return m_os ? 0 : -1;
+    }
+};
+
+// Blocks in the container are compressed independently, so the reader
+// decompresses them in parallel: a reader thread pulls compressed
+// blocks off the input stream into a bounded job queue, worker
+// threads inflate them, and underflow() hands the results to the
+// consumer in stream order. Decompression thus overlaps with parsing
+// and aggregation in the consuming thread and scales with cores.
+// With a single thread, blocks are decompressed inline as before.
+
+class DecompressBuf : public std::streambuf
+{
+    struct Block {
+        uint64_t                   seq;
+        uint64_t                   ulen;
+        std::vector<unsigned char> cdata;
+        std::vector<char>          data;
+        bool                       ok;
+    };
+
+    std::istream& m_is;
+    unsigned      m_num_threads;
+
+    // single-thread path buffers
+    std::vector<char>          m_block;
+    std::vector<unsigned char> m_cbuf;
+
+    // pipeline state, guarded by m_mtx. The input stream is only
+    // accessed by the reader thread once the pipeline has started.
+    std::mutex                 m_mtx;
+    std::condition_variable    m_jobs_cv;
+    std::condition_variable    m_done_cv;
+
+    std::deque<std::unique_ptr<Block>>         m_jobs;
+    std::map<uint64_t, std::unique_ptr<Block>> m_done;
+
+    uint64_t m_next_seq   { 0 };     // next block to hand to the consumer
+    unsigned m_active     { 0 };     // blocks currently being decompressed
+    bool     m_input_done { false };
+    bool     m_shutdown   { false };
+    bool     m_started    { false };
+
+    std::unique_ptr<Block>     m_cur; // block exposed in the get area
+
+    std::thread                m_reader;
+    std::vector<std::thread>   m_workers;
+
+    bool read_uint(uint64_t* val) {
+        unsigned char buf[10];
+        size_t        pos = 0;
+
+        do {
+            int c = m_is.get();
+
+            if (c == istream::traits_type::eof())
+                return false;
+
+            buf[pos] = static_cast<unsigned char>(c);
+        } while (buf[pos++] & 0x80);
+
+        pos  = 0;
+        *val = vldec_u64(buf, &pos);
+
+        return true;
+    }
+
+    static bool inflate_block(Block* b) {
+        b->data.resize(b->ulen);
+
+        uLongf blen = b->ulen;
+
+        return uncompress(reinterpret_cast<Bytef*>(b->data.data()), &blen,
+                          b->cdata.data(), b->cdata.size()) == Z_OK && blen == b->ulen;
+    }
+
+    void reader_fn() {
+        size_t qcap = 2 * m_num_threads;
+
+        for (uint64_t seq = 0; ; ++seq) {
+            std::unique_ptr<Block> b { new Block };
+
+            uint64_t clen;
+
+            b->seq = seq;
+
+            if (!read_uint(&b->ulen) || !read_uint(&clen))
+                break;
+
+            b->cdata.resize(clen);
+
+            if (!m_is.read(reinterpret_cast<char*>(b->cdata.data()), clen))
+                break;
+
+            std::unique_lock<std::mutex> lk(m_mtx);
+
+            m_jobs_cv.wait(lk, [this,qcap](){
+                    return m_jobs.size() < qcap || m_shutdown;
+                });
+
+            if (m_shutdown)
+                break;
+
+            m_jobs.push_back(std::move(b));
+            m_jobs_cv.notify_all();
+        }
+
+        std::lock_guard<std::mutex> lk(m_mtx);
+
+        m_input_done = true;
+
+        m_jobs_cv.notify_all();
+        m_done_cv.notify_all();
+    }
+
+    void worker_fn() {
+        for (;;) {
+            std::unique_ptr<Block> b;
+
+            {
+                std::unique_lock<std::mutex> lk(m_mtx);
+
+                m_jobs_cv.wait(lk, [this](){
+                        return !m_jobs.empty() || m_input_done || m_shutdown;
+                    });
+
+                if (m_shutdown || (m_jobs.empty() && m_input_done))
+                    return;
+                if (m_jobs.empty())
+                    continue;
+
+                b = std::move(m_jobs.front());
+                m_jobs.pop_front();
+                ++m_active;
+
+                m_jobs_cv.notify_all(); // wake the reader: queue has room
+            }
+
+            b->ok = inflate_block(b.get());
+            b->cdata.clear();
+
+            std::lock_guard<std::mutex> lk(m_mtx);
+
+            m_done.insert(std::make_pair(b->seq, std::move(b)));
+            --m_active;
+
+            m_done_cv.notify_all();
+        }
+    }
+
+    void start() {
+        m_started = true;
+
+        m_reader = std::thread(&DecompressBuf::reader_fn, this);
+
+        for (unsigned i = 0; i < m_num_threads; ++i)
+            m_workers.push_back(std::thread(&DecompressBuf::worker_fn, this));
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lk(m_mtx);
+
+            m_shutdown = true;
+
+            m_jobs_cv.notify_all();
+            m_done_cv.notify_all();
+        }
+
+        if (m_reader.joinable())
+            m_reader.join();
+        for (std::thread& t : m_workers)
+            t.join();
+    }
+
+    int_type underflow_serial() {
+        uint64_t ulen, clen;
+
+        if (!read_uint(&ulen) || !read_uint(&clen))
+            return traits_type::eof();
+
+        m_cbuf.resize(clen);
+
+        if (!m_is.read(reinterpret_cast<char*>(m_cbuf.data()), clen))
+            return traits_type::eof();
+
+        m_block.resize(ulen);
+
+        uLongf blen = ulen;
+
+        if (uncompress(reinterpret_cast<Bytef*>(m_block.data()), &blen,
+                       m_cbuf.data(), clen) != Z_OK || blen != ulen) {
+            Log(0).stream() << "DecompressStream: error: block decompression failed" << endl;
+            return traits_type::eof();
+        }
+
+        setg(m_block.data(), m_block.data(), m_block.data() + ulen);
+
+        return traits_type::to_int_type(m_block[0]);
+    }
+
+public:
+
+    DecompressBuf(std::istream& is, unsigned n_threads)
+        : m_is(is), m_num_threads(n_threads)
+        {
+            if (m_num_threads == 0) {
+                unsigned hw = std::thread::hardware_concurrency();
+
+                m_num_threads = std::min(std::max(hw, 1u), 16u);
+            }
+        }
+
+    ~DecompressBuf() {
+        if (m_started)
+            stop();
+    }
+
+protected:
+
+    virtual int_type underflow() {
+        if (m_num_threads <= 1)
+            return underflow_serial();
+
+        if (!m_started)
+            start();
+
+        std::unique_ptr<Block> b;
+
+        {
+            std::unique_lock<std::mutex> lk(m_mtx);
+
+            m_done_cv.wait(lk, [this](){
+                    return m_done.count(m_next_seq) > 0
+                        || (m_input_done && m_jobs.empty() && m_active == 0);
+                });
+
+            auto it = m_done.find(m_next_seq);
+
+            if (it == m_done.end())
+                return traits_type::eof();
+
+            b = std::move(it->second);
+
+            m_done.erase(it);
+            ++m_next_seq;
+        }
+
+        if (!b->ok) {
+            Log(0).stream() << "DecompressStream: error: block decompression failed" << endl;
+            return traits_type::eof();
+        }
+
+        m_cur = std::move(b);
+
+        setg(m_cur->data.data(), m_cur->data.data(), m_cur->data.data() + m_cur->ulen);
+
+        return traits_type::to_int_type(m_cur->data[0]);
+    }
+};
+
+} // namespace
+
+
+struct CompressStream::CompressStreamImpl
+{
+    CompressBuf  m_buf;
+    std::ostream m_stream;
+
+    CompressStreamImpl(std::ostream& os, int level)
+        : m_buf(os, level), m_stream(&m_buf)
+        { }
+
+    ~CompressStreamImpl() {
+        m_buf.flush_block();
+    }
+};
+
+CompressStream::CompressStream(std::ostream& os, int level)
+    : mP(new CompressStreamImpl(os, level))
+{ }
+
+CompressStream::~CompressStream()
+{
+    mP.reset();
+}
+
+std::ostream& CompressStream::stream()
+{
+    return mP->m_stream;
+}
+
+void CompressStream::flush()
+{
+    mP->m_buf.flush_block();
+    mP->m_stream.flush();
+}
+
+
+struct DecompressStream::DecompressStreamImpl
+{
+    std::ifstream m_file;
+    DecompressBuf m_buf;
+    std::istream  m_stream;
+
+    DecompressStreamImpl(const std::string& filename, unsigned n_threads)
+        : m_file(filename.c_str(), ios::binary), m_buf(m_file, n_threads), m_stream(&m_buf)
+        {
+            char magic[sizeof(compress::spec_magic)];
+
+            if (!m_file.read(magic, sizeof(magic))
+                || 0 != memcmp(magic, compress::spec_magic, sizeof(magic))
+                || m_file.get() != compress::spec_codec_deflate)
+                m_stream.setstate(ios::failbit);
+        }
+};
+
+DecompressStream::DecompressStream(const std::string& filename, unsigned n_threads)
+    : mP(new DecompressStreamImpl(filename, n_threads))
+{ }
+
+DecompressStream::~DecompressStream()
+{
+    mP.reset();
+}
+
+std::istream& DecompressStream::stream()
+{
+    return mP->m_stream;
+}
+
+bool DecompressStream::is_compressed_file(const std::string& filename)
+{
+    ifstream is(filename.c_str(), ios::binary);
+
+    char magic[sizeof(compress::spec_magic)];
+
+    return is.read(magic, sizeof(magic))
+        && 0 == memcmp(magic, compress::spec_magic, sizeof(magic));
+}
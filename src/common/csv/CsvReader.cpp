@@ -33,12 +33,30 @@
 /// @file CsvReader.cpp
 /// CsvReader implementation
 
+#include "caliper/caliper-config.h"
+
 #include "caliper/common/csv/CsvReader.h"
 #include "caliper/common/csv/CsvSpec.h"
 
+#include "caliper/common/binary/BinaryReader.h"
+
+#include "caliper/common/Log.h"
+#include "caliper/common/StringConverter.h"
+
+#ifdef CALIPER_HAVE_ZLIB
+#include "caliper/common/compress/CompressStream.h"
+#endif
+
 #include <iostream>
 #include <fstream>
 
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace cali;
 using namespace std;
 
@@ -50,14 +68,83 @@ struct CsvReader::CsvReaderImpl
         : m_filename { filename }
         { }
 
-    bool read(function<void(const RecordMap&)> rec_handler) {
+    // __rec=sync markers (see CsvWriter::set_sync_markers()) are
+    // writer bookkeeping: don't forward them to the record handler
+
+    static bool is_sync_record(const char* begin, const char* end) {
+        return end - begin >= 10 && memcmp(begin, "__rec=sync", 10) == 0;
+    }
+
+    static bool is_sync_record(const string& line) {
+        return line.compare(0, 10, "__rec=sync") == 0;
+    }
+
+    // Verify a __rec=sync marker: checksum the marker's len bytes
+    // preceding the marker line and compare against its chk entry
+
+    bool verify_sync_marker(const char* base, const char* line, const char* line_end) {
+        RecordMap rec = CsvSpec::read_record(line, line_end);
+
+        auto l_it = rec.find("len");
+        auto c_it = rec.find("chk");
+
+        if (l_it == rec.end() || l_it->second.empty() || c_it == rec.end() || c_it->second.empty())
+            return false;
+
+        bool     ok_l = false, ok_c = false;
+        uint64_t len  = StringConverter(l_it->second.front()).to_uint(&ok_l);
+        uint64_t chk  = StringConverter(c_it->second.front()).to_uint(&ok_c);
+
+        if (!ok_l || !ok_c || len > static_cast<uint64_t>(line - base))
+            return false;
+
+        return CsvSpec::checksum(line - len, static_cast<size_t>(len)) == chk;
+    }
+
+    bool read(function<void(const RecordMap&)>  rec_handler,
+              function<bool(const RecordMap&)>  block_filter) {
         if (m_filename.empty()) {
             // empty file: read from stdin
 
             for (string line ; getline(std::cin, line); )
-                rec_handler(CsvSpec::read_record(line));
+                if (!is_sync_record(line))
+                    rec_handler(CsvSpec::read_record(line));
         } else {
-            // read from file
+            // delegate binary-format files to the binary reader
+
+            if (BinaryReader::is_binary_file(m_filename))
+                return BinaryReader(m_filename).read(rec_handler);
+
+#ifdef CALIPER_HAVE_ZLIB
+            // transparently decompress compressed files; the embedded
+            // stream can be either text or binary format
+
+            if (DecompressStream::is_compressed_file(m_filename)) {
+                DecompressStream ds(m_filename);
+
+                if (!ds.stream())
+                    return false;
+
+                if (BinaryReader::is_binary_stream(ds.stream()))
+                    return BinaryReader(ds.stream()).read(rec_handler);
+
+                for (string line ; getline(ds.stream(), line); )
+                    if (!is_sync_record(line))
+                        rec_handler(CsvSpec::read_record(line));
+
+                return true;
+            }
+#endif
+
+            // read from file: map it and parse the records in place,
+            // which avoids copying every line into a string and lets
+            // the OS prefetch sequentially
+
+            if (read_mmap(rec_handler, block_filter))
+                return true;
+
+            // fall back to stream reading if the file can't be mapped
+            // (e.g., it is a pipe or special file)
 
             ifstream is(m_filename.c_str());
 
@@ -65,11 +152,176 @@ struct CsvReader::CsvReaderImpl
                 return false;
 
             for (string line ; getline(is, line); )
-                rec_handler(CsvSpec::read_record(line));
+                if (!is_sync_record(line))
+                    rec_handler(CsvSpec::read_record(line));
         }
 
         return true;
     }
+
+    // Parse the footer index, if present, and collect the byte ranges
+    // of the blocks that block_filter rejects
+
+    void find_skip_blocks(const char* base, const char* end,
+                          function<bool(const RecordMap&)> block_filter,
+                          const char** data_end,
+                          vector< pair<size_t, size_t> >& skip_blocks)
+    {
+        // the footer record is the last (non-empty) line of the file
+
+        const char* le = end;
+
+        while (le > base && *(le-1) == '\n')
+            --le;
+
+        const char* ls = le;
+
+        while (ls > base && *(ls-1) != '\n')
+            --ls;
+
+        RecordMap ftr = CsvSpec::read_record(ls, le);
+
+        auto r_it = ftr.find("__rec");
+        auto i_it = ftr.find("idx");
+
+        if (r_it == ftr.end() || r_it->second.empty() || r_it->second.front() != "ftr")
+            return;
+        if (i_it == ftr.end() || i_it->second.empty())
+            return;
+
+        bool     ok  = false;
+        uint64_t idx = StringConverter(i_it->second.front()).to_uint(&ok);
+
+        if (!ok || idx > static_cast<uint64_t>(ls - base))
+            return;
+
+        // record stream ends where the index section begins
+
+        *data_end = base + idx;
+
+        // read the idx records and ask the filter which blocks to skip
+
+        for (const char* p = base + idx; p < ls; ) {
+            const char* nl = static_cast<const char*>(memchr(p, '\n', ls - p));
+
+            if (!nl)
+                nl = ls;
+
+            RecordMap rec = CsvSpec::read_record(p, nl);
+
+            p = nl + 1;
+
+            auto rr = rec.find("__rec");
+
+            if (rr == rec.end() || rr->second.empty() || rr->second.front() != "idx")
+                continue;
+
+            auto o_it = rec.find("offset");
+            auto l_it = rec.find("len");
+
+            if (o_it == rec.end() || o_it->second.empty() || l_it == rec.end() || l_it->second.empty())
+                continue;
+
+            bool     ok_o = false, ok_l = false;
+            uint64_t off  = StringConverter(o_it->second.front()).to_uint(&ok_o);
+            uint64_t len  = StringConverter(l_it->second.front()).to_uint(&ok_l);
+
+            if (ok_o && ok_l && off + len <= idx && !block_filter(rec))
+                skip_blocks.push_back(make_pair(static_cast<size_t>(off), static_cast<size_t>(len)));
+        }
+    }
+
+    bool read_mmap(function<void(const RecordMap&)> rec_handler,
+                   function<bool(const RecordMap&)> block_filter) {
+        int fd = open(m_filename.c_str(), O_RDONLY);
+
+        if (fd == -1)
+            return false;
+
+        struct stat statbuf;
+
+        if (fstat(fd, &statbuf) == -1 || !S_ISREG(statbuf.st_mode)) {
+            close(fd);
+            return false;
+        }
+
+        size_t size = static_cast<size_t>(statbuf.st_size);
+
+        if (size == 0) {
+            close(fd);
+            return true;
+        }
+
+        void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (map == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+
+        madvise(map, size, MADV_SEQUENTIAL);
+
+        const char* base     = static_cast<const char*>(map);
+        const char* end      = base + size;
+        const char* data_end = end;
+
+        vector< pair<size_t, size_t> > skip_blocks; // (offset, len) sorted by offset
+
+        if (block_filter)
+            find_skip_blocks(base, end, block_filter, &data_end, skip_blocks);
+
+        const char* p      = base;
+        size_t      next   = 0;
+        bool        verify = true; // block jumps break marker contiguity
+
+        while (p < data_end) {
+            size_t pos = static_cast<size_t>(p - base);
+
+            while (next < skip_blocks.size() && skip_blocks[next].first < pos)
+                ++next;
+
+            if (next < skip_blocks.size() && skip_blocks[next].first == pos) {
+                p = base + pos + skip_blocks[next].second;
+                ++next;
+                verify = false;
+                continue;
+            }
+
+            const char* nl = static_cast<const char*>(memchr(p, '\n', data_end - p));
+
+            if (!nl) {
+                // a line without terminating newline at the end of the
+                // file is a record torn off by a crashed writer: drop it
+
+                if (data_end == end) {
+                    Log(1).stream() << m_filename
+                                    << ": dropping incomplete record at end of file" << endl;
+                    break;
+                }
+
+                nl = data_end;
+            }
+
+            if (is_sync_record(p, nl)) {
+                if (verify && !verify_sync_marker(base, p, nl))
+                    Log(0).stream() << m_filename
+                                    << ": sync marker checksum mismatch, file may be corrupted"
+                                    << endl;
+
+                p = nl + 1;
+                continue;
+            }
+
+            rec_handler(CsvSpec::read_record(p, nl));
+
+            p = nl + 1;
+        }
+
+        munmap(map, size);
+        close(fd);
+
+        return true;
+    }
 };
 
 CsvReader::CsvReader(const string& filename)
@@ -82,5 +334,12 @@ CsvReader::~CsvReader()
 bool
 CsvReader::read(function<void(const RecordMap&)> rec_handler)
 {
-    return mP->read(rec_handler);
+    return mP->read(rec_handler, nullptr);
+}
+
+bool
+CsvReader::read(function<void(const RecordMap&)> rec_handler,
+                function<bool(const RecordMap&)> block_filter)
+{
+    return mP->read(rec_handler, block_filter);
 }
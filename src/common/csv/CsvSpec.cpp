@@ -41,11 +41,80 @@
 
 #include <vector>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace cali;
 using namespace std;
 
-namespace 
+namespace
+{
+
+// Find the first special character (escape, separator, '=', or
+// newline) in [p,end), or end if there is none. This is the inner
+// loop of both record writing and parsing: scanning 16 or 32 bytes
+// per step with SIMD compares and extracting the hit position from
+// the comparison bitmask is much faster than testing each byte.
+// The character set must match CsvSpecImpl::m_esc_chars.
+
+inline const char*
+scan_special(const char* p, const char* end)
 {
+#if defined(__AVX2__)
+    const __m256i v_esc = _mm256_set1_epi8('\\');
+    const __m256i v_sep = _mm256_set1_epi8(',');
+    const __m256i v_equ = _mm256_set1_epi8('=');
+    const __m256i v_nwl = _mm256_set1_epi8('\n');
+
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+
+        __m256i m =
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, v_esc),
+                                            _mm256_cmpeq_epi8(v, v_sep)),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(v, v_equ),
+                                            _mm256_cmpeq_epi8(v, v_nwl)));
+
+        unsigned mask = _mm256_movemask_epi8(m);
+
+        if (mask)
+            return p + __builtin_ctz(mask);
+
+        p += 32;
+    }
+#elif defined(__SSE2__)
+    const __m128i v_esc = _mm_set1_epi8('\\');
+    const __m128i v_sep = _mm_set1_epi8(',');
+    const __m128i v_equ = _mm_set1_epi8('=');
+    const __m128i v_nwl = _mm_set1_epi8('\n');
+
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+
+        __m128i m =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, v_esc),
+                                      _mm_cmpeq_epi8(v, v_sep)),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, v_equ),
+                                      _mm_cmpeq_epi8(v, v_nwl)));
+
+        unsigned mask = _mm_movemask_epi8(m);
+
+        if (mask)
+            return p + __builtin_ctz(mask);
+
+        p += 16;
+    }
+#endif
+
+    for ( ; p != end; ++p)
+        if (*p == '\\' || *p == ',' || *p == '=' || *p == '\n')
+            break;
+
+    return p;
+}
 
 struct CsvSpecImpl
 {
@@ -58,15 +127,22 @@ struct CsvSpecImpl
     // --- write interface
 
     void write_string(ostream& os, const char* str, size_t size) const {
-        // os << '"';
+        // write unescaped runs in one go, scanning with scan_special()
 
-        for (size_t i = 0; i < size; ++i) {
-            if (m_esc_chars.find(str[i]) != string::npos)
-                os << m_esc;
-            os << str[i];
-        }
+        const char* p   = str;
+        const char* end = str + size;
+
+        while (p != end) {
+            const char* q = scan_special(p, end);
 
-        // os << '"';
+            if (q != p)
+                os.write(p, q - p);
+            if (q == end)
+                break;
+
+            os << m_esc << *q;
+            p = q + 1;
+        }
     }
 
     void write_string(ostream& os, const string& str) const {
@@ -76,31 +152,6 @@ struct CsvSpecImpl
 
     // --- read interface
 
-    vector<string> split(const string& line, char sep, bool keep_escape = false) const {
-        vector<string> vec;
-        string str;
-        bool   escaped = false;
-        
-        for (auto it = line.begin(); it != line.end(); ++it) {
-            if (!escaped && *it == m_esc) {
-                escaped = true;
-                
-                if (keep_escape)
-                    str.push_back(m_esc);
-            } else if (!escaped && *it == sep) {
-                vec.push_back(str);
-                str.clear();
-            } else {
-                str.push_back(*it);
-                escaped = false;
-            }
-        }
-
-        vec.push_back(str);
-
-        return vec;
-    }
-
     void write_record(ostream& os, const RecordDescriptor& record, const int count[], const Variant* data[]) {
         os << "__rec=" << record.name;
 
@@ -132,24 +183,81 @@ struct CsvSpecImpl
             os << endl;
     }
 
-    RecordMap read_record(const string& line) {
-        vector<string> entries = split(line, m_sep[0], true /* keep escape */ );
+    // Parse a record in place over [begin,end). A single pass unescapes
+    // characters and splits entries and key/value pairs, so callers can
+    // hand in spans of e.g. a memory-mapped file without copying lines
+    // into strings first.
+
+    RecordMap read_record(const char* begin, const char* end) {
         RecordMap      rec;
 
-        for (const string& entry : entries) {
-            vector<string> keyval = split(entry, '=', false);
+        string         key;
+        vector<string> data;
+        string         str;
+
+        bool have_key = false;
+
+        // Jump from one special character to the next with
+        // scan_special() and append the unescaped runs in between
+        // wholesale instead of examining every byte.
+
+        for (const char* p = begin; p != end; ) {
+            const char* q = scan_special(p, end);
 
-            if (keyval.size() > 1) {
-                vector<std::string> data;
+            str.append(p, q - p);
 
-                for (auto it = keyval.begin()+1; it != keyval.end(); ++it)
-                    data.emplace_back(*it);
+            if (q == end)
+                break;
 
-                rec.insert(make_pair(keyval[0], std::move(data)));                
-            } else
-                Log(1).stream() << "Invalid CSV entry: " << entry << endl;
+            if (*q == m_esc) {
+                // append the escaped character verbatim; a trailing
+                // escape at the end of input is dropped
+
+                if (q + 1 != end) {
+                    str.push_back(q[1]);
+                    p = q + 2;
+                } else
+                    p = end;
+            } else if (*q == m_sep[0]) {
+                // entry finished
+
+                if (have_key) {
+                    data.push_back(std::move(str));
+                    rec.insert(make_pair(std::move(key), std::move(data)));
+                } else
+                    Log(1).stream() << "Invalid CSV entry: " << str << endl;
+
+                key.clear();
+                data.clear();
+                str.clear();
+
+                have_key = false;
+                p = q + 1;
+            } else if (*q == '=') {
+                if (have_key)
+                    data.push_back(std::move(str));
+                else {
+                    key      = std::move(str);
+                    have_key = true;
+                }
+
+                str.clear();
+                p = q + 1;
+            } else {
+                // newline: not special on input, keep it
+                str.push_back(*q);
+                p = q + 1;
+            }
         }
 
+        // last entry
+
+        if (have_key) {
+            data.push_back(std::move(str));
+            rec.insert(make_pair(std::move(key), std::move(data)));
+        } else
+            Log(1).stream() << "Invalid CSV entry: " << str << endl;
+
         return rec;
     }
 };
@@ -170,8 +278,27 @@ CsvSpec::write_record(ostream& os, const RecordDescriptor& record, const int* da
     ::CsvSpecImpl::s_caliper_csvspec.write_record(os, record, data_count, data);
 }
 
-RecordMap 
+RecordMap
 CsvSpec::read_record(const string& line)
 {
-    return ::CsvSpecImpl::s_caliper_csvspec.read_record(line);
+    return ::CsvSpecImpl::s_caliper_csvspec.read_record(line.data(), line.data() + line.size());
+}
+
+RecordMap
+CsvSpec::read_record(const char* begin, const char* end)
+{
+    return ::CsvSpecImpl::s_caliper_csvspec.read_record(begin, end);
+}
+
+uint64_t
+CsvSpec::checksum(const char* data, std::size_t len, uint64_t seed)
+{
+    uint64_t h = seed;
+
+    for (std::size_t i = 0; i < len; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ull;
+    }
+
+    return h;
 }
@@ -35,14 +35,21 @@
 
 #include "caliper/common/csv/CsvWriter.h"
 
+#include "caliper/common/csv/CsvIndex.h"
 #include "caliper/common/csv/CsvSpec.h"
 
 #include "caliper/common/CaliperMetadataAccessInterface.h"
 #include "caliper/common/ContextRecord.h"
 #include "caliper/common/Node.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
 #include <mutex>
 #include <set>
+#include <sstream>
+#include <vector>
 
 using namespace cali;
 
@@ -53,57 +60,524 @@ struct CsvWriter::CsvWriterImpl
     std::mutex    m_os_lock;
 
     std::set<cali_id_t> m_written_nodes;
-    std::mutex    m_written_nodes_lock;
 
-    std::size_t   m_num_written;
-
-    CsvWriterImpl(std::ostream& os)
+    //
+    // --- chunk buffers. Node and snapshot records accumulate in
+    //     separate buffers and are written out batch-wise at chunk
+    //     boundaries, node section first, so node records never
+    //     interrupt a snapshot run or split an index block. All
+    //     buffer state is modified under m_os_lock.
+    //
+
+    static const std::size_t s_chunksize = 65536;
+
+    std::ostringstream m_nodebuf;
+    std::size_t        m_nodebuf_count;
+    std::ostringstream m_snapbuf;
+    std::size_t        m_snapbuf_count;
+
+    std::atomic<std::size_t> m_num_written;
+
+    //
+    // --- sync marker bookkeeping. When enabled, a __rec=sync record
+    //     with the length and checksum of the preceding record block
+    //     is appended after roughly every chunk of output and the
+    //     stream is flushed, so a job that crashes mid-run leaves a
+    //     file whose complete blocks are verifiable and recoverable.
+    //     All sync state is modified under m_os_lock.
+    //
+
+    bool          m_sync_markers;
+    std::size_t   m_sync_len; ///< accounted bytes since the last marker
+    uint64_t      m_sync_chk; ///< running checksum since the last marker
+
+    //
+    // --- claim-based output ring (non-indexed mode). Threads format
+    //     a record locally, reserve a variable-size region in the
+    //     ring with a CAS on the claim cursor, copy the record in,
+    //     and mark it ready; whoever notices enough completed backlog
+    //     publishes the contiguous ready prefix to the stream
+    //     (disruptor-style log writing). Record writes from parallel
+    //     flush threads thus only contend on the claim cursor.
+    //     Indexed output needs stream offsets at record granularity
+    //     and stays on the locked chunk-buffer path.
+    //
+
+    static const std::size_t s_ringsize   = 1 << 20;     // must be a power of two
+    static const uint32_t    s_region_pad = 0x80000000u; // wrap-around filler region
+
+    // Region layout in the ring: a header followed by the payload,
+    // padded to 8 bytes. A region is complete when its header holds
+    // the region's unique monotonic position (plus one, so position 0
+    // differs from the initial zero): region boundaries differ from
+    // lap to lap, so a header can land on residual payload bytes of
+    // the previous lap, and only a position stamp distinguishes a
+    // completed region from stale data. Regions never straddle the
+    // ring end.
+    struct RegionHeader {
+        std::atomic<uint64_t> ready; ///< region position + 1 when complete
+        uint32_t              size;  ///< total region size and flags
+        uint32_t              len;   ///< payload bytes
+    };
+
+    bool                  m_use_ring;
+    std::vector<char>     m_ring;
+
+    std::atomic<uint64_t> m_claim;   ///< monotonic count of bytes claimed
+    std::atomic<uint64_t> m_publish; ///< monotonic count of bytes published
+
+    std::mutex            m_nodes_lock; ///< ring mode: guards m_written_nodes
+
+    //
+    // --- footer index bookkeeping (see CsvIndex.h). All index state
+    //     is modified under m_os_lock.
+    //
+
+    struct BlockInfo {
+        std::streamoff offset;
+        std::streamoff len;
+        std::size_t    nrec;
+        uint64_t       bloom[csvindex::bloom_words];
+        uint64_t       tmin, tmax;
+        bool           has_time;
+    };
+
+    struct BloomMask {
+        uint64_t w[csvindex::bloom_words];
+    };
+
+    bool          m_write_index;
+    bool          m_block_open;
+
+    BlockInfo              m_block;
+    std::vector<BlockInfo> m_blocks;
+
+    std::map<cali_id_t, BloomMask> m_attr_masks; ///< attribute id -> name's bloom bits
+    std::map<cali_id_t, BloomMask> m_node_masks; ///< node id -> bloom bits of all attributes on its path
+
+    cali_id_t     m_time_attr_id;
+
+    CsvWriterImpl(std::ostream& os, bool write_index)
         : m_os(os),
-          m_num_written(0)
+          m_nodebuf_count(0),
+          m_snapbuf_count(0),
+          m_num_written(0),
+          m_sync_markers(false),
+          m_sync_len(0),
+          m_sync_chk(CsvSpec::checksum(nullptr, 0)),
+          m_use_ring(!write_index),
+          m_ring(write_index ? 0 : s_ringsize, 0),
+          m_claim(0),
+          m_publish(0),
+          m_write_index(write_index),
+          m_block_open(false),
+          m_time_attr_id(CALI_INV_ID)
     { }
-    
-    void recursive_write_node(const CaliperMetadataAccessInterface& db, cali_id_t id)
-    {
-        if (id < 11) // don't write the hard-coded metadata nodes
+
+    ~CsvWriterImpl() {
+        flush_chunks();
+    }
+
+    const BloomMask& attr_mask(const CaliperMetadataAccessInterface& db, cali_id_t attr_id) {
+        auto it = m_attr_masks.find(attr_id);
+
+        if (it == m_attr_masks.end()) {
+            BloomMask mask = { { 0, 0, 0, 0 } };
+
+            Attribute attr = db.get_attribute(attr_id);
+
+            if (attr != Attribute::invalid) {
+                std::string name = attr.name();
+
+                csvindex::bloom_add(mask.w, name.data(), name.size());
+
+                if (name == "time.offset")
+                    m_time_attr_id = attr_id;
+            }
+
+            it = m_attr_masks.insert(std::make_pair(attr_id, mask)).first;
+        }
+
+        return it->second;
+    }
+
+    const BloomMask& node_mask(const CaliperMetadataAccessInterface& db, cali_id_t node_id) {
+        auto it = m_node_masks.find(node_id);
+
+        if (it == m_node_masks.end()) {
+            BloomMask mask = { { 0, 0, 0, 0 } };
+
+            Node* node = db.node(node_id);
+
+            if (node) {
+                mask = attr_mask(db, node->attribute());
+
+                Node* parent = node->parent();
+
+                if (parent && parent->id() != CALI_INV_ID) {
+                    const BloomMask& pmask = node_mask(db, parent->id());
+
+                    for (std::size_t i = 0; i < csvindex::bloom_words; ++i)
+                        mask.w[i] |= pmask.w[i];
+                }
+            }
+
+            it = m_node_masks.insert(std::make_pair(node_id, mask)).first;
+        }
+
+        return it->second;
+    }
+
+    // Fold output bytes into the running sync block checksum.
+    // Assumes m_os_lock is locked.
+    void account_sync(const char* data, std::size_t len) {
+        if (!m_sync_markers)
             return;
 
-        {
+        m_sync_chk  = CsvSpec::checksum(data, len, m_sync_chk);
+        m_sync_len += len;
+    }
+
+    // Append a sync marker record covering the accounted bytes and
+    // flush the stream. Unless \a force is set, only writes a marker
+    // once a chunk's worth of output has accumulated.
+    // Assumes m_os_lock is locked.
+    void write_sync_marker(bool force) {
+        if (!m_sync_markers || m_sync_len == 0
+            || (!force && m_sync_len < s_chunksize))
+            return;
+
+        m_os << "__rec=sync,len=" << m_sync_len
+             << ",chk=" << m_sync_chk << '\n';
+        m_os.flush();
+
+        m_sync_len = 0;
+        m_sync_chk = CsvSpec::checksum(nullptr, 0);
+    }
+
+    // NOTE: the block handling functions assume m_os_lock is locked!
+
+    void block_begin() {
+        m_block.offset   = 0;
+        m_block.len      = 0;
+        m_block.nrec     = 0;
+        m_block.tmin     = 0;
+        m_block.tmax     = 0;
+        m_block.has_time = false;
+
+        std::fill(m_block.bloom, m_block.bloom + csvindex::bloom_words, 0);
+
+        m_block_open = true;
+    }
+
+    std::size_t buffered_size() {
+        return static_cast<std::size_t>(m_nodebuf.tellp())
+             + static_cast<std::size_t>(m_snapbuf.tellp());
+    }
+
+    // Write out buffered node and snapshot records, node section
+    // first: a node referenced by a buffered snapshot was appended no
+    // later than the snapshot, so its record always precedes it in
+    // the stream. The snapshot section forms one index block.
+    // Assumes m_os_lock is locked.
+    void flush_chunks_unlocked() {
+        if (m_nodebuf_count > 0) {
+            std::string s = m_nodebuf.str();
+
+            m_os << s;
+            account_sync(s.data(), s.size());
+
+            m_num_written  += m_nodebuf_count;
+            m_nodebuf.str(std::string());
+            m_nodebuf_count = 0;
+        }
+
+        if (m_snapbuf_count > 0) {
+            if (m_write_index) {
+                std::streamoff pos = m_os.tellp();
+
+                if (pos == -1)
+                    m_write_index = false; // stream is not seekable: can't index it
+                else
+                    m_block.offset = pos;
+            }
+
+            std::string s = m_snapbuf.str();
+
+            m_os << s;
+            account_sync(s.data(), s.size());
+
+            if (m_write_index && m_block_open) {
+                m_block.len = static_cast<std::streamoff>(m_os.tellp()) - m_block.offset;
+                m_blocks.push_back(m_block);
+            }
+
+            m_block_open    = false;
+            m_num_written  += m_snapbuf_count;
+            m_snapbuf.str(std::string());
+            m_snapbuf_count = 0;
+        }
+
+        write_sync_marker(false);
+    }
+
+    void flush_chunks() {
+        if (m_use_ring) {
+            // drain the ring. Writers commit immediately after
+            // claiming, so any in-flight region completes promptly.
+            while (m_publish.load(std::memory_order_acquire)
+                   < m_claim.load(std::memory_order_acquire))
+                publish(true);
+
             std::lock_guard<std::mutex>
-                g(m_written_nodes_lock);
+                g(m_os_lock);
 
-            if (m_written_nodes.count(id) > 0)
-                return;
+            write_sync_marker(true);
+            return;
         }
 
-        Node* node = db.node(id);
+        std::lock_guard<std::mutex>
+            g(m_os_lock);
 
-        if (!node)
+        flush_chunks_unlocked();
+        write_sync_marker(true);
+    }
+
+    // NOTE: ring-mode (claim/commit/publish) functions below
+
+    RegionHeader* header(uint64_t pos) {
+        return reinterpret_cast<RegionHeader*>(m_ring.data() + (pos & (s_ringsize-1)));
+    }
+
+    /// \brief Reserve a ring region for \a len payload bytes.
+    ///
+    /// Returns the region's monotonic stream position. Regions never
+    /// straddle the ring end: the gap is claimed along with the
+    /// region and marked as a pad. If the ring is full, helps drain
+    /// it by publishing.
+    uint64_t claim(std::size_t len) {
+        uint64_t size = sizeof(RegionHeader) + ((len + 7) & ~static_cast<uint64_t>(7));
+        uint64_t head = m_claim.load(std::memory_order_relaxed);
+
+        for (;;) {
+            uint64_t off   = head & (s_ringsize-1);
+            bool     wrap  = off + size > s_ringsize;
+            uint64_t alloc = wrap ? (s_ringsize - off) + size : size;
+
+            if (head + alloc > m_publish.load(std::memory_order_acquire) + s_ringsize) {
+                publish(true);
+                head = m_claim.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (m_claim.compare_exchange_weak(head, head + alloc,
+                                              std::memory_order_relaxed)) {
+                if (wrap) {
+                    RegionHeader* pad = header(head);
+
+                    pad->size = static_cast<uint32_t>(s_ringsize - off) | s_region_pad;
+                    pad->ready.store(head + 1, std::memory_order_release);
+
+                    head += s_ringsize - off;
+                }
+
+                return head;
+            }
+        }
+    }
+
+    /// \brief Fill the region claimed at \a pos and mark it ready.
+    void commit(uint64_t pos, const char* data, std::size_t len) {
+        RegionHeader* h = header(pos);
+
+        h->size = static_cast<uint32_t>(sizeof(RegionHeader) + ((len + 7) & ~static_cast<std::size_t>(7)));
+        h->len  = static_cast<uint32_t>(len);
+
+        memcpy(m_ring.data() + (pos & (s_ringsize-1)) + sizeof(RegionHeader), data, len);
+
+        h->ready.store(pos + 1, std::memory_order_release);
+    }
+
+    /// \brief Write the contiguous completed region prefix to the stream.
+    ///
+    /// Only one publisher works at a time; unless \a blocking is set,
+    /// other threads return immediately.
+    void publish(bool blocking) {
+        if (blocking)
+            m_os_lock.lock();
+        else if (!m_os_lock.try_lock())
             return;
 
-        recursive_write_node(db, node->attribute());
+        uint64_t pos = m_publish.load(std::memory_order_relaxed);
 
-        Node* parent = node->parent();
+        for (;;) {
+            RegionHeader* h = header(pos);
 
-        if (parent && parent->id() != CALI_INV_ID)
-            recursive_write_node(db, parent->id());
+            if (h->ready.load(std::memory_order_acquire) != pos + 1)
+                break;
+
+            if (!(h->size & s_region_pad)) {
+                const char* p = m_ring.data() + (pos & (s_ringsize-1)) + sizeof(RegionHeader);
+
+                m_os.write(p, h->len);
+                account_sync(p, h->len);
+            }
+
+            pos += h->size & ~s_region_pad;
+
+            m_publish.store(pos, std::memory_order_release);
+        }
+
+        write_sync_marker(false);
+
+        m_os_lock.unlock();
+    }
+
+    /// \brief Write a formatted record through the ring.
+    void write_record_ring(const char* data, std::size_t len, std::size_t n_rec) {
+        if (sizeof(RegionHeader) + len > s_ringsize / 4) {
+            // outsize record: drain the ring and write it directly
+            flush_chunks();
 
-        {
             std::lock_guard<std::mutex>
                 g(m_os_lock);
-            
-            CsvSpec::write_record(m_os, node->record());
-            ++m_num_written;
+
+            m_os.write(data, len);
+            account_sync(data, len);
+        } else
+            commit(claim(len), data, len);
+
+        m_num_written.fetch_add(n_rec, std::memory_order_relaxed);
+
+        if (m_claim.load(std::memory_order_relaxed)
+            - m_publish.load(std::memory_order_relaxed) >= s_chunksize)
+            publish(false);
+    }
+
+    /// \brief Write the not-yet-written node records among \a nodes
+    ///   and \a attr, with their attribute and parent records.
+    ///
+    /// The region is claimed under the node lock: a later snapshot
+    /// record referencing these nodes is claimed after them and so
+    /// published after them.
+    void write_nodes_ring(const CaliperMetadataAccessInterface& db,
+                          std::size_t n_nodes, const cali_id_t nodes[],
+                          std::size_t n_imm,   const cali_id_t attr[])
+    {
+        thread_local std::ostringstream buf;
+
+        std::size_t count = 0;
+
+        std::lock_guard<std::mutex>
+            g(m_nodes_lock);
+
+        for (std::size_t i = 0; i < n_nodes; ++i)
+            recursive_write_node(db, nodes[i], buf, count);
+        for (std::size_t i = 0; i < n_imm;   ++i)
+            recursive_write_node(db, attr[i],  buf, count);
+
+        if (count > 0) {
+            std::string rec = buf.str();
+            buf.str(std::string());
+
+            write_record_ring(rec.data(), rec.size(), count);
         }
+    }
 
-        {
-            std::lock_guard<std::mutex>
-                g(m_written_nodes_lock);
+    void block_add(const CaliperMetadataAccessInterface& db,
+                   size_t n_nodes, const cali_id_t nodes[],
+                   size_t n_imm,   const cali_id_t attr[], const Variant vals[])
+    {
+        if (!m_block_open)
+            block_begin();
+        if (!m_write_index)
+            return;
+
+        for (size_t i = 0; i < n_nodes; ++i) {
+            const BloomMask& mask = node_mask(db, nodes[i]);
+
+            for (std::size_t w = 0; w < csvindex::bloom_words; ++w)
+                m_block.bloom[w] |= mask.w[w];
+        }
+
+        for (size_t i = 0; i < n_imm; ++i) {
+            const BloomMask& mask = attr_mask(db, attr[i]);
+
+            for (std::size_t w = 0; w < csvindex::bloom_words; ++w)
+                m_block.bloom[w] |= mask.w[w];
+
+            if (attr[i] == m_time_attr_id) {
+                uint64_t t = vals[i].to_uint();
 
-            if (m_written_nodes.count(id) > 0)
-                return;
-       
-            m_written_nodes.insert(id);
+                m_block.tmin     = m_block.has_time ? std::min(m_block.tmin, t) : t;
+                m_block.tmax     = m_block.has_time ? std::max(m_block.tmax, t) : t;
+                m_block.has_time = true;
+            }
         }
+
+        ++m_block.nrec;
+    }
+
+    void write_index() {
+        std::lock_guard<std::mutex>
+            g(m_os_lock);
+
+        flush_chunks_unlocked();
+
+        if (!m_write_index)
+            return;
+
+        std::streamoff idx_offset = m_os.tellp();
+
+        for (const BlockInfo& b : m_blocks) {
+            m_os << "__rec=idx,offset=" << b.offset
+                 << ",len="  << b.len
+                 << ",nrec=" << b.nrec
+                 << ",bloom=" << csvindex::bloom_to_hex(b.bloom);
+
+            if (b.has_time)
+                m_os << ",tmin=" << b.tmin << ",tmax=" << b.tmax;
+
+            m_os << '\n';
+            ++m_num_written;
+        }
+
+        m_os << "__rec=ftr,idx=" << idx_offset
+             << ",nblocks=" << m_blocks.size() << std::endl;
+        ++m_num_written;
+
+        m_write_index = false;
+    }
+
+    // Append the node's record, preceded by its attribute and parent
+    // records, to the given buffer. Assumes the lock guarding
+    // m_written_nodes is held: m_os_lock on the chunk-buffer path,
+    // m_nodes_lock in ring mode.
+    void recursive_write_node(const CaliperMetadataAccessInterface& db, cali_id_t id,
+                              std::ostream& os, std::size_t& count)
+    {
+        if (id < 11) // don't write the hard-coded metadata nodes
+            return;
+
+        if (m_written_nodes.count(id) > 0)
+            return;
+
+        m_written_nodes.insert(id);
+
+        Node* node = db.node(id);
+
+        if (!node)
+            return;
+
+        recursive_write_node(db, node->attribute(), os, count);
+
+        Node* parent = node->parent();
+
+        if (parent && parent->id() != CALI_INV_ID)
+            recursive_write_node(db, parent->id(), os, count);
+
+        CsvSpec::write_record(os, node->record());
+        ++count;
     }
 
     void write_snapshot(const CaliperMetadataAccessInterface& db,
@@ -116,31 +590,140 @@ struct CsvWriter::CsvWriterImpl
         Variant v_node[128];
         Variant v_attr[128];
 
+        if (m_use_ring) {
+            write_nodes_ring(db, nn, nodes, ni, attr);
+
+            for (int i = 0; i < nn; ++i)
+                v_node[i] = Variant(nodes[i]);
+            for (int i = 0; i < ni; ++i)
+                v_attr[i] = Variant(attr[i]);
+
+            int               n[3] = { nn,     ni,     ni   };
+            const Variant* data[3] = { v_node, v_attr, vals };
+
+            thread_local std::ostringstream buf;
+
+            CsvSpec::write_record(buf, ContextRecord::record_descriptor(), n, data);
+
+            std::string rec = buf.str();
+            buf.str(std::string());
+
+            write_record_ring(rec.data(), rec.size(), 1);
+            return;
+        }
+
+        std::lock_guard<std::mutex>
+            g(m_os_lock);
+
         for (int i = 0; i < nn; ++i) {
             v_node[i] = Variant(nodes[i]);
-            recursive_write_node(db, nodes[i]);
+            recursive_write_node(db, nodes[i], m_nodebuf, m_nodebuf_count);
         }
         for (int i = 0; i < ni;   ++i) {
             v_attr[i] = Variant(attr[i]);
-            recursive_write_node(db, attr[i]);
+            recursive_write_node(db, attr[i], m_nodebuf, m_nodebuf_count);
         }
 
         int               n[3] = { nn,     ni,     ni   };
         const Variant* data[3] = { v_node, v_attr, vals };
 
-        {
-            std::lock_guard<std::mutex>
-                g(m_os_lock);
-            
-            CsvSpec::write_record(m_os, ContextRecord::record_descriptor(), n, data);
-            ++m_num_written;
+        if (m_write_index)
+            block_add(db, nn, nodes, ni, attr, vals);
+
+        CsvSpec::write_record(m_snapbuf, ContextRecord::record_descriptor(), n, data);
+        ++m_snapbuf_count;
+
+        if ((m_write_index && m_block.nrec >= csvindex::block_size)
+            || buffered_size() >= s_chunksize)
+            flush_chunks_unlocked();
+    }
+
+    void write_node(const CaliperMetadataAccessInterface& db, const Node* node)
+    {
+        if (m_use_ring) {
+            cali_id_t id = node->id();
+            write_nodes_ring(db, 1, &id, 0, nullptr);
+            return;
         }
+
+        std::lock_guard<std::mutex>
+            g(m_os_lock);
+
+        recursive_write_node(db, node->id(), m_nodebuf, m_nodebuf_count);
+    }
+
+    void write_entrylist(const CaliperMetadataAccessInterface& db, const std::vector<Entry>& list)
+    {
+        Variant   v_node[128];
+        Variant   v_attr[128];
+        Variant   v_data[128];
+
+        cali_id_t id_node[128];
+        cali_id_t id_attr[128];
+
+        int nn = 0;
+        int ni = 0;
+
+        for (const Entry& e : list)
+            if (e.node()) {
+                if (nn > 127)
+                    continue;
+
+                v_node[nn]  = Variant(e.node()->id());
+                id_node[nn] = e.node()->id();
+
+                ++nn;
+            } else if (e.is_immediate()) {
+                if (ni > 127)
+                    continue;
+
+                v_attr[ni]  = Variant(e.attribute());
+                v_data[ni]  = e.value();
+                id_attr[ni] = e.attribute();
+
+                ++ni;
+            }
+
+        int               n[3] = { nn,     ni,     ni     };
+        const Variant* data[3] = { v_node, v_attr, v_data };
+
+        if (m_use_ring) {
+            write_nodes_ring(db, nn, id_node, ni, id_attr);
+
+            thread_local std::ostringstream buf;
+
+            CsvSpec::write_record(buf, ContextRecord::record_descriptor(), n, data);
+
+            std::string rec = buf.str();
+            buf.str(std::string());
+
+            write_record_ring(rec.data(), rec.size(), 1);
+            return;
+        }
+
+        std::lock_guard<std::mutex>
+            g(m_os_lock);
+
+        for (int i = 0; i < nn; ++i)
+            recursive_write_node(db, id_node[i], m_nodebuf, m_nodebuf_count);
+        for (int i = 0; i < ni; ++i)
+            recursive_write_node(db, id_attr[i], m_nodebuf, m_nodebuf_count);
+
+        if (m_write_index)
+            block_add(db, nn, id_node, ni, id_attr, v_data);
+
+        CsvSpec::write_record(m_snapbuf, ContextRecord::record_descriptor(), n, data);
+        ++m_snapbuf_count;
+
+        if ((m_write_index && m_block.nrec >= csvindex::block_size)
+            || buffered_size() >= s_chunksize)
+            flush_chunks_unlocked();
     }
 };
 
 
-CsvWriter::CsvWriter(std::ostream& os)
-    : mP(new CsvWriterImpl(os))
+CsvWriter::CsvWriter(std::ostream& os, bool write_index)
+    : mP(new CsvWriterImpl(os, write_index))
 { }
 
 CsvWriter::~CsvWriter()
@@ -150,7 +733,17 @@ CsvWriter::~CsvWriter()
 
 size_t CsvWriter::num_written() const
 {
-    return mP->m_num_written;
+    return mP->m_num_written.load(std::memory_order_relaxed);
+}
+
+void CsvWriter::set_sync_markers(bool enable)
+{
+    mP->m_sync_markers = enable;
+}
+
+void CsvWriter::write_index()
+{
+    mP->write_index();
 }
 
 void CsvWriter::write_snapshot(const CaliperMetadataAccessInterface& db,
@@ -160,47 +753,18 @@ void CsvWriter::write_snapshot(const CaliperMetadataAccessInterface& db,
     mP->write_snapshot(db, n_nodes, nodes, n_imm, attr, vals);
 }
 
+void CsvWriter::flush()
+{
+    if (mP)
+        mP->flush_chunks();
+}
+
 void CsvWriter::operator()(const CaliperMetadataAccessInterface& db, const Node* node)
 {
-    mP->recursive_write_node(db, node->id());
+    mP->write_node(db, node);
 }
 
 void CsvWriter::operator()(const CaliperMetadataAccessInterface& db, const std::vector<Entry>& list)
 {
-    Variant v_node[128];
-    Variant v_attr[128];
-    Variant v_data[128];
-
-    int nn = 0;
-    int ni = 0;
-
-    for (const Entry& e : list)
-        if (e.node()) {
-            if (nn > 127)
-                continue;
-            
-            mP->recursive_write_node(db, e.node()->id());
-            v_node[nn] = Variant(e.node()->id());
-
-            ++nn;
-        } else if (e.is_immediate()) {
-            if (ni > 127)
-                continue;
-            
-            mP->recursive_write_node(db, e.attribute());
-            v_attr[ni] = Variant(e.attribute());
-            v_data[ni] = e.value();
-
-            ++ni;
-        }
-
-    int               n[3] = { nn,     ni,     ni     };
-    const Variant* data[3] = { v_node, v_attr, v_data };
-
-    {
-        std::lock_guard<std::mutex>
-            g(mP->m_os_lock);
-            
-        CsvSpec::write_record(mP->m_os, ContextRecord::record_descriptor(), n, data);
-    }
+    mP->write_entrylist(db, list);
 }
@@ -41,6 +41,7 @@
 #include <gtest/gtest.h>
 
 #include <map>
+#include <vector>
 
 namespace cali
 {
@@ -52,6 +53,9 @@ class MockupMetadataDB : public CaliperMetadataAccessInterface
     std::map<cali_id_t,   Attribute> m_attr_map;
     std::map<std::string, Attribute> m_attr_names;
 
+    std::vector<Node*> m_created_nodes;
+    cali_id_t          m_next_node_id = 1000;
+
     // gtest FAIL() can only be called in void functions
     void fail(const char* str) {
         FAIL() << str;
@@ -62,8 +66,10 @@ public:
     MockupMetadataDB()
     { }
 
-    ~MockupMetadataDB()
-    { }
+    ~MockupMetadataDB() {
+        for (Node* node : m_created_nodes)
+            delete node;
+    }
 
     inline void
     add_node(Node* node) {
@@ -123,8 +129,28 @@ public:
 
     Node*
     make_tree_entry(std::size_t n, const Node* nodelist[], Node* parent) {
-        fail("make_tree_entry() is not implemented in MockupMetadataDB!");
-        return nullptr;
+        Node* node = parent;
+
+        for (std::size_t i = 0; i < n; ++i) {
+            Node* child = node ? node->first_child() : nullptr;
+
+            for ( ; child && !child->equals(nodelist[i]->attribute(), nodelist[i]->data()); child = child->next_sibling())
+                ;
+
+            if (!child) {
+                child = new Node(m_next_node_id++, nodelist[i]->attribute(), nodelist[i]->data());
+
+                m_created_nodes.push_back(child);
+                add_node(child);
+
+                if (node)
+                    node->append(child);
+            }
+
+            node = child;
+        }
+
+        return node;
     }
 
 };
@@ -83,8 +83,38 @@ TEST(C_Variant_Test, CreateStringVariant) {
 
     EXPECT_EQ(cali_variant_get_type(v), CALI_TYPE_STRING);
     EXPECT_EQ(cali_variant_get_size(v), strlen(mystring)+1);
-    EXPECT_EQ(cali_variant_get_data(&v), mystring);
+    // fits into the inline buffer: the variant owns a copy
+    EXPECT_NE(cali_variant_get_data(&v), static_cast<const void*>(mystring));
     EXPECT_STREQ(static_cast<const char*>(cali_variant_get_data(&v)), mystring);
+
+    const char* mylongstring = "My considerably longer test string";
+
+    cali_variant_t v2 = cali_make_variant(CALI_TYPE_STRING, mylongstring, strlen(mylongstring)+1);
+
+    EXPECT_EQ(cali_variant_get_type(v2), CALI_TYPE_STRING);
+    EXPECT_EQ(cali_variant_get_size(v2), strlen(mylongstring)+1);
+    // exceeds the inline buffer: stored as unmanaged pointer
+    EXPECT_EQ(cali_variant_get_data(&v2), mylongstring);
+    EXPECT_STREQ(static_cast<const char*>(cali_variant_get_data(&v2)), mylongstring);
+}
+
+TEST(C_Variant_Test, InlineStringOwnership) {
+    char buf[16];
+
+    strcpy(buf, "0123456789");
+
+    cali_variant_t v = cali_make_variant(CALI_TYPE_STRING, buf, strlen(buf));
+
+    // the variant's copy must be unaffected by changes to the source buffer
+
+    strcpy(buf, "xxxxxxxxxx");
+
+    EXPECT_EQ(0, strncmp(static_cast<const char*>(cali_variant_get_data(&v)), "0123456789", 10));
+
+    cali_variant_t v2 = cali_make_variant(CALI_TYPE_STRING, "0123456789", 10);
+
+    EXPECT_TRUE(cali_variant_eq(v, v2));
+    EXPECT_EQ(cali_variant_compare(v, v2), 0);
 }
 
 TEST(C_Variant_Test, CreateBoolVariant) {
@@ -6,6 +6,8 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 using namespace cali;
 
 //
@@ -249,3 +251,53 @@ TEST(CompressedSnapshotRecordTest, Unpack) {
 
     EXPECT_EQ(t2.count(), 2);
 }
+
+TEST(CompressedSnapshotRecordTest, AppendPath) {
+    // two reference chains: (n1 <- n2), (n3)
+
+    Node* n1 = new Node(1, 1, Variant(CALI_TYPE_STRING, "whee", 4));
+    Node* n2 = new Node(2, 2, Variant(-1.0));
+    Node* n3 = new Node(3, 4, Variant(42.0));
+
+    n1->append(n2);
+
+    const Node* node_in[2] = { n2, n3 };
+
+    MockupMetadataDB db;
+
+    CompressedSnapshotRecord rec;
+
+    EXPECT_EQ(rec.append_path(db, 2, node_in), static_cast<size_t>(0));
+
+    // the record holds a single path id for the merged chain
+
+    ASSERT_EQ(rec.num_nodes(), static_cast<size_t>(1));
+
+    cali_id_t node_out;
+
+    rec.view().unpack_nodes(1, &node_out);
+
+    // reconstruct the chain by walking parents: entries appear
+    // leaf-to-root, i.e. in reverse entry order
+
+    const Node* node = db.node(node_out);
+
+    ASSERT_TRUE(node != nullptr);
+    EXPECT_TRUE(node->equals(n3->attribute(), n3->data()));
+
+    node = node->parent();
+
+    ASSERT_TRUE(node != nullptr);
+    EXPECT_TRUE(node->equals(n2->attribute(), n2->data()));
+
+    node = node->parent();
+
+    ASSERT_TRUE(node != nullptr);
+    EXPECT_TRUE(node->equals(n1->attribute(), n1->data()));
+
+    EXPECT_TRUE(node->parent() == nullptr);
+
+    delete n3;
+    delete n2;
+    delete n1;
+}
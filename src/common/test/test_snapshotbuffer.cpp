@@ -94,6 +94,98 @@ TEST(SnapshotBufferTest, Append) {
     }
 }
 
+TEST(SnapshotBufferTest, Growth) {
+    // small initial reservation: the appends below grow the buffer
+    // several times
+
+    SnapshotBuffer buf(64);
+
+    const size_t N = 100;
+
+    for (size_t i = 0; i < N; ++i) {
+        cali_id_t attr =   7;
+        Variant   data { static_cast<int>(i) };
+
+        CompressedSnapshotRecord rec;
+
+        EXPECT_EQ(rec.append(1, &attr, &data), static_cast<size_t>(0));
+
+        buf.append(rec);
+    }
+
+    EXPECT_EQ(buf.count(), N);
+
+    {
+        size_t i = 0;
+
+        buf.for_each([&i](const CompressedSnapshotRecordView& view){
+                cali_id_t attr_out;
+                Variant   data_out;
+
+                ASSERT_EQ(view.num_immediates(), static_cast<size_t>(1));
+
+                view.unpack_immediate(1, &attr_out, &data_out);
+
+                EXPECT_EQ(attr_out, static_cast<cali_id_t>(7));
+                EXPECT_EQ(data_out, Variant(static_cast<int>(i)));
+
+                ++i;
+            });
+
+        EXPECT_EQ(i, N);
+    }
+
+    {
+        size_t pos = 0;
+
+        for (size_t i = 0; i < N; ++i) {
+            CompressedSnapshotRecordView view(buf.data() + pos, &pos);
+
+            cali_id_t attr_out;
+            Variant   data_out;
+
+            view.unpack_immediate(1, &attr_out, &data_out);
+
+            EXPECT_EQ(data_out, Variant(static_cast<int>(i)));
+        }
+
+        EXPECT_EQ(pos, buf.size());
+    }
+
+    // release() drops the contents but keeps the buffer usable
+
+    buf.release();
+
+    EXPECT_EQ(buf.count(), static_cast<size_t>(0));
+    EXPECT_EQ(buf.size(),  static_cast<size_t>(0));
+
+    {
+        cali_id_t attr =   7;
+        Variant   data { 4242 };
+
+        CompressedSnapshotRecord rec;
+
+        EXPECT_EQ(rec.append(1, &attr, &data), static_cast<size_t>(0));
+
+        buf.append(rec);
+    }
+
+    EXPECT_EQ(buf.count(), static_cast<size_t>(1));
+
+    {
+        size_t pos = 0;
+
+        CompressedSnapshotRecordView view(buf.data(), &pos);
+
+        cali_id_t attr_out;
+        Variant   data_out;
+
+        view.unpack_immediate(1, &attr_out, &data_out);
+
+        EXPECT_EQ(data_out, Variant(4242));
+    }
+}
+
 TEST(SnapshotBufferTest, Import) {
     cali_id_t attr_in[3] = { 7, CALI_INV_ID, 42 };
     Variant   data_in[3] = { Variant(CALI_TYPE_INT), Variant(), Variant(1.23) };
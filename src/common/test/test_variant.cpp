@@ -62,6 +62,7 @@ TEST(Variant_Test, PackUnpack) {
     const void*    val_5_inv  = NULL;
     cali_attr_type val_6_type = CALI_TYPE_ADDR;
     bool           val_7_bool = true;
+    const char*    val_8_sstr = "short string";
 
     cali::Variant  v_1_int_in(val_1_int);
     cali::Variant  v_2_uint_in(CALI_TYPE_UINT, &val_2_uint, sizeof(uint64_t));
@@ -70,11 +71,12 @@ TEST(Variant_Test, PackUnpack) {
     cali::Variant  v_5_inv_in;
     cali::Variant  v_6_type_in(val_6_type);
     cali::Variant  v_7_bool_in(val_7_bool);
+    cali::Variant  v_8_sstr_in(CALI_TYPE_STRING, val_8_sstr, strlen(val_8_sstr)+1);
 
-    unsigned char buf[160]; // must be >= 7*22 = 154 bytes
+    unsigned char buf[200]; // must hold all packed variants incl. inline string data
     size_t pos = 0;
 
-    memset(buf, 0, 160);
+    memset(buf, 0, 200);
 
     pos += v_1_int_in.pack(buf+pos);
     pos += v_2_uint_in.pack(buf+pos);
@@ -83,8 +85,9 @@ TEST(Variant_Test, PackUnpack) {
     pos += v_5_inv_in.pack(buf+pos);
     pos += v_6_type_in.pack(buf+pos);
     pos += v_7_bool_in.pack(buf+pos);
+    pos += v_8_sstr_in.pack(buf+pos);
 
-    EXPECT_LE(pos, 154);
+    EXPECT_LE(pos, sizeof(buf));
 
     bool ok = false;
     pos = 0;
@@ -103,6 +106,8 @@ TEST(Variant_Test, PackUnpack) {
     EXPECT_TRUE(ok && "v_6 unpack (type)");
     Variant v_7_bool_out = Variant::unpack(buf+pos, &pos, &ok);
     EXPECT_TRUE(ok && "v_7 unpack (bool)");
+    Variant v_8_sstr_out = Variant::unpack(buf+pos, &pos, &ok);
+    EXPECT_TRUE(ok && "v_8 unpack (inline string)");
 
     EXPECT_EQ(v_1_int_out.type(), CALI_TYPE_INT);
     EXPECT_EQ(v_1_int_out.to_int(), val_1_int);
@@ -124,4 +129,11 @@ TEST(Variant_Test, PackUnpack) {
 
     EXPECT_EQ(v_7_bool_out.type(), CALI_TYPE_BOOL);
     EXPECT_EQ(v_7_bool_out.to_bool(), val_7_bool);
+
+    // inline strings pack their contents: the unpacked copy must not
+    // reference the original string
+
+    EXPECT_EQ(v_8_sstr_out.type(), CALI_TYPE_STRING);
+    EXPECT_NE(v_8_sstr_out.data(), static_cast<const void*>(val_8_sstr));
+    EXPECT_EQ(v_8_sstr_out.to_string(), std::string(val_8_sstr));
 }
@@ -0,0 +1,93 @@
+#include "caliper/common/c-util/vlenc.h"
+
+#include "gtest/gtest.h"
+
+#include <cstring>
+
+//
+// --- test bulk varint array encoding/decoding
+//
+
+TEST(VlencTest, ArrayRoundTrip) {
+    uint64_t vals[] = {
+        0, 1, 0x7F, 0x80, 300, 0xFFFF, 0x12345678, 0xFFFFFFFFFFFFFFFF,
+        2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17
+    };
+
+    const size_t  N = sizeof(vals)/sizeof(vals[0]);
+
+    unsigned char buf[10*N];
+
+    size_t enc_len = vlenc_u64_arr(vals, N, buf);
+
+    uint64_t out[N];
+
+    size_t dec_len = vldec_u64_arr(buf, enc_len, N, out);
+
+    EXPECT_EQ(enc_len, dec_len);
+
+    for (size_t i = 0; i < N; ++i)
+        EXPECT_EQ(vals[i], out[i]) << "at index " << i;
+}
+
+TEST(VlencTest, ArrayMatchesScalarEncoding) {
+    // bulk encoding must be byte-identical to per-value encoding
+
+    uint64_t vals[] = { 1, 2, 3, 4, 5, 6, 7, 8, 0x1234, 9, 10, 11, 12, 13, 14, 15, 16 };
+
+    const size_t  N = sizeof(vals)/sizeof(vals[0]);
+
+    unsigned char bulk[10*N];
+    unsigned char scalar[10*N];
+
+    size_t bulk_len   = vlenc_u64_arr(vals, N, bulk);
+    size_t scalar_len = 0;
+
+    for (size_t i = 0; i < N; ++i)
+        scalar_len += vlenc_u64(vals[i], scalar+scalar_len);
+
+    ASSERT_EQ(bulk_len, scalar_len);
+    EXPECT_EQ(0, memcmp(bulk, scalar, bulk_len));
+}
+
+TEST(VlencTest, FastMatchesScalar) {
+    // branchless encode/decode must match the byte-loop versions
+
+    uint64_t vals[] = {
+        0, 1, 0x7F, 0x80, 300, 0x3FFF, 0x4000, 0x12345678,
+        UINT64_C(0x00FFFFFFFFFFFFFF), UINT64_C(0x0100000000000000),
+        UINT64_C(0xFFFFFFFFFFFFFFFF)
+    };
+
+    for (uint64_t val : vals) {
+        unsigned char fast[16]   = { 0 };
+        unsigned char scalar[16] = { 0 };
+
+        size_t fast_len   = vlenc_u64_fast(val, fast);
+        size_t scalar_len = vlenc_u64(val, scalar);
+
+        ASSERT_EQ(fast_len, scalar_len) << "for value " << val;
+        EXPECT_EQ(0, memcmp(fast, scalar, fast_len)) << "for value " << val;
+
+        size_t   pos = 0;
+        uint64_t out = vldec_u64_fast(fast, &pos);
+
+        EXPECT_EQ(out, val);
+        EXPECT_EQ(pos, fast_len);
+    }
+}
+
+TEST(VlencTest, ArrayDecodeRespectsAvail) {
+    // single-byte values with avail smaller than a vector block
+
+    unsigned char buf[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+    uint64_t out[8];
+
+    size_t len = vldec_u64_arr(buf, 8, 8, out);
+
+    EXPECT_EQ(len, static_cast<size_t>(8));
+
+    for (size_t i = 0; i < 8; ++i)
+        EXPECT_EQ(out[i], static_cast<uint64_t>(i+1));
+}
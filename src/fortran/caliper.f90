@@ -3,18 +3,23 @@ module Caliper
   use, intrinsic :: iso_c_binding
 
   integer(kind=C_INT64_T), parameter :: CALI_INV_ID = -1
-  
+
+  ! Kind of the integer handles used by the handle-based annotation API
+  integer, parameter :: CALI_CONTEXT_HANDLE_KIND = C_INTPTR_T
+
+  integer(kind=C_INTPTR_T), parameter :: CALI_INV_HANDLE = 0
+
   ! cali_attr_type
   integer(kind=C_INT), parameter ::  &
-       CALI_TYPE_INV           = -1, &
-       CALI_TYPE_USR           =  0, &
-       CALI_TYPE_INT           =  1, &
-       CALI_TYPE_UINT          =  2, &
-       CALI_TYPE_STRING        =  3, &
-       CALI_TYPE_ADDR          =  4, &
-       CALI_TYPE_DOUBLE        =  5, &
-       CALI_TYPE_BOOL          =  6, &
-       CALI_TYPE_TYPE          =  7
+       CALI_TYPE_INV           =  0, &
+       CALI_TYPE_USR           =  1, &
+       CALI_TYPE_INT           =  2, &
+       CALI_TYPE_UINT          =  3, &
+       CALI_TYPE_STRING        =  4, &
+       CALI_TYPE_ADDR          =  5, &
+       CALI_TYPE_DOUBLE        =  6, &
+       CALI_TYPE_BOOL          =  7, &
+       CALI_TYPE_TYPE          =  8
 
   ! cali_attr_properties
   integer(kind=C_INT), parameter ::  &
@@ -62,7 +67,28 @@ contains
     id = cali_create_attribute_c( trim(name)//C_NULL_CHAR, type, properties )
   end subroutine cali_create_attribute
 
-  
+  ! cali_find_attribute
+  subroutine cali_find_attribute(name, id)
+    use, intrinsic :: iso_c_binding, only : C_NULL_CHAR, C_INT64_T
+    implicit none
+
+    character(len=*),        intent(in)  :: name
+
+    integer(kind=C_INT64_T), intent(out) :: id
+
+    ! cali_id_t cali_find_attribute(const char* name)
+    interface
+       integer(kind=C_INT64_T) function cali_find_attribute_c (name) &
+            bind(C, name='cali_find_attribute')
+         use, intrinsic :: iso_c_binding, only : C_CHAR, C_INT64_T
+         character(kind=C_CHAR), intent(in) :: name(*)
+       end function cali_find_attribute_c
+    end interface
+
+    id = cali_find_attribute_c( trim(name)//C_NULL_CHAR )
+  end subroutine cali_find_attribute
+
+
   ! cali_begin
   subroutine cali_begin(id, err)
     use, intrinsic :: iso_c_binding, only : C_INT64_T
@@ -284,7 +310,97 @@ contains
     end if
   end subroutine cali_end
 
-  
+
+  !
+  ! --- Handle-based annotation API
+  !
+  ! Pre-resolve an attribute/value pair into an integer handle once,
+  ! then begin/end by handle inside hot loops: the per-call path does
+  ! no character conversion or by-name lookup.
+
+  ! cali_make_context_handle
+  subroutine cali_make_context_handle(id, val, handle)
+    use, intrinsic :: iso_c_binding, only : C_CHAR, C_INT64_T, C_INTPTR_T, &
+         C_NULL_CHAR, C_PTR, C_SIZE_T
+    implicit none
+
+    integer(kind=C_INT64_T),  intent(in)  :: id
+    character(len=*),         intent(in)  :: val
+
+    integer(kind=C_INTPTR_T), intent(out) :: handle
+
+    type(C_PTR)                           :: ptr
+
+    ! cali_context_handle_t cali_make_context_handle(cali_id_t attr, const void* value, size_t size)
+    interface
+       type(C_PTR) function cali_make_context_handle_c (attr, value, size) &
+            bind(C, name='cali_make_context_handle')
+         use, intrinsic :: iso_c_binding, only : C_CHAR, C_INT64_T, C_PTR, C_SIZE_T
+         integer(kind=C_INT64_T), intent(in), value :: attr
+         character(kind=C_CHAR),  intent(in)        :: value(*)
+         integer(kind=C_SIZE_T),  intent(in), value :: size
+       end function cali_make_context_handle_c
+    end interface
+
+    ! string tree data is stored without the terminating null
+    ptr    = cali_make_context_handle_c( id, trim(val)//C_NULL_CHAR, &
+         int(len_trim(val), kind=C_SIZE_T) )
+    handle = transfer(ptr, handle)
+  end subroutine cali_make_context_handle
+
+  ! cali_begin_handle
+  subroutine cali_begin_handle(handle, err)
+    use, intrinsic :: iso_c_binding, only : C_INT, C_INTPTR_T, C_NULL_PTR, C_PTR
+    implicit none
+
+    integer(kind=C_INTPTR_T),    intent(in) :: handle
+    integer(kind(CALI_SUCCESS)), intent(out), optional :: err
+
+    integer(kind(CALI_SUCCESS))             :: err_
+
+    ! cali_err cali_begin_handle(cali_context_handle_t handle);
+    interface
+       integer(kind=C_INT) function cali_begin_handle_c (handle) &
+            bind(C, name='cali_begin_handle')
+         use, intrinsic :: iso_c_binding, only : C_INT, C_PTR
+         type(C_PTR), intent(in), value :: handle
+       end function cali_begin_handle_c
+    end interface
+
+    err_ = cali_begin_handle_c( transfer(handle, C_NULL_PTR) )
+
+    if (present(err)) then
+       err = err_
+    end if
+  end subroutine cali_begin_handle
+
+  ! cali_end_handle
+  subroutine cali_end_handle(handle, err)
+    use, intrinsic :: iso_c_binding, only : C_INT, C_INTPTR_T, C_NULL_PTR, C_PTR
+    implicit none
+
+    integer(kind=C_INTPTR_T),    intent(in) :: handle
+    integer(kind(CALI_SUCCESS)), intent(out), optional :: err
+
+    integer(kind(CALI_SUCCESS))             :: err_
+
+    ! cali_err cali_end_handle(cali_context_handle_t handle);
+    interface
+       integer(kind=C_INT) function cali_end_handle_c (handle) &
+            bind(C, name='cali_end_handle')
+         use, intrinsic :: iso_c_binding, only : C_INT, C_PTR
+         type(C_PTR), intent(in), value :: handle
+       end function cali_end_handle_c
+    end interface
+
+    err_ = cali_end_handle_c( transfer(handle, C_NULL_PTR) )
+
+    if (present(err)) then
+       err = err_
+    end if
+  end subroutine cali_end_handle
+
+
   !
   ! --- _byname "overloads"
   !
@@ -4,7 +4,8 @@ program testf03
   implicit none
 
   integer                    :: cali_ret
-  integer(kind(CALI_INV_ID)) :: iter_attr
+  integer(kind(CALI_INV_ID)) :: iter_attr, step_attr
+  integer(kind=CALI_CONTEXT_HANDLE_KIND) :: step_handle
   integer                    :: i, count
 
   ! Mark "initialization" phase
@@ -13,21 +14,32 @@ program testf03
   call cali_end_byname('initialization')
 
   if (count .gt. 0) then
-     ! Mark "loop" phase
-     call cali_begin_byname('loop')
+     ! Mark "loop" phase. "loop" is a pre-defined string attribute,
+     ! so it needs a region name.
+     call cali_begin_string_byname('loop', 'mainloop')
 
      ! create attribute for iteration counter with CALI_ATTR_ASVALUE property
      call cali_create_attribute('iteration', CALI_TYPE_INT, &
           CALI_ATTR_ASVALUE, iter_attr)
 
+     ! Pre-resolve the "step"="compute" pair into a handle: the
+     ! begin/end calls inside the loop then do no string handling
+     call cali_create_attribute('step', CALI_TYPE_STRING, &
+          CALI_ATTR_DEFAULT, step_attr)
+     call cali_make_context_handle(step_attr, 'compute', step_handle)
+
      do i = 1,count
         ! Update iteration counter attribute
         call cali_set_int(iter_attr, i)
 
+        call cali_begin_handle(step_handle)
+
         ! A Caliper snapshot taken at this point will contain
-        ! { "loop", "iteration"=<i> } 
-        
+        ! { "loop", "step"="compute", "iteration"=<i> }
+
         ! perform calculation
+
+        call cali_end_handle(step_handle)
      end do
 
      ! Clear the iteration counter attribute (otherwise, snapshots taken
@@ -1,4 +1,4 @@
-// Copyright (c) 2015-2016, Lawrence Livermore National Security, LLC.  
+// Copyright (c) 2015-2016, Lawrence Livermore National Security, LLC.
 // Produced at the Lawrence Livermore National Laboratory.
 //
 // This file is part of Caliper.
@@ -36,10 +36,290 @@
 // Include Python.h first because it may redefine some C stdlib macros
 #include <Python.h>
 
-#include <SimpleReader.h>
+#include <caliper/reader/CaliperMetadataDB.h>
+#include <caliper/reader/RecordProcessor.h>
+#include <caliper/reader/SimpleReader.h>
+
+#include <caliper/common/Attribute.h>
+#include <caliper/common/Node.h>
+
 using namespace cali;
 
+#include <cstdint>
+#include <map>
 #include <string>
+#include <vector>
+
+namespace
+{
+
+#if PY_MAJOR_VERSION < 3
+#define CALI_PYSTRING_FROMSTRING PyString_FromString
+#define CALI_PYINT_FROMLONG      PyInt_FromLong
+#else
+#define CALI_PYSTRING_FROMSTRING PyUnicode_FromString
+#define CALI_PYINT_FROMLONG      PyLong_FromLong
+#endif
+
+/// \brief Typed column under construction for read_cali_file_columns().
+///
+/// Numeric attribute types fill a flat 8-byte-per-row array. String
+/// and other types are dictionary-encoded: the column stores 64-bit
+/// codes into a per-column list of unique labels. A byte mask marks
+/// the rows that have a value for the column.
+
+struct Column {
+    cali_attr_type             type;
+
+    std::vector<int64_t>       i64;    // INT, BOOL, and dictionary codes
+    std::vector<uint64_t>      u64;    // UINT, ADDR, TYPE
+    std::vector<double>        f64;    // DOUBLE
+
+    std::vector<std::string>   labels; // string dictionary
+    std::map<std::string, int64_t> label_idx;
+
+    std::vector<unsigned char> mask;   // 1 where the row has a value
+
+    explicit Column(cali_attr_type t)
+        : type(t) { }
+
+    bool is_string() const {
+        switch (type) {
+        case CALI_TYPE_INT:
+        case CALI_TYPE_BOOL:
+        case CALI_TYPE_UINT:
+        case CALI_TYPE_ADDR:
+        case CALI_TYPE_TYPE:
+        case CALI_TYPE_DOUBLE:
+            return false;
+        default:
+            return true;
+        }
+    }
+
+    size_t size() const {
+        return mask.size();
+    }
+
+    void append_missing() {
+        switch (type) {
+        case CALI_TYPE_INT:
+        case CALI_TYPE_BOOL:
+            i64.push_back(0);
+            break;
+        case CALI_TYPE_UINT:
+        case CALI_TYPE_ADDR:
+        case CALI_TYPE_TYPE:
+            u64.push_back(0);
+            break;
+        case CALI_TYPE_DOUBLE:
+            f64.push_back(0.0);
+            break;
+        default:
+            i64.push_back(-1); // dictionary code for "no value"
+            break;
+        }
+
+        mask.push_back(0);
+    }
+
+    void pad(size_t row) {
+        while (size() < row)
+            append_missing();
+    }
+
+    void append(const Variant& value) {
+        switch (type) {
+        case CALI_TYPE_INT:
+            i64.push_back(value.c_variant().value.v_int);
+            break;
+        case CALI_TYPE_BOOL:
+            i64.push_back(value.to_bool() ? 1 : 0);
+            break;
+        case CALI_TYPE_UINT:
+        case CALI_TYPE_ADDR:
+        case CALI_TYPE_TYPE:
+            u64.push_back(value.to_uint());
+            break;
+        case CALI_TYPE_DOUBLE:
+            f64.push_back(value.to_double());
+            break;
+        default:
+            append_label(value.to_string());
+            return;
+        }
+
+        mask.push_back(1);
+    }
+
+    void append_label(const std::string& label) {
+        auto it = label_idx.find(label);
+
+        if (it == label_idx.end()) {
+            it = label_idx.insert(std::make_pair(label,
+                     static_cast<int64_t>(labels.size()))).first;
+            labels.push_back(label);
+        }
+
+        i64.push_back(it->second);
+        mask.push_back(1);
+    }
+
+    const char* typestr() const {
+        switch (type) {
+        case CALI_TYPE_INT:
+        case CALI_TYPE_BOOL:
+            return "<i8";
+        case CALI_TYPE_UINT:
+        case CALI_TYPE_ADDR:
+        case CALI_TYPE_TYPE:
+            return "<u8";
+        case CALI_TYPE_DOUBLE:
+            return "<f8";
+        default:
+            return "str";
+        }
+    }
+
+    const char* buf() const {
+        switch (type) {
+        case CALI_TYPE_UINT:
+        case CALI_TYPE_ADDR:
+        case CALI_TYPE_TYPE:
+            return reinterpret_cast<const char*>(u64.data());
+        case CALI_TYPE_DOUBLE:
+            return reinterpret_cast<const char*>(f64.data());
+        default:
+            return reinterpret_cast<const char*>(i64.data());
+        }
+    }
+};
+
+/// \brief Decode the snapshot stream into typed columns, one pass.
+
+class ColumnReader {
+    CaliperMetadataDB                m_db;
+
+    std::map<cali_id_t, Column>      m_columns;
+
+    size_t                           m_rows = 0;
+
+    Column& column(const Attribute& attr) {
+        auto it = m_columns.find(attr.id());
+
+        if (it == m_columns.end()) {
+            it = m_columns.insert(std::make_pair(attr.id(),
+                     Column(attr.type()))).first;
+            // late columns start with the rows already read missing
+            it->second.pad(m_rows);
+        }
+
+        return it->second;
+    }
+
+    void process_snapshot(const EntryList& list) {
+        for (const Entry& e : list) {
+            if (e.node()) {
+                // collect the path nodes per attribute, innermost first
+                std::map<cali_id_t, std::vector<const Node*>> by_attr;
+
+                for (const Node* node = e.node(); node && node->attribute() != CALI_INV_ID; node = node->parent())
+                    by_attr[node->attribute()].push_back(node);
+
+                for (auto &p : by_attr) {
+                    Column& col = column(m_db.get_attribute(p.first));
+
+                    if (col.size() > m_rows) // keep the first (innermost) value
+                        continue;
+
+                    col.pad(m_rows);
+
+                    if (col.is_string() && p.second.size() > 1) {
+                        // nested values of one attribute become a
+                        // '/'-joined path label, like the expand writer
+                        std::string path;
+
+                        for (auto it = p.second.rbegin(); it != p.second.rend(); ++it) {
+                            if (!path.empty())
+                                path.append(1, '/');
+                            path.append((*it)->data().to_string());
+                        }
+
+                        col.append_label(path);
+                    } else {
+                        col.append(p.second.front()->data());
+                    }
+                }
+            } else if (e.attribute() != CALI_INV_ID) {
+                Column& col = column(m_db.get_attribute(e.attribute()));
+
+                if (col.size() > m_rows)
+                    continue;
+
+                col.pad(m_rows);
+                col.append(e.value());
+            }
+        }
+
+        ++m_rows;
+    }
+
+public:
+
+    bool read(const char* filename) {
+        NodeProcessFn     node_fn = [](CaliperMetadataAccessInterface&, const Node*) { };
+        SnapshotProcessFn snap_fn =
+            [this](CaliperMetadataAccessInterface&, const EntryList& list) {
+                process_snapshot(list);
+            };
+
+        return m_db.read(filename, node_fn, snap_fn);
+    }
+
+    PyObject* make_result() {
+        PyObject* columns = PyDict_New();
+
+        for (auto &p : m_columns) {
+            Column& col = p.second;
+
+            col.pad(m_rows);
+
+            PyObject* entry = PyDict_New();
+
+            PyDict_SetItemString(entry, "type",
+                CALI_PYSTRING_FROMSTRING(col.typestr()));
+            PyDict_SetItemString(entry, "data",
+                PyByteArray_FromStringAndSize(col.buf(), 8 * m_rows));
+            PyDict_SetItemString(entry, "mask",
+                PyByteArray_FromStringAndSize(
+                    reinterpret_cast<const char*>(col.mask.data()), m_rows));
+
+            if (col.is_string()) {
+                PyObject* labels = PyList_New(col.labels.size());
+
+                for (size_t i = 0; i < col.labels.size(); ++i)
+                    PyList_SetItem(labels, i,
+                        CALI_PYSTRING_FROMSTRING(col.labels[i].c_str()));
+
+                PyDict_SetItemString(entry, "labels", labels);
+            }
+
+            PyObject* name =
+                CALI_PYSTRING_FROMSTRING(m_db.get_attribute(p.first).name().c_str());
+
+            PyDict_SetItem(columns, name, entry);
+        }
+
+        PyObject* result = PyDict_New();
+
+        PyDict_SetItemString(result, "num_rows", CALI_PYINT_FROMLONG(m_rows));
+        PyDict_SetItemString(result, "columns",  columns);
+
+        return result;
+    }
+};
+
+} // namespace
 
 extern "C" {
 
@@ -60,24 +340,56 @@ PyObject* read_cali_file(const char *filename) {
         for (auto attr : rec) {
 #if PY_MAJOR_VERSION < 3
             PyObject *key = PyString_FromString(attr.first.c_str());
-            PyObject *value = PyString_FromString(attr.second.to_string().c_str());
+            PyObject *value = PyString_FromString(attr.second.c_str());
 #else
             PyObject *key = PyUnicode_FromString(attr.first.c_str());
-            PyObject *value = PyUnicode_FromString(attr.second.to_string().c_str());            
+            PyObject *value = PyUnicode_FromString(attr.second.c_str());
 #endif
             PyDict_SetItem(row, key, value);
         }
 
-#if PY_MAJOR_VERSION < 3        
+#if PY_MAJOR_VERSION < 3
         PyObject *rowkey = PyInt_FromLong(i++);
 #else
         PyObject *rowkey = PyLong_FromLong(i++);
 #endif
-        
+
         PyDict_SetItem(result, rowkey, row);
     }
 
     return result;
 }
 
+/// Parse the whole .cali file into typed columnar arrays in one pass.
+///
+/// Returns { "num_rows": n, "columns": { name: column } }, where a
+/// column is { "type": "<i8"|"<u8"|"<f8"|"str", "data": bytearray,
+/// "mask": bytearray, ["labels": [str...]] }. Numeric columns hold
+/// 8-byte little-endian values; "str" columns hold 64-bit dictionary
+/// codes into "labels". numpy.frombuffer() maps the bytearrays without
+/// copying; see read_cali_dataframe() in calireader.py.
+
+PyObject* read_cali_file_columns(const char *filename) {
+
+    ColumnReader reader;
+
+    bool read_ok = reader.read(filename);
+
+    // ctypes' cdll releases the GIL around the call: re-acquire it
+    // before touching Python objects
+
+    PyGILState_STATE gil = PyGILState_Ensure();
+
+    PyObject* result = NULL;
+
+    if (read_ok)
+        result = reader.make_result();
+    else
+        PyErr_SetString(PyExc_IOError, "cannot read file");
+
+    PyGILState_Release(gil);
+
+    return result;
+}
+
 } // extern "C"
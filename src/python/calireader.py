@@ -1,8 +1,43 @@
-from ctypes import cdll, py_object
+from ctypes import cdll, py_object, c_char_p
 lib = cdll.LoadLibrary('./libcalireader.so')
 
 lib.read_cali_file.restype = py_object
+lib.read_cali_file_columns.restype = py_object
+lib.read_cali_file_columns.argtypes = [c_char_p]
 
 def read_cali_file(filename):
         return lib.read_cali_file(filename)
-    
+
+def read_cali_file_columns(filename):
+        """Parse a .cali file into typed columnar arrays in one C++ pass.
+
+        Returns { 'num_rows': n, 'columns': { name: column } }, where a
+        column is { 'type': '<i8'|'<u8'|'<f8'|'str', 'data': bytearray,
+        'mask': bytearray, ['labels': [str...]] }. Numeric columns hold
+        8-byte little-endian values; 'str' columns hold 64-bit dictionary
+        codes into 'labels'. numpy.frombuffer() maps the bytearrays
+        without copying.
+        """
+        if not isinstance(filename, bytes):
+                filename = filename.encode()
+        return lib.read_cali_file_columns(filename)
+
+def read_cali_dataframe(filename):
+        """Load a .cali file into a pandas DataFrame via the bulk decoder."""
+        import numpy
+        import pandas
+
+        raw  = read_cali_file_columns(filename)
+        cols = {}
+
+        for name, c in raw['columns'].items():
+                mask = numpy.frombuffer(c['mask'], dtype=numpy.uint8).astype(bool)
+
+                if c['type'] == 'str':
+                        codes      = numpy.frombuffer(c['data'], dtype='<i8')
+                        cols[name] = pandas.Categorical.from_codes(codes, c['labels'])
+                else:
+                        data       = numpy.frombuffer(c['data'], dtype=c['type'])
+                        cols[name] = numpy.ma.masked_array(data, mask=~mask)
+
+        return pandas.DataFrame(cols)
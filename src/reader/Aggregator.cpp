@@ -39,6 +39,7 @@
 
 #include "caliper/common/Attribute.h"
 #include "caliper/common/CaliperMetadataAccessInterface.h"
+#include "caliper/common/FlushExecutor.h"
 #include "caliper/common/Log.h"
 #include "caliper/common/Node.h"
 
@@ -46,6 +47,7 @@
 
 #include "caliper/common/c-util/vlenc.h"
 
+#include "caliper/common/util/prefetch.hpp"
 #include "caliper/common/util/split.hpp"
 
 #include <algorithm>
@@ -70,7 +72,25 @@ public:
         { }
     
     virtual void aggregate(CaliperMetadataAccessInterface& db, const EntryList& list) = 0;
+    virtual void merge(AggregateKernel* other) = 0;
     virtual void append_result(CaliperMetadataAccessInterface& db, EntryList& list) = 0;
+
+    /// \brief Aggregate a snapshot's immediate entries directly
+    ///   (fused single-pass path, see Aggregator::add()).
+    ///
+    /// Kernels only inspect immediate entries, so the default
+    /// materializes them for kernels without a direct implementation.
+    /// The common kernels override this to skip the materialization.
+    virtual void aggregate(CaliperMetadataAccessInterface& db,
+                           size_t n_imm, const cali_id_t attr_ids[], const Variant values[]) {
+        EntryList list;
+        list.reserve(n_imm);
+
+        for (size_t i = 0; i < n_imm; ++i)
+            list.push_back(Entry(attr_ids[i], values[i]));
+
+        aggregate(db, list);
+    }
 };
 
 class AggregateKernelConfig
@@ -101,7 +121,16 @@ public:
                 m_attr = db.create_attribute("aggregate.count", CALI_TYPE_UINT, CALI_ATTR_ASVALUE);
 
             return m_attr;
-        }        
+        }
+
+        // Lookup-only variant: the attribute pre-exists only if the
+        // input contains already aggregated records.
+        Attribute attribute_if_exists(CaliperMetadataAccessInterface& db) {
+            if (m_attr == Attribute::invalid)
+                m_attr = db.get_attribute("aggregate.count");
+
+            return m_attr;
+        }
         
         AggregateKernel* make_kernel() {
             return new CountKernel(this);
@@ -120,10 +149,41 @@ public:
         : m_count(0), m_config(config)
         { }
     
-    virtual void aggregate(CaliperMetadataAccessInterface&, const EntryList&) {
+    virtual void aggregate(CaliperMetadataAccessInterface& db, const EntryList& list) {
+        // Fold counts from already aggregated records (e.g., flushed
+        // results received from another rank or process) so partial
+        // aggregates combine correctly; other records count as one.
+
+        Attribute attr = m_config->attribute_if_exists(db);
+
+        if (attr != Attribute::invalid)
+            for (const Entry& e : list)
+                if (e.attribute() == attr.id()) {
+                    m_count += e.value().to_uint();
+                    return;
+                }
+
         ++m_count;
     }
 
+    virtual void aggregate(CaliperMetadataAccessInterface& db,
+                           size_t n_imm, const cali_id_t attr_ids[], const Variant values[]) {
+        Attribute attr = m_config->attribute_if_exists(db);
+
+        if (attr != Attribute::invalid)
+            for (size_t i = 0; i < n_imm; ++i)
+                if (attr_ids[i] == attr.id()) {
+                    m_count += values[i].to_uint();
+                    return;
+                }
+
+        ++m_count;
+    }
+
+    virtual void merge(AggregateKernel* other) {
+        m_count += static_cast<CountKernel*>(other)->m_count.load();
+    }
+
     virtual void append_result(CaliperMetadataAccessInterface& db, EntryList& list) {
         uint64_t count = m_count.load();
         
@@ -143,51 +203,126 @@ private:
 // --- SumKernel
 //
 
-class SumKernel : public AggregateKernel {
+// Common interface of the sum kernel variants, so generic and typed
+// kernels created from the same config can merge with each other.
+
+class SumKernelBase : public AggregateKernel {
+public:
+
+    virtual unsigned count() const = 0;
+    virtual Variant  sum_value() const = 0;
+};
+
+// Typed accumulators for the specialized sum kernels. Each converts
+// incoming values with the conversion fixed by the attribute's type,
+// so there is no per-value type dispatch in the accumulation loop.
+
+struct IntSumAcc {
+    int64_t m_sum;
+
+    IntSumAcc() : m_sum(0) { }
+
+    void    add(const Variant& v) { m_sum += v.to_int(); }
+    Variant value() const         { return Variant(static_cast<int>(m_sum)); }
+};
+
+struct UintSumAcc {
+    uint64_t m_sum;
+
+    UintSumAcc() : m_sum(0) { }
+
+    void    add(const Variant& v) { m_sum += v.to_uint(); }
+    Variant value() const         { return Variant(m_sum); }
+};
+
+struct DoubleSumAcc {
+    double m_sum;
+
+    DoubleSumAcc() : m_sum(0) { }
+
+    void    add(const Variant& v) { m_sum += v.to_double(); }
+    Variant value() const         { return Variant(m_sum); }
+};
+
+// Kahan compensated summation in long double, for accumulations
+// (e.g. energy counters) where many small increments into a large
+// running sum lose precision.
+
+struct CompensatedSumAcc {
+    long double m_sum;
+    long double m_c;
+
+    CompensatedSumAcc() : m_sum(0), m_c(0) { }
+
+    void add(const Variant& v) {
+        long double y = static_cast<long double>(v.to_double()) - m_c;
+        long double t = m_sum + y;
+
+        m_c   = (t - m_sum) - y;
+        m_sum = t;
+    }
+
+    Variant value() const { return Variant(static_cast<double>(m_sum)); }
+};
+
+class SumKernel : public SumKernelBase {
 public:
 
     class Config : public AggregateKernelConfig {
-        std::string m_aggr_attr_name;
-        Attribute   m_aggr_attr;
-        
+        std::string    m_aggr_attr_name;
+        Attribute      m_aggr_attr;
+
+        cali_attr_type m_type;  // set once the attribute is resolved
+        bool           m_compensated;
+
     public:
 
         Attribute get_aggr_attr(CaliperMetadataAccessInterface& db) {
-            if (m_aggr_attr == Attribute::invalid)
+            if (m_aggr_attr == Attribute::invalid) {
                 m_aggr_attr = db.get_attribute(m_aggr_attr_name);
 
+                if (m_aggr_attr != Attribute::invalid)
+                    m_type = m_aggr_attr.type();
+            }
+
             return m_aggr_attr;
         }
-        
-        AggregateKernel* make_kernel() {
-            return new SumKernel(this);
-        }
 
-        Config(const std::string& name)
+        // defined after TypedSumKernel: creates a type-specialized
+        // kernel once the attribute's type is known
+        AggregateKernel* make_kernel();
+
+        Config(const std::string& name, bool compensated = false)
             : m_aggr_attr_name(name),
-              m_aggr_attr(Attribute::invalid)
+              m_aggr_attr(Attribute::invalid),
+              m_type(CALI_TYPE_INV),
+              m_compensated(compensated)
             {
                 Log(2).stream() << "aggregate: creating sum kernel for attribute " << m_aggr_attr_name << std::endl;
             }
 
         static AggregateKernelConfig* create(const std::string& cfg) {
             return new Config(cfg);
-        }        
+        }
+
+        static AggregateKernelConfig* create_compensated(const std::string& cfg) {
+            return new Config(cfg, true);
+        }
     };
 
     SumKernel(Config* config)
         : m_count(0), m_config(config)
         { }
-    
+
     virtual void aggregate(CaliperMetadataAccessInterface& db, const EntryList& list) {
         std::lock_guard<std::mutex>
             g(m_lock);
-        
+
         Attribute aggr_attr = m_config->get_aggr_attr(db);
 
         if (aggr_attr == Attribute::invalid)
             return;
-            
+
         for (const Entry& e : list) {
             if (e.attribute() == aggr_attr.id()) {
                 switch (aggr_attr.type()) {
@@ -206,17 +341,78 @@ public:
                 }
 
                 ++m_count;
-                
+
+                break;
+            }
+        }
+    }
+
+    virtual void aggregate(CaliperMetadataAccessInterface& db,
+                           size_t n_imm, const cali_id_t attr_ids[], const Variant values[]) {
+        std::lock_guard<std::mutex>
+            g(m_lock);
+
+        Attribute aggr_attr = m_config->get_aggr_attr(db);
+
+        if (aggr_attr == Attribute::invalid)
+            return;
+
+        for (size_t i = 0; i < n_imm; ++i) {
+            if (attr_ids[i] == aggr_attr.id()) {
+                switch (aggr_attr.type()) {
+                case CALI_TYPE_DOUBLE:
+                    m_sum = Variant(m_sum.to_double() + values[i].to_double());
+                    break;
+                case CALI_TYPE_INT:
+                    m_sum = Variant(m_sum.to_int()    + values[i].to_int()   );
+                    break;
+                case CALI_TYPE_UINT:
+                    m_sum = Variant(m_sum.to_uint()   + values[i].to_uint()  );
+                    break;
+                default:
+                    ;
+                }
+
+                ++m_count;
+
                 break;
             }
         }
     }
 
+    virtual void merge(AggregateKernel* other) {
+        SumKernelBase* o = static_cast<SumKernelBase*>(other);
+
+        if (o->count() == 0)
+            return;
+
+        Variant o_sum = o->sum_value();
+
+        switch (o_sum.type()) {
+        case CALI_TYPE_DOUBLE:
+            m_sum = Variant(m_sum.to_double() + o_sum.to_double());
+            break;
+        case CALI_TYPE_INT:
+            m_sum = Variant(m_sum.to_int()    + o_sum.to_int()   );
+            break;
+        case CALI_TYPE_UINT:
+            m_sum = Variant(m_sum.to_uint()   + o_sum.to_uint()  );
+            break;
+        default:
+            ;
+        }
+
+        m_count += o->count();
+    }
+
     virtual void append_result(CaliperMetadataAccessInterface& db, EntryList& list) {
         if (m_count > 0)
             list.push_back(Entry(m_config->get_aggr_attr(db), m_sum));
     }
 
+    virtual unsigned count() const     { return m_count; }
+    virtual Variant  sum_value() const { return m_sum;   }
+
 private:
 
     unsigned   m_count;
@@ -225,6 +421,195 @@ private:
     Config*    m_config;
 };
 
+// Type-specialized sum kernel, instantiated by SumKernel::Config once
+// the aggregation attribute's type is known (i.e., for all but the
+// first aggregation entry). The accumulation loop has no per-value
+// type dispatch and no lock: aggregation runs on per-thread
+// aggregator instances (see cali-query), and merging only ever
+// touches a given entry's kernels from one thread (partition-wise,
+// see AggregatorImpl::merge).
+
+template<class Acc>
+class TypedSumKernel : public SumKernelBase {
+    unsigned           m_count;
+    Acc                m_acc;
+    SumKernel::Config* m_config;
+
+public:
+
+    TypedSumKernel(SumKernel::Config* config)
+        : m_count(0), m_config(config)
+        { }
+
+    virtual void aggregate(CaliperMetadataAccessInterface& db, const EntryList& list) {
+        cali_id_t id = m_config->get_aggr_attr(db).id();
+
+        for (const Entry& e : list)
+            if (e.attribute() == id) {
+                m_acc.add(e.value());
+                ++m_count;
+
+                break;
+            }
+    }
+
+    virtual void aggregate(CaliperMetadataAccessInterface& db,
+                           size_t n_imm, const cali_id_t attr_ids[], const Variant values[]) {
+        cali_id_t id = m_config->get_aggr_attr(db).id();
+
+        for (size_t i = 0; i < n_imm; ++i)
+            if (attr_ids[i] == id) {
+                m_acc.add(values[i]);
+                ++m_count;
+
+                break;
+            }
+    }
+
+    virtual void merge(AggregateKernel* other) {
+        SumKernelBase* o = static_cast<SumKernelBase*>(other);
+
+        if (o->count() == 0)
+            return;
+
+        m_acc.add(o->sum_value());
+        m_count += o->count();
+    }
+
+    virtual void append_result(CaliperMetadataAccessInterface& db, EntryList& list) {
+        if (m_count > 0)
+            list.push_back(Entry(m_config->get_aggr_attr(db), m_acc.value()));
+    }
+
+    virtual unsigned count() const     { return m_count;       }
+    virtual Variant  sum_value() const { return m_acc.value(); }
+};
+
+AggregateKernel*
+SumKernel::Config::make_kernel()
+{
+    switch (m_type) {
+    case CALI_TYPE_INT:
+        return new TypedSumKernel<IntSumAcc>(this);
+    case CALI_TYPE_UINT:
+        return new TypedSumKernel<UintSumAcc>(this);
+    case CALI_TYPE_DOUBLE:
+        return m_compensated ?
+            static_cast<AggregateKernel*>(new TypedSumKernel<CompensatedSumAcc>(this)) :
+            static_cast<AggregateKernel*>(new TypedSumKernel<DoubleSumAcc>(this));
+    default:
+        // attribute type not seen yet: the generic kernel resolves it
+        return new SumKernel(this);
+    }
+}
+
+//
+// --- ScaledSumKernel
+//
+
+class ScaledSumKernel : public AggregateKernel {
+public:
+
+    class Config : public AggregateKernelConfig {
+        std::string m_aggr_attr_name;
+        Attribute   m_aggr_attr;
+        Attribute   m_res_attr;
+
+        double      m_scale;
+
+    public:
+
+        Attribute get_aggr_attr(CaliperMetadataAccessInterface& db) {
+            if (m_aggr_attr == Attribute::invalid)
+                m_aggr_attr = db.get_attribute(m_aggr_attr_name);
+
+            return m_aggr_attr;
+        }
+
+        Attribute get_result_attr(CaliperMetadataAccessInterface& db) {
+            if (m_res_attr == Attribute::invalid)
+                m_res_attr =
+                    db.create_attribute("scale#" + m_aggr_attr_name,
+                                        CALI_TYPE_DOUBLE,
+                                        CALI_ATTR_SKIP_EVENTS | CALI_ATTR_ASVALUE);
+
+            return m_res_attr;
+        }
+
+        double scale() const { return m_scale; }
+
+        AggregateKernel* make_kernel() {
+            return new ScaledSumKernel(this);
+        }
+
+        // config is "attribute, factor", e.g. from scale(papi.PAPI_TOT_CYC,4)
+        Config(const std::string& cfg)
+            : m_aggr_attr(Attribute::invalid),
+              m_res_attr(Attribute::invalid),
+              m_scale(1.0)
+            {
+                std::vector<std::string> args;
+                util::split(cfg, ',', std::back_inserter(args));
+
+                if (args.size() > 0)
+                    m_aggr_attr_name = args[0];
+                if (args.size() > 1)
+                    m_scale = std::stod(args[1]);
+
+                Log(2).stream() << "aggregate: creating scaled sum kernel for attribute "
+                                << m_aggr_attr_name << ", factor " << m_scale << std::endl;
+            }
+
+        static AggregateKernelConfig* create(const std::string& cfg) {
+            return new Config(cfg);
+        }
+    };
+
+    ScaledSumKernel(Config* config)
+        : m_count(0), m_sum(0), m_config(config)
+        { }
+
+    virtual void aggregate(CaliperMetadataAccessInterface& db, const EntryList& list) {
+        std::lock_guard<std::mutex>
+            g(m_lock);
+
+        Attribute aggr_attr = m_config->get_aggr_attr(db);
+
+        if (aggr_attr == Attribute::invalid)
+            return;
+
+        for (const Entry& e : list) {
+            if (e.attribute() == aggr_attr.id()) {
+                m_sum += e.value().to_double();
+                ++m_count;
+
+                break;
+            }
+        }
+    }
+
+    virtual void merge(AggregateKernel* other) {
+        ScaledSumKernel* o = static_cast<ScaledSumKernel*>(other);
+
+        m_sum   += o->m_sum;
+        m_count += o->m_count;
+    }
+
+    virtual void append_result(CaliperMetadataAccessInterface& db, EntryList& list) {
+        if (m_count > 0)
+            list.push_back(Entry(m_config->get_result_attr(db),
+                                 Variant(m_sum * m_config->scale())));
+    }
+
+private:
+
+    unsigned   m_count;
+    double     m_sum;
+
+    std::mutex m_lock;
+    Config*    m_config;
+};
+
 //
 // --- StatisticsKernel
 //
@@ -369,12 +754,41 @@ public:
                 }
 
                 ++m_count;
-                
+
                 break;
             }
         }
     }
 
+    virtual void merge(AggregateKernel* other) {
+        StatisticsKernel* o = static_cast<StatisticsKernel*>(other);
+
+        if (o->m_count == 0)
+            return;
+
+        switch (o->m_sum.type()) {
+        case CALI_TYPE_DOUBLE:
+            m_sum = Variant(m_sum.to_double() + o->m_sum.to_double());
+            m_min = Variant(m_min.empty() ? o->m_min.to_double() : std::min(m_min.to_double(), o->m_min.to_double()));
+            m_max = Variant(m_max.empty() ? o->m_max.to_double() : std::max(m_max.to_double(), o->m_max.to_double()));
+            break;
+        case CALI_TYPE_INT:
+            m_sum = Variant(m_sum.to_int()  + o->m_sum.to_int());
+            m_min = Variant(m_min.empty() ? o->m_min.to_int()  : std::min(m_min.to_int(),  o->m_min.to_int()));
+            m_max = Variant(m_max.empty() ? o->m_max.to_int()  : std::max(m_max.to_int(),  o->m_max.to_int()));
+            break;
+        case CALI_TYPE_UINT:
+            m_sum = Variant(m_sum.to_uint() + o->m_sum.to_uint());
+            m_min = Variant(m_min.empty() ? o->m_min.to_uint() : std::min(m_min.to_uint(), o->m_min.to_uint()));
+            m_max = Variant(m_max.empty() ? o->m_max.to_uint() : std::max(m_max.to_uint(), o->m_max.to_uint()));
+            break;
+        default:
+            ;
+        }
+
+        m_count += o->m_count;
+    }
+
     virtual void append_result(CaliperMetadataAccessInterface& db, EntryList& list) {
         if (m_count > 0) {
             list.push_back(Entry(m_config->get_avg_attribute(db),
@@ -398,20 +812,25 @@ private:
 };
 
 enum KernelID {
-    Count       = 0,
-    Sum         = 1,
-    Statistics  = 2
+    Count           = 0,
+    Sum             = 1,
+    Statistics      = 2,
+    ScaledSum       = 3,
+    CompensatedSum  = 4
 };
 
-#define MAX_KERNEL_ID 2
+#define MAX_KERNEL_ID 4
 
 const char* kernel_args[] = { "attribute" };
+const char* scale_args[]  = { "attribute", "factor" };
 
 const QuerySpec::FunctionSignature kernel_signatures[] = {
-    { KernelID::Count,      "count",      0, 0, nullptr     },
-    { KernelID::Sum,        "sum",        1, 1, kernel_args },
-    { KernelID::Statistics, "statistics", 1, 1, kernel_args },
-    
+    { KernelID::Count,          "count",      0, 0, nullptr     },
+    { KernelID::Sum,            "sum",        1, 1, kernel_args },
+    { KernelID::Statistics,     "statistics", 1, 1, kernel_args },
+    { KernelID::ScaledSum,      "scale",      2, 2, scale_args  },
+    { KernelID::CompensatedSum, "csum",       1, 1, kernel_args },
+
     QuerySpec::FunctionSignatureTerminator
 };
 
@@ -419,9 +838,11 @@ const struct KernelInfo {
     const char* name;
     AggregateKernelConfig* (*create)(const std::string& cfg);
 } kernel_list[] = {
-    { "count",      CountKernel::Config::create      },
-    { "sum",        SumKernel::Config::create        },
-    { "statistics", StatisticsKernel::Config::create },
+    { "count",      CountKernel::Config::create           },
+    { "sum",        SumKernel::Config::create             },
+    { "statistics", StatisticsKernel::Config::create      },
+    { "scale",      ScaledSumKernel::Config::create       },
+    { "csum",       SumKernel::Config::create_compensated },
     { 0, 0 }
 };
 
@@ -437,23 +858,47 @@ struct Aggregator::AggregatorImpl
     std::mutex             m_key_lock;
 
     bool                   m_select_all;
-    
+
     vector<AggregateKernelConfig*> m_kernel_configs;
-    
-    struct TrieNode {
-        uint32_t next[256] = { 0 };
+
+    // Aggregation database: open-addressing hash tables over the
+    // packed snapshot keys (key node id plus immediate entries), so
+    // per-record group lookup is a hash probe rather than a tree walk.
+    //
+    // The hash space is split into fixed partitions, each an
+    // independently locked table. Concurrent adds only contend within
+    // a partition, and merging two aggregators decomposes into
+    // independent per-partition merges that can run in parallel
+    // (see merge()).
+
+    struct AggregateEntry {
+        unsigned char key[MAX_KEYLEN];
+        size_t        key_len;
+
         vector<AggregateKernel*> kernels;
 
-        ~TrieNode() {
+        ~AggregateEntry() {
             for (AggregateKernel* k : kernels)
                 delete k;
             kernels.clear();
         }
     };
 
-    std::vector<TrieNode*> m_trie;    
-    std::mutex             m_trie_lock;
-    
+    static const size_t PARTITION_BITS = 6;
+    static const size_t NUM_PARTITIONS = 1 << PARTITION_BITS;
+
+    struct Partition {
+        std::vector<AggregateEntry*> table; ///< linear probing, power-of-2 size
+        size_t                       count;
+        std::mutex                   lock;
+
+        Partition()
+            : table(128, nullptr), count(0)
+            { }
+    };
+
+    Partition m_partitions[NUM_PARTITIONS];
+
     //
     // --- parse config
     //
@@ -526,7 +971,13 @@ struct Aggregator::AggregatorImpl
         case QuerySpec::AggregationSelection::List:
             for (const QuerySpec::AggregationOp& k : spec.aggregation_ops.list) {
                 if (k.op.id >= 0 && k.op.id <= MAX_KERNEL_ID) {
-                    m_kernel_configs.push_back((*::kernel_list[k.op.id].create)(k.args.front()));
+                    // pass all arguments to the kernel config as comma-separated list
+                    std::string cfg = k.args.empty() ? std::string() : k.args.front();
+
+                    for (std::vector<std::string>::size_type i = 1; i < k.args.size(); ++i)
+                        cfg.append(",").append(k.args[i]);
+
+                    m_kernel_configs.push_back((*::kernel_list[k.op.id].create)(cfg));
                 } else {
                     Log(0).stream() << "aggregator: Error: Unknown aggregation kernel "
                                     << k.op.id << " (" << (k.op.name ? k.op.name : "") << ")"
@@ -542,41 +993,95 @@ struct Aggregator::AggregatorImpl
     //
     // --- aggregation db ops
     //
-    
-    TrieNode* get_trienode(uint32_t id) {
-        // Assume trie is locked!!
-        
-        if (id >= m_trie.size())
-            m_trie.resize(id+1);
 
-        if (!m_trie[id])
-            m_trie[id] = new TrieNode;
+    static uint64_t hash_key(size_t n, const unsigned char* key) {
+        // FNV-1a
+        uint64_t h = 14695981039346656037ULL;
+
+        for (size_t i = 0; i < n; ++i) {
+            h ^= key[i];
+            h *= 1099511628211ULL;
+        }
+
+        return h;
+    }
+
+    static void grow_table(Partition& part, size_t min_slots) {
+        // Assume partition is locked!!
+
+        size_t slots = 16;
+
+        while (slots < min_slots)
+            slots *= 2;
+
+        if (slots <= part.table.size())
+            return;
+
+        std::vector<AggregateEntry*> table(slots, nullptr);
+
+        for (AggregateEntry* e : part.table) {
+            if (!e)
+                continue;
+
+            for (size_t i = hash_key(e->key_len, e->key) & (slots-1); ; i = (i+1) & (slots-1))
+                if (!table[i]) {
+                    table[i] = e;
+                    break;
+                }
+        }
 
-        return m_trie[id];
+        part.table.swap(table);
     }
 
-    TrieNode* find_trienode(size_t n, unsigned char* key) {
+    AggregateEntry* find_entry(size_t n, const unsigned char* key) {
+        uint64_t   h    = hash_key(n, key);
+
+        // the partition is chosen by the top hash bits, probing within
+        // the partition's table by the low ones
+        Partition& part = m_partitions[h >> (64 - PARTITION_BITS)];
+
         std::lock_guard<std::mutex>
-            g(m_trie_lock);
+            g(part.lock);
+
+        // grow at 70% load
+        if (10 * (part.count+1) >= 7 * part.table.size())
+            grow_table(part, 2 * part.table.size());
 
-        TrieNode* trie = get_trienode(0);
+        size_t mask = part.table.size() - 1;
 
-        for ( size_t i = 0; trie && i < n; ++i ) {
-            uint32_t id = trie->next[key[i]];
+        for (size_t i = h & mask; ; i = (i+1) & mask) {
+            AggregateEntry* e = part.table[i];
 
-            if (!id) {
-                id = static_cast<uint32_t>(m_trie.size()+1);
-                trie->next[key[i]] = id;
+            if (!e) {
+                e = new AggregateEntry;
+
+                memcpy(e->key, key, n);
+                e->key_len = n;
+
+                for (AggregateKernelConfig* c : m_kernel_configs)
+                    e->kernels.push_back(c->make_kernel());
+
+                part.table[i] = e;
+                ++part.count;
+
+                return e;
             }
 
-            trie = get_trienode(id);
+            if (e->key_len == n && 0 == memcmp(e->key, key, n))
+                return e;
         }
+    }
 
-        if (trie->kernels.empty())
-            for (AggregateKernelConfig* c : m_kernel_configs)
-                trie->kernels.push_back(c->make_kernel());
-        
-        return trie;
+    void reserve(size_t n) {
+        // size each partition for its share of the hinted group count
+        // at 70% load
+
+        for (Partition& part : m_partitions) {
+            std::lock_guard<std::mutex>
+                g(part.lock);
+
+            grow_table(part, (10 * (n / NUM_PARTITIONS)) / 7 + 1);
+        }
     }
 
     //
@@ -660,9 +1165,11 @@ struct Aggregator::AggregatorImpl
         bool select_all = m_select_all;
         
         for (const Entry& e : list)
-            for (const Node* node = e.node(); node && node->attribute() != CALI_INV_ID; node = node->parent())
+            for (const Node* node = e.node(); node && node->attribute() != CALI_INV_ID; node = node->parent()) {
+                util::prefetch(node->parent());
                 if (select_all || std::find(key_ids.begin(), key_ids.end(), node->attribute()) != key_ids.end())
-                    nodes.push_back(node);    
+                    nodes.push_back(node);
+            }
 
         // Only include explicitly selected immediate entries in the key.
         // Add them in key_ids order to make sure they're normalized
@@ -683,19 +1190,76 @@ struct Aggregator::AggregatorImpl
         // --- Pack key
 
         unsigned char key[MAX_KEYLEN];
-        size_t        pos  = pack_key(key_node, immediates, db, key);
+        size_t        pos   = pack_key(key_node, immediates, db, key);
 
-        TrieNode*     trie = find_trienode(pos, key);
+        AggregateEntry* entry = find_entry(pos, key);
 
-        if (!trie)
+        if (!entry)
             return;
 
         // --- Aggregate
-        
-        for (AggregateKernel* k : trie->kernels)
+
+        for (AggregateKernel* k : entry->kernels)
             k->aggregate(db, list);
     }
 
+    // Fused single-pass path: like process(), but consumes the
+    // snapshot record's raw fields directly, so no EntryList has to
+    // be materialized for records that are only aggregated
+    void process(CaliperMetadataAccessInterface& db,
+                 size_t n_nodes, const Node* const node_entries[],
+                 size_t n_imm,   const cali_id_t attr_ids[], const Variant values[]) {
+        std::vector<cali_id_t>   key_ids = update_key_attribute_ids(db);
+
+        // --- Unravel nodes, filter for key attributes
+
+        std::vector<const Node*> nodes;
+        std::vector<Entry>       immediates;
+
+        nodes.reserve(80);
+        immediates.reserve(key_ids.size());
+
+        bool select_all = m_select_all;
+
+        for (size_t i = 0; i < n_nodes; ++i)
+            for (const Node* node = node_entries[i]; node && node->attribute() != CALI_INV_ID; node = node->parent()) {
+                util::prefetch(node->parent());
+                if (select_all || std::find(key_ids.begin(), key_ids.end(), node->attribute()) != key_ids.end())
+                    nodes.push_back(node);
+            }
+
+        // Only include explicitly selected immediate entries in the key.
+        // Add them in key_ids order to make sure they're normalized
+        for (cali_id_t id : key_ids)
+            for (size_t i = 0; i < n_imm; ++i)
+                if (attr_ids[i] == id)
+                    immediates.push_back(Entry(id, values[i]));
+
+        // --- Group by attribute, reverse nodes (restores original order) and get/create tree node
+
+        std::stable_sort(nodes.begin(), nodes.end(),
+                    [](const Node* a, const Node* b) { return a->attribute() < b->attribute(); } );
+
+        std::reverse(nodes.begin(), nodes.end());
+
+        const Node*   key_node = db.make_tree_entry(nodes.size(), nodes.data());
+
+        // --- Pack key
+
+        unsigned char key[MAX_KEYLEN];
+        size_t        pos   = pack_key(key_node, immediates, db, key);
+
+        AggregateEntry* entry = find_entry(pos, key);
+
+        if (!entry)
+            return;
+
+        // --- Aggregate
+
+        for (AggregateKernel* k : entry->kernels)
+            k->aggregate(db, n_imm, attr_ids, values);
+    }
+
     //
     // --- Flush
     //
@@ -720,72 +1284,89 @@ struct Aggregator::AggregatorImpl
         }
     }
     
-    void recursive_flush(size_t n, unsigned char* key, TrieNode* trie,
-                         CaliperMetadataAccessInterface& db, const SnapshotProcessFn push) {
-        if (!trie)
-            return;
+    void flush(CaliperMetadataAccessInterface& db, const SnapshotProcessFn push) {
+        // NOTE: No locking: we assume flush() runs serially!
 
-        // --- Write current entry (if it represents a snapshot)
-        
-        if (!trie->kernels.empty()) {
-            EntryList list;
+        for (Partition& part : m_partitions)
+            for (AggregateEntry* e : part.table) {
+                if (!e)
+                    continue;
 
-            // Decode & add key node entry
-            unpack_key(key, db, list);
+                EntryList list;
 
-            // Write aggregation variables
-            for (AggregateKernel* k : trie->kernels)
-                k->append_result(db, list);
+                // Decode & add key node entry
+                unpack_key(e->key, db, list);
 
-            push(db, list);
-        }
+                // Write aggregation variables
+                for (AggregateKernel* k : e->kernels)
+                    k->append_result(db, list);
 
-        // --- Recursively iterate over subsequent DB entries
+                push(db, list);
+            }
+    }
 
-        unsigned char* next_key = static_cast<unsigned char*>(alloca(n+2));
+    //
+    // --- Merge
+    //
 
-        memset(next_key, 0, n+2);
-        memcpy(next_key, key, n);
-        
-        for (size_t i = 0; i < 256; ++i) {
-            if (trie->next[i] == 0)
+    void merge_partition(size_t p, AggregatorImpl& from) {
+        for (AggregateEntry* e : from.m_partitions[p].table) {
+            if (!e)
                 continue;
 
-            TrieNode* next = get_trienode(trie->next[i]);
-            next_key[n]    = static_cast<unsigned char>(i);
+            AggregateEntry* target = find_entry(e->key_len, e->key);
 
-            recursive_flush(n+1, next_key, next, db, push);
+            if (target && target->kernels.size() == e->kernels.size())
+                for (size_t i = 0; i < e->kernels.size(); ++i)
+                    target->kernels[i]->merge(e->kernels[i]);
         }
     }
-    
-    void flush(CaliperMetadataAccessInterface& db, const SnapshotProcessFn push) {
-        // NOTE: No locking: we assume flush() runs serially!
-        
-        TrieNode*     trie = get_trienode(0);
-        unsigned char key  = 0;
 
-        recursive_flush(0, &key, trie, db, push);
+    void merge(AggregatorImpl& from) {
+        // Partition-wise combine: a key lands in the same partition
+        // in both aggregators, so the merge decomposes into
+        // independent per-partition merges. High-cardinality merges
+        // run them in parallel on the shared flush pool; small ones
+        // stay inline to avoid the dispatch overhead.
+
+        size_t n = 0;
+
+        for (Partition& part : from.m_partitions)
+            n += part.count;
+
+        if (n >= 4096) {
+            std::vector<FlushExecutor::Task> tasks;
+
+            tasks.reserve(NUM_PARTITIONS);
+
+            for (size_t p = 0; p < NUM_PARTITIONS; ++p)
+                tasks.push_back([this,p,&from]{ merge_partition(p, from); });
+
+            FlushExecutor::run(tasks);
+        } else
+            for (size_t p = 0; p < NUM_PARTITIONS; ++p)
+                merge_partition(p, from);
     }
 
-    AggregatorImpl() 
+    AggregatorImpl()
         : m_select_all(false)
     {
-        m_trie.reserve(4096);
     }
 
-    AggregatorImpl(const QuerySpec& spec) 
+    AggregatorImpl(const QuerySpec& spec)
         : m_select_all(false)
     {
         configure(spec);
-        m_trie.reserve(4096);
     }
 
     ~AggregatorImpl() {
-        for (TrieNode* e : m_trie)
-            delete e;
+        for (Partition& part : m_partitions) {
+            for (AggregateEntry* e : part.table)
+                delete e;
+
+            part.table.clear();
+        }
 
-        m_trie.clear();
-        
         for (AggregateKernelConfig* c : m_kernel_configs)
             delete c;
 
@@ -822,6 +1403,26 @@ Aggregator::add(CaliperMetadataAccessInterface& db, const EntryList& list)
     mP->process(db, list);
 }
 
+void
+Aggregator::add(CaliperMetadataAccessInterface& db,
+                std::size_t n_nodes, const Node* const nodes[],
+                std::size_t n_imm,   const cali_id_t attr_ids[], const Variant values[])
+{
+    mP->process(db, n_nodes, nodes, n_imm, attr_ids, values);
+}
+
+void
+Aggregator::merge(Aggregator& from)
+{
+    mP->merge(*from.mP);
+}
+
+void
+Aggregator::reserve(std::size_t n)
+{
+    mP->reserve(n);
+}
+
 const QuerySpec::FunctionSignature*
 Aggregator::aggregation_defs()
 {
@@ -35,6 +35,8 @@
 
 #include "caliper/reader/CaliperMetadataDB.h"
 
+#include "caliper/reader/Aggregator.h"
+
 #include "caliper/common/csv/CsvReader.h"
 
 #include "caliper/common/Log.h"
@@ -42,12 +44,18 @@
 #include "caliper/common/RecordMap.h"
 #include "caliper/common/StringConverter.h"
 
+#include "caliper/common/util/prefetch.hpp"
+
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstring>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <type_traits>
 #include <vector>
 
 using namespace cali;
@@ -75,28 +83,82 @@ namespace
         auto it = idmap.find(id);
         return it == idmap.end() ? id : it->second;
     }
-    
+
+    /// \brief Compact per-file node id remap table.
+    ///
+    /// Stream-local node ids are dense, so an array indexed by the
+    /// stream-local id replaces the per-record map lookup of IdMap.
+    /// Provides the same interface subset as IdMap for the merge
+    /// functions. CALI_INV_ID marks identity-mapped entries.
+    ///
+    /// A parallel array maps stream-local ids directly to the merged
+    /// nodes, so resolving a snapshot's node references is a
+    /// bounds-check and array load without a node-table lookup.
+
+    class IdRemapArray {
+        std::vector<cali_id_t>   m_map;
+        std::vector<const Node*> m_node;
+
+    public:
+
+        inline cali_id_t get(cali_id_t id) const {
+            return id < m_map.size() && m_map[id] != CALI_INV_ID ? m_map[id] : id;
+        }
+
+        inline const Node* get_node(cali_id_t id) const {
+            return id < m_node.size() ? m_node[id] : nullptr;
+        }
+
+        void insert(const std::pair<cali_id_t, cali_id_t>& p) {
+            if (p.first >= m_map.size())
+                m_map.resize(std::max<std::vector<cali_id_t>::size_type>(p.first + 1, 2 * m_map.size()), CALI_INV_ID);
+
+            m_map[p.first] = p.second;
+        }
+
+        void insert_node(cali_id_t id, const Node* node) {
+            if (id >= m_node.size())
+                m_node.resize(std::max<std::vector<const Node*>::size_type>(id + 1, 2 * m_node.size()), nullptr);
+
+            m_node[id] = node;
+        }
+    };
+
     inline cali_id_t
-    map_id_from_rec(const RecordMap& rec, const char* key, const IdMap& idmap) {
+    map_id(cali_id_t id, const IdRemapArray& idmap) {
+        return idmap.get(id);
+    }
+
+    // remember the merged node for a stream-local id (array table only)
+
+    inline void
+    remember_node(cali_id_t, const Node*, IdMap&) {
+    }
+
+    inline void
+    remember_node(cali_id_t id, const Node* node, IdRemapArray& idmap) {
+        idmap.insert_node(id, node);
+    }
+
+    template<class MapT>
+    inline cali_id_t
+    map_id_from_rec(const RecordMap& rec, const char* key, const MapT& idmap) {
         cali_id_t id = id_from_rec(rec, key);
 
-        if (id != CALI_INV_ID) {
-            auto it = idmap.find(id);
-            return it == idmap.end() ? id : it->second;
-        }
+        if (id != CALI_INV_ID)
+            return map_id(id, idmap);
 
         return CALI_INV_ID;
     }
 
+    template<class MapT>
     inline cali_id_t
-    map_id_from_string(const std::string& str, const IdMap& idmap) {
+    map_id_from_string(const std::string& str, const MapT& idmap) {
         bool ok = false;
         cali_id_t id = StringConverter(str).to_uint(&ok);
 
-        if (ok) {
-            auto it = idmap.find(id);
-            return it == idmap.end() ? id : it->second;
-        }
+        if (ok)
+            return map_id(id, idmap);
 
         return CALI_INV_ID;
     }
@@ -109,13 +171,75 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
     mutable mutex             m_node_lock;
 
     Node*                     m_type_nodes[CALI_MAXTYPE+1] = { 0 };
-    
+
     map<string, Node*>        m_attributes;
     mutable mutex             m_attribute_lock;
 
+    //
+    // Lock-free attribute-by-id table. Attribute ids are small and
+    // dense, so a flat array indexed by id serves attribute(id) --
+    // called per entry in expand and formatting paths -- with a single
+    // load. Slots hold only validated attribute nodes, published with
+    // a release store when the attribute is registered; misses fall
+    // back to the locked node-list lookup.
+    //
+
+    static const size_t       s_attr_id_table_size = 4096;
+
+    std::atomic<Node*>        m_attr_id_table[s_attr_id_table_size];
+
+    void insert_attr_id_table(Node* node) {
+        if (node && node->id() < s_attr_id_table_size)
+            m_attr_id_table[node->id()].store(node, std::memory_order_release);
+    }
+
     vector<const char*>       m_string_db;
     mutable mutex             m_string_db_lock;
-    
+
+    //
+    // --- Arena storage. Nodes and interned strings live until the DB
+    //     is destroyed, so they are carved out of larger blocks instead
+    //     of being allocated individually.
+    //
+
+    static const size_t       s_stringblock_size = 65536; // bytes per string block
+    static const size_t       s_nodeblock_size   = 4096;  // nodes per node block
+
+    typedef std::aligned_storage<sizeof(Node), alignof(Node)>::type NodeStorage;
+
+    vector< unique_ptr<char[]> > m_string_blocks;
+    size_t                    m_string_block_used = 0;
+
+    vector<NodeStorage*>      m_node_blocks;
+    size_t                    m_node_block_used = 0;
+
+    /// \brief Get storage for a string of length \a len (plus null byte).
+    /// NOTE: We assume that m_string_db_lock is locked!
+    char* alloc_string(size_t len) {
+        size_t sz = len + 1;
+
+        if (m_string_blocks.empty() || sz > s_stringblock_size - m_string_block_used) {
+            m_string_blocks.emplace_back(new char[sz > s_stringblock_size ? sz : s_stringblock_size]);
+            m_string_block_used = 0;
+        }
+
+        char* ptr = m_string_blocks.back().get() + m_string_block_used;
+        m_string_block_used += sz;
+
+        return ptr;
+    }
+
+    /// \brief Construct a node in the node arena.
+    /// NOTE: We assume that m_node_lock is locked!
+    Node* alloc_node(cali_id_t id, cali_id_t attr, const Variant& data) {
+        if (m_node_blocks.empty() || m_node_block_used == s_nodeblock_size) {
+            m_node_blocks.push_back(new NodeStorage[s_nodeblock_size]);
+            m_node_block_used = 0;
+        }
+
+        return new(m_node_blocks.back() + m_node_block_used++) Node(id, attr, data);
+    }
+
     inline Node* node(cali_id_t id) const {
         std::lock_guard<std::mutex>
             g(m_node_lock);
@@ -151,7 +275,7 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
         m_nodes.resize(11);
         
         for (const NodeInfo* info = bootstrap_nodes; info->id != CALI_INV_ID; ++info) {
-            Node* node = new Node(info->id, info->attr_id, info->data);
+            Node* node = alloc_node(info->id, info->attr_id, info->data);
 
             m_nodes[info->id] = node;
                     
@@ -162,16 +286,18 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
             
             if (info->attr_id == 9 /* type node */)
                 m_type_nodes[info->data.to_attr_type()] = node;
-            else if (info->attr_id == 8 /* attribute node*/)
+            else if (info->attr_id == 8 /* attribute node*/) {
                 m_attributes.insert(make_pair(info->data.to_string(), node));
+                insert_attr_id_table(node);
+            }
         }
     }
 
     Node* create_node(cali_id_t attr_id, const Variant& data, Node* parent) {
         // NOTE: We assume that m_node_lock is locked!
         
-        Node* node = new Node(m_nodes.size(), attr_id, data);
-        
+        Node* node = alloc_node(m_nodes.size(), attr_id, data);
+
         m_nodes.push_back(node);
 
         if (parent)
@@ -180,24 +306,28 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
         return node;
     }
 
-    /// \brief Make string variant from string database 
+    /// \brief Make string variant from string database
     Variant make_string_variant(const char* str, size_t len) {
         std::lock_guard<std::mutex>
             g(m_string_db_lock);
-                
-        auto it = std::upper_bound(m_string_db.begin(), m_string_db.end(), str,
+
+        // The database is sorted by strcmp order. Since str need not be
+        // null-terminated, compare the first len characters; a stored
+        // string that matches the prefix and ends there is an exact match.
+
+        auto it = std::lower_bound(m_string_db.begin(), m_string_db.end(), str,
                                    [len](const char* a, const char* b) { return strncmp(a, b, len) < 0; });
 
-        if (it != m_string_db.end() && str == *it)
+        if (it != m_string_db.end() && strncmp(*it, str, len) == 0 && (*it)[len] == '\0')
             return Variant(CALI_TYPE_STRING, *it, len);
 
-        char* ptr = new char[len + 1];
+        char* ptr = alloc_string(len);
         strncpy(ptr, str, len);
         ptr[len] = '\0';
-        
+
         m_string_db.insert(it, ptr);
 
-        return Variant(CALI_TYPE_STRING, ptr, len);        
+        return Variant(CALI_TYPE_STRING, ptr, len);
     }
     
     Variant make_variant(cali_attr_type type, const std::string& str) {
@@ -222,7 +352,9 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
     
     /// Merge node given by un-mapped node info from stream with given \a idmap into DB
     /// If \a v_data is a string, it must already be in the string database!
-    const Node* merge_node(cali_id_t node_id, cali_id_t attr_id, cali_id_t prnt_id, const Variant& v_data, IdMap& idmap) {
+    /// \a MapT is IdMap or the internal ::IdRemapArray.
+    template<class MapT>
+    const Node* merge_node(cali_id_t node_id, cali_id_t attr_id, cali_id_t prnt_id, const Variant& v_data, MapT& idmap) {
         attr_id = ::map_id(attr_id, idmap);
         prnt_id = ::map_id(prnt_id, idmap);
 
@@ -266,7 +398,7 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
                 g(m_node_lock);
 
             for ( node = parent->first_child(); node && !node->equals(attr_id, v_data); node = node->next_sibling() )
-                ;
+                util::prefetch(node->next_sibling());
 
             if (!node) {
                 node     = create_node(attr_id, v_data, parent);
@@ -279,15 +411,19 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
                 g(m_attribute_lock);
             
             m_attributes.insert(make_pair(string(node->data().to_string()), node));
+            insert_attr_id_table(node);
         }
 
+        ::remember_node(node_id, node, idmap);
+
         if (node_id != node->id())
             idmap.insert(make_pair(node_id, node->id()));
 
         return node;
     }
 
-    const Node* merge_node_record(const RecordMap& rec, IdMap& idmap) {
+    template<class MapT>
+    const Node* merge_node_record(const RecordMap& rec, MapT& idmap) {
         cali_id_t node_id = ::id_from_rec(rec, "id");
         cali_id_t attr_id = ::id_from_rec(rec, "attr");
         cali_id_t prnt_id = ::id_from_rec(rec, "parent");
@@ -330,20 +466,46 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
         return list;       
     }
 
-    EntryList merge_ctx_record_to_list(const RecordMap& rec, IdMap& idmap) {
+    const Node* node_from_stream_id(cali_id_t sid, const IdMap& idmap) {
+        cali_id_t id = ::map_id(sid, idmap);
+
+        std::lock_guard<std::mutex>
+            g(m_node_lock);
+
+        return id < m_nodes.size() ? m_nodes[id] : nullptr;
+    }
+
+    const Node* node_from_stream_id(cali_id_t sid, const IdRemapArray& idmap) {
+        const Node* node = idmap.get_node(sid);
+
+        if (node)
+            return node;
+
+        // id not seen as a node record in this stream: go through the node table
+
+        cali_id_t id = ::map_id(sid, idmap);
+
+        std::lock_guard<std::mutex>
+            g(m_node_lock);
+
+        return id < m_nodes.size() ? m_nodes[id] : nullptr;
+    }
+
+    template<class MapT>
+    EntryList merge_ctx_record_to_list(const RecordMap& rec, MapT& idmap) {
         EntryList list;
 
         auto r_it = rec.find("ref");
 
         if (r_it != rec.end())
             for (const std::string& str : r_it->second) {
-                cali_id_t id = ::map_id_from_string(str, idmap);
+                bool      ok  = false;
+                cali_id_t sid = StringConverter(str).to_uint(&ok);
 
-                std::lock_guard<std::mutex>
-                    g(m_node_lock);
-                
-                if (id < m_nodes.size())
-                    list.push_back(Entry(m_nodes[id]));
+                const Node* node = ok ? node_from_stream_id(sid, idmap) : nullptr;
+
+                if (node)
+                    list.push_back(Entry(node));
             }
 
         auto a_it = rec.find("attr");
@@ -394,7 +556,93 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
         return rec;
     }
 
-    void merge(CaliperMetadataDB* db, const RecordMap& rec, IdMap& idmap, NodeProcessFn node_fn, SnapshotProcessFn snap_fn) {
+    bool read(CaliperMetadataDB* db, const std::string& filename,
+              NodeProcessFn node_fn, SnapshotProcessFn snap_fn,
+              std::function<bool(const RecordMap&)> block_filter)
+    {
+        CsvReader reader(filename);
+
+        // The id map only lives while this file is read, so memory use
+        // is bounded by a single file's metadata regardless of how
+        // many files are merged into the database. Stream-local node
+        // ids are dense, so the array-based remap table avoids a tree
+        // lookup per id.
+        ::IdRemapArray idmap;
+
+        auto rec_fn = [&](const RecordMap& rec){ merge(db, rec, idmap, node_fn, snap_fn); };
+
+        return block_filter ? reader.read(rec_fn, block_filter) : reader.read(rec_fn);
+    }
+
+    // Fused aggregation path: hand a ctx record's raw fields to the
+    // aggregator's direct interface instead of materializing them as
+    // an EntryList first
+    template<class MapT>
+    void merge_ctx_record_direct(CaliperMetadataDB* db, const RecordMap& rec, MapT& idmap, Aggregator& aggregator) {
+        const Node* nodes[128];
+        size_t      n_nodes = 0;
+
+        auto r_it = rec.find("ref");
+
+        if (r_it != rec.end())
+            for (const std::string& str : r_it->second) {
+                bool      ok  = false;
+                cali_id_t sid = StringConverter(str).to_uint(&ok);
+
+                const Node* node = ok ? node_from_stream_id(sid, idmap) : nullptr;
+
+                if (node && n_nodes < 128)
+                    nodes[n_nodes++] = node;
+            }
+
+        cali_id_t attr_ids[128];
+        Variant   values[128];
+        size_t    n_imm = 0;
+
+        auto a_it = rec.find("attr");
+        auto d_it = rec.find("data");
+
+        if (a_it != rec.end() && d_it != rec.end() && a_it->second.size() == d_it->second.size())
+            for (EntryList::size_type i = 0; i < a_it->second.size() && n_imm < 128; ++i) {
+                Attribute attr = attribute(::map_id_from_string(a_it->second[i], idmap));
+
+                if (attr != Attribute::invalid) {
+                    attr_ids[n_imm] = attr.id();
+                    values[n_imm]   = make_variant(attr.type(), d_it->second[i]);
+                    ++n_imm;
+                }
+            }
+
+        aggregator.add(*db, n_nodes, nodes, n_imm, attr_ids, values);
+    }
+
+    bool read_aggregate(CaliperMetadataDB* db, const std::string& filename,
+                        NodeProcessFn node_fn, Aggregator& aggregator)
+    {
+        CsvReader reader(filename);
+
+        ::IdRemapArray idmap;
+
+        auto rec_fn = [&](const RecordMap& rec){
+            auto rec_name_it = rec.find("__rec");
+
+            if (rec_name_it == rec.end() || rec_name_it->second.empty())
+                return;
+
+            if (rec_name_it->second.front() == "node") {
+                const Node* node = merge_node_record(rec, idmap);
+
+                if (node)
+                    node_fn(*db, node);
+            } else if (rec_name_it->second.front() == "ctx" )
+                merge_ctx_record_direct(db, rec, idmap, aggregator);
+        };
+
+        return reader.read(rec_fn);
+    }
+
+    template<class MapT>
+    void merge(CaliperMetadataDB* db, const RecordMap& rec, MapT& idmap, NodeProcessFn node_fn, SnapshotProcessFn snap_fn) {
         auto rec_name_it = rec.find("__rec");
 
         if (rec_name_it == rec.end() || rec_name_it->second.empty())
@@ -410,9 +658,16 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
     }
 
     Attribute attribute(cali_id_t id) const {
+        if (id < s_attr_id_table_size) {
+            Node* node = m_attr_id_table[id].load(std::memory_order_acquire);
+
+            if (node)
+                return Attribute::make_attribute_unchecked(node);
+        }
+
         std::lock_guard<std::mutex>
             g(m_node_lock);
-        
+
         if (id >= m_nodes.size())
             return Attribute::invalid;
 
@@ -456,7 +711,7 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
                 g(m_node_lock);
             
             for (node = parent->first_child(); node && !node->equals(attr[i].id(), data[i]); node = node->next_sibling())
-                ;
+                util::prefetch(node->next_sibling());
 
             if (!node)
                 node = create_node(attr[i].id(), data[i], parent);
@@ -478,7 +733,7 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
                 g(m_node_lock);
             
             for (node = parent->first_child(); node && !node->equals(nodelist[i]->attribute(), nodelist[i]->data()); node = node->next_sibling())
-                ;
+                util::prefetch(node->next_sibling());
 
             if (!node)
                 node = create_node(nodelist[i]->attribute(), nodelist[i]->data(), parent);
@@ -516,21 +771,31 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
         Node* node = make_tree_entry(2, n_attr, n_data, parent);
 
         m_attributes.insert(make_pair(string(name), node));
-        
+        insert_attr_id_table(node);
+
         return Attribute::make_attribute(node);
     }
     
     CaliperMetadataDBImpl()
         : m_root { CALI_INV_ID, CALI_INV_ID, { } }
         {
+            for (std::atomic<Node*>& node : m_attr_id_table)
+                node.store(nullptr, std::memory_order_relaxed);
+
             setup_bootstrap_nodes();
         }
 
     ~CaliperMetadataDBImpl() {
-        for (const char* str : m_string_db)
-            delete[] str;
-        for (Node* n : m_nodes)
-            delete n;
+        // Nodes and interned strings live in the arena blocks
+
+        for (size_t b = 0; b < m_node_blocks.size(); ++b) {
+            size_t n = (b + 1 == m_node_blocks.size() ? m_node_block_used : s_nodeblock_size);
+
+            for (size_t i = 0; i < n; ++i)
+                reinterpret_cast<Node*>(m_node_blocks[b] + i)->~Node();
+
+            delete[] m_node_blocks[b];
+        }
     }
 }; // CaliperMetadataDBImpl
 
@@ -552,12 +817,31 @@ CaliperMetadataDB::merge(const RecordMap& rec, IdMap& idmap)
     return mP->merge(rec, idmap);
 }
 
-void 
+void
 CaliperMetadataDB::merge(const RecordMap& rec, IdMap& map, NodeProcessFn node_fn, SnapshotProcessFn snap_fn)
 {
     mP->merge(this, rec, map, node_fn, snap_fn);
 }
 
+bool
+CaliperMetadataDB::read(const std::string& filename, NodeProcessFn node_fn, SnapshotProcessFn snap_fn)
+{
+    return mP->read(this, filename, node_fn, snap_fn, nullptr);
+}
+
+bool
+CaliperMetadataDB::read_aggregate(const std::string& filename, NodeProcessFn node_fn, Aggregator& aggregator)
+{
+    return mP->read_aggregate(this, filename, node_fn, aggregator);
+}
+
+bool
+CaliperMetadataDB::read(const std::string& filename, NodeProcessFn node_fn, SnapshotProcessFn snap_fn,
+                        std::function<bool(const RecordMap&)> block_filter)
+{
+    return mP->read(this, filename, node_fn, snap_fn, block_filter);
+}
+
 const Node*
 CaliperMetadataDB::merge_node(cali_id_t node_id, cali_id_t attr_id, cali_id_t prnt_id, const Variant& value, IdMap& idmap)
 {
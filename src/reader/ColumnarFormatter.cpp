@@ -0,0 +1,405 @@
+// Copyright (c) 2015, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file ColumnarFormatter.cpp
+/// Columnar binary table writer
+///
+/// File layout (all integers little-endian, every buffer padded to a
+/// multiple of 8 bytes so readers can map the typed buffers in place):
+///
+///     "CALICOL1"                        8-byte magic
+///     u64 num_columns
+///     u64 num_rows
+///     per column:
+///       u32 name_len, name bytes        column (attribute) name
+///       u32 type                        cali_attr_type of the column
+///       u32 encoding                    0: fixed 8-byte values
+///                                       1: dictionary-encoded strings
+///       validity bitmap                 ceil(num_rows / 8) bytes;
+///                                       bit i set: row i has a value
+///       encoding 0:
+///         num_rows x u64                int64/uint64/float64 bit patterns,
+///                                       by column type
+///       encoding 1:
+///         num_rows x u32                dictionary indices
+///         u32 dict_count
+///         (dict_count + 1) x u32        offsets into the string heap
+///         string heap bytes             concatenated dictionary entries
+
+#include "caliper/reader/ColumnarFormatter.h"
+
+#include "caliper/reader/QuerySpec.h"
+
+#include "caliper/common/Attribute.h"
+#include "caliper/common/CaliperMetadataAccessInterface.h"
+#include "caliper/common/Node.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+using namespace cali;
+
+namespace
+{
+
+bool is_numeric(cali_attr_type type)
+{
+    return type == CALI_TYPE_INT  ||
+           type == CALI_TYPE_UINT ||
+           type == CALI_TYPE_ADDR ||
+           type == CALI_TYPE_BOOL ||
+           type == CALI_TYPE_DOUBLE;
+}
+
+void put_u32(std::ostream& os, uint32_t val)
+{
+    unsigned char buf[4];
+
+    for (int i = 0; i < 4; ++i)
+        buf[i] = static_cast<unsigned char>((val >> (8*i)) & 0xFF);
+
+    os.write(reinterpret_cast<char*>(buf), 4);
+}
+
+void put_u64(std::ostream& os, uint64_t val)
+{
+    unsigned char buf[8];
+
+    for (int i = 0; i < 8; ++i)
+        buf[i] = static_cast<unsigned char>((val >> (8*i)) & 0xFF);
+
+    os.write(reinterpret_cast<char*>(buf), 8);
+}
+
+// pad the stream to the next multiple of 8 bytes
+void pad8(std::ostream& os, size_t written)
+{
+    static const char zeros[8] = { 0 };
+
+    if (written % 8)
+        os.write(zeros, 8 - written % 8);
+}
+
+} // namespace [anonymous]
+
+struct ColumnarFormatter::ColumnarFormatterImpl
+{
+    // One column buffer. Numeric columns store 8-byte value bit
+    // patterns; string columns store dictionary indices and intern
+    // the cell strings in the dictionary.
+    struct Column {
+        Attribute attr;
+        bool      dictionary;
+
+        std::vector<uint64_t>       values;   // numeric bit patterns
+        std::vector<uint32_t>       indices;  // dictionary indices
+        std::vector<unsigned char>  validity; // bitmap, bit per row
+
+        std::vector<std::string>        dict;
+        std::map<std::string, uint32_t> dict_ids;
+
+        Column(const Attribute& attr_)
+            : attr(attr_), dictionary(!is_numeric(attr_.type()))
+        { }
+    };
+
+    std::vector<std::string> m_col_attr_names;
+    std::vector<Column>      m_cols;
+
+    size_t                   m_num_rows = 0;
+
+    std::mutex               m_lock;
+
+    bool                     m_auto_column = true;
+
+    void configure(const QuerySpec& spec) {
+        m_col_attr_names.clear();
+
+        switch (spec.attribute_selection.selection) {
+        case QuerySpec::AttributeSelection::Default:
+        case QuerySpec::AttributeSelection::All:
+            m_auto_column = true;
+            break;
+        case QuerySpec::AttributeSelection::List:
+            m_auto_column = false;
+            m_col_attr_names = spec.attribute_selection.list;
+            break;
+        case QuerySpec::AttributeSelection::None:
+            m_auto_column = false;
+        }
+    }
+
+    // Add a column for the given attribute. Columns appearing after
+    // rows have been added are backfilled as invalid.
+    void add_column(const Attribute& attr) {
+        m_cols.push_back(Column(attr));
+
+        Column& col = m_cols.back();
+
+        col.validity.assign((m_num_rows + 7) / 8, 0);
+
+        if (col.dictionary)
+            col.indices.assign(m_num_rows, 0);
+        else
+            col.values.assign(m_num_rows, 0);
+    }
+
+    void update_column_attribute(CaliperMetadataAccessInterface& db, cali_id_t attr_id) {
+        auto it = std::find_if(m_cols.begin(), m_cols.end(),
+                               [attr_id](const Column& c) {
+                                   return c.attr.id() == attr_id;
+                               });
+
+        if (it != m_cols.end())
+            return;
+
+        Attribute attr = db.get_attribute(attr_id);
+
+        if (attr == Attribute::invalid)
+            return;
+
+        std::string name = attr.name();
+
+        // Skip internal "cali." and "event." attributes
+        if (name.compare(0, 5, "cali." ) == 0 ||
+            name.compare(0, 6, "event.") == 0)
+            return;
+
+        add_column(attr);
+    }
+
+    void update_columns(CaliperMetadataAccessInterface& db, const EntryList& list) {
+        // Auto-generate columns from attributes in the snapshots. Used if no
+        // field list was given. Skips some internal attributes.
+
+        if (m_auto_column) {
+            for (const Entry& e : list) {
+                if (e.node()) {
+                    for (const Node* node = e.node(); node && node->attribute() != CALI_INV_ID; node = node->parent())
+                        update_column_attribute(db, node->attribute());
+                } else
+                    update_column_attribute(db, e.attribute());
+            }
+        } else {
+            // Check if we can look up attribute object from name
+
+            auto it = m_col_attr_names.begin();
+
+            while (it != m_col_attr_names.end()) {
+                Attribute attr = db.get_attribute(*it);
+
+                if (attr != Attribute::invalid) {
+                    add_column(attr);
+                    it = m_col_attr_names.erase(it);
+                } else
+                    ++it;
+            }
+        }
+    }
+
+    uint32_t intern(Column& col, const std::string& str) {
+        auto it = col.dict_ids.find(str);
+
+        if (it != col.dict_ids.end())
+            return it->second;
+
+        uint32_t id = static_cast<uint32_t>(col.dict.size());
+
+        col.dict.push_back(str);
+        col.dict_ids.insert(std::make_pair(str, id));
+
+        return id;
+    }
+
+    void add(CaliperMetadataAccessInterface& db, const EntryList& list) {
+        std::lock_guard<std::mutex>
+            g(m_lock);
+
+        update_columns(db, list);
+
+        size_t row = m_num_rows++;
+
+        for (Column& col : m_cols) {
+            bool     valid = false;
+            uint64_t value = 0;
+            uint32_t index = 0;
+
+            if (col.dictionary) {
+                std::string val;
+
+                for (const Entry& e : list) {
+                    if (e.node()) {
+                        for (const Node* node = e.node(); node; node = node->parent())
+                            if (node->attribute() == col.attr.id())
+                                val = node->data().to_string().append(val.empty() ? "" : "/").append(val);
+                    } else if (e.attribute() == col.attr.id())
+                        val = e.value().to_string();
+                }
+
+                if (!val.empty()) {
+                    valid = true;
+                    index = intern(col, val);
+                }
+            } else {
+                Variant v;
+
+                for (const Entry& e : list) {
+                    if (e.node()) {
+                        // take the value closest to the leaf
+                        for (const Node* node = e.node(); node; node = node->parent())
+                            if (node->attribute() == col.attr.id()) {
+                                v = node->data();
+                                break;
+                            }
+                    } else if (e.attribute() == col.attr.id())
+                        v = e.value();
+
+                    if (!v.empty())
+                        break;
+                }
+
+                if (!v.empty()) {
+                    valid = true;
+
+                    switch (col.attr.type()) {
+                    case CALI_TYPE_DOUBLE:
+                        {
+                            double d = v.to_double();
+                            memcpy(&value, &d, sizeof(double));
+                        }
+                        break;
+                    case CALI_TYPE_INT:
+                        {
+                            int64_t i = v.to_int();
+                            memcpy(&value, &i, sizeof(int64_t));
+                        }
+                        break;
+                    default:
+                        value = v.to_uint();
+                    }
+                }
+            }
+
+            col.validity.resize(row / 8 + 1, 0);
+
+            if (valid)
+                col.validity[row / 8] |= (1 << (row % 8));
+
+            if (col.dictionary)
+                col.indices.push_back(index);
+            else
+                col.values.push_back(value);
+        }
+    }
+
+    void write(std::ostream& os) {
+        os.write("CALICOL1", 8);
+
+        put_u64(os, m_cols.size());
+        put_u64(os, m_num_rows);
+
+        for (Column& col : m_cols) {
+            std::string name = col.attr.name();
+
+            put_u32(os, static_cast<uint32_t>(name.size()));
+            os.write(name.data(), name.size());
+            pad8(os, 4 + name.size());
+
+            put_u32(os, static_cast<uint32_t>(col.attr.type()));
+            put_u32(os, col.dictionary ? 1 : 0);
+
+            // columns created before the last row may be short
+
+            col.validity.resize((m_num_rows + 7) / 8, 0);
+
+            os.write(reinterpret_cast<char*>(col.validity.data()), col.validity.size());
+            pad8(os, col.validity.size());
+
+            if (col.dictionary) {
+                col.indices.resize(m_num_rows, 0);
+
+                for (uint32_t index : col.indices)
+                    put_u32(os, index);
+                pad8(os, 4 * col.indices.size());
+
+                put_u32(os, static_cast<uint32_t>(col.dict.size()));
+
+                uint32_t offset = 0;
+
+                for (const std::string& str : col.dict) {
+                    put_u32(os, offset);
+                    offset += str.size();
+                }
+                put_u32(os, offset);
+                pad8(os, 4 * (col.dict.size() + 2));
+
+                for (const std::string& str : col.dict)
+                    os.write(str.data(), str.size());
+                pad8(os, offset);
+            } else {
+                col.values.resize(m_num_rows, 0);
+
+                for (uint64_t value : col.values)
+                    put_u64(os, value);
+            }
+        }
+
+        os.flush();
+    }
+};
+
+
+ColumnarFormatter::ColumnarFormatter(const QuerySpec& spec)
+    : mP { new ColumnarFormatterImpl }
+{
+    mP->configure(spec);
+}
+
+ColumnarFormatter::~ColumnarFormatter()
+{
+    mP.reset();
+}
+
+void
+ColumnarFormatter::process_record(CaliperMetadataAccessInterface& db, const EntryList& list)
+{
+    mP->add(db, list);
+}
+
+void
+ColumnarFormatter::flush(CaliperMetadataAccessInterface&, std::ostream& os)
+{
+    mP->write(os);
+}
@@ -47,6 +47,7 @@
 #include <algorithm>
 #include <functional>
 #include <iterator>
+#include <map>
 #include <mutex>
 #include <set>
 #include <sstream>
@@ -59,6 +60,11 @@ struct Expand::ExpandImpl
     set<string> m_selected;
     set<string> m_deselected;
 
+    // Memoizes the projection decision per attribute id, so non-projected
+    // entries are dismissed without resolving the attribute name
+    map<cali_id_t, bool> m_select_cache;
+    std::mutex           m_cache_lock;
+
     ostream&    m_os;
 
     std::mutex  m_os_lock;
@@ -100,6 +106,28 @@ struct Expand::ExpandImpl
         }
     }
     
+    bool is_selected(CaliperMetadataAccessInterface& db, cali_id_t attr_id) {
+        {
+            std::lock_guard<std::mutex>
+                g(m_cache_lock);
+
+            auto it = m_select_cache.find(attr_id);
+
+            if (it != m_select_cache.end())
+                return it->second;
+        }
+
+        string name = db.get_attribute(attr_id).name();
+        bool   ret  = !((!m_selected.empty() && m_selected.count(name) == 0) || m_deselected.count(name));
+
+        std::lock_guard<std::mutex>
+            g(m_cache_lock);
+
+        m_select_cache.insert(make_pair(attr_id, ret));
+
+        return ret;
+    }
+
     void print(CaliperMetadataAccessInterface& db, const EntryList& list) {
         int nentry = 0;
 
@@ -109,14 +137,9 @@ struct Expand::ExpandImpl
             if (e.node()) {
                 vector<const Node*> nodes;
 
-                for (const Node* node = e.node(); node && node->attribute() != CALI_INV_ID; node = node->parent()) {
-                    string name = db.get_attribute(node->attribute()).name();
-
-                    if ((!m_selected.empty() && m_selected.count(name) == 0) || m_deselected.count(name))
-                        continue;
-
-                    nodes.push_back(node);
-                }
+                for (const Node* node = e.node(); node && node->attribute() != CALI_INV_ID; node = node->parent())
+                    if (is_selected(db, node->attribute()))
+                        nodes.push_back(node);
 
                 if (nodes.empty())
                     continue;
@@ -135,12 +158,10 @@ struct Expand::ExpandImpl
                     os << (*it)->data().to_string();
                 }
             } else if (e.attribute() != CALI_INV_ID) {
-                string name = db.get_attribute(e.attribute()).name();
-
-                if ((!m_selected.empty() && m_selected.count(name) == 0) || m_deselected.count(name))
+                if (!is_selected(db, e.attribute()))
                     continue;
 
-                os << (nentry++ ? "," : "") << name << '=' << e.value();
+                os << (nentry++ ? "," : "") << db.get_attribute(e.attribute()).name() << '=' << e.value();
             }
         }
         
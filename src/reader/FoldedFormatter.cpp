@@ -0,0 +1,236 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/// \file FoldedFormatter.cpp
+/// Print records as folded call stacks
+
+#include "caliper/reader/FoldedFormatter.h"
+
+#include "caliper/reader/QuerySpec.h"
+
+#include "caliper/common/Attribute.h"
+#include "caliper/common/CaliperMetadataAccessInterface.h"
+#include "caliper/common/Node.h"
+
+#include "caliper/common/util/split.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+using namespace cali;
+
+struct FoldedFormatter::FoldedImpl
+{
+    std::ostream&            m_os;
+    std::mutex               m_os_lock;
+
+    std::string              m_separator       { ";" };
+    std::string              m_count_attr_name { "aggregate.count" };
+
+    std::vector<std::string> m_path_key_names;
+    std::vector<Attribute>   m_path_keys;
+
+    std::mutex               m_path_key_lock;
+
+    FoldedImpl(std::ostream& os)
+        : m_os(os)
+        { }
+
+    void configure(const QuerySpec& spec) {
+        // spec.format.args: path-attributes, separator, count-attribute
+
+        if (spec.format.args.size() > 0)
+            util::split(spec.format.args[0], ',',
+                        std::back_inserter(m_path_key_names));
+        if (spec.format.args.size() > 1 && !spec.format.args[1].empty())
+            m_separator = spec.format.args[1];
+        if (spec.format.args.size() > 2 && !spec.format.args[2].empty())
+            m_count_attr_name = spec.format.args[2];
+
+        m_path_keys.assign(m_path_key_names.size(), Attribute::invalid);
+    }
+
+    std::vector<Attribute> get_path_keys(const CaliperMetadataAccessInterface& db) {
+        std::vector<Attribute> path_keys;
+
+        {
+            std::lock_guard<std::mutex>
+                g(m_path_key_lock);
+
+            path_keys = m_path_keys;
+        }
+
+        for (std::vector<Attribute>::size_type i = 0; i < path_keys.size(); ++i)
+            if (path_keys[i] == Attribute::invalid) {
+                Attribute attr = db.get_attribute(m_path_key_names[i]);
+
+                if (attr != Attribute::invalid) {
+                    path_keys[i]   = attr;
+                    std::lock_guard<std::mutex>
+                        g(m_path_key_lock);
+                    m_path_keys[i] = attr;
+                }
+            }
+
+        return path_keys;
+    }
+
+    void process(CaliperMetadataAccessInterface& db, const EntryList& list) {
+        //
+        // find path entries (leaf-to-root order)
+        //
+
+        std::vector<const Node*> path;
+
+        // A record's entries can resolve overlapping node chains (e.g.,
+        // an event meta entry and the region entry it refers to), so
+        // only add each node once.
+
+        auto add_node = [&path](const Node* node) {
+            if (std::find(path.begin(), path.end(), node) == path.end())
+                path.push_back(node);
+        };
+
+        if (m_path_key_names.empty()) {
+            for (const Entry& e : list)
+                for (const Node* node = e.node(); node && node->attribute() != CALI_INV_ID; node = node->parent()) {
+                    Attribute attr = db.get_attribute(node->attribute());
+
+                    if (!attr.is_nested())
+                        continue;
+
+                    // skip internal "cali." and "event." attributes:
+                    // event meta attributes inherit the nested flag
+                    // from their base attribute
+                    std::string name = attr.name();
+
+                    if (name.compare(0, 5, "cali." ) == 0 ||
+                        name.compare(0, 6, "event.") == 0)
+                        continue;
+
+                    add_node(node);
+                }
+        } else {
+            auto path_keys = get_path_keys(db);
+
+            for (const Entry& e : list)
+                for (const Node* node = e.node(); node && node->attribute() != CALI_INV_ID; node = node->parent())
+                    if (std::find_if(path_keys.begin(), path_keys.end(),
+                                     [node](const Attribute& a) {
+                                         return a.id() == node->attribute();
+                                     }) != path_keys.end())
+                        add_node(node);
+        }
+
+        if (path.empty())
+            return;
+
+        // Sort path entries root-to-leaf by their depth in the context
+        // tree. The parent chain is authoritative for nesting order:
+        // attribute ids are not, since begin and end event records
+        // resolve the same region through different attributes. Needed
+        // for aggregated records, where the key node order does not
+        // reflect the nesting.
+
+        auto depth = [](const Node* node) {
+            int d = 0;
+            for (const Node* p = node->parent(); p && p->attribute() != CALI_INV_ID; p = p->parent())
+                ++d;
+            return d;
+        };
+
+        std::stable_sort(path.begin(), path.end(),
+                         [&depth](const Node* a, const Node* b) {
+                             return depth(a) < depth(b);
+                         });
+
+        //
+        // write "a;b;c count" line
+        //
+
+        std::string line;
+
+        for (auto it = path.begin(); it != path.end(); ++it) {
+            if (it != path.begin())
+                line.append(m_separator);
+
+            line.append((*it)->data().to_string());
+        }
+
+        line.push_back(' ');
+
+        Attribute count_attr = db.get_attribute(m_count_attr_name);
+        Variant   v_count;
+
+        if (count_attr != Attribute::invalid)
+            for (const Entry& e : list)
+                if (e.attribute() == count_attr.id())
+                    v_count = e.value();
+
+        line.append(v_count.empty() ? "1" : v_count.to_string());
+        line.push_back('\n');
+
+        {
+            std::lock_guard<std::mutex>
+                g(m_os_lock);
+
+            m_os << line;
+        }
+    }
+};
+
+
+FoldedFormatter::FoldedFormatter(std::ostream& os, const QuerySpec& spec)
+    : mP { new FoldedImpl(os) }
+{
+    mP->configure(spec);
+}
+
+FoldedFormatter::~FoldedFormatter()
+{
+    mP.reset();
+}
+
+void
+FoldedFormatter::process_record(CaliperMetadataAccessInterface& db, const EntryList& list)
+{
+    mP->process(db, list);
+}
+
+void
+FoldedFormatter::flush(CaliperMetadataAccessInterface&, std::ostream&)
+{
+    // nothing to do: records are written as they arrive
+}
@@ -32,7 +32,9 @@
 
 #include "caliper/reader/FormatProcessor.h"
 
+#include "caliper/reader/ColumnarFormatter.h"
 #include "caliper/reader/Expand.h"
+#include "caliper/reader/FoldedFormatter.h"
 #include "caliper/reader/JsonFormatter.h"
 #include "caliper/reader/TableFormatter.h"
 #include "caliper/reader/TreeFormatter.h"
@@ -48,7 +50,9 @@ namespace
 {
 
 const char* format_kernel_args[] = { "format", "title" };
-const char* tree_kernel_args[]   = { "path-attributes" }; 
+const char* table_kernel_args[]  = { "stream" };
+const char* tree_kernel_args[]   = { "path-attributes" };
+const char* folded_kernel_args[] = { "path-attributes", "separator", "count-attribute" };
 
 enum FormatterID {
     Csv    = 0,
@@ -56,7 +60,9 @@ enum FormatterID {
     Expand = 2,
     Format = 3,
     Table  = 4,
-    Tree   = 5
+    Tree   = 5,
+    Folded = 6,
+    Columnar = 7
 };
 
 const QuerySpec::FunctionSignature formatters[] = {
@@ -64,9 +70,11 @@ const QuerySpec::FunctionSignature formatters[] = {
     { FormatterID::Json,   "json",   0, 0, nullptr },
     { FormatterID::Expand, "expand", 0, 0, nullptr },
     { FormatterID::Format, "format", 1, 2, format_kernel_args },
-    { FormatterID::Table,  "table",  0, 0, nullptr },
+    { FormatterID::Table,  "table",  0, 1, table_kernel_args  },
     { FormatterID::Tree,   "tree",   0, 1, tree_kernel_args   },
-    
+    { FormatterID::Folded, "folded", 0, 3, folded_kernel_args },
+    { FormatterID::Columnar, "columnar", 0, 0, nullptr },
+
     QuerySpec::FunctionSignatureTerminator
 };
 
@@ -83,6 +91,12 @@ public:
     void process_record(CaliperMetadataAccessInterface& db, const EntryList& list) {
         m_writer(db, list);
     }
+
+    void flush(CaliperMetadataAccessInterface&, std::ostream&) {
+        // drain buffered chunks: output must be complete after
+        // FormatProcessor::flush(), not only at destruction
+        m_writer.flush();
+    }
 };
 
 }
@@ -110,11 +124,17 @@ struct FormatProcessor::FormatProcessorImpl
                 m_formatter = new UserFormatter(m_os, spec);
                 break;
             case FormatterID::Table:
-                m_formatter = new TableFormatter(spec);
+                m_formatter = new TableFormatter(m_os, spec);
                 break;
             case FormatterID::Tree:
                 m_formatter = new TreeFormatter(spec);
                 break;
+            case FormatterID::Folded:
+                m_formatter = new FoldedFormatter(m_os, spec);
+                break;
+            case FormatterID::Columnar:
+                m_formatter = new ColumnarFormatter(spec);
+                break;
             }
         }
     }
@@ -53,9 +53,11 @@ using namespace cali;
 struct JsonFormatter::JsonFormatterImpl
 {
     std::vector<std::string>                m_col_attr_names;
-    std::vector<Attribute>                  m_cols;    
+    std::vector<Attribute>                  m_cols;
 
-    std::vector< std::vector<std::string> > m_rows;
+    // Each element holds one fully serialized row (the comma-separated
+    // cell list), so no per-cell strings are retained until flush
+    std::vector<std::string>                m_rows;
 
     std::mutex m_col_lock;
     std::mutex m_row_lock;
@@ -147,12 +149,30 @@ struct JsonFormatter::JsonFormatterImpl
         return m_cols;
     }
     
+    // Append \a str to \a buf as a quoted JSON string literal
+    static void append_json_string(std::string& buf, const std::string& str) {
+        buf.push_back('"');
+
+        for (char c : str) {
+            if (c == '"' || c == '\\')
+                buf.push_back('\\');
+
+            buf.push_back(c);
+        }
+
+        buf.push_back('"');
+    }
+
     void add(CaliperMetadataAccessInterface& db, const EntryList& list) {
-        std::vector<Attribute>   col(update_columns(db, list));
-        std::vector<std::string> row(col.size());
+        std::vector<Attribute> col(update_columns(db, list));
+
+        // Serialize the record's cells directly into a single row buffer
+
+        std::string row;
+        row.reserve(16 * col.size());
 
         bool active = false;
-        
+
         for (std::vector<Attribute>::size_type c = 0; c < col.size(); ++c) {
             if (col[c] == Attribute::invalid)
                 continue;
@@ -170,37 +190,37 @@ struct JsonFormatter::JsonFormatterImpl
                 }
             }
 
-            if (!val.empty()) {
+            if (!val.empty())
                 active = true;
-                row[c] = val;
-            }
+
+            append_json_string(row, val);
+            row.push_back(',');
         }
 
         if (active) {
             std::lock_guard<std::mutex>
                 g(m_row_lock);
-            
+
             m_rows.push_back(std::move(row));
         }
     }
 
-    void flush(std::ostream& os) {            
+    void flush(std::ostream& os) {
         // print header
         os << "{ \"attributes\" : [" ;
-        for (const Attribute& col : m_cols)
-            os << "\"" << col.name() <<"\",";
+        for (const Attribute& col : m_cols) {
+            std::string name;
+            append_json_string(name, col.name());
+            os << name << ",";
+        }
 
         os << "\b ], "<< std::endl<<" \"rows\" : [ ";
 
         // print rows
 
-        for (auto row : m_rows) {
-            os << " [ " ;
-            for (std::vector<std::string>::size_type c = 0; c < row.size(); ++c) {
-                    os << "\"" << row[c] << "\",";
-            }
-            os<< "\b ]," ;
-        }        
+        for (const std::string& row : m_rows)
+            os << " [ " << row << "\b ]," ;
+
         os << "\b]}" << std::endl;
     }
 };
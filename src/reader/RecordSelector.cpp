@@ -40,8 +40,11 @@
 #include "caliper/common/CaliperMetadataAccessInterface.h"
 #include "caliper/common/Node.h"
 
+#include "caliper/common/csv/CsvIndex.h"
+
 #include "caliper/common/util/split.hpp"
 
+#include <atomic>
 #include <iostream>
 #include <iterator>
 #include <mutex>
@@ -55,12 +58,12 @@ QuerySpec::Condition
 parse_clause(const std::string& str)
 {
     QuerySpec::Condition clause { QuerySpec::Condition::None, "", "" };
-    
-    // parse "[-]attribute[(<>=)value]" string
+
+    // parse "[-]attribute[(<|>|<=|>=|=)value]" string
 
     if (str.empty())
         return clause;
-        
+
     std::string::size_type spos = 0;
     bool negate = false;
 
@@ -74,33 +77,55 @@ parse_clause(const std::string& str)
     clause.attr_name.assign(str, spos, opos < std::string::npos ? opos-spos : opos);
 
     if (opos < str.size()-1) {
-        clause.value.assign(str, opos+1, std::string::npos);
-
-        struct ops_t { char c; QuerySpec::Condition::Op op; } const ops[] = {
-            // { '<', Op::Less     }, { '>', Op::Greater  },
-            { '=', QuerySpec::Condition::Op::Equal },
-            { 0,   QuerySpec::Condition::Op::Exist }
-        };
+        std::string::size_type vpos = opos + 1;
+
+        QuerySpec::Condition::Op op = QuerySpec::Condition::Op::None;
+
+        switch (str[opos]) {
+        case '=':
+            op = QuerySpec::Condition::Op::Equal;
+            break;
+        case '<':
+            if (str[vpos] == '=' && vpos < str.size()-1) {
+                op = QuerySpec::Condition::Op::LessOrEqual;
+                ++vpos;
+            } else
+                op = QuerySpec::Condition::Op::LessThan;
+            break;
+        case '>':
+            if (str[vpos] == '=' && vpos < str.size()-1) {
+                op = QuerySpec::Condition::Op::GreaterOrEqual;
+                ++vpos;
+            } else
+                op = QuerySpec::Condition::Op::GreaterThan;
+            break;
+        }
 
-        int i;
-        for (i = 0; ops[i].c && ops[i].c != str[opos]; ++i)
-            ;
+        clause.value.assign(str, vpos, std::string::npos);
 
         if (negate) {
-            switch (ops[i].op) {
-            case QuerySpec::Condition::Op::Exist:
-                clause.op = QuerySpec::Condition::Op::NotExist;
-                break;
+            switch (op) {
             case QuerySpec::Condition::Op::Equal:
-                clause.op = QuerySpec::Condition::Op::NotEqual;
+                op = QuerySpec::Condition::Op::NotEqual;
+                break;
+            case QuerySpec::Condition::Op::LessThan:
+                op = QuerySpec::Condition::Op::GreaterOrEqual;
+                break;
+            case QuerySpec::Condition::Op::GreaterThan:
+                op = QuerySpec::Condition::Op::LessOrEqual;
+                break;
+            case QuerySpec::Condition::Op::LessOrEqual:
+                op = QuerySpec::Condition::Op::GreaterThan;
+                break;
+            case QuerySpec::Condition::Op::GreaterOrEqual:
+                op = QuerySpec::Condition::Op::LessThan;
                 break;
             default:
-                // TODO: Handle remaining conditions
-                clause.op = QuerySpec::Condition::Op::None;
+                op = QuerySpec::Condition::Op::None;
             }
-        } else {
-            clause.op = ops[i].op;
         }
+
+        clause.op = op;
     } else {
         clause.op = (negate ? QuerySpec::Condition::Op::NotExist : QuerySpec::Condition::Op::Exist);
     }
@@ -111,36 +136,193 @@ parse_clause(const std::string& str)
     return clause;
 }
 
+template<class T>
+inline bool apply_op(QuerySpec::Condition::Op op, T lhs, T rhs)
+{
+    switch (op) {
+    case QuerySpec::Condition::Op::Equal:
+        return lhs == rhs;
+    case QuerySpec::Condition::Op::LessThan:
+        return lhs <  rhs;
+    case QuerySpec::Condition::Op::GreaterThan:
+        return lhs >  rhs;
+    case QuerySpec::Condition::Op::LessOrEqual:
+        return lhs <= rhs;
+    case QuerySpec::Condition::Op::GreaterOrEqual:
+        return lhs >= rhs;
+    default:
+        return false;
+    }
+}
+
 }
 
 using namespace cali;
 
 struct RecordSelector::RecordSelectorImpl
 {
-    std::vector<QuerySpec::Condition> m_filters;    
+    std::vector<QuerySpec::Condition> m_filters;
+
+    // Compiled filter clauses: the attribute name is resolved to its
+    // id and the comparison value converted to a typed Variant once,
+    // so per-record evaluation does no attribute lookups or string
+    // conversions. A clause stays unresolved until its attribute
+    // appears in the metadata db; clause i compiles m_filters[i].
 
     struct Clause {
         QuerySpec::Condition::Op op;
-        Attribute attr;
+        cali_id_t attr_id;
         Variant   value;
-    };    
+        bool      resolved;
+        bool      is_ref;    // clause attribute is a reference (tree) attribute
+
+        // Typed fast path for numeric attributes: the target value is
+        // stored unboxed and compared against the entry's raw packed
+        // Variant payload, without per-record conversion
+        enum CmpType { CmpNone, CmpInt, CmpUint, CmpDouble } cmp_type;
+        union {
+            int64_t  i;
+            uint64_t u;
+            double   d;
+        } target;
+    };
+
+    std::vector<Clause> m_clauses;
+    std::atomic<int>    m_num_unresolved;
+    std::mutex          m_clause_lock;
+
+    // --- Matching-node set
+    //
+    // Planning step: clauses on reference (tree) attributes are
+    // evaluated against a precomputed matching-node set. For each
+    // context tree node we cache a bitmask of the reference clauses
+    // whose pattern occurs on the node's path, so record evaluation
+    // is one array load per node entry instead of an ancestor walk
+    // per clause, and non-matching records are rejected before any
+    // entry is examined further. Clauses on immediate (ASVALUE)
+    // attributes are evaluated per entry as before.
+
+    static const size_t MAX_REF_CLAUSES = 64; // bits in the node mask
+
+    std::vector<uint64_t>      m_node_mask;  // clause match bitmask, indexed by node id
+    std::vector<unsigned char> m_node_known; // mask computed for this node id?
+
+    uint64_t node_mask(const Node* node) {
+        cali_id_t id = node->id();
+
+        if (id == CALI_INV_ID)
+            return 0;
+        if (id < m_node_known.size() && m_node_known[id])
+            return m_node_mask[id];
+
+        const Node* parent = node->parent();
+
+        uint64_t mask = parent ? node_mask(parent) : 0;
+
+        for (size_t i = 0; i < m_clauses.size() && i < MAX_REF_CLAUSES; ++i) {
+            const Clause& clause = m_clauses[i];
+
+            if (!clause.resolved || !clause.is_ref || node->attribute() != clause.attr_id)
+                continue;
+
+            switch (clause.op) {
+            case QuerySpec::Condition::Op::Exist:
+            case QuerySpec::Condition::Op::NotExist:
+                mask |= 1ull << i;
+                break;
+            case QuerySpec::Condition::Op::Equal:
+            case QuerySpec::Condition::Op::NotEqual:
+                if (node->data() == clause.value)
+                    mask |= 1ull << i;
+                break;
+            case QuerySpec::Condition::Op::LessThan:
+            case QuerySpec::Condition::Op::GreaterThan:
+            case QuerySpec::Condition::Op::LessOrEqual:
+            case QuerySpec::Condition::Op::GreaterOrEqual:
+                if (compare(clause, clause.op, node->data()))
+                    mask |= 1ull << i;
+                break;
+            default:
+                ;
+            }
+        }
+
+        if (id >= m_node_known.size()) {
+            m_node_mask.resize(id + 1, 0);
+            m_node_known.resize(id + 1, 0);
+        }
+
+        m_node_mask[id]  = mask;
+        m_node_known[id] = 1;
+
+        return mask;
+    }
 
     void configure(const QuerySpec& spec) {
         m_filters.clear();
-        
+
         if (spec.filter.selection == QuerySpec::FilterSelection::List)
             m_filters = spec.filter.list;
+
+        compile_clauses();
     }
 
-    Clause make_clause(const CaliperMetadataAccessInterface& db, const QuerySpec::Condition& f) {
-        Clause clause { f.op, Attribute::invalid, Variant() };
+    void compile_clauses() {
+        m_clauses.clear();
 
-        clause.attr = db.get_attribute(f.attr_name);
+        for (const QuerySpec::Condition& f : m_filters)
+            m_clauses.push_back(Clause { f.op, CALI_INV_ID, Variant(), false, false, Clause::CmpNone, { 0 } });
 
-        if (clause.attr != Attribute::invalid)
-            clause.value = Variant::from_string(clause.attr.type(), f.value.c_str(), nullptr);
-        
-        return clause;
+        m_num_unresolved.store(static_cast<int>(m_clauses.size()));
+    }
+
+    void resolve_clauses(const CaliperMetadataAccessInterface& db) {
+        std::lock_guard<std::mutex>
+            g(m_clause_lock);
+
+        int num_unresolved = 0;
+
+        for (std::vector<Clause>::size_type i = 0; i < m_clauses.size(); ++i) {
+            if (m_clauses[i].resolved)
+                continue;
+
+            Attribute attr = db.get_attribute(m_filters[i].attr_name);
+
+            if (attr == Attribute::invalid) {
+                ++num_unresolved;
+                continue;
+            }
+
+            m_clauses[i].attr_id  = attr.id();
+            // NOTE: string Variants reference the m_filters entry's buffer
+            m_clauses[i].value    = Variant::from_string(attr.type(), m_filters[i].value.c_str(), nullptr);
+            m_clauses[i].resolved = true;
+            m_clauses[i].is_ref   = !attr.store_as_value();
+
+            // unbox the target for the typed comparison path
+            switch (attr.type()) {
+            case CALI_TYPE_INT:
+                m_clauses[i].cmp_type = Clause::CmpInt;
+                m_clauses[i].target.i = m_clauses[i].value.c_variant().value.v_int;
+                break;
+            case CALI_TYPE_UINT:
+                m_clauses[i].cmp_type = Clause::CmpUint;
+                m_clauses[i].target.u = m_clauses[i].value.c_variant().value.v_uint;
+                break;
+            case CALI_TYPE_DOUBLE:
+                m_clauses[i].cmp_type = Clause::CmpDouble;
+                m_clauses[i].target.d = m_clauses[i].value.c_variant().value.v_double;
+                break;
+            default:
+                m_clauses[i].cmp_type = Clause::CmpNone;
+            }
+
+            // cached node masks miss the newly resolved clause
+            m_node_mask.clear();
+            m_node_known.clear();
+        }
+
+        m_num_unresolved.store(num_unresolved, std::memory_order_release);
     }
 
     template<class Op>
@@ -154,21 +336,111 @@ struct RecordSelector::RecordSelectorImpl
         } else if  (match(entry.attribute(), entry.value()))
             return true;
 
-        return false;        
+        return false;
+    }
+
+    // Evaluate relation \a op between entry value \a val and the
+    // clause target. Numeric attributes compare the raw packed
+    // Variant payload against the unboxed target; other types fall
+    // back to Variant comparison.
+    static inline bool compare(const Clause& clause, QuerySpec::Condition::Op op, const Variant& val) {
+        switch (clause.cmp_type) {
+        case Clause::CmpInt:
+            if (val.type() == CALI_TYPE_INT)
+                return apply_op<int64_t>(op, val.c_variant().value.v_int, clause.target.i);
+            break;
+        case Clause::CmpUint:
+            if (val.type() == CALI_TYPE_UINT)
+                return apply_op<uint64_t>(op, val.c_variant().value.v_uint, clause.target.u);
+            break;
+        case Clause::CmpDouble:
+            if (val.type() == CALI_TYPE_DOUBLE)
+                return apply_op<double>(op, val.c_variant().value.v_double, clause.target.d);
+            break;
+        default:
+            break;
+        }
+
+        switch (op) {
+        case QuerySpec::Condition::Op::Equal:
+            return val == clause.value;
+        case QuerySpec::Condition::Op::LessThan:
+            return val < clause.value;
+        case QuerySpec::Condition::Op::GreaterThan:
+            return clause.value < val;
+        case QuerySpec::Condition::Op::LessOrEqual:
+            return !(clause.value < val);
+        case QuerySpec::Condition::Op::GreaterOrEqual:
+            return !(val < clause.value);
+        default:
+            return false;
+        }
     }
 
     bool pass(const CaliperMetadataAccessInterface& db, const EntryList& list) {
-        for (auto &f : m_filters) {
-            Clause clause = make_clause(db, f);
+        if (m_num_unresolved.load(std::memory_order_acquire) > 0)
+            resolve_clauses(db);
+
+        // evaluate reference-attribute clauses on the matching-node set
+
+        uint64_t ref_clauses = 0;
+
+        for (size_t i = 0; i < m_clauses.size() && i < MAX_REF_CLAUSES; ++i)
+            if (m_clauses[i].resolved && m_clauses[i].is_ref)
+                ref_clauses |= 1ull << i;
+
+        if (ref_clauses) {
+            uint64_t found = 0;
+
+            for (const Entry& e : list)
+                if (e.node())
+                    found |= node_mask(e.node());
+
+            for (size_t i = 0; i < m_clauses.size() && i < MAX_REF_CLAUSES; ++i) {
+                uint64_t bit = 1ull << i;
+
+                if (!(ref_clauses & bit))
+                    continue;
+
+                switch (m_clauses[i].op) {
+                case QuerySpec::Condition::Op::Exist:
+                case QuerySpec::Condition::Op::Equal:
+                case QuerySpec::Condition::Op::LessThan:
+                case QuerySpec::Condition::Op::GreaterThan:
+                case QuerySpec::Condition::Op::LessOrEqual:
+                case QuerySpec::Condition::Op::GreaterOrEqual:
+                    if (!(found & bit))
+                        return false;
+                    break;
+                case QuerySpec::Condition::Op::NotExist:
+                case QuerySpec::Condition::Op::NotEqual:
+                    if (found & bit)
+                        return false;
+                    break;
+                default:
+                    ;
+                }
+            }
+        }
+
+        // evaluate the remaining clauses per entry
+
+        size_t clause_idx = 0;
+
+        for (const Clause& clause : m_clauses) {
+            size_t i = clause_idx++;
+
+            if (i < MAX_REF_CLAUSES && (ref_clauses & (1ull << i)))
+                continue;
 
             switch (clause.op) {
             case QuerySpec::Condition::Op::Exist:
                 {
                     bool m = false;
-                    
+
                     for (const Entry& e : list)
                         if (have_match(e, [&clause](cali_id_t attr_id, const Variant&){
-                                    return attr_id == clause.attr.id();
+                                    return attr_id == clause.attr_id;
                                 }))
                             m = true;
 
@@ -179,17 +451,21 @@ struct RecordSelector::RecordSelectorImpl
             case QuerySpec::Condition::Op::NotExist:
                 for (const Entry& e : list)
                     if (have_match(e, [&clause](cali_id_t attr_id, const Variant&){
-                                return attr_id == clause.attr.id();
+                                return attr_id == clause.attr_id;
                             }))
                         return false;
-                break;                
+                break;
             case QuerySpec::Condition::Op::Equal:
+            case QuerySpec::Condition::Op::LessThan:
+            case QuerySpec::Condition::Op::GreaterThan:
+            case QuerySpec::Condition::Op::LessOrEqual:
+            case QuerySpec::Condition::Op::GreaterOrEqual:
                 {
                     bool m = false;
-                    
+
                     for (const Entry& e : list)
                         if (have_match(e, [&clause](cali_id_t attr_id, const Variant& val){
-                                    return attr_id == clause.attr.id() && val == clause.value;
+                                    return attr_id == clause.attr_id && compare(clause, clause.op, val);
                                 }))
                             m = true;
 
@@ -198,17 +474,55 @@ struct RecordSelector::RecordSelectorImpl
                 }
                 break;
             case QuerySpec::Condition::Op::NotEqual:
+                // reject the record if a matching entry exists
                 for (const Entry& e : list)
                     if (have_match(e, [&clause](cali_id_t attr_id, const Variant& val){
-                                return attr_id == clause.attr.id() && val == clause.value;
+                                return attr_id == clause.attr_id
+                                    && compare(clause, QuerySpec::Condition::Op::Equal, val);
                             }))
                         return false;
                 break;
-            }   
+            }
         }
 
         return true;
     }
+
+    bool pass_block(const RecordMap& idx_rec) const {
+        auto b_it = idx_rec.find("bloom");
+
+        if (b_it == idx_rec.end() || b_it->second.empty())
+            return true;
+
+        uint64_t bloom[csvindex::bloom_words];
+
+        if (!csvindex::bloom_from_hex(b_it->second.front(), bloom))
+            return true;
+
+        // Records pass only if all conditions hold. A positive
+        // condition (Exist, Equal, or an ordered comparison) on an
+        // attribute that does not occur in the block thus rules out
+        // every record in it. Negated conditions can't prune: the
+        // bloom filter can show absence, not presence in every
+        // record.
+
+        for (const QuerySpec::Condition& f : m_filters)
+            switch (f.op) {
+            case QuerySpec::Condition::Op::Exist:
+            case QuerySpec::Condition::Op::Equal:
+            case QuerySpec::Condition::Op::LessThan:
+            case QuerySpec::Condition::Op::GreaterThan:
+            case QuerySpec::Condition::Op::LessOrEqual:
+            case QuerySpec::Condition::Op::GreaterOrEqual:
+                if (!csvindex::bloom_test(bloom, f.attr_name.data(), f.attr_name.size()))
+                    return false;
+                break;
+            default:
+                ;
+            }
+
+        return true;
+    }
 }; // RecordSelectorImpl
 
 
@@ -216,6 +530,7 @@ RecordSelector::RecordSelector(const std::string& filter_string)
     : mP { new RecordSelectorImpl }
 {
     mP->m_filters = parse(filter_string);
+    mP->compile_clauses();
 }
 
 RecordSelector::RecordSelector(const QuerySpec& spec)
@@ -235,6 +550,12 @@ RecordSelector::pass(const CaliperMetadataAccessInterface& db, const EntryList&
     return mP->pass(db, list);
 }
 
+bool
+RecordSelector::pass_block(const RecordMap& idx_rec) const
+{
+    return mP->pass_block(idx_rec);
+}
+
 void 
 RecordSelector::operator()(CaliperMetadataAccessInterface& db, const EntryList& list, SnapshotProcessFn push) const
 {
@@ -38,7 +38,9 @@
 #include "caliper/common/CaliperMetadataAccessInterface.h"
 #include "caliper/common/Node.h"
 
+#include <algorithm>
 #include <cassert>
+#include <type_traits>
 #include <vector>
 
 using namespace cali;
@@ -46,30 +48,53 @@ using namespace cali;
 
 struct SnapshotTree::SnapshotTreeImpl
 {
-    SnapshotTreeNode* m_root;
+    //
+    // --- Node arena
+    //
+    // Tree nodes all live until the tree is destroyed, so we create
+    // them in fixed-size arena chunks instead of allocating each node
+    // individually.
+    //
 
-    void recursive_delete(SnapshotTreeNode* node) {
-        if (node) {
-            node = node->first_child();
+    static const size_t chunksize = 256;
 
-            while (node) {
-                ::SnapshotTreeNode* tmp = node->next_sibling();
+    typedef std::aligned_storage<sizeof(SnapshotTreeNode), alignof(SnapshotTreeNode)>::type NodeStorage;
 
-                recursive_delete(node);
+    std::vector<NodeStorage*> m_chunks;
+    size_t                    m_used;    // occupied slots in the last chunk
 
-                delete node;
-                node = tmp;
-            }
+    SnapshotTreeNode* make_node(const Attribute& label_key, const Variant& label_val, bool empty) {
+        if (m_chunks.empty() || m_used == chunksize) {
+            m_chunks.push_back(new NodeStorage[chunksize]);
+            m_used = 0;
         }
+
+        return new(m_chunks.back() + m_used++) SnapshotTreeNode(label_key, label_val, empty);
+    }
+
+    void delete_nodes() {
+        for (size_t c = 0; c < m_chunks.size(); ++c) {
+            size_t n = (c + 1 == m_chunks.size() ? m_used : chunksize);
+
+            for (size_t i = 0; i < n; ++i)
+                reinterpret_cast<SnapshotTreeNode*>(m_chunks[c] + i)->~SnapshotTreeNode();
+
+            delete[] m_chunks[c];
+        }
+
+        m_chunks.clear();
+        m_used = 0;
     }
 
+    SnapshotTreeNode* m_root;
+
     const SnapshotTreeNode* 
     add_snapshot(const CaliperMetadataAccessInterface& db, 
                  const EntryList&  list,
                  IsPathPredicateFn is_path) 
     {
         std::vector< std::pair<Attribute, Variant> > path;
-        std::map<Attribute, Variant> attributes;
+        std::vector< std::pair<Attribute, Variant> > attributes;
 
         //
         // helper function to distinguish path and attribute entries
@@ -83,10 +108,8 @@ struct SnapshotTree::SnapshotTreeImpl
 
             if (is_path(attr, val))
                 path.push_back(std::make_pair(attr, val));
-            else {
-                if (attributes.count(attr) == 0)
-                    attributes.insert(std::make_pair(attr, val));
-            }   
+            else
+                attributes.push_back(std::make_pair(attr, val));
         };
 
         //
@@ -117,7 +140,7 @@ struct SnapshotTree::SnapshotTreeImpl
                 ;
 
             if (!child) {
-                child = new SnapshotTreeNode((*it).first, (*it).second, true /* empty */);
+                child = make_node((*it).first, (*it).second, true /* empty */);
                 node->append(child);
             }
 
@@ -130,14 +153,26 @@ struct SnapshotTree::SnapshotTreeImpl
             assert(node->parent());
 
             // create a new node if the existing one is not empty
-            node->parent()->append(new SnapshotTreeNode(node->label_key(), 
-                                                        node->label_value(), 
-                                                        false));
+            node->parent()->append(make_node(node->label_key(),
+                                             node->label_value(),
+                                             false));
         }
 
         //
-        // add the attributes
-        // 
+        // add the attributes; sort by attribute, keeping only the
+        // first (top-level) entry for duplicate keys
+        //
+
+        auto attr_lt = [](const std::pair<Attribute, Variant>& lhs, const std::pair<Attribute, Variant>& rhs) {
+            return lhs.first < rhs.first;
+        };
+        auto attr_eq = [](const std::pair<Attribute, Variant>& lhs, const std::pair<Attribute, Variant>& rhs) {
+            return lhs.first == rhs.first;
+        };
+
+        std::stable_sort(attributes.begin(), attributes.end(), attr_lt);
+        attributes.erase(std::unique(attributes.begin(), attributes.end(), attr_eq),
+                         attributes.end());
 
         node->assign_attributes(std::move(attributes));
 
@@ -145,11 +180,13 @@ struct SnapshotTree::SnapshotTreeImpl
     }
 
     SnapshotTreeImpl(const Attribute& attr, const Variant& value)
-        : m_root(new SnapshotTreeNode(attr, value, true))
-        { }
+        : m_used(0)
+        {
+            m_root = make_node(attr, value, true);
+        }
 
     ~SnapshotTreeImpl() {
-        recursive_delete(m_root);
+        delete_nodes();
     }
 
 }; // SnapshotTreeImpl
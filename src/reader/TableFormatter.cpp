@@ -51,6 +51,16 @@
 
 using namespace cali;
 
+namespace
+{
+
+const char whitespace[120+1] =
+    "                                        "
+    "                                        "
+    "                                        ";
+
+}
+
 struct TableFormatter::TableImpl
 {
     struct Column {
@@ -75,6 +85,13 @@ struct TableFormatter::TableImpl
     bool                                    m_auto_column;
     std::size_t                             m_num_sort_columns;
 
+    // Streaming mode: sample column widths from the first m_sample_rows
+    // records, then write records to *m_stream_os as they arrive instead
+    // of retaining them. Requires an output stream and no sort columns.
+    std::ostream*                           m_stream_os   { nullptr };
+    std::size_t                             m_sample_rows { 0       };
+    bool                                    m_streaming   { false   };
+
     void parse(const std::string& field_string, const std::string& sort_string) {
         std::vector<std::string> fields;
 
@@ -141,6 +158,17 @@ struct TableFormatter::TableImpl
             // Keep auto_column = false and empty column list
             break;
         }
+
+        // Parse "stream" argument (number of records sampled for column
+        // widths). Streaming needs an output stream and unsorted output.
+
+        if (spec.format.args.size() > 0 && m_stream_os && m_num_sort_columns == 0) {
+            bool ok = false;
+            int  n  = StringConverter(spec.format.args[0]).to_int(&ok);
+
+            if (ok && n > 0)
+                m_sample_rows = n;
+        }
     }
     
     void update_column_attribute(CaliperMetadataAccessInterface& db, cali_id_t attr_id) {
@@ -173,8 +201,10 @@ struct TableFormatter::TableImpl
 
         // Auto-generate columns from attributes in the snapshots. Used if no
         // field list was given. Skips some internal attributes.
+        // The column set is frozen once the header has been printed in
+        // streaming mode.
 
-        if (m_auto_column)
+        if (m_auto_column && !m_streaming)
             for (Entry e : list) {
                 if (e.node()) {
                     for (const Node* node = e.node(); node && node->attribute() != CALI_INV_ID; node = node->parent())
@@ -192,6 +222,33 @@ struct TableFormatter::TableImpl
         return m_cols;
     }
 
+    void print_header(std::ostream& os, const std::vector<Column>& cols) {
+        for (const Column& col : cols)
+            if (col.print)
+                os << col.name << whitespace+(120 - std::min<std::size_t>(120, 1+col.max_width-col.name.size()));
+
+        os << std::endl;
+    }
+
+    void print_row(std::ostream& os, const std::vector<Column>& cols, const std::vector<std::string>& row) {
+        for (std::vector<Column>::size_type c = m_num_sort_columns; c < row.size(); ++c) {
+            if (!cols[c].print)
+                continue;
+
+            const std::string& str = row[c];
+            cali_attr_type t   = cols[c].attr.type();
+            bool           align_right = (t == CALI_TYPE_INT || t == CALI_TYPE_UINT || t == CALI_TYPE_DOUBLE);
+            std::size_t    len = cols[c].max_width > str.size() ? cols[c].max_width-str.size() : 0;
+
+            if (align_right)
+                os << whitespace+(120 - std::min<std::size_t>(120, len)) << str << ' ';
+            else
+                os << str << whitespace+(120 - std::min<std::size_t>(120, 1+len));
+        }
+
+        os << std::endl;
+    }
+
     void add(CaliperMetadataAccessInterface& db, const EntryList& list) {
         std::vector<Column> cols = update_columns(db, list);
         std::vector<std::string> row(cols.size());
@@ -237,13 +294,6 @@ struct TableFormatter::TableImpl
             }
         }
 
-        if (active) {
-            std::lock_guard<std::mutex>
-                g(m_row_lock);
-
-            m_rows.push_back(std::move(row));
-        }
-
         if (update_max_width) {
             std::lock_guard<std::mutex>
                 g(m_col_lock);
@@ -252,11 +302,43 @@ struct TableFormatter::TableImpl
                 if (cols[c].max_width > m_cols[c].max_width)
                     m_cols[c].max_width = cols[c].max_width;
         }
+
+        if (active) {
+            std::lock_guard<std::mutex>
+                g(m_row_lock);
+
+            if (m_streaming) {
+                print_row(*m_stream_os, cols, row);
+            } else {
+                m_rows.push_back(std::move(row));
+
+                // In streaming mode, print header and sampled rows once
+                // enough records arrived, then stop retaining rows
+
+                if (m_sample_rows > 0 && m_rows.size() >= m_sample_rows) {
+                    std::lock_guard<std::mutex>
+                        gc(m_col_lock);
+
+                    print_header(*m_stream_os, m_cols);
+
+                    for (const std::vector<std::string>& r : m_rows)
+                        print_row(*m_stream_os, m_cols, r);
+
+                    m_rows.clear();
+                    m_streaming = true;
+                }
+            }
+        }
     }
 
     void flush(std::ostream& os) {
         // NOTE: No locking, assume flush() runs serially
 
+        // In streaming mode, header and rows have already been written
+
+        if (m_streaming)
+            return;
+
         // sort rows
         // NOTE: This is REALLY slow (potentially converts strings to numbers on every comparison)
 
@@ -269,39 +351,12 @@ struct TableFormatter::TableImpl
                                  return Variant::from_string(type, lhs[c].c_str()) < Variant::from_string(type, rhs[c].c_str());
                              });
 
-        const char whitespace[120+1] =
-            "                                        "
-            "                                        "
-            "                                        ";
+        // print header and rows
 
-        // print header
+        print_header(os, m_cols);
 
-        for (const Column& col : m_cols)
-            if (col.print)
-                os << col.name << whitespace+(120 - std::min<std::size_t>(120, 1+col.max_width-col.name.size()));
-
-        os << std::endl;
-
-        // print rows
-
-        for (auto row : m_rows) {
-            for (std::vector<Column>::size_type c = m_num_sort_columns; c < row.size(); ++c) {
-                if (!m_cols[c].print)
-                    continue;
-
-                std::string    str = row[c];
-                cali_attr_type t   = m_cols[c].attr.type();
-                bool           align_right = (t == CALI_TYPE_INT || t == CALI_TYPE_UINT || t == CALI_TYPE_DOUBLE);
-                std::size_t    len = m_cols[c].max_width-str.size();
-
-                if (align_right)
-                    os << whitespace+(120 - std::min<std::size_t>(120, len)) << str << ' ';
-                else
-                    os << str << whitespace+(120 - std::min<std::size_t>(120, 1+len));
-            }
-
-            os << std::endl;
-        }
+        for (const std::vector<std::string>& row : m_rows)
+            print_row(os, m_cols, row);
     }
 };
 
@@ -318,6 +373,13 @@ TableFormatter::TableFormatter(const QuerySpec& spec)
     mP->configure(spec);
 }
 
+TableFormatter::TableFormatter(std::ostream& os, const QuerySpec& spec)
+    : mP { new TableImpl }
+{
+    mP->m_stream_os = &os;
+    mP->configure(spec);
+}
+
 TableFormatter::~TableFormatter()
 {
     mP.reset();
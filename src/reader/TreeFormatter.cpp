@@ -186,9 +186,9 @@ struct TreeFormatter::TreeFormatterImpl
             std::string str;
 
             {
-                auto it = node->attributes().find(a);
-                if (it != node->attributes().end())
-                    str = it->second.to_string();
+                Variant val = node->attribute(a);
+                if (!val.empty())
+                    str = val.to_string();
             }
 
             cali_attr_type t = a.type();
@@ -8,6 +8,7 @@
 #include <gtest/gtest.h>
 
 #include <set>
+#include <vector>
 
 using namespace cali;
 
@@ -136,3 +137,63 @@ TEST(NodeBufferTest, Import) {
     EXPECT_EQ(out_2_attr.type(), CALI_TYPE_INT);    
     EXPECT_EQ(out_2_attr.properties(), in_2_attr.properties());    
 }
+
+TEST(NodeBufferTest, AppendBatch) {
+    // Batch round-trip: bulk-encoded nodes must decode like per-node records
+
+    CaliperMetadataDB in_db;
+
+    Attribute in_1_attr = in_db.create_attribute("my.string.attr", CALI_TYPE_STRING, CALI_ATTR_DEFAULT);
+    Attribute in_2_attr = in_db.create_attribute("my.int.attr", CALI_TYPE_INT, CALI_ATTR_DEFAULT);
+
+    const Node* in_1 = in_db.node(in_1_attr.id());
+    const Node* in_2 = in_db.node(in_2_attr.id());
+
+    ASSERT_NE(in_1, nullptr);
+    ASSERT_NE(in_2, nullptr);
+
+    std::vector<const Node*> nodes;
+
+    {
+        // collect the attribute nodes' paths
+
+        std::set<cali_id_t> written_nodes;
+        NodeBuffer          tmp;
+
+        ::append_path(in_db, in_1, tmp);
+        ::append_path(in_db, in_2, tmp);
+
+        tmp.for_each([&in_db,&nodes](const NodeBuffer::NodeInfo& info){
+                nodes.push_back(in_db.node(info.node_id));
+            });
+    }
+
+    NodeBuffer buf;
+
+    buf.append_batch(nodes.size(), nodes.data());
+
+    EXPECT_EQ(buf.count(), nodes.size());
+
+    CaliperMetadataDB out_db;
+    IdMap idmap;
+
+    auto add_node = [&out_db, &idmap](const NodeBuffer::NodeInfo& info) {
+        out_db.merge_node(info.node_id, info.attr_id, info.parent_id, info.value, idmap);
+    };
+
+    buf.for_each(add_node);
+
+    Attribute out_1_attr = out_db.get_attribute("my.string.attr");
+    Attribute out_2_attr = out_db.get_attribute("my.int.attr");
+
+    ASSERT_NE(out_1_attr, Attribute::invalid);
+    ASSERT_NE(out_2_attr, Attribute::invalid);
+
+    EXPECT_STREQ(out_1_attr.name().c_str(), "my.string.attr");
+    EXPECT_EQ(out_1_attr.type(), CALI_TYPE_STRING);
+    EXPECT_EQ(out_1_attr.properties(), in_1_attr.properties());
+
+    EXPECT_STREQ(out_2_attr.name().c_str(), "my.int.attr");
+    EXPECT_EQ(out_2_attr.type(), CALI_TYPE_INT);
+    EXPECT_EQ(out_2_attr.properties(), in_2_attr.properties());
+}
@@ -42,10 +42,12 @@
 #include "caliper/common/Log.h"
 #include "caliper/common/RuntimeConfig.h"
 
-#include "caliper/common/util/split.hpp"
+#include "caliper/common/util/stringview.hpp"
 
 #include <algorithm>
 #include <iterator>
+#include <map>
+#include <set>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -56,6 +58,9 @@ using namespace std;
 // List of services, defined in services.inc.cpp
 #include "services.inc.cpp"
 
+// annotation fast-disable flag, defined in api.cpp
+extern int cali_enabled;
+
 namespace cali
 {
     
@@ -68,38 +73,98 @@ struct Services::ServicesImpl
 
     ConfigSet m_config;
 
+    // name -> service table entry, built on first use so processes
+    // that enable no services never touch the service table
+    map<string, const CaliperService*> m_registry;
+
+    // names of services that have been activated
+    set<string> m_active;
+
 
     // --- interface
 
+    void build_registry() {
+        if (!m_registry.empty())
+            return;
+
+        for (const CaliperService* s = caliper_services; s->name && s->register_fn; ++s)
+            m_registry.insert(make_pair(string(s->name), s));
+    }
+
     void register_services(Caliper* c) {
+        string enabled_string = m_config.get("enable").to_string();
+
+        vector<util::stringview> services;
+
+        util::split(util::stringview(enabled_string), ':', back_inserter(services));
+
+        if (services.empty()) {
+            // no services: disable the annotation fast path
+            cali_enabled = 0;
+            return;
+        }
+
+        build_registry();
+
         // list services
 
         if (Log::verbosity() >= 2) {
             ostringstream sstr;
 
-            for (const CaliperService* s = caliper_services; s->name && s->register_fn; ++s)
-                sstr << ' ' << s->name;
+            for (const auto& p : m_registry)
+                sstr << ' ' << p.first;
 
             Log(2).stream() << "Available services:" << sstr.str() << endl;
         }
 
-        vector<string> services;
+        // look up enabled services in the registry
+
+        vector<const CaliperService*> enabled;
+
+        for (util::stringview s : services) {
+            auto it = m_registry.find(s.to_string());
+
+            if (it == m_registry.end())
+                Log(0).stream() << "Warning: service \"" << s.to_string() << "\" not found" << endl;
+            else
+                enabled.push_back(it->second);
+        }
+
+        // invoke register functions in service table order
+
+        sort(enabled.begin(), enabled.end());
+        enabled.erase(unique(enabled.begin(), enabled.end()), enabled.end());
 
-        util::split(m_config.get("enable").to_string(), ':', back_inserter(services));
+        cali_enabled = enabled.empty() ? 0 : 1;
+
+        for (const CaliperService* s : enabled) {
+            (*s->register_fn)(c);
+            m_active.insert(s->name);
+        }
+    }
 
-        // register caliper services
+    bool start_service(Caliper* c, const string& name) {
+        build_registry();
 
-        for (const CaliperService* s = caliper_services; s->name && s->register_fn; ++s) {
-            auto it = find(services.begin(), services.end(), string(s->name));
+        auto it = m_registry.find(name);
 
-            if (it != services.end()) {
-                (*s->register_fn)(c);
-                services.erase(it);
-            }
+        if (it == m_registry.end()) {
+            Log(0).stream() << "Warning: service \"" << name << "\" not found" << endl;
+            return false;
         }
+        if (m_active.count(name) > 0) {
+            Log(1).stream() << "Service \"" << name << "\" is already active" << endl;
+            return false;
+        }
+
+        (*it->second->register_fn)(c);
+        m_active.insert(name);
+
+        cali_enabled = 1;
+
+        Log(1).stream() << "Started service \"" << name << "\"" << endl;
 
-        for ( const string& s : services )
-            Log(0).stream() << "Warning: service \"" << s << "\" not found" << endl;
+        return true;
     }
 
     ServicesImpl()
@@ -136,3 +201,8 @@ void Services::register_services(Caliper* c)
 {
     return ServicesImpl::instance()->register_services(c);
 }
+
+bool Services::start_service(Caliper* c, const std::string& name)
+{
+    return ServicesImpl::instance()->start_service(c, name);
+}
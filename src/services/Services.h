@@ -37,6 +37,7 @@
 #define CALI_SERVICES_H
 
 #include <memory>
+#include <string>
 
 namespace cali
 {
@@ -51,6 +52,14 @@ class Services
 public:
 
     static void register_services(Caliper* c = nullptr);
+
+    /// \brief Activate service \a name at runtime.
+    ///
+    /// Looks up \a name in the service registry and invokes its
+    /// registration function. Services that are already active are
+    /// not activated again. Returns false if \a name is unknown or
+    /// already active.
+    static bool start_service(Caliper* c, const std::string& name);
 };
 
 } // namespace cali
@@ -39,23 +39,39 @@
 #include "caliper/SnapshotRecord.h"
 
 #include "caliper/common/ContextRecord.h"
+#include "caliper/common/FlushExecutor.h"
+#include "caliper/common/Health.h"
 #include "caliper/common/Log.h"
+#include "caliper/common/MemoryBudget.h"
 #include "caliper/common/Node.h"
 #include "caliper/common/RuntimeConfig.h"
 #include "caliper/common/Variant.h"
 
 #include "caliper/common/c-util/vlenc.h"
 
+#include "caliper/common/csv/CsvReader.h"
+#include "caliper/common/csv/CsvWriter.h"
+
+#include "caliper/common/util/hugealloc.hpp"
 #include "caliper/common/util/spinlock.hpp"
 #include "caliper/common/util/split.hpp"
 
 #include <pthread.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iterator>
 #include <limits>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <thread>
 #include <vector>
 #include <unordered_set>
 
@@ -80,32 +96,175 @@ class AggregateDB {
     AggregateDB*             m_next;
     AggregateDB*             m_prev;
 
+    // the key group (grouping granularity) this DB aggregates for
+    unsigned                 m_key_group;
+
     // the actual aggregation db
 
     struct AggregateKernel  {
+        // number of power-of-two histogram buckets for percentile estimates
+        static const int NUM_HIST_BUCKETS = 36;
+
+        // staging buffer capacity (one cache line of doubles)
+        static const int STAGE_SIZE       = 8;
+
         double   min;
         double   max;
         double   sum;
         int      count;
 
+        // Welford running variance
+        double   avg;
+        double   m2;
+
+        // log2-scale histogram: bucket i counts values in [2^(i-1), 2^i)
+        uint32_t hist[NUM_HIST_BUCKETS];
+
+        // Incoming values are staged here and folded into the
+        // statistics a batch at a time with vectorizable loops.
+        // Readers must call drain() first.
+        double   staged[STAGE_SIZE];
+        int      n_staged;
+
         AggregateKernel()
             : min(std::numeric_limits<double>::max()),
               max(std::numeric_limits<double>::min()),
-              sum(0), count(0)
-        { }
+              sum(0), count(0),
+              avg(0), m2(0),
+              n_staged(0)
+        {
+            std::fill_n(hist, NUM_HIST_BUCKETS, 0);
+        }
+
+        static int hist_bucket(double val) {
+            int exp = 0;
+
+            frexp(std::fabs(val), &exp);
+
+            return std::min(std::max(exp, 0), NUM_HIST_BUCKETS-1);
+        }
 
         void add(double val) {
-            min  = std::min(min, val);
-            max  = std::max(max, val);
-            sum += val;
-            ++count;
+            staged[n_staged++] = val;
+
+            if (n_staged == STAGE_SIZE)
+                drain();
+        }
+
+        // Fold a span of values into the statistics. The min/max/sum
+        // reductions are separate simple loops so the compiler can
+        // vectorize them.
+        void add_batch(const double* v, int n) {
+            double b_min = v[0];
+            double b_max = v[0];
+            double b_sum = 0.0;
+
+            for (int i = 0; i < n; ++i)
+                b_min = std::min(b_min, v[i]);
+            for (int i = 0; i < n; ++i)
+                b_max = std::max(b_max, v[i]);
+            for (int i = 0; i < n; ++i)
+                b_sum += v[i];
+
+            min  = std::min(min, b_min);
+            max  = std::max(max, b_max);
+
+            if (s_calc_variance) {
+                // Welford statistics of the batch, then the parallel
+                // merge form to combine with the running terms
+
+                double b_avg = 0.0;
+                double b_m2  = 0.0;
+
+                for (int i = 0; i < n; ++i) {
+                    double delta = v[i] - b_avg;
+                    b_avg += delta / (i + 1);
+                    b_m2  += delta * (v[i] - b_avg);
+                }
+
+                double delta = b_avg - avg;
+                double total = count + n;
+
+                avg = (count * avg + n * b_avg) / total;
+                m2 += b_m2 + delta * delta * count * n / total;
+            }
+
+            sum   += b_sum;
+            count += n;
+
+            if (s_calc_percentiles)
+                for (int i = 0; i < n; ++i)
+                    ++hist[hist_bucket(v[i])];
+        }
+
+        // Apply any staged values to the statistics
+        void drain() {
+            if (n_staged > 0) {
+                add_batch(staged, n_staged);
+                n_staged = 0;
+            }
+        }
+
+        // Fold another kernel's statistics into this one. Uses the
+        // parallel form of Welford's algorithm for the variance terms.
+        // The other kernel must be drained.
+        void merge(const AggregateKernel& o) {
+            drain();
+
+            if (o.count == 0)
+                return;
+
+            min = std::min(min, o.min);
+            max = std::max(max, o.max);
+
+            if (s_calc_variance) {
+                double delta = o.avg - avg;
+                double n     = count + o.count;
+
+                avg = (count * avg + o.count * o.avg) / n;
+                m2 += o.m2 + delta * delta * count * o.count / n;
+            }
+
+            sum   += o.sum;
+            count += o.count;
+
+            if (s_calc_percentiles)
+                for (int i = 0; i < NUM_HIST_BUCKETS; ++i)
+                    hist[i] += o.hist[i];
+        }
+
+        double variance() const {
+            return count > 0 ? m2 / count : 0.0;
+        }
+
+        // Estimate the given percentile (0..1) from the histogram.
+        // Returns the upper bound of the bucket holding the percentile.
+        double percentile(double q) const {
+            uint32_t target = static_cast<uint32_t>(q * count);
+            uint32_t cum    = 0;
+
+            for (int i = 0; i < NUM_HIST_BUCKETS; ++i) {
+                cum += hist[i];
+
+                if (cum > target)
+                    return ldexp(1.0, i);
+            }
+
+            return max;
         }
     };
 
-    struct TrieNode {
-        uint32_t next[256] = { 0 };
+    // Hash table entry for the aggregation db. Entries store the encoded
+    // key inline and chain within a bucket via entry ids. At ~48 bytes per
+    // entry this is more than an order of magnitude more compact than the
+    // 256-ary trie with its 1KB fan-out arrays that it replaces.
+    struct HashEntry {
+        unsigned char key[MAX_KEYLEN];
+        uint8_t  keylen    = 0;
+        uint32_t next      = 0;
         uint32_t k_id      = 0xFFFFFFFF;
         uint32_t count     = 0;
+        uint32_t last_use  = 0; // update stamp for LRU eviction (see spill())
     };
 
     template<typename T, size_t MAX_BLOCKS = 2048, size_t ENTRIES_PER_BLOCK = 1024>
@@ -113,6 +272,45 @@ class AggregateDB {
         T*     m_blocks[MAX_BLOCKS] = { 0 };
         size_t m_num_blocks;
 
+        // hugepage-backed superblocks that blocks are carved from when
+        // memory.hugepages is set (see alloc_block())
+        std::vector<unsigned char*> m_regions;
+        unsigned char*              m_region_ptr   = nullptr;
+        size_t                      m_region_avail = 0;
+
+        // Blocks are only ever freed all at once in clear(), so with
+        // hugepages we bump-carve them out of 2MB-aligned,
+        // MADV_HUGEPAGE superblock regions to cut TLB pressure
+        T* alloc_block() {
+            size_t bytes = ENTRIES_PER_BLOCK * sizeof(T);
+
+            if (!s_use_hugepages) {
+                MemoryBudget::add(MemoryBudget::Aggregate, bytes);
+                return new T[ENTRIES_PER_BLOCK];
+            }
+
+            if (m_region_avail < bytes) {
+                size_t rsize = util::region_size(std::max(bytes, util::hugepage_bytes), true);
+
+                MemoryBudget::add(MemoryBudget::Aggregate, rsize);
+
+                m_region_ptr   = static_cast<unsigned char*>(util::alloc_region(rsize, true));
+                m_region_avail = rsize;
+
+                m_regions.push_back(m_region_ptr);
+            }
+
+            T* block = reinterpret_cast<T*>(m_region_ptr);
+
+            m_region_ptr   += bytes;
+            m_region_avail -= bytes;
+
+            for (size_t i = 0; i < ENTRIES_PER_BLOCK; ++i)
+                new(block + i) T();
+
+            return block;
+        }
+
     public:
 
         T* get(size_t id, bool alloc) {
@@ -123,7 +321,7 @@ class AggregateDB {
 
             if (!m_blocks[block]) {
                 if (alloc) {
-                    m_blocks[block] = new T[ENTRIES_PER_BLOCK];
+                    m_blocks[block] = alloc_block();
                     ++m_num_blocks;
                 } else
                     return 0;
@@ -133,11 +331,34 @@ class AggregateDB {
         }
 
         void clear() {
-            for (size_t b = 0; b < MAX_BLOCKS; ++b)
-                delete[] m_blocks[b];
-            
+            if (s_use_hugepages) {
+                for (size_t b = 0; b < MAX_BLOCKS; ++b)
+                    if (m_blocks[b])
+                        for (size_t i = 0; i < ENTRIES_PER_BLOCK; ++i)
+                            m_blocks[b][i].~T();
+
+                for (unsigned char* r : m_regions) {
+                    size_t rsize =
+                        util::region_size(std::max(ENTRIES_PER_BLOCK * sizeof(T), util::hugepage_bytes), true);
+
+                    util::free_region(r, rsize);
+                    MemoryBudget::sub(MemoryBudget::Aggregate, rsize);
+                }
+
+                m_regions.clear();
+
+                m_region_ptr   = nullptr;
+                m_region_avail = 0;
+            } else {
+                for (size_t b = 0; b < MAX_BLOCKS; ++b)
+                    if (m_blocks[b]) {
+                        delete[] m_blocks[b];
+                        MemoryBudget::sub(MemoryBudget::Aggregate, ENTRIES_PER_BLOCK * sizeof(T));
+                    }
+            }
+
             std::fill_n(m_blocks, MAX_BLOCKS, nullptr);
-            
+
             m_num_blocks = 0;
         }
 
@@ -154,16 +375,47 @@ class AggregateDB {
         }
     };
 
-    BlockAlloc<TrieNode>        m_trie;
+    BlockAlloc<HashEntry>       m_entries;
     BlockAlloc<AggregateKernel> m_kernels;
 
+    // bucket array of the key hash table: entry ids, 0 is "empty"
+    std::vector<uint32_t>       m_buckets;
+
+    // Slots of spilled entries, available for reuse. Freed entries are
+    // marked with keylen 0 and skipped by the table iteration loops.
+    std::vector<uint32_t>       m_free_entries;
+    std::vector<uint32_t>       m_free_kernels;
+
+    // monotonic update counter providing the last_use stamps
+    uint32_t                    m_op_count;
+
+    // Entry cache for snapshots whose key is fully determined by their
+    // context tree nodes (i.e., no immediate key entries). Slots are
+    // indexed by the highest node id in the snapshot and validated
+    // against the full node id tuple, so repeat snapshots skip key
+    // encoding and the hash table lookup (see process_snapshot()).
+    // Invalidated when the key attribute set changes (s_key_version).
+
+    static const size_t MAX_CACHE_NODES = 4;
+
+    struct CacheEntry {
+        HashEntry* entry = nullptr;
+        uint8_t    n_nodes = 0;
+        cali_id_t  nodes[MAX_CACHE_NODES];
+    };
+
+    std::vector<CacheEntry>     m_entry_cache;
+    unsigned                    m_cache_version;
+
     Node                        m_aggr_root_node;
-    
+
     // we maintain some internal statistics
-    size_t                   m_num_trie_entries;
+    size_t                   m_num_entries;
     size_t                   m_num_kernel_entries;
     size_t                   m_num_dropped;
     size_t                   m_num_skipped_keys;
+    size_t                   m_num_cache_hits;
+    size_t                   m_num_spilled;
     size_t                   m_max_keylen;
 
     //
@@ -174,13 +426,28 @@ class AggregateDB {
         Attribute min_attr;
         Attribute max_attr;
         Attribute sum_attr;
+        Attribute variance_attr;
+        Attribute p50_attr;
+        Attribute p95_attr;
+        Attribute p99_attr;
     };
 
     static Attribute         s_count_attribute;
 
-    static vector<cali_id_t> s_key_attribute_ids;
-    static vector<Attribute> s_key_attributes;
-    static vector<string>    s_key_attribute_names;
+    // A key group is one grouping granularity: multiple groups,
+    // separated by ';' in the key config, run as concurrent
+    // aggregation instances. Each thread keeps one DB per group; all
+    // groups share the snapshot handed to process_snapshot_cb(), so
+    // an additional group costs only its own key encoding and table
+    // update, not a second snapshot unpack.
+    struct KeyGroup {
+        vector<string>    attribute_names;
+        vector<Attribute> attributes;
+        vector<cali_id_t> attribute_ids;
+    };
+
+    static vector<KeyGroup>  s_keys;
+
     static vector<Attribute> s_aggr_attributes;
     static vector<string>    s_aggr_attribute_names;
     static vector<StatisticsAttributes>
@@ -190,18 +457,57 @@ class AggregateDB {
                              s_configdata[];
     static ConfigSet         s_config;
 
+    static bool              s_calc_variance;
+    static bool              s_calc_percentiles;
+    static bool              s_use_hugepages;
+
+    // bumped whenever a key attribute resolves; invalidates the
+    // per-thread leaf node entry caches
+    static std::atomic<unsigned>
+                             s_key_version;
+
     static pthread_key_t     s_aggregate_db_key;
 
     static AggregateDB*      s_list;
     static util::spinlock    s_list_lock;
 
+    // Accumulation DBs (one per key group) holding merged contents of
+    // retired per-thread DBs between incremental flushes
+    static std::vector<AggregateDB*>
+                             s_accum;
+    static std::mutex        s_accum_lock;
+
+    // serializes concurrent flush requests
+    static std::mutex        s_flush_lock;
+
+    // incremental flush thread (enabled with flush_interval > 0)
+    static unsigned          s_flush_interval;
+    static std::thread       s_flush_thread;
+    static std::atomic<bool> s_flush_active;
+
+    // number of threads for the parallel merge at flush
+    static unsigned          s_flush_threads;
+
+    // checkpoint file for saving/restoring aggregation state across
+    // job restarts (empty: disabled)
+    static std::string       s_checkpoint_file;
+
+    // per-DB entry limit for bounded aggregation (0: unbounded)
+    static size_t            s_max_entries;
+
+    // set when a spill has announced the write phase to the output
+    // services (fires pre_write_evt once before the first spill record)
+    static std::atomic<bool> s_spill_announced;
+
     // global statistics
-    static size_t            s_global_num_trie_entries;
+    static size_t            s_global_num_entries;
     static size_t            s_global_num_kernel_entries;
-    static size_t            s_global_num_trie_blocks;
+    static size_t            s_global_num_entry_blocks;
     static size_t            s_global_num_kernel_blocks;
     static size_t            s_global_num_dropped;
     static size_t            s_global_num_skipped_keys;
+    static size_t            s_global_num_cache_hits;
+    static size_t            s_global_num_spilled;
     static size_t            s_global_max_keylen;
 
 
@@ -216,40 +522,118 @@ class AggregateDB {
             m_prev->m_next = m_next;
     }
 
-    TrieNode* find_entry(size_t n, unsigned char* key, bool alloc) {
-        TrieNode* entry = m_trie.get(0, alloc);
+    static uint64_t hash_key(size_t n, const unsigned char* key) {
+        // FNV-1a
+        uint64_t h = 14695981039346656037ull;
+
+        for (size_t i = 0; i < n; ++i)
+            h = (h ^ key[i]) * 1099511628211ull;
+
+        return h;
+    }
+
+    void rehash() {
+        std::vector<uint32_t> buckets(4 * m_buckets.size(), 0);
+
+        for (uint32_t id = 1; id <= m_num_entries; ++id) {
+            HashEntry* e = m_entries.get(id, false);
+
+            if (!e || e->keylen == 0) // skip spilled slots
+                continue;
+
+            size_t b   = hash_key(e->keylen, e->key) % buckets.size();
+
+            e->next    = buckets[b];
+            buckets[b] = id;
+        }
+
+        m_buckets.swap(buckets);
+    }
+
+    HashEntry* find_entry(size_t n, unsigned char* key, bool alloc) {
+        size_t     b     = hash_key(n, key) % m_buckets.size();
+        HashEntry* entry = nullptr;
 
-        for ( size_t i = 0; entry && i < n; ++i ) {
-            uint32_t id = entry->next[key[i]];
+        for (uint32_t id = m_buckets[b]; id; ) {
+            HashEntry* e = m_entries.get(id, false);
 
-            if (!id) {
-                id = static_cast<uint32_t>(++m_num_trie_entries);
-                entry->next[key[i]] = id;
+            if (e->keylen == n && 0 == memcmp(e->key, key, n)) {
+                entry = e;
+                break;
             }
 
-            entry = m_trie.get(id, alloc);
+            id = e->next;
         }
-        
+
+        if (!entry) {
+            if (!alloc)
+                return nullptr;
+
+            // grow the bucket array at load factor 2 to keep chains short
+            if (m_num_entries > 2 * m_buckets.size()) {
+                rehash();
+                b = hash_key(n, key) % m_buckets.size();
+            }
+
+            uint32_t id;
+
+            if (!m_free_entries.empty()) {
+                id = m_free_entries.back();
+                m_free_entries.pop_back();
+            } else
+                id = static_cast<uint32_t>(++m_num_entries);
+
+            entry = m_entries.get(id, alloc);
+
+            if (!entry)
+                return nullptr;
+
+            memcpy(entry->key, key, n);
+
+            entry->keylen = static_cast<uint8_t>(n);
+            entry->next   = m_buckets[b];
+            m_buckets[b]  = id;
+        }
+
         if (entry && entry->k_id == 0xFFFFFFFF) {
             size_t num_ids = s_aggr_attributes.size();
 
             if (num_ids > 0) {
-                uint32_t first_id = static_cast<uint32_t>(m_num_kernel_entries + 1);
+                if (!m_free_kernels.empty()) {
+                    entry->k_id = m_free_kernels.back();
+                    m_free_kernels.pop_back();
+                } else {
+                    uint32_t first_id = static_cast<uint32_t>(m_num_kernel_entries + 1);
 
-                m_num_kernel_entries += num_ids;
+                    m_num_kernel_entries += num_ids;
 
-                for (unsigned i = 0; i < num_ids; ++i)
-                    if (m_kernels.get(first_id + i, alloc) == 0)
-                        return 0;
+                    for (unsigned i = 0; i < num_ids; ++i)
+                        if (m_kernels.get(first_id + i, alloc) == 0)
+                            return 0;
 
-                entry->k_id = first_id;
+                    entry->k_id = first_id;
+                }
             }
         }
 
         return entry;
     }
 
-    void write_aggregated_snapshot(const unsigned char* key, const TrieNode* entry, Caliper* c,
+    void update_entry(Caliper* c, HashEntry* entry,
+                      const SnapshotRecord::Sizes& sizes, const SnapshotRecord::Data& addr) {
+        ++entry->count;
+
+        for (size_t a = 0; a < s_aggr_attributes.size(); ++a)
+            for (size_t i = 0; i < sizes.n_immediate; ++i)
+                if (addr.immediate_attr[i] == s_aggr_attributes[a].id()) {
+                    AggregateKernel* k = m_kernels.get(entry->k_id + a, !c->is_signal());
+
+                    if (k)
+                        k->add(addr.immediate_data[i].to_double());
+                }
+    }
+
+    void write_aggregated_snapshot(const unsigned char* key, const HashEntry* entry, Caliper* c,
                                    Caliper::SnapshotFlushFn proc_fn) {
         SnapshotRecord::FixedSnapshotRecord<SNAP_MAX> snapshot_data;
         SnapshotRecord snapshot(snapshot_data);
@@ -267,14 +651,16 @@ class AggregateDB {
         if (toc % 2 == 1) {
             // there are immediate key entries
 
+            const KeyGroup& kg = s_keys[m_key_group];
+
             uint64_t imm_bitfield = vldec_u64(key+p, &p);
 
-            for (size_t k = 0; k < s_key_attribute_ids.size(); ++k)
+            for (size_t k = 0; k < kg.attribute_ids.size(); ++k)
                 if (imm_bitfield & (1 << k)) {
                     uint64_t val = vldec_u64(key+p, &p);
-                    Variant  v(s_key_attributes[k].type(), &val, sizeof(uint64_t));
+                    Variant  v(kg.attributes[k].type(), &val, sizeof(uint64_t));
 
-                    snapshot.append(s_key_attribute_ids[k], v);
+                    snapshot.append(kg.attribute_ids[k], v);
                 }
         }
 
@@ -290,12 +676,24 @@ class AggregateDB {
 
             if (!k)
                 break;
+
+            k->drain();
+
             if (k->count == 0)
                 continue;
 
             snapshot.append(s_stats_attributes[a].min_attr.id(), Variant(k->min));
             snapshot.append(s_stats_attributes[a].max_attr.id(), Variant(k->max));
             snapshot.append(s_stats_attributes[a].sum_attr.id(), Variant(k->sum));
+
+            if (s_calc_variance)
+                snapshot.append(s_stats_attributes[a].variance_attr.id(), Variant(k->variance()));
+
+            if (s_calc_percentiles) {
+                snapshot.append(s_stats_attributes[a].p50_attr.id(), Variant(k->percentile(0.50)));
+                snapshot.append(s_stats_attributes[a].p95_attr.id(), Variant(k->percentile(0.95)));
+                snapshot.append(s_stats_attributes[a].p99_attr.id(), Variant(k->percentile(0.99)));
+            }
         }
 
         uint64_t count = entry->count;
@@ -307,37 +705,105 @@ class AggregateDB {
         proc_fn(&snapshot);
     }
 
-    size_t recursive_flush(size_t n, unsigned char* key, TrieNode* entry, Caliper* c, Caliper::SnapshotFlushFn proc_fn) {
-        if (!entry)
-            return 0;
+    // Evict the least-recently-updated eighth of the table, writing the
+    // evicted entries as partial aggregate records to the output
+    // services. The reader-side aggregator folds the partials back
+    // together, so results stay exact while the table stays bounded.
+    // Called from process_snapshot() (never in signal context) when a
+    // new key would exceed the max_entries limit.
+    void spill(Caliper* c) {
+        // the recorder derives its filename from pre_write_evt; fire it
+        // once before the first spill record reaches it
+
+        if (!s_spill_announced.exchange(true)) {
+            SnapshotRecord::FixedSnapshotRecord<SNAP_MAX> info_data;
+            SnapshotRecord flush_info(info_data);
+
+            c->events().pre_write_evt(c, &flush_info);
+        }
+
+        // --- find the last-use stamp separating the coldest eighth
 
-        size_t num_written = 0;
+        std::vector<uint32_t> stamps;
+        stamps.reserve(m_num_entries);
+
+        for (uint32_t id = 1; id <= m_num_entries; ++id) {
+            HashEntry* e = m_entries.get(id, false);
+
+            if (e && e->keylen > 0)
+                stamps.push_back(e->last_use);
+        }
+
+        if (stamps.empty())
+            return;
+
+        size_t batch = std::min(std::max<size_t>(1, s_max_entries / 8), stamps.size());
+
+        std::nth_element(stamps.begin(), stamps.begin() + (batch-1), stamps.end());
+
+        uint32_t cutoff = stamps[batch-1];
+
+        // --- write out and free all entries at or below the cutoff
+
+        Caliper::SnapshotFlushFn proc_fn = [c](const SnapshotRecord* rec){
+            c->events().write_snapshot(c, nullptr, rec);
+            return true;
+        };
 
-        // --- write current entry if it represents a snapshot
+        size_t num_spilled = 0;
 
-        if (entry->count > 0)
-            write_aggregated_snapshot(key, entry, c, proc_fn);
+        for (uint32_t id = 1; id <= m_num_entries; ++id) {
+            HashEntry* e = m_entries.get(id, false);
 
-        num_written += (entry->count > 0 ? 1 : 0);
+            if (!e || e->keylen == 0 || e->last_use > cutoff)
+                continue;
+
+            if (e->count > 0)
+                write_aggregated_snapshot(e->key, e, c, proc_fn);
+
+            if (e->k_id != 0xFFFFFFFF) {
+                for (size_t a = 0; a < s_aggr_attributes.size(); ++a) {
+                    AggregateKernel* k = m_kernels.get(e->k_id + a, false);
+
+                    if (k)
+                        *k = AggregateKernel();
+                }
+
+                m_free_kernels.push_back(e->k_id);
+            }
 
-        // --- iterate over sub-records
+            e->keylen = 0;
+            e->count  = 0;
+            e->k_id   = 0xFFFFFFFF;
 
-        unsigned char* next_key = static_cast<unsigned char*>(alloca(n+2));
+            m_free_entries.push_back(id);
 
-        memset(next_key, 0, n+2);
-        memcpy(next_key, key, n);
+            ++num_spilled;
+        }
+
+        // evicted entries leave the table: rebuild the bucket chains
+        // and drop the entry cache, which holds pointers into the table
+
+        std::fill(m_buckets.begin(), m_buckets.end(), 0);
+
+        for (uint32_t id = 1; id <= m_num_entries; ++id) {
+            HashEntry* e = m_entries.get(id, false);
 
-        for (size_t i = 0; i < 256; ++i) {
-            if (entry->next[i] == 0)
+            if (!e || e->keylen == 0)
                 continue;
 
-            TrieNode* e  = m_trie.get(entry->next[i], false);
-            next_key[n]  = static_cast<unsigned char>(i);
+            size_t b = hash_key(e->keylen, e->key) % m_buckets.size();
 
-            num_written += recursive_flush(n+1, next_key, e, c, proc_fn);
+            e->next      = m_buckets[b];
+            m_buckets[b] = id;
         }
 
-        return num_written;
+        m_entry_cache.clear();
+
+        m_num_spilled += num_spilled;
+
+        Log(2).stream() << "Aggregate: spilled " << num_spilled
+                        << " entries as partial aggregates" << std::endl;
     }
 
     static void init_aggregation_attributes(Caliper* c, const std::vector<std::string>& aggr_attr_names) {
@@ -394,6 +860,23 @@ class AggregateDB {
             s_stats_attributes[i].sum_attr =
                 c->create_attribute(std::string("aggregate.sum#") + name,
                                     CALI_TYPE_DOUBLE, CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD);
+
+            if (s_calc_variance)
+                s_stats_attributes[i].variance_attr =
+                    c->create_attribute(std::string("aggregate.variance#") + name,
+                                        CALI_TYPE_DOUBLE, CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD);
+
+            if (s_calc_percentiles) {
+                s_stats_attributes[i].p50_attr =
+                    c->create_attribute(std::string("aggregate.p50#") + name,
+                                        CALI_TYPE_DOUBLE, CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD);
+                s_stats_attributes[i].p95_attr =
+                    c->create_attribute(std::string("aggregate.p95#") + name,
+                                        CALI_TYPE_DOUBLE, CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD);
+                s_stats_attributes[i].p99_attr =
+                    c->create_attribute(std::string("aggregate.p99#") + name,
+                                        CALI_TYPE_DOUBLE, CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD);
+            }
         }
 
         s_count_attribute =
@@ -406,12 +889,47 @@ class AggregateDB {
 
         s_config = RuntimeConfig::init("aggregate", s_configdata);
 
-        util::split(s_config.get("key").to_string(), ':',
-                    std::back_inserter(s_key_attribute_names));
+        // ';' separates key groups, ':' the attributes within a group
+
+        {
+            vector<string> groups;
+
+            util::split(s_config.get("key").to_string(), ';',
+                        std::back_inserter(groups));
+
+            if (groups.empty())
+                groups.push_back(string());
+
+            for (const string& group : groups) {
+                KeyGroup kg;
+
+                util::split(group, ':',
+                            std::back_inserter(kg.attribute_names));
+
+                kg.attributes.assign(kg.attribute_names.size(), Attribute::invalid);
+                kg.attribute_ids.assign(kg.attribute_names.size(), CALI_INV_ID);
+
+                s_keys.push_back(kg);
+            }
+        }
+
+        s_accum.assign(s_keys.size(), nullptr);
+
+        s_calc_variance    = s_config.get("calc_variance").to_bool();
+        s_calc_percentiles = s_config.get("calc_percentiles").to_bool();
+        s_flush_interval   = s_config.get("flush_interval").to_uint();
+        s_flush_threads    = s_config.get("flush_threads").to_uint();
+        s_checkpoint_file  = s_config.get("checkpoint").to_string();
+        s_max_entries      = s_config.get("max_entries").to_uint();
+
+        // hugepage backing is controlled by the memory pool's config set
+        s_use_hugepages    = RuntimeConfig::get("memory", "hugepages").to_bool();
+
+        if (!s_checkpoint_file.empty() && s_keys.size() > 1)
+            Log(1).stream() << "Aggregate: Note: only the first key group is checkpointed"
+                            << std::endl;
+
 
-        s_key_attribute_ids.assign(s_key_attribute_names.size(), CALI_INV_ID);
-        s_key_attributes.assign(s_key_attribute_names.size(), Attribute::invalid);
-        
         if (pthread_key_create(&s_aggregate_db_key, retire) != 0) {
             Log(0).stream() << "aggregate: error: pthread_key_create() failed"
                             << std::endl;
@@ -424,24 +942,94 @@ class AggregateDB {
 public:
 
     void clear() {
-        m_trie.clear();
+        m_entries.clear();
         m_kernels.clear();
 
-        m_num_trie_entries   = 0;
+        m_buckets.assign(1024, 0);
+        m_entry_cache.clear();
+
+        m_free_entries.clear();
+        m_free_kernels.clear();
+
+        m_num_entries        = 0;
         m_num_kernel_entries = 0;
         m_num_dropped        = 0;
         m_num_skipped_keys   = 0;
+        m_num_cache_hits     = 0;
+        m_num_spilled        = 0;
         m_max_keylen         = 0;
     }
 
-    void process_snapshot(Caliper* c, const SnapshotRecord* snapshot) {
+    // Find or create the hash table entry for the given snapshot's
+    // aggregation key and (if \a update is set) fold the snapshot's
+    // aggregatable values into it. Returns the entry, or null if the
+    // snapshot was empty or the entry could not be created.
+    HashEntry* process_snapshot(Caliper* c, const SnapshotRecord* snapshot, bool update = true) {
         SnapshotRecord::Sizes sizes = snapshot->size();
 
         if (sizes.n_nodes + sizes.n_immediate == 0)
-            return;
+            return nullptr;
 
         SnapshotRecord::Data addr   = snapshot->data();
 
+        const KeyGroup& kg = s_keys[m_key_group];
+
+        //
+        // --- leaf node entry cache lookup
+        //
+
+        // For snapshots without immediate key entries, the aggregation
+        // key is fully determined by the context tree nodes. We cache
+        // the resolved entry under the leaf (highest) node id so repeat
+        // snapshots skip key encoding and the hash table lookup.
+
+        {
+            unsigned key_version = s_key_version.load(std::memory_order_relaxed);
+
+            if (m_cache_version != key_version) {
+                m_entry_cache.clear();
+                m_cache_version = key_version;
+            }
+        }
+
+        bool cacheable = (sizes.n_nodes >= 1 && sizes.n_nodes <= MAX_CACHE_NODES);
+
+        for (size_t k = 0; cacheable && k < kg.attribute_ids.size(); ++k)
+            for (size_t i = 0; i < sizes.n_immediate; ++i)
+                if (kg.attribute_ids[k] == addr.immediate_attr[i]) {
+                    cacheable = false;
+                    break;
+                }
+
+        cali_id_t leaf_id = CALI_INV_ID;
+
+        if (cacheable) {
+            leaf_id = addr.node_entries[0]->id();
+
+            for (size_t i = 1; i < sizes.n_nodes; ++i)
+                leaf_id = std::max(leaf_id, addr.node_entries[i]->id());
+        }
+
+        if (cacheable && leaf_id < m_entry_cache.size()) {
+            const CacheEntry& ce = m_entry_cache[leaf_id];
+
+            bool match = ce.entry && ce.n_nodes == sizes.n_nodes;
+
+            for (size_t i = 0; match && i < sizes.n_nodes; ++i)
+                match = (ce.nodes[i] == addr.node_entries[i]->id());
+
+            if (match) {
+                ++m_num_cache_hits;
+
+                if (update) {
+                    ce.entry->last_use = ++m_op_count;
+                    update_entry(c, ce.entry, sizes, addr);
+                }
+
+                return ce.entry;
+            }
+        }
+
         //
         // --- create / get context tree nodes for key
         //
@@ -451,12 +1039,12 @@ public:
         uint64_t    n_nodes    = 0;
 
         size_t      n_key_attr = 0;
-        cali_id_t*  key_attribute_ids = static_cast<cali_id_t*>(alloca(s_key_attribute_ids.size() * sizeof(cali_id_t)));
+        cali_id_t*  key_attribute_ids = static_cast<cali_id_t*>(alloca(kg.attribute_ids.size() * sizeof(cali_id_t)));
 
         // create list of all valid key attribute ids
-        for (size_t i = 0; i < s_key_attribute_ids.size(); ++i)
-            if (s_key_attribute_ids[i] != CALI_INV_ID)
-                key_attribute_ids[n_key_attr++] = s_key_attribute_ids[i];
+        for (size_t i = 0; i < kg.attribute_ids.size(); ++i)
+            if (kg.attribute_ids[i] != CALI_INV_ID)
+                key_attribute_ids[n_key_attr++] = kg.attribute_ids[i];
             
         if (n_key_attr > 0 && sizes.n_nodes > 0) {
             // --- find out number of entries for each key attribute
@@ -508,7 +1096,7 @@ public:
                 else
                     Log(0).stream() << "aggregate: can't create node" << std::endl;
             }
-        } else if (s_key_attribute_ids.size() == 0) {
+        } else if (kg.attribute_ids.empty()) {
             // --- no key attributes set: take nodes in snapshot   
 
             nodeid_vec = static_cast<cali_id_t*>(alloca((sizes.n_nodes+1) * sizeof(cali_id_t)));
@@ -528,8 +1116,8 @@ public:
         // key encoding is as follows:
         //    - 1 u64: "toc" = 2 * num_nodes + (1 if immediate entries | 0 if no immediate entries)
         //    - num_nodes u64: key node ids
-        //    - 1 u64: bitfield of indices in s_key_attributes that mark immediate key entries
-        //    - for each immediate entry, 1 u64 entry for the value 
+        //    - 1 u64: bitfield of indices in the group's key attributes that mark immediate key entries
+        //    - for each immediate entry, 1 u64 entry for the value
 
         // encode node key
 
@@ -553,9 +1141,9 @@ public:
         size_t          imm_key_len = 0;
         uint64_t        imm_key_bitfield = 0;
 
-        for (size_t k = 0; k < s_key_attribute_ids.size(); ++k) 
+        for (size_t k = 0; k < kg.attribute_ids.size(); ++k)
             for (size_t i = 0; i < sizes.n_immediate; ++i)
-                if (s_key_attribute_ids[k] == addr.immediate_attr[i]) {
+                if (kg.attribute_ids[k] == addr.immediate_attr[i]) {
                     unsigned char buf[10];
                     size_t        p = 0;
 
@@ -590,94 +1178,275 @@ public:
         // --- find entry
         //
 
-        TrieNode* entry = find_entry(pos, key, !c->is_signal());
+        // Under the global memory budget, stop adding new keys once
+        // usage crosses the watermark: snapshots for existing keys
+        // still aggregate, new key combinations are dropped
+
+        bool alloc = !c->is_signal() && !MemoryBudget::over_watermark();
+
+        // With an entry limit set, make room for a new key by spilling
+        // the least-recently-updated entries as partial aggregates
+
+        if (s_max_entries > 0 && alloc && update
+            && m_num_entries - m_free_entries.size() >= s_max_entries
+            && !find_entry(pos, key, false))
+            spill(c);
+
+        HashEntry* entry = find_entry(pos, key, alloc);
 
         if (!entry) {
             ++m_num_dropped;
-            return;
+            Health::inc(Health::DroppedSnapshots);
+            return nullptr;
         }
 
         //
-        // --- update values
+        // --- fill cache, update values
         //
 
-        ++entry->count;
-
-        for (size_t a = 0; a < s_aggr_attributes.size(); ++a)
-            for (size_t i = 0; i < sizes.n_immediate; ++i)
-                if (addr.immediate_attr[i] == s_aggr_attributes[a].id()) {
-                    AggregateKernel* k = m_kernels.get(entry->k_id + a, !c->is_signal());
-
-                    if (k)
-                        k->add(addr.immediate_data[i].to_double());
-                }
-    }
+        // only cache entries with resolved kernel slots, so the cached
+        // path never has to allocate
 
-    size_t flush(Caliper* c, Caliper::SnapshotFlushFn proc_fn) {
-        TrieNode*     entry = m_trie.get(0, false);
-        unsigned char key   = 0;
+        if (cacheable && !c->is_signal()
+            && (s_aggr_attributes.empty() || entry->k_id != 0xFFFFFFFF)) {
+            if (leaf_id >= m_entry_cache.size())
+                m_entry_cache.resize(leaf_id + 1);
 
-        return recursive_flush(0, &key, entry, c, proc_fn);
-    }
+            CacheEntry& ce = m_entry_cache[leaf_id];
 
-    bool stopped() const {
-        return m_stopped.load();
-    }
+            ce.entry   = entry;
+            ce.n_nodes = static_cast<uint8_t>(sizes.n_nodes);
 
-    AggregateDB(Caliper* c)
-        : m_stopped(false),
-          m_retired(false),
-          m_next(nullptr),
-          m_prev(nullptr),
-          m_aggr_root_node(CALI_INV_ID, CALI_INV_ID, Variant()),
-          m_num_trie_entries(0),
-          m_num_kernel_entries(0),
-          m_num_dropped(0),
-          m_num_skipped_keys(0),
-          m_max_keylen(0)
-    {
-        Log(2).stream() << "Aggregate: creating aggregation database" << std::endl;
+            for (size_t i = 0; i < sizes.n_nodes; ++i)
+                ce.nodes[i] = addr.node_entries[i]->id();
+        }
 
-        // initialize first block
-        m_trie.get(0, true);
-        m_kernels.get(0, true);
-    }
+        if (update) {
+            entry->last_use = ++m_op_count;
+            update_entry(c, entry, sizes, addr);
+        }
 
-    ~AggregateDB() {
+        return entry;
     }
 
-    static AggregateDB* acquire(Caliper* c, bool alloc) {
-        AggregateDB* db =
-            static_cast<AggregateDB*>(pthread_getspecific(s_aggregate_db_key));
+    // Fold a single entry of \a other into this DB
+    void merge_entry(HashEntry* o_entry, AggregateDB* other) {
+        HashEntry* entry = find_entry(o_entry->keylen, o_entry->key, true);
 
-        if (alloc && !db) {
-            db = new AggregateDB(c);
+        if (!entry) {
+            ++m_num_dropped;
+            Health::inc(Health::DroppedSnapshots);
+            return;
+        }
 
-            if (pthread_setspecific(s_aggregate_db_key, db) == 0) {
-                std::lock_guard<util::spinlock>
-                    g(s_list_lock);
+        entry->count += o_entry->count;
 
-                if (s_list)
-                    s_list->m_prev = db;
+        for (size_t a = 0; a < s_aggr_attributes.size(); ++a) {
+            AggregateKernel* k   = m_kernels.get(entry->k_id + a, true);
+            AggregateKernel* o_k = other->m_kernels.get(o_entry->k_id + a, false);
 
-                db->m_next = s_list;
-                s_list     = db;
+            if (k && o_k) {
+                o_k->drain();
+                k->merge(*o_k);
             }
         }
+    }
+
+    // Fold a restored checkpoint entry into this DB. The key snapshot
+    // must already be re-resolved against the fresh metadata tree; the
+    // kernels must be drained.
+    void restore_entry(Caliper* c, const SnapshotRecord* key, uint64_t count,
+                       const std::vector<AggregateKernel>& kernels) {
+        HashEntry* entry = process_snapshot(c, key, false);
+
+        if (!entry) {
+            ++m_num_dropped;
+            Health::inc(Health::DroppedSnapshots);
+            return;
+        }
+
+        entry->count += count;
+
+        for (size_t a = 0; a < std::min(kernels.size(), s_aggr_attributes.size()); ++a) {
+            AggregateKernel* k = m_kernels.get(entry->k_id + a, true);
+
+            if (k)
+                k->merge(kernels[a]);
+        }
+    }
+
+    // Fold the contents of \a other into this DB. Key encodings use
+    // global node and attribute ids, so entries merge across threads.
+    void merge(AggregateDB* other) {
+        for (uint32_t id = 1; id <= other->m_num_entries; ++id) {
+            HashEntry* o_entry = other->m_entries.get(id, false);
+
+            if (o_entry && o_entry->count > 0)
+                merge_entry(o_entry, other);
+        }
+
+        m_num_dropped      += other->m_num_dropped;
+        m_num_skipped_keys += other->m_num_skipped_keys;
+        m_num_cache_hits   += other->m_num_cache_hits;
+        m_num_spilled      += other->m_num_spilled;
+        m_max_keylen        = std::max(m_max_keylen, other->m_max_keylen);
+    }
+
+    // Fold those entries of \a other whose key hash falls into the
+    // given partition of the hash space. Workers of the parallel flush
+    // each own disjoint partitions, so no locking is needed.
+    void merge_partition(AggregateDB* other, unsigned partition, unsigned num_partitions) {
+        for (uint32_t id = 1; id <= other->m_num_entries; ++id) {
+            HashEntry* o_entry = other->m_entries.get(id, false);
+
+            if (!o_entry || o_entry->count == 0)
+                continue;
+            if (hash_key(o_entry->keylen, o_entry->key) % num_partitions != partition)
+                continue;
+
+            merge_entry(o_entry, other);
+        }
+    }
+
+    size_t flush(Caliper* c, Caliper::SnapshotFlushFn proc_fn) {
+        size_t num_written = 0;
+
+        for (uint32_t id = 1; id <= m_num_entries; ++id) {
+            HashEntry* entry = m_entries.get(id, false);
+
+            if (entry && entry->count > 0) {
+                write_aggregated_snapshot(entry->key, entry, c, proc_fn);
+                ++num_written;
+            }
+        }
+
+        return num_written;
+    }
+
+    bool stopped() const {
+        return m_stopped.load();
+    }
+
+    AggregateDB(Caliper* c, unsigned key_group = 0)
+        : m_stopped(false),
+          m_retired(false),
+          m_next(nullptr),
+          m_prev(nullptr),
+          m_key_group(key_group),
+          m_buckets(1024, 0),
+          m_op_count(0),
+          m_cache_version(0),
+          m_aggr_root_node(CALI_INV_ID, CALI_INV_ID, Variant()),
+          m_num_entries(0),
+          m_num_kernel_entries(0),
+          m_num_dropped(0),
+          m_num_skipped_keys(0),
+          m_num_cache_hits(0),
+          m_num_spilled(0),
+          m_max_keylen(0)
+    {
+        Log(2).stream() << "Aggregate: creating aggregation database" << std::endl;
+
+        // initialize first block
+        m_entries.get(0, true);
+        m_kernels.get(0, true);
+    }
+
+    ~AggregateDB() {
+    }
+
+    // The per-thread DB set: one DB per key group, created on demand
+    struct ThreadDBs {
+        std::vector<AggregateDB*> dbs;
+    };
+
+    static AggregateDB* acquire(Caliper* c, bool alloc, unsigned key_group = 0) {
+        ThreadDBs* tdbs =
+            static_cast<ThreadDBs*>(pthread_getspecific(s_aggregate_db_key));
+
+        if (!tdbs) {
+            if (!alloc)
+                return nullptr;
+
+            tdbs = new ThreadDBs;
+            tdbs->dbs.assign(s_keys.size(), nullptr);
+
+            if (pthread_setspecific(s_aggregate_db_key, tdbs) != 0) {
+                delete tdbs;
+                return nullptr;
+            }
+        }
+
+        AggregateDB* db = tdbs->dbs[key_group];
+
+        if (alloc && !db) {
+            db = new AggregateDB(c, key_group);
+
+            tdbs->dbs[key_group] = db;
+
+            std::lock_guard<util::spinlock>
+                g(s_list_lock);
+
+            if (s_list)
+                s_list->m_prev = db;
+
+            db->m_next = s_list;
+            s_list     = db;
+        }
 
         return db;
     }
 
     static void retire(void* ptr) {
-        AggregateDB* db = static_cast<AggregateDB*>(ptr);
+        ThreadDBs* tdbs = static_cast<ThreadDBs*>(ptr);
 
-        if (!db)
+        if (!tdbs)
             return;
 
-        db->m_retired.store(true);
+        for (AggregateDB* db : tdbs->dbs)
+            if (db)
+                db->m_retired.store(true);
+
+        delete tdbs;
     }
 
-    static void flush_cb(Caliper* c, const SnapshotRecord*, Caliper::SnapshotFlushFn proc_fn) {
+    // Swap a stopped DB for a fresh one on the owning thread. The old
+    // DB is marked retired and handed over to the next flush, so the
+    // thread continues aggregating without pausing for the flush.
+    static AggregateDB* exchange(Caliper* c, AggregateDB* old) {
+        ThreadDBs* tdbs =
+            static_cast<ThreadDBs*>(pthread_getspecific(s_aggregate_db_key));
+
+        if (!tdbs)
+            return old;
+
+        AggregateDB* db = new AggregateDB(c, old->m_key_group);
+
+        tdbs->dbs[old->m_key_group] = db;
+
+        {
+            std::lock_guard<util::spinlock>
+                g(s_list_lock);
+
+            if (s_list)
+                s_list->m_prev = db;
+
+            db->m_next = s_list;
+            s_list     = db;
+        }
+
+        old->m_retired.store(true);
+
+        return db;
+    }
+
+    // Merge retired DBs (threads that exited, or that handed their DB
+    // over after a flush request) into the accumulation DB and remove
+    // them from the list.
+    static void collect_retired_dbs() {
+        std::lock_guard<std::mutex>
+            ga(s_accum_lock);
+
         AggregateDB* db = nullptr;
 
         {
@@ -687,28 +1456,608 @@ public:
             db = s_list;
         }
 
+        while (db) {
+            AggregateDB* next = db->m_next;
+
+            if (db->m_retired.load()) {
+                if (!s_accum[db->m_key_group])
+                    s_accum[db->m_key_group] = new AggregateDB(nullptr, db->m_key_group);
+
+                s_accum[db->m_key_group]->merge(db);
+
+                s_global_num_entries        += db->m_num_entries;
+                s_global_num_kernel_entries += db->m_num_kernel_entries;
+                s_global_num_entry_blocks   += db->m_entries.num_blocks();
+                s_global_num_kernel_blocks  += db->m_kernels.num_blocks();
+
+                {
+                    std::lock_guard<util::spinlock>
+                        g(s_list_lock);
+
+                    db->unlink();
+
+                    if (db == s_list)
+                        s_list = next;
+                }
+
+                delete db;
+            }
+
+            db = next;
+        }
+    }
+
+    //
+    // --- checkpoint/restart
+    //
+
+    // Write the current aggregation state (the accumulation DB and all
+    // per-thread DBs) to the checkpoint file. The DBs are stopped but
+    // not cleared, so a subsequent flush sees the same contents. The
+    // file is written to a temporary name and renamed when complete, so
+    // a crash mid-checkpoint does not corrupt an existing checkpoint.
+    static void write_checkpoint(Caliper* c) {
+        std::lock_guard<std::mutex>
+            gf(s_flush_lock);
+
+        collect_retired_dbs();
+
+        std::string tmpname = s_checkpoint_file + ".tmp";
+
+        std::ofstream os(tmpname.c_str());
+
+        if (!os) {
+            Log(0).stream() << "Aggregate: error: could not open checkpoint file "
+                            << tmpname << std::endl;
+            return;
+        }
+
+        CsvWriter writer(os);
+
+        Caliper::SnapshotFlushFn proc_fn = [c,&writer](const SnapshotRecord* snapshot){
+            SnapshotRecord::Data   data = snapshot->data();
+            SnapshotRecord::Sizes sizes = snapshot->size();
+
+            cali_id_t node_ids[SNAP_MAX];
+            size_t    nn = std::min<size_t>(sizes.n_nodes, SNAP_MAX);
+
+            for (size_t i = 0; i < nn; ++i)
+                node_ids[i] = data.node_entries[i]->id();
+
+            writer.write_snapshot(*c, nn, node_ids,
+                                  sizes.n_immediate, data.immediate_attr, data.immediate_data);
+
+            return true;
+        };
+
         size_t num_written = 0;
-        std::unordered_set<cali_id_t> written_node_cache;
 
-        while (db) {
-            db->m_stopped.store(true);
-            num_written += db->flush(c, proc_fn);
+        {
+            std::lock_guard<std::mutex>
+                ga(s_accum_lock);
+
+            // only the first key group is checkpointed: restoring
+            // records of several granularities would double-count
+
+            if (s_accum[0])
+                num_written += s_accum[0]->flush(c, proc_fn);
+
+            std::lock_guard<util::spinlock>
+                g(s_list_lock);
+
+            for (AggregateDB* db = s_list; db; db = db->m_next) {
+                if (db->m_key_group != 0)
+                    continue;
+
+                db->m_stopped.store(true);
+                num_written += db->flush(c, proc_fn);
+            }
+        }
+
+        writer.flush();
+        os.close();
+
+        // don't clobber an existing checkpoint with an empty one
+
+        if (num_written > 0) {
+            std::rename(tmpname.c_str(), s_checkpoint_file.c_str());
+
+            Log(1).stream() << "Aggregate: wrote " << num_written
+                            << " checkpoint entries to " << s_checkpoint_file << std::endl;
+        } else
+            std::remove(tmpname.c_str());
+    }
+
+    // Re-resolves checkpoint records against the fresh process. Node
+    // ids are run-local: attribute definitions are matched by name (or
+    // created from the checkpointed name, type, and properties, so the
+    // restarted application reuses them), and context tree nodes are
+    // then rebuilt lazily from their (attribute, data) paths.
+    // make_tree_entry() finds identical existing children, so nodes the
+    // fresh run has already created are reused rather than duplicated.
+    class CheckpointReader {
+        struct CkptNode {
+            cali_id_t   attr;
+            cali_id_t   parent;
+            std::string data;
+        };
+
+        std::map<cali_id_t, CkptNode>  m_nodes; // checkpoint node records
+        std::map<cali_id_t, Attribute> m_attrs; // checkpoint attr id -> fresh attribute
+        std::map<cali_id_t, Node*>     m_tree;  // checkpoint node id -> fresh node
+
+        cali_id_t m_name_attr_id;
+        cali_id_t m_type_attr_id;
+        cali_id_t m_prop_attr_id;
+
+    public:
+
+        CheckpointReader(Caliper* c)
+            : m_name_attr_id { c->get_attribute("cali.attribute.name").id() },
+              m_type_attr_id { c->get_attribute("cali.attribute.type").id() },
+              m_prop_attr_id { c->get_attribute("cali.attribute.prop").id() }
+            { }
+
+        void add_node(const RecordMap& rec) {
+            auto id_it   = rec.find("id");
+            auto attr_it = rec.find("attr");
+            auto data_it = rec.find("data");
+
+            if (id_it   == rec.end() || id_it->second.empty()   ||
+                attr_it == rec.end() || attr_it->second.empty() ||
+                data_it == rec.end() || data_it->second.empty())
+                return;
+
+            CkptNode node;
+
+            node.attr   = std::stoull(attr_it->second.front());
+            node.parent = CALI_INV_ID;
+            node.data   = data_it->second.front();
+
+            auto p_it = rec.find("parent");
+
+            if (p_it != rec.end() && !p_it->second.empty())
+                node.parent = std::stoull(p_it->second.front());
+
+            m_nodes[std::stoull(id_it->second.front())] = node;
+        }
+
+        Attribute attribute(Caliper* c, cali_id_t ckpt_id) {
+            auto a_it = m_attrs.find(ckpt_id);
+
+            if (a_it != m_attrs.end())
+                return a_it->second;
+
+            Attribute attr = Attribute::invalid;
+
+            auto n_it = m_nodes.find(ckpt_id);
+
+            if (n_it == m_nodes.end()) {
+                // the metadata bootstrap attributes have fixed ids and
+                // are not written to the file
+                if (ckpt_id < 11)
+                    attr = c->get_attribute(ckpt_id);
+            } else if (n_it->second.attr == m_name_attr_id) {
+                std::string name = n_it->second.data;
+
+                attr = c->get_attribute(name);
+
+                if (attr == Attribute::invalid) {
+                    // not (yet) created in this run: create it from the
+                    // checkpointed type and properties, so the restarted
+                    // application finds and reuses it later
+
+                    cali_attr_type type = CALI_TYPE_INV;
+                    int            prop = CALI_ATTR_DEFAULT;
+
+                    for (cali_id_t p = n_it->second.parent; p != CALI_INV_ID; ) {
+                        auto p_it = m_nodes.find(p);
+
+                        if (p_it == m_nodes.end()) {
+                            // ends at a bootstrap type node
+                            Node* node = c->node(p);
+
+                            if (node && node->attribute() == m_type_attr_id)
+                                type = node->data().to_attr_type();
+
+                            break;
+                        }
+
+                        if (p_it->second.attr == m_prop_attr_id)
+                            prop = std::stoi(p_it->second.data);
+
+                        p = p_it->second.parent;
+                    }
+
+                    if (type != CALI_TYPE_INV)
+                        attr = c->create_attribute(name, type, prop);
+                }
+            }
+
+            if (attr != Attribute::invalid)
+                m_attrs[ckpt_id] = attr;
+
+            return attr;
+        }
+
+        Node* node(Caliper* c, cali_id_t ckpt_id) {
+            auto t_it = m_tree.find(ckpt_id);
+
+            if (t_it != m_tree.end())
+                return t_it->second;
+
+            auto n_it = m_nodes.find(ckpt_id);
+
+            if (n_it == m_nodes.end())
+                return nullptr;
 
-            s_global_num_trie_entries   += db->m_num_trie_entries;
+            Node* parent = nullptr;
+
+            if (n_it->second.parent != CALI_INV_ID) {
+                parent = node(c, n_it->second.parent);
+
+                if (!parent)
+                    return nullptr;
+            }
+
+            Attribute attr = attribute(c, n_it->second.attr);
+
+            if (attr == Attribute::invalid)
+                return nullptr;
+
+            bool    ok = false;
+            Variant data;
+
+            std::vector<unsigned char> blob;
+
+            if (attr.type() == CALI_TYPE_USR) {
+                // from_string() can't convert USR data: decode
+                // to_string()'s colon-separated hex byte dump instead
+
+                for (const char* p = n_it->second.data.c_str(); *p; ) {
+                    char* end = nullptr;
+
+                    blob.push_back(static_cast<unsigned char>(strtoul(p, &end, 16)));
+
+                    if (end == p)
+                        break;
+
+                    p = (*end == ':') ? end+1 : end;
+                }
+
+                data = Variant(CALI_TYPE_USR, blob.data(), blob.size());
+                ok   = true;
+            } else
+                data = Variant::from_string(attr.type(), n_it->second.data.c_str(), &ok);
+
+            if (!ok)
+                return nullptr;
+
+            // The event service's snapshot info nodes store the id of
+            // the triggering attribute as their data: translate it, or
+            // the rebuilt path won't match the fresh run's
+
+            if (data.to_uint() != CALI_INV_ID
+                && (attr.name() == "cali.event.begin" ||
+                    attr.name() == "cali.event.set"   ||
+                    attr.name() == "cali.event.end")) {
+                Attribute target = attribute(c, data.to_uint());
+
+                if (target != Attribute::invalid) {
+                    uint64_t id = target.id();
+                    data = Variant(CALI_TYPE_UINT, &id, sizeof(uint64_t));
+                }
+            }
+
+            Node* node = c->make_tree_entry(attr, data, parent);
+
+            if (node)
+                m_tree[ckpt_id] = node;
+
+            return node;
+        }
+    };
+
+    // Rebuild the aggregation entry from a checkpoint context record:
+    // re-resolve its key references against the fresh tree, turn the
+    // aggregate.* immediates back into kernels, and fold the result
+    // into this DB. Returns false if the record could not be resolved.
+    bool restore_ctx(Caliper* c, const RecordMap& rec, CheckpointReader& ckpt) {
+        SnapshotRecord::FixedSnapshotRecord<SNAP_MAX> key_data;
+        SnapshotRecord key(key_data);
+
+        auto ref_it = rec.find("ref");
+
+        if (ref_it != rec.end())
+            for (const std::string& str : ref_it->second) {
+                Node* node = ckpt.node(c, std::stoull(str));
+
+                if (!node)
+                    return false;
+
+                key.append(node);
+            }
+
+        auto attr_it = rec.find("attr");
+        auto data_it = rec.find("data");
+
+        size_t n_imm =
+            (attr_it != rec.end() && data_it != rec.end()) ?
+            std::min(attr_it->second.size(), data_it->second.size()) : 0;
+
+        uint64_t count = 0;
+
+        std::vector<AggregateKernel> kernels(s_aggr_attributes.size());
+
+        for (size_t i = 0; i < n_imm; ++i) {
+            Attribute attr = ckpt.attribute(c, std::stoull(attr_it->second[i]));
+
+            if (attr == Attribute::invalid)
+                return false;
+
+            const std::string& data = data_it->second[i];
+
+            if (attr.id() == s_count_attribute.id()) {
+                count = std::stoull(data);
+                continue;
+            }
+
+            // map the derived statistics attributes back onto kernel slots
+
+            bool is_stat = false;
+
+            for (size_t a = 0; a < kernels.size() && !is_stat; ++a) {
+                const StatisticsAttributes& s = s_stats_attributes[a];
+
+                is_stat = true;
+
+                if (attr.id() == s.min_attr.id())
+                    kernels[a].min = std::stod(data);
+                else if (attr.id() == s.max_attr.id())
+                    kernels[a].max = std::stod(data);
+                else if (attr.id() == s.sum_attr.id())
+                    kernels[a].sum = std::stod(data);
+                else if (s_calc_variance && attr.id() == s.variance_attr.id())
+                    kernels[a].m2  = std::stod(data); // scaled by count below
+                else if (s_calc_percentiles &&
+                         (attr.id() == s.p50_attr.id() ||
+                          attr.id() == s.p95_attr.id() ||
+                          attr.id() == s.p99_attr.id()))
+                    ; // not restored: the underlying histogram isn't in the file
+                else
+                    is_stat = false;
+            }
+
+            if (is_stat)
+                continue;
+
+            // remaining immediates are key entries
+
+            bool    ok = false;
+            Variant v  = Variant::from_string(attr.type(), data.c_str(), &ok);
+
+            if (!ok)
+                return false;
+
+            key.append(attr.id(), v);
+        }
+
+        for (AggregateKernel& k : kernels) {
+            if (k.min == std::numeric_limits<double>::max())
+                continue; // attribute not present in this record
+
+            // The per-kernel count isn't in the file; use the entry
+            // count (exact when the attribute was in every snapshot).
+            // The histogram is approximated by putting all values into
+            // the mean's bucket, so restored percentiles are rough.
+
+            k.count = static_cast<int>(count);
+            k.avg   = count > 0 ? k.sum / count : 0.0;
+            k.m2   *= count;
+
+            if (s_calc_percentiles && count > 0)
+                k.hist[AggregateKernel::hist_bucket(k.avg)] = static_cast<uint32_t>(count);
+        }
+
+        restore_entry(c, &key, count, kernels);
+
+        return true;
+    }
+
+    // Read a checkpoint file written by a previous run of the job and
+    // fold its entries into the master thread's DB, so aggregation
+    // continues from the checkpointed state after a restart.
+    static void read_checkpoint(Caliper* c) {
+        AggregateDB* db = acquire(c, true);
+
+        if (!db)
+            return;
+
+        CsvReader reader(s_checkpoint_file);
+
+        CheckpointReader ckpt(c);
+
+        // Context records can precede node records they reference, so
+        // collect the node table first and resolve entries afterwards
+
+        std::vector<RecordMap> ctx_recs;
+
+        bool ok = reader.read([&](const RecordMap& rec){
+                auto it = rec.find("__rec");
+
+                if (it == rec.end() || it->second.empty())
+                    return;
+
+                if (it->second.front() == "node")
+                    ckpt.add_node(rec);
+                else if (it->second.front() == "ctx")
+                    ctx_recs.push_back(rec);
+            });
+
+        size_t num_restored = 0;
+        size_t num_skipped  = 0;
+
+        if (ok)
+            for (const RecordMap& rec : ctx_recs) {
+                if (db->restore_ctx(c, rec, ckpt))
+                    ++num_restored;
+                else
+                    ++num_skipped;
+            }
+
+        if (!ok) {
+            Log(1).stream() << "Aggregate: no checkpoint file "
+                            << s_checkpoint_file << ", starting fresh" << std::endl;
+            return;
+        }
+
+        if (num_skipped > 0)
+            Log(1).stream() << "Aggregate: warning: could not restore "
+                            << num_skipped << " checkpoint entries" << std::endl;
+
+        Log(1).stream() << "Aggregate: restored " << num_restored
+                        << " entries from " << s_checkpoint_file << std::endl;
+    }
+
+    static void flush_thread_fn() {
+        Caliper::instance();
+
+        while (s_flush_active.load()) {
+            // sleep for the flush interval, in small steps so shutdown
+            // does not have to wait for a full interval
+            auto end = std::chrono::steady_clock::now()
+                + std::chrono::seconds(s_flush_interval);
+
+            while (s_flush_active.load() && std::chrono::steady_clock::now() < end)
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+            if (!s_flush_active.load())
+                break;
+
+            // ask annotation threads to hand over their DBs ...
+
+            {
+                std::lock_guard<util::spinlock>
+                    g(s_list_lock);
+
+                for (AggregateDB* db = s_list; db; db = db->m_next)
+                    db->m_stopped.store(true);
+            }
+
+            // ... give them a moment to pick up fresh ones ...
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            // ... then merge the retired DBs and write a checkpoint.
+            // The reader-side aggregator folds the partial aggregates
+            // from incremental flushes back together.
+
+            Caliper::instance().flush_and_write(nullptr);
+        }
+    }
+
+    static void stop_flush_thread() {
+        if (s_flush_thread.joinable()
+            && std::this_thread::get_id() != s_flush_thread.get_id()) {
+            s_flush_active.store(false);
+            s_flush_thread.join();
+        }
+    }
+
+    static void flush_cb(Caliper* c, const SnapshotRecord*, Caliper::SnapshotFlushFn proc_fn) {
+        std::lock_guard<std::mutex>
+            gf(s_flush_lock);
+
+        collect_retired_dbs();
+
+        size_t num_written = 0;
+
+        std::lock_guard<std::mutex>
+            ga(s_accum_lock);
+
+        // stop the live DBs and gather all flush sources, per key group
+
+        std::vector< std::vector<AggregateDB*> > group_dbs(s_keys.size());
+
+        for (unsigned grp = 0; grp < s_keys.size(); ++grp)
+            if (s_accum[grp])
+                group_dbs[grp].push_back(s_accum[grp]);
+
+        {
+            std::lock_guard<util::spinlock>
+                g(s_list_lock);
+
+            for (AggregateDB* db = s_list; db; db = db->m_next) {
+                db->m_stopped.store(true);
+                group_dbs[db->m_key_group].push_back(db);
+            }
+        }
+
+        // DBs of different key groups use different key encodings and
+        // must not merge; each group flushes separately
+
+        for (unsigned grp = 0; grp < group_dbs.size(); ++grp) {
+            std::vector<AggregateDB*>& dbs = group_dbs[grp];
+
+            if (s_flush_threads > 1 && dbs.size() > 1) {
+                // --- parallel path: merge all DBs into a single table,
+                //     partitioned by key hash range. The per-partition
+                //     merge tasks run on the shared flush pool, whose
+                //     workers claim them from a shared counter, so
+                //     threads that finish early steal the remaining ones.
+
+                unsigned num_partitions = 4 * s_flush_threads;
+
+                std::vector< std::unique_ptr<AggregateDB> > partitions;
+
+                for (unsigned p = 0; p < num_partitions; ++p)
+                    partitions.emplace_back(new AggregateDB(nullptr, grp));
+
+                std::vector<FlushExecutor::Task> tasks;
+
+                for (unsigned p = 0; p < num_partitions; ++p)
+                    tasks.push_back([&partitions,&dbs,p,num_partitions]{
+                            for (AggregateDB* db : dbs)
+                                partitions[p]->merge_partition(db, p, num_partitions);
+                        });
+
+                FlushExecutor::run(tasks);
+
+                Log(2).stream() << "Aggregate: merged " << dbs.size() << " DBs in "
+                                << num_partitions << " partitions." << std::endl;
+
+                for (auto &p : partitions)
+                    num_written += p->flush(c, proc_fn);
+            } else {
+                for (AggregateDB* db : dbs)
+                    num_written += db->flush(c, proc_fn);
+            }
+        }
+
+        // --- update statistics, clear sources, delete retired DBs
+
+        for (const std::vector<AggregateDB*>& dbs : group_dbs)
+        for (AggregateDB* db : dbs) {
+            s_global_num_skipped_keys += db->m_num_skipped_keys;
+            s_global_num_dropped      += db->m_num_dropped;
+            s_global_num_cache_hits   += db->m_num_cache_hits;
+            s_global_num_spilled      += db->m_num_spilled;
+            s_global_max_keylen = std::max(s_global_max_keylen, db->m_max_keylen);
+
+            if (db == s_accum[db->m_key_group]) {
+                db->clear();
+                continue;
+            }
+
+            s_global_num_entries        += db->m_num_entries;
             s_global_num_kernel_entries += db->m_num_kernel_entries;
-            s_global_num_trie_blocks    += db->m_trie.num_blocks();
+            s_global_num_entry_blocks   += db->m_entries.num_blocks();
             s_global_num_kernel_blocks  += db->m_kernels.num_blocks();
-            s_global_num_skipped_keys   += db->m_num_skipped_keys;
-            s_global_num_dropped        += db->m_num_dropped;
-            s_global_max_keylen = std::max(s_global_max_keylen, db->m_max_keylen);
-            
+
             db->clear();
-            
             db->m_stopped.store(false);
 
             if (db->m_retired) {
-                AggregateDB* tmp = db->m_next;
-
                 {
                     std::lock_guard<util::spinlock>
                         g(s_list_lock);
@@ -716,13 +2065,10 @@ public:
                     db->unlink();
 
                     if (db == s_list)
-                        s_list = tmp;
+                        s_list = db->m_next;
                 }
 
                 delete db;
-                db = tmp;
-            } else {
-                db = db->m_next;
             }
         }
 
@@ -730,24 +2076,40 @@ public:
     }
 
     static void process_snapshot_cb(Caliper* c, const SnapshotRecord* trigger_info, const SnapshotRecord* snapshot) {
-        AggregateDB* db = acquire(c, !c->is_signal());
+        // all key groups share the snapshot: an additional group costs
+        // only its own key encoding and table update
 
-        if (db && !db->stopped())
-            db->process_snapshot(c, snapshot);
-        else
-            ++s_global_num_dropped;
+        for (unsigned grp = 0; grp < s_keys.size(); ++grp) {
+            AggregateDB* db = acquire(c, !c->is_signal(), grp);
+
+            // a stopped DB is requested by an incremental flush: swap in a
+            // fresh one and hand the old one over
+
+            if (db && db->stopped() && !c->is_signal())
+                db = exchange(c, db);
+
+            if (db && !db->stopped())
+                db->process_snapshot(c, snapshot);
+            else {
+                ++s_global_num_dropped;
+                Health::inc(Health::DroppedSnapshots);
+            }
+        }
     }
 
     static void post_init_cb(Caliper* c) {
         // Update key attributes
-        for (unsigned i = 0; i < s_key_attribute_names.size(); ++i) {
-            Attribute attr = c->get_attribute(s_key_attribute_names[i]);
+        for (KeyGroup& kg : s_keys)
+            for (unsigned i = 0; i < kg.attribute_names.size(); ++i) {
+                Attribute attr = c->get_attribute(kg.attribute_names[i]);
+
+                if (attr != Attribute::invalid) {
+                    kg.attributes[i]    = attr;
+                    kg.attribute_ids[i] = attr.id();
 
-            if (attr != Attribute::invalid) {
-                s_key_attributes[i]    = attr;
-                s_key_attribute_ids[i] = attr.id();
+                    ++s_key_version;
+                }
             }
-        }
 
         // Initialize aggregation attributes
         std::vector<std::string> names;
@@ -757,65 +2119,98 @@ public:
 
         init_aggregation_attributes(c, names);
 
-        // Initialize master-thread aggregation DB
-        acquire(c, true);
+        // Initialize master-thread aggregation DBs
+        for (unsigned grp = 0; grp < s_keys.size(); ++grp)
+            acquire(c, true, grp);
+
+        // Restore checkpointed aggregation state from a previous run
+        if (!s_checkpoint_file.empty())
+            read_checkpoint(c);
+
+        if (s_flush_interval > 0) {
+            s_flush_active.store(true);
+            s_flush_thread = std::thread(flush_thread_fn);
+
+            Log(1).stream() << "Aggregate: incremental flush every "
+                            << s_flush_interval << " seconds" << std::endl;
+        }
     }
 
     static void create_attribute_cb(Caliper* c, const Attribute& attr) {
         // Update key attributes
-        auto it = std::find(s_key_attribute_names.begin(), s_key_attribute_names.end(),
-                            attr.name());
+        for (KeyGroup& kg : s_keys) {
+            auto it = std::find(kg.attribute_names.begin(), kg.attribute_names.end(),
+                                attr.name());
+
+            // No lock: hope that update is more-or-less atomic, and
+            // consequences of invalid values are negligible
+            if (it != kg.attribute_names.end()) {
+                if (attr.store_as_value()) {
+                    cali_attr_type type = attr.type();
+
+                    if (type != CALI_TYPE_INT  &&
+                        type != CALI_TYPE_UINT &&
+                        type != CALI_TYPE_ADDR &&
+                        type != CALI_TYPE_BOOL &&
+                        type != CALI_TYPE_TYPE) {
+                        Log(1).stream() << "Aggregate: warning: type " << cali_type2string(type)
+                                        << " in as-value attribute \"" << attr.name()
+                                        << "\" is not supported in aggregation key and will be dropped."
+                                        << std::endl;
+                        continue;
+                    }
+                }
 
-        // No lock: hope that update is more-or-less atomic, and
-        // consequences of invalid values are negligible
-        if (it != s_key_attribute_names.end()) {
-            if (attr.store_as_value()) {
-                cali_attr_type type = attr.type();
+                kg.attributes[it-kg.attribute_names.begin()]    = attr;
+                kg.attribute_ids[it-kg.attribute_names.begin()] = attr.id();
 
-                if (type != CALI_TYPE_INT  &&
-                    type != CALI_TYPE_UINT &&
-                    type != CALI_TYPE_ADDR &&
-                    type != CALI_TYPE_BOOL &&   
-                    type != CALI_TYPE_TYPE) {
-                    Log(1).stream() << "Aggregate: warning: type " << cali_type2string(type)
-                                    << " in as-value attribute \"" << attr.name() 
-                                    << "\" is not supported in aggregation key and will be dropped." 
-                                    << std::endl;
-                    return;
-                }
+                ++s_key_version;
             }
-
-            s_key_attributes[it-s_key_attribute_names.begin()]    = attr;
-            s_key_attribute_ids[it-s_key_attribute_names.begin()] = attr.id();
         }
     }
 
     static void create_scope_cb(Caliper* c, cali_context_scope_t scope) {
-        // create new aggregation DB on thread
+        // create new aggregation DBs on thread
         if (scope == CALI_SCOPE_THREAD)
-            acquire(c, true);
+            for (unsigned grp = 0; grp < s_keys.size(); ++grp)
+                acquire(c, true, grp);
+    }
+
+    static void pre_flush_cb(Caliper* c, const SnapshotRecord*) {
+        // an external flush takes over: end incremental flushing
+        stop_flush_thread();
+
+        if (!s_checkpoint_file.empty())
+            write_checkpoint(c);
     }
 
     static void finish_cb(Caliper* c) {
+        stop_flush_thread();
+
         Log(2).stream() << "Aggregate: max key len " << s_global_max_keylen << ", "
-                        << s_global_num_kernel_entries << " entries, "
-                        << s_global_num_trie_entries << " nodes, "
-                        << s_global_num_trie_blocks + s_global_num_kernel_blocks << " blocks ("
-                        << s_global_num_trie_blocks * sizeof(TrieNode) * 1024
+                        << s_global_num_cache_hits << " node cache hits, "
+                        << s_global_num_kernel_entries << " kernel entries, "
+                        << s_global_num_entries << " key entries, "
+                        << s_global_num_entry_blocks + s_global_num_kernel_blocks << " blocks ("
+                        << s_global_num_entry_blocks * sizeof(HashEntry) * 1024
             + s_global_num_kernel_blocks * sizeof(AggregateKernel) * 1024
                         << " bytes reserved)"
                         << std::endl;
 
-        // report attribute keys we haven't found 
-        for (size_t i = 0; i < s_key_attribute_ids.size(); ++i)
-            if (s_key_attribute_ids[i] == CALI_INV_ID)
-                Log(1).stream() << "Aggregate: warning: key attribute \""
-                                << s_key_attribute_names[i]
-                                << "\" unused" << std::endl;
+        // report attribute keys we haven't found
+        for (const KeyGroup& kg : s_keys)
+            for (size_t i = 0; i < kg.attribute_ids.size(); ++i)
+                if (kg.attribute_ids[i] == CALI_INV_ID)
+                    Log(1).stream() << "Aggregate: warning: key attribute \""
+                                    << kg.attribute_names[i]
+                                    << "\" unused" << std::endl;
 
         if (s_global_num_dropped > 0)
             Log(1).stream() << "Aggregate: dropped " << s_global_num_dropped
                             << " snapshots." << std::endl;
+        if (s_global_num_spilled > 0)
+            Log(1).stream() << "Aggregate: spilled " << s_global_num_spilled
+                            << " entries as partial aggregates." << std::endl;
         if (s_global_num_skipped_keys > 0)
             Log(0).stream() << "Aggregate: warning: maximum key length exceeded " 
                             << s_global_num_skipped_keys
@@ -835,7 +2230,15 @@ public:
         c->events().create_attr_evt.connect(create_attribute_cb);
         c->events().post_init_evt.connect(post_init_cb);
         c->events().create_scope_evt.connect(create_scope_cb);
-        c->events().process_snapshot.connect(process_snapshot_cb);
+
+        std::string channel = s_config.get("channel").to_string();
+
+        if (channel.empty())
+            c->events().process_snapshot.connect(process_snapshot_cb);
+        else
+            c->channel(channel.c_str())->process_snapshot.connect(process_snapshot_cb);
+
+        c->events().pre_flush_evt.connect(pre_flush_cb);
         c->events().flush_evt.connect(flush_cb);
         c->events().finish_evt.connect(finish_cb);
 
@@ -852,32 +2255,106 @@ const ConfigSet::Entry AggregateDB::s_configdata[] = {
       "By default, aggregate all aggregatable attributes." },
     { "key",   CALI_TYPE_STRING, "",
       "List of attributes in the aggregation key",
-      "List of attributes in the aggregation key."
-      "If specified, only group by the given attributes." },
+      "List of attributes in the aggregation key.\n"
+      "If specified, only group by the given attributes.\n"
+      "Multiple ';'-separated attribute lists run as concurrent\n"
+      "aggregation instances, each producing its own set of records\n"
+      "(e.g. \"function;loop.id\" yields a per-function and a\n"
+      "per-loop profile from one run)." },
+    { "channel", CALI_TYPE_STRING, "",
+      "Snapshot channel to subscribe to",
+      "Subscribe to the given snapshot channel instead of the"
+      "global snapshot stream. The channel's trigger filter"
+      "(CALI_CHANNEL_<NAME>_TRIGGER) selects which snapshots"
+      "this service receives." },
+    { "calc_variance", CALI_TYPE_BOOL, "false",
+      "Calculate variance of aggregation attributes",
+      "Calculate variance of aggregation attributes"
+      "using Welford's streaming algorithm." },
+    { "calc_percentiles", CALI_TYPE_BOOL, "false",
+      "Estimate percentiles (p50/p95/p99) of aggregation attributes",
+      "Estimate percentiles (p50/p95/p99) of aggregation attributes"
+      "from a fixed-size log-scale histogram." },
+    { "flush_interval", CALI_TYPE_UINT, "0",
+      "Incremental flush interval in seconds (0: disabled)",
+      "Incremental flush interval in seconds. If set, a background thread\n"
+      "periodically swaps the per-thread aggregation databases for fresh\n"
+      "ones, merges the retired databases, and writes the aggregated\n"
+      "records to the output services. The records written by incremental\n"
+      "flushes are partial aggregates; the reader-side aggregator folds\n"
+      "them back together. 0 disables incremental flush." },
+    { "flush_threads", CALI_TYPE_UINT, "4",
+      "Parallelism hint for merging aggregation DBs at flush",
+      "Parallelism hint for merging the per-thread aggregation\n"
+      "databases into a single table at flush. The key hash space is\n"
+      "split into 4x this many partitions; the per-partition merge\n"
+      "tasks run on the shared flush pool (CALI_FLUSH_THREADS).\n"
+      "0 or 1 selects the serial flush, which writes each database's\n"
+      "entries separately." },
+    { "max_entries", CALI_TYPE_UINT, "0",
+      "Maximum number of entries per aggregation database (0: unbounded)",
+      "Maximum number of entries per per-thread aggregation database.\n"
+      "When a new key would exceed the limit, the least-recently-updated\n"
+      "entries are written to the output services as partial aggregate\n"
+      "records and evicted; the reader-side aggregator folds the partials\n"
+      "back together, so results stay exact while runtime memory stays\n"
+      "bounded even for very high-cardinality aggregation keys.\n"
+      "0 disables the limit." },
+    { "checkpoint", CALI_TYPE_STRING, "",
+      "Aggregation state checkpoint file",
+      "File for saving and restoring aggregation state across job\n"
+      "restarts. If set, the aggregation databases are written to the\n"
+      "given .cali file before each flush, and an existing file is read\n"
+      "back at startup so aggregation continues from the checkpointed\n"
+      "state; end-of-job output then covers the whole logical run.\n"
+      "Combine with flush_interval=0: incremental flushes clear the\n"
+      "databases, so the checkpoint would only cover the last interval.\n"
+      "Restored percentile estimates are approximate." },
     ConfigSet::Terminator
 };
 
 ConfigSet      AggregateDB::s_config;
 
+bool           AggregateDB::s_calc_variance    = false;
+bool           AggregateDB::s_calc_percentiles = false;
+bool           AggregateDB::s_use_hugepages    = false;
+
 Attribute      AggregateDB::s_count_attribute = Attribute::invalid;
 
-vector<string> AggregateDB::s_key_attribute_names;
-vector<Attribute> AggregateDB::s_key_attributes;
+vector<AggregateDB::KeyGroup> AggregateDB::s_keys;
 vector<Attribute> AggregateDB::s_aggr_attributes;
-vector<cali_id_t> AggregateDB::s_key_attribute_ids;
 vector<AggregateDB::StatisticsAttributes> AggregateDB::s_stats_attributes;
 
+std::atomic<unsigned> AggregateDB::s_key_version { 0 };
+
 pthread_key_t  AggregateDB::s_aggregate_db_key;
 
 AggregateDB*   AggregateDB::s_list = nullptr;
 util::spinlock AggregateDB::s_list_lock;
 
-size_t         AggregateDB::s_global_num_trie_entries   = 0;
+std::vector<AggregateDB*> AggregateDB::s_accum;
+std::mutex     AggregateDB::s_accum_lock;
+std::mutex     AggregateDB::s_flush_lock;
+
+unsigned          AggregateDB::s_flush_interval = 0;
+std::thread       AggregateDB::s_flush_thread;
+std::atomic<bool> AggregateDB::s_flush_active { false };
+
+unsigned          AggregateDB::s_flush_threads = 4;
+
+std::string       AggregateDB::s_checkpoint_file;
+
+size_t            AggregateDB::s_max_entries = 0;
+std::atomic<bool> AggregateDB::s_spill_announced { false };
+
+size_t         AggregateDB::s_global_num_entries        = 0;
 size_t         AggregateDB::s_global_num_kernel_entries = 0;
-size_t         AggregateDB::s_global_num_trie_blocks    = 0;
+size_t         AggregateDB::s_global_num_entry_blocks   = 0;
 size_t         AggregateDB::s_global_num_kernel_blocks  = 0;
 size_t         AggregateDB::s_global_num_dropped        = 0;
 size_t         AggregateDB::s_global_num_skipped_keys   = 0;
+size_t         AggregateDB::s_global_num_cache_hits     = 0;
+size_t         AggregateDB::s_global_num_spilled        = 0;
 size_t         AggregateDB::s_global_max_keylen         = 0;
 
 namespace cali
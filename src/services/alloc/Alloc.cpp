@@ -0,0 +1,233 @@
+// Copyright (c) 2015, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///\file  Alloc.cpp
+///\brief GOTCHA-based sampled allocation tracking service
+///
+/// Interposes malloc, calloc, realloc, and free, and takes a snapshot
+/// for every Nth allocation on each thread with the allocation size
+/// attached as an aggregatable attribute. Combined with the aggregate
+/// service this yields per-region heap allocation profiles. With the
+/// default 1-in-1000 sampling the wrapper cost for unsampled
+/// allocations is a thread-local counter decrement.
+
+#include "../CaliperService.h"
+
+#include "caliper/Caliper.h"
+#include "caliper/SnapshotRecord.h"
+
+#include "caliper/common/Log.h"
+#include "caliper/common/RuntimeConfig.h"
+#include "caliper/common/Variant.h"
+
+#include <gotcha/gotcha.h>
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+using namespace cali;
+
+namespace
+{
+
+ConfigSet        config;
+
+const ConfigSet::Entry s_configdata[] = {
+    { "sample_interval", CALI_TYPE_UINT, "1000",
+      "Take a snapshot for every N-th allocation",
+      "Take a snapshot for every N-th allocation on each thread.\n"
+      "Multiply aggregated byte counts by this interval to estimate\n"
+      "total allocation volume."
+    },
+    { "record_free", CALI_TYPE_BOOL, "false",
+      "Also sample free() calls",
+      "Also sample free() calls, recording the usable size of the\n"
+      "freed block as free.bytes."
+    },
+    ConfigSet::Terminator
+};
+
+cali_id_t alloc_bytes_attr_id = CALI_INV_ID;
+cali_id_t free_bytes_attr_id  = CALI_INV_ID;
+
+int64_t   sample_interval     = 1000;
+bool      record_free         = false;
+
+std::atomic<unsigned> n_samples;
+std::atomic<unsigned> n_processed_samples;
+
+// Per-thread sampling countdowns. Keeping unsampled calls to a single
+// decrement-and-test is what makes 1-in-N sampling cheap.
+
+thread_local int64_t  s_alloc_countdown = 1;
+thread_local int64_t  s_free_countdown  = 1;
+
+void sample(cali_id_t attr_id, uint64_t bytes)
+{
+    ++n_samples;
+
+    // sigsafe_instance() fails during initialization and while this
+    // thread processes a snapshot; that also stops the wrappers from
+    // recursing on Caliper's own allocations.
+
+    Caliper c = Caliper::sigsafe_instance();
+
+    if (!c)
+        return;
+
+    Variant v_bytes(bytes);
+
+    SnapshotRecord trigger_info(1, &attr_id, &v_bytes);
+
+    c.push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, &trigger_info);
+
+    ++n_processed_samples;
+}
+
+inline void count_allocation(uint64_t bytes)
+{
+    if (--s_alloc_countdown > 0)
+        return;
+
+    s_alloc_countdown = sample_interval;
+
+    sample(alloc_bytes_attr_id, bytes);
+}
+
+void* (*orig_malloc)(size_t)           = nullptr;
+void* (*orig_calloc)(size_t, size_t)   = nullptr;
+void* (*orig_realloc)(void*, size_t)   = nullptr;
+void  (*orig_free)(void*)              = nullptr;
+
+void* cali_malloc_wrapper(size_t size)
+{
+    void* ret = (*orig_malloc)(size);
+
+    if (ret)
+        count_allocation(size);
+
+    return ret;
+}
+
+void* cali_calloc_wrapper(size_t num, size_t size)
+{
+    void* ret = (*orig_calloc)(num, size);
+
+    if (ret)
+        count_allocation(num * size);
+
+    return ret;
+}
+
+void* cali_realloc_wrapper(void* ptr, size_t size)
+{
+    void* ret = (*orig_realloc)(ptr, size);
+
+    if (ret && size > 0)
+        count_allocation(size);
+
+    return ret;
+}
+
+void cali_free_wrapper(void* ptr)
+{
+    if (ptr && --s_free_countdown <= 0) {
+        s_free_countdown = sample_interval;
+
+        sample(free_bytes_attr_id, malloc_usable_size(ptr));
+    }
+
+    (*orig_free)(ptr);
+}
+
+struct gotcha_binding_t alloc_bindings[] = {
+    { "malloc",  (void*) cali_malloc_wrapper,  &orig_malloc  },
+    { "calloc",  (void*) cali_calloc_wrapper,  &orig_calloc  },
+    { "realloc", (void*) cali_realloc_wrapper, &orig_realloc }
+};
+
+struct gotcha_binding_t free_bindings[] = {
+    { "free",    (void*) cali_free_wrapper,    &orig_free    }
+};
+
+void finish_cb(Caliper* c)
+{
+    Log(1).stream() << "alloc: "
+                    << n_samples.load()           << " samples, "
+                    << n_processed_samples.load() << " processed" << std::endl;
+}
+
+void alloc_service_register(Caliper* c)
+{
+    config = RuntimeConfig::init("alloc", s_configdata);
+
+    sample_interval = std::max<int64_t>(config.get("sample_interval").to_uint(), 1);
+    record_free     = config.get("record_free").to_bool();
+
+    Attribute aggr_class_attr = c->get_attribute("class.aggregatable");
+    Variant   v_true(true);
+
+    alloc_bytes_attr_id =
+        c->create_attribute("alloc.bytes", CALI_TYPE_UINT,
+                            CALI_ATTR_ASVALUE      |
+                            CALI_ATTR_SCOPE_THREAD |
+                            CALI_ATTR_SKIP_EVENTS,
+                            1, &aggr_class_attr, &v_true).id();
+    free_bytes_attr_id  =
+        c->create_attribute("free.bytes",  CALI_TYPE_UINT,
+                            CALI_ATTR_ASVALUE      |
+                            CALI_ATTR_SCOPE_THREAD |
+                            CALI_ATTR_SKIP_EVENTS,
+                            1, &aggr_class_attr, &v_true).id();
+
+    c->events().finish_evt.connect(&finish_cb);
+
+    gotcha_wrap(alloc_bindings,
+                sizeof(alloc_bindings)/sizeof(alloc_bindings[0]), "Caliper");
+
+    if (record_free)
+        gotcha_wrap(free_bindings,
+                    sizeof(free_bindings)/sizeof(free_bindings[0]), "Caliper");
+
+    Log(1).stream() << "Registered alloc service, sampling 1 in "
+                    << sample_interval << " allocations" << std::endl;
+}
+
+} // namespace [anonymous]
+
+namespace cali
+{
+    CaliperService alloc_service { "alloc", ::alloc_service_register };
+}
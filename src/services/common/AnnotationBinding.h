@@ -92,23 +92,29 @@ public:
 
     template <class BindingT>
     static void make_binding(Caliper* c) {
-        BindingT* binding = new BindingT();
+        // The binding instance lives in a static so the capture-less
+        // lambdas below can refer to it: they convert to plain
+        // function pointers for the callback dispatch table.
+        static BindingT* binding = nullptr;
+
+        binding = new BindingT();
         binding->pre_initialize(c);
         binding->initialize(c);
 
         c->events().pre_create_attr_evt.connect(
-            [binding](Caliper* c, const std::string& name, cali_attr_type type, int* prop, Node** node){
+            [](Caliper* c, const std::string& name, cali_attr_type type, int* prop, Node** node){
                 binding->pre_create_attr_cb(c, name, type, prop, node);
             });
-        c->events().pre_begin_evt.connect([binding](Caliper* c,const Attribute& attr,const Variant& value){
+        c->events().pre_begin_evt.connect([](Caliper* c,const Attribute& attr,const Variant& value){
                 binding->begin_cb(c,attr,value);
             });
-        c->events().pre_end_evt.connect([binding](Caliper* c,const Attribute& attr,const Variant& value){
+        c->events().pre_end_evt.connect([](Caliper* c,const Attribute& attr,const Variant& value){
                 binding->end_cb(c,attr,value);
             });
-        c->events().finish_evt.connect([binding](Caliper* c){
+        c->events().finish_evt.connect([](Caliper* c){
                 binding->finalize(c);
                 delete binding;
+                binding = nullptr;
             });
 
         Log(1).stream() << "Registered " << binding->service_tag() << " binding" << std::endl;
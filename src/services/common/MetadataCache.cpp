@@ -0,0 +1,165 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file  MetadataCache.cpp
+/// \brief MetadataCache implementation
+
+#include "MetadataCache.h"
+
+#include "caliper/common/Log.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace cali;
+
+namespace
+{
+
+std::string job_id()
+{
+    const char* vars[] = { "SLURM_JOB_ID", "LSB_JOBID", "PBS_JOBID", "COBALT_JOBID" };
+
+    for (const char* var : vars) {
+        const char* val = std::getenv(var);
+
+        if (val && *val)
+            return std::string(val);
+    }
+
+    return std::string();
+}
+
+std::string cache_path(const std::string& key)
+{
+    std::string id = ::job_id();
+
+    if (id.empty())
+        return std::string();
+
+    std::string path = "/dev/shm/cali-cache-" + std::to_string(getuid()) + "-" + id + "-" + key;
+
+    // scheduler ids and keys are plain, but don't trust them blindly
+    for (std::string::size_type i = 9; i < path.size(); ++i)
+        if (!isalnum(path[i]) && path[i] != '-' && path[i] != '.' && path[i] != '_')
+            path[i] = '_';
+
+    return path;
+}
+
+std::string read_blob(const std::string& path)
+{
+    std::string blob;
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return blob;
+
+    struct stat st;
+
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+        if (p != MAP_FAILED) {
+            blob.assign(static_cast<char*>(p), st.st_size);
+            munmap(p, st.st_size);
+        }
+    }
+
+    close(fd);
+
+    return blob;
+}
+
+void publish_blob(const std::string& path, const std::string& blob)
+{
+    // write to a process-private file first, then atomically rename it
+    // into place so readers never see a partial blob
+
+    std::string tmp = path + "." + std::to_string(getpid());
+
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+
+    if (fd < 0)
+        return;
+
+    const char* p    = blob.data();
+    size_t      left = blob.size();
+    bool        ok   = true;
+
+    while (left > 0) {
+        ssize_t written = write(fd, p, left);
+
+        if (written < 0) {
+            ok = false;
+            break;
+        }
+
+        p    += written;
+        left -= written;
+    }
+
+    close(fd);
+
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+        unlink(tmp.c_str());
+}
+
+} // namespace
+
+std::string MetadataCache::fetch(const std::string& key, std::function<std::string()> capture)
+{
+    std::string path = ::cache_path(key);
+
+    if (path.empty())
+        return capture();
+
+    std::string blob = ::read_blob(path);
+
+    if (!blob.empty()) {
+        Log(2).stream() << "Using cached metadata from " << path << std::endl;
+        return blob;
+    }
+
+    blob = capture();
+
+    if (!blob.empty())
+        ::publish_blob(path, blob);
+
+    return blob;
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file  MetadataCache.h
+/// \brief Node-local cache for expensive startup metadata captures
+
+#pragma once
+
+#include <functional>
+#include <string>
+
+namespace cali
+{
+
+/// \brief Node-local cache for expensive startup metadata captures.
+///
+/// Services that gather identical metadata in every process of a job
+/// (e.g. by spawning shell commands) can route the capture through
+/// this cache: the first process on a node runs the capture and
+/// publishes the resulting blob under /dev/shm, keyed by the batch
+/// job id, and subsequent processes on the node mmap the published
+/// blob instead of repeating the capture. This turns a per-process
+/// fork/exec stampede at large scale into a single map.
+///
+/// Caching is only active when a batch job id can be determined from
+/// the environment (SLURM, LSF, PBS, or Cobalt); without one, stale
+/// entries from an earlier run could not be told apart from the
+/// current one, so the capture simply runs in every process.
+class MetadataCache
+{
+public:
+
+    /// \brief Return the blob cached under \a key, running \a capture
+    ///    to produce and publish it if no process on this node has yet.
+    ///
+    /// \a key must identify the capture including any configuration it
+    /// depends on; distinct configurations must use distinct keys.
+    static std::string fetch(const std::string& key, std::function<std::string()> capture);
+};
+
+} // namespace cali
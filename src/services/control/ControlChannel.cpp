@@ -0,0 +1,234 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @file  ControlChannel.cpp
+/// @brief Caliper runtime control channel service
+
+// The control service listens on a named pipe for commands and
+// executes them mid-run, so long-running jobs can turn on expensive
+// measurement services (e.g., tracing) only when something looks
+// wrong instead of running them always-on "just in case".
+//
+// Commands (one per line):
+//
+//   start <service>[:<service>...]   activate services at runtime
+//   enable / disable                 toggle annotation processing
+//   flush                            flush and write buffered snapshots
+//   quit                             stop listening
+//
+// Late-activated services miss the begin events of currently open
+// regions; after a start command, the service pushes one snapshot so
+// the current blackboard contents appear in their output. Commands
+// run on the listener thread: issue start commands at a reasonably
+// quiescent point, as callback registration is not synchronized
+// against concurrent snapshot processing.
+
+#include "../CaliperService.h"
+#include "../Services.h"
+
+#include "caliper/Caliper.h"
+
+#include "caliper/common/Log.h"
+#include "caliper/common/RuntimeConfig.h"
+
+#include "caliper/common/util/split.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+using namespace cali;
+using namespace std;
+
+// annotation fast-disable flag, defined in api.cpp
+extern int cali_enabled;
+
+namespace
+{
+
+const ConfigSet::Entry configdata[] = {
+    { "pipe", CALI_TYPE_STRING, "",
+      "Name of the command pipe",
+      "Name of the command (FIFO) pipe the control service listens on.\n"
+      "If empty, /tmp/caliper-<pid>.cmd is used."
+    },
+    ConfigSet::Terminator
+};
+
+ConfigSet         config;
+
+std::string       pipe_name;
+std::thread       listener;
+std::atomic<bool> done;
+
+void process_command(std::string cmd)
+{
+    // trim trailing whitespace
+    while (!cmd.empty() && isspace(cmd.back()))
+        cmd.pop_back();
+
+    if (cmd.empty())
+        return;
+
+    std::string arg;
+    std::string::size_type n = cmd.find(' ');
+
+    if (n != std::string::npos) {
+        arg = cmd.substr(n+1);
+        cmd = cmd.substr(0, n);
+    }
+
+    Log(1).stream() << "control: received command \"" << cmd
+                    << (arg.empty() ? "" : " ") << arg << "\"" << endl;
+
+    Caliper c;
+
+    if (cmd == "start") {
+        std::vector<std::string> services;
+
+        util::split(arg, ':', std::back_inserter(services));
+
+        bool started = false;
+
+        for (const std::string& s : services)
+            if (!s.empty())
+                started = Services::start_service(&c, s) || started;
+
+        if (started) {
+            // Late-activated services missed the begin events of open
+            // regions: push one snapshot so the current blackboard
+            // contents appear in their output
+            c.push_snapshot(CALI_SCOPE_PROCESS | CALI_SCOPE_THREAD, nullptr);
+        }
+    } else if (cmd == "enable") {
+        cali_enabled = 1;
+    } else if (cmd == "disable") {
+        cali_enabled = 0;
+    } else if (cmd == "flush") {
+        c.flush_and_write(nullptr);
+    } else if (cmd == "quit") {
+        done.store(true);
+    } else {
+        Log(0).stream() << "control: unknown command \"" << cmd << "\"" << endl;
+    }
+}
+
+void listen_fn()
+{
+    // Non-blocking reads so the listener can notice shutdown: with no
+    // writer, read() returns 0 and we sleep; with a writer attached
+    // but no data, it returns EAGAIN.
+
+    int fd = open(pipe_name.c_str(), O_RDONLY | O_NONBLOCK);
+
+    if (fd < 0) {
+        Log(0).stream() << "control: cannot open command pipe " << pipe_name
+                        << ": " << strerror(errno) << endl;
+        return;
+    }
+
+    std::string buf;
+    char        rd[256];
+
+    while (!done.load()) {
+        ssize_t n = read(fd, rd, sizeof(rd));
+
+        if (n > 0) {
+            buf.append(rd, n);
+
+            std::string::size_type p;
+
+            while ((p = buf.find('\n')) != std::string::npos) {
+                process_command(buf.substr(0, p));
+                buf.erase(0, p+1);
+            }
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(n == 0 ? 100 : 10));
+        }
+    }
+
+    close(fd);
+}
+
+void finish_cb(Caliper* c)
+{
+    done.store(true);
+
+    if (listener.joinable())
+        listener.join();
+
+    unlink(pipe_name.c_str());
+}
+
+void controlservice_register(Caliper* c)
+{
+    config = RuntimeConfig::init("control", configdata);
+
+    pipe_name = config.get("pipe").to_string();
+
+    if (pipe_name.empty()) {
+        ostringstream os;
+        os << "/tmp/caliper-" << getpid() << ".cmd";
+        pipe_name = os.str();
+    }
+
+    if (mkfifo(pipe_name.c_str(), 0600) != 0) {
+        Log(0).stream() << "control: cannot create command pipe " << pipe_name
+                        << ": " << strerror(errno) << endl;
+        return;
+    }
+
+    done.store(false);
+    listener = std::thread(listen_fn);
+
+    c->events().finish_evt.connect(&finish_cb);
+
+    Log(1).stream() << "Registered control service, listening on " << pipe_name << endl;
+}
+
+} // namespace
+
+namespace cali
+{
+    CaliperService control_service { "control", &::controlservice_register };
+}
@@ -47,7 +47,12 @@
 #include <nvToolsExt.h>
 #include <generated_nvtx_meta.h>
 
+#include <pthread.h>
+
+#include <cstring>
 #include <iterator>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 using namespace cali;
@@ -78,6 +83,15 @@ namespace
           "Record CUDA context ID for CUDA runtime and driver callbacks",
           "Record CUDA context ID for CUDA runtime and driver callbacks"
         },
+        { "buffered", CALI_TYPE_BOOL, "false",
+          "Buffer CUDA API events and translate them at flush",
+          "Buffer CUDA runtime and driver API events in per-thread\n"
+          "buffers during execution and translate them into Caliper\n"
+          "snapshots at flush, correlating enter/exit events by\n"
+          "correlation ID. Avoids blackboard updates and snapshot\n"
+          "processing inside the driver callback, which add latency\n"
+          "to every kernel launch."
+        },
         ConfigSet::Terminator
     };
 
@@ -106,6 +120,10 @@ namespace
         Attribute device_attr;
         Attribute stream_attr;
 
+        Attribute timestamp_attr;
+        Attribute duration_attr;
+        Attribute correlation_attr;
+
         bool      record_context;
         bool      record_symbol;
     }                      cupti_info;
@@ -118,6 +136,47 @@ namespace
     unsigned               num_sync_cb;
     unsigned               num_nvtx_cb;
 
+    //
+    // --- Buffered event recording
+    //
+
+    // Raw API event as recorded in the driver callback. Strings live
+    // in the buffer's string arena.
+    struct ApiEvent {
+        Attribute attr;           // runtime or driver API attribute
+        uint64_t  timestamp;
+        uint32_t  correlation_id;
+        bool      is_enter;
+        size_t    name_offset;    // offsets into the string arena,
+        size_t    symbol_offset;  //   (size_t)-1 if not set
+    };
+
+    struct EventBuffer {
+        std::vector<ApiEvent> events;
+        std::vector<char>     strings;
+
+        EventBuffer*          next = nullptr;
+
+        size_t intern(const char* str) {
+            if (!str)
+                return static_cast<size_t>(-1);
+
+            size_t ret = strings.size();
+            strings.insert(strings.end(), str, str + strlen(str) + 1);
+            return ret;
+        }
+
+        const char* string(size_t offset) const {
+            return offset == static_cast<size_t>(-1) ? nullptr : strings.data() + offset;
+        }
+    };
+
+    bool          buffered       = false;
+
+    pthread_key_t event_buf_key;
+    EventBuffer*  event_buf_list = nullptr;
+    std::mutex    event_buf_lock;
+
     //
     // --- Helper functions
     //
@@ -284,6 +343,128 @@ namespace
         }
     }
 
+    EventBuffer*
+    acquire_event_buf()
+    {
+        EventBuffer* ebuf = static_cast<EventBuffer*>(pthread_getspecific(event_buf_key));
+
+        if (!ebuf) {
+            ebuf = new EventBuffer;
+            ebuf->events.reserve(4096);
+
+            if (pthread_setspecific(event_buf_key, ebuf) == 0) {
+                std::lock_guard<std::mutex>
+                    g(event_buf_lock);
+
+                ebuf->next     = event_buf_list;
+                event_buf_list = ebuf;
+            } else {
+                Log(0).stream() << "cupti: error: unable to set thread event buffer" << std::endl;
+                delete ebuf;
+                ebuf = nullptr;
+            }
+        }
+
+        return ebuf;
+    }
+
+    // Buffered mode: record the raw API event and return. Translation
+    // into Caliper snapshots happens at flush.
+    void
+    handle_callback_buffered(CUpti_CallbackData* cbInfo, const Attribute& attr)
+    {
+        ++num_api_cb;
+
+        EventBuffer* ebuf = acquire_event_buf();
+
+        if (!ebuf)
+            return;
+
+        ApiEvent e;
+
+        e.attr           = attr;
+        e.correlation_id = cbInfo->correlationId;
+        e.is_enter       = (cbInfo->callbackSite == CUPTI_API_ENTER);
+        e.name_offset    = e.is_enter ?
+            ebuf->intern(cbInfo->functionName) : static_cast<size_t>(-1);
+        e.symbol_offset  = e.is_enter && cupti_info.record_symbol ?
+            ebuf->intern(cbInfo->symbolName)   : static_cast<size_t>(-1);
+
+        cuptiGetTimestamp(&e.timestamp);
+
+        ebuf->events.push_back(e);
+    }
+
+    // Translate the buffered API events into Caliper snapshots,
+    // matching enter/exit events by correlation ID
+    void
+    flush_event_buffers(Caliper* c, const SnapshotRecord*)
+    {
+        EventBuffer* ebuf = nullptr;
+
+        {
+            std::lock_guard<std::mutex>
+                g(event_buf_lock);
+
+            ebuf = event_buf_list;
+        }
+
+        size_t num_events = 0;
+
+        for ( ; ebuf; ebuf = ebuf->next) {
+            std::unordered_map<uint32_t, const ApiEvent*> open_events;
+
+            for (const ApiEvent& e : ebuf->events) {
+                if (e.is_enter) {
+                    open_events[e.correlation_id] = &e;
+                    continue;
+                }
+
+                auto it = open_events.find(e.correlation_id);
+
+                if (it == open_events.end())
+                    continue;
+
+                const ApiEvent* enter = it->second;
+                open_events.erase(it);
+
+                const char* name   = ebuf->string(enter->name_offset);
+                const char* symbol = ebuf->string(enter->symbol_offset);
+
+                if (!name)
+                    continue;
+
+                Attribute attr[5] = { enter->attr,
+                                      cupti_info.timestamp_attr,
+                                      cupti_info.duration_attr,
+                                      cupti_info.correlation_attr,
+                                      cupti_info.symbol_attr };
+                Variant   vals[5] = { Variant(CALI_TYPE_STRING, name, strlen(name)),
+                                      Variant(enter->timestamp),
+                                      Variant(e.timestamp - enter->timestamp),
+                                      Variant(static_cast<uint64_t>(e.correlation_id)),
+                                      symbol ?
+                                      Variant(CALI_TYPE_STRING, symbol, strlen(symbol)) : Variant() };
+
+                size_t n = symbol ? 5 : 4;
+
+                SnapshotRecord::FixedSnapshotRecord<8> trigger_info_data;
+                SnapshotRecord trigger_info(trigger_info_data);
+
+                c->make_entrylist(n, attr, vals, trigger_info);
+                c->push_snapshot(CALI_SCOPE_PROCESS | CALI_SCOPE_THREAD, &trigger_info);
+
+                ++num_events;
+            }
+
+            ebuf->events.clear();
+            ebuf->strings.clear();
+        }
+
+        Log(2).stream() << "cupti: flushed " << num_events << " buffered events."
+                        << std::endl;
+    }
+
     void
     handle_nvtx(CUpti_CallbackId cbid, CUpti_NvtxData* cbInfo)
     {
@@ -351,12 +532,20 @@ namespace
                                static_cast<CUpti_SynchronizeData*>(cbInfo));
             break;
         case CUPTI_CB_DOMAIN_RUNTIME_API:
-            handle_callback(cbid, static_cast<CUpti_CallbackData*>(cbInfo),
-                            cupti_info.runtime_attr);
+            if (buffered)
+                handle_callback_buffered(static_cast<CUpti_CallbackData*>(cbInfo),
+                                         cupti_info.runtime_attr);
+            else
+                handle_callback(cbid, static_cast<CUpti_CallbackData*>(cbInfo),
+                                cupti_info.runtime_attr);
             break;
         case CUPTI_CB_DOMAIN_DRIVER_API:
-            handle_callback(cbid, static_cast<CUpti_CallbackData*>(cbInfo),
-                            cupti_info.driver_attr);
+            if (buffered)
+                handle_callback_buffered(static_cast<CUpti_CallbackData*>(cbInfo),
+                                         cupti_info.driver_attr);
+            else
+                handle_callback(cbid, static_cast<CUpti_CallbackData*>(cbInfo),
+                                cupti_info.driver_attr);
             break;
         case CUPTI_CB_DOMAIN_NVTX:
             handle_nvtx(cbid, static_cast<CUpti_NvtxData*>(cbInfo));
@@ -381,6 +570,16 @@ namespace
 
         cuptiUnsubscribe(subscriber);
         cuptiFinalize();
+
+        if (buffered) {
+            while (event_buf_list) {
+                EventBuffer* ebuf = event_buf_list;
+                event_buf_list = ebuf->next;
+                delete ebuf;
+            }
+
+            pthread_key_delete(event_buf_key);
+        }
     }
 
     void
@@ -408,6 +607,18 @@ namespace
         cupti_info.stream_attr =
             c->create_attribute("cupti.streamID",   CALI_TYPE_UINT,   CALI_ATTR_SKIP_EVENTS);
 
+        if (buffered) {
+            cupti_info.timestamp_attr =
+                c->create_attribute("cupti.timestamp", CALI_TYPE_UINT,
+                                    CALI_ATTR_ASVALUE | CALI_ATTR_SKIP_EVENTS);
+            cupti_info.duration_attr =
+                c->create_attribute("cupti.duration",  CALI_TYPE_UINT,
+                                    CALI_ATTR_ASVALUE | CALI_ATTR_SKIP_EVENTS);
+            cupti_info.correlation_attr =
+                c->create_attribute("cupti.correlationID", CALI_TYPE_UINT,
+                                    CALI_ATTR_ASVALUE | CALI_ATTR_SKIP_EVENTS);
+        }
+
         cupti_info.record_context = config.get("record_context").to_bool();
         cupti_info.record_symbol = config.get("record_symbol").to_bool();
     }
@@ -470,12 +681,22 @@ namespace
         num_sync_cb     = 0;
         num_nvtx_cb     = 0;
 
+        buffered = config.get("buffered").to_bool();
+
+        if (buffered && pthread_key_create(&event_buf_key, nullptr) != 0) {
+            Log(0).stream() << "cupti: error: pthread_key_create() failed" << std::endl;
+            buffered = false;
+        }
+
         if (!register_callback_domains())
             return;
 
         c->events().post_init_evt.connect(&post_init_cb);
         c->events().finish_evt.connect(&finish_cb);
 
+        if (buffered)
+            c->events().pre_flush_evt.connect(&flush_event_buffers);
+
         Log(1).stream() << "Registered cupti service" << std::endl;
     }
 
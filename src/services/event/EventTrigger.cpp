@@ -44,7 +44,9 @@
 #include "caliper/common/util/split.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <iterator>
 #include <map>
 #include <mutex>
@@ -68,6 +70,53 @@ const ConfigSet::Entry   configdata[] = {
       "Enable snapshot info records",
       "Enable snapshot info records."
     },
+    { "throttle", CALI_TYPE_BOOL, "false",
+      "Throttle high-frequency trigger attributes to 1-in-N sampling",
+      "Throttle high-frequency trigger attributes to 1-in-N sampling.\n"
+      "Once a trigger attribute's event rate exceeds the throttle_threshold,\n"
+      "only every N-th event records a snapshot. The skip factor N is doubled\n"
+      "or halved as the event rate changes, and is recorded in the snapshot\n"
+      "(cali.event.skip) so that aggregated counts can be rescaled."
+    },
+    { "throttle_threshold", CALI_TYPE_UINT, "100000",
+      "Trigger event rate (events/second) above which snapshots are sampled",
+      "Trigger event rate (events/second) above which snapshots are sampled"
+    },
+    { "coalesce_ends", CALI_TYPE_BOOL, "false",
+      "Coalesce rapid cascades of region end events into one snapshot",
+      "Coalesce rapid cascades of region end events into one snapshot.\n"
+      "When nested regions unwind with no intervening work (inter-end\n"
+      "gap below coalesce_threshold), only the innermost end records a\n"
+      "snapshot; it carries the full region list being unwound. The\n"
+      "number of ends folded into the preceding end record is attached\n"
+      "to the next snapshot (cali.event.coalesced) so trace readers\n"
+      "can reconstruct per-level durations."
+    },
+    { "coalesce_threshold", CALI_TYPE_UINT, "50000",
+      "Maximum gap (in nanoseconds) between coalesced end events",
+      "Maximum gap (in nanoseconds) between coalesced end events"
+    },
+    { "no_event_attributes", CALI_TYPE_STRING, "",
+      "List of attributes whose regions suppress snapshot triggering",
+      "Colon-separated list of attributes marked \"no-events\": while\n"
+      "such a region is active, neither it nor any begin/set/end event\n"
+      "nested inside it triggers snapshots. Unlike per-attribute\n"
+      "trigger lists, the suppression is inherited by nested regions.\n"
+      "The regions remain annotated and appear as context in snapshots\n"
+      "taken by other means."
+    },
+    { "include_regions", CALI_TYPE_STRING, "",
+      "Region name prefixes that trigger snapshots",
+      "Colon-separated list of region name prefixes. If set, only\n"
+      "begin/set/end events whose value matches one of the prefixes\n"
+      "trigger snapshots. Only applies to string-valued attributes."
+    },
+    { "exclude_regions", CALI_TYPE_STRING, "",
+      "Region name prefixes that do not trigger snapshots",
+      "Colon-separated list of region name prefixes. Begin/set/end\n"
+      "events whose value matches one of the prefixes do not trigger\n"
+      "snapshots. Only applies to string-valued attributes."
+    },
 
     ConfigSet::Terminator
 };
@@ -93,6 +142,298 @@ Attribute                trigger_level_attr { Attribute::invalid };
 
 Attribute                event_info_attr    { Attribute::invalid };
 
+Attribute                trigger_skip_attr  { Attribute::invalid };
+
+//
+// --- Trigger attribute bitmap
+//
+
+// Dense bitmap of trigger attribute ids, filled as attributes are
+// created. The event callbacks dismiss non-trigger attributes with a
+// single bit test before touching throttle state or walking the
+// attribute's metadata. Ids beyond the bitmap take the regular path.
+
+const size_t             TRIGGER_BITMAP_WORDS = 1024; // covers 65536 ids
+
+std::atomic<uint64_t>    trigger_bitmap[TRIGGER_BITMAP_WORDS];
+std::atomic<uint64_t>    noevent_bitmap[TRIGGER_BITMAP_WORDS];
+
+inline void set_bitmap_bit(std::atomic<uint64_t>* bitmap, cali_id_t id)
+{
+    if (id / 64 < TRIGGER_BITMAP_WORDS)
+        bitmap[id / 64].fetch_or(static_cast<uint64_t>(1) << (id % 64),
+                                 std::memory_order_relaxed);
+}
+
+inline bool test_bitmap_bit(const std::atomic<uint64_t>* bitmap, cali_id_t id)
+{
+    return bitmap[id / 64].load(std::memory_order_relaxed)
+        & (static_cast<uint64_t>(1) << (id % 64));
+}
+
+inline void set_trigger_bit(cali_id_t id)
+{
+    set_bitmap_bit(trigger_bitmap, id);
+}
+
+inline bool is_trigger_attribute(cali_id_t id)
+{
+    if (id / 64 >= TRIGGER_BITMAP_WORDS)
+        return true;
+
+    return test_bitmap_bit(trigger_bitmap, id);
+}
+
+//
+// --- No-event region suppression
+//
+
+// Attributes listed in no_event_attributes mark "no-events" regions:
+// while one is on the blackboard, begin/set/end events - the region's
+// own and any nested inside it - don't trigger snapshots. The nesting
+// depth is kept in a hidden blackboard counter, so the suppression is
+// inherited by nested regions, which a per-attribute trigger list
+// can't express. The regions themselves remain annotated.
+
+std::vector<std::string> no_event_attr_names;
+
+bool                     no_event_active = false;
+
+Attribute                noevt_lvl_attr { Attribute::invalid };
+
+std::atomic<uint64_t>    num_no_event_suppressed;
+
+inline bool is_no_event_attribute(cali_id_t id)
+{
+    if (id / 64 >= TRIGGER_BITMAP_WORDS)
+        return false;
+
+    return test_bitmap_bit(noevent_bitmap, id);
+}
+
+inline void push_no_event_region(Caliper* c)
+{
+    uint64_t lvl = 1;
+    Variant  v_lvl(lvl), v_p_lvl;
+
+    v_p_lvl = c->exchange(noevt_lvl_attr, v_lvl);
+    lvl     = v_p_lvl.to_uint();
+
+    if (lvl > 0)
+        c->set(noevt_lvl_attr, Variant(++lvl));
+}
+
+inline void pop_no_event_region(Caliper* c)
+{
+    uint64_t lvl = 0;
+    Variant  v_p_lvl = c->exchange(noevt_lvl_attr, Variant(lvl));
+
+    lvl = v_p_lvl.to_uint();
+
+    if (lvl > 1)
+        c->set(noevt_lvl_attr, Variant(--lvl));
+}
+
+inline bool in_no_event_region(Caliper* c)
+{
+    return c->get(noevt_lvl_attr).value().to_uint() > 0;
+}
+
+//
+// --- Region filter
+//
+
+// Include/exclude lists of region name prefixes, compiled into
+// character tries at registration. The begin/set/end callbacks check
+// the event value against the tries before the snapshot machinery
+// engages, so filtered regions only pay for the trie walk.
+
+struct PrefixTrie {
+    struct TrieNode {
+        int  next[256];
+        bool terminal;
+
+        TrieNode()
+            : terminal(false) {
+            std::fill(next, next+256, -1);
+        }
+    };
+
+    std::vector<TrieNode> nodes; // nodes[0] is the root
+
+    bool empty() const {
+        return nodes.empty();
+    }
+
+    void clear() {
+        nodes.clear();
+    }
+
+    void add(const std::string& prefix) {
+        if (nodes.empty())
+            nodes.push_back(TrieNode());
+
+        int n = 0;
+
+        for (char c : prefix) {
+            int next = nodes[n].next[static_cast<unsigned char>(c)];
+
+            if (next < 0) {
+                next = static_cast<int>(nodes.size());
+                nodes[n].next[static_cast<unsigned char>(c)] = next;
+                nodes.push_back(TrieNode());
+            }
+
+            n = next;
+        }
+
+        nodes[n].terminal = true;
+    }
+
+    bool match(const char* str, size_t len) const {
+        if (nodes.empty())
+            return false;
+
+        int n = 0;
+
+        for (size_t i = 0; ; ++i) {
+            if (nodes[n].terminal)
+                return true;
+            if (i >= len)
+                return false;
+
+            n = nodes[n].next[static_cast<unsigned char>(str[i])];
+
+            if (n < 0)
+                return false;
+        }
+    }
+};
+
+PrefixTrie            include_regions;
+PrefixTrie            exclude_regions;
+
+bool                  region_filter_active = false;
+
+std::atomic<uint64_t> num_region_filtered;
+
+// Check the event value against the region filter. Only string values
+// are filtered: other value types always pass.
+inline bool region_filter_pass(const Variant& value)
+{
+    if (value.type() != CALI_TYPE_STRING)
+        return true;
+
+    const char* str = static_cast<const char*>(value.data());
+    size_t      len = value.size();
+
+    if (!exclude_regions.empty() && exclude_regions.match(str, len))
+        return false;
+    if (!include_regions.empty() && !include_regions.match(str, len))
+        return false;
+
+    return true;
+}
+
+//
+// --- End-event coalescing
+//
+
+// With coalesce_ends, a cascade of end events with no intervening
+// work - detected by an inter-end gap below coalesce_threshold on the
+// same thread - emits only its first snapshot. That snapshot is taken
+// before the innermost region pops, so it carries the full region list
+// being unwound; deep phase exits pay for one snapshot instead of one
+// per level. The number of ends folded into the preceding end record
+// is attached to the next emitted snapshot (cali.event.coalesced).
+// Begin and set events reset the cascade: an end after them always
+// records a snapshot.
+
+bool                  coalesce_ends      = false;
+uint64_t              coalesce_threshold = 50000;
+
+Attribute             coalesce_attr { Attribute::invalid };
+
+struct CoalesceState {
+    uint64_t last_end_nsec { 0 };
+    uint64_t pending       { 0 }; // ends folded into the last emitted end snapshot
+};
+
+thread_local CoalesceState coalesce_state;
+
+std::atomic<uint64_t> num_coalesced;
+
+inline uint64_t clock_nsec()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//
+// --- Adaptive throttling
+//
+
+// Per-trigger-attribute event counters, hashed by attribute id.
+// Attributes that collide on a table entry share a throttle state.
+
+const size_t   THROTTLE_TABLE_SIZE     = 256;
+const uint64_t THROTTLE_CHECK_INTERVAL = 256;
+const uint64_t THROTTLE_MAX_SKIP       = 1 << 20;
+
+struct ThrottleState {
+    std::atomic<uint64_t> count      { 0 }; // events seen, incl. skipped ones
+    std::atomic<uint64_t> skip       { 1 }; // record every skip-th event
+    std::atomic<uint64_t> last_check { 0 }; // time of last rate check (ns)
+};
+
+ThrottleState            throttle_table[THROTTLE_TABLE_SIZE];
+
+bool                     throttle           = false;
+uint64_t                 throttle_threshold = 100000;
+
+std::atomic<uint64_t>    num_throttled;
+
+/// Count an event on \a attr's throttle state and decide whether it
+/// should record a snapshot. Every THROTTLE_CHECK_INTERVAL events, the
+/// event rate is re-evaluated and the skip factor is doubled (rate above
+/// threshold) or halved (rate below a quarter of the threshold).
+bool throttle_pass(const Attribute& attr, uint64_t* skip_out)
+{
+    ThrottleState& s = throttle_table[attr.id() % THROTTLE_TABLE_SIZE];
+
+    uint64_t count = 1 + s.count.fetch_add(1, std::memory_order_relaxed);
+    uint64_t skip  = s.skip.load(std::memory_order_relaxed);
+
+    if (count % THROTTLE_CHECK_INTERVAL == 0) {
+        uint64_t now  =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        uint64_t last = s.last_check.exchange(now, std::memory_order_relaxed);
+
+        if (last > 0 && now > last) {
+            uint64_t rate = THROTTLE_CHECK_INTERVAL * 1000000000 / (now - last);
+
+            if (rate > throttle_threshold && skip < THROTTLE_MAX_SKIP) {
+                s.skip.store(2 * skip, std::memory_order_relaxed);
+
+                Log(2).stream() << "Event: Throttling attribute " << attr.name()
+                                << ": sampling 1 in " << 2 * skip << endl;
+            } else if (rate < throttle_threshold / 4 && skip > 1) {
+                s.skip.store(skip / 2, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    *skip_out = skip;
+
+    if (skip > 1 && count % skip != 0) {
+        num_throttled.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
+
 EventAttributes
 make_event_attributes(Caliper* c, const std::string& name, cali_attr_type type, int prop)
 {
@@ -134,6 +475,13 @@ pre_create_attribute_cb(Caliper* c, const std::string& name, cali_attr_type type
     if (*prop & CALI_ATTR_SKIP_EVENTS)
         return;
 
+    // No-event attributes keep their events so the callbacks can track
+    // the suppression depth, but get no event info metadata
+    if (no_event_active
+        && std::find(no_event_attr_names.begin(), no_event_attr_names.end(),
+                     name) != no_event_attr_names.end())
+        return;
+
     std::vector<std::string>::iterator it =
         std::find(trigger_attr_names.begin(), trigger_attr_names.end(), name);
 
@@ -156,12 +504,62 @@ pre_create_attribute_cb(Caliper* c, const std::string& name, cali_attr_type type
     }
 }
 
+void create_attr_cb(Caliper* c, const Attribute& attr)
+{
+    // Non-trigger attributes got CALI_ATTR_SKIP_EVENTS in
+    // pre_create_attribute_cb; everything else triggers snapshots.
+
+    if (attr.skip_events())
+        return;
+
+    if (no_event_active
+        && std::find(no_event_attr_names.begin(), no_event_attr_names.end(),
+                     attr.name()) != no_event_attr_names.end()) {
+        set_bitmap_bit(noevent_bitmap, attr.id());
+        return;
+    }
+
+    set_trigger_bit(attr.id());
+}
+
 void event_begin_cb(Caliper* c, const Attribute& attr, const Variant& value)
 {
+    if (no_event_active) {
+        if (is_no_event_attribute(attr.id())) {
+            push_no_event_region(c);
+            return;
+        }
+        if (in_no_event_region(c)) {
+            num_no_event_suppressed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    if (!is_trigger_attribute(attr.id()))
+        return;
+
+    if (coalesce_ends)
+        coalesce_state.last_end_nsec = 0;
+
+    if (region_filter_active && !region_filter_pass(value)) {
+        num_region_filtered.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint64_t skip = 1;
+
+    if (throttle && !throttle_pass(attr, &skip))
+        return;
+
     if (enable_snapshot_info) {
         Variant v_ids = attr.get(event_info_attr);
 
-        assert(!v_ids.empty());
+        if (v_ids.empty()) {
+            // Attribute created before the event service attached: it
+            // carries no event info metadata, push a plain snapshot
+            c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, nullptr);
+            return;
+        }
 
         const cali_id_t* evt_info_attr_ids =
             static_cast<const cali_id_t*>(v_ids.data());
@@ -194,13 +592,28 @@ void event_begin_cb(Caliper* c, const Attribute& attr, const Variant& value)
 
         // Construct the trigger info entry
 
-        Attribute attrs[3] = { trigger_level_attr, trigger_begin_attr, begin_attr };
-        Variant    vals[3] = { v_lvl, Variant(attr.id()), value };
+        Attribute attrs[5] = { trigger_level_attr, trigger_begin_attr, begin_attr };
+        Variant    vals[5] = { v_lvl, Variant(attr.id()), value };
 
-        SnapshotRecord::FixedSnapshotRecord<3> trigger_info_data;
+        size_t     n_info  = 3;
+
+        if (skip > 1) {
+            attrs[n_info] = trigger_skip_attr;
+            vals[n_info]  = Variant(skip);
+            ++n_info;
+        }
+        if (coalesce_ends && coalesce_state.pending > 0) {
+            attrs[n_info] = coalesce_attr;
+            vals[n_info]  = Variant(coalesce_state.pending);
+            ++n_info;
+
+            coalesce_state.pending = 0;
+        }
+
+        SnapshotRecord::FixedSnapshotRecord<5> trigger_info_data;
         SnapshotRecord trigger_info(trigger_info_data);
 
-        c->make_entrylist(3, attrs, vals, trigger_info);
+        c->make_entrylist(n_info, attrs, vals, trigger_info);
         c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, &trigger_info);
     } else {
         c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, nullptr);
@@ -209,10 +622,41 @@ void event_begin_cb(Caliper* c, const Attribute& attr, const Variant& value)
 
 void event_set_cb(Caliper* c, const Attribute& attr, const Variant& value)
 {
+    if (no_event_active) {
+        // set() replaces the previous region: the suppression depth
+        // doesn't change
+        if (is_no_event_attribute(attr.id()))
+            return;
+
+        if (in_no_event_region(c)) {
+            num_no_event_suppressed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    if (!is_trigger_attribute(attr.id()))
+        return;
+
+    if (coalesce_ends)
+        coalesce_state.last_end_nsec = 0;
+
+    if (region_filter_active && !region_filter_pass(value)) {
+        num_region_filtered.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint64_t skip = 1;
+
+    if (throttle && !throttle_pass(attr, &skip))
+        return;
+
     if (enable_snapshot_info) {
         Variant v_ids = attr.get(event_info_attr);
 
-        assert(!v_ids.empty());
+        if (v_ids.empty()) {
+            c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, nullptr);
+            return;
+        }
 
         const cali_id_t* evt_info_attr_ids =
             static_cast<const cali_id_t*>(v_ids.data());
@@ -231,13 +675,28 @@ void event_set_cb(Caliper* c, const Attribute& attr, const Variant& value)
 
         // Construct the trigger info entry
 
-        Attribute attrs[3] = { trigger_level_attr, trigger_set_attr, set_attr };
-        Variant    vals[3] = { v_lvl, Variant(attr.id()), value };
+        Attribute attrs[5] = { trigger_level_attr, trigger_set_attr, set_attr };
+        Variant    vals[5] = { v_lvl, Variant(attr.id()), value };
 
-        SnapshotRecord::FixedSnapshotRecord<3> trigger_info_data;
+        size_t     n_info  = 3;
+
+        if (skip > 1) {
+            attrs[n_info] = trigger_skip_attr;
+            vals[n_info]  = Variant(skip);
+            ++n_info;
+        }
+        if (coalesce_ends && coalesce_state.pending > 0) {
+            attrs[n_info] = coalesce_attr;
+            vals[n_info]  = Variant(coalesce_state.pending);
+            ++n_info;
+
+            coalesce_state.pending = 0;
+        }
+
+        SnapshotRecord::FixedSnapshotRecord<5> trigger_info_data;
         SnapshotRecord trigger_info(trigger_info_data);
 
-        c->make_entrylist(3, attrs, vals, trigger_info);
+        c->make_entrylist(n_info, attrs, vals, trigger_info);
         c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, &trigger_info);
     } else {
         c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, nullptr);
@@ -246,10 +705,74 @@ void event_set_cb(Caliper* c, const Attribute& attr, const Variant& value)
 
 void event_end_cb(Caliper* c, const Attribute& attr, const Variant& value)
 {
+    if (no_event_active) {
+        if (is_no_event_attribute(attr.id())) {
+            pop_no_event_region(c);
+            return;
+        }
+        if (in_no_event_region(c)) {
+            // Nested begins were suppressed, too, so the per-attribute
+            // level bookkeeping stays balanced
+            num_no_event_suppressed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    if (!is_trigger_attribute(attr.id()))
+        return;
+
+    if (region_filter_active && !region_filter_pass(value)) {
+        num_region_filtered.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (coalesce_ends) {
+        uint64_t now = clock_nsec();
+
+        if (coalesce_state.last_end_nsec > 0
+            && now - coalesce_state.last_end_nsec < coalesce_threshold) {
+            // Part of an end cascade: the preceding end snapshot already
+            // carries this region, so fold this end into it. Only the
+            // per-attribute nesting level bookkeeping still runs.
+
+            coalesce_state.last_end_nsec = now;
+            ++coalesce_state.pending;
+
+            num_coalesced.fetch_add(1, std::memory_order_relaxed);
+
+            if (enable_snapshot_info) {
+                Variant v_ids = attr.get(event_info_attr);
+
+                if (!v_ids.empty()) {
+                    Attribute lvl_attr =
+                        c->get_attribute(static_cast<const cali_id_t*>(v_ids.data())[3]);
+
+                    Variant  v_p_lvl = c->exchange(lvl_attr, Variant(static_cast<uint64_t>(0)));
+                    uint64_t lvl     = v_p_lvl.to_uint();
+
+                    if (lvl > 1)
+                        c->set(lvl_attr, Variant(--lvl));
+                }
+            }
+
+            return;
+        }
+
+        coalesce_state.last_end_nsec = now;
+    }
+
+    uint64_t skip = 1;
+
+    if (throttle && !throttle_pass(attr, &skip))
+        return;
+
     if (enable_snapshot_info) {
         Variant v_ids = attr.get(event_info_attr);
 
-        assert(!v_ids.empty());
+        if (v_ids.empty()) {
+            c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, nullptr);
+            return;
+        }
 
         const cali_id_t* evt_info_attr_ids =
             static_cast<const cali_id_t*>(v_ids.data());
@@ -277,19 +800,50 @@ void event_end_cb(Caliper* c, const Attribute& attr, const Variant& value)
 
         // Construct the trigger info entry with previous level
 
-        Attribute attrs[3] = { trigger_level_attr, trigger_end_attr, end_attr };
-        Variant    vals[3] = { v_p_lvl, Variant(attr.id()), value };
+        Attribute attrs[5] = { trigger_level_attr, trigger_end_attr, end_attr };
+        Variant    vals[5] = { v_p_lvl, Variant(attr.id()), value };
+
+        size_t     n_info  = 3;
+
+        if (skip > 1) {
+            attrs[n_info] = trigger_skip_attr;
+            vals[n_info]  = Variant(skip);
+            ++n_info;
+        }
+        if (coalesce_ends && coalesce_state.pending > 0) {
+            attrs[n_info] = coalesce_attr;
+            vals[n_info]  = Variant(coalesce_state.pending);
+            ++n_info;
 
-        SnapshotRecord::FixedSnapshotRecord<3> trigger_info_data;
+            coalesce_state.pending = 0;
+        }
+
+        SnapshotRecord::FixedSnapshotRecord<5> trigger_info_data;
         SnapshotRecord trigger_info(trigger_info_data);
 
-        c->make_entrylist(3, attrs, vals, trigger_info);
+        c->make_entrylist(n_info, attrs, vals, trigger_info);
         c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, &trigger_info);
     } else {
         c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, nullptr);
     }
 }
 
+void event_finish_cb(Caliper* c)
+{
+    if (num_throttled.load() > 0)
+        Log(1).stream() << "Event: throttled " << num_throttled.load()
+                        << " snapshots." << endl;
+    if (num_region_filtered.load() > 0)
+        Log(1).stream() << "Event: filtered " << num_region_filtered.load()
+                        << " region events." << endl;
+    if (num_coalesced.load() > 0)
+        Log(1).stream() << "Event: coalesced " << num_coalesced.load()
+                        << " end events." << endl;
+    if (num_no_event_suppressed.load() > 0)
+        Log(1).stream() << "Event: suppressed " << num_no_event_suppressed.load()
+                        << " events in no-event regions." << endl;
+}
+
 void event_trigger_register(Caliper* c)
 {
     // parse the configuration & set up triggers
@@ -301,6 +855,78 @@ void event_trigger_register(Caliper* c)
 
     enable_snapshot_info = config.get("enable_snapshot_info").to_bool();
 
+    throttle             = config.get("throttle").to_bool();
+    throttle_threshold   = config.get("throttle_threshold").to_uint();
+
+    num_throttled.store(0);
+
+    coalesce_ends        = config.get("coalesce_ends").to_bool();
+    coalesce_threshold   = config.get("coalesce_threshold").to_uint();
+
+    num_coalesced.store(0);
+
+    // compile the region filter prefixes into tries
+
+    include_regions.clear();
+    exclude_regions.clear();
+
+    {
+        std::vector<std::string> prefixes;
+
+        util::split(config.get("include_regions").to_string(), ':',
+                    std::back_inserter(prefixes));
+
+        for (const std::string& p : prefixes)
+            if (!p.empty())
+                include_regions.add(p);
+
+        prefixes.clear();
+
+        util::split(config.get("exclude_regions").to_string(), ':',
+                    std::back_inserter(prefixes));
+
+        for (const std::string& p : prefixes)
+            if (!p.empty())
+                exclude_regions.add(p);
+    }
+
+    region_filter_active = !(include_regions.empty() && exclude_regions.empty());
+
+    num_region_filtered.store(0);
+
+    util::split(config.get("no_event_attributes").to_string(), ':',
+                std::back_inserter(no_event_attr_names));
+
+    no_event_attr_names.erase(
+        std::remove(no_event_attr_names.begin(), no_event_attr_names.end(), std::string()),
+        no_event_attr_names.end());
+
+    no_event_active = !no_event_attr_names.empty();
+
+    num_no_event_suppressed.store(0);
+
+    if (no_event_active)
+        noevt_lvl_attr =
+            c->create_attribute("cali.event.noevt.lvl",
+                                CALI_TYPE_UINT,
+                                CALI_ATTR_ASVALUE     |
+                                CALI_ATTR_HIDDEN      |
+                                CALI_ATTR_SKIP_EVENTS);
+
+    if (throttle)
+        trigger_skip_attr =
+            c->create_attribute("cali.event.skip",
+                                CALI_TYPE_UINT,
+                                CALI_ATTR_ASVALUE |
+                                CALI_ATTR_SKIP_EVENTS);
+
+    if (coalesce_ends)
+        coalesce_attr =
+            c->create_attribute("cali.event.coalesced",
+                                CALI_TYPE_UINT,
+                                CALI_ATTR_ASVALUE |
+                                CALI_ATTR_SKIP_EVENTS);
+
     // register trigger events
 
     if (enable_snapshot_info) {
@@ -328,11 +954,36 @@ void event_trigger_register(Caliper* c)
     // register callbacks
 
     c->events().pre_create_attr_evt.connect(&pre_create_attribute_cb);
+    c->events().create_attr_evt.connect(&create_attr_cb);
 
     c->events().pre_begin_evt.connect(&event_begin_cb);
     c->events().pre_set_evt.connect(&event_set_cb);
     c->events().pre_end_evt.connect(&event_end_cb);
 
+    if (throttle || region_filter_active || coalesce_ends || no_event_active)
+        c->events().finish_evt.connect(&event_finish_cb);
+
+    // Late activation: seed the trigger bitmap with the attributes
+    // that already exist. Their nodes carry no event info metadata,
+    // so the event callbacks record plain snapshots for them.
+
+    for (const Attribute& attr : c->get_attributes()) {
+        if (attr.skip_events())
+            continue;
+        if (no_event_active
+            && std::find(no_event_attr_names.begin(), no_event_attr_names.end(),
+                         attr.name()) != no_event_attr_names.end()) {
+            set_bitmap_bit(noevent_bitmap, attr.id());
+            continue;
+        }
+        if (trigger_attr_names.size() > 0
+            && std::find(trigger_attr_names.begin(), trigger_attr_names.end(),
+                         attr.name()) == trigger_attr_names.end())
+            continue;
+
+        set_trigger_bit(attr.id());
+    }
+
     Log(1).stream() << "Registered event trigger service" << endl;
 }
 
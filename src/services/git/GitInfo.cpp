@@ -35,6 +35,8 @@
 
 #include "../CaliperService.h"
 
+#include "../common/MetadataCache.h"
+
 #include "caliper/Caliper.h"
 
 #include "caliper/common/Log.h"
@@ -55,6 +57,7 @@
 #include <string>
 #include <iostream>
 #include <cstdio>
+#include <functional>
 #include <memory>
 
 using namespace cali;
@@ -110,10 +113,24 @@ void read_gitdir(Caliper* c){
     annot_git_name= c->create_attribute("Git.Commiter", CALI_TYPE_STRING,CALI_ATTR_SCOPE_PROCESS);
     annot_git_date= c->create_attribute("Git.Date", CALI_TYPE_STRING,CALI_ATTR_SCOPE_PROCESS);
     string gitDirectory = makeCaliSafe(config.get("repo_dir").to_string());
-    string hash = makeCaliSafe(shell_exec("git --git-dir="+gitDirectory+"/.git log -1 --pretty=%H"));
-    string author_name = makeCaliSafe(shell_exec("git --git-dir="+gitDirectory+"/.git log -1 --pretty=%an"));
-    string date = makeCaliSafe(shell_exec("git --git-dir="+gitDirectory+"/.git log -1 --pretty=%ad"));
-    string message = makeCaliSafe(shell_exec("git --git-dir="+gitDirectory+"/.git log -1 --pretty=%s"));
+    // the repo state is identical for every process in the job, so run git
+    // only in the first process per node and share the result via mmap.
+    // makeCaliSafe strips newlines, so '\n' splits the blob unambiguously.
+    string blob = MetadataCache::fetch("git-"+std::to_string(std::hash<std::string>()(gitDirectory)),
+        [&gitDirectory](){
+            string b;
+            b += makeCaliSafe(shell_exec("git --git-dir="+gitDirectory+"/.git log -1 --pretty=%H"))+"\n";
+            b += makeCaliSafe(shell_exec("git --git-dir="+gitDirectory+"/.git log -1 --pretty=%an"))+"\n";
+            b += makeCaliSafe(shell_exec("git --git-dir="+gitDirectory+"/.git log -1 --pretty=%ad"))+"\n";
+            b += makeCaliSafe(shell_exec("git --git-dir="+gitDirectory+"/.git log -1 --pretty=%s"))+"\n";
+            return b;
+        });
+    vector<string> fields;
+    util::split(blob, '\n', std::back_inserter(fields));
+    string hash = fields.size() > 0 ? fields[0] : "";
+    string author_name = fields.size() > 1 ? fields[1] : "";
+    string date = fields.size() > 2 ? fields[2] : "";
+    string message = fields.size() > 3 ? fields[3] : "";
     c->begin(annot_git_dir,cali::Variant(CALI_TYPE_STRING,gitDirectory.c_str(),gitDirectory.length()));
     c->set(annot_git_hash,cali::Variant(CALI_TYPE_STRING,hash.c_str(),hash.length()));
     c->set(annot_git_message,cali::Variant(CALI_TYPE_STRING,message.c_str(),message.length()));
@@ -0,0 +1,260 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///@file  Heartbeat.cpp
+///@brief Caliper heartbeat service: periodic lightweight status records
+
+// Low-rate always-on monitoring with a dedicated minimal path. A
+// background thread wakes at the configured interval, reads the
+// current top-of-stack values of the configured attributes straight
+// off the blackboard, formats them into a fixed-size record, and
+// rewrites the status file in place with a single pwrite(). The
+// pull_snapshot callback chain is bypassed entirely, so a beat costs
+// a few blackboard lookups and one system call regardless of which
+// other services are active.
+
+#include "../CaliperService.h"
+
+#include "caliper/Caliper.h"
+
+#include "caliper/common/Log.h"
+#include "caliper/common/RuntimeConfig.h"
+#include "caliper/common/Variant.h"
+
+#include "caliper/common/util/split.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace cali;
+using namespace std;
+
+namespace
+{
+
+const ConfigSet::Entry s_configdata[] = {
+    { "interval", CALI_TYPE_UINT, "1000",
+      "Heartbeat interval in milliseconds",
+      "Heartbeat interval in milliseconds"
+    },
+    { "attributes", CALI_TYPE_STRING, "",
+      "Attributes reported in the heartbeat record",
+      "Colon-separated list of attributes whose current top-of-stack\n"
+      "blackboard values are reported in each heartbeat record, e.g.\n"
+      "the current region annotation and progress counters."
+    },
+    { "filename", CALI_TYPE_STRING, "heartbeat.txt",
+      "Heartbeat output file name",
+      "Heartbeat output file name. The file always holds exactly one\n"
+      "fixed-size record and is rewritten in place on each beat, so\n"
+      "monitoring tools read a complete, current record at any time.\n"
+      "Place it on a memory filesystem (e.g. /dev/shm) to keep beats\n"
+      "off the disk. \"stderr\" appends the records to stderr instead."
+    },
+
+    ConfigSet::Terminator
+};
+
+// fixed record size: one beat is always one complete record
+const size_t RECORD_SIZE = 256;
+
+ConfigSet   config;
+
+unsigned    interval_ms = 1000;
+std::string filename;
+bool        use_stderr  = false;
+
+int         fd          = -1;
+
+std::vector<std::string> attr_names;
+std::vector<Attribute>   attributes;
+bool                     attributes_resolved = false;
+
+uint64_t    seq         = 0;
+
+std::thread             heartbeat_thread;
+std::mutex              heartbeat_lock;
+std::condition_variable heartbeat_cv;
+bool                    heartbeat_stop = false;
+
+// Look up the configured attributes. Re-tried on each beat until all
+// names resolve: application attributes appear as the job runs.
+void resolve_attributes(Caliper* c) {
+    bool all_resolved = true;
+
+    for (size_t i = 0; i < attr_names.size(); ++i) {
+        if (attributes[i] != Attribute::invalid)
+            continue;
+
+        attributes[i] = c->get_attribute(attr_names[i]);
+
+        if (attributes[i] == Attribute::invalid)
+            all_resolved = false;
+    }
+
+    attributes_resolved = all_resolved;
+}
+
+void beat(Caliper* c) {
+    if (!attributes_resolved)
+        resolve_attributes(c);
+
+    char buf[RECORD_SIZE];
+
+    uint64_t now =
+        chrono::duration_cast<chrono::milliseconds>(
+            chrono::system_clock::now().time_since_epoch()).count();
+
+    int p = snprintf(buf, sizeof(buf),
+                     "heartbeat.seq=%llu,heartbeat.time=%llu",
+                     static_cast<unsigned long long>(seq++),
+                     static_cast<unsigned long long>(now));
+
+    for (size_t i = 0; i < attributes.size() && p >= 0 && static_cast<size_t>(p) < sizeof(buf); ++i) {
+        if (attributes[i] == Attribute::invalid)
+            continue;
+
+        // dedicated minimal path: top-of-stack blackboard read from
+        // the main thread's scope, no snapshot is triggered
+        Entry e = c->get(attributes[i], c->default_scope(CALI_SCOPE_THREAD));
+
+        if (e.is_empty())
+            continue;
+
+        p += snprintf(buf + p, sizeof(buf) - p, ",%s=%s",
+                      attr_names[i].c_str(), e.value().to_string().c_str());
+    }
+
+    // pad to the fixed record size so readers never see a torn record
+
+    size_t len = (p < 0 || static_cast<size_t>(p) >= RECORD_SIZE ? RECORD_SIZE - 1 : p);
+
+    memset(buf + len, ' ', RECORD_SIZE - len);
+    buf[RECORD_SIZE-1] = '\n';
+
+    if (use_stderr) {
+        ssize_t ret = write(STDERR_FILENO, buf, RECORD_SIZE);
+        (void) ret;
+    } else if (fd >= 0) {
+        ssize_t ret = pwrite(fd, buf, RECORD_SIZE, 0);
+        (void) ret;
+    }
+}
+
+void heartbeat_fn() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> g(heartbeat_lock);
+
+            heartbeat_cv.wait_for(g, std::chrono::milliseconds(interval_ms),
+                                  [] { return heartbeat_stop; });
+
+            if (heartbeat_stop)
+                break;
+        }
+
+        Caliper c = Caliper::instance();
+
+        if (c)
+            beat(&c);
+    }
+}
+
+void post_init_cb(Caliper* c) {
+    if (!use_stderr) {
+        fd = open(filename.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+
+        if (fd < 0) {
+            Log(0).stream() << "heartbeat: error: could not open "
+                            << filename << endl;
+            return;
+        }
+    }
+
+    heartbeat_stop = false;
+    heartbeat_thread = std::thread(heartbeat_fn);
+}
+
+void finish_cb(Caliper* c) {
+    if (heartbeat_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> g(heartbeat_lock);
+            heartbeat_stop = true;
+        }
+
+        heartbeat_cv.notify_one();
+        heartbeat_thread.join();
+    }
+
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+void heartbeat_register(Caliper* c) {
+    config = RuntimeConfig::init("heartbeat", s_configdata);
+
+    interval_ms = std::max<unsigned>(config.get("interval").to_uint(), 1);
+    filename    = config.get("filename").to_string();
+    use_stderr  = (filename == "stderr");
+
+    attr_names.clear();
+    util::split(config.get("attributes").to_string(), ':',
+                back_inserter(attr_names));
+
+    attributes.assign(attr_names.size(), Attribute::invalid);
+    attributes_resolved = attr_names.empty();
+
+    seq = 0;
+
+    c->events().post_init_evt.connect(&post_init_cb);
+    c->events().finish_evt.connect(&finish_cb);
+
+    Log(1).stream() << "Registered heartbeat service" << endl;
+}
+
+} // namespace
+
+namespace cali
+{
+    CaliperService heartbeat_service { "heartbeat", &::heartbeat_register };
+}
@@ -134,6 +134,22 @@ namespace {
              "Extra event configuration",
              "Specifies extra event configuration value for supported events (e.g. PEBS latency threshold)"
             },
+            {"enable_sampling", CALI_TYPE_BOOL, "true",
+             "Enable sampling",
+             "Collect samples for the events in event_list"
+            },
+            {"counting_events", CALI_TYPE_STRING, "",
+             "Counting events",
+             "Comma-separated list of events to count per thread and read at each snapshot.\n"
+             "The events are opened as a perf_event group so all counters\n"
+             "are collected with a single read per snapshot."
+            },
+            {"rdpmc", CALI_TYPE_BOOL, "true",
+             "Read counters from userspace",
+             "Read counting event values with the rdpmc instruction where the kernel\n"
+             "allows it, avoiding the read syscall entirely. Falls back to\n"
+             "group reads if unsupported."
+            },
             ConfigSet::Terminator
     };
 
@@ -150,6 +166,15 @@ namespace {
     static std::vector <std::string> sample_attributes_strvec;
     static uint64_t sample_attributes = 0;
 
+    static bool enable_sampling = true;
+    static std::string counting_events_string;
+    static bool use_rdpmc = true;
+
+#define MAX_COUNTING_EVENTS 12
+
+    static int num_counting_events = 0;
+    static cali_id_t counting_attributes[MAX_COUNTING_EVENTS] = {CALI_INV_ID};
+
     /*
      * libpfm sampling variables
      */
@@ -403,6 +428,177 @@ namespace {
         return ret;
     }
 
+    /*
+     * Counting mode: the counting_events are opened as a single
+     * perf_event group per thread with PERF_FORMAT_GROUP, so one read
+     * on the group leader returns all counter values. Where the kernel
+     * allows it, counters are instead read from userspace with rdpmc,
+     * avoiding the syscall entirely.
+     */
+
+    static __thread perf_event_desc_t *counting_fds;
+    static __thread int counting_num_fds;
+    static __thread struct perf_event_mmap_page *counting_pages[MAX_COUNTING_EVENTS];
+    static __thread bool counting_rdpmc_ok;
+
+#if defined(__x86_64__) || defined(__i386__)
+    static inline uint64_t rdpmc(unsigned counter) {
+        unsigned lo, hi;
+        __asm__ __volatile__ ("rdpmc" : "=a" (lo), "=d" (hi) : "c" (counter));
+        return lo | ((uint64_t) hi) << 32;
+    }
+#endif
+
+    static void setup_thread_counting_events() {
+        size_t pgsz = sysconf(_SC_PAGESIZE);
+        int ret;
+
+        counting_fds     = NULL;
+        counting_num_fds = 0;
+
+        ret = perf_setup_list_events(counting_events_string.c_str(),
+                                     &counting_fds, &counting_num_fds);
+        if (ret || !counting_num_fds)
+            errx(1, "cannot setup counting events");
+        if (counting_num_fds > MAX_COUNTING_EVENTS)
+            errx(1, "too many counting events (max %d)", MAX_COUNTING_EVENTS);
+
+        for (int i = 0; i < counting_num_fds; i++) {
+            counting_fds[i].hw.disabled    = (i == 0);
+            counting_fds[i].hw.read_format = PERF_FORMAT_GROUP;
+
+            int group_fd = (i == 0 ? -1 : counting_fds[0].fd);
+
+            counting_fds[i].fd =
+                perf_event_open(&counting_fds[i].hw, gettid(), -1, group_fd, 0);
+            if (counting_fds[i].fd == -1)
+                err(1, "cannot open counting event %s", counting_fds[i].name);
+        }
+
+        // Map the counters' user pages for rdpmc reads
+        counting_rdpmc_ok = use_rdpmc;
+
+#if defined(__x86_64__) || defined(__i386__)
+        for (int i = 0; counting_rdpmc_ok && i < counting_num_fds; i++) {
+            counting_pages[i] = (struct perf_event_mmap_page *)
+                mmap(NULL, pgsz, PROT_READ, MAP_SHARED, counting_fds[i].fd, 0);
+
+            if (counting_pages[i] == MAP_FAILED) {
+                counting_pages[i]  = NULL;
+                counting_rdpmc_ok = false;
+            } else if (!counting_pages[i]->cap_user_rdpmc)
+                counting_rdpmc_ok = false;
+        }
+#else
+        counting_rdpmc_ok = false;
+#endif
+
+        ret = ioctl(counting_fds[0].fd, PERF_EVENT_IOC_ENABLE, 0);
+        if (ret)
+            err(1, "cannot enable counting group");
+    }
+
+    // Read all counters of this thread's group with a single read on
+    // the group leader.
+    static bool read_counting_group(uint64_t values[]) {
+        // PERF_FORMAT_GROUP layout: u64 nr; u64 value per group member
+        uint64_t buf[1 + MAX_COUNTING_EVENTS];
+
+        ssize_t sz  = (1 + counting_num_fds) * sizeof(uint64_t);
+        ssize_t ret = read(counting_fds[0].fd, buf, sz);
+
+        if (ret < sz || buf[0] != (uint64_t) counting_num_fds)
+            return false;
+
+        for (int i = 0; i < counting_num_fds; i++)
+            values[i] = buf[1 + i];
+
+        return true;
+    }
+
+    static bool read_counting_events(uint64_t values[]) {
+#if defined(__x86_64__) || defined(__i386__)
+        if (counting_rdpmc_ok) {
+            for (int i = 0; i < counting_num_fds; i++) {
+                struct perf_event_mmap_page *pc = counting_pages[i];
+
+                uint32_t seq, idx, width;
+                uint64_t count;
+
+                do {
+                    seq   = pc->lock;
+                    __sync_synchronize();
+
+                    idx   = pc->index;
+                    width = pc->pmc_width;
+                    count = pc->offset;
+
+                    if (idx == 0) {
+                        // counter not currently active on this CPU's PMU
+                        return read_counting_group(values);
+                    }
+
+                    uint64_t pmc = rdpmc(idx - 1);
+
+                    // sign-extend the pmc_width-bit counter value
+                    pmc <<= 64 - width;
+                    pmc >>= 64 - width;
+
+                    count += pmc;
+
+                    __sync_synchronize();
+                } while (pc->lock != seq);
+
+                values[i] = count;
+            }
+
+            return true;
+        }
+#endif
+
+        return read_counting_group(values);
+    }
+
+    static void end_thread_counting() {
+        size_t pgsz = sysconf(_SC_PAGESIZE);
+
+        if (!counting_fds)
+            return;
+
+        ioctl(counting_fds[0].fd, PERF_EVENT_IOC_DISABLE, 0);
+
+        for (int i = 0; i < counting_num_fds; i++) {
+            if (counting_pages[i]) {
+                munmap(counting_pages[i], pgsz);
+                counting_pages[i] = NULL;
+            }
+
+            close(counting_fds[i].fd);
+        }
+
+        perf_free_fds(counting_fds, counting_num_fds);
+
+        counting_fds     = NULL;
+        counting_num_fds = 0;
+    }
+
+    static void snapshot_cb(Caliper* c, int scope, const SnapshotRecord* trigger_info, SnapshotRecord* sbuf) {
+        if (!counting_fds)
+            return;
+
+        uint64_t values[MAX_COUNTING_EVENTS];
+
+        if (!read_counting_events(values))
+            return;
+
+        SnapshotBuilder<0, MAX_COUNTING_EVENTS> rec;
+
+        for (int i = 0; i < num_counting_events; i++)
+            rec.append(counting_attributes[i], Variant(values[i]));
+
+        rec.flush(sbuf);
+    }
+
     static void parse_configset(Caliper *c) {
         config = RuntimeConfig::init("libpfm", s_configdata);
 
@@ -461,6 +657,36 @@ namespace {
         precise_ip = config.get("precise_ip").to_uint();
 
         config1 = config.get("config1").to_uint();
+
+        enable_sampling        = config.get("enable_sampling").to_bool();
+        counting_events_string = config.get("counting_events").to_string();
+        use_rdpmc              = config.get("rdpmc").to_bool();
+
+        // Create one aggregatable attribute per counting event
+
+        Attribute aggr_class_attr = c->get_attribute("class.aggregatable");
+        Variant   v_true(true);
+
+        std::vector<std::string> counting_events_strvec;
+        util::split(counting_events_string, ',', back_inserter(counting_events_strvec));
+
+        num_counting_events = 0;
+
+        for (const std::string& event : counting_events_strvec) {
+            if (num_counting_events >= MAX_COUNTING_EVENTS) {
+                Log(0).stream() << "libpfm: too many counting events, skipping "
+                                << event << std::endl;
+                continue;
+            }
+
+            counting_attributes[num_counting_events++] =
+                c->create_attribute("libpfm.counter." + event,
+                                    CALI_TYPE_UINT,
+                                    CALI_ATTR_ASVALUE
+                                    | CALI_ATTR_SCOPE_THREAD
+                                    | CALI_ATTR_SKIP_EVENTS,
+                                    1, &aggr_class_attr, &v_true).id();
+        }
     }
 
     static void setup_thread_pointers() {
@@ -517,22 +743,33 @@ namespace {
 
     void post_init_cb(Caliper* c) {
         // Run on master thread initialization
-        setup_thread_events();
-        setup_thread_pointers();
-        begin_thread_sampling();
+        if (enable_sampling) {
+            setup_thread_events();
+            setup_thread_pointers();
+            begin_thread_sampling();
+        }
+        if (num_counting_events)
+            setup_thread_counting_events();
     }
 
     void create_scope_cb(Caliper* c, cali_context_scope_t scope) {
         if (scope == CALI_SCOPE_THREAD) {
-            setup_thread_events();
-            setup_thread_pointers();
-            begin_thread_sampling();
+            if (enable_sampling) {
+                setup_thread_events();
+                setup_thread_pointers();
+                begin_thread_sampling();
+            }
+            if (num_counting_events)
+                setup_thread_counting_events();
         }
     }
 
     void release_scope_cb(Caliper* c, cali_context_scope_t scope) {
         if (scope == CALI_SCOPE_THREAD) {
-            end_thread_sampling();
+            if (enable_sampling)
+                end_thread_sampling();
+
+            end_thread_counting();
         }
     }
 
@@ -623,14 +860,21 @@ namespace {
         config = RuntimeConfig::init("libpfm", s_configdata);
 
         parse_configset(c);
-        setup_process_signals();
-        
+
+        if (enable_sampling)
+            setup_process_signals();
+        else if (pfm_initialize() != PFM_SUCCESS)
+            errx(1, "pfm_initialize failed");
+
         c->events().create_scope_evt.connect(create_scope_cb);
         c->events().post_init_evt.connect(post_init_cb);
         c->events().finish_evt.connect(finish_cb);
         c->events().pre_flush_evt.connect(pre_flush_cb);
         c->events().postprocess_snapshot.connect(postprocess_snapshot_cb);
 
+        if (num_counting_events)
+            c->events().snapshot.connect(snapshot_cb);
+
         Log(1).stream() << "Registered libpfm service" << endl;
     }
 
@@ -0,0 +1,296 @@
+// Copyright (c) 2015, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///\file  MpiGotcha.cpp
+///\brief GOTCHA-based MPI function wrapping service
+///
+/// Unlike the PMPI wrapper (mpiwrap), which interposes every MPI call
+/// and decides per-call whether to record it, this service binds
+/// wrappers only for the functions given in the mpigotcha.functions
+/// config list. MPI functions that are not on the list keep their
+/// native call path and pay no wrapper overhead at all.
+
+#include "../CaliperService.h"
+
+#include "caliper/Caliper.h"
+
+#include "caliper/common/Log.h"
+#include "caliper/common/RuntimeConfig.h"
+#include "caliper/common/Variant.h"
+
+#include "caliper/common/util/split.hpp"
+
+#include <mpi.h>
+
+#include <gotcha/gotcha.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace cali;
+
+namespace
+{
+
+ConfigSet        config;
+
+ConfigSet::Entry configdata[] = {
+    { "functions", CALI_TYPE_STRING, "",
+      "List of MPI functions to wrap",
+      "Colon-separated list of MPI functions to wrap.\n"
+      "Only the listed functions are bound at initialization; all other\n"
+      "MPI calls remain at native cost. MPI_Init, MPI_Init_thread, and\n"
+      "MPI_Finalize are always wrapped to record rank and size."
+    },
+    ConfigSet::Terminator
+};
+
+Attribute mpifn_attr   { Attribute::invalid };
+Attribute mpirank_attr { Attribute::invalid };
+Attribute mpisize_attr { Attribute::invalid };
+
+// Defines the original function pointer and an annotating wrapper for
+// an int-returning MPI function. \a args is the parenthesized
+// parameter list, \a callargs the parenthesized argument names.
+
+#define CALI_MPIGOTCHA_WRAPPER(name, args, callargs)                      \
+    int (*orig_ ## name) args = nullptr;                                  \
+    int cali_ ## name ## _wrapper args {                                  \
+        Caliper c;                                                        \
+        c.begin(mpifn_attr, Variant(CALI_TYPE_STRING, #name, strlen(#name))); \
+        int ret = (*orig_ ## name) callargs;                              \
+        c.end(mpifn_attr);                                                \
+        return ret;                                                       \
+    }
+
+CALI_MPIGOTCHA_WRAPPER(MPI_Send,
+                       (const void* buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm),
+                       (buf, count, type, dest, tag, comm))
+CALI_MPIGOTCHA_WRAPPER(MPI_Recv,
+                       (void* buf, int count, MPI_Datatype type, int src, int tag, MPI_Comm comm, MPI_Status* status),
+                       (buf, count, type, src, tag, comm, status))
+CALI_MPIGOTCHA_WRAPPER(MPI_Isend,
+                       (const void* buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm, MPI_Request* req),
+                       (buf, count, type, dest, tag, comm, req))
+CALI_MPIGOTCHA_WRAPPER(MPI_Irecv,
+                       (void* buf, int count, MPI_Datatype type, int src, int tag, MPI_Comm comm, MPI_Request* req),
+                       (buf, count, type, src, tag, comm, req))
+CALI_MPIGOTCHA_WRAPPER(MPI_Wait,
+                       (MPI_Request* req, MPI_Status* status),
+                       (req, status))
+CALI_MPIGOTCHA_WRAPPER(MPI_Waitall,
+                       (int count, MPI_Request reqs[], MPI_Status statuses[]),
+                       (count, reqs, statuses))
+CALI_MPIGOTCHA_WRAPPER(MPI_Waitany,
+                       (int count, MPI_Request reqs[], int* index, MPI_Status* status),
+                       (count, reqs, index, status))
+CALI_MPIGOTCHA_WRAPPER(MPI_Waitsome,
+                       (int incount, MPI_Request reqs[], int* outcount, int indices[], MPI_Status statuses[]),
+                       (incount, reqs, outcount, indices, statuses))
+CALI_MPIGOTCHA_WRAPPER(MPI_Test,
+                       (MPI_Request* req, int* flag, MPI_Status* status),
+                       (req, flag, status))
+CALI_MPIGOTCHA_WRAPPER(MPI_Testsome,
+                       (int incount, MPI_Request reqs[], int* outcount, int indices[], MPI_Status statuses[]),
+                       (incount, reqs, outcount, indices, statuses))
+CALI_MPIGOTCHA_WRAPPER(MPI_Probe,
+                       (int src, int tag, MPI_Comm comm, MPI_Status* status),
+                       (src, tag, comm, status))
+CALI_MPIGOTCHA_WRAPPER(MPI_Iprobe,
+                       (int src, int tag, MPI_Comm comm, int* flag, MPI_Status* status),
+                       (src, tag, comm, flag, status))
+CALI_MPIGOTCHA_WRAPPER(MPI_Sendrecv,
+                       (const void* sendbuf, int sendcount, MPI_Datatype sendtype, int dest, int sendtag,
+                        void* recvbuf, int recvcount, MPI_Datatype recvtype, int src, int recvtag,
+                        MPI_Comm comm, MPI_Status* status),
+                       (sendbuf, sendcount, sendtype, dest, sendtag,
+                        recvbuf, recvcount, recvtype, src, recvtag, comm, status))
+CALI_MPIGOTCHA_WRAPPER(MPI_Barrier,
+                       (MPI_Comm comm),
+                       (comm))
+CALI_MPIGOTCHA_WRAPPER(MPI_Bcast,
+                       (void* buf, int count, MPI_Datatype type, int root, MPI_Comm comm),
+                       (buf, count, type, root, comm))
+CALI_MPIGOTCHA_WRAPPER(MPI_Reduce,
+                       (const void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm),
+                       (sendbuf, recvbuf, count, type, op, root, comm))
+CALI_MPIGOTCHA_WRAPPER(MPI_Allreduce,
+                       (const void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm),
+                       (sendbuf, recvbuf, count, type, op, comm))
+CALI_MPIGOTCHA_WRAPPER(MPI_Gather,
+                       (const void* sendbuf, int sendcount, MPI_Datatype sendtype,
+                        void* recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm),
+                       (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm))
+CALI_MPIGOTCHA_WRAPPER(MPI_Allgather,
+                       (const void* sendbuf, int sendcount, MPI_Datatype sendtype,
+                        void* recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm),
+                       (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm))
+CALI_MPIGOTCHA_WRAPPER(MPI_Scatter,
+                       (const void* sendbuf, int sendcount, MPI_Datatype sendtype,
+                        void* recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm),
+                       (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm))
+CALI_MPIGOTCHA_WRAPPER(MPI_Alltoall,
+                       (const void* sendbuf, int sendcount, MPI_Datatype sendtype,
+                        void* recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm),
+                       (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm))
+
+// MPI_Init, MPI_Init_thread, and MPI_Finalize are always bound: they
+// run once and set up the rank and size attributes.
+
+int (*orig_MPI_Init)(int*, char***) = nullptr;
+int (*orig_MPI_Init_thread)(int*, char***, int, int*) = nullptr;
+int (*orig_MPI_Finalize)() = nullptr;
+
+void post_init()
+{
+    int rank = 0;
+    int size = 1;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Disable (most) logging on non-0 ranks by default
+    Log::add_prefix("(" + std::to_string(rank) + "): ");
+
+    if (rank > 0)
+        Log::set_verbosity(0);
+
+    Caliper c;
+
+    c.set(mpisize_attr, Variant(size));
+    c.set(mpirank_attr, Variant(rank));
+}
+
+int cali_MPI_Init_wrapper(int* argc, char*** argv)
+{
+    int ret = (*orig_MPI_Init)(argc, argv);
+    post_init();
+    return ret;
+}
+
+int cali_MPI_Init_thread_wrapper(int* argc, char*** argv, int required, int* provided)
+{
+    int ret = (*orig_MPI_Init_thread)(argc, argv, required, provided);
+    post_init();
+    return ret;
+}
+
+int cali_MPI_Finalize_wrapper()
+{
+    Caliper c;
+    c.begin(mpifn_attr, Variant(CALI_TYPE_STRING, "MPI_Finalize", 12));
+    c.end(mpifn_attr);
+
+    return (*orig_MPI_Finalize)();
+}
+
+#define CALI_MPIGOTCHA_BINDING(name) \
+    { #name, (void*) cali_ ## name ## _wrapper, &orig_ ## name }
+
+const struct gotcha_binding_t wrap_table[] = {
+    CALI_MPIGOTCHA_BINDING(MPI_Send),
+    CALI_MPIGOTCHA_BINDING(MPI_Recv),
+    CALI_MPIGOTCHA_BINDING(MPI_Isend),
+    CALI_MPIGOTCHA_BINDING(MPI_Irecv),
+    CALI_MPIGOTCHA_BINDING(MPI_Wait),
+    CALI_MPIGOTCHA_BINDING(MPI_Waitall),
+    CALI_MPIGOTCHA_BINDING(MPI_Waitany),
+    CALI_MPIGOTCHA_BINDING(MPI_Waitsome),
+    CALI_MPIGOTCHA_BINDING(MPI_Test),
+    CALI_MPIGOTCHA_BINDING(MPI_Testsome),
+    CALI_MPIGOTCHA_BINDING(MPI_Probe),
+    CALI_MPIGOTCHA_BINDING(MPI_Iprobe),
+    CALI_MPIGOTCHA_BINDING(MPI_Sendrecv),
+    CALI_MPIGOTCHA_BINDING(MPI_Barrier),
+    CALI_MPIGOTCHA_BINDING(MPI_Bcast),
+    CALI_MPIGOTCHA_BINDING(MPI_Reduce),
+    CALI_MPIGOTCHA_BINDING(MPI_Allreduce),
+    CALI_MPIGOTCHA_BINDING(MPI_Gather),
+    CALI_MPIGOTCHA_BINDING(MPI_Allgather),
+    CALI_MPIGOTCHA_BINDING(MPI_Scatter),
+    CALI_MPIGOTCHA_BINDING(MPI_Alltoall)
+};
+
+void mpigotcha_register(Caliper* c)
+{
+    config = RuntimeConfig::init("mpigotcha", configdata);
+
+    mpifn_attr   =
+        c->create_attribute("mpi.function", CALI_TYPE_STRING, CALI_ATTR_NESTED);
+    mpirank_attr =
+        c->create_attribute("mpi.rank", CALI_TYPE_INT,
+                            CALI_ATTR_SCOPE_PROCESS | CALI_ATTR_SKIP_EVENTS | CALI_ATTR_ASVALUE);
+    mpisize_attr =
+        c->create_attribute("mpi.size", CALI_TYPE_INT,
+                            CALI_ATTR_SCOPE_PROCESS | CALI_ATTR_SKIP_EVENTS);
+
+    std::vector<std::string> functions;
+
+    util::split(config.get("functions").to_string(), ':', std::back_inserter(functions));
+
+    // Bind only the configured functions: unlisted MPI calls keep
+    // their native call path.
+
+    std::vector<gotcha_binding_t> bindings;
+
+    bindings.push_back(gotcha_binding_t { "MPI_Init",        (void*) cali_MPI_Init_wrapper,        &orig_MPI_Init        });
+    bindings.push_back(gotcha_binding_t { "MPI_Init_thread", (void*) cali_MPI_Init_thread_wrapper, &orig_MPI_Init_thread });
+    bindings.push_back(gotcha_binding_t { "MPI_Finalize",    (void*) cali_MPI_Finalize_wrapper,    &orig_MPI_Finalize    });
+
+    for (const std::string& fn : functions) {
+        const gotcha_binding_t* b   = wrap_table;
+        const gotcha_binding_t* end = wrap_table + sizeof(wrap_table)/sizeof(wrap_table[0]);
+
+        for ( ; b != end && fn != b->name; ++b)
+            ;
+
+        if (b != end)
+            bindings.push_back(*b);
+        else
+            Log(1).stream() << "mpigotcha: unknown or unsupported MPI function " << fn << std::endl;
+    }
+
+    gotcha_wrap(bindings.data(), bindings.size(), "Caliper");
+
+    Log(1).stream() << "Registered mpigotcha service, wrapping "
+                    << bindings.size() << " MPI functions" << std::endl;
+}
+
+} // namespace [anonymous]
+
+namespace cali
+{
+    CaliperService mpigotcha_service { "mpigotcha", ::mpigotcha_register };
+}
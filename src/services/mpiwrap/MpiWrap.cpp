@@ -49,10 +49,35 @@ namespace cali
     Attribute mpirank_attr { Attribute::invalid };
     Attribute mpisize_attr { Attribute::invalid };
 
-    bool      mpi_enabled  { false };
+    Attribute mpicallcount_attr { Attribute::invalid };
+    Attribute mpisentbytes_attr { Attribute::invalid };
+    Attribute mpirecvbytes_attr { Attribute::invalid };
+    Attribute mpicalltime_attr  { Attribute::invalid };
+
+    Attribute mpitraceactive_attr   { Attribute::invalid };
+    Attribute mpitracecoverage_attr { Attribute::invalid };
+
+    Attribute mpioutlier_attr       { Attribute::invalid };
+
+    bool      mpi_enabled       { false };
+    bool      mpi_stats_enabled { false };
 
     string    mpi_whitelist_string;
     string    mpi_blacklist_string;
+
+    // Rank-subset tracing configuration, read by the MPI_Init wrapper
+    // before Caliper initializes
+
+    string    mpi_trace_ranks_string;
+    int       mpi_trace_rank_stride        { 0 };
+    bool      mpi_trace_outliers           { false };
+    double    mpi_trace_outlier_threshold  { 2.0 };
+
+    // Cross-rank outlier detection configuration, used by the wrappers
+
+    bool      mpi_outlier_enabled          { false };
+    double    mpi_outlier_interval         { 1.0  };
+    double    mpi_outlier_sigma            { 3.0  };
 }
 
 namespace
@@ -69,7 +94,57 @@ ConfigSet::Entry configdata[] = {
     },
     { "blacklist", CALI_TYPE_STRING, "",
       "List of MPI functions to filter",
-      "Colon-separated list of functions to blacklist." 
+      "Colon-separated list of functions to blacklist."
+    },
+    { "trace_ranks", CALI_TYPE_STRING, "",
+      "List of MPI ranks that run the trace service",
+      "Colon-separated list of MPI ranks that run the trace service.\n"
+      "All other ranks run aggregation instead. Requires services to be\n"
+      "configured through CALI_SERVICES_ENABLE."
+    },
+    { "trace_rank_stride", CALI_TYPE_INT, "0",
+      "Run the trace service on every Nth MPI rank",
+      "Run the trace service on every Nth MPI rank. All other ranks run\n"
+      "aggregation instead. Requires services to be configured through\n"
+      "CALI_SERVICES_ENABLE."
+    },
+    { "trace_outliers", CALI_TYPE_BOOL, "false",
+      "Run the trace service on outlier ranks chosen at runtime",
+      "Select trace ranks at MPI_Init from the distribution of each rank's\n"
+      "init-phase (program start to MPI_Init) time, exchanged with\n"
+      "MPI_Allreduce. Ranks more than trace_outlier_threshold standard\n"
+      "deviations from the mean run the trace service, as does rank 0 as a\n"
+      "representative of the typical ranks. All other ranks run aggregation\n"
+      "instead."
+    },
+    { "trace_outlier_threshold", CALI_TYPE_DOUBLE, "2",
+      "Outlier threshold for trace_outliers, in standard deviations",
+      "Outlier threshold for trace_outliers, in standard deviations."
+    },
+    { "outlier_detection", CALI_TYPE_BOOL, "false",
+      "Detect slow ranks during the run",
+      "Periodically exchange each rank's time spent in MPI across all\n"
+      "ranks with a nonblocking allreduce (16 bytes per period), and flag\n"
+      "ranks more than outlier_sigma standard deviations above the mean.\n"
+      "Flagged ranks tag their records with mpi.outlier and switch from\n"
+      "statistics mode to per-call snapshots until they return to the\n"
+      "population. The exchange is progressed from the MPI wrappers and\n"
+      "needs no extra thread."
+    },
+    { "outlier_check_interval", CALI_TYPE_DOUBLE, "1",
+      "Outlier detection exchange period in seconds",
+      "Outlier detection exchange period in seconds."
+    },
+    { "outlier_sigma", CALI_TYPE_DOUBLE, "3",
+      "Outlier threshold, in standard deviations above the mean",
+      "Outlier threshold, in standard deviations above the mean."
+    },
+    { "statistics", CALI_TYPE_BOOL, "false",
+      "Collect MPI call statistics instead of triggering snapshots",
+      "Accumulate per-function call counts, sent/received bytes, and time\n"
+      "in counters inside the wrappers instead of triggering a snapshot\n"
+      "per call. One aggregate record per called MPI function is pushed\n"
+      "through the snapshot processing chain at MPI_Finalize."
     },
     ConfigSet::Terminator
 };
@@ -83,22 +158,67 @@ void mpi_register(Caliper* c)
     mpirank_attr = 
         c->create_attribute("mpi.rank", CALI_TYPE_INT, 
                             CALI_ATTR_SCOPE_PROCESS | CALI_ATTR_SKIP_EVENTS | CALI_ATTR_ASVALUE);
-    mpisize_attr = 
-        c->create_attribute("mpi.size", CALI_TYPE_INT, 
+    mpisize_attr =
+        c->create_attribute("mpi.size", CALI_TYPE_INT,
                             CALI_ATTR_SCOPE_PROCESS | CALI_ATTR_SKIP_EVENTS);
 
-    mpi_enabled = true;
+    mpicallcount_attr =
+        c->create_attribute("mpi.call.count", CALI_TYPE_UINT,
+                            CALI_ATTR_ASVALUE | CALI_ATTR_SKIP_EVENTS);
+    mpisentbytes_attr =
+        c->create_attribute("mpi.bytes.sent", CALI_TYPE_UINT,
+                            CALI_ATTR_ASVALUE | CALI_ATTR_SKIP_EVENTS);
+    mpirecvbytes_attr =
+        c->create_attribute("mpi.bytes.received", CALI_TYPE_UINT,
+                            CALI_ATTR_ASVALUE | CALI_ATTR_SKIP_EVENTS);
+    mpicalltime_attr =
+        c->create_attribute("mpi.call.time", CALI_TYPE_DOUBLE,
+                            CALI_ATTR_ASVALUE | CALI_ATTR_SKIP_EVENTS);
+
+    mpitraceactive_attr =
+        c->create_attribute("mpi.trace.active", CALI_TYPE_BOOL,
+                            CALI_ATTR_SCOPE_PROCESS | CALI_ATTR_SKIP_EVENTS);
+    mpitracecoverage_attr =
+        c->create_attribute("mpi.trace.coverage", CALI_TYPE_STRING,
+                            CALI_ATTR_SCOPE_PROCESS | CALI_ATTR_SKIP_EVENTS);
+
+    mpioutlier_attr =
+        c->create_attribute("mpi.outlier", CALI_TYPE_BOOL,
+                            CALI_ATTR_SCOPE_PROCESS | CALI_ATTR_SKIP_EVENTS | CALI_ATTR_ASVALUE);
+
+    mpi_enabled       = true;
+    mpi_stats_enabled = config.get("statistics").to_bool();
 
     mpi_whitelist_string = config.get("whitelist").to_string();
     mpi_blacklist_string = config.get("blacklist").to_string();
 
+    mpi_outlier_enabled  = config.get("outlier_detection").to_bool();
+    mpi_outlier_interval = config.get("outlier_check_interval").to_double();
+    mpi_outlier_sigma    = config.get("outlier_sigma").to_double();
+
     Log(1).stream() << "Registered MPI service" << endl;
 }
 
-} // anonymous namespace 
+} // anonymous namespace
+
 
+namespace cali
+{
 
-namespace cali 
+// Read the rank-subset tracing configuration. Called by the MPI_Init
+// wrapper before Caliper initializes, so the service configuration can
+// still be adjusted for this rank.
+
+void mpi_read_trace_subset_config()
 {
-    CaliperService mpi_service = { "mpi", ::mpi_register };
+    ConfigSet cfg = RuntimeConfig::init("mpi", ::configdata);
+
+    mpi_trace_ranks_string      = cfg.get("trace_ranks").to_string();
+    mpi_trace_rank_stride       = cfg.get("trace_rank_stride").to_int();
+    mpi_trace_outliers          = cfg.get("trace_outliers").to_bool();
+    mpi_trace_outlier_threshold = cfg.get("trace_outlier_threshold").to_double();
+}
+
+CaliperService mpi_service = { "mpi", ::mpi_register };
+
 } // namespace cali
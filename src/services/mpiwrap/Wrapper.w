@@ -1,7 +1,9 @@
 
 #include "caliper/Caliper.h"
+#include "caliper/SnapshotRecord.h"
 
 #include "caliper/common/Log.h"
+#include "caliper/common/StringConverter.h"
 #include "caliper/common/Variant.h"
 
 #include "caliper/common/util/split.hpp"
@@ -9,10 +11,15 @@
 #include <mpi.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
 #include <iterator>
 #include <string>
 #include <sstream>
+#include <vector>
 
 namespace cali
 {
@@ -20,10 +27,32 @@ namespace cali
     extern Attribute   mpirank_attr;
     extern Attribute   mpisize_attr;
 
+    extern Attribute   mpicallcount_attr;
+    extern Attribute   mpisentbytes_attr;
+    extern Attribute   mpirecvbytes_attr;
+    extern Attribute   mpicalltime_attr;
+
+    extern Attribute   mpitraceactive_attr;
+    extern Attribute   mpitracecoverage_attr;
+
     extern bool        mpi_enabled;
+    extern bool        mpi_stats_enabled;
 
     extern std::string mpi_whitelist_string;
     extern std::string mpi_blacklist_string;
+
+    extern std::string mpi_trace_ranks_string;
+    extern int         mpi_trace_rank_stride;
+    extern bool        mpi_trace_outliers;
+    extern double      mpi_trace_outlier_threshold;
+
+    extern Attribute   mpioutlier_attr;
+
+    extern bool        mpi_outlier_enabled;
+    extern double      mpi_outlier_interval;
+    extern double      mpi_outlier_sigma;
+
+    extern void        mpi_read_trace_subset_config();
 }
 
 using namespace cali;
@@ -35,6 +64,77 @@ namespace
     bool enable_{{foo}} = true;
     {{endforallfn}}
 
+    // Per-function call statistics for the statistics mode: counters
+    // are accumulated directly in the wrapper with relaxed atomics, so
+    // no snapshot is triggered and the blackboard is not touched.
+
+    struct mpi_fn_statistics {
+        std::atomic<uint64_t> count      { 0 };
+        std::atomic<uint64_t> sent_bytes { 0 };
+        std::atomic<uint64_t> recv_bytes { 0 };
+        std::atomic<uint64_t> time_nsec  { 0 };
+
+        inline void add(uint64_t sent, uint64_t recv, double sec) {
+            count.fetch_add(1, std::memory_order_relaxed);
+
+            if (sent)
+                sent_bytes.fetch_add(sent, std::memory_order_relaxed);
+            if (recv)
+                recv_bytes.fetch_add(recv, std::memory_order_relaxed);
+
+            time_nsec.fetch_add(static_cast<uint64_t>(sec * 1e9), std::memory_order_relaxed);
+        }
+    };
+
+    {{forallfn foo}}
+    mpi_fn_statistics stats_{{foo}};
+    {{endforallfn}}
+
+    // Push one aggregate record per called MPI function through the
+    // regular snapshot path (trace buffer / recorder).
+
+    void flush_statistics(Caliper* c) {
+        const struct stats_table_elem {
+            const char*        name;
+            mpi_fn_statistics* stats;
+        } table[] = {
+            {{forallfn foo}}
+            { "{{foo}}", &stats_{{foo}} },
+            {{endforallfn}}
+            { 0, 0 }
+        };
+
+        for (const stats_table_elem* e = table; e->name && e->stats; ++e) {
+            uint64_t count = e->stats->count.load();
+
+            if (count == 0)
+                continue;
+
+            uint64_t sent  = e->stats->sent_bytes.load();
+            uint64_t recv  = e->stats->recv_bytes.load();
+            double   time  = 1e-9 * e->stats->time_nsec.load();
+
+            Attribute attr[4] = {
+                mpicallcount_attr, mpisentbytes_attr, mpirecvbytes_attr, mpicalltime_attr
+            };
+            Variant   data[4] = {
+                Variant(CALI_TYPE_UINT, &count, sizeof(uint64_t)),
+                Variant(CALI_TYPE_UINT, &sent,  sizeof(uint64_t)),
+                Variant(CALI_TYPE_UINT, &recv,  sizeof(uint64_t)),
+                Variant(time)
+            };
+
+            SnapshotRecord::FixedSnapshotRecord<8> info_data;
+            SnapshotRecord info(info_data);
+
+            c->make_entrylist(4, attr, data, info);
+
+            c->begin(mpifn_attr, Variant(CALI_TYPE_STRING, e->name, strlen(e->name)));
+            c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, &info);
+            c->end(mpifn_attr);
+        }
+    }
+
     void setup_filter() {
         std::vector<std::string> whitelist;
         std::vector<std::string> blacklist;
@@ -84,6 +184,270 @@ namespace
         for (vector<string>::const_iterator it = blacklist.begin(); it != blacklist.end(); ++it)
             Log(1).stream() << "Unknown MPI function " << *it << " in MPI function blacklist" << endl;
     }
+
+    //
+    // --- Rank-subset tracing
+    //
+    // At scale, tracing every rank is neither affordable nor useful.
+    // When a trace rank subset is configured, the MPI_Init wrapper
+    // selects representative ranks that run the trace service; all
+    // other ranks swap trace for aggregation. The decision is made
+    // before Caliper initializes so it can still adjust the service
+    // configuration for this process.
+    //
+
+    // Wrapper library load time, for the init-phase outlier metric
+    std::chrono::steady_clock::time_point load_time = std::chrono::steady_clock::now();
+
+    // Outlier selection: exchange sum and sum-of-squares of each
+    // rank's init-phase (program start to MPI_Init) time with a single
+    // allreduce, then pick ranks far off the mean. Rank 0 always
+    // traces as a representative of the typical ranks.
+    bool is_outlier_rank(int rank, int size, double threshold) {
+        double x = std::chrono::duration<double>(std::chrono::steady_clock::now() - load_time).count();
+
+        double in[2]  = { x, x*x };
+        double out[2] = { 0.0, 0.0 };
+
+        PMPI_Allreduce(in, out, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+        double mean   = out[0] / size;
+        double var    = out[1] / size - mean*mean;
+        double stddev = var > 0.0 ? std::sqrt(var) : 0.0;
+
+        return rank == 0 || (stddev > 0.0 && std::fabs(x - mean) > threshold * stddev);
+    }
+
+    // Decide whether this rank runs the trace service and rewrite the
+    // service configuration accordingly. Returns true if rank-subset
+    // mode is active; *tracedptr and *coverageptr receive this rank's
+    // role and the coverage descriptor for the output metadata.
+    bool setup_trace_subset(int rank, int size, bool* tracedptr, std::string* coverageptr) {
+        mpi_read_trace_subset_config();
+
+        if (mpi_trace_ranks_string.empty() && mpi_trace_rank_stride <= 0 && !mpi_trace_outliers)
+            return false;
+
+        bool        traced = false;
+        std::string coverage;
+
+        if (!mpi_trace_ranks_string.empty()) {
+            std::vector<std::string> ranks;
+
+            util::split(mpi_trace_ranks_string, ':', std::back_inserter(ranks));
+
+            for (const std::string& s : ranks)
+                if (!s.empty() && StringConverter(s).to_int() == rank)
+                    traced = true;
+
+            coverage = "ranks=" + mpi_trace_ranks_string;
+        } else if (mpi_trace_rank_stride > 0) {
+            traced   = (rank % mpi_trace_rank_stride == 0);
+            coverage = "stride=" + std::to_string(mpi_trace_rank_stride);
+        } else {
+            traced   = is_outlier_rank(rank, size, mpi_trace_outlier_threshold);
+            coverage = "outliers";
+        }
+
+        if (Caliper::is_initialized()) {
+            Log(1).stream() << "mpi: Cannot set up trace rank subset: Caliper is already initialized" << endl;
+            return false;
+        }
+
+        // Swap trace and aggregate in the configured service list.
+        // We can only rewrite an environment-configured list here:
+        // anything read through RuntimeConfig before this point is
+        // already fixed for this process.
+
+        const char* services = getenv("CALI_SERVICES_ENABLE");
+
+        if (!services) {
+            Log(1).stream() << "mpi: Trace rank subset is configured but CALI_SERVICES_ENABLE is not set" << endl;
+            return false;
+        }
+
+        std::vector<std::string> list;
+
+        util::split(std::string(services), ':', std::back_inserter(list));
+
+        list.erase(std::remove_if(list.begin(), list.end(),
+                                  [](const std::string& s){
+                                      return s == "trace" || s == "aggregate";
+                                  }),
+                   list.end());
+        list.push_back(traced ? "trace" : "aggregate");
+
+        std::string joined;
+
+        for (const std::string& s : list) {
+            if (!joined.empty())
+                joined.push_back(':');
+
+            joined.append(s);
+        }
+
+        setenv("CALI_SERVICES_ENABLE", joined.c_str(), 1);
+
+        Log(1).stream() << "mpi: Trace rank subset (" << coverage << "): this rank runs "
+                        << (traced ? "trace" : "aggregate") << endl;
+
+        *tracedptr   = traced;
+        *coverageptr = coverage;
+
+        return true;
+    }
+
+    //
+    // --- Cross-rank outlier detection
+    //
+    // Find slow ranks during the run instead of in post-processing:
+    // each period, exchange every rank's time-in-MPI with a single
+    // nonblocking allreduce of sum and sum-of-squares (16 bytes on the
+    // wire per period), and flag ranks more than outlier_sigma
+    // standard deviations above the population mean. Flagged ranks tag
+    // their records with mpi.outlier and raise their measurement
+    // detail by switching from accumulated statistics to per-call
+    // snapshots until they return to the population. The exchange is
+    // progressed from the wrapper epilogues, so there is no extra
+    // thread, and it runs on duplicated communicators so it never
+    // interleaves with the application's collectives.
+    //
+
+    std::atomic<uint64_t> outlier_period_nsec { 0 };
+    std::atomic_flag      outlier_lock        = ATOMIC_FLAG_INIT;
+
+    double       outlier_last_check  = 0.0;
+    double       outlier_local_x     = 0.0;
+    double       outlier_sendbuf[2]  = { 0.0, 0.0 };
+    double       outlier_recvbuf[2]  = { 0.0, 0.0 };
+    MPI_Request  outlier_req;
+    bool         outlier_req_active  = false;
+    uint64_t     outlier_num_posted  = 0;
+    bool         outlier_flagged     = false;
+    bool         outlier_saved_stats = false;
+    MPI_Comm     outlier_comm        = MPI_COMM_NULL;
+    MPI_Comm     outlier_drain_comm  = MPI_COMM_NULL;
+    int          outlier_comm_size   = 1;
+
+    inline void outlier_add(double sec) {
+        if (mpi_outlier_enabled)
+            outlier_period_nsec.fetch_add(static_cast<uint64_t>(sec * 1e9), std::memory_order_relaxed);
+    }
+
+    void outlier_setup() {
+        if (!mpi_outlier_enabled)
+            return;
+
+        PMPI_Comm_dup(MPI_COMM_WORLD, &outlier_comm);
+        PMPI_Comm_dup(MPI_COMM_WORLD, &outlier_drain_comm);
+        PMPI_Comm_size(outlier_comm, &outlier_comm_size);
+
+        outlier_last_check = PMPI_Wtime();
+    }
+
+    void outlier_update(double x, double mean, double stddev) {
+        bool flagged = stddev > 0.0 && x > mean + mpi_outlier_sigma * stddev;
+
+        if (flagged == outlier_flagged)
+            return;
+
+        Caliper c;
+        c.set(mpioutlier_attr, Variant(flagged));
+
+        if (flagged) {
+            // raise measurement detail: per-call snapshots instead of
+            // accumulated statistics
+            outlier_saved_stats = mpi_stats_enabled;
+            mpi_stats_enabled   = false;
+
+            Log(1).stream() << "mpi: Rank flagged as outlier: " << x << "s in MPI, population mean "
+                            << mean << "s, stddev " << stddev << endl;
+        } else {
+            mpi_stats_enabled = outlier_saved_stats;
+
+            Log(1).stream() << "mpi: Rank returned to population" << endl;
+        }
+
+        outlier_flagged = flagged;
+    }
+
+    // Progress the outlier exchange: complete the outstanding
+    // allreduce, or start a new one when the period has elapsed.
+    // Called from the wrapper epilogues; keeps at most one exchange
+    // in flight.
+    void outlier_progress() {
+        if (!mpi_outlier_enabled)
+            return;
+        if (outlier_lock.test_and_set(std::memory_order_acquire))
+            return;
+
+        if (outlier_req_active) {
+            int done = 0;
+            PMPI_Test(&outlier_req, &done, MPI_STATUS_IGNORE);
+
+            if (done) {
+                outlier_req_active = false;
+
+                double mean = outlier_recvbuf[0] / outlier_comm_size;
+                double var  = outlier_recvbuf[1] / outlier_comm_size - mean*mean;
+
+                outlier_update(outlier_local_x, mean, var > 0.0 ? std::sqrt(var) : 0.0);
+            }
+        } else {
+            double now = PMPI_Wtime();
+
+            if (now - outlier_last_check >= mpi_outlier_interval) {
+                outlier_last_check = now;
+
+                double x = 1e-9 * outlier_period_nsec.exchange(0, std::memory_order_relaxed);
+
+                outlier_local_x    = x;
+                outlier_sendbuf[0] = x;
+                outlier_sendbuf[1] = x*x;
+
+                PMPI_Iallreduce(outlier_sendbuf, outlier_recvbuf, 2, MPI_DOUBLE, MPI_SUM,
+                                outlier_comm, &outlier_req);
+
+                outlier_req_active = true;
+                ++outlier_num_posted;
+            }
+        }
+
+        outlier_lock.clear(std::memory_order_release);
+    }
+
+    // Match up exchange collectives across ranks before MPI_Finalize:
+    // ranks post them on local time, so the posted counts can differ
+    // at the end of the run. The count exchange runs on its own
+    // communicator so it cannot misorder against pending exchanges.
+    void outlier_drain() {
+        if (!mpi_outlier_enabled || outlier_comm == MPI_COMM_NULL)
+            return;
+
+        unsigned long long posted    = outlier_num_posted;
+        unsigned long long maxposted = 0;
+
+        PMPI_Allreduce(&posted, &maxposted, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX,
+                       outlier_drain_comm);
+
+        for ( ; posted < maxposted; ++posted) {
+            if (outlier_req_active)
+                PMPI_Wait(&outlier_req, MPI_STATUS_IGNORE);
+
+            PMPI_Iallreduce(outlier_sendbuf, outlier_recvbuf, 2, MPI_DOUBLE, MPI_SUM,
+                            outlier_comm, &outlier_req);
+
+            outlier_req_active = true;
+        }
+
+        if (outlier_req_active) {
+            PMPI_Wait(&outlier_req, MPI_STATUS_IGNORE);
+            outlier_req_active = false;
+        }
+
+        PMPI_Comm_free(&outlier_comm);
+        PMPI_Comm_free(&outlier_drain_comm);
+    }
 }
 
 {{fn func MPI_Init MPI_Init_thread}}{
@@ -101,29 +465,132 @@ namespace
     if (rank > 0)
         Log::set_verbosity(0);
 
+    int size = 1;
+    PMPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Select the trace rank subset (if configured) before Caliper
+    // initializes and fixes the service configuration
+
+    bool        subset_traced = false;
+    std::string subset_coverage;
+
+    bool subset_active = ::setup_trace_subset(rank, size, &subset_traced, &subset_coverage);
+
     // Make sure Caliper is initialized
-    Caliper c;    
+    Caliper c;
 
     if (mpi_enabled) {
         ::setup_filter();
 
-        int size;
-        PMPI_Comm_size(MPI_COMM_WORLD, &size);
-
         c.set(mpisize_attr, Variant(size));
         c.set(mpirank_attr, Variant(rank));
+
+        if (subset_active) {
+            c.set(mpitraceactive_attr,   Variant(subset_traced));
+            c.set(mpitracecoverage_attr,
+                  Variant(CALI_TYPE_STRING, subset_coverage.c_str(), subset_coverage.size()));
+        }
+
+        ::outlier_setup();
     }
 }{{endfn}}
 
-// Wrap all MPI functions
+// Send functions: track sent bytes in statistics mode
 
-{{fnall func MPI_Init MPI_Init_thread}}{
+{{fn func MPI_Send MPI_Bsend MPI_Rsend MPI_Ssend MPI_Isend}}{
     if (mpi_enabled && ::enable_{{func}}) {
+        if (mpi_stats_enabled) {
+            double t = PMPI_Wtime();
+            {{callfn}}
+            double dt = PMPI_Wtime() - t;
+            int typesize = 0;
+            PMPI_Type_size({{2}}, &typesize);
+            ::stats_{{func}}.add(static_cast<uint64_t>({{1}}) * typesize, 0, dt);
+            ::outlier_add(dt);
+        } else {
+            Caliper c;
+            c.begin(mpifn_attr, Variant(CALI_TYPE_STRING, "{{func}}", strlen("{{func}}")));
+            double t = mpi_outlier_enabled ? PMPI_Wtime() : 0.0;
+            {{callfn}}
+            if (mpi_outlier_enabled)
+                ::outlier_add(PMPI_Wtime() - t);
+            c.end(mpifn_attr);
+        }
+        ::outlier_progress();
+    } else {
+        {{callfn}}
+    }
+}{{endfn}}
+
+// Receive functions: track received bytes (posted counts) in statistics mode
+
+{{fn func MPI_Recv MPI_Irecv}}{
+    if (mpi_enabled && ::enable_{{func}}) {
+        if (mpi_stats_enabled) {
+            double t = PMPI_Wtime();
+            {{callfn}}
+            double dt = PMPI_Wtime() - t;
+            int typesize = 0;
+            PMPI_Type_size({{2}}, &typesize);
+            ::stats_{{func}}.add(0, static_cast<uint64_t>({{1}}) * typesize, dt);
+            ::outlier_add(dt);
+        } else {
+            Caliper c;
+            c.begin(mpifn_attr, Variant(CALI_TYPE_STRING, "{{func}}", strlen("{{func}}")));
+            double t = mpi_outlier_enabled ? PMPI_Wtime() : 0.0;
+            {{callfn}}
+            if (mpi_outlier_enabled)
+                ::outlier_add(PMPI_Wtime() - t);
+            c.end(mpifn_attr);
+        }
+        ::outlier_progress();
+    } else {
+        {{callfn}}
+    }
+}{{endfn}}
+
+// MPI_Finalize: flush collected statistics first
+
+{{fn func MPI_Finalize}}{
+    if (mpi_enabled)
+        ::outlier_drain();
+
+    if (mpi_enabled && mpi_stats_enabled) {
+        Caliper c;
+        ::flush_statistics(&c);
+    }
+
+    if (mpi_enabled && ::enable_MPI_Finalize && !mpi_stats_enabled) {
         Caliper c;
-        c.begin(mpifn_attr, Variant(CALI_TYPE_STRING, "{{func}}", strlen("{{func}}")));
+        c.begin(mpifn_attr, Variant(CALI_TYPE_STRING, "MPI_Finalize", strlen("MPI_Finalize")));
         {{callfn}}
         c.end(mpifn_attr);
     } else {
         {{callfn}}
     }
+}{{endfn}}
+
+// Wrap all other MPI functions
+
+{{fnall func MPI_Init MPI_Init_thread MPI_Finalize MPI_Send MPI_Bsend MPI_Rsend MPI_Ssend MPI_Isend MPI_Recv MPI_Irecv}}{
+    if (mpi_enabled && ::enable_{{func}}) {
+        if (mpi_stats_enabled) {
+            double t = PMPI_Wtime();
+            {{callfn}}
+            double dt = PMPI_Wtime() - t;
+            ::stats_{{func}}.add(0, 0, dt);
+            ::outlier_add(dt);
+        } else {
+            Caliper c;
+            c.begin(mpifn_attr, Variant(CALI_TYPE_STRING, "{{func}}", strlen("{{func}}")));
+            double t = mpi_outlier_enabled ? PMPI_Wtime() : 0.0;
+            {{callfn}}
+            if (mpi_outlier_enabled)
+                ::outlier_add(PMPI_Wtime() - t);
+            c.end(mpifn_attr);
+        }
+        ::outlier_progress();
+    } else {
+        {{callfn}}
+    }
 }{{endfnall}}
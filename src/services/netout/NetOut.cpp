@@ -8,21 +8,28 @@
 #include "caliper/Caliper.h"
 #include "caliper/SnapshotRecord.h"
 
+#include "caliper/common/CompressedSnapshotRecord.h"
 #include "caliper/common/SnapshotTextFormatter.h"
+#include "caliper/common/Health.h"
 #include "caliper/common/Log.h"
 #include "caliper/common/RuntimeConfig.h"
 
 #include "caliper/common/util/split.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <functional>
 #include <iterator>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <sstream>
+#include <thread>
 #include <vector>
 
 using namespace cali;
@@ -51,9 +58,145 @@ const ConfigSet::Entry   configdata[] = {
     { "posturl" , CALI_TYPE_STRING, "https://lc.llnl.gov",
       "URL to issue requests to"
     },
+    { "binary", CALI_TYPE_BOOL, "false",
+      "Send snapshots in binary form",
+      "Send snapshots as compressed binary records instead of formatted\n"
+      "text, avoiding any re-encoding of the snapshot data."
+    },
+    { "async", CALI_TYPE_BOOL, "true",
+      "Send records from a background network thread",
+      "Queue outgoing records and send them from a dedicated network\n"
+      "thread, so network hiccups do not stall application threads.\n"
+      "When the send queue is full, the oldest queued record is dropped."
+    },
+    { "queue_size", CALI_TYPE_UINT, "256",
+      "Size of the asynchronous send queue",
+      "Size of the asynchronous send queue"
+    },
     ConfigSet::Terminator
 };
 
+//
+// Bounded lock-free MPMC queue for outgoing records, same scheme as
+// the runtime's snapshot queue: a slot's sequence number equals its
+// position when free, position+1 when filled. Application threads
+// enqueue encoded records; the network thread drains them. On
+// overflow the caller drops the oldest record and retries.
+//
+
+class SendQueue {
+public:
+
+    static const std::size_t MAX_RECORD = 4096;
+
+private:
+
+    struct Slot {
+        std::atomic<std::size_t> seq;
+
+        std::size_t   len;
+        unsigned char data[MAX_RECORD];
+
+        Slot() : seq(0), len(0) { }
+    };
+
+    std::vector<Slot>        m_slots;
+    std::size_t              m_mask;
+
+    std::atomic<std::size_t> m_enqueue_pos;
+    std::atomic<std::size_t> m_dequeue_pos;
+
+    static std::size_t next_power_of_two(std::size_t n) {
+        std::size_t p = 2;
+
+        while (p < n)
+            p *= 2;
+
+        return p;
+    }
+
+public:
+
+    explicit SendQueue(std::size_t capacity)
+        : m_slots(next_power_of_two(capacity)),
+          m_mask(m_slots.size() - 1),
+          m_enqueue_pos(0), m_dequeue_pos(0)
+        {
+            for (std::size_t i = 0; i < m_slots.size(); ++i)
+                m_slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+    /// \return false if the queue is full
+    bool enqueue(const unsigned char* data, std::size_t len) {
+        if (len > MAX_RECORD)
+            return false;
+
+        std::size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+
+        Slot* slot;
+
+        for (;;) {
+            slot = &m_slots[pos & m_mask];
+
+            std::size_t seq = slot->seq.load(std::memory_order_acquire);
+
+            if (seq == pos) {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+                    break;
+            } else if (seq < pos)
+                return false; // queue is full
+            else
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        }
+
+        memcpy(slot->data, data, len);
+        slot->len = len;
+
+        slot->seq.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /// \return false if the queue is empty
+    bool dequeue(unsigned char* data, std::size_t& len) {
+        std::size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+
+        Slot* slot;
+
+        for (;;) {
+            slot = &m_slots[pos & m_mask];
+
+            std::size_t seq = slot->seq.load(std::memory_order_acquire);
+
+            if (seq == pos + 1) {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+                    break;
+            } else if (seq < pos + 1)
+                return false; // queue is empty
+            else
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        }
+
+        len = slot->len;
+        memcpy(data, slot->data, len);
+
+        slot->seq.store(pos + m_mask + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /// Remove and discard the oldest queued record.
+    /// Returns the discarded record's length.
+    std::size_t drop_oldest() {
+        unsigned char scratch[MAX_RECORD];
+        std::size_t   len = 0;
+
+        dequeue(scratch, len);
+
+        return len;
+    }
+};
+
 class NetOutService
 {
     ConfigSet                   config;
@@ -73,9 +216,20 @@ class NetOutService
     Stream                      m_stream;
     ofstream                    m_ofstream;
     std::string                 m_output_url;
-    Attribute                   set_event_attr;   
+    Attribute                   set_event_attr;
     Attribute                   end_event_attr;
 
+    bool                        m_binary;
+    bool                        m_async;
+
+    std::unique_ptr<SendQueue>  m_queue;
+    std::thread                 m_sender;
+    std::atomic<bool>           m_sender_active;
+
+    std::atomic<unsigned>       m_num_sent;
+    std::atomic<unsigned>       m_num_send_failed;
+    std::atomic<unsigned>       m_num_dropped;
+
     static unique_ptr<NetOutService> 
                                 s_netout;
 
@@ -173,32 +327,110 @@ class NetOutService
         if (trigger_attr == Attribute::invalid || snapshot->get(trigger_attr).is_empty())
             return;
 
-        std::vector<Entry> entrylist;
-
-        SnapshotRecord::Sizes size = snapshot->size();
-        SnapshotRecord::Data  data = snapshot->data();
-
-        for (size_t n = 0; n < size.n_nodes; ++n)
-            entrylist.push_back(Entry(data.node_entries[n]));
-        for (size_t n = 0; n < size.n_immediate; ++n)
-            entrylist.push_back(Entry(data.immediate_attr[n], data.immediate_data[n]));
-
-        // DZPOLIA EDITING HERE
-        formatter.print(string_output, c, entrylist) << std::endl;
-        std::string outThis = string_output.str();
-        curl_easy_setopt(m_curl,CURLOPT_URL,m_output_url.c_str());
-        curl_easy_setopt(m_curl,CURLOPT_USERAGENT,"libcurl-agent/1.0");
-        curl_easy_setopt(s_netout->getCurl(),CURLOPT_POSTFIELDS,outThis.c_str());
-        curl_easy_setopt(s_netout->getCurl(),CURLOPT_POSTFIELDSIZE,outThis.length());
-        CURLcode result = curl_easy_perform(m_curl);
-        if(result != CURLE_OK) {
-            fprintf(stderr, "curl_easy_perform() failed: %s\n",
-            curl_easy_strerror(result));
+        if (m_binary) {
+            // Merge the reference entries into a single path id: the
+            // receiver reconstructs the chain from the node metadata
+            unsigned char buf[SendQueue::MAX_RECORD];
+
+            CompressedSnapshotRecord rec(sizeof(buf), buf);
+
+            rec.append_path(*c, snapshot);
+
+            dispatch(rec.data(), rec.size());
+        } else {
+            std::vector<Entry> entrylist;
+
+            SnapshotRecord::Sizes size = snapshot->size();
+            SnapshotRecord::Data  data = snapshot->data();
+
+            for (size_t n = 0; n < size.n_nodes; ++n)
+                entrylist.push_back(Entry(data.node_entries[n]));
+            for (size_t n = 0; n < size.n_immediate; ++n)
+                entrylist.push_back(Entry(data.immediate_attr[n], data.immediate_data[n]));
+
+            // DZPOLIA EDITING HERE
+            formatter.print(string_output, c, entrylist) << std::endl;
+            std::string outThis = string_output.str();
+            string_output.str(std::string());
+
+            dispatch(reinterpret_cast<const unsigned char*>(outThis.data()), outThis.length());
+        }
+    }
+
+    // Queue the record for the network thread, or send it right away
+    // in synchronous mode. When the queue is full, drop the oldest
+    // queued record in favor of the new one.
+    void dispatch(const unsigned char* data, size_t len) {
+        if (m_async) {
+            while (!m_queue->enqueue(data, len)) {
+                std::size_t dropped = m_queue->drop_oldest();
+
+                ++m_num_dropped;
+
+                Health::inc(Health::DroppedSnapshots);
+                Health::inc(Health::DroppedBytes, dropped);
+            }
+        } else
+            post_payload(m_curl, data, len);
+    }
+
+    void post_payload(CURL* curl, const unsigned char* data, size_t len) {
+        curl_easy_setopt(curl, CURLOPT_URL, m_output_url.c_str());
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, len);
+
+        CURLcode result = curl_easy_perform(curl);
+
+        if (result != CURLE_OK) {
+            ++m_num_send_failed;
+            Log(2).stream() << "NetOut: curl_easy_perform() failed: "
+                            << curl_easy_strerror(result) << std::endl;
+        } else
+            ++m_num_sent;
+    }
+
+    // Network thread: drains the send queue. Uses its own curl handle;
+    // curl easy handles must not be shared across threads.
+    void sender_fn() {
+        CURL* curl = curl_easy_init();
+
+        if (m_binary) {
+            struct curl_slist* headers =
+                curl_slist_append(nullptr, "Content-Type: application/octet-stream");
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
         }
-        else{
-            fprintf(stderr, "curl_easy_perform() success\n");
+
+        unsigned char buf[SendQueue::MAX_RECORD];
+        size_t        len;
+
+        while (m_sender_active.load()) {
+            if (m_queue->dequeue(buf, len))
+                post_payload(curl, buf, len);
+            else
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
-        
+
+        // drain remaining records before exiting
+        while (m_queue->dequeue(buf, len))
+            post_payload(curl, buf, len);
+
+        curl_easy_cleanup(curl);
+    }
+
+    void stop_sender() {
+        if (!m_sender_active.exchange(false))
+            return;
+
+        m_sender.join();
+    }
+
+    void finish_cb(Caliper* c) {
+        stop_sender();
+
+        Log(1).stream() << "NetOut: " << m_num_sent.load() << " records sent, "
+                        << m_num_send_failed.load() << " failed, "
+                        << m_num_dropped.load()     << " dropped." << std::endl;
     }
 
     void post_init_cb(Caliper* c) {
@@ -219,6 +451,13 @@ class NetOutService
             set_event_attr      == Attribute::invalid)
             Log(1).stream() << "NetOut: Note: \"event\" trigger attributes not registered\n"
                 "    disabling text log.\n" << std::endl;
+
+        if (m_async) {
+            m_queue.reset(new SendQueue(std::max<uint64_t>(config.get("queue_size").to_uint(), 2)));
+
+            m_sender_active.store(true);
+            m_sender = std::thread(&NetOutService::sender_fn, this);
+        }
     }
 
     // static callbacks
@@ -231,25 +470,39 @@ class NetOutService
         s_netout->process_snapshot_cb(c, trigger_info, snapshot);
     }
 
-    static void s_post_init_cb(Caliper* c) { 
+    static void s_post_init_cb(Caliper* c) {
         s_netout->post_init_cb(c);
     }
+
+    static void s_finish_cb(Caliper* c) {
+        s_netout->finish_cb(c);
+    }
     decltype(m_curl) getCurl(){
         return m_curl;
     }
     NetOutService(Caliper* c)
         : config(RuntimeConfig::init("netout", configdata)),
           set_event_attr(Attribute::invalid),
-          end_event_attr(Attribute::invalid)
-        { 
+          end_event_attr(Attribute::invalid),
+          m_binary(false),
+          m_async(true),
+          m_sender_active(false),
+          m_num_sent(0),
+          m_num_send_failed(0),
+          m_num_dropped(0)
+        {
             init_stream();
 
-            util::split(config.get("trigger").to_string(), ':', 
+            util::split(config.get("trigger").to_string(), ':',
                         std::back_inserter(trigger_attr_names));
 
+            m_binary = config.get("binary").to_bool();
+            m_async  = config.get("async").to_bool();
+
             c->events().create_attr_evt.connect(&NetOutService::s_create_attribute_cb);
             c->events().post_init_evt.connect(&NetOutService::s_post_init_cb);
             c->events().process_snapshot.connect(&NetOutService::s_process_snapshot_cb);
+            c->events().finish_evt.connect(&NetOutService::s_finish_cb);
 
             Log(1).stream() << "Registered text log service" << std::endl;
         }
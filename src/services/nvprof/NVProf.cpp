@@ -36,6 +36,7 @@
 #include "../common/AnnotationBinding.h"
 
 #include "caliper/common/Attribute.h"
+#include "caliper/common/Node.h"
 
 #include <nvToolsExt.h>
 
@@ -43,6 +44,8 @@
 #include <cassert>
 #include <map>
 #include <mutex>
+#include <string>
+#include <vector>
 
 namespace cali
 {
@@ -58,12 +61,45 @@ class NVProfBinding : public AnnotationBinding
     std::map<cali_id_t, nvtxDomainHandle_t> m_domain_map;
     std::mutex            m_domain_mutex;
 
+    // Registered-string handles indexed by region node id, so
+    // steady-state range pushes are handle-based and don't rebuild the
+    // name string. NVTX registers a name once per unique region.
+    bool                  m_pool_handles;
+
+    std::vector<nvtxStringHandle_t> m_handle_vec;
+    std::mutex            m_handle_mutex;
+
+    static const ConfigSet::Entry s_configdata[];
+
+    // Get or register the name handle for the given region node
+    nvtxStringHandle_t get_string_handle(nvtxDomainHandle_t domain, const Node* node, const Variant& value) {
+        std::lock_guard<std::mutex>
+            g(m_handle_mutex);
+
+        if (node->id() >= m_handle_vec.size())
+            m_handle_vec.resize(node->id() + 1, nullptr);
+
+        nvtxStringHandle_t handle = m_handle_vec[node->id()];
+
+        if (!handle) {
+            std::string name = value.to_string();
+
+            handle = nvtxDomainRegisterStringA(domain, name.c_str());
+            m_handle_vec[node->id()] = handle;
+        }
+
+        return handle;
+    }
+
 public:
 
     void initialize(Caliper* c) {
         m_color_attr =
             c->create_attribute("nvtx.color", CALI_TYPE_UINT,
                                 CALI_ATTR_SKIP_EVENTS | CALI_ATTR_HIDDEN);
+
+        m_pool_handles =
+            RuntimeConfig::init("nvprof", s_configdata).get("pool_handles").to_bool();
     }
 
     const char* service_tag() const { return "nvvp"; }
@@ -77,45 +113,62 @@ public:
          *node = c->make_tree_entry(m_color_attr, v_color, *node);
     }
 
-    void on_begin(Caliper*, const Attribute &attr, const Variant& value) {
+    void on_begin(Caliper* c, const Attribute &attr, const Variant& value) {
         Variant  v_color = attr.get(m_color_attr);
         uint32_t color   =
             v_color.empty() ? s_colors[0] : static_cast<uint32_t>(v_color.to_uint());
 
+        // For properly nested attributes, just use default push/pop.
+        // For other attributes, create a domain.
+
+        nvtxDomainHandle_t domain = nullptr;
+
+        if (!attr.is_nested()) {
+            std::lock_guard<std::mutex>
+                g(m_domain_mutex);
+
+            auto it = m_domain_map.find(attr.id());
+
+            if (it == m_domain_map.end()) {
+                domain = nvtxDomainCreateA(attr.name().c_str());
+                m_domain_map.insert(std::make_pair(attr.id(), domain));
+            } else {
+                domain = it->second;
+            }
+        }
+
         nvtxEventAttributes_t eventAttrib = { 0 };
 
         eventAttrib.version       = NVTX_VERSION;
         eventAttrib.size          = NVTX_EVENT_ATTRIB_STRUCT_SIZE;
         eventAttrib.colorType     = NVTX_COLOR_ARGB;
         eventAttrib.color         = color;
-        eventAttrib.messageType   = NVTX_MESSAGE_TYPE_ASCII;
-        eventAttrib.message.ascii =
-            (value.type() == CALI_TYPE_STRING ? static_cast<const char*>(value.data()) : value.to_string().c_str());
 
-        // For properly nested attributes, just use default push/pop.
-        // For other attributes, create a domain.
+        nvtxStringHandle_t handle = nullptr;
 
-        if (attr.is_nested()) {
-            nvtxRangePushEx(&eventAttrib);
-        } else {
-            nvtxDomainHandle_t domain;
+        if (m_pool_handles && !attr.store_as_value()) {
+            // the node begin() will resolve this region to; repeat
+            // regions find the existing node
+            Node* node = c->make_tree_entry(attr, value,
+                                            const_cast<Node*>(c->get(attr).node()));
 
-            {
-                std::lock_guard<std::mutex>
-                    g(m_domain_mutex);
-
-                auto it = m_domain_map.find(attr.id());
+            if (node)
+                handle = get_string_handle(domain, node, value);
+        }
 
-                if (it == m_domain_map.end()) {
-                    domain = nvtxDomainCreateA(attr.name().c_str());
-                    m_domain_map.insert(std::make_pair(attr.id(), domain));
-                } else {
-                    domain = it->second;
-                }
-            }
+        if (handle) {
+            eventAttrib.messageType   = NVTX_MESSAGE_TYPE_REGISTERED;
+            eventAttrib.message.registered = handle;
+        } else {
+            eventAttrib.messageType   = NVTX_MESSAGE_TYPE_ASCII;
+            eventAttrib.message.ascii =
+                (value.type() == CALI_TYPE_STRING ? static_cast<const char*>(value.data()) : value.to_string().c_str());
+        }
 
+        if (attr.is_nested())
+            nvtxRangePushEx(&eventAttrib);
+        else
             nvtxDomainRangePushEx(domain, &eventAttrib);
-        }
     }
 
     void on_end(Caliper*, const Attribute& attr, const Variant& value) {
@@ -145,6 +198,15 @@ public:
     }
 };
 
+const ConfigSet::Entry NVProfBinding::s_configdata[] = {
+    { "pool_handles", CALI_TYPE_BOOL, "true",
+      "Use pooled NVTX registered-string handles for range names",
+      "Use pooled NVTX registered-string handles for range names.\n"
+      "Registers each unique region's name with NVTX once and pushes\n"
+      "ranges by handle, avoiding per-event name string construction." },
+    ConfigSet::Terminator
+};
+
 const uint32_t NVProfBinding::s_colors[] = {
     0x0000cc00, 0x000000cc, 0x00cccc00, 0x00cc00cc,
     0x0000cccc, 0x00cc0000, 0x00cccccc
@@ -40,6 +40,8 @@
 #include "caliper/common/Log.h"
 #include "caliper/common/RuntimeConfig.h"
 
+#include "caliper/common/util/spinlock.hpp"
+
 #include <map>
 #include <mutex>
 
@@ -76,17 +78,64 @@ const ConfigSet::Entry configdata[] = {
 volatile bool                    finished    { false };
 bool                             enable_ompt { false };
 bool				 perm_off    { false };
+bool                             environment_mapping { false };
 Attribute                        thread_attr { Attribute::invalid };
 Attribute                        state_attr  { Attribute::invalid };
 Attribute			 region_attr { Attribute::invalid };
 
-std::mutex                       thread_env_lock;
-map<ompt_thread_id_t, Caliper::Scope*> thread_env; ///< Thread ID -> Environment
+// pre-resolved region entries: begin() with a pre-made tree entry does
+// no string work or node data allocation in the callback
+
+Node*                            parallel_node { nullptr };
+Node*                            idle_node     { nullptr };
+Node*                            barrier_node  { nullptr };
 
 map<ompt_state_t, string>        runtime_states;
 
 ConfigSet                        config;
 
+// Per-thread event staging: OMPT callbacks only touch the calling
+// thread's record, so they never serialize on shared state. Records
+// are linked into a global list once at thread begin and reconciled
+// at finish.
+
+struct ThreadEventInfo {
+    ompt_thread_id_t thread_id    { 0 };
+    Caliper::Scope*  scope        { nullptr };
+
+    unsigned         num_parallel { 0 };
+    unsigned         num_idle     { 0 };
+    unsigned         num_barrier  { 0 };
+
+    int              region_depth { 0 };
+
+    ThreadEventInfo* next         { nullptr };
+};
+
+thread_local ThreadEventInfo* t_event_info = nullptr;
+
+ThreadEventInfo* event_info_list = nullptr;
+util::spinlock   event_info_lock;
+
+ThreadEventInfo*
+acquire_event_info()
+{
+    ThreadEventInfo* ti = t_event_info;
+
+    if (!ti) {
+        ti = new ThreadEventInfo;
+        t_event_info = ti;
+
+        std::lock_guard<util::spinlock>
+            g(event_info_lock);
+
+        ti->next        = event_info_list;
+        event_info_list = ti;
+    }
+
+    return ti;
+}
+
 
 // The OMPT interface function pointers
 
@@ -122,21 +171,18 @@ cb_event_thread_begin(ompt_thread_type_t type, ompt_thread_id_t thread_id)
 {
     Caliper c;
 
-    if (config.get("environment_mapping").to_bool() == true) {
-        // Create a new Caliper environment for each thread. 
-        // Record thread id -> environment id mapping for later use in get_environment()
+    ThreadEventInfo* ti = acquire_event_info();
 
-        Caliper::Scope* ctx;
+    ti->thread_id = thread_id;
+
+    if (environment_mapping) {
+        // Create a new Caliper environment for each thread. The scope
+        // is kept in the thread-local record for get_thread_scope()
 
         if (type == ompt_thread_initial)
-            ctx = c.default_scope(CALI_SCOPE_THREAD);
+            ti->scope = c.default_scope(CALI_SCOPE_THREAD);
         else
-            ctx = c.create_scope(CALI_SCOPE_THREAD);
-
-        std::lock_guard<std::mutex>
-            g(thread_env_lock);
-        
-        thread_env.insert(make_pair(thread_id, ctx));
+            ti->scope = c.create_scope(CALI_SCOPE_THREAD);
     }
 
     // Set the thread id in the new environment
@@ -149,22 +195,17 @@ cb_event_thread_begin(ompt_thread_type_t type, ompt_thread_id_t thread_id)
 void
 cb_event_thread_end(ompt_thread_type_t type, ompt_thread_id_t thread_id)
 {
-    if (finished || config.get("environment_mapping").to_bool() == false)
+    if (finished || !environment_mapping)
         return;
 
-    Caliper::Scope* ctx { nullptr };
+    ThreadEventInfo* ti = t_event_info;
 
-    thread_env_lock.lock();
-    auto it = thread_env.find(thread_id);
-    
-    if (it != thread_env.end()) {
-        ctx = it->second;
-        thread_env.erase(it);
-    }
-    thread_env_lock.unlock();
+    if (ti && ti->scope) {
+        Caliper::Scope* ctx = ti->scope;
+        ti->scope = nullptr;
 
-    if (ctx)
         Caliper().release_scope(ctx);
+    }
 }
 
 // ompt_event_parallel_begin
@@ -173,9 +214,13 @@ void
 cb_event_parallel_begin(ompt_thread_type_t type)
 {
 	if ( enable_ompt == true && !finished ) {
-		Caliper c;
-		c.begin(region_attr, Variant(CALI_TYPE_STRING, "parallel", 8));
-	}	
+		ThreadEventInfo* ti = acquire_event_info();
+
+		++ti->num_parallel;
+		++ti->region_depth;
+
+		Caliper().begin(region_attr, parallel_node);
+	}
 }
 
 // ompt_event_parallel_end
@@ -184,8 +229,12 @@ void
 cb_event_parallel_end(ompt_thread_type_t type)
 {
 	if ( enable_ompt == true && !finished ) {
-		Caliper c;
-		c.end(region_attr);
+		ThreadEventInfo* ti = acquire_event_info();
+
+		if (ti->region_depth > 0) {
+			--ti->region_depth;
+			Caliper().end(region_attr);
+		}
 	}
 }
 
@@ -195,9 +244,13 @@ void
 cb_event_idle_begin(ompt_thread_type_t type)
 {
 	if ( enable_ompt == true && !finished ) {
-		Caliper c;
-		c.begin(region_attr, Variant(CALI_TYPE_STRING, "idle", 4));
-	}	
+		ThreadEventInfo* ti = acquire_event_info();
+
+		++ti->num_idle;
+		++ti->region_depth;
+
+		Caliper().begin(region_attr, idle_node);
+	}
 }
 
 // ompt_event_idle_end
@@ -206,8 +259,12 @@ void
 cb_event_idle_end(ompt_thread_type_t type)
 {
 	if ( enable_ompt == true && !finished ) {
-		Caliper c;
-		c.end(region_attr);
+		ThreadEventInfo* ti = acquire_event_info();
+
+		if (ti->region_depth > 0) {
+			--ti->region_depth;
+			Caliper().end(region_attr);
+		}
 	}
 }
 
@@ -218,9 +275,13 @@ void
 cb_event_wait_barrier_begin(ompt_thread_type_t type, ompt_thread_id_t thread_id)
 {
 	if ( enable_ompt == true && !finished) {
-		Caliper c;
-		c.begin(region_attr, Variant(CALI_TYPE_STRING,"barrier",7));
-	}	
+		ThreadEventInfo* ti = acquire_event_info();
+
+		++ti->num_barrier;
+		++ti->region_depth;
+
+		Caliper().begin(region_attr, barrier_node);
+	}
 }
 
 // ompt_event_wait_barrier_end
@@ -229,8 +290,12 @@ void
 cb_event_wait_barrier_end(ompt_thread_type_t type, ompt_thread_id_t thread_id)
 {
 	if ( enable_ompt == true && !finished) {
-		Caliper c;
-		c.end(region_attr);
+		ThreadEventInfo* ti = acquire_event_info();
+
+		if (ti->region_depth > 0) {
+			--ti->region_depth;
+			Caliper().end(region_attr);
+		}
 	}
 }
 
@@ -283,25 +348,45 @@ void
 finish_cb(Caliper*)
 {
     finished = true;
-}
 
-Caliper::Scope*
-get_thread_scope(Caliper* c, bool alloc) 
-{
-    Caliper::Scope* ctx = c->default_scope(CALI_SCOPE_THREAD);
+    // reconcile the per-thread event records
 
-    if (!api.get_thread_id)
-        return ctx;
+    ThreadEventInfo* ti = nullptr;
 
-    ompt_thread_id_t thread_id = (*api.get_thread_id)();
+    {
+        std::lock_guard<util::spinlock>
+            g(event_info_lock);
+
+        ti = event_info_list;
+    }
+
+    unsigned num_threads  = 0;
+    unsigned num_parallel = 0;
+    unsigned num_idle     = 0;
+    unsigned num_barrier  = 0;
 
-    thread_env_lock.lock();
-    auto it = thread_env.find(thread_id);
-    if (it != thread_env.end())
-        ctx = it->second;
-    thread_env_lock.unlock();
+    for ( ; ti; ti = ti->next) {
+        ++num_threads;
 
-    return ctx;
+        num_parallel += ti->num_parallel;
+        num_idle     += ti->num_idle;
+        num_barrier  += ti->num_barrier;
+    }
+
+    if (num_parallel + num_idle + num_barrier > 0)
+        Log(2).stream() << "ompt: processed "
+                        << num_parallel << " parallel, "
+                        << num_idle     << " idle, "
+                        << num_barrier  << " barrier events on "
+                        << num_threads  << " threads." << endl;
+}
+
+Caliper::Scope*
+get_thread_scope(Caliper* c, bool alloc)
+{
+    ThreadEventInfo* ti = t_event_info;
+
+    return ti && ti->scope ? ti->scope : c->default_scope(CALI_SCOPE_THREAD);
 }
 
 void
@@ -394,7 +479,16 @@ omptservice_initialize(Caliper* c)
 	c->create_attribute("ompt.region",    CALI_TYPE_STRING,
 			    CALI_ATTR_SCOPE_THREAD);
 
-    if (config.get("environment_mapping").to_bool() == true)
+    parallel_node =
+        c->make_tree_entry(region_attr, Variant(CALI_TYPE_STRING, "parallel", 8));
+    idle_node =
+        c->make_tree_entry(region_attr, Variant(CALI_TYPE_STRING, "idle", 4));
+    barrier_node =
+        c->make_tree_entry(region_attr, Variant(CALI_TYPE_STRING, "barrier", 7));
+
+    environment_mapping = config.get("environment_mapping").to_bool();
+
+    if (environment_mapping)
         c->set_scope_callback(CALI_SCOPE_THREAD, &get_thread_scope);
 
     c->events().finish_evt.connect(&finish_cb);
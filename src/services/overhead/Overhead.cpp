@@ -0,0 +1,164 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @file  Overhead.cpp
+/// @brief Caliper self-measurement service
+///
+/// Times the snapshot and snapshot-processing callback chains and
+/// reports per-snapshot latency histograms and totals at exit, so
+/// Caliper's own overhead can be measured in production configs
+/// without an uninstrumented reference run.
+
+#include "../CaliperService.h"
+
+#include "caliper/Caliper.h"
+
+#include "caliper/common/Log.h"
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+
+using namespace cali;
+using namespace std;
+
+namespace
+{
+
+const int MAX_BUCKET = 26; // log2 latency buckets, 1ns .. ~32ms
+
+struct ChainStatistics {
+    atomic<unsigned>           count;
+    atomic<unsigned long long> time_nsec;
+
+    atomic<unsigned>           histogram[MAX_BUCKET];
+
+    void add(unsigned long long nsec) {
+        ++count;
+        time_nsec += nsec;
+
+        int b = 0;
+        for (unsigned long long v = nsec; v > 1 && b < MAX_BUCKET-1; v >>= 1)
+            ++b;
+
+        ++histogram[b];
+    }
+
+    void reset() {
+        count     = 0;
+        time_nsec = 0;
+
+        for (int b = 0; b < MAX_BUCKET; ++b)
+            histogram[b] = 0;
+    }
+};
+
+ChainStatistics snapshot_stats;
+ChainStatistics process_stats;
+
+thread_local chrono::steady_clock::time_point snapshot_start;
+thread_local chrono::steady_clock::time_point process_start;
+
+void pre_snapshot_cb(Caliper*, int, const SnapshotRecord*, SnapshotRecord*)
+{
+    snapshot_start = chrono::steady_clock::now();
+}
+
+void post_snapshot_cb(Caliper*, int, const SnapshotRecord*, SnapshotRecord*)
+{
+    snapshot_stats.add(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - snapshot_start).count());
+}
+
+void pre_process_snapshot_cb(Caliper*, const SnapshotRecord*, const SnapshotRecord*)
+{
+    process_start = chrono::steady_clock::now();
+}
+
+void post_process_snapshot_cb(Caliper*, const SnapshotRecord*, const SnapshotRecord*)
+{
+    process_stats.add(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - process_start).count());
+}
+
+void print_chain(ostream& os, const char* name, const ChainStatistics& s)
+{
+    unsigned           count = s.count.load();
+    unsigned long long nsec  = s.time_nsec.load();
+
+    os << "\n     " << name << ": "
+       << count << " invocations, total "
+       << nsec / 1000 << " usec";
+
+    if (count > 0)
+        os << ", avg " << nsec / count << " nsec";
+
+    for (int b = 0; b < MAX_BUCKET; ++b)
+        if (s.histogram[b].load() > 0)
+            os << "\n       <= " << (1ull << (b+1)) << " nsec: "
+               << s.histogram[b].load();
+}
+
+void finish_cb(Caliper* c)
+{
+    // format into a local buffer and emit in one statement: the stream
+    // returned by Log::stream() lives only as long as the Log temporary
+    ostringstream os;
+
+    os << "Overhead statistics:";
+
+    print_chain(os, "snapshot callbacks  ", snapshot_stats);
+    print_chain(os, "processing callbacks", process_stats);
+
+    Log(1).stream() << os.str() << endl;
+}
+
+void overhead_service_register(Caliper* c)
+{
+    snapshot_stats.reset();
+    process_stats.reset();
+
+    c->events().pre_snapshot_evt.connect(&pre_snapshot_cb);
+    c->events().post_snapshot_evt.connect(&post_snapshot_cb);
+    c->events().pre_process_snapshot_evt.connect(&pre_process_snapshot_cb);
+    c->events().post_process_snapshot_evt.connect(&post_process_snapshot_cb);
+    c->events().finish_evt.connect(&finish_cb);
+
+    Log(1).stream() << "Registered overhead service" << endl;
+}
+
+} // namespace
+
+namespace cali
+{
+    CaliperService overhead_service = { "overhead", ::overhead_service_register };
+}
@@ -1,4 +1,4 @@
-// Copyright (c) 2015, Lawrence Livermore National Security, LLC.  
+// Copyright (c) 2015, Lawrence Livermore National Security, LLC.
 // Produced at the Lawrence Livermore National Laboratory.
 //
 // This file is part of Caliper.
@@ -46,6 +46,8 @@
 
 #include <pthread.h>
 
+#include <atomic>
+#include <chrono>
 #include <vector>
 
 using namespace cali;
@@ -53,31 +55,74 @@ using namespace std;
 
 #include <papi.h>
 
-namespace 
+namespace
 {
 
 #define MAX_COUNTERS 32
-    
+
+// A set of counters that is programmed into the PMU together. With a
+// single group the group is always active; with multiple groups the
+// active group rotates on a time or snapshot-count schedule.
+struct CounterGroup {
+    std::string            name;
+    std::vector<int>       events;
+    std::vector<cali_id_t> delta_attrs;
+    std::vector<cali_id_t> accum_attrs;
+};
+
 struct PapiGlobalInfo {
-    std::vector<cali_id_t> counter_delta_attrs;
-    std::vector<cali_id_t> counter_accum_attrs;
-    std::vector<int>       counter_events;
-    bool                   record_delta;
-    bool                   record_accum;
+    std::vector<CounterGroup> groups;
+    bool                      record_delta;
+    bool                      record_accum;
 } global_info;
 
 struct ThreadInfo {
-    long long* accum_values;
+    long long* accum_values; // accumulated counts, MAX_COUNTERS slots per group
+    size_t     group;        // group currently programmed on this thread
     bool       active;
 };
 
 pthread_key_t threadinfo_key;
 size_t        num_failed = 0;
-    
+
+// --- counter group rotation state
+
+unsigned      rotation_snapshots = 0;
+unsigned      rotation_interval  = 0;
+
+cali_id_t     group_attr_id      = CALI_INV_ID;
+
+std::atomic<unsigned> snapshot_count;
+
+std::chrono::steady_clock::time_point rotation_start_time;
+
 static const ConfigSet::Entry s_configdata[] = {
     { "counters", CALI_TYPE_STRING, "",
       "List of PAPI events to record",
-      "List of PAPI events to record, separated by ','" 
+      "List of PAPI events to record, separated by ','"
+    },
+    { "counter_groups", CALI_TYPE_STRING, "",
+      "Named counter groups to rotate through",
+      "Named counter groups to rotate through, e.g.\n"
+      "  \"mem=PAPI_L1_DCM,PAPI_L2_DCM;ins=PAPI_TOT_INS,PAPI_TOT_CYC\"\n"
+      "Groups are separated by ';', events within a group by ','.\n"
+      "The active group rotates on the configured schedule, so more\n"
+      "events can be recorded in one run than fit into the PMU at\n"
+      "once. Records are tagged with the active group (papi.group),\n"
+      "and the group count is recorded in the stream\n"
+      "(papi.rotation.factor) so that readers can scale each group's\n"
+      "sums by its duty cycle. Overrides \"counters\" when set."
+    },
+    { "rotation_snapshots", CALI_TYPE_UINT, "100",
+      "Rotate the active counter group after this many snapshots",
+      "Rotate the active counter group after this many snapshots.\n"
+      "0: disable snapshot-count based rotation."
+    },
+    { "rotation_interval", CALI_TYPE_UINT, "0",
+      "Rotate the active counter group after this many milliseconds",
+      "Rotate the active counter group after this many milliseconds.\n"
+      "Takes precedence over rotation_snapshots when set.\n"
+      "0: disable time-based rotation."
     },
     { "record_difference", CALI_TYPE_BOOL, "true",
       "Record the counter value increases between subsequent snapshots.",
@@ -92,7 +137,28 @@ static const ConfigSet::Entry s_configdata[] = {
     ConfigSet::Terminator
 };
 
-    
+// Return the group that should be programmed according to the
+// rotation schedule
+size_t active_group()
+{
+    size_t ngroups = global_info.groups.size();
+
+    if (ngroups < 2)
+        return 0;
+
+    if (rotation_interval > 0) {
+        auto ms =
+            chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - rotation_start_time).count();
+
+        return (ms / rotation_interval) % ngroups;
+    }
+
+    if (rotation_snapshots > 0)
+        return (snapshot_count.load() / rotation_snapshots) % ngroups;
+
+    return 0;
+}
+
 void destroy_thread_info(void* data)
 {
     PAPI_unregister_thread();
@@ -101,48 +167,93 @@ void destroy_thread_info(void* data)
         return;
 
     ThreadInfo* info = static_cast<ThreadInfo*>(data);
-    
+
     delete[] info->accum_values;
     delete   info;
 }
-    
-ThreadInfo* get_thread_info(bool alloc, size_t num_counters)
+
+ThreadInfo* get_thread_info(bool alloc)
 {
     ThreadInfo* info = static_cast<ThreadInfo*>(pthread_getspecific(threadinfo_key));
 
-    if (!info && alloc && num_counters > 0) {
+    if (!info && alloc && !global_info.groups.empty()) {
         info = new ThreadInfo;
 
-        info->accum_values = new long long[num_counters];
+        info->accum_values = new long long[global_info.groups.size() * MAX_COUNTERS]();
+        info->group        = active_group();
         info->active       = false;
 
         pthread_setspecific(threadinfo_key, info);
 
         // Register thread and start counters on new thread
-        
+
         PAPI_register_thread();
 
-        if (PAPI_start_counters(global_info.counter_events.data(), num_counters) == PAPI_OK &&
-            PAPI_read_counters(info->accum_values, num_counters)                 == PAPI_OK)
+        CounterGroup& grp = global_info.groups[info->group];
+        long long     scratch[MAX_COUNTERS];
+
+        if (PAPI_start_counters(grp.events.data(), grp.events.size()) == PAPI_OK &&
+            PAPI_read_counters(scratch, grp.events.size())            == PAPI_OK)
             info->active = true;
     }
-    
+
     return info;
 }
-    
+
+// Reprogram the PMU with the target group's counters. The outgoing
+// group's final counts are credited to its accumulator.
+void switch_group(ThreadInfo* info, size_t target)
+{
+    CounterGroup& old = global_info.groups[info->group];
+
+    long long values[MAX_COUNTERS];
+
+    if (PAPI_stop_counters(values, old.events.size()) == PAPI_OK)
+        for (size_t i = 0; i < old.events.size(); ++i)
+            info->accum_values[info->group * MAX_COUNTERS + i] += values[i];
+
+    CounterGroup& grp = global_info.groups[target];
+
+    info->group  = target;
+    info->active = false;
+
+    if (PAPI_start_counters(grp.events.data(), grp.events.size()) == PAPI_OK)
+        info->active = true;
+}
+
 void snapshot_cb(Caliper* c, int scope, const SnapshotRecord*, SnapshotRecord* snapshot) {
-    auto num_counters = global_info.counter_events.size();
-    
-    if (num_counters < 1)
+    if (global_info.groups.empty())
         return;
 
-    ThreadInfo* thread_info = get_thread_info(!c->is_signal(), num_counters);
+    if (global_info.groups.size() > 1 && rotation_interval == 0 && rotation_snapshots > 0)
+        ++snapshot_count;
+
+    ThreadInfo* thread_info = get_thread_info(!c->is_signal());
 
     if (!thread_info || !thread_info->active) {
         ++num_failed;
         return;
     }
 
+    // Rotate to the scheduled group. Reprogramming the PMU is not
+    // signal safe, so signal-context snapshots read whichever group
+    // is currently programmed instead.
+
+    size_t target = active_group();
+
+    if (target != thread_info->group && !c->is_signal()) {
+        switch_group(thread_info, target);
+
+        if (!thread_info->active) {
+            ++num_failed;
+            return;
+        }
+    }
+
+    const CounterGroup& grp = global_info.groups[thread_info->group];
+
+    auto num_counters = grp.events.size();
+
     long long counter_values[MAX_COUNTERS];
 
     if (PAPI_read_counters(counter_values, num_counters) != PAPI_OK) {
@@ -153,25 +264,33 @@ void snapshot_cb(Caliper* c, int scope, const SnapshotRecord*, SnapshotRecord* s
     Variant data[MAX_COUNTERS];
 
     if (global_info.record_delta) {
-        for (int i = 0; i < num_counters; ++i)
+        for (size_t i = 0; i < num_counters; ++i)
             data[i] = Variant(static_cast<uint64_t>(counter_values[i]));
 
-        snapshot->append(num_counters, global_info.counter_delta_attrs.data(), data);
+        snapshot->append(num_counters, grp.delta_attrs.data(), data);
     }
 
     if (global_info.record_accum) {
-        for (int i = 0; i < num_counters; ++i) {
-            thread_info->accum_values[i] += counter_values[i];
-            data[i] = Variant(static_cast<uint64_t>(thread_info->accum_values[i]));
+        long long* accum = thread_info->accum_values + thread_info->group * MAX_COUNTERS;
+
+        for (size_t i = 0; i < num_counters; ++i) {
+            accum[i] += counter_values[i];
+            data[i]   = Variant(static_cast<uint64_t>(accum[i]));
         }
 
-        snapshot->append(num_counters, global_info.counter_accum_attrs.data(), data);
+        snapshot->append(num_counters, grp.accum_attrs.data(), data);
+    }
+
+    if (group_attr_id != CALI_INV_ID) {
+        Variant v_group(static_cast<uint64_t>(thread_info->group));
+
+        snapshot->append(1, &group_attr_id, &v_group);
     }
 }
 
 void papi_init(Caliper* c) {
     // start counters
-    get_thread_info(true, global_info.counter_events.size());
+    get_thread_info(true);
 }
 
 void papi_finish(Caliper* c) {
@@ -180,7 +299,7 @@ void papi_finish(Caliper* c) {
                         << " times." << std::endl;
 }
 
-void setup_events(Caliper* c, const string& eventstring)
+void setup_group_events(Caliper* c, CounterGroup& grp, const string& eventstring)
 {
     vector<string> events;
 
@@ -198,44 +317,72 @@ void setup_events(Caliper* c, const string& eventstring)
         }
 
         // check if we have this event already
-        if (std::find(global_info.counter_events.begin(), global_info.counter_events.end(), 
-                      code) != global_info.counter_events.end())
+        if (std::find(grp.events.begin(), grp.events.end(), code) != grp.events.end())
             continue;
 
-        if (global_info.counter_events.size() < MAX_COUNTERS) {
+        if (grp.events.size() < MAX_COUNTERS) {
             Attribute delta_attr =
                 c->create_attribute(string("papi.")+event, CALI_TYPE_UINT,
-                                    CALI_ATTR_ASVALUE      | 
-                                    CALI_ATTR_SCOPE_THREAD | 
+                                    CALI_ATTR_ASVALUE      |
+                                    CALI_ATTR_SCOPE_THREAD |
                                     CALI_ATTR_SKIP_EVENTS,
                                     1, &aggr_class_attr, &v_true);
-            Attribute accum_attr = 
+            Attribute accum_attr =
                 c->create_attribute(string("papi.accum.")+event, CALI_TYPE_UINT,
-                                    CALI_ATTR_ASVALUE      | 
-                                    CALI_ATTR_SCOPE_THREAD | 
+                                    CALI_ATTR_ASVALUE      |
+                                    CALI_ATTR_SCOPE_THREAD |
                                     CALI_ATTR_SKIP_EVENTS);
 
-            global_info.counter_events.push_back(code);
-            global_info.counter_delta_attrs.push_back(delta_attr.id());
-            global_info.counter_accum_attrs.push_back(accum_attr.id());
+            grp.events.push_back(code);
+            grp.delta_attrs.push_back(delta_attr.id());
+            grp.accum_attrs.push_back(accum_attr.id());
         } else
-            Log(0).stream() << "Maximum number of PAPI counters exceeded; dropping \"" 
+            Log(0).stream() << "Maximum number of PAPI counters exceeded; dropping \""
                             << event << '"' << endl;
     }
 }
 
+// Parse the counter_groups config: "name=EV1,EV2;name=EV3,..."
+void setup_groups(Caliper* c, const string& groupstring)
+{
+    vector<string> groupdefs;
+
+    util::split(groupstring, ';', back_inserter(groupdefs));
+
+    for (const string& def : groupdefs) {
+        if (def.empty())
+            continue;
+
+        string::size_type eq = def.find('=');
+
+        CounterGroup grp;
+
+        grp.name = (eq == string::npos ?
+                    string("group.") + std::to_string(global_info.groups.size()) :
+                    def.substr(0, eq));
+
+        setup_group_events(c, grp, eq == string::npos ? def : def.substr(eq+1));
+
+        if (grp.events.empty())
+            Log(0).stream() << "PAPI counter group \"" << grp.name
+                            << "\" has no valid events; dropping it" << endl;
+        else
+            global_info.groups.push_back(std::move(grp));
+    }
+}
+
 // Initialization handler
 void papi_register(Caliper* c) {
     int ret = PAPI_library_init(PAPI_VER_CURRENT);
-    
+
     if (ret != PAPI_VER_CURRENT && ret > 0) {
-        Log(0).stream() << "PAPI version mismatch: found " 
+        Log(0).stream() << "PAPI version mismatch: found "
                         << ret << ", expected " << PAPI_VER_CURRENT << endl;
         return;
-    }        
+    }
 
     PAPI_thread_init(pthread_self);
-    
+
     if (PAPI_is_initialized() == PAPI_NOT_INITED) {
         Log(0).stream() << "PAPI library is not initialized" << endl;
         return;
@@ -243,9 +390,22 @@ void papi_register(Caliper* c) {
 
     ConfigSet config = RuntimeConfig::init("papi", s_configdata);
 
-    setup_events(c, config.get("counters").to_string());
+    string groupstring = config.get("counter_groups").to_string();
+
+    if (groupstring.empty()) {
+        // single unnamed group from the "counters" config
+        CounterGroup grp;
+
+        grp.name = "default";
+
+        setup_group_events(c, grp, config.get("counters").to_string());
+
+        if (!grp.events.empty())
+            global_info.groups.push_back(std::move(grp));
+    } else
+        setup_groups(c, groupstring);
 
-    if (global_info.counter_events.size() < 1) {
+    if (global_info.groups.empty()) {
         Log(1).stream() << "No PAPI counters registered, dropping PAPI service" << endl;
         return;
     }
@@ -258,6 +418,37 @@ void papi_register(Caliper* c) {
     global_info.record_delta = config.get("record_difference").to_bool();
     global_info.record_accum = config.get("accumulate").to_bool();
 
+    rotation_interval   = config.get("rotation_interval").to_uint();
+    rotation_snapshots  = config.get("rotation_snapshots").to_uint();
+
+    snapshot_count.store(0);
+    rotation_start_time = chrono::steady_clock::now();
+
+    if (global_info.groups.size() > 1) {
+        // tag records with the active group, and record the group
+        // count in the stream so that readers can scale each group's
+        // sums by its duty cycle, e.g. scale(papi.EVENT, <groups>)
+
+        Attribute group_attr =
+            c->create_attribute("papi.group", CALI_TYPE_UINT,
+                                CALI_ATTR_ASVALUE      |
+                                CALI_ATTR_SCOPE_THREAD |
+                                CALI_ATTR_SKIP_EVENTS);
+
+        group_attr_id = group_attr.id();
+
+        Attribute factor_attr =
+            c->create_attribute("papi.rotation.factor", CALI_TYPE_UINT,
+                                CALI_ATTR_ASVALUE     |
+                                CALI_ATTR_SKIP_EVENTS |
+                                CALI_ATTR_SCOPE_PROCESS);
+
+        c->set(factor_attr, Variant(static_cast<uint64_t>(global_info.groups.size())));
+
+        Log(1).stream() << "PAPI: rotating " << global_info.groups.size()
+                        << " counter groups" << endl;
+    }
+
     // add callback for Caliper::get_context() event
     c->events().post_init_evt.connect(&papi_init);
     c->events().finish_evt.connect(&papi_finish);
@@ -269,7 +460,7 @@ void papi_register(Caliper* c) {
 } // namespace
 
 
-namespace cali 
+namespace cali
 {
     CaliperService papi_service = { "papi", ::papi_register };
 } // namespace cali
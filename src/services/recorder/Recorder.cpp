@@ -33,14 +33,24 @@
 /// @file Recorder.cpp
 /// @brief Caliper event recorder
 
+#include "caliper/caliper-config.h"
+
 #include "../CaliperService.h"
 
 #include "caliper/Caliper.h"
 #include "caliper/SnapshotRecord.h"
 
+#include "caliper/common/binary/BinarySpec.h"
+#include "caliper/common/binary/BinaryWriter.h"
+
+#ifdef CALIPER_HAVE_ZLIB
+#include "caliper/common/compress/CompressStream.h"
+#endif
+
 #include "caliper/common/csv/CsvSpec.h"
 #include "caliper/common/csv/CsvWriter.h"
 
+#include "caliper/common/AlignedFileStream.h"
 #include "caliper/common/ContextRecord.h"
 #include "caliper/common/Log.h"
 #include "caliper/common/Node.h"
@@ -71,17 +81,36 @@ class Recorder
     static const ConfigSet::Entry s_configdata[];
 
     enum class Stream { None, File, StdErr, StdOut };
+    enum class Format { Csv, Binary };
 
     ConfigSet     m_config;
 
     std::mutex    m_init_mutex;
     bool          m_writer_initialized;
-    
+
     Stream        m_stream;
+    Format        m_format;
     std::ofstream m_ofstream;
     std::string   m_filename;
 
+    bool          m_direct_io;
+    bool          m_drop_cache;
+
+    AlignedFileStream m_afstream;
+
+    bool          m_compress;
+    int           m_compress_level;
+
+    bool          m_write_index;
+    bool          m_sync_markers;
+    bool          m_raw_trace_flush;
+
     CsvWriter     m_writer;
+    BinaryWriter  m_bin_writer;
+
+#ifdef CALIPER_HAVE_ZLIB
+    CompressStream m_compress_stream;
+#endif
     
     // --- helpers
 
@@ -126,6 +155,93 @@ class Recorder
         else {
             m_stream = it->second;
         }
+
+        string format = m_config.get("format").to_string();
+
+        if      (format == "binary")
+            m_format = Format::Binary;
+        else if (format == "csv")
+            m_format = Format::Csv;
+        else {
+            Log(0).stream() << "Recorder: Unknown format \"" << format
+                            << "\", using csv" << std::endl;
+            m_format = Format::Csv;
+        }
+
+        string compress = m_config.get("compress").to_string();
+
+        m_compress       = false;
+        m_compress_level = static_cast<int>(m_config.get("compress_level").to_uint());
+
+        if (compress == "deflate") {
+#ifdef CALIPER_HAVE_ZLIB
+            m_compress = true;
+#else
+            Log(0).stream() << "Recorder: Cannot compress: "
+                            << "Caliper was built without zlib support" << std::endl;
+#endif
+        } else if (compress != "none")
+            Log(0).stream() << "Recorder: Unknown compression codec \"" << compress
+                            << "\", writing uncompressed" << std::endl;
+
+        m_write_index = m_config.get("write_index").to_bool();
+
+        if (m_write_index && m_format != Format::Csv) {
+            Log(1).stream() << "Recorder: Index is only supported for csv format" << std::endl;
+            m_write_index = false;
+        }
+        if (m_write_index && m_compress) {
+            Log(1).stream() << "Recorder: Cannot index compressed streams" << std::endl;
+            m_write_index = false;
+        }
+
+        m_sync_markers = m_config.get("sync_markers").to_bool();
+
+        if (m_sync_markers && m_format != Format::Csv) {
+            Log(1).stream() << "Recorder: Sync markers are only supported for csv format" << std::endl;
+            m_sync_markers = false;
+        }
+
+        m_raw_trace_flush = m_config.get("raw_trace_flush").to_bool();
+
+        if (m_raw_trace_flush && m_format != Format::Binary) {
+            Log(1).stream() << "Recorder: Raw trace flush is only supported for binary format" << std::endl;
+            m_raw_trace_flush = false;
+        }
+
+        m_direct_io  = m_config.get("direct_io").to_bool();
+        m_drop_cache = m_config.get("drop_page_cache").to_bool();
+
+        if ((m_direct_io || m_drop_cache) && m_stream != Stream::File) {
+            Log(1).stream() << "Recorder: Direct I/O requires file output" << std::endl;
+            m_direct_io  = false;
+            m_drop_cache = false;
+        }
+    }
+
+    void init_format_writer(std::ostream& os) {
+        std::ostream* osp = &os;
+
+#ifdef CALIPER_HAVE_ZLIB
+        if (m_compress) {
+            m_compress_stream = CompressStream(os, m_compress_level);
+            osp = &m_compress_stream.stream();
+        }
+#endif
+
+        if (m_format == Format::Binary) {
+            m_bin_writer = BinaryWriter(*osp);
+
+            // keep block writes on I/O block boundaries in direct-I/O
+            // mode; pointless on a compressed stream
+            if (m_direct_io && !m_compress)
+                m_bin_writer.set_block_alignment(AlignedFileStream::alignment);
+        } else {
+            m_writer = CsvWriter(*osp, m_write_index);
+
+            if (m_sync_markers)
+                m_writer.set_sync_markers(true);
+        }
     }
 
     void init_writer() {
@@ -150,6 +266,24 @@ class Recorder
                         dirname += '/';
                 }
 
+                if (m_direct_io || m_drop_cache) {
+                    m_afstream =
+                        AlignedFileStream(dirname + filename,
+                                          (m_direct_io  ? AlignedFileStream::DirectIO  : 0) |
+                                          (m_drop_cache ? AlignedFileStream::DropCache : 0));
+
+                    if (!m_afstream.is_open()) {
+                        Log(0).stream() << "Recorder: Error: Could not open recording file "
+                                        << filename << std::endl;
+                        m_stream = Stream::None;
+                    } else {
+                        m_stream = Stream::File;
+                        init_format_writer(m_afstream.stream());
+                    }
+
+                    break;
+                }
+
                 m_ofstream.open(dirname + filename);
 
                 if (!m_ofstream) {
@@ -158,15 +292,15 @@ class Recorder
                     m_stream = Stream::None;
                 } else {
                     m_stream = Stream::File;
-                    m_writer = CsvWriter(m_ofstream);
+                    init_format_writer(m_ofstream);
                 }
             }
-            break;        
+            break;
         case Stream::StdOut:
-            m_writer = CsvWriter(std::cout);
+            init_format_writer(std::cout);
             break;
         case Stream::StdErr:
-            m_writer = CsvWriter(std::cerr);
+            init_format_writer(std::cerr);
             break;
         case Stream::None:
             break;
@@ -221,8 +355,29 @@ class Recorder
         for (size_t i = 0; i < nn; ++i)
             node_ids[i] = data.node_entries[i]->id();
 
-        m_writer.write_snapshot(*c, nn, node_ids,
-                                sizes.n_immediate, data.immediate_attr, data.immediate_data);
+        if (m_format == Format::Binary)
+            m_bin_writer.write_snapshot(*c, nn, node_ids,
+                                        sizes.n_immediate, data.immediate_attr, data.immediate_data);
+        else
+            m_writer.write_snapshot(*c, nn, node_ids,
+                                    sizes.n_immediate, data.immediate_attr, data.immediate_data);
+    }
+
+    void write_blob(Caliper* c, int type, size_t n_rec, const unsigned char* data, size_t len) {
+        {
+            std::lock_guard<std::mutex>
+                g(m_init_mutex);
+
+            if (!m_writer_initialized)
+                init_writer();
+            if (m_stream == Stream::None)
+                return;
+        }
+
+        if (type == binary::spec_trace_block)
+            m_bin_writer.write_trace_block(*c, n_rec, data, len);
+        else
+            Log(1).stream() << "Recorder: Skipping unknown blob block type " << type << std::endl;
     }
 
     static void flush_snapshot_cb(Caliper* c, const SnapshotRecord* flush_info, const SnapshotRecord* snapshot) {
@@ -232,6 +387,13 @@ class Recorder
         s_instance->flush_snapshot(c, flush_info, snapshot);
     }
 
+    static void write_blob_cb(Caliper* c, int type, size_t n_rec, const unsigned char* data, size_t len) {
+        if (!s_instance)
+            return;
+
+        s_instance->write_blob(c, type, n_rec, data, len);
+    }
+
     static void pre_flush_cb(Caliper* c, const SnapshotRecord* flush_info) {
         if (!s_instance)
             return;
@@ -240,13 +402,40 @@ class Recorder
     }
 
     static void finish_cb(Caliper* c) {
-        if (s_instance && s_instance->m_writer_initialized)
-            Log(1).stream() << "Recorder: Wrote " << s_instance->m_writer.num_written() << " records." << endl;
+        if (s_instance && s_instance->m_writer_initialized) {
+            size_t num_written = 0;
+
+            if (s_instance->m_format == Format::Binary) {
+                s_instance->m_bin_writer.flush();
+                num_written = s_instance->m_bin_writer.num_written();
+            } else {
+                s_instance->m_writer.flush();
+
+                if (s_instance->m_write_index)
+                    s_instance->m_writer.write_index();
+
+                num_written = s_instance->m_writer.num_written();
+            }
+
+#ifdef CALIPER_HAVE_ZLIB
+            if (s_instance->m_compress)
+                s_instance->m_compress_stream.flush();
+#endif
+
+            if (s_instance->m_afstream.is_open())
+                s_instance->m_afstream.close();
+
+            Log(1).stream() << "Recorder: Wrote " << num_written << " records." << endl;
+        }
     }
     
     void register_callbacks(Caliper* c) {
         c->events().pre_write_evt.connect(pre_flush_cb);
         c->events().write_snapshot.connect(flush_snapshot_cb);
+
+        if (m_raw_trace_flush)
+            c->events().write_blob_evt.connect(write_blob_cb);
+
         c->events().finish_evt.connect(finish_cb);
     }
 
@@ -288,6 +477,58 @@ const ConfigSet::Entry Recorder::s_configdata[] = {
       "Name of Caliper output directory (default: current working directory)",
       "Name of Caliper output directory (default: current working directory)"
     },
+    { "format", CALI_TYPE_STRING, "csv",
+      "Output format (\"csv\" or \"binary\")",
+      "Output format. Either\n"
+      "   csv:    Text-based record stream,\n"
+      "   binary: Binary block format.\n"
+    },
+    { "compress", CALI_TYPE_STRING, "none",
+      "Output compression codec (\"none\" or \"deflate\")",
+      "Output compression codec. Either\n"
+      "   none:    No compression,\n"
+      "   deflate: Block-based deflate compression (requires zlib).\n"
+    },
+    { "compress_level", CALI_TYPE_UINT, "6",
+      "Compression level (1-9)",
+      "Compression level (1-9)"
+    },
+    { "raw_trace_flush", CALI_TYPE_BOOL, "false",
+      "Write trace buffer contents verbatim (binary format only)",
+      "Write trace buffer contents verbatim instead of re-encoding\n"
+      "each snapshot at flush. Avoids the decode/re-encode pass for\n"
+      "large traces. Only supported for binary format. Snapshots\n"
+      "written this way bypass other flush-time output services.\n"
+    },
+    { "direct_io", CALI_TYPE_BOOL, "false",
+      "Write the output file with direct I/O (O_DIRECT)",
+      "Write the output file with direct I/O (O_DIRECT), bypassing\n"
+      "the OS page cache. Writes are staged in an aligned buffer,\n"
+      "and binary record blocks are aligned to the I/O block size.\n"
+      "Keeps large trace flushes from displacing the application's\n"
+      "working set. Falls back to buffered writes if the file\n"
+      "system does not support O_DIRECT. File output only.\n"
+    },
+    { "drop_page_cache", CALI_TYPE_BOOL, "false",
+      "Drop written file ranges from the OS page cache",
+      "Drop written file ranges from the OS page cache\n"
+      "(posix_fadvise DONTNEED) as they are written out. A\n"
+      "buffered-I/O alternative to direct_io. File output only.\n"
+    },
+    { "sync_markers", CALI_TYPE_BOOL, "false",
+      "Append periodic sync markers for crash-tolerant output (csv format only)",
+      "Append a sync marker record with the length and checksum of\n"
+      "the preceding record block after roughly every chunk of\n"
+      "output, and flush the stream at each marker. Readers recover\n"
+      "all complete blocks from a file truncated by a crashed job.\n"
+      "Only supported for csv format.\n"
+    },
+    { "write_index", CALI_TYPE_BOOL, "false",
+      "Append a footer index for selective reads (csv format only)",
+      "Append a footer index to the output file. The index allows\n"
+      "readers to skip record blocks that cannot match a query\n"
+      "predicate. Only supported for uncompressed csv format.\n"
+    },
     ConfigSet::Terminator
 };
 
@@ -52,6 +52,10 @@
 #include <fstream>
 #include <sstream>
 
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
 using namespace cali;
 
 namespace
@@ -63,6 +67,8 @@ namespace
 
         ConfigSet      m_config;
 
+        bool           m_offload;
+
         TableFormatter m_table_writer;
         RecordSelector m_selector;
 
@@ -90,7 +96,7 @@ namespace
                        });
         }
 
-        void flush(Caliper* c, const SnapshotRecord* flush_info) {
+        void write_report(Caliper* c, const SnapshotRecord* flush_info) {
             std::string filename = m_config.get("filename").to_string();
 
             if (filename == "stdout")
@@ -114,11 +120,44 @@ namespace
             }
         }
 
-        Report() 
+        void flush(Caliper* c, const SnapshotRecord* flush_info) {
+            if (m_offload) {
+                // Hand report generation (sort, formatting, output) to
+                // a forked helper: the helper works on its
+                // copy-on-write copy of the collected table data while
+                // the application continues shutting down. Double-fork
+                // so the helper is reparented to init and the
+                // application neither waits for it nor leaves a
+                // zombie.
+
+                pid_t pid = fork();
+
+                if (pid == 0) {
+                    if (fork() == 0) {
+                        write_report(c, flush_info);
+                        std::cout.flush();
+                        std::cerr.flush();
+                    }
+
+                    _exit(0);
+                } else if (pid > 0) {
+                    waitpid(pid, nullptr, 0);
+                    return;
+                }
+
+                Log(1).stream() << "Report: cannot fork helper process, generating report inline"
+                                << std::endl;
+            }
+
+            write_report(c, flush_info);
+        }
+
+        Report()
             : m_config( RuntimeConfig::init("report", s_configdata) ),
+              m_offload( m_config.get("offload").to_bool() ),
               m_table_writer(m_config.get("attributes").to_string(),
                              m_config.get("sort_by").to_string()),
-              m_selector(m_config.get("filter").to_string())  
+              m_selector(m_config.get("filter").to_string())
             { }
 
         //
@@ -177,6 +216,15 @@ namespace
           "List of attributes to sort by.",
           "List of attributes to sort by. Default: empty (undefined order)"
         },
+        { "offload", CALI_TYPE_BOOL, "false",
+          "Generate the report in a forked helper process.",
+          "Generate the report in a forked helper process. The helper\n"
+          "formats and writes the report from a copy-on-write copy of\n"
+          "the collected data while the application continues, so\n"
+          "end-of-run report generation does not extend the\n"
+          "application's wallclock time. The helper only writes the\n"
+          "report; snapshot selection still runs inline during flush."
+        },
         ConfigSet::Terminator
     };
 
@@ -41,8 +41,14 @@
 #include "caliper/common/Log.h"
 #include "caliper/common/RuntimeConfig.h"
 
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <signal.h>
 #include <time.h>
 #include <sys/time.h>
@@ -50,6 +56,9 @@
 
 #include <unistd.h>
 
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <ucontext.h>
@@ -61,16 +70,19 @@ namespace
 {
     Attribute timer_attr   { Attribute::invalid };
     Attribute sampler_attr { Attribute::invalid };
+    Attribute tid_attr     { Attribute::invalid };
 
     cali_id_t sampler_attr_id    = CALI_INV_ID;
-    
+    cali_id_t tid_attr_id        = CALI_INV_ID;
+
     ConfigSet config;
 
+    int       sample_frequency    = 10;
     int       nsec_interval       = 0;
     int       sample_contexts     = 0;
 
-    int       n_samples           = 0;
-    int       n_processed_samples = 0;
+    std::atomic<int> n_samples           { 0 };
+    std::atomic<int> n_processed_samples { 0 };
 
     static const ConfigSet::Entry s_configdata[] = {
         { "frequency", CALI_TYPE_INT, "10",
@@ -81,18 +93,385 @@ namespace
           "Capture process-wide context information",
           "Capture process-wide context information in addition to thread-local context"
         },
+        { "buffered", CALI_TYPE_BOOL, "false",
+          "Buffer samples and process them on a drainer thread",
+          "Buffer samples and process them on a drainer thread.\n"
+          "The signal handler only captures the sample into a per-thread\n"
+          "ring buffer; the expensive snapshot processing runs in batches\n"
+          "outside the handler. Samples taken while the thread holds\n"
+          "Caliper state are staged without blackboard context instead\n"
+          "of being dropped. Recommended for high sampling frequencies."
+        },
+        { "buffer_size", CALI_TYPE_UINT, "64",
+          "Number of sample slots in each per-thread buffer",
+          "Number of sample slots in each per-thread buffer.\n"
+          "Samples taken while the buffer is full are dropped."
+        },
+        { "backend", CALI_TYPE_STRING, "signal",
+          "Sampling backend (\"signal\" or \"perf\")",
+          "Sampling backend. Either\n"
+          "   signal: POSIX timer with SIGPROF delivery,\n"
+          "   perf:   perf_event mmap ring buffers drained by a service\n"
+          "           thread. No signal handler runs in the application;\n"
+          "           samples carry the pc and thread id, but no\n"
+          "           thread-local blackboard context.\n"
+        },
+        { "perf_ring_pages", CALI_TYPE_UINT, "8",
+          "Number of data pages in each per-thread perf ring buffer",
+          "Number of data pages in each per-thread perf ring buffer.\n"
+          "Must be a power of two. Samples taken while a ring is full\n"
+          "are counted as dropped."
+        },
         ConfigSet::Terminator
     };
 
+    //
+    // --- Buffered sampling
+    //
+    // In buffered mode the signal handler only pulls the sample into a
+    // slot of the thread's ring buffer: a blackboard copy and a few
+    // stores. A drainer thread runs the snapshot processing chain over
+    // the buffered samples in batches, outside the signal handler and
+    // off the application's critical path.
+    //
+
+    class SampleBuffer {
+        static const std::size_t MAX_ENTRIES = 80;
+
+        struct Slot {
+            SnapshotRecord::FixedSnapshotRecord<MAX_ENTRIES> data;
+            SnapshotRecord::Sizes                            sizes;
+        };
+
+        std::vector<Slot>        m_slots;
+        std::size_t              m_mask;
+
+        // single producer (the owning thread's signal handler),
+        // single consumer (the drainer)
+        std::atomic<std::size_t> m_head;
+        std::atomic<std::size_t> m_tail;
+
+    public:
+
+        explicit SampleBuffer(std::size_t size)
+            : m_head(0), m_tail(0)
+            {
+                std::size_t p = 2;
+
+                while (p < size)
+                    p *= 2;
+
+                m_slots.resize(p);
+                m_mask = p - 1;
+            }
+
+        /// Pull the current sample into the next free slot.
+        /// Runs in the signal handler. Returns false if the buffer is full.
+        bool push(Caliper& c, int scopes, const SnapshotRecord* trigger_info) {
+            std::size_t head = m_head.load(std::memory_order_relaxed);
+
+            if (head - m_tail.load(std::memory_order_acquire) > m_mask)
+                return false;
+
+            Slot& slot = m_slots[head & m_mask];
+
+            SnapshotRecord rec(slot.data);
+
+            c.pull_snapshot(scopes, trigger_info, &rec);
+
+            slot.sizes = rec.size();
+
+            m_head.store(head + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        /// Stage the trigger info alone, without blackboard context.
+        /// Needs no Caliper instance, so it is safe even while the
+        /// thread holds Caliper state. Returns false if the buffer is full.
+        bool push_raw(const SnapshotRecord* trigger_info) {
+            std::size_t head = m_head.load(std::memory_order_relaxed);
+
+            if (head - m_tail.load(std::memory_order_acquire) > m_mask)
+                return false;
+
+            Slot& slot = m_slots[head & m_mask];
+
+            SnapshotRecord rec(slot.data);
+
+            if (trigger_info)
+                rec.append(*trigger_info);
+
+            slot.sizes = rec.size();
+
+            m_head.store(head + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        /// Process all buffered samples. Runs on the drainer thread.
+        unsigned drain(Caliper& c) {
+            unsigned    n    = 0;
+            std::size_t tail = m_tail.load(std::memory_order_relaxed);
+            std::size_t head = m_head.load(std::memory_order_acquire);
+
+            for ( ; tail != head; ++tail, ++n) {
+                Slot& slot = m_slots[tail & m_mask];
+
+                SnapshotRecord::FixedSnapshotRecord<MAX_ENTRIES> pdata;
+                SnapshotRecord rec(pdata);
+
+                rec.append(slot.sizes.n_nodes,     slot.data.node_array,
+                           slot.sizes.n_immediate, slot.data.attr_array, slot.data.data_array);
+
+                c.events().pre_process_snapshot_evt(&c, nullptr, &rec);
+                c.events().process_snapshot(&c, nullptr, &rec);
+                c.events().post_process_snapshot_evt(&c, nullptr, &rec);
+
+                m_tail.store(tail + 1, std::memory_order_release);
+            }
+
+            return n;
+        }
+    };
+
+    bool      use_buffered       = false;
+    size_t    buffer_size        = 64;
+
+    std::mutex                                 buffer_list_lock;
+    std::vector<std::unique_ptr<SampleBuffer>> buffer_list;
+
+    thread_local SampleBuffer* s_buffer = nullptr;
+
+    std::thread       drainer_thread;
+    std::atomic<bool> drainer_active { false };
+
+    std::atomic<unsigned> n_dropped_samples;
+    std::atomic<unsigned> n_contextless_samples;
+
+    //
+    // --- perf_event sampling
+    //
+    // In perf mode the kernel writes PERF_SAMPLE_IP|TID records into a
+    // per-thread mmap ring buffer; no signal handler runs in the
+    // application. The drainer thread walks the rings in batches and
+    // pushes a snapshot per sample, carrying the pc and thread id.
+    // Since the drain is asynchronous to the sampled thread, only
+    // process-scope blackboard context is attached.
+    //
+
+    struct PerfChannel {
+        int            fd;
+        unsigned char* base;      // mmap base: metadata page + data pages
+        unsigned char* data;      // start of the data ring
+        size_t         data_size; // bytes in the data ring (power of two)
+        size_t         map_len;
+    };
+
+    bool      use_perf           = false;
+    size_t    perf_ring_pages    = 8;
+
+    std::mutex               perf_channel_lock;
+    std::vector<PerfChannel> perf_channels;
+
+    bool create_perf_channel() {
+        struct perf_event_attr pe;
+
+        memset(&pe, 0, sizeof(pe));
+
+        // software clock samples work without hardware counter access
+        pe.type           = PERF_TYPE_SOFTWARE;
+        pe.size           = sizeof(pe);
+        pe.config         = PERF_COUNT_SW_CPU_CLOCK;
+        pe.freq           = 1;
+        pe.sample_freq    = static_cast<uint64_t>(sample_frequency);
+        pe.sample_type    = PERF_SAMPLE_IP | PERF_SAMPLE_TID;
+        pe.exclude_kernel = 1;
+        pe.exclude_hv     = 1;
+
+        // attach to the calling thread so each thread gets its own ring
+
+        int fd = static_cast<int>(syscall(__NR_perf_event_open, &pe, 0, -1, -1, 0));
+
+        if (fd < 0) {
+            Log(0).stream() << "sampler: perf_event_open() failed: "
+                            << strerror(errno) << std::endl;
+            return false;
+        }
+
+        size_t pagesize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t map_len  = (1 + perf_ring_pages) * pagesize;
+
+        void* base = mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (base == MAP_FAILED) {
+            Log(0).stream() << "sampler: cannot map perf ring buffer: "
+                            << strerror(errno) << std::endl;
+            close(fd);
+            return false;
+        }
+
+        PerfChannel ch;
+
+        ch.fd        = fd;
+        ch.base      = static_cast<unsigned char*>(base);
+        ch.data      = ch.base + pagesize;
+        ch.data_size = perf_ring_pages * pagesize;
+        ch.map_len   = map_len;
+
+        std::lock_guard<std::mutex> g(perf_channel_lock);
+
+        perf_channels.push_back(ch);
+
+        return true;
+    }
+
+    // copy len bytes starting at ring position from, handling wrap-around
+    void copy_from_ring(const PerfChannel& ch, uint64_t from, void* dst, size_t len) {
+        size_t off = from & (ch.data_size - 1);
+        size_t n   = std::min(len, ch.data_size - off);
+
+        memcpy(dst, ch.data + off, n);
+
+        if (n < len)
+            memcpy(static_cast<char*>(dst) + n, ch.data, len - n);
+    }
+
+    unsigned drain_perf_channel(Caliper& c, PerfChannel& ch) {
+        struct perf_event_mmap_page* mp =
+            reinterpret_cast<struct perf_event_mmap_page*>(ch.base);
+
+        uint64_t head = mp->data_head;
+        uint64_t tail = mp->data_tail;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        unsigned n = 0;
+
+        while (tail != head) {
+            struct perf_event_header hdr;
+
+            copy_from_ring(ch, tail, &hdr, sizeof(hdr));
+
+            if (hdr.size < sizeof(hdr))
+                break;
+
+            if (hdr.type == PERF_RECORD_SAMPLE) {
+                struct {
+                    uint64_t ip;
+                    uint32_t pid;
+                    uint32_t tid;
+                } sample;
+
+                copy_from_ring(ch, tail + sizeof(hdr), &sample, sizeof(sample));
+
+                ++n_samples;
+
+                cali_id_t attr[2] = { sampler_attr_id, tid_attr_id };
+                Variant   vals[2] = {
+                    Variant(CALI_TYPE_ADDR, &sample.ip, sizeof(uint64_t)),
+                    Variant(static_cast<uint64_t>(sample.tid))
+                };
+
+                SnapshotRecord trigger_info(2, attr, vals);
+
+                c.push_snapshot(CALI_SCOPE_PROCESS, &trigger_info);
+
+                ++n;
+            } else if (hdr.type == PERF_RECORD_LOST) {
+                struct {
+                    uint64_t id;
+                    uint64_t lost;
+                } lost;
+
+                copy_from_ring(ch, tail + sizeof(hdr), &lost, sizeof(lost));
+
+                n_dropped_samples += static_cast<unsigned>(lost.lost);
+            }
+
+            tail += hdr.size;
+        }
+
+        std::atomic_thread_fence(std::memory_order_release);
+
+        mp->data_tail = tail;
+
+        return n;
+    }
+
+    unsigned drain_all_perf_channels(Caliper& c) {
+        std::lock_guard<std::mutex> g(perf_channel_lock);
+
+        unsigned n = 0;
+
+        for (PerfChannel& ch : perf_channels)
+            n += drain_perf_channel(c, ch);
+
+        return n;
+    }
+
+    void disable_perf_channels() {
+        std::lock_guard<std::mutex> g(perf_channel_lock);
+
+        for (PerfChannel& ch : perf_channels)
+            ioctl(ch.fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    void close_perf_channels() {
+        std::lock_guard<std::mutex> g(perf_channel_lock);
+
+        for (PerfChannel& ch : perf_channels) {
+            ioctl(ch.fd, PERF_EVENT_IOC_DISABLE, 0);
+            munmap(ch.base, ch.map_len);
+            close(ch.fd);
+        }
+
+        perf_channels.clear();
+    }
+
+
+    void create_thread_buffer() {
+        std::lock_guard<std::mutex> g(buffer_list_lock);
+
+        buffer_list.emplace_back(new SampleBuffer(buffer_size));
+        s_buffer = buffer_list.back().get();
+    }
+
+    unsigned drain_all_buffers(Caliper& c) {
+        std::lock_guard<std::mutex> g(buffer_list_lock);
+
+        unsigned n = 0;
+
+        for (auto& buf : buffer_list)
+            n += buf->drain(c);
+
+        return n;
+    }
+
+    void drainer_fn() {
+        Caliper c = Caliper::instance();
+
+        while (drainer_active.load()) {
+            n_processed_samples += use_perf ? drain_all_perf_channels(c) : drain_all_buffers(c);
+
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+    }
+
+    void stop_drainer(Caliper* c) {
+        if (!drainer_active.exchange(false))
+            return;
+
+        drainer_thread.join();
+
+        // process any samples taken since the drainer's last pass
+        n_processed_samples += use_perf ? drain_all_perf_channels(*c) : drain_all_buffers(*c);
+    }
+
     void on_prof(int sig, siginfo_t *info, void *context)
     {
         ++n_samples;
-        
-        Caliper c = Caliper::sigsafe_instance();
 
-        if (!c)
-            return;
-        
         ucontext_t *ucontext = (ucontext_t *) context;
 
         uint64_t  pc = static_cast<uint64_t>(ucontext->uc_mcontext.gregs[REG_RIP]);
@@ -100,6 +479,29 @@ namespace
 
         SnapshotRecord trigger_info(1, &sampler_attr_id, &v_pc);
 
+        Caliper c = Caliper::sigsafe_instance();
+
+        if (use_buffered && s_buffer) {
+            // The staging buffer is preallocated and lock-free, so the
+            // sample can be taken even while the thread holds Caliper
+            // state; it is then staged without blackboard context
+            // rather than dropped, keeping its pc attribution.
+            bool ok = c ? s_buffer->push(c, sample_contexts, &trigger_info)
+                        : s_buffer->push_raw(&trigger_info);
+
+            if (!ok)
+                ++n_dropped_samples;
+            else if (!c)
+                ++n_contextless_samples;
+
+            return;
+        }
+
+        if (!c) {
+            ++n_dropped_samples;
+            return;
+        }
+
         c.push_snapshot(sample_contexts, &trigger_info);
 
         ++n_processed_samples;
@@ -187,22 +589,51 @@ namespace
     }
     
     void create_scope_cb(Caliper* c, cali_context_scope_t scope) {
-        if (scope == CALI_SCOPE_THREAD)
+        if (scope == CALI_SCOPE_THREAD) {
+            if (use_perf) {
+                create_perf_channel();
+                return;
+            }
+
+            if (use_buffered)
+                create_thread_buffer();
+
             setup_settimer(c);
+        }
     }
 
     void release_scope_cb(Caliper* c, cali_context_scope_t scope) {
-        if (scope == CALI_SCOPE_THREAD)
+        if (scope == CALI_SCOPE_THREAD && !use_perf)
             clear_timer(c);
     }
 
+    // Stop sampling and process remaining buffered samples before the
+    // flush so that flush callbacks see all samples.
+    void pre_flush_cb(Caliper* c, const SnapshotRecord*) {
+        if (use_perf)
+            disable_perf_channels();
+        else {
+            clear_timer(c);
+            clear_signal();
+        }
+
+        stop_drainer(c);
+    }
+
     void finish_cb(Caliper* c) {
-        clear_timer(c);
-        clear_signal();
+        if (!use_perf) {
+            clear_timer(c);
+            clear_signal();
+        }
+
+        stop_drainer(c);
+        close_perf_channels();
 
         Log(1).stream() << "Sampler: processed " << n_processed_samples << " samples ("
                         << n_samples << " total, "
-                        << n_samples - n_processed_samples << " dropped)." << endl;
+                        << n_contextless_samples.load() << " without thread context, "
+                        << n_samples - n_processed_samples - n_dropped_samples.load() << " unprocessed, "
+                        << n_dropped_samples.load() << " dropped)." << endl;
     }
     
     void sampler_register(Caliper* c)
@@ -228,26 +659,76 @@ namespace
 
         sampler_attr_id = sampler_attr.id();
 
+        std::string backend = config.get("backend").to_string();
+
+        use_perf = (backend == "perf");
+
+        if (!use_perf && backend != "signal") {
+            Log(0).stream() << "sampler: Unknown backend \"" << backend
+                            << "\", using signal" << std::endl;
+        }
+
         int frequency = config.get("frequency").to_int();
-        
-        // some sanity checking
-        frequency     = std::min(std::max(frequency, 1), 10000);
+
+        // some sanity checking; the perf backend handles kHz+ rates
+        frequency     = std::min(std::max(frequency, 1), use_perf ? 100000 : 10000);
         nsec_interval = 1000000000 / frequency;
 
+        sample_frequency = frequency;
+
         sample_contexts = CALI_SCOPE_THREAD;
 
         if (config.get("add_shared_context").to_bool() == true)
             sample_contexts |= CALI_SCOPE_PROCESS;
-        
+
+        use_buffered = config.get("buffered").to_bool();
+        buffer_size  = std::max<size_t>(config.get("buffer_size").to_uint(), 2);
+
+        if (use_perf) {
+            tid_attr =
+                c->create_attribute("cali.sampler.tid", CALI_TYPE_UINT,
+                                    CALI_ATTR_SCOPE_THREAD |
+                                    CALI_ATTR_SKIP_EVENTS  |
+                                    CALI_ATTR_ASVALUE);
+
+            tid_attr_id = tid_attr.id();
+
+            size_t pages = std::max<size_t>(config.get("perf_ring_pages").to_uint(), 1);
+
+            // round up to a power of two as required by perf
+            for (perf_ring_pages = 1; perf_ring_pages < pages; )
+                perf_ring_pages *= 2;
+
+            if (!create_perf_channel()) {
+                Log(0).stream() << "sampler: perf backend unavailable, using signal backend"
+                                << std::endl;
+                use_perf = false;
+            }
+        }
+
         c->events().create_scope_evt.connect(create_scope_cb);
         c->events().release_scope_evt.connect(release_scope_cb);
         c->events().finish_evt.connect(finish_cb);
 
-        setup_signal();
-        setup_settimer(c);
-        
+        if (use_buffered || use_perf) {
+            // Sampling ends at the first flush
+            c->events().pre_flush_evt.connect(pre_flush_cb);
+
+            if (!use_perf)
+                create_thread_buffer();
+
+            drainer_active.store(true);
+            drainer_thread = std::thread(drainer_fn);
+        }
+
+        if (!use_perf) {
+            setup_signal();
+            setup_settimer(c);
+        }
+
         Log(1).stream() << "Registered sampler service. Using "
-                        << frequency << "Hz sampling frequency." << endl;
+                        << frequency << "Hz sampling frequency"
+                        << (use_perf ? ", perf backend." : (use_buffered ? ", buffered mode." : ".")) << endl;
     }
 
 } // namespace
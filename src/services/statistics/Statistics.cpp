@@ -1,4 +1,4 @@
-// Copyright (c) 2015, Lawrence Livermore National Security, LLC.  
+// Copyright (c) 2015, Lawrence Livermore National Security, LLC.
 // Produced at the Lawrence Livermore National Laboratory.
 //
 // This file is part of Caliper.
@@ -35,11 +35,20 @@
 
 #include "../CaliperService.h"
 
+#include "StatisticsCounters.h"
+
 #include "caliper/Caliper.h"
+#include "caliper/SnapshotRecord.h"
 
 #include "caliper/common/Log.h"
+#include "caliper/common/MemoryBudget.h"
+
+#include "caliper/common/util/spinlock.hpp"
 
 #include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
 
 using namespace cali;
 using namespace std;
@@ -47,61 +56,293 @@ using namespace std;
 namespace
 {
 
-atomic<unsigned> num_attributes;
-atomic<unsigned> num_snapshots;
-atomic<unsigned> num_updates;
-atomic<unsigned> num_scopes;
+//
+// --- Wait-free counter slabs
+//
+// Each thread increments counters in its own cacheline-aligned slab,
+// so a counter update is one uncontended increment with no shared
+// cacheline traffic. Slabs are linked into a global list when a
+// thread first counts and are only read and summed at finish; slabs
+// of exited threads stay in the list so their counts are preserved.
+//
+
+const int MAX_COUNTERS = 64;
+
+struct alignas(64) CounterSlab {
+    uint64_t     val[MAX_COUNTERS];
+
+    // per-thread blackboard nesting depth and its high-water mark
+    uint64_t     depth;
+    uint64_t     max_depth;
+
+    CounterSlab* next;
+};
+
+std::atomic<int> num_counters;
+std::string      counter_names[MAX_COUNTERS];
+
+CounterSlab*     slab_list = nullptr;
+util::spinlock   slab_lock;
+
+thread_local CounterSlab* t_slab = nullptr;
+
+CounterSlab* acquire_slab()
+{
+    // operator new does not honor extended alignment in C++11, so get
+    // the cacheline-aligned memory from posix_memalign and construct
+    // the slab in place. Slabs are never freed: exited threads' counts
+    // stay in the list until finish.
+    void* mem = nullptr;
+
+    if (posix_memalign(&mem, alignof(CounterSlab), sizeof(CounterSlab)) != 0)
+        throw std::bad_alloc();
+
+    CounterSlab* s = new (mem) CounterSlab();
+
+    {
+        std::lock_guard<util::spinlock>
+            g(slab_lock);
+
+        s->next   = slab_list;
+        slab_list = s;
+    }
+
+    t_slab = s;
+
+    return s;
+}
+
+inline CounterSlab* slab()
+{
+    CounterSlab* s = t_slab;
+    return s ? s : acquire_slab();
+}
+
+// --- built-in counters
+
+int c_attributes = -1;
+int c_updates    = -1;
+int c_scopes     = -1;
+int c_snapshots  = -1;
+
+// --- snapshots by trigger attribute
+//
+// Fixed slot table mapping trigger attribute ids to counters. Slots
+// are claimed once with a CAS; the per-snapshot path is a linear
+// scan over at most MAX_TRIGGERS ids.
+
+const int MAX_TRIGGERS = 16;
+
+std::atomic<cali_id_t> trigger_attr_id[MAX_TRIGGERS];
+int                    trigger_counter[MAX_TRIGGERS];
+
+Attribute begin_evt_attr { Attribute::invalid };
+Attribute set_evt_attr   { Attribute::invalid };
+Attribute end_evt_attr   { Attribute::invalid };
+
+void count_trigger(Caliper* c, cali_id_t attr_id)
+{
+    for (int i = 0; i < MAX_TRIGGERS; ++i) {
+        cali_id_t id = trigger_attr_id[i].load(std::memory_order_relaxed);
+
+        if (id == attr_id) {
+            statistics::inc(trigger_counter[i]);
+            return;
+        }
+
+        if (id == CALI_INV_ID) {
+            // registration looks up the attribute name: don't claim
+            // new slots in signal context, just lose the count
+            if (c->is_signal())
+                return;
+
+            cali_id_t inv = CALI_INV_ID;
+
+            if (trigger_attr_id[i].compare_exchange_strong(inv, attr_id)) {
+                trigger_counter[i] =
+                    statistics::register_counter("snapshots#" + c->get_attribute(attr_id).name());
+
+                statistics::inc(trigger_counter[i]);
+                return;
+            }
+
+            // another thread claimed the slot: re-check it
+            --i;
+        }
+    }
+}
 
 void create_attr_cb(Caliper*, const Attribute&)
 {
-    ++num_attributes;
+    statistics::inc(c_attributes);
+}
+
+void begin_cb(Caliper*, const Attribute&, const Variant&)
+{
+    statistics::inc(c_updates);
+
+    CounterSlab* s = slab();
+
+    if (++s->depth > s->max_depth)
+        s->max_depth = s->depth;
 }
 
-void update_cb(Caliper*, const Attribute&,const Variant&)
+void end_cb(Caliper*, const Attribute&, const Variant&)
 {
-    ++num_updates;
+    statistics::inc(c_updates);
+
+    CounterSlab* s = slab();
+
+    if (s->depth > 0)
+        --s->depth;
+}
+
+void set_cb(Caliper*, const Attribute&, const Variant&)
+{
+    statistics::inc(c_updates);
+}
+
+void create_scope_cb(Caliper*, cali_context_scope_t scope)
+{
+    statistics::inc(c_scopes);
+
+    // pre-create the thread's counter slab so the hot path never
+    // allocates, not even on a thread's first count
+    if (scope == CALI_SCOPE_THREAD)
+        slab();
 }
 
-void create_scope_cb(Caliper*, cali_context_scope_t)
+void snapshot_cb(Caliper* c, int, const SnapshotRecord* trigger_info, SnapshotRecord*)
 {
-    ++num_scopes;
+    statistics::inc(c_snapshots);
+
+    if (trigger_info) {
+        Entry event = trigger_info->get(begin_evt_attr);
+
+        if (event.is_empty())
+            event = trigger_info->get(set_evt_attr);
+        if (event.is_empty())
+            event = trigger_info->get(end_evt_attr);
+        if (event.is_empty())
+            return;
+
+        cali_id_t attr_id = event.value().to_id();
+
+        if (attr_id != CALI_INV_ID)
+            count_trigger(c, attr_id);
+    }
 }
 
-void snapshot_cb(Caliper*, int, const SnapshotRecord*, SnapshotRecord*)
+void post_init_cb(Caliper* c)
 {
-    ++num_snapshots;
+    begin_evt_attr = c->get_attribute("cali.event.begin");
+    set_evt_attr   = c->get_attribute("cali.event.set");
+    end_evt_attr   = c->get_attribute("cali.event.end");
 }
 
 void finish_cb(Caliper* c)
 {
+    int      n = std::min(num_counters.load(), MAX_COUNTERS);
+
+    uint64_t sum[MAX_COUNTERS] = { 0 };
+    uint64_t max_depth         = 0;
+
+    {
+        std::lock_guard<util::spinlock>
+            g(slab_lock);
+
+        for (CounterSlab* s = slab_list; s; s = s->next) {
+            for (int i = 0; i < n; ++i)
+                sum[i] += s->val[i];
+
+            max_depth = std::max(max_depth, s->max_depth);
+        }
+    }
+
     Log(1).stream() << "Statistics:"
-                    << "\n     Number of additional scopes  : " << num_scopes.load() 
-                    << "\n     Number of user attributes:     " << num_attributes.load()
-                    << "\n     Number of context updates:     " << num_updates.load()
-                    << "\n     Number of context snapshots:   " << num_snapshots.load() << endl;
+                    << "\n     Number of additional scopes  : " << sum[c_scopes]
+                    << "\n     Number of user attributes:     " << sum[c_attributes]
+                    << "\n     Number of context updates:     " << sum[c_updates]
+                    << "\n     Number of context snapshots:   " << sum[c_snapshots]
+                    << "\n     Blackboard depth high-water:   " << max_depth
+                    << "\n     Runtime memory usage (bytes):  " << MemoryBudget::total_usage()
+                    << endl;
+
+    // report the dynamically registered counters (trigger attributes
+    // and counters other services registered)
+
+    for (int i = 0; i < n; ++i) {
+        if (i == c_scopes || i == c_attributes || i == c_updates || i == c_snapshots)
+            continue;
+
+        Log(1).stream() << "     " << counter_names[i] << ": " << sum[i] << endl;
+    }
 }
 
 void statistics_service_register(Caliper* c)
 {
-    num_attributes = 0;
-    num_snapshots  = 0;
-    num_updates    = 0;
-    num_scopes     = 0;
+    slab_lock.unlock();
+
+    num_counters.store(0);
+
+    for (int i = 0; i < MAX_TRIGGERS; ++i) {
+        trigger_attr_id[i].store(CALI_INV_ID);
+        // -1 makes racing readers of a just-claimed slot drop the
+        // count instead of bumping an unregistered counter
+        trigger_counter[i] = -1;
+    }
+
+    c_attributes = statistics::register_counter("attributes");
+    c_updates    = statistics::register_counter("updates");
+    c_scopes     = statistics::register_counter("scopes");
+    c_snapshots  = statistics::register_counter("snapshots");
 
     c->events().create_attr_evt.connect(&create_attr_cb);
-    c->events().pre_begin_evt.connect(&update_cb);
-    c->events().pre_end_evt.connect(&update_cb);
-    c->events().pre_set_evt.connect(&update_cb);
+    c->events().pre_begin_evt.connect(&begin_cb);
+    c->events().pre_end_evt.connect(&end_cb);
+    c->events().pre_set_evt.connect(&set_cb);
+    c->events().post_init_evt.connect(&post_init_cb);
     c->events().finish_evt.connect(&finish_cb);
     c->events().create_scope_evt.connect(&create_scope_cb);
     c->events().snapshot.connect(&snapshot_cb);
 
-    Log(1).stream() << "Registered debug service" << endl;
+    Log(1).stream() << "Registered statistics service" << endl;
 }
-    
+
 } // namespace
 
 namespace cali
 {
+
+namespace statistics
+{
+
+int register_counter(const std::string& name)
+{
+    int id = ::num_counters.fetch_add(1);
+
+    if (id >= ::MAX_COUNTERS) {
+        ::num_counters.fetch_sub(1);
+
+        Log(1).stream() << "statistics: no free counter slot for " << name << endl;
+
+        return -1;
+    }
+
+    ::counter_names[id] = name;
+
+    return id;
+}
+
+void inc(int counter, uint64_t add)
+{
+    if (counter < 0)
+        return;
+
+    ::slab()->val[counter] += add;
+}
+
+} // namespace statistics
+
     CaliperService statistics_service = { "statistics", ::statistics_service_register };
 }
@@ -44,17 +44,28 @@
 #include "caliper/common/RuntimeConfig.h"
 
 #include "caliper/common/util/split.hpp"
+#include "caliper/common/util/spinlock.hpp"
 
 #include <Symtab.h>
 #include <LineInformation.h>
 #include <Function.h>
 #include <AddrLookup.h>
 
+#include <sys/stat.h>
+
 #include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <iterator>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 using namespace cali;
 
@@ -88,8 +99,82 @@ class SymbolLookup
     AddressLookup* m_lookup;
     std::mutex     m_lookup_mutex;
 
-    unsigned m_num_lookups;
-    unsigned m_num_failed;
+    //
+    // --- persistent symbol cache
+    //
+    // Resolved symbols are cached on disk keyed by (module, offset),
+    // where the module id is a hash of the module's path, size, and
+    // mtime. Repeat runs against unchanged binaries resolve known
+    // addresses with a hash lookup; only new addresses hit the
+    // resolver. Entries of rebuilt modules get a new module id and are
+    // simply never matched again.
+    //
+
+    struct CacheKey {
+        uint64_t module;
+        uint64_t offset;
+
+        bool operator==(const CacheKey& rhs) const {
+            return module == rhs.module && offset == rhs.offset;
+        }
+    };
+
+    struct CacheKeyHash {
+        std::size_t operator()(const CacheKey& k) const {
+            return k.module ^ (k.offset * 0x9e3779b97f4a7c15ull);
+        }
+    };
+
+    struct CachedSymbol {
+        int         flags;    // which lookups the entry covers
+        std::string file;
+        uint64_t    line;
+        std::string function;
+    };
+
+    enum CacheFlags { CACHE_SOURCELOC = 1, CACHE_FUNCTIONS = 2 };
+
+    std::string m_cache_filename;
+
+    std::unordered_map<CacheKey, CachedSymbol, CacheKeyHash> m_cache;
+    std::vector< std::pair<CacheKey, CachedSymbol> >         m_new_cache_entries;
+    std::mutex  m_cache_mutex;
+
+    // module ids, memoized per symtab object; guarded by m_lookup_mutex
+    std::map<Symtab*, uint64_t> m_module_ids;
+
+    //
+    // --- batch resolution
+    //
+    // Traces typically have many samples over few unique addresses.
+    // During the run we collect the unique addresses seen in snapshot
+    // records; at flush, a thread pool resolves the unique set into an
+    // in-memory memo before the records are rewritten, so record
+    // processing only performs memo lookups. The symtab queries of
+    // different modules run in parallel (each Symtab has its own lock).
+    //
+
+    static const int MAX_ADDRESS_ATTRIBUTES = 16;
+
+    bool     m_batch_resolve;
+    unsigned m_batch_threads;
+
+    cali_id_t        m_addr_attr_ids[MAX_ADDRESS_ATTRIBUTES];
+    std::atomic<int> m_num_addr_attrs;
+    std::mutex       m_attr_watch_mutex;
+
+    std::unordered_set<uint64_t> m_addr_set;
+    util::spinlock               m_addr_set_lock;
+
+    std::unordered_map<uint64_t, CachedSymbol> m_memo;
+    std::mutex                                 m_memo_mutex;
+
+    // per-module locks for parallel symtab queries; map guarded by m_lookup_mutex
+    std::map< Symtab*, std::unique_ptr<std::mutex> > m_symtab_locks;
+
+    std::atomic<unsigned> m_num_lookups;
+    std::atomic<unsigned> m_num_failed;
+    std::atomic<unsigned> m_num_cache_hits;
 
     //
     // --- methods
@@ -139,79 +224,377 @@ class SymbolLookup
             make_symbol_attributes(c, a);
     }
     
-    void add_symbol_attributes(const Entry& e, 
+    static uint64_t hash_string(uint64_t h, const std::string& str) {
+        // FNV-1a
+        for (char c : str)
+            h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+
+        return h;
+    }
+
+    // Module id: hash of the module's path, size, and mtime.
+    // Call with m_lookup_mutex held.
+    uint64_t get_module_id(Symtab* symtab) {
+        auto it = m_module_ids.find(symtab);
+
+        if (it != m_module_ids.end())
+            return it->second;
+
+        std::string path = symtab->file();
+
+        uint64_t    id   = hash_string(0xcbf29ce484222325ull, path);
+
+        struct stat st;
+
+        if (stat(path.c_str(), &st) == 0) {
+            id = hash_string(id, std::to_string(st.st_size));
+            id = hash_string(id, std::to_string(st.st_mtime));
+        }
+
+        m_module_ids.insert(std::make_pair(symtab, id));
+
+        return id;
+    }
+
+    // Call with m_lookup_mutex held.
+    std::mutex* get_symtab_lock(Symtab* symtab) {
+        auto it = m_symtab_locks.find(symtab);
+
+        if (it == m_symtab_locks.end())
+            it = m_symtab_locks.insert(
+                std::make_pair(symtab, std::unique_ptr<std::mutex>(new std::mutex))).first;
+
+        return it->second.get();
+    }
+
+    bool cache_lookup(const CacheKey& key, int flags, CachedSymbol& sym) {
+        std::lock_guard<std::mutex>
+            g(m_cache_mutex);
+
+        auto it = m_cache.find(key);
+
+        if (it == m_cache.end() || (it->second.flags & flags) != flags)
+            return false;
+
+        sym = it->second;
+
+        return true;
+    }
+
+    void cache_insert(const CacheKey& key, const CachedSymbol& sym) {
+        std::lock_guard<std::mutex>
+            g(m_cache_mutex);
+
+        if (m_cache.insert(std::make_pair(key, sym)).second)
+            m_new_cache_entries.push_back(std::make_pair(key, sym));
+    }
+
+    // Cache file format: one tab-separated entry per line,
+    //   <module id> <offset> <flags> <line> <file> <function>
+    // Malformed lines (e.g. from an interrupted run) are skipped.
+
+    void load_cache() {
+        if (m_cache_filename.empty())
+            return;
+
+        std::ifstream is(m_cache_filename.c_str());
+
+        std::string line;
+
+        while (std::getline(is, line)) {
+            std::istringstream iss(line);
+
+            CacheKey     key;
+            CachedSymbol sym;
+
+            if (!(iss >> key.module >> key.offset >> sym.flags >> sym.line))
+                continue;
+
+            if (!(iss.ignore(1) && std::getline(iss, sym.file, '\t')
+                                && std::getline(iss, sym.function)))
+                continue;
+
+            m_cache.insert(std::make_pair(key, sym));
+        }
+
+        if (!m_cache.empty())
+            Log(1).stream() << "Symbollookup: Loaded " << m_cache.size()
+                            << " cached symbols from " << m_cache_filename
+                            << std::endl;
+    }
+
+    void write_cache() {
+        std::lock_guard<std::mutex>
+            g(m_cache_mutex);
+
+        if (m_cache_filename.empty() || m_new_cache_entries.empty())
+            return;
+
+        std::ofstream os(m_cache_filename.c_str(), std::ios::app);
+
+        if (!os) {
+            Log(0).stream() << "Symbollookup: Could not write symbol cache "
+                            << m_cache_filename << std::endl;
+            return;
+        }
+
+        for (const auto &p : m_new_cache_entries)
+            os << p.first.module    << '\t'
+               << p.first.offset    << '\t'
+               << p.second.flags    << '\t'
+               << p.second.line     << '\t'
+               << p.second.file     << '\t'
+               << p.second.function << '\n';
+
+        Log(1).stream() << "Symbollookup: Added " << m_new_cache_entries.size()
+                        << " symbols to cache " << m_cache_filename << std::endl;
+
+        m_new_cache_entries.clear();
+    }
+
+    void add_symbol_attributes(const Entry& e,
                                const SymbolAttributes& sym_attr,
                                MemoryPool& mempool,
                                std::vector<Attribute>& attr, 
                                std::vector<Variant>&   data) {
-        std::vector<Statement*> statements;
-        SymtabAPI::Function* function = 0;
+        int flags = (m_lookup_sourceloc ? CACHE_SOURCELOC : 0)
+                  | (m_lookup_functions ? CACHE_FUNCTIONS : 0);
+
+        CachedSymbol sym;
+
+        if (!resolve(e.value().to_uint(), flags, sym))
+            return;
+
+        if (m_lookup_sourceloc) {
+            char* tmp_s = static_cast<char*>(mempool.allocate(sym.file.size()+1));
+            std::copy(sym.file.begin(), sym.file.end(), tmp_s);
+            tmp_s[sym.file.size()] = '\0';
+
+            attr.push_back(sym_attr.file_attr);
+            attr.push_back(sym_attr.line_attr);
+
+            data.push_back(Variant(CALI_TYPE_STRING, tmp_s, sym.file.size()));
+            data.push_back(Variant(CALI_TYPE_UINT,   &sym.line, sizeof(uint64_t)));
+        }
 
-        bool     ret_line = false;
-        bool     ret_func = false;
+        if (m_lookup_functions) {
+            char* tmp_f = static_cast<char*>(mempool.allocate(sym.function.size()+1));
+            std::copy(sym.function.begin(), sym.function.end(), tmp_f);
+            tmp_f[sym.function.size()] = '\0';
 
-        uint64_t address  = e.value().to_uint();
+            attr.push_back(sym_attr.func_attr);
+            data.push_back(Variant(CALI_TYPE_STRING, tmp_f, sym.function.size()));
+        }
+    }
+
+    /// Resolve \a address, first through the in-memory memo, then the
+    /// persistent cache, then symtab. Thread-safe; concurrent callers
+    /// resolving addresses of different modules query symtab in parallel.
+    /// \return false if the lookup is unavailable.
+    bool resolve(uint64_t address, int flags, CachedSymbol& out) {
+        {
+            std::lock_guard<std::mutex>
+                g(m_memo_mutex);
+
+            auto it = m_memo.find(address);
+
+            if (it != m_memo.end()) {
+                out = it->second;
+                return true;
+            }
+        }
+
+        Symtab*     symtab      = nullptr;
+        Offset      offset      = 0;
+        std::mutex* symtab_lock = nullptr;
+
+        bool        ret         = false;
+        bool        have_key    = false;
+        CacheKey    key         = { 0, 0 };
 
         {
             std::lock_guard<std::mutex>
                 g(m_lookup_mutex);
 
             if (!m_lookup)
-                return;
+                return false;
 
-            Symtab* symtab;
-            Offset  offset;
+            ret = m_lookup->getOffset(address, symtab, offset);
 
-            bool ret = m_lookup->getOffset(address, symtab, offset);
+            if (ret) {
+                if (!m_cache_filename.empty()) {
+                    key      = { get_module_id(symtab), offset };
+                    have_key = true;
+                }
 
-            if (ret && m_lookup_sourceloc)
-                ret_line = symtab->getSourceLines(statements, offset);
-            if (ret && m_lookup_functions)
-                ret_func = symtab->getContainingFunction(offset, function);
+                symtab_lock = get_symtab_lock(symtab);
+            }
 
             ++m_num_lookups;
         }
 
-        if (m_lookup_sourceloc) {
-            std::string filename = "UNKNOWN";
-            uint64_t    lineno   = 0;
+        out.flags    = flags;
+        out.file     = "UNKNOWN";
+        out.line     = 0;
+        out.function = "UNKNOWN";
 
-            if (ret_line && statements.size() > 0) {
-                filename = statements.front()->getFile();
-                lineno   = statements.front()->getLine();
-            }
+        bool cached = have_key && cache_lookup(key, flags, out);
 
-            char* tmp_s = static_cast<char*>(mempool.allocate(filename.size()+1));
-            std::copy(filename.begin(), filename.end(), tmp_s);
-            tmp_s[filename.size()] = '\0';
+        if (cached)
+            ++m_num_cache_hits;
 
-            attr.push_back(sym_attr.file_attr);
-            attr.push_back(sym_attr.line_attr);
+        if (!cached && ret) {
+            std::vector<Statement*> statements;
+            SymtabAPI::Function* function = 0;
 
-            data.push_back(Variant(CALI_TYPE_STRING, tmp_s, filename.size()));
-            data.push_back(Variant(CALI_TYPE_UINT,   &lineno, sizeof(uint64_t)));
-        }
+            bool ret_line = false;
+            bool ret_func = false;
 
-        if (m_lookup_functions) {
-            std::string funcname = "UNKNOWN";
+            {
+                std::lock_guard<std::mutex>
+                    g(*symtab_lock);
+
+                if (m_lookup_sourceloc)
+                    ret_line = symtab->getSourceLines(statements, offset);
+                if (m_lookup_functions)
+                    ret_func = symtab->getContainingFunction(offset, function);
+            }
+
+            if (ret_line && statements.size() > 0) {
+                out.file = statements.front()->getFile();
+                out.line = statements.front()->getLine();
+            }
 
             if (ret_func && function) {
                 auto it = function->pretty_names_begin();
 
                 if (it != function->pretty_names_end())
-                    funcname = *it;
+                    out.function = *it;
             }
 
-            char* tmp_f = static_cast<char*>(mempool.allocate(funcname.size()+1));
-            std::copy(funcname.begin(), funcname.end(), tmp_f);
-            tmp_f[funcname.size()] = '\0';
+            // Cache fully successful resolutions
+            if (have_key
+                && (ret_line || !m_lookup_sourceloc)
+                && (ret_func || !m_lookup_functions))
+                cache_insert(key, out);
 
-            attr.push_back(sym_attr.func_attr);
-            data.push_back(Variant(CALI_TYPE_STRING, tmp_f, funcname.size()));
+            if ((m_lookup_functions && !ret_func) || (m_lookup_sourceloc && !ret_line))
+                ++m_num_failed;
+        } else if (!ret)
+            ++m_num_failed;
+
+        {
+            std::lock_guard<std::mutex>
+                g(m_memo_mutex);
+
+            m_memo.insert(std::make_pair(address, out));
+        }
+
+        return true;
+    }
+
+    // Track the ids of address attributes so snapshot processing can
+    // collect their values cheaply.
+    void watch_attribute(Caliper* c, const Attribute& attr) {
+        if (attr == Attribute::invalid)
+            return;
+
+        if (m_addr_attr_names.empty()) {
+            if (!attr.get(c->get_attribute("class.symboladdress")).to_bool())
+                return;
+        } else if (std::find(m_addr_attr_names.begin(), m_addr_attr_names.end(),
+                             attr.name()) == m_addr_attr_names.end())
+            return;
+
+        std::lock_guard<std::mutex>
+            g(m_attr_watch_mutex);
+
+        int n = m_num_addr_attrs.load(std::memory_order_relaxed);
+
+        for (int i = 0; i < n; ++i)
+            if (m_addr_attr_ids[i] == attr.id())
+                return;
+
+        if (n >= MAX_ADDRESS_ATTRIBUTES)
+            return;
+
+        m_addr_attr_ids[n] = attr.id();
+        m_num_addr_attrs.store(n+1, std::memory_order_release);
+    }
+
+    void scan_address_attributes(Caliper* c) {
+        for (const Attribute& attr :
+                 c->find_attributes_with(c->get_attribute("class.symboladdress")))
+            watch_attribute(c, attr);
+
+        for (const std::string& s : m_addr_attr_names)
+            watch_attribute(c, c->get_attribute(s));
+    }
+
+    void collect_addresses(const SnapshotRecord* snapshot) {
+        int n = m_num_addr_attrs.load(std::memory_order_acquire);
+
+        if (!n)
+            return;
+
+        SnapshotRecord::Sizes sizes = snapshot->size();
+        SnapshotRecord::Data  addr  = snapshot->data();
+
+        for (size_t i = 0; i < sizes.n_immediate; ++i)
+            for (int a = 0; a < n; ++a)
+                if (addr.immediate_attr[i] == m_addr_attr_ids[a]) {
+                    uint64_t address = addr.immediate_data[i].to_uint();
+
+                    std::lock_guard<util::spinlock>
+                        g(m_addr_set_lock);
+
+                    m_addr_set.insert(address);
+                }
+    }
+
+    // Resolve the collected unique address set with a thread pool
+    // before the flushed records are rewritten.
+    void batch_resolve(Caliper* c) {
+        std::vector<uint64_t> addrs;
+
+        {
+            std::lock_guard<util::spinlock>
+                g(m_addr_set_lock);
+
+            addrs.assign(m_addr_set.begin(), m_addr_set.end());
         }
 
-        if ((m_lookup_functions && !ret_func) || (m_lookup_sourceloc && !ret_line))
-            ++m_num_failed; // not locked, doesn't matter too much if it's slightly off
+        if (addrs.empty())
+            return;
+
+        int flags = (m_lookup_sourceloc ? CACHE_SOURCELOC : 0)
+                  | (m_lookup_functions ? CACHE_FUNCTIONS : 0);
+
+        unsigned nthreads =
+            std::max<unsigned>(std::min<unsigned>(m_batch_threads, addrs.size()), 1);
+
+        std::atomic<std::size_t> next { 0 };
+
+        auto worker = [this,&addrs,&next,flags]() {
+            CachedSymbol sym;
+
+            for (std::size_t i = next++; i < addrs.size(); i = next++)
+                resolve(addrs[i], flags, sym);
+        };
+
+        std::vector<std::thread> pool;
+
+        for (unsigned t = 1; t < nthreads; ++t)
+            pool.emplace_back(worker);
+
+        worker();
+
+        for (std::thread& t : pool)
+            t.join();
+
+        Log(1).stream() << "Symbollookup: Batch-resolved " << addrs.size()
+                        << " unique addresses using " << nthreads
+                        << " threads" << std::endl;
     }
 
     void process_snapshot(Caliper* c, SnapshotRecord* snapshot) {
@@ -260,10 +643,13 @@ class SymbolLookup
 
     // some final log output; print warning if we didn't find an address attribute
     void finish_log(Caliper* c) {
-        Log(1).stream() << "Symbollookup: Performed " 
-                        << m_num_lookups << " address lookups, "
-                        << m_num_failed  << " failed." 
+        Log(1).stream() << "Symbollookup: Performed "
+                        << m_num_lookups    << " address lookups, "
+                        << m_num_cache_hits << " cache hits, "
+                        << m_num_failed     << " failed."
                         << std::endl;
+
+        write_cache();
     }
 
     void init_lookup() {
@@ -284,12 +670,27 @@ class SymbolLookup
     static void pre_flush_cb(Caliper* c, const SnapshotRecord*) {
         s_instance->check_attributes(c);
         s_instance->init_lookup();
+
+        if (s_instance->m_batch_resolve)
+            s_instance->batch_resolve(c);
     }
 
     static void postprocess_snapshot_cb(Caliper* c, SnapshotRecord* snapshot) {
         s_instance->process_snapshot(c, snapshot);
     }
 
+    static void post_init_cb(Caliper* c) {
+        s_instance->scan_address_attributes(c);
+    }
+
+    static void create_attr_cb(Caliper* c, const Attribute& attr) {
+        s_instance->watch_attribute(c, attr);
+    }
+
+    static void process_snapshot_cb(Caliper* c, const SnapshotRecord*, const SnapshotRecord* snapshot) {
+        s_instance->collect_addresses(snapshot);
+    }
+
     static void finish_cb(Caliper* c) {
         s_instance->finish_log(c);
     }
@@ -298,11 +699,23 @@ class SymbolLookup
         c->events().pre_flush_evt.connect(pre_flush_cb);
         c->events().postprocess_snapshot.connect(postprocess_snapshot_cb);
         c->events().finish_evt.connect(finish_cb);
+
+        if (m_batch_resolve) {
+            c->events().post_init_evt.connect(post_init_cb);
+            c->events().create_attr_evt.connect(create_attr_cb);
+            c->events().process_snapshot.connect(process_snapshot_cb);
+        }
     }
 
     SymbolLookup(Caliper* c)
         : m_config(RuntimeConfig::init("symbollookup", s_configdata)),
-          m_lookup(0)
+          m_lookup(0),
+          m_batch_resolve(true),
+          m_batch_threads(4),
+          m_num_addr_attrs(0),
+          m_num_lookups(0),
+          m_num_failed(0),
+          m_num_cache_hits(0)
         {
             util::split(m_config.get("attributes").to_string(), ':',
                         std::back_inserter(m_addr_attr_names));
@@ -310,6 +723,14 @@ class SymbolLookup
             m_lookup_functions = m_config.get("lookup_functions").to_bool();
             m_lookup_sourceloc = m_config.get("lookup_sourceloc").to_bool();
 
+            m_cache_filename   = m_config.get("cache_file").to_string();
+
+            m_batch_resolve    = m_config.get("batch_resolve").to_bool();
+            m_batch_threads    =
+                std::max<unsigned>(m_config.get("batch_resolve_threads").to_uint(), 1);
+
+            load_cache();
+
             register_callbacks(c);
 
             Log(1).stream() << "Registered symbollookup service" << std::endl;
@@ -337,6 +758,23 @@ const ConfigSet::Entry SymbolLookup::s_configdata[] = {
       "Perform source location (filename/linenumber) lookup",
       "Perform source location (filename/linenumber) lookup",
     },
+    { "batch_resolve", CALI_TYPE_BOOL, "true",
+      "Resolve unique addresses in parallel at flush",
+      "Collect the unique addresses seen in snapshot records during the\n"
+      "run and resolve them with a thread pool at flush, before the\n"
+      "flushed records are rewritten.",
+    },
+    { "batch_resolve_threads", CALI_TYPE_UINT, "4",
+      "Number of threads for batch address resolution",
+      "Number of threads for batch address resolution",
+    },
+    { "cache_file", CALI_TYPE_STRING, "",
+      "Persistent symbol cache file",
+      "Persistent symbol cache file. Resolved symbols are cached here\n"
+      "across runs, keyed by module and offset; repeat runs against\n"
+      "unchanged binaries only resolve new addresses. Empty disables\n"
+      "the cache.",
+    },
     ConfigSet::Terminator
 };
     
@@ -1,4 +1,4 @@
-// Copyright (c) 2015, Lawrence Livermore National Security, LLC.  
+// Copyright (c) 2015, Lawrence Livermore National Security, LLC.
 // Produced at the Lawrence Livermore National Laboratory.
 //
 // This file is part of Caliper.
@@ -31,48 +31,87 @@
 // ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 /// @file  tau.cpp
-/// @brief Caliper TAU service
+/// @brief Caliper TAU annotation binding
 
-#include "../common/ToolWrapper.h"
-#include "caliper/common/filters/RegexFilter.h"
+#include "../common/AnnotationBinding.h"
 
+#include "caliper/common/Attribute.h"
+#include "caliper/common/Node.h"
+
+#include <sstream>
+#include <mutex>
+#include <vector>
 
-#include <map>
 #include <TAU.h>
 
-namespace cali {
+namespace cali
+{
 
+class TAUBinding : public AnnotationBinding
+{
+    // Resolved TAU timers indexed by Caliper context tree node id.
+    // Each (attribute, value) pair maps to one node, so steady-state
+    // forwarding is an array load and a TAU start/stop call rather
+    // than a per-event string resolution.
 
-class TAUWrapper : public ToolWrapper {
-  public:
-    virtual void initialize(){
-        TAU_PROFILE_SET_NODE(0);
-    }
+    std::vector<void*> m_timers;
+    std::mutex         m_timer_mutex;
 
-    virtual std::string service_name() { 
-      return "TAU service";
-    }
-    virtual std::string service_tag(){
-      return "tau";
+    void* acquire_timer(const Node* node, const Attribute& attr, const Variant& value) {
+        cali_id_t id = node->id();
+
+        std::lock_guard<std::mutex>
+            g(m_timer_mutex);
+
+        if (id >= m_timers.size())
+            m_timers.resize(id + 1, nullptr);
+
+        void* timer = m_timers[id];
+
+        if (!timer) {
+            std::stringstream ss;
+            ss << attr.name() << "=" << value.to_string();
+            std::string name = ss.str();
+
+            TAU_PROFILER_CREATE(timer, name.c_str(), "", TAU_USER);
+
+            m_timers[id] = timer;
+        }
+
+        return timer;
     }
-    virtual void beginAction(Caliper* c, const Attribute &attr, const Variant& value){
-      std::stringstream ss;
-      ss << attr.name() << "=" << value.to_string();
-      std::string name = ss.str();
 
-      TAU_START(name.c_str());
+public:
+
+    void initialize(Caliper* c) {
+        TAU_PROFILE_SET_NODE(0);
     }
 
-    virtual void endAction(Caliper* c, const Attribute& attr, const Variant& value){
-      std::stringstream ss;
-      ss << attr.name() << "=" << value.to_string();
-      std::string name = ss.str();
-      TAU_STOP(name.c_str());
+    const char* service_tag() const { return "tau"; }
+
+    void on_begin(Caliper* c, const Attribute& attr, const Variant& value) {
+        Node* node = c->make_tree_entry(attr, value, nullptr);
+
+        if (!node)
+            return;
+
+        void* timer = acquire_timer(node, attr, value);
+
+        TAU_PROFILER_START(timer);
     }
-};
 
-CaliperService tau_service { "tau", &setCallbacks<TAUWrapper>};
+    void on_end(Caliper* c, const Attribute& attr, const Variant& value) {
+        Node* node = c->make_tree_entry(attr, value, nullptr);
+
+        if (!node)
+            return;
+
+        void* timer = acquire_timer(node, attr, value);
 
+        TAU_PROFILER_STOP(timer);
+    }
+};
 
-}
+CaliperService tau_service { "tau", &AnnotationBinding::make_binding<TAUBinding> };
 
+} // namespace cali
@@ -13,11 +13,13 @@
 #include "caliper/common/util/split.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <functional>
 #include <iterator>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <sstream>
@@ -46,9 +48,30 @@ const ConfigSet::Entry   configdata[] = {
       "   none:   No output,\n"
       " or a file name. The default is stdout\n"
     },
+    { "buffer_size", CALI_TYPE_UINT, "65536",
+      "Size of the per-thread output buffer in bytes",
+      "Size of the per-thread output buffer in bytes. Formatted log\n"
+      "entries are written out in batches when a buffer fills up or its\n"
+      "flush interval expires. Set to 0 to write each entry immediately."
+    },
+    { "flush_interval", CALI_TYPE_UINT, "500",
+      "Maximum buffering time in milliseconds",
+      "Maximum time in milliseconds a buffered log entry may be held\n"
+      "back before its buffer is flushed to the output stream."
+    },
     ConfigSet::Terminator
 };
 
+// Per-thread buffer for formatted log entries. Entries are appended by
+// the owning thread; the finish handler may flush leftover contents.
+struct LogBuffer {
+    std::mutex                            lock;
+    std::string                           data;
+    std::chrono::steady_clock::time_point last_flush;
+};
+
+thread_local LogBuffer* t_buffer { nullptr };
+
 class TextLogService
 {
     ConfigSet                   config;
@@ -70,7 +93,14 @@ class TextLogService
     Attribute                   end_event_attr;
 
     std::mutex                  stream_mutex;
-    
+
+    std::size_t                 m_buffer_size;
+    std::chrono::milliseconds   m_flush_interval;
+
+    std::mutex                  buffer_list_mutex;
+    std::vector< std::unique_ptr<LogBuffer> >
+                                buffer_list;
+
     static unique_ptr<TextLogService> 
                                 s_textlog;
 
@@ -128,6 +158,66 @@ class TextLogService
         }
     }
 
+    void write_output(const std::string& str) {
+        if (m_buffer_size == 0) {
+            std::lock_guard<std::mutex>
+                g(stream_mutex);
+
+            get_stream() << str;
+            return;
+        }
+
+        LogBuffer* buf = t_buffer;
+
+        if (!buf) {
+            buf = new LogBuffer;
+            buf->last_flush = std::chrono::steady_clock::now();
+
+            std::lock_guard<std::mutex>
+                g(buffer_list_mutex);
+
+            buffer_list.emplace_back(buf);
+            t_buffer = buf;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+
+        std::lock_guard<std::mutex>
+            gb(buf->lock);
+
+        buf->data.append(str);
+
+        if (buf->data.size() >= m_buffer_size || now - buf->last_flush >= m_flush_interval) {
+            std::lock_guard<std::mutex>
+                gs(stream_mutex);
+
+            get_stream() << buf->data;
+
+            buf->data.clear();
+            buf->last_flush = now;
+        }
+    }
+
+    void flush_buffers() {
+        std::lock_guard<std::mutex>
+            g(buffer_list_mutex);
+
+        for (auto &buf : buffer_list) {
+            std::lock_guard<std::mutex>
+                gb(buf->lock);
+
+            if (buf->data.empty())
+                continue;
+
+            std::lock_guard<std::mutex>
+                gs(stream_mutex);
+
+            get_stream() << buf->data;
+
+            buf->data.clear();
+        }
+    }
+
     void create_attribute(Caliper* c, const Attribute& attr) {
         if (attr.skip_events())
             return;
@@ -179,13 +269,10 @@ class TextLogService
             entrylist.push_back(Entry(data.immediate_attr[n], data.immediate_data[n]));
 
         ostringstream os;
-        
-        formatter.print(os, c, entrylist) << std::endl;
 
-        std::lock_guard<std::mutex>
-            g(stream_mutex);
+        formatter.print(os, c, entrylist) << std::endl;
 
-        get_stream() << os.str();
+        write_output(os.str());
     }
 
     void post_init(Caliper* c) {
@@ -196,8 +283,8 @@ class TextLogService
 
         formatter.reset(formatstr);
 
-        set_event_attr = c->get_attribute("cali.snapshot.event.set");
-        end_event_attr = c->get_attribute("cali.snapshot.event.end");
+        set_event_attr = c->get_attribute("cali.event.set");
+        end_event_attr = c->get_attribute("cali.event.end");
 
         if (end_event_attr      == Attribute::invalid ||
             set_event_attr      == Attribute::invalid)
@@ -205,6 +292,11 @@ class TextLogService
                 "    disabling text log.\n" << std::endl;
     }
 
+    void finish(Caliper* c) {
+        flush_buffers();
+        get_stream().flush();
+    }
+
     // static callbacks
 
     static void create_attr_cb(Caliper* c, const Attribute& attr) {
@@ -215,23 +307,32 @@ class TextLogService
         s_textlog->process_snapshot(c, trigger_info, snapshot);
     }
 
-    static void post_init_cb(Caliper* c) { 
+    static void post_init_cb(Caliper* c) {
         s_textlog->post_init(c);
     }
 
+    static void finish_cb(Caliper* c) {
+        s_textlog->finish(c);
+    }
+
     TextLogService(Caliper* c)
         : config(RuntimeConfig::init("textlog", configdata)),
           set_event_attr(Attribute::invalid),
           end_event_attr(Attribute::invalid)
-        { 
+        {
             init_stream();
 
-            util::split(config.get("trigger").to_string(), ':', 
+            m_buffer_size    = config.get("buffer_size").to_uint();
+            m_flush_interval =
+                std::chrono::milliseconds(config.get("flush_interval").to_uint());
+
+            util::split(config.get("trigger").to_string(), ':',
                         std::back_inserter(trigger_attr_names));
 
             c->events().create_attr_evt.connect(&TextLogService::create_attr_cb);
             c->events().post_init_evt.connect(&TextLogService::post_init_cb);
             c->events().process_snapshot.connect(&TextLogService::process_snapshot_cb);
+            c->events().finish_evt.connect(&TextLogService::finish_cb);
 
             Log(1).stream() << "Registered text log service" << std::endl;
         }
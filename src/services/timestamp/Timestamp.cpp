@@ -42,14 +42,15 @@
 #include "caliper/common/ContextRecord.h"
 #include "caliper/common/Log.h"
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
-#include <map>
-#include <mutex>
 #include <string>
 #include <type_traits>
 #include <vector>
 
+#include <time.h>
+
 using namespace cali;
 using namespace std;
 
@@ -58,6 +59,74 @@ namespace
 
 chrono::time_point<chrono::high_resolution_clock> tstart;
 
+enum class ClockSource { Chrono, Tsc };
+
+ClockSource clocksource = ClockSource::Chrono;
+
+// --- TSC clock source state
+
+uint64_t tsc_start         = 0;
+double   tsc_usec_per_tick = 0.0;
+
+inline uint64_t read_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned lo, hi;
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+#else
+    return 0;
+#endif
+}
+
+// Calibrate the TSC tick length against the high-resolution clock.
+// Assumes an invariant TSC that runs at constant rate and is
+// synchronized across cores and sockets (constant_tsc/nonstop_tsc on
+// modern x86); on such systems the calibration holds process-wide.
+
+bool init_tsc_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+    const int64_t calibration_usec = 10000;
+
+    auto     c0 = chrono::high_resolution_clock::now();
+    uint64_t t0 = read_tsc();
+
+    while (chrono::duration_cast<chrono::microseconds>(
+               chrono::high_resolution_clock::now() - c0).count() < calibration_usec)
+        ;
+
+    auto     c1 = chrono::high_resolution_clock::now();
+    uint64_t t1 = read_tsc();
+
+    if (t1 <= t0)
+        return false;
+
+    int64_t  usec = chrono::duration_cast<chrono::microseconds>(c1 - c0).count();
+
+    tsc_usec_per_tick = static_cast<double>(usec) / static_cast<double>(t1 - t0);
+    tsc_start         = t0;
+
+    Log(2).stream() << "Timestamp: TSC calibrated to "
+                    << 1.0 / tsc_usec_per_tick << " ticks/usec" << std::endl;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Microseconds since service registration on the configured clock source
+
+inline uint64_t get_usec_offset() {
+    if (clocksource == ClockSource::Tsc) {
+        uint64_t tsc = read_tsc();
+        return tsc > tsc_start ?
+            static_cast<uint64_t>((tsc - tsc_start) * tsc_usec_per_tick) : 0;
+    }
+
+    return chrono::duration_cast<chrono::microseconds>(
+        chrono::high_resolution_clock::now() - tstart).count();
+}
+
 Attribute timestamp_attr { Attribute::invalid } ;
 Attribute timeoffs_attr  { Attribute::invalid } ;
 Attribute snapshot_duration_attr { Attribute::invalid };
@@ -69,16 +138,91 @@ bool      record_timestamp;
 bool      record_offset;
 bool      record_duration;
 bool      record_phases;
+bool      record_sequence;
+
+// --- sequence timer mode state
+//
+// Sequence mode records a per-thread monotonically increasing
+// sequence number instead of a clock read: the increment is a plain
+// thread-local register op, and as a monotonic attribute the
+// sequence delta-encodes to almost nothing in trace buffers.
+// Periodic sync records pair the current sequence number with an
+// absolute time offset so readers can reconstruct absolute times
+// for the snapshots in between.
+
+Attribute seq_attr  { Attribute::invalid };
+Attribute sync_attr { Attribute::invalid };
+
+unsigned  sync_interval = 1000;
+
+thread_local uint64_t t_seq       = 0;
+thread_local uint64_t t_last_sync = 0;
+
+// --- CPU timer state
+//
+// The dual-clock mode records thread CPU time next to the wall-clock
+// timers to detect oversubscription. A thread CPU clock read is much
+// more expensive than the wall clock, so it is sampled lazily: every
+// N-th snapshot per thread, or on region end events only. Readers
+// interpolate CPU time for the snapshots in between from the
+// surrounding samples' wall-clock offsets.
+
+enum class CpuTimeMode { None, Interval, End };
+
+CpuTimeMode cputime_mode     = CpuTimeMode::None;
+unsigned    cputime_interval = 32;
+
+Attribute cputime_attr { Attribute::invalid };
+
+thread_local uint64_t t_cputime_count = 0;
+
+#ifdef CLOCK_THREAD_CPUTIME_ID
+inline uint64_t get_cputime_usec() {
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        return 0;
+
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+#endif
 
 Attribute begin_evt_attr { Attribute::invalid };
 Attribute set_evt_attr   { Attribute::invalid };
 Attribute end_evt_attr   { Attribute::invalid };
 Attribute lvl_attr       { Attribute::invalid };
 
-typedef std::map<uint64_t, Attribute> OffsetAttributeMap;
+// --- phase timer state
+//
+// Begin times for open phases live on a per-thread stack: a begin
+// event pushes the current time, the matching end event pops it and
+// appends the elapsed time to the end snapshot. Entries carry the
+// event's (attribute, nesting level) pair so interleaved annotations
+// resolve to their matching begin; the match is almost always the top
+// of the stack.
+
+struct PhaseStackEntry {
+    cali_id_t attr_id;
+    uint64_t  level;
+    uint64_t  usec;
+};
 
-std::mutex         offset_attributes_mutex;
-OffsetAttributeMap offset_attributes;
+thread_local std::vector<PhaseStackEntry> t_phase_stack;
+
+std::vector<PhaseStackEntry>::iterator
+find_phase_entry(cali_id_t attr_id, uint64_t level)
+{
+    auto it = t_phase_stack.end();
+
+    while (it != t_phase_stack.begin()) {
+        --it;
+
+        if (it->attr_id == attr_id && it->level == level)
+            return it;
+    }
+
+    return t_phase_stack.end();
+}
 
 static const ConfigSet::Entry s_configdata[] = {
     { "snapshot_duration", CALI_TYPE_BOOL, "false",
@@ -95,87 +239,69 @@ static const ConfigSet::Entry s_configdata[] = {
     },
     { "inclusive_duration", CALI_TYPE_BOOL, "true",
       "Record inclusive duration of begin/end phases.",
-      "Record inclusive duration of begin/end phases."
+      "Record inclusive duration of begin/end phases. The elapsed\n"
+      "time since the matching begin is computed at runtime and\n"
+      "written with the end snapshot, so readers need no begin/end\n"
+      "pairing pass to compute region profiles."
+    },
+    { "sequence", CALI_TYPE_BOOL, "false",
+      "Include a per-thread snapshot sequence number with each context record",
+      "Include a per-thread monotonically increasing sequence number"
+      "with each context record instead of a clock read. Gives"
+      "relative ordering within a thread at the cost of a register"
+      "op, and delta-encodes to almost nothing in trace buffers."
+      "Periodic sync records (see sync_interval) pair the sequence"
+      "with an absolute time offset so readers can reconstruct"
+      "absolute times."
+    },
+    { "sync_interval", CALI_TYPE_UINT, "1000",
+      "Emit an absolute time sync record every N sequence snapshots",
+      "In sequence mode, emit an absolute time offset paired with the"
+      "current sequence number on the first snapshot of each thread"
+      "and every N-th snapshot after that."
+    },
+    { "cputime", CALI_TYPE_STRING, "none",
+      "Sample the thread CPU-time clock (\"none\", \"interval\", or \"end\")",
+      "Record thread CPU time next to the wall-clock timers to detect\n"
+      "oversubscription. The thread CPU clock is sampled lazily:\n"
+      "   none:     Off (default)\n"
+      "   interval: Sample every N-th snapshot per thread\n"
+      "             (see cputime_interval)\n"
+      "   end:      Sample on region end events only\n"
+      "Snapshots between samples carry no CPU time value; readers\n"
+      "interpolate from the surrounding samples' wall-clock offsets."
+    },
+    { "cputime_interval", CALI_TYPE_UINT, "32",
+      "Sample the thread CPU clock every N snapshots per thread",
+      "Sample the thread CPU clock every N snapshots per thread in\n"
+      "cputime=interval mode. Each thread's first snapshot is always\n"
+      "sampled to anchor the interpolation."
+    },
+    { "clocksource", CALI_TYPE_STRING, "chrono",
+      "Clock source for duration and offset timers (\"chrono\" or \"tsc\")",
+      "Clock source for duration and offset timers. Either\n"
+      "   chrono: std::chrono high-resolution clock reads,\n"
+      "   tsc:    Cycle counter reads (rdtsc), calibrated against the\n"
+      "           system clock at startup. Requires an invariant TSC\n"
+      "           (x86 with constant_tsc/nonstop_tsc).\n"
+      "Default: chrono"
     },
     ConfigSet::Terminator
 };
 
 
-uint64_t make_offset_attribute_key(cali_id_t attr_id, unsigned level)
-{
-    // assert((level   & 0xFFFF)         == 0);
-    // assert((attr_id & 0xFFFFFFFFFFFF) == 0);
-
-    uint64_t lvl_k = static_cast<uint64_t>(level) << 48;
-
-    return lvl_k | attr_id;    
-}
-
-// Get or create a hidden offset attribute for the given attribute and its
-// current hierarchy level
-
-Attribute make_offset_attribute(Caliper* c, cali_id_t attr_id, unsigned level)
-{
-    uint64_t key = make_offset_attribute_key(attr_id, level);
-
-    {
-        std::lock_guard<std::mutex>  lock(offset_attributes_mutex);
-        OffsetAttributeMap::iterator it = offset_attributes.find(key);
-    
-        if (it != offset_attributes.end())
-            return it->second;
-    }
-
-    // Not found -> create new entry
-
-    std::string name = "offs.";
-    name.append(std::to_string(attr_id));
-    name.append(".");
-    name.append(std::to_string(level));
-
-    Attribute offs_attr = 
-        c->create_attribute(name, CALI_TYPE_UINT,
-                            CALI_ATTR_ASVALUE     |
-                            CALI_ATTR_SKIP_EVENTS |
-                            CALI_ATTR_HIDDEN      |
-                            CALI_ATTR_SCOPE_THREAD); // FIXME: needs to be original attribute's scope
-
-    std::lock_guard<std::mutex> lock(offset_attributes_mutex);
-    offset_attributes.insert(std::make_pair(key, offs_attr));
-
-    return offs_attr;
-}
-
-// Get existing hidden offset attribute for the given attribute and its
-// current hierarchy level
-
-Attribute find_offset_attribute(Caliper* c, cali_id_t attr_id, unsigned level)
-{
-    uint64_t key = make_offset_attribute_key(attr_id, level);
-
-    {
-        std::lock_guard<std::mutex>  lock(offset_attributes_mutex);
-        OffsetAttributeMap::iterator it = offset_attributes.find(key);
-    
-        if (it != offset_attributes.end())
-            return it->second;
-    }
-
-    return Attribute::invalid;
-}
-
 void snapshot_cb(Caliper* c, int scope, const SnapshotRecord* trigger_info, SnapshotRecord* sbuf) {
-    auto now = chrono::high_resolution_clock::now();
+    // stage entries locally, append them to the snapshot in one go at the end
+    SnapshotBuilder<0, 8> rec;
 
     if ((record_duration || record_phases || record_offset) && scope & CALI_SCOPE_THREAD) {
-        uint64_t  usec = chrono::duration_cast<chrono::microseconds>(now - tstart).count();
-        Variant v_usec = Variant(usec);
-        Variant v_offs = c->exchange(timeoffs_attr, v_usec);
+        uint64_t  usec = get_usec_offset();
 
-        if (record_duration && !v_offs.empty()) {
-            uint64_t duration = usec - v_offs.to_uint();
+        if (record_duration || record_offset) {
+            Variant v_offs = c->exchange(timeoffs_attr, Variant(usec));
 
-            sbuf->append(snapshot_duration_attr.id(), Variant(duration));
+            if (record_duration && !v_offs.empty())
+                rec.append(snapshot_duration_attr.id(), Variant(usec - v_offs.to_uint()));
         }
 
         if (record_phases && trigger_info) {
@@ -190,7 +316,7 @@ void snapshot_cb(Caliper* c, int scope, const SnapshotRecord* trigger_info, Snap
                 event = trigger_info->get(end_evt_attr);
             if (event.is_empty())
                 goto record_phases_exit;
-            
+
             evt_attr_id = event.value().to_id();
             v_level     = trigger_info->get(lvl_attr).value();
 
@@ -198,40 +324,66 @@ void snapshot_cb(Caliper* c, int scope, const SnapshotRecord* trigger_info, Snap
                 goto record_phases_exit;
 
             if (event.attribute() == begin_evt_attr.id()) {
-                // begin/set event: save time for current entry
+                // begin event: push begin time for the new entry
 
-                c->set(make_offset_attribute(c, evt_attr_id, v_level.to_uint()), v_usec);
+                t_phase_stack.push_back( { evt_attr_id, v_level.to_uint(), usec } );
             } else if (event.attribute() == set_evt_attr.id())   {
-                // set event: get saved time for current entry and calculate duration
+                // set event: emit time since the previous set/begin at
+                // this level, if any, and restart the timer
 
-                Variant v_p_usec    = 
-                    c->exchange(make_offset_attribute(c, evt_attr_id, v_level.to_uint()), v_usec);
+                auto it = find_phase_entry(evt_attr_id, v_level.to_uint());
 
-                if (!v_p_usec.empty())
-                    sbuf->append(phase_duration_attr.id(), Variant(usec - v_p_usec.to_uint()));
+                if (it != t_phase_stack.end()) {
+                    rec.append(phase_duration_attr.id(), Variant(usec - it->usec));
+                    it->usec = usec;
+                } else
+                    t_phase_stack.push_back( { evt_attr_id, v_level.to_uint(), usec } );
             } else if (event.attribute() == end_evt_attr.id())   {
-                // end event: get saved time for current entry and calculate duration
-
-                Attribute offs_attr = 
-                    find_offset_attribute(c, evt_attr_id, v_level.to_uint());
-
-                if (offs_attr == Attribute::invalid)
-                    goto record_phases_exit;
+                // end event: pop the matching begin time and emit the
+                // elapsed time on the end snapshot
 
-                Variant v_p_usec    = 
-                    c->exchange(offs_attr, Variant());
+                auto it = find_phase_entry(evt_attr_id, v_level.to_uint());
 
-                if (!v_p_usec.empty())
-                    sbuf->append(phase_duration_attr.id(), Variant(usec - v_p_usec.to_uint()));
+                if (it != t_phase_stack.end()) {
+                    rec.append(phase_duration_attr.id(), Variant(usec - it->usec));
+                    t_phase_stack.erase(it);
+                }
             }
 record_phases_exit:
             ;
         }
     }
 
+    if (record_sequence && (scope & CALI_SCOPE_THREAD)) {
+        uint64_t seq = ++t_seq;
+
+        rec.append(seq_attr.id(), Variant(seq));
+
+        if (seq == 1 || seq - t_last_sync >= sync_interval) {
+            t_last_sync = seq;
+            rec.append(sync_attr.id(), Variant(get_usec_offset()));
+        }
+    }
+
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    if (cputime_mode != CpuTimeMode::None && (scope & CALI_SCOPE_THREAD)) {
+        bool sample = false;
+
+        if (cputime_mode == CpuTimeMode::Interval)
+            sample = (t_cputime_count++ % cputime_interval) == 0;
+        else if (trigger_info)
+            sample = !trigger_info->get(end_evt_attr).is_empty();
+
+        if (sample)
+            rec.append(cputime_attr.id(), Variant(get_cputime_usec()));
+    }
+#endif
+
     if (record_timestamp && (scope & CALI_SCOPE_PROCESS))
-        sbuf->append(timestamp_attr.id(),
-                     Variant(static_cast<int>(chrono::system_clock::to_time_t(chrono::system_clock::now()))));
+        rec.append(timestamp_attr.id(),
+                   Variant(static_cast<int>(chrono::system_clock::to_time_t(chrono::system_clock::now()))));
+
+    rec.flush(sbuf);
 }
 
 void post_init_cb(Caliper* c)
@@ -252,6 +404,29 @@ void post_init_cb(Caliper* c)
                 "    disabling phase timers." << std::endl;
 
         record_phases = false;
+
+        if (cputime_mode == CpuTimeMode::End) {
+            Log(1).stream() << "Timestamp: Note: event trigger attributes not registered,\n"
+                "    sampling CPU time at interval instead of region end." << std::endl;
+
+            cputime_mode = CpuTimeMode::Interval;
+        }
+    }
+
+    // If phase timers are the only thing we record, our snapshot
+    // callback only acts on event-triggered snapshots: narrow its
+    // interest to the event info attributes so pull_snapshot() skips
+    // us for all other triggers.
+
+    // (Event-triggered CPU sampling fits within the mask; interval
+    // sampling needs every snapshot.)
+
+    if (record_phases &&
+        !(record_duration || record_offset || record_timestamp || record_sequence ||
+          cputime_mode == CpuTimeMode::Interval)) {
+        cali_id_t evt_ids[3] = { begin_evt_attr.id(), set_evt_attr.id(), end_evt_attr.id() };
+
+        c->events().snapshot.set_interest(&snapshot_cb, Caliper::make_attribute_mask(3, evt_ids));
     }
 }
 
@@ -268,6 +443,42 @@ void timestamp_service_register(Caliper* c)
     record_offset    = config.get("offset").to_bool();
     record_timestamp = config.get("timestamp").to_bool();
     record_phases    = config.get("inclusive_duration").to_bool();
+    record_sequence  = config.get("sequence").to_bool();
+
+    sync_interval    = std::max<unsigned>(config.get("sync_interval").to_uint(), 1);
+
+    std::string cputimename = config.get("cputime").to_string();
+
+    if      (cputimename == "interval")
+        cputime_mode = CpuTimeMode::Interval;
+    else if (cputimename == "end")
+        cputime_mode = CpuTimeMode::End;
+    else if (cputimename != "none")
+        Log(0).stream() << "Timestamp: Unknown cputime mode \"" << cputimename
+                        << "\", disabling CPU timer" << std::endl;
+
+    cputime_interval = std::max<unsigned>(config.get("cputime_interval").to_uint(), 1);
+
+#ifndef CLOCK_THREAD_CPUTIME_ID
+    if (cputime_mode != CpuTimeMode::None) {
+        Log(0).stream() << "Timestamp: Thread CPU clock not available, "
+            "disabling CPU timer" << std::endl;
+
+        cputime_mode = CpuTimeMode::None;
+    }
+#endif
+
+    std::string clockname = config.get("clocksource").to_string();
+
+    if (clockname == "tsc") {
+        if (init_tsc_clock())
+            clocksource = ClockSource::Tsc;
+        else
+            Log(0).stream() << "Timestamp: TSC clock source not available, "
+                "using chrono" << std::endl;
+    } else if (clockname != "chrono")
+        Log(0).stream() << "Timestamp: Unknown clock source \"" << clockname
+                        << "\", using chrono" << std::endl;
 
     Attribute unit_attr = 
         c->create_attribute("time.unit", CALI_TYPE_STRING, CALI_ATTR_SKIP_EVENTS);
@@ -284,16 +495,18 @@ void timestamp_service_register(Caliper* c)
     Variant   meta_vals[2] = { true_val,        usec_val  };
 
     timestamp_attr = 
-        c->create_attribute("time.timestamp", CALI_TYPE_UINT, 
-                            CALI_ATTR_ASVALUE       | 
-                            CALI_ATTR_SCOPE_PROCESS | 
-                            CALI_ATTR_SKIP_EVENTS,
+        c->create_attribute("time.timestamp", CALI_TYPE_UINT,
+                            CALI_ATTR_ASVALUE       |
+                            CALI_ATTR_SCOPE_PROCESS |
+                            CALI_ATTR_SKIP_EVENTS   |
+                            CALI_ATTR_MONOTONIC,
                             1, &unit_attr, &sec_val);
     timeoffs_attr = 
-        c->create_attribute("time.offset",    CALI_TYPE_UINT, 
-                            CALI_ATTR_ASVALUE       | 
-                            CALI_ATTR_SCOPE_THREAD  | 
-                            CALI_ATTR_SKIP_EVENTS | hide_offset,
+        c->create_attribute("time.offset",    CALI_TYPE_UINT,
+                            CALI_ATTR_ASVALUE       |
+                            CALI_ATTR_SCOPE_THREAD  |
+                            CALI_ATTR_SKIP_EVENTS   |
+                            CALI_ATTR_MONOTONIC | hide_offset,
                             1, &unit_attr, &usec_val);
     snapshot_duration_attr = 
         c->create_attribute("time.duration",  CALI_TYPE_UINT, 
@@ -308,6 +521,31 @@ void timestamp_service_register(Caliper* c)
                             CALI_ATTR_SKIP_EVENTS,
                             2, meta_attr, meta_vals);
 
+    if (cputime_mode != CpuTimeMode::None)
+        cputime_attr =
+            c->create_attribute("time.cputime", CALI_TYPE_UINT,
+                                CALI_ATTR_ASVALUE       |
+                                CALI_ATTR_SCOPE_THREAD  |
+                                CALI_ATTR_SKIP_EVENTS   |
+                                CALI_ATTR_MONOTONIC,
+                                1, &unit_attr, &usec_val);
+
+    if (record_sequence) {
+        seq_attr =
+            c->create_attribute("time.seq",  CALI_TYPE_UINT,
+                                CALI_ATTR_ASVALUE       |
+                                CALI_ATTR_SCOPE_THREAD  |
+                                CALI_ATTR_SKIP_EVENTS   |
+                                CALI_ATTR_MONOTONIC);
+        sync_attr =
+            c->create_attribute("time.sync", CALI_TYPE_UINT,
+                                CALI_ATTR_ASVALUE       |
+                                CALI_ATTR_SCOPE_THREAD  |
+                                CALI_ATTR_SKIP_EVENTS   |
+                                CALI_ATTR_MONOTONIC,
+                                1, &unit_attr, &usec_val);
+    }
+
     c->set(timeoffs_attr, Variant(static_cast<uint64_t>(0)));
 
     // c->events().create_attr_evt.connect(&create_attr_cb);
@@ -0,0 +1,216 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///@file  Topology.cpp
+///@brief A Caliper service that attaches hardware locality context
+
+#include "../CaliperService.h"
+
+#include "caliper/Caliper.h"
+#include "caliper/SnapshotRecord.h"
+
+#include "caliper/common/Log.h"
+#include "caliper/common/RuntimeConfig.h"
+#include "caliper/common/Variant.h"
+
+#include "caliper/common/util/split.hpp"
+
+#include <sched.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace cali;
+using namespace std;
+
+namespace
+{
+
+const ConfigSet::Entry s_configdata[] = {
+    { "check_interval", CALI_TYPE_UINT, "64",
+      "Check for thread migration every N snapshots",
+      "Check for thread migration every N snapshots.\n"
+      "The placement attributes are updated when the thread has moved\n"
+      "to another cpu since the last check. 0 disables migration\n"
+      "tracking; placement is then captured at thread start only."
+    },
+    ConfigSet::Terminator
+};
+
+Attribute cpu_attr    { Attribute::invalid };
+Attribute socket_attr { Attribute::invalid };
+Attribute numa_attr   { Attribute::invalid };
+
+ConfigSet config;
+
+unsigned  check_interval = 64;
+
+// cpu id -> physical package / NUMA node, read from sysfs at startup
+std::vector<int> cpu_socket;
+std::vector<int> cpu_numa;
+
+thread_local int      t_cpu      = -1;
+thread_local unsigned t_snapshot = 0;
+
+int read_int_file(const std::string& path) {
+    std::ifstream is(path.c_str());
+    int           val = -1;
+
+    is >> val;
+
+    return is ? val : -1;
+}
+
+// parse a sysfs cpu list of the form "0-3,8-11" and assign \a node
+void assign_numa_node(const std::string& list, int node) {
+    std::vector<std::string> ranges;
+
+    util::split(list, ',', std::back_inserter(ranges));
+
+    for (const std::string& r : ranges) {
+        if (r.empty() || !isdigit(r[0]))
+            continue;
+
+        int lo = std::atoi(r.c_str());
+        int hi = lo;
+
+        std::string::size_type dash = r.find('-');
+
+        if (dash != std::string::npos)
+            hi = std::atoi(r.c_str() + dash + 1);
+
+        for (int cpu = lo; cpu <= hi && cpu < static_cast<int>(cpu_numa.size()); ++cpu)
+            if (cpu >= 0)
+                cpu_numa[cpu] = node;
+    }
+}
+
+void read_topology() {
+    long n_cpus = sysconf(_SC_NPROCESSORS_CONF);
+
+    if (n_cpus < 1)
+        n_cpus = 1;
+
+    cpu_socket.assign(n_cpus, -1);
+    cpu_numa.assign(n_cpus, -1);
+
+    for (long cpu = 0; cpu < n_cpus; ++cpu)
+        cpu_socket[cpu] =
+            read_int_file("/sys/devices/system/cpu/cpu" + std::to_string(cpu)
+                          + "/topology/physical_package_id");
+
+    for (int node = 0; ; ++node) {
+        std::ifstream is(("/sys/devices/system/node/node" + std::to_string(node)
+                          + "/cpulist").c_str());
+        std::string   list;
+
+        if (!(is >> list))
+            break;
+
+        assign_numa_node(list, node);
+    }
+}
+
+void update_placement(Caliper* c, int cpu) {
+    t_cpu = cpu;
+
+    if (cpu < 0 || cpu >= static_cast<int>(cpu_socket.size()))
+        return;
+
+    c->set(cpu_attr,    Variant(cpu));
+    c->set(socket_attr, Variant(cpu_socket[cpu]));
+    c->set(numa_attr,   Variant(cpu_numa[cpu]));
+}
+
+void create_scope_cb(Caliper* c, cali_context_scope_t scope) {
+    if (scope == CALI_SCOPE_THREAD)
+        update_placement(c, sched_getcpu());
+}
+
+void post_init_cb(Caliper* c) {
+    // the initial thread's scope exists before service registration
+    update_placement(c, sched_getcpu());
+}
+
+void snapshot_cb(Caliper* c, int, const SnapshotRecord*, SnapshotRecord*) {
+    // sample sched_getcpu() every Nth snapshot to catch migration
+    if (++t_snapshot % check_interval)
+        return;
+
+    int cpu = sched_getcpu();
+
+    if (cpu != t_cpu)
+        update_placement(c, cpu);
+}
+
+void topology_register(Caliper* c)
+{
+    config = RuntimeConfig::init("topology", s_configdata);
+
+    check_interval = config.get("check_interval").to_uint();
+
+    read_topology();
+
+    // Placement attributes are reference entries, so they cost nothing
+    // per snapshot and work as aggregation keys for per-socket or
+    // per-node profiles.
+
+    cpu_attr =
+        c->create_attribute("topology.cpu", CALI_TYPE_INT,
+                            CALI_ATTR_SCOPE_THREAD | CALI_ATTR_SKIP_EVENTS);
+    socket_attr =
+        c->create_attribute("topology.socket", CALI_TYPE_INT,
+                            CALI_ATTR_SCOPE_THREAD | CALI_ATTR_SKIP_EVENTS);
+    numa_attr =
+        c->create_attribute("topology.numanode", CALI_TYPE_INT,
+                            CALI_ATTR_SCOPE_THREAD | CALI_ATTR_SKIP_EVENTS);
+
+    c->events().post_init_evt.connect(post_init_cb);
+    c->events().create_scope_evt.connect(create_scope_cb);
+
+    if (check_interval > 0)
+        c->events().snapshot.connect(snapshot_cb);
+
+    Log(1).stream() << "Registered topology service" << endl;
+}
+
+} // namespace
+
+namespace cali
+{
+    CaliperService topology_service = { "topology", ::topology_register };
+} // namespace cali
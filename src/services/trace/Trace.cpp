@@ -40,17 +40,35 @@
 #include "caliper/Caliper.h"
 #include "caliper/SnapshotRecord.h"
 
+#include "caliper/common/FlushExecutor.h"
+#include "caliper/common/Health.h"
 #include "caliper/common/Log.h"
+#include "caliper/common/MemoryBudget.h"
+#include "caliper/common/Node.h"
 #include "caliper/common/RuntimeConfig.h"
 
+#include "caliper/common/binary/BinarySpec.h"
+
+#include "caliper/common/csv/CsvWriter.h"
+
 #include "caliper/common/util/spinlock.hpp"
+#include "caliper/common/util/split.hpp"
 
 #include <pthread.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <iterator>
+#include <condition_variable>
 #include <cstring>
+#include <fstream>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 using namespace trace;
 using namespace cali;
@@ -70,8 +88,22 @@ namespace
         TraceBuffer*       next;
         TraceBuffer*       prev;
 
+        // size of the next chunk allocated for this thread; fixed to
+        // the configured buffer size unless adaptive sizing is on
+        size_t             chunksize;
+
+        // per-thread output file, used only in per_thread_files mode
+        std::ofstream      stream;
+        CsvWriter          writer;
+
+        // content hash of the last saved snapshot and number of
+        // suppressed duplicates since, used only in dedup mode
+        uint64_t           last_hash;
+        uint64_t           repeat;
+
         TraceBuffer(size_t s)
-            : stopped(false), retired(false), chunks(new TraceBufferChunk(s)), next(0), prev(0)
+            : stopped(false), retired(false), chunks(new TraceBufferChunk(s)), next(0), prev(0),
+              chunksize(s), last_hash(0), repeat(0)
             { }
         
         ~TraceBuffer() {
@@ -90,6 +122,21 @@ namespace
         { "buffer_size",   CALI_TYPE_UINT, "2",
           "Size of initial per-thread trace buffer in MiB",
           "Size of initial per-thread trace buffer in MiB" },
+        { "adaptive", CALI_TYPE_BOOL, "false",
+          "Adapt per-thread trace buffer sizes to observed usage",
+          "Adapt per-thread trace buffer sizes to the observed"
+          "snapshot rate: buffers start at buffer_size_min, grow"
+          "geometrically up to buffer_size_max while a thread keeps"
+          "filling them, and shrink back towards the bytes a thread"
+          "actually used when its buffers are flushed. Avoids wasting"
+          "memory on identically sized buffers for mostly-idle"
+          "threads." },
+        { "buffer_size_min", CALI_TYPE_UINT, "64",
+          "Minimum adaptive trace buffer size in KiB",
+          "Minimum adaptive trace buffer size in KiB" },
+        { "buffer_size_max", CALI_TYPE_UINT, "8",
+          "Maximum adaptive trace buffer size in MiB",
+          "Maximum adaptive trace buffer size in MiB" },
         { "buffer_policy", CALI_TYPE_STRING, "grow",
           "What to do when trace buffer is full",
           "What to do when trace buffer is full:\n"
@@ -97,7 +144,67 @@ namespace
           "   grow:   Increase buffer size\n"
           "   stop:   Stop recording.\n"
           "Default: grow" },
-        
+        { "async_flush", CALI_TYPE_BOOL, "false",
+          "Drain trace buffers to output from a background thread",
+          "Drain trace buffers to output from a background thread"
+          "while the application runs, so long-running jobs don't"
+          "accumulate the full trace in memory. Annotation threads"
+          "hand full buffers to the flush thread and never block on I/O." },
+        { "async_flush_interval", CALI_TYPE_UINT, "1000",
+          "Flush interval of the background flush thread in milliseconds",
+          "Flush interval of the background flush thread in milliseconds" },
+        { "sampling_interval", CALI_TYPE_UINT, "0",
+          "Statistical trace mode: keep only every N-th snapshot",
+          "Statistical trace mode: keep only every N-th snapshot, plus"
+          "all snapshots whose duration exceeds an adaptive"
+          "per-trigger-attribute threshold (outliers). The sampling"
+          "factor is recorded in the stream (trace.sampling.factor)"
+          "so that readers can rescale counts. 0: keep all snapshots." },
+        { "outlier_factor", CALI_TYPE_UINT, "4",
+          "Duration outlier threshold for statistical trace mode",
+          "In statistical trace mode, always keep snapshots whose"
+          "duration exceeds this multiple of the running average"
+          "duration for their trigger attribute." },
+        { "duration_attribute", CALI_TYPE_STRING, "time.inclusive.duration",
+          "Duration attribute for statistical trace mode",
+          "Attribute used for outlier detection in statistical trace"
+          "mode, e.g. time.inclusive.duration from the timestamp"
+          "service." },
+        { "channel", CALI_TYPE_STRING, "",
+          "Snapshot channel to subscribe to",
+          "Subscribe to the given snapshot channel instead of the"
+          "global snapshot stream. The channel's trigger filter"
+          "(CALI_CHANNEL_<NAME>_TRIGGER) selects which snapshots"
+          "this service receives." },
+        { "dedup", CALI_TYPE_BOOL, "false",
+          "Run-length encode consecutive identical snapshots",
+          "Run-length encode consecutive identical snapshots: when a"
+          "snapshot's content (ignoring timestamp attributes) matches"
+          "the previous snapshot on the same thread, suppress it and"
+          "count repeats instead. The repeat count is recorded on the"
+          "next differing snapshot (trace.dedup.count)." },
+        { "dedup_skip_attributes", CALI_TYPE_STRING,
+          "time.duration:time.inclusive.duration:time.offset:time.timestamp",
+          "Attributes ignored by snapshot deduplication",
+          "Colon-separated list of attributes ignored when comparing"
+          "snapshots for deduplication. Timestamps differ between"
+          "otherwise identical snapshots and are skipped by default." },
+        { "isolate_memory", CALI_TYPE_BOOL, "false",
+          "Keep trace buffer memory out of the application's caches",
+          "Keep trace buffer memory out of the application's caches:"
+          "snapshots are encoded on the stack and copied into the"
+          "trace buffer with non-temporal stores, and filled chunks"
+          "are advised cold to the OS until they are flushed. Reduces"
+          "the observer effect on cache-sensitive applications at a"
+          "small recording overhead." },
+        { "per_thread_files", CALI_TYPE_BOOL, "false",
+          "Write one trace output file per thread",
+          "Write one trace output file per thread instead of funneling"
+          "all buffers through the recorder output stream. Each thread's"
+          "buffers are drained by a separate worker thread at flush, so"
+          "flush runs in parallel. The files are self-contained and can"
+          "be read or merged with cali-query." },
+
         ConfigSet::Terminator
     };
     
@@ -106,6 +213,12 @@ namespace
     BufferPolicy   policy            = BufferPolicy::Grow;
     size_t         buffersize        = 2 * 1024 * 1024;
 
+    // --- adaptive buffer sizing state
+
+    bool           adaptive          = false;
+    size_t         buffersize_min    = 64 * 1024;
+    size_t         buffersize_max    = 8 * 1024 * 1024;
+
     size_t         dropped_snapshots = 0;
     
     pthread_key_t  trace_buf_key;
@@ -114,7 +227,58 @@ namespace
     util::spinlock global_tbuf_lock;
 
     std::mutex     global_flush_lock;
-    
+
+    // --- async flush thread state
+
+    bool           async_flush       = false;
+    unsigned       async_interval    = 1000;
+
+    // --- statistical trace mode state
+
+    unsigned       sampling_interval = 0;
+    unsigned       outlier_factor    = 4;
+    std::string    duration_attr_name;
+
+    cali_id_t      duration_attr_id  = CALI_INV_ID;
+    cali_id_t      end_evt_attr_id   = CALI_INV_ID;
+
+    std::atomic<unsigned> snapshot_num;
+
+    size_t         sampled_out       = 0;
+
+    struct DurationStat {
+        uint64_t count;
+        uint64_t sum;
+    };
+
+    std::unordered_map<cali_id_t, DurationStat> duration_stats;
+    util::spinlock duration_stats_lock;
+
+    // --- dedup (run-length encoding) state
+
+    bool           dedup             = false;
+    bool           dedup_skip_resolved = false;
+
+    std::vector<std::string> dedup_skip_names;
+    std::vector<cali_id_t>   dedup_skip_attrs;
+
+    Attribute      dedup_count_attr { Attribute::invalid };
+
+    std::atomic<size_t> deduplicated_snapshots;
+
+    // --- per-thread output file state
+
+    bool             per_thread_files = false;
+    std::string      file_basename;
+    std::atomic<int> file_index;
+
+    std::thread             flush_thread;
+    std::mutex              flush_thread_lock;
+    std::condition_variable flush_thread_cv;
+    bool                    flush_thread_wakeup = false;
+    std::atomic<bool>       flush_thread_stop;
+
+
 
     void destroy_tbuf(void* ctx) {
         TraceBuffer* tbuf = static_cast<TraceBuffer*>(ctx);
@@ -129,7 +293,9 @@ namespace
         TraceBuffer* tbuf = static_cast<TraceBuffer*>(pthread_getspecific(trace_buf_key));
 
         if (alloc && !tbuf) {
-            tbuf = new TraceBuffer(buffersize);
+            // adaptive mode: start small, busy threads grow their
+            // buffers geometrically at overflow
+            tbuf = new TraceBuffer(adaptive ? buffersize_min : buffersize);
 
             if (!tbuf) {
                 Log(0).stream() << "trace: error: unable to  allocate trace buffer!" << endl;
@@ -155,6 +321,39 @@ namespace
         return tbuf;
     }
 
+    void request_async_flush() {
+        {
+            std::lock_guard<std::mutex>
+                g(flush_thread_lock);
+
+            flush_thread_wakeup = true;
+        }
+
+        flush_thread_cv.notify_one();
+    }
+
+    void flush_thread_fn() {
+        while (!flush_thread_stop.load()) {
+            {
+                std::unique_lock<std::mutex>
+                    g(flush_thread_lock);
+
+                flush_thread_cv.wait_for(g, std::chrono::milliseconds(async_interval),
+                                         [] { return flush_thread_wakeup || flush_thread_stop.load(); });
+
+                flush_thread_wakeup = false;
+            }
+
+            if (flush_thread_stop.load())
+                break;
+
+            Caliper c = Caliper::instance();
+
+            if (c)
+                c.flush_and_write(nullptr);
+        }
+    }
+
     TraceBuffer* handle_overflow(Caliper* c, TraceBuffer* tbuf) {
         switch (policy) {
         case BufferPolicy::Stop:
@@ -164,17 +363,45 @@ namespace
                 
         case BufferPolicy::Grow:
         {
-            TraceBufferChunk* newchunk = new TraceBufferChunk(buffersize);
+            // Degrade under the global memory budget: near the
+            // watermark, drain the buffers instead of growing them;
+            // once the budget is exhausted, stop recording
+            if (MemoryBudget::exceeded()) {
+                tbuf->stopped.store(true);
+                Log(1).stream() << "Trace: memory budget exhausted: recording stopped." << endl;
+                return 0;
+            }
+            if (MemoryBudget::over_watermark()) {
+                if (async_flush) {
+                    request_async_flush();
+                } else if (!c->is_signal()) {
+                    Log(1).stream() << "Trace: memory budget watermark reached: flushing." << endl;
+                    c->flush_and_write(nullptr);
+                    return tbuf;
+                }
+            }
+
+            if (adaptive)
+                tbuf->chunksize = std::min(2 * tbuf->chunksize, buffersize_max);
+
+            TraceBufferChunk* newchunk = new TraceBufferChunk(tbuf->chunksize);
 
             if (!newchunk) {
                 Log(0).stream() << "trace: error: unable to allocate new trace buffer. Recording stopped." << endl;
                 tbuf->stopped.store(true);
                 return 0;
             }
-            
+
+            // the filled chunk won't be touched again until flush
+            tbuf->chunks->mark_cold();
+
             newchunk->append(tbuf->chunks);
             tbuf->chunks = newchunk;
 
+            // in async mode, ask the flush thread to drain the buffers
+            if (async_flush)
+                request_async_flush();
+
             return tbuf;
         }
             
@@ -192,72 +419,355 @@ namespace
         return 0;
     }
     
+    // Statistical trace mode: keep every N-th snapshot, plus all
+    // snapshots whose duration is an outlier for their trigger
+    // attribute
+    bool keep_snapshot(Caliper* c, const SnapshotRecord* sbuf) {
+        if (snapshot_num++ % sampling_interval == 0)
+            return true;
+
+        // Off-stride snapshots are kept if their duration exceeds
+        // outlier_factor times the running average duration for their
+        // trigger attribute. Skip the check in signal context: the
+        // statistics map may allocate.
+
+        if (c->is_signal())
+            return false;
+
+        if (duration_attr_id == CALI_INV_ID) {
+            Attribute attr = c->get_attribute(duration_attr_name);
+
+            if (attr == Attribute::invalid)
+                return false;
+
+            duration_attr_id = attr.id();
+        }
+        if (end_evt_attr_id == CALI_INV_ID) {
+            Attribute attr = c->get_attribute("cali.event.end");
+
+            if (attr == Attribute::invalid)
+                return false;
+
+            end_evt_attr_id = attr.id();
+        }
+
+        SnapshotRecord::Data   data = sbuf->data();
+        SnapshotRecord::Sizes sizes = sbuf->size();
+
+        Variant v_duration;
+        Variant v_trigger;
+
+        for (size_t i = 0; i < sizes.n_immediate; ++i) {
+            if (data.immediate_attr[i] == duration_attr_id)
+                v_duration = data.immediate_data[i];
+            else if (data.immediate_attr[i] == end_evt_attr_id)
+                v_trigger  = data.immediate_data[i];
+        }
+
+        if (v_duration.empty() || v_trigger.empty())
+            return false;
+
+        uint64_t duration = v_duration.to_uint();
+
+        std::lock_guard<util::spinlock>
+            g(duration_stats_lock);
+
+        DurationStat& stat = duration_stats[v_trigger.to_uint()];
+
+        ++stat.count;
+        stat.sum += duration;
+
+        return duration * stat.count > outlier_factor * stat.sum;
+    }
+
+    // Look up the ids of the attributes excluded from the dedup
+    // content hash. Unresolved slots stay CALI_INV_ID; writes are
+    // idempotent, so concurrent resolution is benign.
+    void resolve_dedup_skip_attributes(Caliper* c) {
+        bool all_resolved = true;
+
+        for (size_t i = 0; i < dedup_skip_names.size(); ++i) {
+            if (dedup_skip_attrs[i] != CALI_INV_ID)
+                continue;
+
+            Attribute attr = c->get_attribute(dedup_skip_names[i]);
+
+            if (attr == Attribute::invalid)
+                all_resolved = false;
+            else
+                dedup_skip_attrs[i] = attr.id();
+        }
+
+        dedup_skip_resolved = all_resolved;
+    }
+
+    inline uint64_t hash_bytes(uint64_t h, const void* ptr, size_t len) {
+        const unsigned char* p = static_cast<const unsigned char*>(ptr);
+
+        // FNV-1a
+        for (size_t i = 0; i < len; ++i) {
+            h ^= p[i];
+            h *= 0x100000001b3;
+        }
+
+        return h;
+    }
+
+    // Hash a snapshot's content, skipping the timestamp attributes
+    // that differ between otherwise identical snapshots
+    uint64_t snapshot_hash(const SnapshotRecord* sbuf) {
+        SnapshotRecord::Data   data  = sbuf->data();
+        SnapshotRecord::Sizes  sizes = sbuf->size();
+
+        uint64_t h = 0xcbf29ce484222325;
+
+        for (size_t i = 0; i < sizes.n_nodes; ++i) {
+            cali_id_t id = data.node_entries[i]->id();
+
+            h = hash_bytes(h, &id, sizeof(id));
+        }
+
+        for (size_t i = 0; i < sizes.n_immediate; ++i) {
+            cali_id_t attr = data.immediate_attr[i];
+
+            if (std::find(dedup_skip_attrs.begin(), dedup_skip_attrs.end(), attr) != dedup_skip_attrs.end())
+                continue;
+
+            const Variant& v = data.immediate_data[i];
+            cali_attr_type t = v.type();
+
+            h = hash_bytes(h, &attr,    sizeof(attr));
+            h = hash_bytes(h, &t,       sizeof(t));
+            h = hash_bytes(h, v.data(), v.size());
+        }
+
+        return h;
+    }
+
     void process_snapshot_cb(Caliper* c, const SnapshotRecord*, const SnapshotRecord* sbuf) {
+        if (sampling_interval > 0 && !keep_snapshot(c, sbuf)) {
+            ++sampled_out;
+            return;
+        }
+
         TraceBuffer* tbuf = acquire_tbuf(!c->is_signal());
 
         if (!tbuf || tbuf->stopped.load()) { // error messaging is done in acquire_tbuf()
             ++dropped_snapshots;
+            Health::inc(Health::DroppedSnapshots);
             return;
         }
-        
-        if (!tbuf->chunks->fits(sbuf))
+
+        const SnapshotRecord* out = sbuf;
+
+        SnapshotRecord::FixedSnapshotRecord<80> count_rec_data;
+        SnapshotRecord count_rec(count_rec_data);
+
+        if (dedup) {
+            if (!dedup_skip_resolved && !c->is_signal())
+                resolve_dedup_skip_attributes(c);
+
+            uint64_t hash = snapshot_hash(sbuf);
+
+            if (hash == tbuf->last_hash) {
+                // identical to the previous snapshot on this thread:
+                // suppress it and count the repeat
+                ++tbuf->repeat;
+                ++deduplicated_snapshots;
+                return;
+            }
+
+            tbuf->last_hash = hash;
+
+            if (tbuf->repeat > 0) {
+                // record the preceding record's repeat count on this
+                // snapshot so that readers can re-expand the run
+                count_rec.append(*sbuf);
+                count_rec.append(dedup_count_attr.id(), Variant(tbuf->repeat));
+
+                tbuf->repeat = 0;
+
+                out = &count_rec;
+            }
+        }
+
+        if (!tbuf->chunks->fits(out))
             tbuf = handle_overflow(c, tbuf);
         if (!tbuf)
             return;
 
-        tbuf->chunks->save_snapshot(sbuf);
-    }        
+        tbuf->chunks->save_snapshot(c, out);
+    }
+
+    // Adaptive mode: size a thread's next chunk to the bytes it used
+    // since the last flush, geometrically between the configured
+    // minimum and maximum. Quiescent threads shrink back towards the
+    // minimum, busy threads keep their grown buffers.
+    size_t next_chunk_size(size_t used) {
+        size_t s = buffersize_min;
+
+        while (s < used && s < buffersize_max)
+            s *= 2;
+
+        return std::min(s, buffersize_max);
+    }
+
+    // chunk lists detached in the previous flush pass, kept for one
+    // pass as a grace period for late in-flight writers
+    std::vector<TraceBufferChunk*> graveyard;
+
+    bool init_tbuf_writer(TraceBuffer* tbuf) {
+        if (tbuf->stream.is_open())
+            return true;
+
+        std::string filename =
+            file_basename + "_t" + std::to_string(file_index++) + ".cali";
+
+        tbuf->stream.open(filename);
+
+        if (!tbuf->stream) {
+            Log(0).stream() << "trace: error: could not open trace file "
+                            << filename << endl;
+            return false;
+        }
+
+        tbuf->writer = CsvWriter(tbuf->stream);
+
+        Log(2).stream() << "Trace: writing thread trace to " << filename << endl;
+
+        return true;
+    }
+
+    size_t flush_tbuf_to_file(Caliper* c, TraceBuffer* tbuf, TraceBufferChunk* chunks) {
+        // don't create files for threads that haven't recorded anything
+        if (chunks->info().used == 0)
+            return 0;
+
+        if (!init_tbuf_writer(tbuf))
+            return 0;
+
+        size_t n = chunks->flush(c, [c,tbuf](const SnapshotRecord* s) {
+                SnapshotRecord::Data   data = s->data();
+                SnapshotRecord::Sizes sizes = s->size();
+
+                cali_id_t node_ids[128];
+                size_t    nn = std::min<size_t>(sizes.n_nodes, 128);
+
+                for (size_t i = 0; i < nn; ++i)
+                    node_ids[i] = data.node_entries[i]->id();
+
+                tbuf->writer.write_snapshot(*c, nn, node_ids,
+                                            sizes.n_immediate, data.immediate_attr, data.immediate_data);
+
+                return true;
+            });
+
+        // write out buffered records so the file is complete after each pass
+        tbuf->writer.flush();
+
+        return n;
+    }
 
     void flush_cb(Caliper* c, const SnapshotRecord*, Caliper::SnapshotFlushFn proc_fn) {
         std::lock_guard<std::mutex>
             g(global_flush_lock);
 
+        for (TraceBufferChunk* chunk : graveyard)
+            delete chunk;
+
+        graveyard.clear();
+
         TraceBuffer* tbuf = nullptr;
-        
+
         {
             std::lock_guard<util::spinlock>
                 g(global_tbuf_lock);
-            
+
             tbuf = global_tbuf_list;
         }
 
         size_t num_written = 0;
 
         TraceBufferChunk::UsageInfo aggregate_info { 0, 0, 0 };
-        
-        while (tbuf) {
-            // Stop tracing while we flush: writers won't block
-            // but just drop the snapshot
-            
+
+        std::vector<TraceBuffer*>      flush_bufs;
+        std::vector<TraceBufferChunk*> flush_chunks;
+
+        for ( ; tbuf; tbuf = tbuf->next) {
+            // Detach the buffer's chunk list and hand the writer a fresh
+            // chunk: the writer is only stopped for the pointer swap,
+            // never for the flush I/O (double buffering)
+
             tbuf->stopped.store(true);
 
-            // Accumulate usage statistics before they're reset in flush
+            TraceBufferChunk* detached = tbuf->chunks;
+
+            if (adaptive)
+                tbuf->chunksize = next_chunk_size(detached->info().used);
+
+            tbuf->chunks = new TraceBufferChunk(tbuf->chunksize);
+            tbuf->stopped.store(false);
+
+            // Accumulate usage statistics
             if (Log::verbosity() > 1) {
-                TraceBufferChunk::UsageInfo info = tbuf->chunks->info();
+                TraceBufferChunk::UsageInfo info = detached->info();
 
                 aggregate_info.nchunks  += info.nchunks;
                 aggregate_info.reserved += info.reserved;
                 aggregate_info.used     += info.used;
             }
-            
-            num_written += tbuf->chunks->flush(c, proc_fn);
-            tbuf->stopped.store(false);
-            
-            if (tbuf->retired.load()) {
-                // delete retired thread's trace buffer                
-                TraceBuffer* tmp = tbuf->next;
 
+            flush_bufs.push_back(tbuf);
+            flush_chunks.push_back(detached);
+        }
+
+        if (per_thread_files) {
+            // Drain each thread's buffers into its own file. The
+            // per-file drain tasks run on the shared flush pool
+            // (CALI_FLUSH_THREADS), so the number of concurrent file
+            // writers stays bounded regardless of the thread count.
+
+            std::vector<FlushExecutor::Task> tasks;
+            std::atomic<size_t>              worker_written { 0 };
+
+            for (size_t i = 0; i < flush_bufs.size(); ++i)
+                tasks.push_back([c,&worker_written,&flush_bufs,&flush_chunks,i]{
+                        worker_written += flush_tbuf_to_file(c, flush_bufs[i], flush_chunks[i]);
+                    });
+
+            FlushExecutor::run(tasks);
+
+            num_written = worker_written.load();
+        } else if (!c->events().write_blob_evt.empty()) {
+            // Zero-copy flush: hand the encoded chunks to the blob sink
+            // verbatim instead of decoding and re-encoding every snapshot
+
+            for (size_t i = 0; i < flush_chunks.size(); ++i)
+                num_written += flush_chunks[i]->flush_raw(
+                    [c](size_t nrec, const unsigned char* data, size_t len){
+                        c->events().write_blob_evt(c, binary::spec_trace_block, nrec, data, len);
+                    });
+        } else {
+            for (size_t i = 0; i < flush_chunks.size(); ++i)
+                num_written += flush_chunks[i]->flush(c, proc_fn);
+        }
+
+        for (size_t i = 0; i < flush_bufs.size(); ++i) {
+            graveyard.push_back(flush_chunks[i]);
+
+            if (flush_bufs[i]->retired.load()) {
+                // delete retired thread's trace buffer
                 {
                     std::lock_guard<util::spinlock>
                         g(global_tbuf_lock);
-                
-                    tbuf->unlink();
+
+                    if (global_tbuf_list == flush_bufs[i])
+                        global_tbuf_list =  flush_bufs[i]->next;
+
+                    flush_bufs[i]->unlink();
                 }
-                
-                delete tbuf;
-                tbuf = tmp;
-            } else {
-                tbuf = tbuf->next;
+
+                delete flush_bufs[i];
             }
         }
 
@@ -293,13 +803,31 @@ namespace
     }
 
     void finish_cb(Caliper* c) {
+        if (flush_thread.joinable()) {
+            flush_thread_stop.store(true);
+            flush_thread_cv.notify_one();
+            flush_thread.join();
+        }
+
+        for (TraceBufferChunk* chunk : graveyard)
+            delete chunk;
+
+        graveyard.clear();
+
         if (dropped_snapshots > 0)
             Log(1).stream() << "Trace: dropped " << dropped_snapshots << " snapshots." << endl;
+        if (sampled_out > 0)
+            Log(1).stream() << "Trace: statistical trace mode sampled out "
+                            << sampled_out << " snapshots." << endl;
+        if (deduplicated_snapshots.load() > 0)
+            Log(1).stream() << "Trace: deduplicated "
+                            << deduplicated_snapshots.load() << " snapshots." << endl;
     }
     
     void trace_register(Caliper* c) {
         global_tbuf_lock.unlock();
         global_flush_lock.unlock();
+        duration_stats_lock.unlock();
         
         config = RuntimeConfig::init("trace", configdata);
         dropped_snapshots = 0;
@@ -307,20 +835,111 @@ namespace
         init_overflow_policy();
         
         buffersize = config.get("buffer_size").to_uint() * 1024 * 1024;
-        
+
+        adaptive       = config.get("adaptive").to_bool();
+        buffersize_min = config.get("buffer_size_min").to_uint() * 1024;
+        buffersize_max = config.get("buffer_size_max").to_uint() * 1024 * 1024;
+
+        if (adaptive) {
+            buffersize_min = std::max<size_t>(buffersize_min, 4096);
+            buffersize_max = std::max(buffersize_max, buffersize_min);
+
+            Log(1).stream() << "Trace: adaptive buffer sizing enabled ("
+                            << buffersize_min << " - " << buffersize_max
+                            << " bytes)" << endl;
+        }
+
         if (pthread_key_create(&trace_buf_key, destroy_tbuf) != 0) {
             Log(0).stream() << "trace: error: pthread_key_create() failed" << endl;
             return;
         }        
         
+        std::string channel = config.get("channel").to_string();
+
         c->events().create_scope_evt.connect(&create_scope_cb);
-        c->events().process_snapshot.connect(&process_snapshot_cb);
+
+        if (channel.empty())
+            c->events().process_snapshot.connect(&process_snapshot_cb);
+        else
+            c->channel(channel.c_str())->process_snapshot.connect(&process_snapshot_cb);
+
         c->events().flush_evt.connect(&flush_cb);
         c->events().finish_evt.connect(&finish_cb);
 
         // Initialize trace buffer on master thread
         acquire_tbuf(true);
-        
+
+        async_flush    = config.get("async_flush").to_bool();
+        async_interval = config.get("async_flush_interval").to_uint();
+
+        sampling_interval  = config.get("sampling_interval").to_uint();
+        outlier_factor     = config.get("outlier_factor").to_uint();
+        duration_attr_name = config.get("duration_attribute").to_string();
+
+        snapshot_num.store(0);
+        sampled_out = 0;
+
+        if (sampling_interval > 0) {
+            // record the sampling factor in the stream so that readers
+            // can rescale counts
+            Attribute factor_attr =
+                c->create_attribute("trace.sampling.factor",
+                                    CALI_TYPE_UINT,
+                                    CALI_ATTR_ASVALUE     |
+                                    CALI_ATTR_SKIP_EVENTS |
+                                    CALI_ATTR_SCOPE_PROCESS);
+
+            c->set(factor_attr, Variant(static_cast<uint64_t>(sampling_interval)));
+
+            Log(1).stream() << "Trace: statistical trace mode enabled, keeping every "
+                            << sampling_interval << "-th snapshot" << endl;
+        }
+
+        dedup = config.get("dedup").to_bool();
+        deduplicated_snapshots.store(0);
+
+        if (dedup) {
+            dedup_skip_names.clear();
+            util::split(config.get("dedup_skip_attributes").to_string(), ':',
+                        back_inserter(dedup_skip_names));
+
+            dedup_skip_attrs.assign(dedup_skip_names.size(), CALI_INV_ID);
+            dedup_skip_resolved = dedup_skip_names.empty();
+
+            dedup_count_attr =
+                c->create_attribute("trace.dedup.count",
+                                    CALI_TYPE_UINT,
+                                    CALI_ATTR_ASVALUE |
+                                    CALI_ATTR_SKIP_EVENTS);
+
+            Log(1).stream() << "Trace: snapshot deduplication enabled" << endl;
+        }
+
+        bool isolate_memory = config.get("isolate_memory").to_bool();
+
+        TraceBufferChunk::set_memory_isolation(isolate_memory);
+
+        if (isolate_memory)
+            Log(1).stream() << "Trace: measurement-memory isolation enabled" << endl;
+
+        per_thread_files = config.get("per_thread_files").to_bool();
+
+        if (per_thread_files) {
+            char   timestring[16];
+            time_t tm = chrono::system_clock::to_time_t(chrono::system_clock::now());
+            strftime(timestring, sizeof(timestring), "%y%m%d-%H%M%S", localtime(&tm));
+
+            file_basename = string(timestring) + "_" + std::to_string(getpid());
+            file_index.store(0);
+        }
+
+        if (async_flush) {
+            flush_thread_stop.store(false);
+            flush_thread = std::thread(flush_thread_fn);
+
+            Log(1).stream() << "Trace: starting async flush thread" << endl;
+        }
+
         Log(1).stream() << "Registered trace service" << endl;
     }
     
@@ -42,16 +42,66 @@
 
 #include "caliper/common/c-util/vlenc.h"
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <cstdint>
+#include <vector>
+
 #define SNAP_MAX 80
 
 using namespace trace;
 using namespace cali;
 
+bool TraceBufferChunk::s_isolate = false;
+
+namespace
+{
+
+// Copy an encoded record into the trace buffer with non-temporal
+// stores where possible, so filling the buffer does not pull its
+// cache lines in and evict application data. Unaligned head and tail
+// bytes use regular stores.
+inline void nt_copy(unsigned char* dst, const unsigned char* src, size_t len)
+{
+#if defined(__SSE2__)
+    size_t i = 0;
+
+    for ( ; i < len && (reinterpret_cast<uintptr_t>(dst + i) % 16) != 0; ++i)
+        dst[i] = src[i];
+
+    for ( ; i + 16 <= len; i += 16) {
+        __m128i v;
+
+        memcpy(&v, src + i, 16);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+
+    for ( ; i < len; ++i)
+        dst[i] = src[i];
+
+    // make the streamed stores visible to the flush thread
+    _mm_sfence();
+#else
+    memcpy(dst, src, len);
+#endif
+}
+
+} // namespace
+
 
 TraceBufferChunk::~TraceBufferChunk()
 {
     delete[] m_data;
 
+    cali::MemoryBudget::sub(cali::MemoryBudget::Trace, m_size);
+
     if (m_next)
         delete m_next;
 }
@@ -70,7 +120,10 @@ void TraceBufferChunk::reset()
 {
     m_pos  = 0;
     m_nrec = 0;
-            
+
+    m_shapes.clear();
+    m_prev_val.clear();
+
     memset(m_data, 0, m_size);
 }
 
@@ -83,35 +136,83 @@ size_t TraceBufferChunk::flush(Caliper* c, Caliper::SnapshotFlushFn proc_fn)
     // local flush
     //
 
+    // Records in the chunk are either shape definitions (tag 0) or
+    // snapshots (tag = shape id + 1); see save_snapshot()
+
+    struct ShapeDef {
+        int       n_nodes;
+        int       n_attr;
+        cali_id_t node_ids[SNAP_MAX];
+        cali_id_t attr_ids[SNAP_MAX];
+        bool      delta[SNAP_MAX];
+    };
+
+    std::vector<ShapeDef> shapes;
+
+    // previous value per delta-encoded attribute; mirrors the
+    // encoder's per-chunk state in save_snapshot()
+    std::unordered_map<cali_id_t, uint64_t> prev_val;
+
     size_t p = 0;
 
     for (size_t r = 0; r < m_nrec; ++r) {
+        uint64_t tag = vldec_u64(m_data + p, &p);
+
+        if (tag == 0) {
+            // decode shape definition record
+
+            shapes.push_back(ShapeDef());
+            ShapeDef& sh = shapes.back();
+
+            sh.n_nodes = static_cast<int>(std::min(static_cast<int>(vldec_u64(m_data + p, &p)), SNAP_MAX));
+            sh.n_attr  = static_cast<int>(std::min(static_cast<int>(vldec_u64(m_data + p, &p)), SNAP_MAX));
+
+            for (int i = 0; i < sh.n_nodes; ++i)
+                sh.node_ids[i] = vldec_u64(m_data + p, &p);
+            for (int i = 0; i < sh.n_attr;  ++i) {
+                // attribute id entry is 2*id + (1 if delta-encoded)
+                uint64_t u     = vldec_u64(m_data + p, &p);
+
+                sh.attr_ids[i] = u / 2;
+                sh.delta[i]    = ((u % 2) == 1);
+            }
+
+            continue;
+        }
+
         // decode snapshot record
-                
-        int n_nodes = static_cast<int>(std::min(static_cast<int>(vldec_u64(m_data + p, &p)), SNAP_MAX));
-        int n_attr  = static_cast<int>(std::min(static_cast<int>(vldec_u64(m_data + p, &p)), SNAP_MAX));
+
+        if (tag > shapes.size()) {
+            Log(0).stream() << "trace: error: invalid shape reference in trace buffer" << std::endl;
+            break;
+        }
+
+        const ShapeDef& sh = shapes[tag-1];
 
         SnapshotRecord::FixedSnapshotRecord<SNAP_MAX> snapshot_data;
         SnapshotRecord snapshot(snapshot_data);
 
-        cali_id_t attr[SNAP_MAX];
-        Variant   data[SNAP_MAX];
+        Variant data[SNAP_MAX];
 
-        for (int i = 0; i < n_nodes; ++i)
-            snapshot.append(c->node(vldec_u64(m_data + p, &p)));
-        for (int i = 0; i < n_attr;  ++i) 
-            attr[i] = vldec_u64(m_data + p, &p);
-        for (int i = 0; i < n_attr;  ++i)
-            data[i] = Variant::unpack(m_data + p, &p, nullptr);
+        for (int i = 0; i < sh.n_nodes; ++i)
+            snapshot.append(c->node(sh.node_ids[i]));
+        for (int i = 0; i < sh.n_attr;  ++i)
+            if (sh.delta[i]) {
+                uint64_t val = prev_val[sh.attr_ids[i]] + vldec_u64(m_data + p, &p);
 
-        snapshot.append(n_attr, attr, data);
+                prev_val[sh.attr_ids[i]] = val;
+                data[i] = Variant(val);
+            } else
+                data[i] = Variant::unpack(m_data + p, &p, nullptr);
 
-        // write snapshot                
+        snapshot.append(sh.n_attr, sh.attr_ids, data);
+
+        // write snapshot
 
         proc_fn(&snapshot);
+        ++written;
     }
 
-    written += m_nrec;            
     reset();
             
     //
@@ -128,7 +229,28 @@ size_t TraceBufferChunk::flush(Caliper* c, Caliper::SnapshotFlushFn proc_fn)
 }
 
 
-void TraceBufferChunk::save_snapshot(const SnapshotRecord* s)
+size_t TraceBufferChunk::flush_raw(const std::function<void(size_t, const unsigned char*, size_t)>& fn)
+{
+    size_t written = 0;
+
+    if (m_pos > 0) {
+        fn(m_nrec, m_data, m_pos);
+        written += m_nrec;
+    }
+
+    reset();
+
+    if (m_next) {
+        written += m_next->flush_raw(fn);
+        delete m_next;
+        m_next = 0;
+    }
+
+    return written;
+}
+
+
+void TraceBufferChunk::save_snapshot(Caliper* c, const SnapshotRecord* s)
 {
     SnapshotRecord::Sizes sizes = s->size();
 
@@ -137,20 +259,113 @@ void TraceBufferChunk::save_snapshot(const SnapshotRecord* s)
 
     sizes.n_nodes     = std::min<size_t>(sizes.n_nodes,     SNAP_MAX);
     sizes.n_immediate = std::min<size_t>(sizes.n_immediate, SNAP_MAX);
-                
-    m_pos += vlenc_u64(sizes.n_nodes,     m_data + m_pos);
-    m_pos += vlenc_u64(sizes.n_immediate, m_data + m_pos);
 
     SnapshotRecord::Data addr = s->data();
 
-    for (int i = 0; i < sizes.n_nodes; ++i)
-        m_pos += vlenc_u64(addr.node_entries[i]->id(), m_data + m_pos);
-    for (int i = 0; i < sizes.n_immediate;  ++i)
-        m_pos += vlenc_u64(addr.immediate_attr[i],     m_data + m_pos);
-    for (int i = 0; i < sizes.n_immediate;  ++i)
-        m_pos += addr.immediate_data[i].pack(m_data + m_pos);
+    // encode the snapshot's shape: node references and immediate
+    // entry attribute ids
+
+    unsigned char shape[20 + 20 * SNAP_MAX];
+    size_t        spos = 0;
+
+    spos += vlenc_u64(sizes.n_nodes,     shape + spos);
+    spos += vlenc_u64(sizes.n_immediate, shape + spos);
+
+    for (size_t i = 0; i < sizes.n_nodes; ++i)
+        spos += vlenc_u64(addr.node_entries[i]->id(), shape + spos);
+    for (size_t i = 0; i < sizes.n_immediate;  ++i)
+        spos += vlenc_u64(addr.immediate_attr[i],     shape + spos);
+
+    std::string key(reinterpret_cast<const char*>(shape), spos);
+
+    // In isolation mode, encode into an on-stack scratch buffer
+    // (which stays in L1) and copy the finished record into the chunk
+    // with non-temporal stores. The scratch covers the worst case
+    // fits() accounts for (shape definition plus snapshot record).
+
+    unsigned char  scratch[4096];
+    unsigned char* buf = s_isolate ? scratch : m_data + m_pos;
+    size_t         pos = 0;
+
+    auto it = m_shapes.find(key);
+
+    if (it == m_shapes.end()) {
+        // new shape: determine which entries to delta-encode, intern
+        // the shape, and append a shape definition record. In the
+        // record, attribute id entries are 2*id + (1 if delta-encoded).
+
+        ShapeInfo info;
+
+        info.id = m_shapes.size();
+        info.delta.assign(sizes.n_immediate, 0);
+
+        for (size_t i = 0; i < sizes.n_immediate; ++i) {
+            Attribute attr = c->get_attribute(addr.immediate_attr[i]);
+
+            if (attr.is_monotonic() && attr.type() == CALI_TYPE_UINT)
+                info.delta[i] = 1;
+        }
+
+        pos += vlenc_u64(0, buf + pos);
+
+        pos += vlenc_u64(sizes.n_nodes,     buf + pos);
+        pos += vlenc_u64(sizes.n_immediate, buf + pos);
+
+        for (size_t i = 0; i < sizes.n_nodes; ++i)
+            pos += vlenc_u64(addr.node_entries[i]->id(), buf + pos);
+        for (size_t i = 0; i < sizes.n_immediate;  ++i)
+            pos += vlenc_u64(2 * addr.immediate_attr[i] + info.delta[i], buf + pos);
+
+        ++m_nrec;
+
+        it = m_shapes.insert(std::make_pair(std::move(key), std::move(info))).first;
+    }
+
+    const ShapeInfo& info = it->second;
+
+    // append the snapshot record: shape reference and immediate values
+
+    pos += vlenc_u64(info.id + 1, buf + pos);
+
+    for (size_t i = 0; i < sizes.n_immediate;  ++i)
+        if (info.delta[i]) {
+            cali_id_t attr = addr.immediate_attr[i];
+            uint64_t  val  = addr.immediate_data[i].to_uint();
+
+            pos += vlenc_u64(val - m_prev_val[attr], buf + pos);
+            m_prev_val[attr] = val;
+        } else
+            pos += addr.immediate_data[i].pack(buf + pos);
 
     ++m_nrec;
+
+    if (s_isolate)
+        nt_copy(m_data + m_pos, scratch, pos);
+
+    m_pos += pos;
+}
+
+
+void TraceBufferChunk::set_memory_isolation(bool enable)
+{
+    s_isolate = enable;
+}
+
+
+void TraceBufferChunk::mark_cold()
+{
+    if (!s_isolate)
+        return;
+
+#if defined(__linux__) && defined(MADV_COLD)
+    // m_data is not page aligned: advise the fully covered pages only
+    uintptr_t pagesize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t beg = (reinterpret_cast<uintptr_t>(m_data) + pagesize - 1) & ~(pagesize - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(m_data) + m_size) & ~(pagesize - 1);
+
+    if (end > beg)
+        madvise(reinterpret_cast<void*>(beg), end - beg, MADV_COLD);
+#endif
 }
 
 
@@ -159,11 +374,13 @@ bool TraceBufferChunk::fits(const SnapshotRecord* s) const
     SnapshotRecord::Sizes sizes = s->size();
 
     // get worst-case estimate of packed snapshot size:
-    //   20 bytes for size indicators
-    //   10 bytes per node id
-    //   10+22 bytes per immediate entry (10 for attr, 22 for variant)
-            
-    size_t max = 20 + 10 * sizes.n_nodes + 32 * sizes.n_immediate;
+    //   a new shape definition (tag and two size indicators,
+    //     10 bytes per node id and immediate attribute id)
+    //   plus the snapshot record
+    //     (10 bytes for the shape reference, 25 bytes per value
+    //     incl. inline string data)
+
+    size_t max = 40 + 10 * sizes.n_nodes + 35 * sizes.n_immediate;
 
     return (m_pos + max) < m_size;
 }
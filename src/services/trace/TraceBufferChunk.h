@@ -37,7 +37,14 @@
 
 #include "caliper/Caliper.h"
 
+#include "caliper/common/MemoryBudget.h"
+
+#include <cstdint>
 #include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 
 namespace cali
@@ -48,20 +55,47 @@ namespace cali
 namespace trace
 {
 
+    /// \brief In-memory trace buffer with shape-dictionary encoding.
+    ///
+    /// Snapshots are stored as a shape (the node references and
+    /// immediate entry attribute ids) plus the immediate values. Each
+    /// distinct shape is interned once per chunk as an in-line shape
+    /// definition record; subsequent snapshots with the same shape
+    /// store only the shape reference and their immediate values.
+    /// Values of monotonic attributes (CALI_ATTR_MONOTONIC) are
+    /// stored as varint deltas to the attribute's previous value in
+    /// the chunk.
+
     class TraceBufferChunk {
         size_t            m_size;
         size_t            m_pos;
         size_t            m_nrec;
-        
+
         unsigned char*    m_data;
-        
+
         TraceBufferChunk* m_next;
 
+        struct ShapeInfo {
+            uint64_t          id;
+            std::vector<char> delta; // delta-encode flag per immediate entry
+        };
+
+        // encoded shape -> shape info of the shapes interned in this chunk
+        std::unordered_map<std::string, ShapeInfo> m_shapes;
+
+        // previous value per delta-encoded attribute in this chunk
+        std::unordered_map<cali_id_t, uint64_t>    m_prev_val;
+
+        // measurement-memory isolation mode (see set_memory_isolation())
+        static bool s_isolate;
+
     public:
 
         TraceBufferChunk(size_t s)
             : m_size(s), m_pos(0), m_nrec(0), m_data(new unsigned char[s]), m_next(0)
-            { }
+            {
+                cali::MemoryBudget::add(cali::MemoryBudget::Trace, s);
+            }
 
         ~TraceBufferChunk();
 
@@ -70,9 +104,31 @@ namespace trace
 
         size_t flush(cali::Caliper* c, cali::Caliper::SnapshotFlushFn proc_fn);
 
-        void   save_snapshot(const cali::SnapshotRecord* s);
+        /// \brief Hand each chunk's encoded contents to \a fn verbatim
+        ///   and reset the chunks (zero-copy flush path).
+        ///
+        /// The chunk encoding is the binary .cali trace block payload;
+        /// see BinarySpec.h. Returns the number of records (shape
+        /// definitions and snapshots) handed out.
+        size_t flush_raw(const std::function<void(size_t nrec, const unsigned char* data, size_t len)>& fn);
+
+        void   save_snapshot(cali::Caliper* c, const cali::SnapshotRecord* s);
         bool   fits(const cali::SnapshotRecord* s) const;
 
+        /// \brief Enable or disable measurement-memory isolation.
+        ///
+        /// With isolation on, save_snapshot() encodes records on the
+        /// stack and copies them into the chunk with non-temporal
+        /// stores, and mark_cold() advises the OS to deprioritize
+        /// filled chunks, so the write-mostly trace memory does not
+        /// displace the application's working set from the caches.
+        static void set_memory_isolation(bool enable);
+
+        /// \brief Hint to the OS that this chunk's memory will not be
+        ///   touched again until flush. No-op unless memory isolation
+        ///   is enabled.
+        void   mark_cold();
+
         struct UsageInfo {
             size_t nchunks;
             size_t reserved;
@@ -39,6 +39,7 @@
 #include "caliper/SnapshotRecord.h"
 
 #include "caliper/common/Log.h"
+#include "caliper/common/RuntimeConfig.h"
 
 #include <atomic>
 #include <iostream>
@@ -280,8 +281,168 @@ void end_cb(Caliper* c, const Attribute& attr, const Variant& value)
     }
 }
 
-void validator_register(Caliper* c) 
+//
+// --- Sampled validation mode
+//
+// Full tracking is too expensive to leave on in production, where the
+// real nesting bugs happen. In sampled mode each thread keeps a
+// fixed-depth shadow stack of (attribute, value) pairs; the stack
+// index serves as an always-on depth counter that catches gross
+// imbalance (ends without begins, unclosed regions at exit)
+// immediately, while the full top-of-stack comparison only runs for
+// one in every sample_interval end events. Maintenance cost per event
+// is two stores and an index update, no map and no lock.
+//
+
+unsigned sampled_interval = 0;
+
+std::atomic<long> proc_depth; // depth of process-scope regions
+
+struct SampledThreadState {
+    static const int max_depth = 128;
+
+    int       depth;       // current thread-scope nesting depth
+    unsigned  num_ends;
+    bool      error_found;
+
+    cali_id_t attr_id[max_depth];
+    Variant   value[max_depth];
+
+    SampledThreadState()
+        : depth(0), num_ends(0), error_found(false)
+        { }
+
+    ~SampledThreadState() {
+        if (depth > 0) {
+            Log(0).stream() << "validator: thread finished with " << depth
+                            << " unclosed region(s)" << std::endl;
+            ++global_errors;
+        }
+    }
+};
+
+thread_local SampledThreadState t_sampled;
+
+void sampled_begin_cb(Caliper* c, const Attribute& attr, const Variant& value)
+{
+    if ((attr.properties() & CALI_ATTR_SCOPE_MASK) == CALI_ATTR_SCOPE_PROCESS) {
+        ++proc_depth;
+        return;
+    }
+
+    SampledThreadState& s = t_sampled;
+
+    if (s.depth < SampledThreadState::max_depth) {
+        s.attr_id[s.depth] = attr.id();
+        s.value[s.depth]   = value;
+    }
+
+    ++s.depth;
+}
+
+void sampled_end_cb(Caliper* c, const Attribute& attr, const Variant& value)
+{
+    if ((attr.properties() & CALI_ATTR_SCOPE_MASK) == CALI_ATTR_SCOPE_PROCESS) {
+        if (proc_depth.fetch_add(-1) <= 0) {
+            proc_depth.fetch_add(1);
+
+            Log(0).stream() << "validator: end(\"" << attr.name()
+                            << "\") without matching begin()" << std::endl;
+            ++global_errors;
+        }
+
+        return;
+    }
+
+    SampledThreadState& s = t_sampled;
+
+    if (s.depth == 0) {
+        if (!s.error_found) {
+            s.error_found = true;
+
+            print_snapshot(c,
+                Log(0).stream() << "validator: end(\"" << attr.name()
+                                << "\"=\"" << value.to_string()
+                                << "\") without matching begin().\n    context: " )
+                << std::endl;
+            ++global_errors;
+        }
+
+        return;
+    }
+
+    --s.depth;
+
+    // sampled top-of-stack check: 1 in sampled_interval end events
+
+    if (!s.error_found
+        && ++s.num_ends % sampled_interval == 0
+        && s.depth < SampledThreadState::max_depth) {
+        if (s.attr_id[s.depth] != attr.id() || !(s.value[s.depth] == value)) {
+            s.error_found = true;
+
+            print_snapshot(c,
+                Log(0).stream() << "validator: incorrect nesting: trying to end \""
+                                << attr.name() << "\"=\"" << value.to_string()
+                                << "\" but current region is \""
+                                << c->get_attribute(s.attr_id[s.depth]).name()
+                                << "\"=\"" << s.value[s.depth].to_string()
+                                << "\".\n    context: " )
+                << std::endl;
+            ++global_errors;
+        }
+    }
+}
+
+void sampled_finalize_cb(Caliper*)
+{
+    long depth = proc_depth.load();
+
+    if (depth > 0) {
+        Log(0).stream() << "validator: " << depth
+                        << " unclosed process-scope region(s)" << std::endl;
+        ++global_errors;
+    }
+
+    if (global_errors.load() > 0)
+        Log(0).stream() << "validator: Annotation nesting errors found"
+                        << std::endl;
+    else
+        Log(1).stream() << "validator: No annotation nesting errors found"
+                        << std::endl;
+}
+
+const ConfigSet::Entry s_configdata[] = {
+    { "sample_interval", CALI_TYPE_UINT, "0",
+      "Validate 1 in N region events (0: validate all events).",
+      "Validate 1 in N region events. With N > 0, full begin/end\n"
+      "tracking is replaced by a per-thread shadow stack whose depth\n"
+      "counter always detects gross imbalance, while the complete\n"
+      "top-of-stack check runs for one in N end events. Overhead is\n"
+      "negligible, so validation can stay enabled in production.\n"
+      "Default: 0 (track and validate every event)."
+    },
+    ConfigSet::Terminator
+};
+
+void validator_register(Caliper* c)
 {
+    sampled_interval =
+        RuntimeConfig::init("validator", s_configdata).get("sample_interval").to_uint();
+
+    if (sampled_interval > 0) {
+        proc_depth.store(0);
+        global_errors.store(0);
+
+        c->events().finish_evt.connect(&sampled_finalize_cb);
+        c->events().pre_begin_evt.connect(&sampled_begin_cb);
+        c->events().pre_end_evt.connect(&sampled_end_cb);
+
+        Log(1).stream() << "Registered validator service (sampled, 1 in "
+                        << sampled_interval << " events)." << std::endl;
+        return;
+    }
+
     if (pthread_key_create(&threadinfo_key, destroy_thread_info) != 0) {
         Log(0).stream() << "validator: error: Could not create thread info" << std::endl;
         return;
@@ -1,22 +1,241 @@
+// Copyright (c) 2015, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file  vtune.cpp
+/// \brief Caliper Intel VTune Amplifier annotation binding (ITT API)
+
+#include "../common/AnnotationBinding.h"
+
+#include "caliper/common/Attribute.h"
+#include "caliper/common/Node.h"
+
+#include "caliper/common/util/split.hpp"
+
 #include <ittnotify.h>
 
-class ITTWrapper : public ToolWrapper {
-    public:
-    static itt_domain* domain;
-    virtual std::string service_name(){
-        return "VTune Service";
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cali
+{
+
+class VTuneBinding : public AnnotationBinding
+{
+    __itt_domain*         m_domain;
+
+    // Attach each non-nested attribute's ITT domain, created when the
+    // attribute is, as hidden metadata so begin/end don't look it up
+    Attribute             m_domain_attr;
+
+    // ITT string handles indexed by region node id, so steady-state
+    // task begins are handle-based and skip the ITT API's name lookup.
+    // Each unique region creates its handle once.
+    std::vector<__itt_string_handle*> m_handle_vec;
+    std::mutex            m_handle_mutex;
+
+    // Frame notification state per frame attribute. Frame boundaries
+    // are batched: one ITT frame spans frame_interval begin/end pairs.
+    struct FrameInfo {
+        __itt_domain* domain;
+        unsigned      num_begin;
+        unsigned      num_end;
+    };
+
+    std::vector<std::string>          m_frame_attr_names;
+    std::map<cali_id_t, FrameInfo*>   m_frame_map;
+    std::mutex            m_frame_mutex;
+
+    unsigned              m_frame_interval;
+
+    static const ConfigSet::Entry s_configdata[];
+
+    // Get or create the name handle for the given region node
+    __itt_string_handle* get_string_handle(const Node* node, const Variant& value) {
+        std::lock_guard<std::mutex>
+            g(m_handle_mutex);
+
+        if (node->id() >= m_handle_vec.size())
+            m_handle_vec.resize(node->id() + 1, nullptr);
+
+        __itt_string_handle* handle = m_handle_vec[node->id()];
+
+        if (!handle) {
+            std::string name = value.to_string();
+
+            handle = __itt_string_handle_create(name.c_str());
+            m_handle_vec[node->id()] = handle;
+        }
+
+        return handle;
     }
-    virtual std::string service_tag(){
-        return "vtune";
+
+    __itt_domain* get_domain(const Attribute& attr) {
+        Variant v_domain = attr.get(m_domain_attr);
+
+        return v_domain.empty() ?
+            m_domain : reinterpret_cast<__itt_domain*>(v_domain.to_uint());
     }
-    virtual void beginAction(Caliper* c, const Attribute &attr, const Variant& value){
-       __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create(value.to_string()));
+
+    // Return the frame state if the given attribute is a frame
+    // attribute, null otherwise
+    FrameInfo* get_frame_info(const Attribute& attr) {
+        std::lock_guard<std::mutex>
+            g(m_frame_mutex);
+
+        auto it = m_frame_map.find(attr.id());
+
+        if (it != m_frame_map.end())
+            return it->second;
+
+        FrameInfo* info = nullptr;
+
+        if (std::find(m_frame_attr_names.begin(), m_frame_attr_names.end(),
+                      attr.name()) != m_frame_attr_names.end()) {
+            info = new FrameInfo;
+
+            info->domain    = __itt_domain_create(attr.name().c_str());
+            info->num_begin = 0;
+            info->num_end   = 0;
+        }
+
+        m_frame_map.insert(std::make_pair(attr.id(), info));
+
+        return info;
     }
-    virtual void endAction(Caliper* c, const Attribute& attr, const Variant& value){
+
+public:
+
+    void initialize(Caliper* c) {
+        m_domain = __itt_domain_create("Caliper Instrumentation Domain");
+
+        m_domain_attr =
+            c->create_attribute("vtune.domain", CALI_TYPE_UINT,
+                                CALI_ATTR_SKIP_EVENTS | CALI_ATTR_HIDDEN);
+
+        ConfigSet config = RuntimeConfig::init("vtune", s_configdata);
+
+        util::split(config.get("frame_attributes").to_string(), ':',
+                    std::back_inserter(m_frame_attr_names));
+
+        m_frame_interval = std::max(1u, (unsigned) config.get("frame_interval").to_uint());
     }
-    virtual void initalize(){
-        domain = __itt_domain_create("Caliper Instrumentation Domain");
+
+    const char* service_tag() const { return "vtune"; }
+
+    void on_create_attribute(Caliper* c, const std::string& name, cali_attr_type, int* prop, Node** node) {
+        // Pre-create a separate ITT domain for non-nested attributes,
+        // like the domain-per-attribute scheme of the nvprof service
+
+        if (*prop & CALI_ATTR_NESTED)
+            return;
+
+        uint64_t domain =
+            reinterpret_cast<uint64_t>(__itt_domain_create(name.c_str()));
+
+        *node = c->make_tree_entry(m_domain_attr, Variant(CALI_TYPE_UINT, &domain, sizeof(uint64_t)), *node);
     }
-}
 
-CaliperService vtune_service { "vtune", &ITTWrapper::setCallbacks }
+    void on_begin(Caliper* c, const Attribute& attr, const Variant& value) {
+        FrameInfo* frame = get_frame_info(attr);
+
+        if (frame) {
+            std::lock_guard<std::mutex>
+                g(m_frame_mutex);
+
+            if (frame->num_begin++ % m_frame_interval == 0)
+                __itt_frame_begin_v3(frame->domain, nullptr);
+
+            return;
+        }
+
+        __itt_domain*        domain = get_domain(attr);
+        __itt_string_handle* handle = nullptr;
+
+        if (!attr.store_as_value()) {
+            // the node begin() will resolve this region to; repeat
+            // regions find the existing node
+            Node* node = c->make_tree_entry(attr, value,
+                                            const_cast<Node*>(c->get(attr).node()));
+
+            if (node)
+                handle = get_string_handle(node, value);
+        }
+
+        if (!handle)
+            handle = __itt_string_handle_create(value.to_string().c_str());
+
+        __itt_task_begin(domain, __itt_null, __itt_null, handle);
+    }
+
+    void on_end(Caliper* c, const Attribute& attr, const Variant& value) {
+        FrameInfo* frame = get_frame_info(attr);
+
+        if (frame) {
+            std::lock_guard<std::mutex>
+                g(m_frame_mutex);
+
+            if (++frame->num_end % m_frame_interval == 0)
+                __itt_frame_end_v3(frame->domain, nullptr);
+
+            return;
+        }
+
+        __itt_task_end(get_domain(attr));
+    }
+
+    VTuneBinding()
+        : m_domain(nullptr),
+          m_frame_interval(1)
+        { }
+};
+
+const ConfigSet::Entry VTuneBinding::s_configdata[] = {
+    { "frame_attributes", CALI_TYPE_STRING, "",
+      "List of attributes mapped to ITT frame notifications",
+      "List of attributes mapped to ITT frame notifications.\n"
+      "Begin/end of these attributes mark frame boundaries (e.g. main\n"
+      "loop iterations) instead of tasks." },
+    { "frame_interval", CALI_TYPE_UINT, "1",
+      "Number of frame attribute begin/end pairs batched into one ITT frame",
+      "Number of frame attribute begin/end pairs batched into one ITT\n"
+      "frame. Batching reduces notification overhead for fast\n"
+      "iterations; the default of 1 reports every iteration." },
+    ConfigSet::Terminator
+};
+
+CaliperService vtune_service { "vtune", &AnnotationBinding::make_binding<VTuneBinding> };
+
+} // namespace cali
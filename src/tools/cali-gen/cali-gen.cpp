@@ -0,0 +1,260 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// @file cali-gen.cpp
+/// @brief Synthetic .cali trace generator
+///
+/// Deterministically synthesizes a Caliper context stream with
+/// controllable tree shape, snapshot count, and attribute mix, so
+/// reader and aggregator performance work has reproducible inputs of
+/// any size without shipping real traces.
+///
+
+#include "caliper/tools-util/Args.h"
+
+#include "caliper/reader/CaliperMetadataDB.h"
+
+#include "caliper/common/csv/CsvWriter.h"
+
+#include "caliper/common/Node.h"
+#include "caliper/common/Variant.h"
+
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace cali;
+using namespace std;
+
+namespace
+{
+    const char* usage = "cali-gen [OPTION]...";
+
+    const util::Args::Table option_table[] = {
+        // name, longopt name, shortopt char, has argument, info, argument info
+        { "output",     "output",     'o', true,
+          "Output file name", "FILE"
+        },
+        { "depth",      "depth",      'd', true,
+          "Context tree depth", "DEPTH"
+        },
+        { "fanout",     "fanout",     'f', true,
+          "Context tree fanout per level", "FANOUT"
+        },
+        { "snapshots",  "snapshots",  'n', true,
+          "Number of snapshot records", "N"
+        },
+        { "int-attributes",    "int-attributes",    0, true,
+          "Number of by-value integer attributes per snapshot", "N"
+        },
+        { "double-attributes", "double-attributes", 0, true,
+          "Number of by-value double attributes per snapshot", "N"
+        },
+        { "distribution", "distribution", 0, true,
+          "Value distribution for double attributes (uniform or normal)", "DIST"
+        },
+        { "seed",       "seed",       's', true,
+          "Random seed", "SEED"
+        },
+        { "index",      "index",      0, false,
+          "Write a footer index", nullptr
+        },
+        { "help",       "help",       'h', false,
+          "Print help message",  nullptr
+        },
+        util::Args::Table::Terminator
+    };
+
+    // Start synthetic input ids well past any id the metadata db will
+    // assign, so unmapped ids pass through merge_node unchanged
+    const cali_id_t id_base = static_cast<cali_id_t>(1) << 48;
+
+    /// Recursively create a complete subtree of the given depth and
+    /// fanout; collects the leaf node ids for snapshot generation.
+    void make_tree(CaliperMetadataDB&  db,
+                   const Attribute&    attr,
+                   cali_id_t           parent_id,
+                   int                 depth,
+                   int                 fanout,
+                   cali_id_t&          next_id,
+                   IdMap&              idmap,
+                   vector<cali_id_t>&  leaf_ids)
+    {
+        if (depth == 0)
+            return;
+
+        for (int i = 0; i < fanout; ++i) {
+            ostringstream os;
+            os << "gen.d" << depth << ".n" << i;
+
+            string sval = os.str();
+
+            const Node* node =
+                db.merge_node(next_id++, attr.id(), parent_id,
+                              Variant(CALI_TYPE_STRING, sval.c_str(), sval.size()), idmap);
+
+            if (depth == 1)
+                leaf_ids.push_back(node->id());
+            else
+                make_tree(db, attr, next_id - 1, depth-1, fanout, next_id, idmap, leaf_ids);
+        }
+    }
+}
+
+
+int main(int argc, const char* argv[])
+{
+    // parse command line arguments
+
+    util::Args args(::option_table);
+    int lastarg = args.parse(argc, argv);
+
+    if (lastarg < argc) {
+        cerr << "cali-gen: unknown option: " << argv[lastarg] << '\n'
+             << "  Available options: ";
+
+        args.print_available_options(cerr);
+
+        return -1;
+    }
+
+    if (args.is_set("help")) {
+        cerr << ::usage << "\n\nOptions:\n";
+        args.print_available_options(cerr);
+        return 0;
+    }
+
+    string   filename   = args.get("output", "gen.cali");
+
+    int      depth      = stoi(args.get("depth",      "5"));
+    int      fanout     = stoi(args.get("fanout",     "4"));
+    uint64_t snapshots  = stoull(args.get("snapshots", "100000"));
+    int      n_int_attr = stoi(args.get("int-attributes",    "2"));
+    int      n_dbl_attr = stoi(args.get("double-attributes", "2"));
+    unsigned seed       = stoul(args.get("seed",      "42"));
+
+    bool     normal_dist = (args.get("distribution", "uniform") == "normal");
+
+    //
+    // --- create metadata: attributes and the context tree
+    //
+
+    CaliperMetadataDB db;
+
+    Attribute tree_attr =
+        db.create_attribute("gen.path", CALI_TYPE_STRING, CALI_ATTR_NESTED);
+    Attribute time_attr =
+        db.create_attribute("time.offset", CALI_TYPE_UINT, CALI_ATTR_ASVALUE | CALI_ATTR_SKIP_EVENTS);
+
+    vector<Attribute> int_attrs;
+    vector<Attribute> dbl_attrs;
+
+    for (int i = 0; i < n_int_attr; ++i) {
+        ostringstream os;
+        os << "gen.int." << i;
+        int_attrs.push_back(db.create_attribute(os.str(), CALI_TYPE_INT,    CALI_ATTR_ASVALUE));
+    }
+    for (int i = 0; i < n_dbl_attr; ++i) {
+        ostringstream os;
+        os << "gen.double." << i;
+        dbl_attrs.push_back(db.create_attribute(os.str(), CALI_TYPE_DOUBLE, CALI_ATTR_ASVALUE));
+    }
+
+    IdMap             idmap;
+    vector<cali_id_t> leaf_ids;
+    cali_id_t         next_id = ::id_base;
+
+    ::make_tree(db, tree_attr, CALI_INV_ID, depth, fanout, next_id, idmap, leaf_ids);
+
+    if (leaf_ids.empty()) {
+        cerr << "cali-gen: empty tree (depth " << depth << ", fanout " << fanout << ")" << endl;
+        return -2;
+    }
+
+    //
+    // --- write the context stream
+    //
+
+    ofstream os(filename.c_str());
+
+    if (!os) {
+        cerr << "cali-gen: cannot open " << filename << endl;
+        return -2;
+    }
+
+    CsvWriter writer(os, args.is_set("index"));
+
+    mt19937 rng(seed);
+
+    uniform_int_distribution<size_t>  leaf_dist(0, leaf_ids.size()-1);
+    uniform_int_distribution<int64_t> ival_dist(0, 1000000);
+    uniform_real_distribution<double> uval_dist(0.0, 1.0);
+    normal_distribution<double>       nval_dist(0.0, 1.0);
+
+    int n_imm = 1 + n_int_attr + n_dbl_attr;
+
+    vector<cali_id_t> attr_ids;
+    vector<Variant>   values(n_imm);
+
+    attr_ids.push_back(time_attr.id());
+    for (const Attribute& a : int_attrs)
+        attr_ids.push_back(a.id());
+    for (const Attribute& a : dbl_attrs)
+        attr_ids.push_back(a.id());
+
+    for (uint64_t s = 0; s < snapshots; ++s) {
+        cali_id_t node_id = leaf_ids[leaf_dist(rng)];
+
+        int i = 0;
+
+        values[i++] = Variant(s);
+
+        for (int k = 0; k < n_int_attr; ++k) {
+            int64_t ival = ival_dist(rng);
+            values[i++] = Variant(CALI_TYPE_INT, &ival, sizeof(ival));
+        }
+        for (int k = 0; k < n_dbl_attr; ++k)
+            values[i++] = Variant(normal_dist ? nval_dist(rng) : uval_dist(rng));
+
+        writer.write_snapshot(db, 1, &node_id, n_imm, attr_ids.data(), values.data());
+    }
+
+    writer.write_index();
+
+    cerr << "cali-gen: wrote " << writer.num_written() << " records ("
+         << leaf_ids.size() << " leaf nodes, "
+         << snapshots       << " snapshots) to " << filename << endl;
+}
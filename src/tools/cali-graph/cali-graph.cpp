@@ -48,8 +48,10 @@
 #include "caliper/common/util/split.hpp"
 
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <iterator>
+#include <vector>
 
 using namespace cali;
 using namespace std;
@@ -74,13 +76,78 @@ namespace
         Args::Table::Terminator
     };
 
+    /// Open-addressing hash set for node ids. Used to deduplicate
+    /// node and edge emission: merged multi-rank streams deliver the
+    /// same global node once per input stream.
+    class NodeIdSet {
+        std::vector<uint64_t> m_table; // stores id+1, 0 is empty
+        size_t                m_count;
+
+        static uint64_t hash(uint64_t k) {
+            k ^= k >> 33;
+            k *= UINT64_C(0xff51afd7ed558ccd);
+            k ^= k >> 33;
+
+            return k;
+        }
+
+        void grow() {
+            std::vector<uint64_t> table(2 * m_table.size(), 0);
+
+            size_t mask = table.size() - 1;
+
+            for (uint64_t key : m_table)
+                if (key) {
+                    size_t i = hash(key) & mask;
+
+                    while (table[i])
+                        i = (i+1) & mask;
+
+                    table[i] = key;
+                }
+
+            m_table.swap(table);
+        }
+
+    public:
+
+        NodeIdSet()
+            : m_table(1024, 0), m_count(0)
+            { }
+
+        /// Insert \a id. Returns true if it was not in the set before.
+        bool insert(uint64_t id) {
+            if (2 * (m_count+1) > m_table.size())
+                grow();
+
+            uint64_t key  = id + 1;
+            size_t   mask = m_table.size() - 1;
+            size_t   i    = hash(key) & mask;
+
+            while (m_table[i]) {
+                if (m_table[i] == key)
+                    return false;
+
+                i = (i+1) & mask;
+            }
+
+            m_table[i] = key;
+            ++m_count;
+
+            return true;
+        }
+    };
+
     class DotPrinter {
-        ostream& m_os;
-        Args     m_args;
-        
-        int      m_max;
-        bool     m_skip_attr_prefixes;
-        
+        ostream&  m_os;
+        Args      m_args;
+
+        int       m_max;
+        bool      m_skip_attr_prefixes;
+
+        NodeIdSet m_written;
+        string    m_buf; // reusable line buffer
+
         void parse_args(const Args& args) {
             if (args.is_set("max"))
                 m_max = stoi(args.get("max"));
@@ -117,19 +184,48 @@ namespace
             m_os << "}" << endl;
         }
 
+        // Append \a str to the line buffer, escaping DOT label syntax
+        void append_label_string(const string& str) {
+            for (char c : str) {
+                if (c == '"' || c == '\\')
+                    m_buf.push_back('\\');
+
+                m_buf.push_back(c);
+            }
+        }
+
         void print_node(CaliperMetadataAccessInterface& db, const Node* node) {
             if (!node || (m_max >= 0 && node->id() >= static_cast<cali_id_t>(m_max)))
                 return;
 
+            // skip nodes we've already written: merged streams deliver
+            // shared nodes once per stream. The metadata graph is a
+            // tree, so the node id also identifies the parent edge.
+
+            if (!m_written.insert(node->id()))
+                return;
+
             Attribute attr = db.get_attribute(node->attribute());
 
-            m_os << "  " << node->id()
-                 << " [label=\"" << format_attr_name(attr) << ":" << node->data().to_string() << "\"];"
-                 << endl;
+            m_buf.clear();
+
+            m_buf.append("  ");
+            m_buf.append(std::to_string(node->id()));
+            m_buf.append(" [label=\"");
+            append_label_string(format_attr_name(attr));
+            m_buf.push_back(':');
+            append_label_string(node->data().to_string());
+            m_buf.append("\"];\n");
+
+            if (node->parent() && node->parent()->id() != CALI_INV_ID) {
+                m_buf.append("  ");
+                m_buf.append(std::to_string(node->parent()->id()));
+                m_buf.append(" -- ");
+                m_buf.append(std::to_string(node->id()));
+                m_buf.append(";\n");
+            }
 
-            if (node->parent() && node->parent()->id() != CALI_INV_ID)
-                m_os << "  " << node->parent()->id() << " -- " << node->id() << ";"
-                     << endl;
+            m_os.write(m_buf.data(), m_buf.size());
         }
 
         void operator()(CaliperMetadataAccessInterface& db, const Node* node) {
@@ -138,46 +234,6 @@ namespace
     };
     
 
-    /// A node record filter that filters redundant identical node records.
-    /// Redundant node records can occur when merging/unifying two streams.
-    class FilterDuplicateNodes {
-        cali_id_t       m_max_node;
-
-    public:
-
-        FilterDuplicateNodes()
-            : m_max_node { 0 }
-            { } 
-
-        void operator()(CaliperMetadataAccessInterface& db, const Node* node, NodeProcessFn push) {
-            cali_id_t id = node->id();
-
-            if (id != CALI_INV_ID) {
-                if (id < m_max_node) {
-                    return;
-                } else 
-                    m_max_node = id;
-            }
-
-            push(db, node);
-        }
-    };
-
-    /// NodeFilterStep helper struct
-    /// Basically the chain link in the processing chain.
-    /// Passes result of @param m_filter_fn to @param m_push_fn
-    struct NodeFilterStep {
-        NodeFilterFn  m_filter_fn; ///< This processing step
-        NodeProcessFn m_push_fn;   ///< Next processing step
-
-        NodeFilterStep(NodeFilterFn filter_fn, NodeProcessFn push_fn) 
-            : m_filter_fn { filter_fn }, m_push_fn { push_fn }
-            { }
-
-        void operator ()(CaliperMetadataAccessInterface& db, const Node* node) {
-            m_filter_fn(db, node, m_push_fn);
-        }
-    };
 }
 
 
@@ -246,10 +302,11 @@ int main(int argc, const char* argv[])
 
     DotPrinter        dotprint(fs.is_open() ? fs : cout, args);
 
-    NodeProcessFn     node_proc = dotprint;
-    SnapshotProcessFn snap_proc = [](CaliperMetadataAccessInterface&,const EntryList&){ return; };
+    // duplicate node records from merged streams are filtered in the
+    // printer's hashed node set
 
-    node_proc = ::NodeFilterStep(::FilterDuplicateNodes(), node_proc);
+    NodeProcessFn     node_proc = std::ref(dotprint);
+    SnapshotProcessFn snap_proc = [](CaliperMetadataAccessInterface&,const EntryList&){ return; };
 
     //
     // --- Process inputs
@@ -44,25 +44,33 @@
 #include "caliper/reader/Aggregator.h"
 #include "caliper/reader/CaliperMetadataDB.h"
 #include "caliper/reader/FormatProcessor.h"
+#include "caliper/reader/QueryProcessor.h"
 #include "caliper/reader/RecordProcessor.h"
 #include "caliper/reader/RecordSelector.h"
 
 #include "caliper/common/ContextRecord.h"
 #include "caliper/common/Node.h"
 
-#include "caliper/common/csv/CsvReader.h"
+#include "caliper/common/csv/CsvSpec.h"
 #include "caliper/common/csv/CsvWriter.h"
 
 #include "caliper/common/util/split.hpp"
 
 #include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <thread>
 
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
 using namespace cali;
 using namespace std;
 using namespace util;
@@ -111,22 +119,58 @@ namespace
           "Print attributes in human-readable table form",
           nullptr
         },
+        { "stream", "stream", 0, true,
+          "Stream table output: sample column widths from this many records, then print records as they arrive",
+          "RECORDS"
+        },
         { "tree" , "tree", 'T', false,
           "Print records in a tree based on the hierarchy of the selected path attributes",
           nullptr
         },
         { "path-attributes", "path-attributes", 0, true,
-          "Select the path attributes for tree printers",
+          "Select the path attributes for tree and folded-stack printers",
           "ATTRIBUTES"
         },
+        { "folded", "folded", 0, false,
+          "Print records as folded call stacks (\"a;b;c count\") for flame graph scripts",
+          nullptr
+        },
+        { "separator", "separator", 0, true,
+          "Hierarchy separator for folded-stack output (default \";\")",
+          "STRING"
+        },
+        { "count-attribute", "count-attribute", 0, true,
+          "Attribute to print as the count in folded-stack output (default \"aggregate.count\")",
+          "ATTRIBUTE"
+        },
         { "json", "json", 'j', false,
           "Print given attributes in web-friendly json format",
           "ATTRIBUTES"
         },
+        { "columnar", "columnar", 0, false,
+          "Write records as a columnar binary table for bulk ingestion into analysis tools",
+          nullptr
+        },
         { "threads", "threads", 0, true,
           "Use this many threads (applicable only with multiple files)",
           "THREADS"
         },
+        { "watch", "watch", 'w', false,
+          "Watch the input file: process appended records on each poll and refresh the report. Text streams only",
+          nullptr
+        },
+        { "watch-interval", "watch-interval", 0, true,
+          "Poll interval for watch mode in milliseconds (default 1000)",
+          "MILLISECONDS"
+        },
+        { "query-file", "query-file", 'Q', true,
+          "Execute additional queries from FILE (one set of query options per line) in the same pass over the input",
+          "FILE"
+        },
+        { "cache-dir", "cache-dir", 0, true,
+          "Cache formatted results in this directory and return cached output when inputs and query are unchanged",
+          "DIR"
+        },
         { "output", "output", 'o', true,  "Set the output file name", "FILE"  },
         { "help",   "help",   'h', false, "Print help message",       nullptr },
         { "list-attributes", "list-attributes", 0, false,
@@ -178,6 +222,221 @@ namespace
         }
     };
 
+    //
+    // --- Result cache
+    //
+    // Optional cache of formatted query results, keyed by the input
+    // files' identity (path, size, mtime) and the canonicalized query
+    // options. Report pipelines re-running identical queries over
+    // unchanged inputs then serve the formatted output straight from
+    // the cache without scanning the inputs.
+    //
+
+    inline uint64_t hash_string(uint64_t h, const std::string& s)
+    {
+        for (char c : s)
+            h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+
+        return h;
+    }
+
+    /// Canonical encoding of the output-relevant query options in
+    /// fixed option-table order, so equivalent command lines map to
+    /// the same cache key regardless of argument order.
+    std::string canonical_options(const Args& args)
+    {
+        std::string ret;
+
+        for (const Args::Table* opt = ::option_table; opt->name; ++opt) {
+            std::string name(opt->name);
+
+            // options that do not affect the formatted result
+            if (name == "output"     || name == "threads"    || name == "help"  ||
+                name == "cache-dir"  || name == "query-file" || name == "watch" ||
+                name == "watch-interval")
+                continue;
+
+            if (args.is_set(name)) {
+                ret.append(name);
+                ret.append("=");
+                ret.append(args.get(name));
+                ret.append(";");
+            }
+        }
+
+        return ret;
+    }
+
+    /// Fold the input files' identity (path, size, mtime) into \a h.
+    /// Returns false if any input cannot be cached (stdin or stat failure).
+    bool hash_input_files(uint64_t& h, const std::vector<std::string>& files)
+    {
+        for (const std::string& file : files) {
+            if (file.empty()) // stdin
+                return false;
+
+            struct stat st;
+
+            if (stat(file.c_str(), &st) != 0)
+                return false;
+
+            h = hash_string(h, file);
+            h = hash_string(h, std::to_string(st.st_size));
+            h = hash_string(h, std::to_string(st.st_mtime));
+        }
+
+        return true;
+    }
+
+    std::string cache_entry_path(const std::string& dir, uint64_t key)
+    {
+        std::ostringstream os;
+
+        os << dir << '/' << std::hex << key << ".result";
+
+        return os.str();
+    }
+
+    /// Store a formatted result under \a path. Writes a temporary
+    /// file and renames it, so concurrent cali-query runs never see
+    /// partial entries.
+    void cache_store(const std::string& dir, const std::string& path, const std::string& data)
+    {
+        mkdir(dir.c_str(), 0755); // may already exist
+
+        std::ostringstream tmp_os;
+        tmp_os << path << ".tmp." << getpid();
+
+        std::string tmp = tmp_os.str();
+
+        {
+            std::ofstream os(tmp.c_str());
+
+            if (!os) {
+                cerr << "cali-query: could not write cache entry " << path << endl;
+                return;
+            }
+
+            os << data;
+        }
+
+        if (std::rename(tmp.c_str(), path.c_str()) != 0)
+            std::remove(tmp.c_str());
+    }
+
+    /// Watch mode: tail the input file. Metadata DB, node id map, and
+    /// aggregation state persist across polls, so each poll parses and
+    /// merges only the records appended since the last one, and each
+    /// refresh costs the increment rather than the full file size.
+    int run_watch(const Args& args, const QuerySpec& spec, const std::string& filename)
+    {
+        unsigned interval = std::stoul(args.get("watch-interval", "1000"));
+
+        CaliperMetadataDB metadb;
+        Aggregator        aggregate(spec);
+        IdMap             idmap; // node id mappings persist for the life of the stream
+
+        bool aggregating =
+            (spec.aggregation_ops.selection != QuerySpec::AggregationSelection::None);
+
+        // Non-aggregating queries stream records through a single
+        // long-lived formatter as they arrive
+
+        ofstream stream_fs;
+
+        if (!aggregating && args.is_set("output")) {
+            stream_fs.open(args.get("output").c_str());
+
+            if (!stream_fs) {
+                cerr << "cali-query: error: could not open output file "
+                     << args.get("output") << endl;
+                return -2;
+            }
+        }
+
+        FormatProcessor stream_format(spec, stream_fs.is_open() ? stream_fs : cout);
+
+        SnapshotProcessFn snap_proc =
+            [&aggregate,&stream_format,aggregating](CaliperMetadataAccessInterface& db, const EntryList& rec) {
+                if (aggregating)
+                    aggregate.add(db, rec);
+                else
+                    stream_format.process_record(db, rec);
+            };
+
+        if (spec.filter.selection == QuerySpec::FilterSelection::List)
+            snap_proc = ::SnapshotFilterStep(RecordSelector(spec), snap_proc);
+
+        NodeProcessFn node_proc = [](CaliperMetadataAccessInterface&,const Node*) { return; };
+
+        cerr << "cali-query: watching " << filename << endl;
+
+        std::ifstream is;
+
+        for ( ; ; ) {
+            if (!is.is_open()) {
+                is.open(filename.c_str());
+
+                if (!is) {
+                    // the file may not exist yet: keep polling
+                    is.clear();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+                    continue;
+                }
+            }
+
+            size_t         n_merged = 0;
+            std::streampos pos      = is.tellg();
+
+            for (std::string line; std::getline(is, line); ) {
+                if (is.eof()) {
+                    // incomplete last line (no trailing newline yet):
+                    // re-read it on the next poll
+                    break;
+                }
+
+                metadb.merge(CsvSpec::read_record(line), idmap, node_proc, snap_proc);
+
+                ++n_merged;
+                pos = is.tellg();
+            }
+
+            // clear eof and continue from the first unconsumed byte
+            is.clear();
+            is.seekg(pos);
+
+            if (n_merged > 0) {
+                if (aggregating) {
+                    // re-emit the full refreshed report; with an output
+                    // file, each refresh replaces the previous report
+
+                    ofstream fs;
+
+                    if (args.is_set("output")) {
+                        fs.open(args.get("output").c_str());
+
+                        if (!fs) {
+                            cerr << "cali-query: error: could not open output file "
+                                 << args.get("output") << endl;
+                            return -2;
+                        }
+                    }
+
+                    FormatProcessor format(spec, fs.is_open() ? fs : cout);
+
+                    aggregate.flush(metadb, format);
+                    format.flush(metadb);
+                }
+
+                (stream_fs.is_open() ? stream_fs : cout).flush();
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+        }
+
+        return 0;
+    }
+
 }
 
 
@@ -251,35 +510,78 @@ int main(int argc, const char* argv[])
 
     QuerySpec         spec = spec_from_args(args);
 
+    //
+    // --- Watch mode: tail the input and refresh reports incrementally
+    //
+
+    if (args.is_set("watch")) {
+        std::vector<std::string> watch_files = args.arguments();
+
+        if (watch_files.size() != 1 || watch_files.front().empty()) {
+            cerr << "cali-query: error: watch mode requires exactly one input file" << endl;
+            return -1;
+        }
+
+        if (fs.is_open())
+            fs.close();
+
+        return ::run_watch(args, spec, watch_files.front());
+    }
+
+    std::vector<std::string> files = args.arguments();
+
+    if (files.empty())
+        files.push_back(""); // read from stdin if no files are given
+
+    //
+    // --- Result cache setup. When caching, formatted output is
+    //     captured and written to both the cache and the real output.
+    //
+
+    std::string cache_dir  = args.get("cache-dir");
+    uint64_t    cache_base = 14695981039346656037ull;
+    bool        caching    = false;
+
+    if (!cache_dir.empty()) {
+        if (::hash_input_files(cache_base, files))
+            caching = true;
+        else
+            cerr << "cali-query: cannot cache stdin input, result cache disabled" << endl;
+    }
+
+    uint64_t main_key = ::hash_string(cache_base, ::canonical_options(args));
+
+    std::ostringstream main_capture;
+
     // setup format spec
-    
-    FormatProcessor   format(spec, fs.is_open() ? fs : cout);
+
+    FormatProcessor   format(spec, caching ? static_cast<std::ostream&>(main_capture)
+                                           : (fs.is_open() ? fs : cout));
 
     NodeProcessFn     node_proc = [](CaliperMetadataAccessInterface&,const Node*) { return; };
     SnapshotProcessFn snap_proc = [](CaliperMetadataAccessInterface&,const EntryList&){ return; };
 
     Aggregator        aggregate(spec);
 
-    if (spec.aggregation_ops.selection == QuerySpec::AggregationSelection::None)
-        snap_proc = format;
-    else
+    bool aggregating =
+        (spec.aggregation_ops.selection != QuerySpec::AggregationSelection::None);
+
+    if (aggregating)
         snap_proc = aggregate;
+    else
+        snap_proc = format;
 
     if (spec.filter.selection == QuerySpec::FilterSelection::List)
         snap_proc = ::SnapshotFilterStep(RecordSelector(spec), snap_proc);
-    
+
     if (args.is_set("list-attributes")) {
-        node_proc = AttributeExtract(snap_proc);
-        snap_proc = [](CaliperMetadataAccessInterface&,const EntryList&){ return; };
+        node_proc   = AttributeExtract(snap_proc);
+        snap_proc   = [](CaliperMetadataAccessInterface&,const EntryList&){ return; };
+        aggregating = false;
     }
 
     node_proc = ::NodeFilterStep(::FilterDuplicateNodes(), node_proc);
 
-    std::vector<std::string> files = args.arguments();
-
-    if (files.empty())
-        files.push_back(""); // read from stdin if no files are given
-    
     unsigned num_threads =
         std::min<unsigned>(files.size(), std::stoul(args.get("threads", "4")));
 
@@ -296,19 +598,187 @@ int main(int argc, const char* argv[])
 
     CaliperMetadataDB     metadb;
     std::atomic<unsigned> index(0);
-    
+
+    // When aggregating, give each thread its own aggregator instance to
+    // avoid contention on the shared one, and merge results at the end.
+
+    std::vector<Aggregator>        t_aggregate;
+    std::vector<SnapshotProcessFn> t_snap_proc(num_threads, snap_proc);
+
+    if (aggregating)
+        for (unsigned t = 0; t < num_threads; ++t) {
+            t_aggregate.emplace_back(spec);
+
+            SnapshotProcessFn sp = t_aggregate.back();
+
+            if (spec.filter.selection == QuerySpec::FilterSelection::List)
+                sp = ::SnapshotFilterStep(RecordSelector(spec), sp);
+
+            t_snap_proc[t] = sp;
+        }
+
+    //
+    // --- Set up additional queries to run in the same pass (--query-file)
+    //
+
+    // note: the output streams must outlive the QueryProcessors
+    // writing to them
+    std::vector< std::unique_ptr<std::ofstream> > query_outputs;
+    std::vector< std::unique_ptr<std::ostringstream> > query_captures;
+
+    std::vector<QueryProcessor> queries;
+
+    std::vector<uint64_t>      query_keys;
+    std::vector<std::ostream*> query_dests;
+
+    if (args.is_set("query-file")) {
+        ifstream qfs(args.get("query-file").c_str());
+
+        if (!qfs) {
+            cerr << "cali-query: error: could not open query file "
+                 << args.get("query-file") << endl;
+
+            return -2;
+        }
+
+        std::string line;
+
+        while (std::getline(qfs, line)) {
+            // Each line holds one set of cali-query options
+
+            std::vector<std::string> tokens { std::string("cali-query") };
+
+            {
+                std::istringstream is(line);
+                std::string s;
+
+                while (is >> s)
+                    tokens.push_back(s);
+            }
+
+            if (tokens.size() < 2 || tokens[1][0] == '#')
+                continue;
+
+            std::vector<const char*> argvec;
+
+            for (const std::string& s : tokens)
+                argvec.push_back(s.c_str());
+
+            Args qargs(::option_table);
+            int  a = qargs.parse(static_cast<int>(argvec.size()), argvec.data());
+
+            if (a < static_cast<int>(argvec.size())) {
+                cerr << "cali-query: error: unknown option in query file: "
+                     << argvec[a] << endl;
+
+                return -1;
+            }
+
+            std::ostream* qos = &cout;
+
+            if (qargs.is_set("output")) {
+                query_outputs.emplace_back(new ofstream(qargs.get("output").c_str()));
+
+                if (!*query_outputs.back()) {
+                    cerr << "cali-query: error: could not open output file "
+                         << qargs.get("output") << endl;
+
+                    return -2;
+                }
+
+                qos = query_outputs.back().get();
+            }
+
+            if (caching) {
+                query_keys.push_back(::hash_string(cache_base, ::canonical_options(qargs)));
+                query_dests.push_back(qos);
+                query_captures.emplace_back(new std::ostringstream);
+
+                qos = query_captures.back().get();
+            }
+
+            queries.emplace_back(spec_from_args(qargs), *qos);
+        }
+    }
+
+    if (!queries.empty())
+        for (unsigned t = 0; t < num_threads; ++t) {
+            SnapshotProcessFn sp = t_snap_proc[t];
+
+            t_snap_proc[t] = [sp,&queries](CaliperMetadataAccessInterface& db, const EntryList& rec) mutable {
+                sp(db, rec);
+
+                for (QueryProcessor& q : queries)
+                    q.process_record(db, rec);
+            };
+        }
+
+    //
+    // --- Result cache lookup: serve cached output when all results
+    //     for this input/query combination are present
+    //
+
+    if (caching) {
+        std::vector<std::string> paths { ::cache_entry_path(cache_dir, main_key) };
+
+        for (uint64_t key : query_keys)
+            paths.push_back(::cache_entry_path(cache_dir, key));
+
+        std::vector< std::unique_ptr<std::ifstream> > entries;
+
+        bool hit = true;
+
+        for (const std::string& p : paths) {
+            entries.emplace_back(new std::ifstream(p.c_str()));
+            hit = hit && static_cast<bool>(*entries.back());
+        }
+
+        if (hit) {
+            cerr << "cali-query: using cached results from " << cache_dir << endl;
+
+            (fs.is_open() ? fs : cout) << entries[0]->rdbuf();
+
+            for (size_t i = 0; i < query_keys.size(); ++i)
+                *query_dests[i] << entries[i+1]->rdbuf();
+
+            return 0;
+        }
+    }
+
+    // Fused single-pass aggregation: when the snapshot processing
+    // chain is exactly the aggregator - no filter, no extra queries -
+    // hand records to the aggregator directly without materializing
+    // them as EntryList records
+
+    bool fused_aggregation =
+        aggregating && queries.empty()
+        && spec.filter.selection != QuerySpec::FilterSelection::List;
+
     auto thread_fn = [&](unsigned t) {
         Annotation::Guard
             g_t(Annotation("thread").set(static_cast<int>(t)));
-        
-        for (unsigned i = index++; i < files.size(); i = index++) { // "index++" is atomic read-mod-write 
-            Annotation::Guard 
+
+        // used to skip index blocks in indexed files that can't match the filter
+        RecordSelector block_selector(spec);
+
+        // Block skipping must be off when additional queries consume the
+        // record stream: their filters differ from the main query's
+
+        bool filtering =
+            (spec.filter.selection == QuerySpec::FilterSelection::List) && queries.empty();
+
+        for (unsigned i = index++; i < files.size(); i = index++) { // "index++" is atomic read-mod-write
+            Annotation::Guard
                 g_s(Annotation("cali-query.stream").set(files[i].empty() ? "stdin" : files[i].c_str()));
-            
-            CsvReader reader(files[i]);
-            IdMap     idmap;
 
-            if (!reader.read([&](const RecordMap& rec){ metadb.merge(rec, idmap, node_proc, snap_proc); }))
+            bool read_ok = fused_aggregation ?
+                metadb.read_aggregate(files[i], node_proc, t_aggregate[t]) :
+                filtering ?
+                metadb.read(files[i], node_proc, t_snap_proc[t],
+                            [&block_selector](const RecordMap& blk){ return block_selector.pass_block(blk); }) :
+                metadb.read(files[i], node_proc, t_snap_proc[t]);
+
+            if (!read_ok)
                 cerr << "Could not read file " << files[i] << endl;
         }
     };
@@ -331,6 +801,45 @@ int main(int argc, const char* argv[])
 
     a_phase.set("flush");
 
+    // Pairwise tree reduction of the per-thread aggregation results.
+    // Each step merges disjoint pairs, so the merge targets don't
+    // require synchronization between the merge threads.
+
+    for (std::size_t step = 1; step < t_aggregate.size(); step *= 2) {
+        std::vector<std::thread> merge_threads;
+
+        for (std::size_t i = 0; i + step < t_aggregate.size(); i += 2*step)
+            merge_threads.emplace_back([&t_aggregate,i,step]{
+                    t_aggregate[i].merge(t_aggregate[i+step]);
+                });
+
+        for (auto &t : merge_threads)
+            t.join();
+    }
+
+    if (!t_aggregate.empty())
+        aggregate.merge(t_aggregate.front());
+
     aggregate.flush(metadb, format);
     format.flush(metadb);
+
+    for (QueryProcessor& q : queries)
+        q.flush(metadb);
+
+    //
+    // --- Emit and store captured results when caching
+    //
+
+    if (caching) {
+        (fs.is_open() ? fs : cout) << main_capture.str();
+
+        ::cache_store(cache_dir, ::cache_entry_path(cache_dir, main_key), main_capture.str());
+
+        for (size_t i = 0; i < query_keys.size(); ++i) {
+            *query_dests[i] << query_captures[i]->str();
+
+            ::cache_store(cache_dir, ::cache_entry_path(cache_dir, query_keys[i]),
+                          query_captures[i]->str());
+        }
+    }
 }
@@ -49,12 +49,17 @@
 
 #include "caliper/common/util/split.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
 #include <iterator>
 #include <limits>
+#include <random>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 using namespace cali;
 using namespace std;
@@ -70,6 +75,13 @@ namespace
         { "reuse",  "reuse-statistics", 'r', false,
           "Print tree data reuse statistics", nullptr
         },
+        { "dist",   "distribution-statistics", 'd', false,
+          "Print value distribution and tree branch factor statistics", nullptr
+        },
+        { "threads", "threads", 0, true,
+          "Use this many threads (applicable only with multiple files)",
+          "THREADS"
+        },
         { "output", "output", 'o', true,  "Set the output file name", "FILE"  },
         { "help",   "help",   'h', false, "Print help message",       nullptr },
         Args::Table::Terminator
@@ -93,6 +105,22 @@ namespace
             : mS(new S)
             { }
 
+        /// \brief Combine per-thread results of \a other into this instance
+        void merge(const ReuseStat& other) {
+            for (auto &p : other.mS->reuse) {
+                auto it = mS->reuse.find(p.first);
+
+                if (it == mS->reuse.end())
+                    mS->reuse.insert(p);
+                else {
+                    it->second.nodes += p.second.nodes;
+
+                    for (auto &dp : p.second.data)
+                        it->second.data[dp.first] += dp.second;
+                }
+            }
+        }
+
         void print_results(CaliperMetadataAccessInterface& db, ostream& os) {
             os << "\nReuse statistics:\n"
                << "Attribute                       #nodes      #elem       #uses       #uses/elem  #uses/node\n";
@@ -161,6 +189,190 @@ namespace
         }
     };
     
+    /// Single-pass, bounded-memory value distribution statistics:
+    /// reservoir-sampled quantiles per numeric attribute and a branch
+    /// factor histogram for the node tree.
+    class DistributionStat {
+        static const size_t reservoir_size = 1024;
+
+        struct AttributeSample {
+            int            count   = 0;
+            double         min     = std::numeric_limits<double>::max();
+            double         max     = std::numeric_limits<double>::lowest();
+            double         sum     = 0.0;
+
+            vector<double> reservoir;
+        };
+
+        struct S {
+            map<cali_id_t, AttributeSample> samples;
+            map<cali_id_t, int>             num_children;
+
+            std::minstd_rand                rng { 42 }; // fixed seed: deterministic output
+        };
+
+        std::shared_ptr<S> mS;
+
+        void add_value(cali_id_t attr_id, double val) {
+            AttributeSample& s = mS->samples[attr_id];
+
+            ++s.count;
+
+            s.min  = std::min(s.min, val);
+            s.max  = std::max(s.max, val);
+            s.sum += val;
+
+            // reservoir sampling: keep each of the first count values
+            // with probability reservoir_size/count
+
+            if (s.reservoir.size() < reservoir_size)
+                s.reservoir.push_back(val);
+            else {
+                size_t j = mS->rng() % s.count;
+
+                if (j < reservoir_size)
+                    s.reservoir[j] = val;
+            }
+        }
+
+        static double quantile(const vector<double>& sorted, double q) {
+            if (sorted.empty())
+                return 0.0;
+
+            size_t i = static_cast<size_t>(q * (sorted.size() - 1));
+
+            return sorted[i];
+        }
+
+    public:
+
+        DistributionStat()
+            : mS(new S)
+            { }
+
+        /// \brief Combine per-thread results of \a other into this instance
+        void merge(const DistributionStat& other) {
+            for (auto &p : other.mS->samples) {
+                AttributeSample& s = mS->samples[p.first];
+
+                s.count += p.second.count;
+                s.min    = std::min(s.min, p.second.min);
+                s.max    = std::max(s.max, p.second.max);
+                s.sum   += p.second.sum;
+
+                // combine reservoirs; subsample if the result exceeds
+                // the reservoir size
+
+                s.reservoir.insert(s.reservoir.end(),
+                                   p.second.reservoir.begin(), p.second.reservoir.end());
+
+                if (s.reservoir.size() > reservoir_size) {
+                    std::shuffle(s.reservoir.begin(), s.reservoir.end(), mS->rng);
+                    s.reservoir.resize(reservoir_size);
+                }
+            }
+
+            for (auto &p : other.mS->num_children)
+                mS->num_children[p.first] += p.second;
+        }
+
+        void print_results(CaliperMetadataAccessInterface& db, ostream& os) {
+            os << "\nValue distribution (quantiles estimated from up to "
+               << reservoir_size << " sampled values):\n"
+               << "Attribute                       #values     min         25%         50%         75%         95%         max         avg\n";
+
+            for (auto &p : mS->samples) {
+                vector<double> sorted(p.second.reservoir);
+                std::sort(sorted.begin(), sorted.end());
+
+                os << std::setw(32) << std::left << db.get_attribute(p.first).name()
+                   << std::setw(12) << p.second.count
+                   << std::setw(12) << p.second.min
+                   << std::setw(12) << quantile(sorted, 0.25)
+                   << std::setw(12) << quantile(sorted, 0.50)
+                   << std::setw(12) << quantile(sorted, 0.75)
+                   << std::setw(12) << quantile(sorted, 0.95)
+                   << std::setw(12) << p.second.max
+                   << std::setw(12) << p.second.sum / p.second.count
+                   << endl;
+            }
+
+            // histogram of node branch factors: bucket b holds nodes
+            // with 2^(b-1) < #children <= 2^b
+
+            int hist[16]  = { 0 };
+            int max_width = 0;
+
+            for (auto &p : mS->num_children) {
+                int b = 0;
+
+                while (b < 15 && (1 << b) < p.second)
+                    ++b;
+
+                ++hist[b];
+                max_width = std::max(max_width, p.second);
+            }
+
+            os << "\nTree branch factor: max " << max_width
+               << ", histogram of inner-node child counts:\n"
+               << "#children       #nodes\n";
+
+            for (int b = 0; b < 16; ++b)
+                if (hist[b] > 0) {
+                    ostringstream range;
+
+                    if (b < 2)
+                        range << (1 << b);
+                    else
+                        range << (1 << (b-1)) + 1 << " - " << (1 << b);
+
+                    os << std::setw(16) << range.str() << hist[b] << endl;
+                }
+        }
+
+        void process_node(CaliperMetadataAccessInterface& db, const RecordMap& rec) {
+            cali_id_t parent_id = CALI_INV_ID;
+
+            auto it = rec.find("parent");
+
+            if (it != rec.end() && !it->second.empty())
+                parent_id = StringConverter(it->second.front()).to_id();
+
+            if (parent_id != CALI_INV_ID)
+                ++mS->num_children[parent_id];
+        }
+
+        void process_snapshot(const CaliperMetadataAccessInterface& db, const RecordMap& rec) {
+            auto a_it = rec.find("attr");
+            auto d_it = rec.find("data");
+
+            if (a_it == rec.end() || d_it == rec.end())
+                return;
+
+            for (vector<string>::size_type i = 0; i < a_it->second.size() && i < d_it->second.size(); ++i) {
+                cali_id_t      attr_id = StringConverter(a_it->second[i]).to_id();
+                cali_attr_type type    = db.get_attribute(attr_id).type();
+
+                if (type == CALI_TYPE_INT || type == CALI_TYPE_UINT || type == CALI_TYPE_DOUBLE) {
+                    bool   ok  = false;
+                    double val = StringConverter(d_it->second[i]).to_double(&ok);
+
+                    if (ok)
+                        add_value(attr_id, val);
+                }
+            }
+        }
+
+        void operator()(CaliperMetadataAccessInterface& db, const RecordMap& rec) {
+            string type = get_record_type(rec);
+
+            if      (type == "node")
+                process_node(db, rec);
+            else if (type == "ctx")
+                process_snapshot(db, rec);
+        }
+    };
+
     class CaliStreamStat {
         struct S {
             int n_snapshots;
@@ -201,6 +413,24 @@ namespace
             : mS(new S { 0, 0, 0, std::numeric_limits<int>::max(), 0, 0, 0, 0, 0, 0 } )
             { }
 
+        /// \brief Combine per-file results of \a other into this instance
+        void merge(const CaliStreamStat& other) {
+            mS->n_snapshots    += other.mS->n_snapshots;
+            mS->n_nodes        += other.mS->n_nodes;
+
+            mS->n_max_snapshot  = std::max(mS->n_max_snapshot, other.mS->n_max_snapshot);
+            mS->n_min_snapshot  = std::min(mS->n_min_snapshot, other.mS->n_min_snapshot);
+
+            mS->n_ref          += other.mS->n_ref;
+            mS->n_val          += other.mS->n_val;
+            mS->n_tot          += other.mS->n_tot;
+
+            mS->n_attr_refs    += other.mS->n_attr_refs;
+
+            mS->size_nodes     += other.mS->size_nodes;
+            mS->size_snapshots += other.mS->size_snapshots;
+        }
+
         void print_results(ostream& os) {
             os << "Number of records\n"
                << "Total          Nodes          Snapshots\n"
@@ -424,42 +654,96 @@ int main(int argc, const char* argv[])
     }
 
     //
-    // --- Build up processing chain (from back to front)
+    // --- Process inputs. Each file is processed independently with its
+    //     own statistics objects; results are merged at the end.
     //
 
-    ::ReuseStat      reuse_stat;
-    ::CaliStreamStat stream_stat;
-    
-    MultiProcessor   stats;
-    
-    if (args.is_set("reuse"))
-        stats.add(reuse_stat);
+    a_phase.set("process");
+
+    bool print_reuse = args.is_set("reuse");
+    bool print_dist  = args.is_set("dist");
+
+    std::vector<std::string> files = args.arguments();
+
+    unsigned num_threads =
+        std::max<unsigned>(1, std::min<unsigned>(files.size(), std::stoul(args.get("threads", "4"))));
+
+    Annotation("cali-stat.num-threads", CALI_ATTR_SCOPE_PROCESS).set(static_cast<int>(num_threads));
+
+    CaliperMetadataDB     metadb;
+    std::atomic<unsigned> index(0);
+
+    std::vector<::CaliStreamStat>   file_stats(files.size());
+    std::vector<::ReuseStat>        t_reuse(num_threads);
+    std::vector<::DistributionStat> t_dist(num_threads);
+
+    auto thread_fn = [&](unsigned t) {
+        Annotation::Guard
+            g_t(Annotation("thread").set(static_cast<int>(t)));
+
+        for (unsigned i = index++; i < files.size(); i = index++) { // "index++" is atomic read-mod-write
+            Annotation::Guard
+                g_s(Annotation("cali-stat.stream").set(files[i].c_str()));
+
+            MultiProcessor stats;
 
-    stats.add(stream_stat);
+            if (print_reuse)
+                stats.add(t_reuse[t]);
+            if (print_dist)
+                stats.add(t_dist[t]);
 
-    RecordProcessFn  processor = ::FilterStep(::FilterDuplicateNodes(), stats);
+            stats.add(file_stats[i]);
+
+            RecordProcessFn processor = ::FilterStep(::FilterDuplicateNodes(), stats);
+
+            CsvReader reader(files[i]);
+            IdMap     idmap;
+
+            if (!reader.read([&](const RecordMap& rec){ processor(metadb, metadb.merge(rec, idmap)); }))
+                cerr << "Could not read file " << files[i] << endl;
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (unsigned t = 0; t < num_threads; ++t)
+        threads.emplace_back(thread_fn, t);
+
+    for (auto &t : threads)
+        t.join();
 
     //
-    // --- Process inputs
+    // --- Merge and print results
     //
 
-    a_phase.set("process");
+    a_phase.set("flush");
 
-    CaliperMetadataDB metadb;
+    ::CaliStreamStat   stream_stat;
+    ::ReuseStat        reuse_stat;
+    ::DistributionStat dist_stat;
 
-    for (const string& file : args.arguments()) {
-        Annotation::Guard 
-            g_s(Annotation("cali-stat.stream").set(file.c_str()));
-            
-        CsvReader reader(file);
-        IdMap     idmap;
+    for (const ::CaliStreamStat& s : file_stats)
+        stream_stat.merge(s);
+    for (const ::ReuseStat& s : t_reuse)
+        reuse_stat.merge(s);
+    for (const ::DistributionStat& s : t_dist)
+        dist_stat.merge(s);
+
+    ostream& os = fs.is_open() ? fs : cout;
+
+    if (files.size() > 1) {
+        for (std::vector<std::string>::size_type i = 0; i < files.size(); ++i) {
+            os << "\n=== " << files[i] << " ===\n";
+            file_stats[i].print_results(os);
+        }
 
-        if (!reader.read([&](const RecordMap& rec){ processor(metadb, metadb.merge(rec, idmap)); }))
-            cerr << "Could not read file " << file << endl;
+        os << "\n=== Total (" << files.size() << " files) ===\n";
     }
 
-    stream_stat.print_results(fs.is_open() ? fs : cout);
+    stream_stat.print_results(os);
 
-    if (args.is_set("reuse"))
-        reuse_stat.print_results(metadb, fs.is_open() ? fs : cout);
+    if (print_reuse)
+        reuse_stat.print_results(metadb, os);
+    if (print_dist)
+        dist_stat.print_results(metadb, os);
 }
@@ -0,0 +1,265 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//
+// Single-thread microbenchmarks for the annotation hot paths.
+//
+// Reports ns/op for begin/end, blackboard updates, snapshots, and
+// snapshot record compression, so overhead regressions show up before
+// release. Run through the "benchmark" make target, or directly.
+//
+// The push_snapshot benchmark times the whole snapshot callback chain:
+// run with CALI_SERVICES_ENABLE set (e.g. to aggregate) to measure the
+// per-snapshot cost of specific service configurations.
+//
+
+#include "caliper/tools-util/Args.h"
+
+#include <caliper/Caliper.h>
+#include <caliper/SnapshotRecord.h>
+
+#include <caliper/common/CompressedSnapshotRecord.h>
+#include <caliper/common/Variant.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+int iterations = 100000;
+
+template<class Fn>
+void run_benchmark(const char* name, Fn fn)
+{
+    auto stime = std::chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < iterations; ++i)
+        fn(i);
+
+    auto etime = std::chrono::high_resolution_clock::now();
+
+    double nsec =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(etime-stime).count();
+
+    std::cout << std::left  << std::setw(36) << name
+              << std::right << std::setw(12) << std::fixed << std::setprecision(1)
+              << nsec / iterations << " ns/op" << std::endl;
+}
+
+cali::Attribute make_tree_attribute(cali::Caliper& c, const std::string& name)
+{
+    return c.create_attribute(name, CALI_TYPE_STRING, CALI_ATTR_SCOPE_THREAD);
+}
+
+//
+// --- benchmarks
+//
+
+// begin/end with a constant value: the node for the value already
+// exists after the first iteration, so this times the tree lookup and
+// blackboard update only
+void benchmark_begin_end(cali::Caliper& c)
+{
+    cali::Attribute attr = make_tree_attribute(c, "bench.beginend");
+    cali::Variant   v_val(CALI_TYPE_STRING, "benchmark", 9);
+
+    run_benchmark("begin/end (existing node)", [&c,&attr,&v_val](int){
+            c.begin(attr, v_val);
+            c.end(attr);
+        });
+}
+
+// begin/end cycling through many distinct values: times
+// MetadataTree::get_path child lookup at the given tree fanout
+void benchmark_begin_end_fanout(cali::Caliper& c, int fanout)
+{
+    cali::Attribute attr = make_tree_attribute(c, "bench.fanout");
+
+    std::vector<std::string> values;
+
+    for (int i = 0; i < fanout; ++i) {
+        std::stringstream s;
+        s << "fanout." << i;
+        values.push_back(s.str());
+    }
+
+    {
+        std::stringstream name;
+        name << "begin/end (fanout " << fanout << ")";
+
+        run_benchmark(name.str().c_str(), [&c,&attr,&values](int i){
+                const std::string& sval = values[i % values.size()];
+
+                c.begin(attr, cali::Variant(CALI_TYPE_STRING, sval.c_str(), sval.length()));
+                c.end(attr);
+            });
+    }
+}
+
+// set on a by-value attribute: times the immediate-entry blackboard update
+void benchmark_set_value(cali::Caliper& c)
+{
+    cali::Attribute attr =
+        c.create_attribute("bench.value", CALI_TYPE_INT, CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD);
+
+    run_benchmark("set (by-value attribute)", [&c,&attr](int i){
+            int64_t ival = i;
+            c.set(attr, cali::Variant(CALI_TYPE_INT, &ival, sizeof(ival)));
+        });
+}
+
+// pull_snapshot at the given blackboard depth
+void benchmark_pull_snapshot(cali::Caliper& c, int depth)
+{
+    std::stringstream s;
+    s << "bench.pull." << depth;
+
+    cali::Attribute attr  = make_tree_attribute(c, s.str());
+    cali::Variant   v_val(CALI_TYPE_STRING, "level", 5);
+
+    for (int d = 0; d < depth; ++d)
+        c.begin(attr, v_val);
+
+    cali::SnapshotRecord::FixedSnapshotRecord<60> data;
+
+    {
+        std::stringstream name;
+        name << "pull_snapshot (depth " << depth << ")";
+
+        run_benchmark(name.str().c_str(), [&c,&data](int){
+                cali::SnapshotRecord rec(data);
+                c.pull_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, nullptr, &rec);
+            });
+    }
+
+    for (int d = 0; d < depth; ++d)
+        c.end(attr);
+}
+
+// push_snapshot: times the full snapshot callback chain of the
+// enabled services
+void benchmark_push_snapshot(cali::Caliper& c)
+{
+    run_benchmark("push_snapshot", [&c](int){
+            c.push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, nullptr);
+        });
+}
+
+// CompressedSnapshotRecord encode/decode of a typical snapshot
+void benchmark_compressed_record(cali::Caliper& c)
+{
+    cali::Attribute attr  = make_tree_attribute(c, "bench.compress");
+    cali::Variant   v_val(CALI_TYPE_STRING, "level", 5);
+
+    for (int d = 0; d < 4; ++d)
+        c.begin(attr, v_val);
+
+    cali::SnapshotRecord::FixedSnapshotRecord<60> data;
+    cali::SnapshotRecord rec(data);
+
+    c.pull_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, nullptr, &rec);
+
+    run_benchmark("CompressedSnapshotRecord encode", [&rec](int){
+            cali::CompressedSnapshotRecord crec;
+            crec.append(&rec);
+        });
+
+    cali::CompressedSnapshotRecord crec;
+    crec.append(&rec);
+
+    run_benchmark("CompressedSnapshotRecord decode", [&crec](int){
+            cali_id_t     node_ids[128];
+            cali_id_t     attr_ids[128];
+            cali::Variant values[128];
+
+            cali::CompressedSnapshotRecordView view = crec.view();
+
+            view.unpack_nodes(128, node_ids);
+            view.unpack_immediate(128, attr_ids, values);
+        });
+
+    for (int d = 0; d < 4; ++d)
+        c.end(attr);
+}
+
+} // namespace [anonymous]
+
+
+int main(int argc, const char* argv[])
+{
+    // parse command line arguments
+
+    const util::Args::Table option_table[] = {
+        { "iterations", "iterations", 'i', true,
+          "Number of iterations per benchmark",
+          "100000" },
+        { "fanout",     "fanout",     'f', true,
+          "Tree fanout for the get_path benchmark",
+          "64" },
+
+        util::Args::Table::Terminator
+    };
+
+    util::Args args(option_table);
+
+    int lastarg = args.parse(argc, argv);
+
+    if (lastarg < argc) {
+        std::cerr << "cali-microbench: unknown option: " << argv[lastarg] << '\n'
+                  << "  Available options: ";
+
+        args.print_available_options(std::cerr);
+
+        return -1;
+    }
+
+    ::iterations = std::stoi(args.get("iterations", "100000"));
+    int fanout   = std::stoi(args.get("fanout",     "64"));
+
+    cali::Caliper c;
+
+    ::benchmark_begin_end(c);
+    ::benchmark_begin_end_fanout(c, fanout);
+    ::benchmark_set_value(c);
+
+    ::benchmark_pull_snapshot(c,  1);
+    ::benchmark_pull_snapshot(c,  4);
+    ::benchmark_pull_snapshot(c, 16);
+
+    ::benchmark_push_snapshot(c);
+    ::benchmark_compressed_record(c);
+}